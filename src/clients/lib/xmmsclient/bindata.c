@@ -79,3 +79,18 @@ xmmsc_bindata_list (xmmsc_connection_t *c)
 	return xmmsc_send_cmd (c, XMMS_IPC_OBJECT_BINDATA, XMMS_IPC_CMD_LIST_DATA,
 	                       XMMSV_LIST_END);
 }
+
+/**
+ * Retrieve statistics about the servers bindata cache. The result is
+ * a dict with the number of cache hits, misses and evictions, the
+ * number of cached entries, and the size and capacity of the cache
+ * in bytes.
+ */
+xmmsc_result_t *
+xmmsc_bindata_stats (xmmsc_connection_t *c)
+{
+	x_check_conn (c, NULL);
+
+	return xmmsc_send_cmd (c, XMMS_IPC_OBJECT_BINDATA, XMMS_IPC_CMD_STATS_DATA,
+	                       XMMSV_LIST_END);
+}
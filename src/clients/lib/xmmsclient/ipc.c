@@ -33,10 +33,28 @@
 #include "xmmsc/xmmsc_sockets.h"
 
 
+/* Initial number of slots in the result table, must be a power of two */
+#define XMMSC_IPC_RESULTS_INITIAL_SIZE 64
+
+typedef struct xmmsc_ipc_result_slot_St {
+	uint32_t cookie;
+	xmmsc_result_t *res;
+} xmmsc_ipc_result_slot_t;
+
+/**
+ * Outstanding results keyed by cookie. Open addressing with linear
+ * probing; empty slots have res set to NULL.
+ */
+typedef struct xmmsc_ipc_results_St {
+	xmmsc_ipc_result_slot_t *slots;
+	uint32_t size;
+	uint32_t used;
+} xmmsc_ipc_results_t;
+
 struct xmmsc_ipc_St {
 	xmms_ipc_transport_t *transport;
 	xmms_ipc_msg_t *read_msg;
-	x_list_t *results_list;
+	xmmsc_ipc_results_t results;
 	x_queue_t *out_msg;
 	char *error;
 	bool disconnect;
@@ -85,8 +103,12 @@ xmmsc_ipc_io_in_callback (xmmsc_ipc_t *ipc)
 		}
 	}
 
-	if (disco)
+	if (disco) {
 		xmmsc_ipc_disconnect (ipc);
+	} else if (ipc->need_out_callback && xmmsc_ipc_io_out (ipc)) {
+		/* the server may have made room for a blocked write */
+		ipc->need_out_callback (1, ipc->need_out_data);
+	}
 
 	return !disco;
 }
@@ -96,7 +118,9 @@ xmmsc_ipc_io_out (xmmsc_ipc_t *ipc)
 {
 	x_return_val_if_fail (ipc, false);
 
-	return !x_queue_is_empty (ipc->out_msg) && !ipc->disconnect;
+	/* a blocked write waits for input, not for the socket */
+	return !x_queue_is_empty (ipc->out_msg) && !ipc->disconnect &&
+	       !xmms_ipc_transport_write_blocked (ipc->transport);
 }
 
 int
@@ -108,11 +132,24 @@ xmmsc_ipc_io_out_callback (xmmsc_ipc_t *ipc)
 	x_return_val_if_fail (!ipc->disconnect, false);
 
 	while (!x_queue_is_empty (ipc->out_msg)) {
-		xmms_ipc_msg_t *msg = x_queue_peek_head (ipc->out_msg);
-		if (xmms_ipc_msg_write_transport (msg, ipc->transport, &disco)) {
+		xmms_ipc_msg_t *msgs[XMMS_IPC_TRANSPORT_MAX_IOVEC];
+		x_list_t *n;
+		int i, count = 0, written;
+
+		for (n = ipc->out_msg->head; n && count < XMMS_IPC_TRANSPORT_MAX_IOVEC;
+		     n = x_list_next (n)) {
+			msgs[count++] = n->data;
+		}
+
+		written = xmms_ipc_msg_write_transport_many (msgs, count,
+		                                             ipc->transport, &disco);
+
+		for (i = 0; i < written; i++) {
 			x_queue_pop_head (ipc->out_msg);
-			xmms_ipc_msg_destroy (msg);
-		} else {
+			xmms_ipc_msg_destroy (msgs[i]);
+		}
+
+		if (written < count) {
 			break;
 		}
 	}
@@ -170,7 +207,9 @@ xmmsc_ipc_init (void)
 	xmmsc_ipc_t *ipc;
 	ipc = x_new0 (xmmsc_ipc_t, 1);
 	ipc->disconnect = false;
-	ipc->results_list = NULL;
+	ipc->results.size = XMMSC_IPC_RESULTS_INITIAL_SIZE;
+	ipc->results.slots = x_new0 (xmmsc_ipc_result_slot_t,
+	                             XMMSC_IPC_RESULTS_INITIAL_SIZE);
 	ipc->out_msg = x_queue_new ();
 
 	return ipc;
@@ -202,6 +241,108 @@ xmmsc_ipc_lock_set (xmmsc_ipc_t *ipc, void *lock, void (*lockfunc)(void *), void
 	ipc->unlockfunc = unlockfunc;
 }
 
+/* Fibonacci hashing spreads the sequential cookies over the table */
+static inline uint32_t
+xmmsc_ipc_results_home (xmmsc_ipc_results_t *results, uint32_t cookie)
+{
+	return (cookie * 2654435761U) & (results->size - 1);
+}
+
+static xmmsc_ipc_result_slot_t *
+xmmsc_ipc_results_find (xmmsc_ipc_results_t *results, uint32_t cookie)
+{
+	uint32_t i;
+
+	for (i = xmmsc_ipc_results_home (results, cookie);
+	     results->slots[i].res;
+	     i = (i + 1) & (results->size - 1)) {
+		if (results->slots[i].cookie == cookie) {
+			return &results->slots[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void
+xmmsc_ipc_results_put (xmmsc_ipc_results_t *results, uint32_t cookie,
+                       xmmsc_result_t *res)
+{
+	uint32_t i;
+
+	for (i = xmmsc_ipc_results_home (results, cookie);
+	     results->slots[i].res;
+	     i = (i + 1) & (results->size - 1)) {
+		if (results->slots[i].cookie == cookie) {
+			results->slots[i].res = res;
+			return;
+		}
+	}
+
+	results->slots[i].cookie = cookie;
+	results->slots[i].res = res;
+	results->used++;
+}
+
+static bool
+xmmsc_ipc_results_grow (xmmsc_ipc_results_t *results)
+{
+	xmmsc_ipc_result_slot_t *old_slots;
+	uint32_t i, old_size;
+
+	old_slots = results->slots;
+	old_size = results->size;
+
+	results->slots = x_new0 (xmmsc_ipc_result_slot_t, old_size * 2);
+	if (!results->slots) {
+		x_oom ();
+		results->slots = old_slots;
+		return false;
+	}
+
+	results->size = old_size * 2;
+	results->used = 0;
+
+	for (i = 0; i < old_size; i++) {
+		if (old_slots[i].res) {
+			xmmsc_ipc_results_put (results, old_slots[i].cookie,
+			                       old_slots[i].res);
+		}
+	}
+
+	free (old_slots);
+
+	return true;
+}
+
+/**
+ * Empty a slot, moving later entries of the same probe sequence back
+ * so that lookups never stop early at the hole.
+ */
+static void
+xmmsc_ipc_results_remove_slot (xmmsc_ipc_results_t *results,
+                               xmmsc_ipc_result_slot_t *slot)
+{
+	uint32_t mask = results->size - 1;
+	uint32_t hole, i, home;
+
+	hole = slot - results->slots;
+
+	for (i = (hole + 1) & mask; results->slots[i].res; i = (i + 1) & mask) {
+		home = xmmsc_ipc_results_home (results, results->slots[i].cookie);
+
+		/* The entry may fill the hole unless its home lies
+		 * cyclically in (hole, i]. */
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			results->slots[hole] = results->slots[i];
+			hole = i;
+		}
+	}
+
+	results->slots[hole].res = NULL;
+	results->used--;
+}
+
 void
 xmmsc_ipc_result_register (xmmsc_ipc_t *ipc, xmmsc_result_t *res)
 {
@@ -209,27 +350,32 @@ xmmsc_ipc_result_register (xmmsc_ipc_t *ipc, xmmsc_result_t *res)
 	x_return_if_fail (res);
 
 	xmmsc_ipc_lock (ipc);
-	ipc->results_list = x_list_prepend (ipc->results_list, res);
+
+	/* Keep the load factor below 3/4 */
+	if ((ipc->results.used + 1) * 4 > ipc->results.size * 3 &&
+	    !xmmsc_ipc_results_grow (&ipc->results)) {
+		xmmsc_ipc_unlock (ipc);
+		return;
+	}
+
+	xmmsc_ipc_results_put (&ipc->results, xmmsc_result_cookie_get (res), res);
+
 	xmmsc_ipc_unlock (ipc);
 }
 
 xmmsc_result_t *
 xmmsc_ipc_result_lookup (xmmsc_ipc_t *ipc, uint32_t cookie)
 {
+	xmmsc_ipc_result_slot_t *slot;
 	xmmsc_result_t *res = NULL;
-	x_list_t *n;
 
 	x_return_val_if_fail (ipc, NULL);
 
 	xmmsc_ipc_lock (ipc);
 
-	for (n = ipc->results_list; n; n = x_list_next (n)) {
-		xmmsc_result_t *tmp = n->data;
-
-		if (cookie == xmmsc_result_cookie_get (tmp)) {
-			res = tmp;
-			break;
-		}
+	slot = xmmsc_ipc_results_find (&ipc->results, cookie);
+	if (slot) {
+		res = slot->res;
 	}
 
 	xmmsc_ipc_unlock (ipc);
@@ -240,20 +386,17 @@ xmmsc_ipc_result_lookup (xmmsc_ipc_t *ipc, uint32_t cookie)
 void
 xmmsc_ipc_result_unregister (xmmsc_ipc_t *ipc, xmmsc_result_t *res)
 {
-	x_list_t *n;
+	xmmsc_ipc_result_slot_t *slot;
 
 	x_return_if_fail (ipc);
 	x_return_if_fail (res);
 
 	xmmsc_ipc_lock (ipc);
 
-	for (n = ipc->results_list; n; n = x_list_next (n)) {
-		xmmsc_result_t *tmp = n->data;
-
-		if (xmmsc_result_cookie_get (res) == xmmsc_result_cookie_get (tmp)) {
-			ipc->results_list = x_list_delete_link (ipc->results_list, n);
-			break;
-		}
+	slot = xmmsc_ipc_results_find (&ipc->results,
+	                               xmmsc_result_cookie_get (res));
+	if (slot && slot->res == res) {
+		xmmsc_ipc_results_remove_slot (&ipc->results, slot);
 	}
 
 	xmmsc_ipc_unlock (ipc);
@@ -277,6 +420,13 @@ xmmsc_ipc_wait_for_event (xmmsc_ipc_t *ipc, unsigned int timeout)
 	x_return_if_fail (ipc);
 	x_return_if_fail (!ipc->disconnect);
 
+	/* Data that already has been read off the socket will not wake
+	 * up select, so handle that first. */
+	if (xmms_ipc_transport_read_pending (ipc->transport)) {
+		xmmsc_ipc_io_in_callback (ipc);
+		return;
+	}
+
 	tmout.tv_sec = timeout;
 	tmout.tv_usec = 0;
 
@@ -326,7 +476,7 @@ xmmsc_ipc_destroy (xmmsc_ipc_t *ipc)
 	if (!ipc)
 		return;
 
-	x_list_free (ipc->results_list);
+	free (ipc->results.slots);
 	if (ipc->transport) {
 		xmms_ipc_transport_destroy (ipc->transport);
 	}
@@ -198,7 +198,11 @@ xmmsc_result_restart (xmmsc_result_t *res)
 		return;
 	}
 
+	/* The result is registered under its cookie, so it has to be
+	 * registered again under the new one. */
+	xmmsc_ipc_result_unregister (res->ipc, res);
 	res->cookie = xmmsc_write_signal_msg (res->c, res->restart_signal);
+	xmmsc_ipc_result_register (res->ipc, res);
 }
 
 static bool
@@ -64,6 +64,18 @@ xmmsc_main_stats (xmmsc_connection_t *c)
 	return xmmsc_send_msg_no_arg (c, XMMS_IPC_OBJECT_MAIN, XMMS_IPC_CMD_STATS);
 }
 
+/**
+ * Request the statistics the server sends every core.stats_interval
+ * seconds. They are the same as returned by #xmmsc_main_stats.
+ */
+xmmsc_result_t *
+xmmsc_broadcast_main_stats (xmmsc_connection_t *c)
+{
+	x_check_conn (c, NULL);
+
+	return xmmsc_send_broadcast_msg (c, XMMS_IPC_SIGNAL_MAIN_STATS);
+}
+
 /**
  * Request status for the mediainfo reader. It can be idle or working
  */
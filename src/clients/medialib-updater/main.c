@@ -22,10 +22,23 @@
 
 #include <xmms_configuration.h>
 
+#include "pending.h"
+#include "watch.h"
+
+/* how long a file has to be left alone before the medialib hears of it */
+#define UPDATER_SETTLE_MS 2000
+/* how many urls to look up in one query */
+#define UPDATER_BATCH_SIZE 256
+
 typedef struct updater_St {
 	xmmsc_connection_t *conn;
-	GHashTable *watchers;
-	GFile *root;
+	updater_watch_t *watch;
+	updater_pending_t *pending;
+	gchar *root;
+
+	GTimer *clock;
+	guint flush_source;
+	gint64 flush_due;
 } updater_t;
 
 typedef struct updater_quit_St {
@@ -34,48 +47,21 @@ typedef struct updater_quit_St {
 	void *source;
 } updater_quit_t;
 
-static gboolean updater_add_watcher (updater_t *updater, GFile *root);
-static void on_directory_event (GFileMonitor *monitor, GFile *dir,
-                                GFile *other, GFileMonitorEvent event,
-                                gpointer udata);
-
-/* TODO: Remove once we depend on GLib >= 2.18 */
-#ifndef HAVE_G_FILE_QUERY_FILE_TYPE
-static GFileType
-g_file_query_file_type (GFile *file, GFileQueryInfoFlags flags,
-                        GCancellable *cancellable);
-
-GFileType
-g_file_query_file_type (GFile *file,
-                        GFileQueryInfoFlags   flags,
-                        GCancellable *cancellable)
-{
-  GFileInfo *info;
-  GFileType file_type;
-
-  g_return_val_if_fail (G_IS_FILE(file), G_FILE_TYPE_UNKNOWN);
-  info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_TYPE, flags,
-			    cancellable, NULL);
-  if (info != NULL)
-    {
-      file_type = g_file_info_get_file_type (info);
-      g_object_unref (info);
-    }
-  else
-    file_type = G_FILE_TYPE_UNKNOWN;
-
-  return file_type;
-}
-#endif
+/* rehashes and removals waiting for the ids of their files */
+typedef struct updater_batch_St {
+	updater_t *updater;
+	GPtrArray *ops;
+} updater_batch_t;
 
-static void
-unregister_monitor (gpointer ptr)
-{
-	GFileMonitor *monitor = (GFileMonitor *) ptr;
+/* what a directory scan found on disk, waiting for the medialib's view */
+typedef struct updater_scan_St {
+	updater_t *updater;
+	/* encoded url -> mtime */
+	GHashTable *files;
+} updater_scan_t;
 
-	g_file_monitor_cancel (monitor);
-	g_object_unref (monitor);
-}
+static void on_watch_event (gpointer udata, const gchar *path,
+                            updater_event_t event, gboolean is_dir);
 
 static updater_t *
 updater_new (void)
@@ -83,8 +69,13 @@ updater_new (void)
 	updater_t *updater = g_new0 (updater_t, 1);
 
 	updater->conn = xmmsc_init ("XMMS2-Medialib-Updater");
-	updater->watchers = g_hash_table_new_full (g_str_hash, g_str_equal,
-	                                           g_free, unregister_monitor);
+	updater->watch = updater_watch_new (on_watch_event, updater);
+	updater->pending = updater_pending_new (UPDATER_SETTLE_MS);
+	updater->clock = g_timer_new ();
+	updater->flush_due = -1;
+
+	g_debug ("watching directories with %s",
+	         updater_watch_backend (updater->watch));
 
 	return updater;
 }
@@ -93,11 +84,18 @@ static void
 updater_destroy (updater_t *updater)
 {
 	g_return_if_fail (updater);
-	g_return_if_fail (updater->watchers);
+	g_return_if_fail (updater->watch);
 	g_return_if_fail (updater->conn);
 
-	g_hash_table_destroy (updater->watchers);
+	if (updater->flush_source) {
+		g_source_remove (updater->flush_source);
+	}
+
+	updater_watch_free (updater->watch);
+	updater_pending_free (updater->pending);
+	g_timer_destroy (updater->clock);
 	xmmsc_unref (updater->conn);
+	g_free (updater->root);
 	g_free (updater);
 }
 
@@ -143,141 +141,503 @@ updater_connect (updater_t *updater, GMainLoop *ml)
 	return quit;
 }
 
-static void
-updater_clear_watchers (updater_t *updater)
+/**
+ * Milliseconds since the updater started, the clock pending ops are
+ * timed by.
+ */
+static gint64
+updater_now (updater_t *updater)
 {
-	g_return_if_fail (updater);
-	g_return_if_fail (updater->watchers);
+	return (gint64) (g_timer_elapsed (updater->clock, NULL) * 1000.0);
+}
 
-	g_hash_table_remove_all (updater->watchers);
+static gchar *
+updater_path_to_url (const gchar *path)
+{
+	gchar *encoded, *url;
+
+	encoded = xmmsc_medialib_encode_url (path);
+	url = g_strconcat ("file://", encoded, NULL);
+	free (encoded);
+
+	return url;
 }
 
+static gboolean
+updater_is_dir (const gchar *path)
+{
+	g_return_val_if_fail (path, FALSE);
 
-static void
-updater_find_sub_directories (updater_t *updater, GFile *file)
+	return g_file_test (path, G_FILE_TEST_IS_DIR);
+}
+
+static xmmsv_coll_t *
+updater_coll_new (xmmsv_coll_type_t type, const gchar *value)
 {
-	GFileEnumerator *enumerator;
-	GFileInfo *info;
-	GError *err = NULL;
+	xmmsv_coll_t *univ, *coll;
 
-	g_return_if_fail (updater);
-	g_return_if_fail (file);
+	univ = xmmsv_coll_universe ();
+	coll = xmmsv_coll_new (type);
+
+	xmmsv_coll_add_operand (coll, univ);
+	xmmsv_coll_attribute_set (coll, "field", "url");
+	xmmsv_coll_attribute_set (coll, "value", value);
+	xmmsv_coll_attribute_set (coll, "case-sensitive", "true");
+
+	xmmsv_coll_unref (univ);
+
+	return coll;
+}
+
+static void updater_flush (updater_t *updater);
+
+static gboolean
+updater_flush_timeout (gpointer udata)
+{
+	updater_t *updater = (updater_t *) udata;
+
+	updater->flush_source = 0;
+	updater->flush_due = -1;
 
-	enumerator = g_file_enumerate_children (file, G_FILE_ATTRIBUTE_STANDARD_NAME,
-	                                        G_FILE_QUERY_INFO_NONE, NULL, &err);
+	updater_flush (updater);
 
-	g_clear_error (&err);
+	return FALSE;
+}
 
-	while ((info = g_file_enumerator_next_file (enumerator, NULL, &err)) != NULL) {
-		const gchar *name;
-		GFile *child;
+/**
+ * Make sure the main loop wakes up when the next pending op is due.
+ */
+static void
+updater_schedule (updater_t *updater)
+{
+	gint64 due, now;
 
-		name = g_file_info_get_name (info);
-		child = g_file_get_child (file, name);
-		g_object_unref (info);
+	due = updater_pending_next_due (updater->pending);
+	if (due < 0) {
+		return;
+	}
 
-		updater_add_watcher (updater, child);
-		g_object_unref (child);
+	if (updater->flush_source) {
+		if (updater->flush_due <= due) {
+			return;
+		}
+		g_source_remove (updater->flush_source);
 	}
 
-	g_object_unref (enumerator);
+	now = updater_now (updater);
+
+	updater->flush_due = due;
+	updater->flush_source = g_timeout_add (MAX (due - now, 0),
+	                                       updater_flush_timeout, updater);
 }
 
+static void
+updater_batch_free (void *udata)
+{
+	updater_batch_t *batch = (updater_batch_t *) udata;
 
-static gboolean
-updater_is_dir (GFile *file)
+	g_ptr_array_foreach (batch->ops, (GFunc) updater_op_free, NULL);
+	g_ptr_array_free (batch->ops, TRUE);
+	g_free (batch);
+}
+
+static int
+updater_remove_file_by_id (xmmsv_t *value, void *udata)
 {
-	GFileType type;
+	xmmsc_result_t *res;
+	updater_t *updater;
+	int mid;
 
-	g_return_val_if_fail (file, FALSE);
+	updater = (updater_t *) udata;
 
-	type = g_file_query_file_type (file, G_FILE_QUERY_INFO_NONE, NULL);
+	g_return_val_if_fail (updater, FALSE);
 
-	if (type != G_FILE_TYPE_DIRECTORY) {
+	if (!xmmsv_get_int (value, &mid)) {
+		g_error ("couldn't find this one!");
 		return FALSE;
 	}
 
+	if (!mid) {
+		g_debug ("entry not in medialib");
+		return FALSE;
+	}
+
+	res = xmmsc_medialib_remove_entry (updater->conn, mid);
+	xmmsc_result_unref (res);
+
+	return FALSE;
+}
+
+static int
+updater_remove_directory_by_id (xmmsv_t *value, void *udata)
+{
+	xmmsv_list_iter_t *it;
+
+	xmmsv_get_list_iter (value, &it);
+	while (xmmsv_list_iter_valid (it)) {
+		xmmsv_t *item;
+
+		if (xmmsv_list_iter_entry (it, &item)) {
+			updater_remove_file_by_id (item, udata);
+		}
+
+		xmmsv_list_iter_next (it);
+	}
 	return TRUE;
 }
 
-static gboolean
-updater_add_watcher (updater_t *updater, GFile *file)
+static void
+updater_remove_directory (updater_t *updater, const gchar *url)
 {
-	GFileMonitor *monitor;
-	GError *err = NULL;
-	gchar *path;
+	xmmsc_result_t *res;
+	xmmsv_coll_t *coll;
+	gchar *pattern;
 
-	g_return_val_if_fail (updater, FALSE);
-	g_return_val_if_fail (file, FALSE);
+	/* the url of a directory op already ends with a slash */
+	pattern = g_strconcat (url, "*", NULL);
+	coll = updater_coll_new (XMMS_COLLECTION_TYPE_MATCH, pattern);
 
-	if (!updater_is_dir (file)) {
+	g_debug ("remove '%s' from mlib", pattern);
+
+	res = xmmsc_coll_query_ids (updater->conn, coll, NULL, 0, 0);
+	xmmsc_result_notifier_set (res, updater_remove_directory_by_id, updater);
+	xmmsc_result_unref (res);
+
+	xmmsv_coll_unref (coll);
+
+	g_free (pattern);
+}
+
+/**
+ * Carry out the ops of a batch now that the medialib has told which
+ * ids their urls have.
+ */
+static int
+updater_batch_resolved (xmmsv_t *value, void *udata)
+{
+	updater_batch_t *batch = (updater_batch_t *) udata;
+	updater_t *updater = batch->updater;
+	xmmsv_list_iter_t *it;
+	xmmsc_result_t *res;
+	GHashTable *ids;
+	const gchar *err;
+	guint i;
+
+	if (xmmsv_get_error (value, &err)) {
+		g_warning ("Couldn't look up medialib entries: %s", err);
 		return FALSE;
 	}
 
-	path = g_file_get_path (file);
+	ids = g_hash_table_new (g_str_hash, g_str_equal);
 
-	monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, &err);
-	if (err) {
-		g_printerr ("Unable to monitor '%s', %s\n", path, err->message);
-		g_error_free (err);
-		g_free (monitor);
-		g_free (path);
-		return FALSE;
+	xmmsv_get_list_iter (value, &it);
+	while (xmmsv_list_iter_valid (it)) {
+		const gchar *url;
+		xmmsv_t *item;
+		int mid;
+
+		if (xmmsv_list_iter_entry (it, &item) &&
+		    xmmsv_dict_entry_get_string (item, "url", &url) &&
+		    xmmsv_dict_entry_get_int (item, "id", &mid)) {
+			/* the strings live as long as the reply */
+			g_hash_table_insert (ids, (gpointer) url, GINT_TO_POINTER (mid));
+		}
+
+		xmmsv_list_iter_next (it);
 	}
 
-	g_signal_connect (monitor, "changed", (gpointer) on_directory_event, updater);
+	for (i = 0; i < batch->ops->len; i++) {
+		updater_op_t *op = g_ptr_array_index (batch->ops, i);
+		gint mid;
+
+		mid = GPOINTER_TO_INT (g_hash_table_lookup (ids, op->url));
+
+		if (op->type == UPDATER_OP_REMOVE) {
+			if (!mid) {
+				continue;
+			}
+			res = xmmsc_medialib_remove_entry (updater->conn, mid);
+		} else if (mid) {
+			res = xmmsc_medialib_rehash (updater->conn, mid);
+		} else {
+			/* replaced by a file the medialib hasn't seen */
+			res = xmmsc_medialib_add_entry_encoded (updater->conn, op->url);
+		}
+		xmmsc_result_unref (res);
+	}
 
-	/* path ownership transfered to the hash */
-	g_hash_table_insert (updater->watchers, path, monitor);
+	g_hash_table_destroy (ids);
 
-	updater_find_sub_directories (updater, file);
+	return FALSE;
+}
 
-	return TRUE;
+/**
+ * Look up the ids of a batch of urls with a single query, instead of
+ * one round trip per file.
+ */
+static void
+updater_resolve_batch (updater_t *updater, GPtrArray *ops)
+{
+	updater_batch_t *batch;
+	xmmsc_result_t *res;
+	xmmsv_coll_t *coll;
+	xmmsv_t *fetch;
+	guint i;
+
+	coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_UNION);
+	for (i = 0; i < ops->len; i++) {
+		updater_op_t *op = g_ptr_array_index (ops, i);
+		xmmsv_coll_t *equals;
+
+		equals = updater_coll_new (XMMS_COLLECTION_TYPE_EQUALS, op->url);
+		xmmsv_coll_add_operand (coll, equals);
+		xmmsv_coll_unref (equals);
+	}
+
+	fetch = xmmsv_build_list (XMMSV_LIST_ENTRY_STR ("id"),
+	                          XMMSV_LIST_ENTRY_STR ("url"),
+	                          XMMSV_LIST_END);
+
+	batch = g_new0 (updater_batch_t, 1);
+	batch->updater = updater;
+	batch->ops = ops;
+
+	g_debug ("resolving %u entries", ops->len);
+
+	res = xmmsc_coll_query_infos (updater->conn, coll, NULL, 0, 0, fetch, NULL);
+	xmmsc_result_notifier_set_full (res, updater_batch_resolved, batch,
+	                                updater_batch_free);
+	xmmsc_result_unref (res);
+
+	xmmsv_unref (fetch);
+	xmmsv_coll_unref (coll);
 }
 
-static gboolean
-updater_add_watcher_and_import (updater_t *updater, GFile *file)
+/**
+ * Tell the medialib about every file that has settled. Requests are
+ * only sent here, and back to back, so the connection can write them
+ * out together.
+ */
+static void
+updater_flush (updater_t *updater)
 {
 	xmmsc_result_t *res;
-	gchar *url, *path;
+	GPtrArray *ops, *unresolved;
+	guint i;
+
+	ops = updater_pending_take_due (updater->pending, updater_now (updater));
+	unresolved = g_ptr_array_new ();
+
+	for (i = 0; i < ops->len; i++) {
+		updater_op_t *op = g_ptr_array_index (ops, i);
+
+		switch (op->type) {
+		case UPDATER_OP_ADD:
+			g_debug ("adding '%s'", op->url);
+			res = xmmsc_medialib_add_entry_encoded (updater->conn, op->url);
+			xmmsc_result_unref (res);
+			break;
+		case UPDATER_OP_REMOVE_DIR:
+			updater_remove_directory (updater, op->url);
+			break;
+		case UPDATER_OP_REHASH:
+		case UPDATER_OP_REMOVE:
+			if (!op->id) {
+				g_ptr_array_add (unresolved, op);
+				if (unresolved->len == UPDATER_BATCH_SIZE) {
+					updater_resolve_batch (updater, unresolved);
+					unresolved = g_ptr_array_new ();
+				}
+				/* owned by the batch now */
+				continue;
+			}
+			if (op->type == UPDATER_OP_REHASH) {
+				res = xmmsc_medialib_rehash (updater->conn, op->id);
+			} else {
+				res = xmmsc_medialib_remove_entry (updater->conn, op->id);
+			}
+			xmmsc_result_unref (res);
+			break;
+		}
 
-	g_return_val_if_fail (updater, FALSE);
-	g_return_val_if_fail (file, FALSE);
+		updater_op_free (op);
+	}
+
+	if (unresolved->len) {
+		updater_resolve_batch (updater, unresolved);
+	} else {
+		g_ptr_array_free (unresolved, TRUE);
+	}
 
-	if (!updater_add_watcher (updater, file)) {
+	g_ptr_array_free (ops, TRUE);
+
+	updater_schedule (updater);
+}
+
+static void
+updater_scan_free (void *udata)
+{
+	updater_scan_t *scan = (updater_scan_t *) udata;
+
+	g_hash_table_destroy (scan->files);
+	g_free (scan);
+}
+
+/**
+ * Compare what the medialib knows about a directory with what was found
+ * on disk, and queue whatever it takes to make them agree. Files that
+ * haven't changed since they were last read are left alone.
+ */
+static int
+updater_scan_reconcile (xmmsv_t *value, void *udata)
+{
+	updater_scan_t *scan = (updater_scan_t *) udata;
+	updater_t *updater = scan->updater;
+	xmmsv_list_iter_t *it;
+	GHashTableIter iter;
+	gpointer key, mtime;
+	const gchar *err;
+	gint64 due;
+
+	if (xmmsv_get_error (value, &err)) {
+		g_warning ("Couldn't query the medialib: %s", err);
 		return FALSE;
 	}
 
-	path = g_file_get_path (file);
-	url = g_strdup_printf ("file://%s", path);
-	g_free (path);
+	/* a directory that just showed up may still be being copied */
+	due = updater_now (updater) + UPDATER_SETTLE_MS;
 
-	res = xmmsc_medialib_import_path (updater->conn, url);
-	xmmsc_result_unref (res);
+	xmmsv_get_list_iter (value, &it);
+	while (xmmsv_list_iter_valid (it)) {
+		const gchar *url;
+		xmmsv_t *item;
+		int mid, lmod = 0;
+
+		if (xmmsv_list_iter_entry (it, &item) &&
+		    xmmsv_dict_entry_get_string (item, "url", &url) &&
+		    xmmsv_dict_entry_get_int (item, "id", &mid)) {
+			xmmsv_dict_entry_get_int (item, "lmod", &lmod);
+
+			if (!g_hash_table_lookup_extended (scan->files, url, NULL, &mtime)) {
+				updater_pending_set (updater->pending, url,
+				                     UPDATER_OP_REMOVE, mid, due);
+			} else {
+				if (GPOINTER_TO_INT (mtime) != lmod) {
+					updater_pending_set (updater->pending, url,
+					                     UPDATER_OP_REHASH, mid, due);
+				}
+				g_hash_table_remove (scan->files, url);
+			}
+		}
 
-	g_free (url);
+		xmmsv_list_iter_next (it);
+	}
 
-	return TRUE;
+	/* whatever is left is new to the medialib */
+	g_hash_table_iter_init (&iter, scan->files);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		updater_pending_set (updater->pending, (const gchar *) key,
+		                     UPDATER_OP_ADD, 0, due);
+	}
+
+	g_debug ("%u medialib updates queued", updater_pending_size (updater->pending));
+
+	updater_schedule (updater);
+
+	return FALSE;
 }
 
-static gboolean
-updater_remove_watcher (updater_t *updater, GFile *file)
+/**
+ * Start watching a directory and everything below it, and bring the
+ * medialib up to date with its contents.
+ */
+static void
+updater_scan (updater_t *updater, const gchar *path)
 {
-	gboolean ret = TRUE;
-	gchar *path;
+	updater_scan_t *scan;
+	xmmsc_result_t *res;
+	xmmsv_coll_t *coll;
+	xmmsv_t *fetch;
+	GSList *dirs;
+	gchar *url, *pattern;
 
-	g_return_val_if_fail (updater, FALSE);
-	g_return_val_if_fail (file, FALSE);
+	g_return_if_fail (updater);
+	g_return_if_fail (path);
+
+	scan = g_new0 (updater_scan_t, 1);
+	scan->updater = updater;
+	scan->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	dirs = g_slist_prepend (NULL, g_strdup (path));
+	while (dirs) {
+		GFileEnumerator *enumerator;
+		GFileInfo *info;
+		GFile *file;
+		gchar *dir;
+
+		dir = (gchar *) dirs->data;
+		dirs = g_slist_delete_link (dirs, dirs);
+
+		updater_watch_add (updater->watch, dir);
+
+		file = g_file_new_for_path (dir);
+		enumerator = g_file_enumerate_children (file,
+		                                        G_FILE_ATTRIBUTE_STANDARD_NAME ","
+		                                        G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+		                                        G_FILE_ATTRIBUTE_TIME_MODIFIED,
+		                                        G_FILE_QUERY_INFO_NONE, NULL, NULL);
+		g_object_unref (file);
 
-	path = g_file_get_path (file);
+		while (enumerator &&
+		       (info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
+			gchar *child;
+
+			child = g_build_filename (dir, g_file_info_get_name (info), NULL);
+
+			switch (g_file_info_get_file_type (info)) {
+			case G_FILE_TYPE_DIRECTORY:
+				dirs = g_slist_prepend (dirs, child);
+				child = NULL;
+				break;
+			case G_FILE_TYPE_REGULAR:
+				g_hash_table_insert (scan->files, updater_path_to_url (child),
+				                     GINT_TO_POINTER (g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)));
+				break;
+			default:
+				break;
+			}
+
+			g_free (child);
+			g_object_unref (info);
+		}
 
-	if (!g_hash_table_remove (updater->watchers, path)) {
-		ret = FALSE;
+		if (enumerator) {
+			g_object_unref (enumerator);
+		}
+		g_free (dir);
 	}
 
-	g_free (path);
+	url = updater_path_to_url (path);
+	pattern = g_strconcat (url, "/*", NULL);
+	g_free (url);
+
+	coll = updater_coll_new (XMMS_COLLECTION_TYPE_MATCH, pattern);
+	fetch = xmmsv_build_list (XMMSV_LIST_ENTRY_STR ("id"),
+	                          XMMSV_LIST_ENTRY_STR ("url"),
+	                          XMMSV_LIST_ENTRY_STR ("lmod"),
+	                          XMMSV_LIST_END);
+
+	g_debug ("scanned %u files below '%s'",
+	         g_hash_table_size (scan->files), path);
 
-	return ret;
+	res = xmmsc_coll_query_infos (updater->conn, coll, NULL, 0, 0, fetch, NULL);
+	xmmsc_result_notifier_set_full (res, updater_scan_reconcile, scan,
+	                                updater_scan_free);
+	xmmsc_result_unref (res);
+
+	xmmsv_unref (fetch);
+	xmmsv_coll_unref (coll);
+	g_free (pattern);
 }
 
 /**
@@ -286,24 +646,22 @@ updater_remove_watcher (updater_t *updater, GFile *file)
 static gboolean
 updater_switch_directory (updater_t *updater, const gchar *path)
 {
-	GFile *file;
-
 	g_return_val_if_fail (updater, FALSE);
 	g_return_val_if_fail (updater->conn, FALSE);
 	g_return_val_if_fail (path, FALSE);
 
-	file = g_file_new_for_path (path);
-
 	g_debug ("switching directory to: %s", path);
 
-	if (!updater_is_dir (file)) {
-		g_object_unref (file);
+	if (!updater_is_dir (path)) {
 		return FALSE;
 	}
 
-	updater_clear_watchers (updater);
-	updater_add_watcher_and_import (updater, file);
-	g_object_unref (file);
+	updater_watch_clear (updater->watch);
+
+	g_free (updater->root);
+	updater->root = g_strdup (path);
+
+	updater_scan (updater, path);
 
 	return TRUE;
 }
@@ -402,259 +760,48 @@ updater_subscribe_config (updater_t *updater)
 }
 
 static void
-updater_add_file (updater_t *updater, GFile *file)
-{
-	xmmsc_result_t *res;
-	gchar *path, *url;
-
-	g_return_if_fail (updater);
-	g_return_if_fail (updater->conn);
-	g_return_if_fail (file);
-
-	path = g_file_get_path (file);
-	url = g_strdup_printf ("file://%s", path);
-	g_free (path);
-
-	res = xmmsc_medialib_add_entry (updater->conn, url);
-	xmmsc_result_unref (res);
-
-	g_free (url);
-}
-
-static int
-updater_remove_file_by_id (xmmsv_t *value, void *udata)
-{
-	xmmsc_result_t *res;
-	updater_t *updater;
-	int mid;
-
-	updater = (updater_t *) udata;
-
-	g_return_val_if_fail (updater, FALSE);
-
-	if (!xmmsv_get_int (value, &mid)) {
-		g_error ("couldn't find this one!");
-		return FALSE;
-	}
-
-	if (!mid) {
-		g_debug ("entry not in medialib");
-		return FALSE;
-	}
-
-	res = xmmsc_medialib_remove_entry (updater->conn, mid);
-	xmmsc_result_unref (res);
-
-	return FALSE;
-}
-
-static void
-updater_remove_file (updater_t *updater, GFile *file)
+on_watch_event (gpointer udata, const gchar *path, updater_event_t event,
+                gboolean is_dir)
 {
-	xmmsc_result_t *res;
-	gchar *path, *url;
+	updater_t *updater = (updater_t *) udata;
+	gchar *url;
 
 	g_return_if_fail (updater);
-	g_return_if_fail (updater->conn);
-	g_return_if_fail (file);
-
-	path = g_file_get_path (file);
-	url = g_strdup_printf ("file://%s", path);
-	g_free (path);
 
-	g_debug ("removing file '%s'", url);
-
-	res = xmmsc_medialib_get_id (updater->conn, url);
-	xmmsc_result_notifier_set (res, updater_remove_file_by_id, updater);
-	xmmsc_result_unref (res);
-
-	g_free (url);
-}
-
-static int
-updater_remove_directory_by_id (xmmsv_t *value, void *udata)
-{
-	xmmsv_list_iter_t *it;
-
-	xmmsv_get_list_iter (value, &it);
-	while (xmmsv_list_iter_valid (it)) {
-		xmmsv_t *item;
-
-		if (xmmsv_list_iter_entry (it, &item)) {
-			updater_remove_file_by_id (item, udata);
+	if (!path) {
+		/* events were dropped, find out what changed the hard way */
+		if (updater->root) {
+			g_debug ("lost track of changes, rescanning");
+			updater_scan (updater, updater->root);
 		}
-
-		xmmsv_list_iter_next (it);
+		return;
 	}
-	return TRUE;
-}
 
-static void
-updater_remove_directory (updater_t *updater, GFile *file)
-{
-	xmmsc_result_t *res;
-	xmmsv_coll_t *univ, *coll;
-	gchar *path, *pattern, *encoded;
-
-	path = g_file_get_path (file);
-	encoded = xmmsc_medialib_encode_url (path);
-	g_free (path);
-
-	pattern = g_strdup_printf ("file://%s/*", encoded);
-	g_free (encoded);
-
-	univ = xmmsv_coll_universe ();
-	coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_MATCH);
-
-	xmmsv_coll_add_operand (coll, univ);
-	xmmsv_coll_attribute_set (coll, "field", "url");
-	xmmsv_coll_attribute_set (coll, "value", pattern);
-	xmmsv_coll_attribute_set (coll, "case-sensitive", "true");
-
-	g_debug ("remove '%s' from mlib", pattern);
-
-	res = xmmsc_coll_query_ids (updater->conn, coll, NULL, 0, 0);
-	xmmsc_result_notifier_set (res, updater_remove_directory_by_id, updater);
-	xmmsc_result_unref (res);
-
-	xmmsv_coll_unref (coll);
-	xmmsv_coll_unref (univ);
-
-	g_free (pattern);
-}
-
-static int
-updater_rehash_file_by_id (xmmsv_t *value, void *udata)
-{
-	xmmsc_result_t *res;
-	updater_t *updater;
-	int mid;
-
-	updater = (updater_t *) udata;
-
-	g_return_val_if_fail (updater, FALSE);
-
-	if (!xmmsv_get_int (value, &mid)) {
-		return FALSE;
-	}
-
-	if (!mid) {
-		g_warning ("Couldn't find requested medialib entry.");
-		return FALSE;
-	}
-
-	res = xmmsc_medialib_rehash (updater->conn, mid);
-	xmmsc_result_unref (res);
-
-	return FALSE;
-}
-
-static void
-updater_rehash_file (updater_t *updater, GFile *file)
-{
-	xmmsc_result_t *res;
-	gchar *path, *url;
-
-	g_return_if_fail (updater);
-	g_return_if_fail (updater->conn);
-	g_return_if_fail (file);
-
-	path = g_file_get_path (file);
-	url = g_strdup_printf ("file://%s", path);
-	g_free (path);
-
-	g_debug ("resolving entry '%s'", url);
-
-	res = xmmsc_medialib_get_id (updater->conn, url);
-	xmmsc_result_notifier_set (res, updater_rehash_file_by_id, updater);
-	xmmsc_result_unref (res);
-
-	g_free (url);
-}
-
-static void
-on_entity_created (updater_t *updater, GFile *entity)
-{
-	GFileType type;
-
-	g_return_if_fail (updater);
-	g_return_if_fail (entity);
-
-	type = g_file_query_file_type (entity, G_FILE_QUERY_INFO_NONE, NULL);
-	switch (type) {
-	case G_FILE_TYPE_DIRECTORY:
-		g_debug ("directory created");
-		updater_add_watcher_and_import (updater, entity);
-		break;
-	case G_FILE_TYPE_REGULAR:
-		g_debug ("file created");
-		updater_add_file (updater, entity);
-		break;
-	default:
-		g_debug ("something else created: %d", (int) type);
-		break;
-	}
-}
-
-static void
-on_entity_changed (updater_t *updater, GFile *entity)
-{
-	GFileType type;
-
-	g_return_if_fail (updater);
-	g_return_if_fail (entity);
-
-	type = g_file_query_file_type (entity, G_FILE_QUERY_INFO_NONE, NULL);
-	switch (type) {
-	case G_FILE_TYPE_REGULAR:
-		updater_rehash_file (updater, entity);
-		break;
-	default:
-		g_debug ("something else changed: %d", (int) type);
-		break;
-	}
-}
-
-static void
-on_entity_deleted (updater_t *updater, GFile *entity)
-{
-	g_debug ("entity deleted");
-
-	g_return_if_fail (updater);
-	g_return_if_fail (entity);
-
-	/* There is no way of knowing if the deleted event
-	 * came from a file or a directory so lets give it
-	 * a go with both actions and see what happens.
-	 */
-	if (updater_remove_watcher (updater, entity)) {
-		updater_remove_directory (updater, entity);
+	if (is_dir) {
+		switch (event) {
+		case UPDATER_EVENT_CREATED:
+			g_debug ("directory created");
+			updater_scan (updater, path);
+			break;
+		case UPDATER_EVENT_DELETED:
+			g_debug ("directory deleted");
+			updater_watch_remove (updater->watch, path);
+			url = updater_path_to_url (path);
+			updater_pending_remove_dir (updater->pending, url,
+			                            updater_now (updater));
+			g_free (url);
+			break;
+		default:
+			return;
+		}
 	} else {
-		updater_remove_file (updater, entity);
+		url = updater_path_to_url (path);
+		updater_pending_event (updater->pending, url, event,
+		                       updater_now (updater));
+		g_free (url);
 	}
-}
 
-static void
-on_directory_event (GFileMonitor *monitor, GFile *entity, GFile *other,
-                    GFileMonitorEvent event, gpointer udata)
-{
-	updater_t *updater = (updater_t *) udata;
-
-	g_return_if_fail (updater);
-
-	switch (event) {
-	case G_FILE_MONITOR_EVENT_CREATED:
-		on_entity_created (updater, entity);
-		break;
-	case G_FILE_MONITOR_EVENT_CHANGED:
-		on_entity_changed (updater, entity);
-		break;
-	case G_FILE_MONITOR_EVENT_DELETED:
-		on_entity_deleted (updater, entity);
-		break;
-	default:
-		break;
-	}
+	updater_schedule (updater);
 }
 
 int
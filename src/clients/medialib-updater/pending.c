@@ -0,0 +1,268 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * Medialib operations waiting for the files they are about to settle.
+ *
+ * Copying a file into a watched directory produces a created event and
+ * then a changed event for every few blocks written. Instead of asking
+ * the medialib to rehash the file each time, events are folded into a
+ * single pending operation per url, which is only carried out once no
+ * new event has arrived for it for a while.
+ */
+
+#include <string.h>
+
+#include "pending.h"
+
+struct updater_pending_St {
+	/* url -> updater_op_t, the key is owned by the op */
+	GHashTable *ops;
+	gint settle_ms;
+};
+
+typedef struct {
+	GPtrArray *out;
+	const gchar *prefix;
+	gint64 now;
+} updater_pending_foreach_t;
+
+updater_pending_t *
+updater_pending_new (gint settle_ms)
+{
+	updater_pending_t *pending;
+
+	pending = g_new0 (updater_pending_t, 1);
+	pending->ops = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+	                                      (GDestroyNotify) updater_op_free);
+	pending->settle_ms = settle_ms;
+
+	return pending;
+}
+
+void
+updater_pending_free (updater_pending_t *pending)
+{
+	g_return_if_fail (pending);
+
+	g_hash_table_destroy (pending->ops);
+	g_free (pending);
+}
+
+void
+updater_op_free (updater_op_t *op)
+{
+	g_free (op->url);
+	g_free (op);
+}
+
+static updater_op_t *
+updater_pending_insert (updater_pending_t *pending, const gchar *url)
+{
+	updater_op_t *op;
+
+	op = g_new0 (updater_op_t, 1);
+	op->url = g_strdup (url);
+	g_hash_table_insert (pending->ops, op->url, op);
+
+	return op;
+}
+
+/**
+ * Fold an event for a file into what is already pending for it, and
+ * put off carrying it out until the file has settled.
+ */
+void
+updater_pending_event (updater_pending_t *pending, const gchar *url,
+                       updater_event_t event, gint64 now)
+{
+	updater_op_type_t type = UPDATER_OP_ADD;
+	updater_op_t *op;
+
+	g_return_if_fail (pending);
+	g_return_if_fail (url);
+
+	op = g_hash_table_lookup (pending->ops, url);
+
+	switch (event) {
+	case UPDATER_EVENT_CREATED:
+		/* replacing a file the medialib may know about; a rehash
+		 * falls back to adding it if it doesn't */
+		if (op && op->type != UPDATER_OP_ADD) {
+			type = UPDATER_OP_REHASH;
+		}
+		break;
+	case UPDATER_EVENT_CHANGED:
+		if (!op || op->type != UPDATER_OP_ADD) {
+			type = UPDATER_OP_REHASH;
+		}
+		break;
+	case UPDATER_EVENT_DELETED:
+		/* even when it was only just created, the created event
+		 * could have been for a file that was overwritten */
+		type = UPDATER_OP_REMOVE;
+		break;
+	}
+
+	if (!op) {
+		op = updater_pending_insert (pending, url);
+	}
+
+	op->type = type;
+	if (type == UPDATER_OP_ADD) {
+		op->id = 0;
+	}
+	op->due = now + pending->settle_ms;
+}
+
+static gboolean
+updater_pending_below (gpointer key, gpointer value, gpointer udata)
+{
+	updater_pending_foreach_t *data = (updater_pending_foreach_t *) udata;
+
+	return g_str_has_prefix ((const gchar *) key, data->prefix);
+}
+
+/**
+ * Queue removing everything below a deleted directory, replacing
+ * whatever was pending for the files in it. The op is kept under the
+ * directory url with a slash appended, which is also its url.
+ */
+void
+updater_pending_remove_dir (updater_pending_t *pending, const gchar *url,
+                            gint64 now)
+{
+	updater_pending_foreach_t data;
+	updater_op_t *op;
+	gchar *prefix;
+
+	g_return_if_fail (pending);
+	g_return_if_fail (url);
+
+	prefix = g_strconcat (url, "/", NULL);
+
+	data.prefix = prefix;
+	g_hash_table_foreach_remove (pending->ops, updater_pending_below, &data);
+
+	op = updater_pending_insert (pending, prefix);
+	op->type = UPDATER_OP_REMOVE_DIR;
+	op->due = now + pending->settle_ms;
+
+	g_free (prefix);
+}
+
+/**
+ * Queue an op found by comparing the disk with the medialib. Events
+ * that arrived in the meantime are newer, so an op already pending
+ * for the url is kept; it only learns the id if it didn't have one.
+ */
+void
+updater_pending_set (updater_pending_t *pending, const gchar *url,
+                     updater_op_type_t type, gint id, gint64 due)
+{
+	updater_op_t *op;
+
+	g_return_if_fail (pending);
+	g_return_if_fail (url);
+
+	op = g_hash_table_lookup (pending->ops, url);
+	if (op) {
+		if (!op->id && op->type != UPDATER_OP_ADD) {
+			op->id = id;
+		}
+		return;
+	}
+
+	op = updater_pending_insert (pending, url);
+	op->type = type;
+	op->id = id;
+	op->due = due;
+}
+
+guint
+updater_pending_size (updater_pending_t *pending)
+{
+	g_return_val_if_fail (pending, 0);
+
+	return g_hash_table_size (pending->ops);
+}
+
+/**
+ * @returns when the next op is due, or -1 if nothing is pending.
+ */
+gint64
+updater_pending_next_due (updater_pending_t *pending)
+{
+	GHashTableIter iter;
+	updater_op_t *op;
+	gint64 due = -1;
+
+	g_return_val_if_fail (pending, -1);
+
+	g_hash_table_iter_init (&iter, pending->ops);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &op)) {
+		if (due < 0 || op->due < due) {
+			due = op->due;
+		}
+	}
+
+	return due;
+}
+
+static gboolean
+updater_pending_steal_due (gpointer key, gpointer value, gpointer udata)
+{
+	updater_pending_foreach_t *data = (updater_pending_foreach_t *) udata;
+	updater_op_t *op = (updater_op_t *) value;
+
+	if (op->due > data->now) {
+		return FALSE;
+	}
+
+	g_ptr_array_add (data->out, op);
+
+	return TRUE;
+}
+
+static gint
+updater_op_compare (gconstpointer a, gconstpointer b)
+{
+	const updater_op_t *op_a = *(const updater_op_t **) a;
+	const updater_op_t *op_b = *(const updater_op_t **) b;
+
+	return strcmp (op_a->url, op_b->url);
+}
+
+/**
+ * Take out every op that is due, sorted by url so files in the same
+ * directory end up next to each other. The caller frees the ops with
+ * #updater_op_free.
+ */
+GPtrArray *
+updater_pending_take_due (updater_pending_t *pending, gint64 now)
+{
+	updater_pending_foreach_t data;
+
+	g_return_val_if_fail (pending, NULL);
+
+	data.out = g_ptr_array_new ();
+	data.now = now;
+	g_hash_table_foreach_steal (pending->ops, updater_pending_steal_due, &data);
+
+	g_ptr_array_sort (data.out, updater_op_compare);
+
+	return data.out;
+}
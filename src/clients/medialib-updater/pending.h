@@ -0,0 +1,65 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+#ifndef __UPDATER_PENDING_H__
+#define __UPDATER_PENDING_H__
+
+#include <glib.h>
+
+/** What happened to a file, as told by the directory watcher */
+typedef enum {
+	UPDATER_EVENT_CREATED,
+	UPDATER_EVENT_CHANGED,
+	UPDATER_EVENT_DELETED
+} updater_event_t;
+
+/** What to ask the medialib to do about a file */
+typedef enum {
+	UPDATER_OP_ADD,
+	UPDATER_OP_REHASH,
+	UPDATER_OP_REMOVE,
+	/** remove everything below a deleted directory */
+	UPDATER_OP_REMOVE_DIR
+} updater_op_type_t;
+
+typedef struct updater_op_St {
+	updater_op_type_t type;
+	/** encoded url of the file or directory */
+	gchar *url;
+	/** medialib id if already known, otherwise 0 */
+	gint id;
+	/** when the op may be carried out, in milliseconds */
+	gint64 due;
+} updater_op_t;
+
+typedef struct updater_pending_St updater_pending_t;
+
+updater_pending_t *updater_pending_new (gint settle_ms);
+void updater_pending_free (updater_pending_t *pending);
+
+void updater_pending_event (updater_pending_t *pending, const gchar *url,
+                            updater_event_t event, gint64 now);
+void updater_pending_remove_dir (updater_pending_t *pending, const gchar *url,
+                                 gint64 now);
+void updater_pending_set (updater_pending_t *pending, const gchar *url,
+                          updater_op_type_t type, gint id, gint64 due);
+
+guint updater_pending_size (updater_pending_t *pending);
+gint64 updater_pending_next_due (updater_pending_t *pending);
+GPtrArray *updater_pending_take_due (updater_pending_t *pending, gint64 now);
+
+void updater_op_free (updater_op_t *op);
+
+#endif
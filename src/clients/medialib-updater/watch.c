@@ -0,0 +1,410 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * Directory watching for the medialib updater.
+ *
+ * Where inotify is available all directories are watched through a
+ * single inotify descriptor, which also says whether a deleted entry
+ * was a directory and reports a file once it has been closed after
+ * writing. Otherwise, or if inotify can't be set up, every directory
+ * gets a GFileMonitor of its own.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <gio/gio.h>
+
+#include <xmms_configuration.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+
+#define UPDATER_INOTIFY_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | \
+                              IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+#endif
+
+#include "watch.h"
+
+struct updater_watch_St {
+	updater_watch_func_t func;
+	gpointer udata;
+
+	/* path -> GFileMonitor, or the inotify watch descriptor */
+	GHashTable *dirs;
+
+	/* -1 when using GFileMonitor */
+	gint fd;
+#ifdef HAVE_SYS_INOTIFY_H
+	/* watch descriptor -> path, the path is owned by dirs */
+	GHashTable *wds;
+	GIOChannel *channel;
+	guint source;
+#endif
+};
+
+/* TODO: Remove once we depend on GLib >= 2.18 */
+#ifndef HAVE_G_FILE_QUERY_FILE_TYPE
+static GFileType
+g_file_query_file_type (GFile *file, GFileQueryInfoFlags flags,
+                        GCancellable *cancellable);
+
+GFileType
+g_file_query_file_type (GFile *file,
+                        GFileQueryInfoFlags   flags,
+                        GCancellable *cancellable)
+{
+  GFileInfo *info;
+  GFileType file_type;
+
+  g_return_val_if_fail (G_IS_FILE(file), G_FILE_TYPE_UNKNOWN);
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_TYPE, flags,
+			    cancellable, NULL);
+  if (info != NULL)
+    {
+      file_type = g_file_info_get_file_type (info);
+      g_object_unref (info);
+    }
+  else
+    file_type = G_FILE_TYPE_UNKNOWN;
+
+  return file_type;
+}
+#endif
+
+static void
+on_directory_event (GFileMonitor *monitor, GFile *entity, GFile *other,
+                    GFileMonitorEvent event, gpointer udata)
+{
+	updater_watch_t *watch = (updater_watch_t *) udata;
+	GFileType type;
+	gchar *path;
+
+	g_return_if_fail (watch);
+
+	path = g_file_get_path (entity);
+
+	/* the parent directory's monitor reports this one too */
+	if (g_hash_table_lookup (watch->dirs, path) == monitor) {
+		g_free (path);
+		return;
+	}
+
+	switch (event) {
+	case G_FILE_MONITOR_EVENT_CREATED:
+	case G_FILE_MONITOR_EVENT_CHANGED:
+		type = g_file_query_file_type (entity, G_FILE_QUERY_INFO_NONE, NULL);
+		if (type == G_FILE_TYPE_REGULAR) {
+			watch->func (watch->udata, path,
+			             event == G_FILE_MONITOR_EVENT_CREATED ?
+			             UPDATER_EVENT_CREATED : UPDATER_EVENT_CHANGED,
+			             FALSE);
+		} else if (type == G_FILE_TYPE_DIRECTORY &&
+		           event == G_FILE_MONITOR_EVENT_CREATED) {
+			watch->func (watch->udata, path, UPDATER_EVENT_CREATED, TRUE);
+		} else {
+			g_debug ("something else created or changed: %d", (int) type);
+		}
+		break;
+	case G_FILE_MONITOR_EVENT_DELETED:
+		/* There is no way of knowing if the deleted event
+		 * came from a file or a directory, but all the
+		 * directories are being watched.
+		 */
+		watch->func (watch->udata, path, UPDATER_EVENT_DELETED,
+		             g_hash_table_lookup (watch->dirs, path) != NULL);
+		break;
+	default:
+		break;
+	}
+
+	g_free (path);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+static gboolean
+on_inotify_readable (GIOChannel *channel, GIOCondition cond, gpointer udata)
+{
+	updater_watch_t *watch = (updater_watch_t *) udata;
+	gchar buf[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+	const struct inotify_event *ev;
+	updater_event_t event;
+	const gchar *dir;
+	gchar *path, *ptr;
+	gssize len;
+
+	while ((len = read (watch->fd, buf, sizeof (buf))) > 0) {
+		for (ptr = buf; ptr < buf + len; ptr += sizeof (*ev) + ev->len) {
+			ev = (const struct inotify_event *) ptr;
+
+			if (ev->mask & IN_Q_OVERFLOW) {
+				watch->func (watch->udata, NULL, UPDATER_EVENT_CHANGED, FALSE);
+				continue;
+			}
+
+			dir = g_hash_table_lookup (watch->wds, GINT_TO_POINTER (ev->wd));
+			if (!dir) {
+				continue;
+			}
+
+			/* the directory is gone, or was unmounted */
+			if (ev->mask & IN_IGNORED) {
+				g_hash_table_remove (watch->wds, GINT_TO_POINTER (ev->wd));
+				g_hash_table_remove (watch->dirs, dir);
+				continue;
+			}
+
+			if (!ev->len) {
+				continue;
+			}
+
+			if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+				event = UPDATER_EVENT_CREATED;
+			} else if (ev->mask & IN_CLOSE_WRITE) {
+				event = UPDATER_EVENT_CHANGED;
+			} else {
+				event = UPDATER_EVENT_DELETED;
+			}
+
+			path = g_build_filename (dir, ev->name, NULL);
+			watch->func (watch->udata, path, event, !!(ev->mask & IN_ISDIR));
+			g_free (path);
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+updater_watch_inotify_init (updater_watch_t *watch)
+{
+	watch->fd = inotify_init ();
+	if (watch->fd < 0) {
+		return FALSE;
+	}
+
+	fcntl (watch->fd, F_SETFL, fcntl (watch->fd, F_GETFL) | O_NONBLOCK);
+	fcntl (watch->fd, F_SETFD, FD_CLOEXEC);
+
+	watch->wds = g_hash_table_new (NULL, NULL);
+	watch->channel = g_io_channel_unix_new (watch->fd);
+	watch->source = g_io_add_watch (watch->channel, G_IO_IN,
+	                                on_inotify_readable, watch);
+
+	return TRUE;
+}
+#endif
+
+updater_watch_t *
+updater_watch_new (updater_watch_func_t func, gpointer udata)
+{
+	updater_watch_t *watch;
+
+	g_return_val_if_fail (func, NULL);
+
+	watch = g_new0 (updater_watch_t, 1);
+	watch->func = func;
+	watch->udata = udata;
+	watch->dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                     g_free, NULL);
+	watch->fd = -1;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (!updater_watch_inotify_init (watch)) {
+		g_debug ("inotify unavailable, using one monitor per directory");
+	}
+#endif
+
+	return watch;
+}
+
+void
+updater_watch_free (updater_watch_t *watch)
+{
+	g_return_if_fail (watch);
+
+	updater_watch_clear (watch);
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (watch->fd != -1) {
+		g_source_remove (watch->source);
+		g_io_channel_unref (watch->channel);
+		g_hash_table_destroy (watch->wds);
+		close (watch->fd);
+	}
+#endif
+
+	g_hash_table_destroy (watch->dirs);
+	g_free (watch);
+}
+
+const gchar *
+updater_watch_backend (updater_watch_t *watch)
+{
+	g_return_val_if_fail (watch, NULL);
+
+	return watch->fd != -1 ? "inotify" : "gio";
+}
+
+/**
+ * Start watching a single directory.
+ *
+ * @returns FALSE if it couldn't be watched.
+ */
+gboolean
+updater_watch_add (updater_watch_t *watch, const gchar *path)
+{
+	GFileMonitor *monitor;
+	GError *err = NULL;
+	GFile *file;
+
+	g_return_val_if_fail (watch, FALSE);
+	g_return_val_if_fail (path, FALSE);
+
+	if (g_hash_table_lookup (watch->dirs, path)) {
+		return TRUE;
+	}
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (watch->fd != -1) {
+		gchar *key;
+		gint wd;
+
+		wd = inotify_add_watch (watch->fd, path, UPDATER_INOTIFY_MASK);
+		if (wd < 0) {
+			g_printerr ("Unable to monitor '%s', %s\n", path,
+			            g_strerror (errno));
+			return FALSE;
+		}
+
+		key = g_strdup (path);
+		g_hash_table_insert (watch->dirs, key, GINT_TO_POINTER (wd));
+		g_hash_table_insert (watch->wds, GINT_TO_POINTER (wd), key);
+
+		return TRUE;
+	}
+#endif
+
+	file = g_file_new_for_path (path);
+	monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, &err);
+	g_object_unref (file);
+
+	if (err) {
+		g_printerr ("Unable to monitor '%s', %s\n", path, err->message);
+		g_error_free (err);
+		return FALSE;
+	}
+
+	g_signal_connect (monitor, "changed", (gpointer) on_directory_event, watch);
+
+	g_hash_table_insert (watch->dirs, g_strdup (path), monitor);
+
+	return TRUE;
+}
+
+static void
+updater_watch_drop (updater_watch_t *watch, const gchar *path)
+{
+	gpointer value;
+
+	value = g_hash_table_lookup (watch->dirs, path);
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (watch->fd != -1) {
+		/* fails harmlessly if the directory is already gone */
+		inotify_rm_watch (watch->fd, GPOINTER_TO_INT (value));
+		g_hash_table_remove (watch->wds, value);
+		g_hash_table_remove (watch->dirs, path);
+		return;
+	}
+#endif
+
+	g_file_monitor_cancel (G_FILE_MONITOR (value));
+	g_object_unref (value);
+	g_hash_table_remove (watch->dirs, path);
+}
+
+/**
+ * Stop watching a directory and everything below it.
+ *
+ * @returns FALSE if the directory wasn't being watched.
+ */
+gboolean
+updater_watch_remove (updater_watch_t *watch, const gchar *path)
+{
+	GHashTableIter iter;
+	GPtrArray *below;
+	gboolean ret;
+	gchar *prefix, *dir;
+	guint i;
+
+	g_return_val_if_fail (watch, FALSE);
+	g_return_val_if_fail (path, FALSE);
+
+	ret = g_hash_table_lookup (watch->dirs, path) != NULL;
+
+	prefix = g_strconcat (path, G_DIR_SEPARATOR_S, NULL);
+	below = g_ptr_array_new ();
+
+	g_hash_table_iter_init (&iter, watch->dirs);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &dir, NULL)) {
+		if (g_str_has_prefix (dir, prefix)) {
+			g_ptr_array_add (below, g_strdup (dir));
+		}
+	}
+
+	for (i = 0; i < below->len; i++) {
+		updater_watch_drop (watch, g_ptr_array_index (below, i));
+		g_free (g_ptr_array_index (below, i));
+	}
+
+	if (ret) {
+		updater_watch_drop (watch, path);
+	}
+
+	g_ptr_array_free (below, TRUE);
+	g_free (prefix);
+
+	return ret;
+}
+
+void
+updater_watch_clear (updater_watch_t *watch)
+{
+	GHashTableIter iter;
+	GPtrArray *all;
+	gchar *dir;
+	guint i;
+
+	g_return_if_fail (watch);
+
+	all = g_ptr_array_new ();
+
+	g_hash_table_iter_init (&iter, watch->dirs);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &dir, NULL)) {
+		g_ptr_array_add (all, g_strdup (dir));
+	}
+
+	for (i = 0; i < all->len; i++) {
+		updater_watch_drop (watch, g_ptr_array_index (all, i));
+		g_free (g_ptr_array_index (all, i));
+	}
+
+	g_ptr_array_free (all, TRUE);
+}
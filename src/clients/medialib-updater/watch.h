@@ -0,0 +1,42 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+#ifndef __UPDATER_WATCH_H__
+#define __UPDATER_WATCH_H__
+
+#include <glib.h>
+
+#include "pending.h"
+
+typedef struct updater_watch_St updater_watch_t;
+
+/**
+ * Called from the main loop for every change in a watched directory.
+ * Only directories and regular files are reported. A NULL path means
+ * events were lost and the watched directories should be rescanned.
+ */
+typedef void (*updater_watch_func_t) (gpointer udata, const gchar *path,
+                                      updater_event_t event, gboolean is_dir);
+
+updater_watch_t *updater_watch_new (updater_watch_func_t func, gpointer udata);
+void updater_watch_free (updater_watch_t *watch);
+
+const gchar *updater_watch_backend (updater_watch_t *watch);
+
+gboolean updater_watch_add (updater_watch_t *watch, const gchar *path);
+gboolean updater_watch_remove (updater_watch_t *watch, const gchar *path);
+void updater_watch_clear (updater_watch_t *watch);
+
+#endif
@@ -64,6 +64,8 @@
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_PICTURE_FRONT_MIME "picture_front_mime"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_STARTMS "startms"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_STOPMS "stopms"
+#define XMMS_MEDIALIB_ENTRY_PROPERTY_STARTFRAME "startframe"
+#define XMMS_MEDIALIB_ENTRY_PROPERTY_STOPFRAME "stopframe"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_STATUS "status"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_DESCRIPTION "description"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_GROUPING "grouping"
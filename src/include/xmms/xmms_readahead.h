@@ -0,0 +1,85 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_READAHEAD_H__
+#define __XMMS_READAHEAD_H__
+
+#include <glib.h>
+#include "xmms/xmms_error.h"
+#include "xmms/xmms_xformplugin.h"
+
+G_BEGIN_DECLS
+
+/**
+ * @defgroup ReadAhead ReadAhead
+ * @ingroup XForm
+ * @brief Background read-ahead for transports with slow reads.
+ *
+ * A transport hands its blocking read and seek functions to a
+ * read-ahead, which calls them from a thread of its own with
+ * large sequential reads into a bounded buffer. The xform's read
+ * and seek methods are then served from the buffer, and seeks that
+ * land inside it never reach the transport.
+ *
+ * The read and seek functions are only ever called from the
+ * read-ahead thread, one at a time.
+ * @{
+ */
+
+typedef struct xmms_readahead_St xmms_readahead_t;
+
+/**
+ * Read up to len bytes into buf.
+ * @returns number of bytes read, 0 on end of stream and -1 on error.
+ */
+typedef gint (*xmms_readahead_read_func_t) (gpointer udata, gpointer buf,
+                                            gint len, xmms_error_t *err);
+/**
+ * Seek the transport.
+ * @returns the new absolute offset, or -1 on error.
+ */
+typedef gint64 (*xmms_readahead_seek_func_t) (gpointer udata, gint64 offset,
+                                              xmms_xform_seek_mode_t whence,
+                                              xmms_error_t *err);
+
+xmms_readahead_t *xmms_readahead_new (xmms_readahead_read_func_t read_func,
+                                      xmms_readahead_seek_func_t seek_func,
+                                      gpointer udata, gint64 offset,
+                                      gint64 length, gint size);
+void xmms_readahead_free (xmms_readahead_t *ra);
+
+gint xmms_readahead_read (xmms_readahead_t *ra, gpointer buf, gint len,
+                          xmms_error_t *err);
+gint64 xmms_readahead_seek (xmms_readahead_t *ra, gint64 offset,
+                            xmms_xform_seek_mode_t whence, xmms_error_t *err);
+
+/**
+ * Get the counters of a read-ahead.
+ *
+ * @param reads number of reads done on the transport
+ * @param seeks number of seeks done on the transport
+ * @param buffered_seeks number of seeks served from the buffer
+ * @param stalls number of reads that had to wait for the transport
+ */
+void xmms_readahead_stats_get (xmms_readahead_t *ra, guint *reads,
+                               guint *seeks, guint *buffered_seeks,
+                               guint *stalls);
+
+/** @} */
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,49 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_STATS_H__
+#define __XMMS_STATS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * @defgroup Stats Stats
+ * @brief Counters shown by main.stats.
+ *
+ * Plugins can register counters of their own, registering a name
+ * twice gives the same counter. The update functions don't block
+ * but may allocate the first time a thread calls them, so a
+ * realtime thread should count in a variable of its own and let
+ * another thread add it up.
+ * @{
+ */
+
+typedef struct xmms_stats_counter_St xmms_stats_counter_t;
+
+xmms_stats_counter_t *xmms_stats_counter_register (const gchar *name);
+void xmms_stats_counter_add (xmms_stats_counter_t *counter, gint64 n);
+void xmms_stats_counter_set (xmms_stats_counter_t *counter, gint64 value);
+gint64 xmms_stats_counter_get (xmms_stats_counter_t *counter);
+
+#define xmms_stats_counter_inc(c) xmms_stats_counter_add ((c), 1)
+
+/** @} */
+
+G_END_DECLS
+
+#endif
@@ -50,6 +50,7 @@ typedef enum {
 	XMMS_IPC_SIGNAL_QUIT,
 	XMMS_IPC_SIGNAL_MEDIAINFO_READER_STATUS,
 	XMMS_IPC_SIGNAL_MEDIAINFO_READER_UNINDEXED,
+	XMMS_IPC_SIGNAL_MAIN_STATS,
 	XMMS_IPC_SIGNAL_END
 } xmms_ipc_signals_t;
 
@@ -158,7 +159,8 @@ typedef enum {
 	XMMS_IPC_CMD_GET_DATA = XMMS_IPC_CMD_FIRST,
 	XMMS_IPC_CMD_ADD_DATA,
 	XMMS_IPC_CMD_REMOVE_DATA,
-	XMMS_IPC_CMD_LIST_DATA
+	XMMS_IPC_CMD_LIST_DATA,
+	XMMS_IPC_CMD_STATS_DATA
 } xmms_ipc_bindata_cmds_t;
 
 /* visualization methods */
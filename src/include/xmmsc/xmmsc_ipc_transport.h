@@ -19,18 +19,47 @@
 #define XMMS_IPC_TRANSPORT_H
 
 #include "xmmsc/xmmsc_stdint.h"
+#include "xmmsc/xmmsc_stdbool.h"
 #include "xmmsc/xmmsc_sockets.h"
 
 typedef struct xmms_ipc_transport_St xmms_ipc_transport_t;
 
+/* Size of the buffer incoming data is read into */
+#define XMMS_IPC_TRANSPORT_READ_BUFFER_SIZE 16384
+
+/* Most buffers handed to a single gathered write */
+#define XMMS_IPC_TRANSPORT_MAX_IOVEC 64
+
+typedef struct xmms_ipc_iovec_St {
+	char *base;
+	int len;
+} xmms_ipc_iovec_t;
+
+/* Per-connection traffic counters */
+typedef struct xmms_ipc_transport_stats_St {
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t msgs_in;
+	uint64_t msgs_out;
+	uint64_t read_calls;
+	uint64_t write_calls;
+} xmms_ipc_transport_stats_t;
+
 typedef int (*xmms_ipc_read_func) (xmms_ipc_transport_t *, char *, int);
 typedef int (*xmms_ipc_write_func) (xmms_ipc_transport_t *, char *, int);
+typedef int (*xmms_ipc_writev_func) (xmms_ipc_transport_t *, xmms_ipc_iovec_t *, int);
 typedef xmms_ipc_transport_t *(*xmms_ipc_accept_func) (xmms_ipc_transport_t *);
 typedef void (*xmms_ipc_destroy_func) (xmms_ipc_transport_t *);
+typedef bool (*xmms_ipc_write_blocked_func) (xmms_ipc_transport_t *);
 
 void xmms_ipc_transport_destroy (xmms_ipc_transport_t *ipct);
 int xmms_ipc_transport_read (xmms_ipc_transport_t *ipct, char *buffer, int len);
 int xmms_ipc_transport_write (xmms_ipc_transport_t *ipct, char *buffer, int len);
+int xmms_ipc_transport_writev (xmms_ipc_transport_t *ipct, xmms_ipc_iovec_t *iov, int count);
+int xmms_ipc_transport_read_buffered (xmms_ipc_transport_t *ipct, char **data, int len);
+bool xmms_ipc_transport_read_pending (xmms_ipc_transport_t *ipct);
+bool xmms_ipc_transport_write_blocked (xmms_ipc_transport_t *ipct);
+void xmms_ipc_transport_stats_get (xmms_ipc_transport_t *ipct, xmms_ipc_transport_stats_t *stats);
 xmms_socket_t xmms_ipc_transport_fd_get (xmms_ipc_transport_t *ipct);
 xmms_ipc_transport_t * xmms_ipc_server_accept (xmms_ipc_transport_t *ipct);
 xmms_ipc_transport_t * xmms_ipc_client_init (const char *path);
@@ -46,8 +75,17 @@ struct xmms_ipc_transport_St {
 
 	xmms_ipc_accept_func accept_func;
 	xmms_ipc_write_func write_func;
+	xmms_ipc_writev_func writev_func;
 	xmms_ipc_read_func read_func;
 	xmms_ipc_destroy_func destroy_func;
+	xmms_ipc_write_blocked_func write_blocked_func;
+
+	/* data read from the socket but not yet consumed */
+	char *read_buffer;
+	int read_pos;
+	int read_len;
+
+	xmms_ipc_transport_stats_t stats;
 };
 
 #endif
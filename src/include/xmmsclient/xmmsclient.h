@@ -177,6 +177,7 @@ xmmsc_result_t *xmmsc_main_list_plugins (xmmsc_connection_t *c, xmms_plugin_type
 xmmsc_result_t *xmmsc_main_stats (xmmsc_connection_t *c);
 
 /* broadcasts */
+xmmsc_result_t *xmmsc_broadcast_main_stats (xmmsc_connection_t *c);
 xmmsc_result_t *xmmsc_broadcast_mediainfo_reader_status (xmmsc_connection_t *c);
 
 /* signals */
@@ -253,6 +254,7 @@ xmmsc_result_t *xmmsc_bindata_add (xmmsc_connection_t *c, const unsigned char *d
 xmmsc_result_t *xmmsc_bindata_retrieve (xmmsc_connection_t *c, const char *hash);
 xmmsc_result_t *xmmsc_bindata_remove (xmmsc_connection_t *c, const char *hash);
 xmmsc_result_t *xmmsc_bindata_list (xmmsc_connection_t *c);
+xmmsc_result_t *xmmsc_bindata_stats (xmmsc_connection_t *c);
 
 /* broadcasts */
 xmmsc_result_t *xmmsc_broadcast_medialib_entry_changed (xmmsc_connection_t *c);
@@ -0,0 +1,37 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_COLLINDEX_H__
+#define __XMMS_COLLINDEX_H__
+
+#include "xmmspriv/xmms_collection.h"
+#include "xmms/xmms_medialib.h"
+
+void xmms_coll_index_init (void);
+void xmms_coll_index_shutdown (void);
+
+gboolean xmms_coll_index_contains (xmmsv_coll_t *coll, xmms_medialib_entry_t mid);
+void xmms_coll_index_add (xmmsv_coll_t *coll, xmms_medialib_entry_t mid);
+void xmms_coll_index_remove (xmmsv_coll_t *coll, xmms_medialib_entry_t mid);
+void xmms_coll_index_invalidate (xmmsv_coll_t *coll);
+
+gint xmms_coll_index_filter_lookup (xmmsv_coll_t *coll, xmms_medialib_entry_t mid);
+void xmms_coll_index_filter_store (xmmsv_coll_t *coll, xmms_medialib_entry_t mid, guint32 stamp, gboolean match);
+
+void xmms_coll_index_schedule_prune (void);
+void xmms_coll_index_prune (xmms_coll_dag_t *dag);
+
+#endif
@@ -20,13 +20,6 @@
 #include <glib.h>
 
 
-/*
- * Public definitions
- */
-
-#define XMMS_COLLSERIAL_ATTR_ID  "_serialized_id"
-
-
 /*
  * Private defintions
  */
@@ -41,6 +34,7 @@
 
 void xmms_collection_dag_restore (xmms_coll_dag_t *dag);
 void xmms_collection_dag_save (xmms_coll_dag_t *dag);
+void xmms_collection_dag_forget (void);
 
 
 #endif
@@ -0,0 +1,50 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_MAGIC_H__
+#define __XMMS_PRIV_MAGIC_H__
+
+#include <stdarg.h>
+#include <glib.h>
+
+typedef struct xmms_magic_set_St xmms_magic_set_t;
+
+/**
+ * Fetch the first len bytes of the data being identified into buf,
+ * returning how many bytes were available or -1 on error.
+ */
+typedef gint (*xmms_magic_read_func_t) (gpointer udata, gchar *buf, guint len);
+
+typedef struct xmms_magic_checker_St {
+	xmms_magic_read_func_t read_func;
+	gpointer udata;
+	gchar *buf;
+	guint alloc;
+	guint read;
+} xmms_magic_checker_t;
+
+xmms_magic_set_t *xmms_magic_set_new (void);
+void xmms_magic_set_free (xmms_magic_set_t *set);
+gboolean xmms_magic_set_add (xmms_magic_set_t *set, const gchar *desc, const gchar *mime, ...);
+gboolean xmms_magic_set_add_valist (xmms_magic_set_t *set, const gchar *desc, const gchar *mime, va_list ap);
+
+const gchar *xmms_magic_set_match (xmms_magic_set_t *set, xmms_magic_checker_t *c, const gchar **desc);
+const gchar *xmms_magic_set_match_linear (xmms_magic_set_t *set, xmms_magic_checker_t *c, const gchar **desc);
+
+void xmms_magic_checker_init (xmms_magic_checker_t *c, xmms_magic_read_func_t func, gpointer udata);
+void xmms_magic_checker_clear (xmms_magic_checker_t *c);
+
+#endif
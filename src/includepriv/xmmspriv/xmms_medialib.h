@@ -42,6 +42,8 @@ gboolean xmms_medialib_check_id (xmms_medialib_entry_t entry);
 
 gboolean xmms_medialib_entry_property_set_str_source (xmms_medialib_session_t *session, xmms_medialib_entry_t entry, const gchar *property, const gchar *value, guint32 source);
 gboolean xmms_medialib_entry_property_set_int_source (xmms_medialib_session_t *session, xmms_medialib_entry_t entry, const gchar *property, gint value, guint32 source);
+void xmms_medialib_property_changed (const gchar *property);
+guint32 xmms_medialib_property_stamp (const gchar *property);
 guint32 xmms_medialib_source_to_id (xmms_medialib_session_t *session, const gchar *source);
 void xmms_medialib_add_recursive (xmms_medialib_t *medialib, const gchar *playlist, const gchar *path, xmms_error_t *error);
 void xmms_medialib_insert_recursive (xmms_medialib_t *medialib, const gchar *playlist, gint32 pos, const gchar *path, xmms_error_t *error);
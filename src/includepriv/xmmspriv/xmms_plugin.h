@@ -44,6 +44,7 @@ typedef struct xmms_plugin_St {
 gboolean xmms_plugin_init (const gchar *path);
 void xmms_plugin_shutdown (void);
 void xmms_plugin_destroy (xmms_plugin_t *plugin);
+gboolean xmms_plugin_load (const xmms_plugin_desc_t *desc, GModule *module);
 
 typedef gboolean (*xmms_plugin_foreach_func_t)(xmms_plugin_t *, gpointer);
 void xmms_plugin_foreach (xmms_plugin_type_t type, xmms_plugin_foreach_func_t func, gpointer user_data);
@@ -34,6 +34,7 @@ gboolean xmms_sqlite_query_table (sqlite3 *sql, xmms_medialib_row_table_method_t
 gboolean xmms_sqlite_exec (sqlite3 *sql, const char *query, ...);
 void xmms_sqlite_close (sqlite3 *sql);
 void xmms_sqlite_print_version (void);
+gboolean xmms_sqlite_text_indexed (const gchar *key);
 gchar *sqlite_prepare_string (const gchar *input);
 
 #endif
@@ -0,0 +1,42 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_STATS_H__
+#define __XMMS_PRIV_STATS_H__
+
+#include <glib.h>
+
+#include "xmmsc/xmmsv.h"
+#include "xmms/xmms_stats.h"
+
+typedef struct xmms_stats_histogram_St xmms_stats_histogram_t;
+
+typedef void (*xmms_stats_foreach_func_t) (const gchar *name, xmmsv_t *value, gpointer udata);
+
+void xmms_stats_init (void);
+void xmms_stats_shutdown (void);
+
+xmms_stats_histogram_t *xmms_stats_histogram_register (const gchar *name);
+void xmms_stats_histogram_add (xmms_stats_histogram_t *hist, gint64 usec);
+gint64 xmms_stats_histogram_count (xmms_stats_histogram_t *hist);
+gint64 xmms_stats_histogram_percentile (xmms_stats_histogram_t *hist, gint percent);
+
+gint64 xmms_stats_time (void);
+void xmms_stats_histogram_add_since (xmms_stats_histogram_t *hist, gint64 start);
+
+void xmms_stats_foreach (xmms_stats_foreach_func_t func, gpointer udata);
+
+#endif
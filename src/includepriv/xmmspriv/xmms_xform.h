@@ -25,6 +25,8 @@
 typedef struct xmms_xform_object_St xmms_xform_object_t;
 
 xmms_xform_object_t *xmms_xform_object_init (void);
+void xmms_xform_route_cache_invalidate (void);
+void xmms_xform_route_stats_get (guint *hits, guint *misses, guint *saved_ms);
 
 xmms_xform_t *xmms_xform_new (xmms_xform_plugin_t *plugin, xmms_xform_t *prev, xmms_medialib_entry_t entry, GList *goal_hints);
 const gchar *xmms_xform_outtype_get_str (xmms_xform_t *xform, xmms_stream_type_key_t key);
@@ -36,6 +38,8 @@ gboolean xmms_xform_plugin_verify (xmms_plugin_t *plugin);
 
 xmms_xform_t *xmms_xform_chain_setup (xmms_medialib_entry_t entry, GList *goal_formats, gboolean rehash);
 xmms_xform_t *xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats, gboolean rehash);
+void xmms_xform_chain_park (xmms_xform_t *xform, gint64 position);
+gint64 xmms_xform_chain_resumed_at (xmms_xform_t *xform);
 
 gint64 xmms_xform_this_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *err);
 int xmms_xform_this_read (xmms_xform_t *xform, gpointer buf, int siz, xmms_error_t *err);
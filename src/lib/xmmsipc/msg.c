@@ -181,40 +181,77 @@ xmms_ipc_msg_write_transport (xmms_ipc_msg_t *msg,
                               xmms_ipc_transport_t *transport,
                               bool *disconnected)
 {
-	char *buf;
-	unsigned int ret, len;
-
 	x_return_val_if_fail (msg, false);
-	x_return_val_if_fail (transport, false);
 
-	xmmsv_bitbuffer_align (msg->bb);
+	return xmms_ipc_msg_write_transport_many (&msg, 1, transport,
+	                                          disconnected) == 1;
+}
+
+/**
+ * Try to write a number of queued messages to transport with a single
+ * gathered write. Like #xmms_ipc_msg_write_transport, a message that
+ * only got partially written keeps track of how far it got.
+ *
+ * @returns the number of messages, counted from the first one, that
+ *          have been fully written. disconnected is set if transport
+ *          was disconnected.
+ */
+int
+xmms_ipc_msg_write_transport_many (xmms_ipc_msg_t **msgs, int count,
+                                   xmms_ipc_transport_t *transport,
+                                   bool *disconnected)
+{
+	xmms_ipc_iovec_t iov[XMMS_IPC_TRANSPORT_MAX_IOVEC];
+	unsigned int len;
+	int i, ret, done;
+
+	x_return_val_if_fail (msgs, 0);
+	x_return_val_if_fail (transport, 0);
+
+	count = MIN (count, XMMS_IPC_TRANSPORT_MAX_IOVEC);
 
-	len = xmmsv_bitbuffer_len (msg->bb) / 8;
+	for (i = 0; i < count; i++) {
+		xmmsv_bitbuffer_align (msgs[i]->bb);
 
-	x_return_val_if_fail (len > msg->xfered, true);
+		len = xmmsv_bitbuffer_len (msgs[i]->bb) / 8;
 
-	buf = (char *) (xmmsv_bitbuffer_buffer (msg->bb) + msg->xfered);
-	ret = xmms_ipc_transport_write (transport, buf, len - msg->xfered);
+		x_return_val_if_fail (len >= msgs[i]->xfered, i);
+
+		iov[i].base = (char *) (xmmsv_bitbuffer_buffer (msgs[i]->bb) + msgs[i]->xfered);
+		iov[i].len = len - msgs[i]->xfered;
+	}
+
+	ret = xmms_ipc_transport_writev (transport, iov, count);
 
 	if (ret == SOCKET_ERROR) {
 		if (xmms_socket_error_recoverable ()) {
-			return false;
+			return 0;
 		}
 
 		if (disconnected) {
 			*disconnected = true;
 		}
 
-		return false;
+		return 0;
 	} else if (!ret) {
 		if (disconnected) {
 			*disconnected = true;
 		}
-	} else {
-		msg->xfered += ret;
+
+		return 0;
 	}
 
-	return (len == msg->xfered);
+	for (done = 0; done < count && ret >= iov[done].len; done++) {
+		ret -= iov[done].len;
+		msgs[done]->xfered += iov[done].len;
+		transport->stats.msgs_out++;
+	}
+
+	if (done < count) {
+		msgs[done]->xfered += ret;
+	}
+
+	return done;
 }
 
 /**
@@ -227,8 +264,9 @@ xmms_ipc_msg_read_transport (xmms_ipc_msg_t *msg,
                              xmms_ipc_transport_t *transport,
                              bool *disconnected)
 {
-	char buf[512];
-	unsigned int ret, len, rlen;
+	char *buf;
+	unsigned int len, rlen;
+	int ret;
 
 	x_return_val_if_fail (msg, false);
 	x_return_val_if_fail (transport, false);
@@ -240,6 +278,7 @@ xmms_ipc_msg_read_transport (xmms_ipc_msg_t *msg,
 			len += xmms_ipc_msg_get_length (msg);
 
 			if (msg->xfered == len) {
+				transport->stats.msgs_in++;
 				return true;
 			}
 		}
@@ -247,10 +286,8 @@ xmms_ipc_msg_read_transport (xmms_ipc_msg_t *msg,
 		x_return_val_if_fail (msg->xfered < len, false);
 
 		rlen = len - msg->xfered;
-		if (rlen > sizeof (buf))
-			rlen = sizeof (buf);
 
-		ret = xmms_ipc_transport_read (transport, buf, rlen);
+		ret = xmms_ipc_transport_read_buffered (transport, &buf, rlen);
 
 		if (ret == SOCKET_ERROR) {
 			if (xmms_socket_error_recoverable ()) {
@@ -0,0 +1,532 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ * Shared memory transport, used for shm:// paths.
+ *
+ * Clients connect to a unix socket just like unix:// clients do. On
+ * accept the server creates a memfd holding two single producer,
+ * single consumer ring buffers, one per direction, and passes it to
+ * the client over the socket.
+ *
+ * From then on messages are copied straight into the rings. The socket
+ * stays open and is the descriptor the mainloops poll: a reader that
+ * found its ring empty flags itself as waiting, and the next writer
+ * sends it a single byte to wake it up. The other way around, a writer
+ * that found the ring full flags it as such and waits for input, and
+ * the reader sends it a byte once it has made room. A peer that goes
+ * away shows up as a hangup on that same descriptor.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include "xmmsc/xmmsc_ipc_transport.h"
+#include "xmmsc/xmmsc_util.h"
+#include "url.h"
+#include "socket_unix.h"
+#include "socket_shm.h"
+
+#define XMMS_IPC_SHM_MAGIC 0x584d5332 /* "XMS2" */
+
+/* Bytes per direction, must be a power of two */
+#define XMMS_IPC_SHM_RING_SIZE (1024 * 1024)
+
+/* Keep producer and consumer owned fields on separate cache lines */
+typedef struct xmms_ipc_shm_ring_St {
+	uint32_t head; /* only written by the producer */
+	uint32_t full; /* producer waits for the consumer to make room */
+	char pad1[56];
+	uint32_t tail; /* only written by the consumer */
+	uint32_t waiting; /* consumer waits for the doorbell */
+	char pad2[56];
+} xmms_ipc_shm_ring_t;
+
+typedef struct xmms_ipc_shm_header_St {
+	uint32_t magic;
+	uint32_t ring_size;
+	char pad[56];
+	/* 0 is server to client, 1 is client to server */
+	xmms_ipc_shm_ring_t rings[2];
+} xmms_ipc_shm_header_t;
+
+typedef struct xmms_ipc_shm_St {
+	void *map;
+	size_t map_size;
+	uint32_t size;
+
+	xmms_ipc_shm_ring_t *in;
+	char *in_data;
+
+	xmms_ipc_shm_ring_t *out;
+	char *out_data;
+} xmms_ipc_shm_t;
+
+static size_t
+xmms_ipc_shm_map_size (uint32_t ring_size)
+{
+	return sizeof (xmms_ipc_shm_header_t) + 2 * (size_t) ring_size;
+}
+
+static xmms_ipc_shm_t *
+xmms_ipc_shm_map (int memfd, bool server)
+{
+	xmms_ipc_shm_header_t *header;
+	xmms_ipc_shm_t *shm;
+	struct stat st;
+	void *map;
+	int in, out;
+
+	if (fstat (memfd, &st) == -1 ||
+	    st.st_size < (off_t) sizeof (xmms_ipc_shm_header_t)) {
+		return NULL;
+	}
+
+	map = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+
+	header = map;
+	if (header->magic != XMMS_IPC_SHM_MAGIC ||
+	    xmms_ipc_shm_map_size (header->ring_size) != (size_t) st.st_size) {
+		munmap (map, st.st_size);
+		return NULL;
+	}
+
+	in = server ? 1 : 0;
+	out = server ? 0 : 1;
+
+	shm = x_new0 (xmms_ipc_shm_t, 1);
+	shm->map = map;
+	shm->map_size = st.st_size;
+	shm->size = header->ring_size;
+	shm->in = &header->rings[in];
+	shm->in_data = (char *) (header + 1) + in * (size_t) header->ring_size;
+	shm->out = &header->rings[out];
+	shm->out_data = (char *) (header + 1) + out * (size_t) header->ring_size;
+
+	return shm;
+}
+
+/**
+ * Eat pending doorbell bytes.
+ *
+ * @returns false if the peer has gone away.
+ */
+static bool
+xmms_ipc_shm_drain (int fd)
+{
+	char buf[64];
+	int ret;
+
+	while ((ret = recv (fd, buf, sizeof (buf), MSG_DONTWAIT)) > 0);
+
+	if (ret == 0) {
+		return false;
+	}
+
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+static int
+xmms_ipc_shm_read (xmms_ipc_transport_t *ipct, char *buffer, int len)
+{
+	xmms_ipc_shm_t *shm;
+	uint32_t head, tail, avail, off, first;
+
+	x_return_val_if_fail (ipct, -1);
+	x_return_val_if_fail (buffer, -1);
+
+	shm = ipct->data;
+
+	tail = shm->in->tail;
+	head = __atomic_load_n (&shm->in->head, __ATOMIC_ACQUIRE);
+	avail = head - tail;
+
+	if (!avail) {
+		bool alive = xmms_ipc_shm_drain (ipct->fd);
+
+		/* Pairs with the fence in xmms_ipc_shm_writev, either
+		 * we see the new data or the writer sees us waiting. A
+		 * peer may also have written its last data right before
+		 * closing, so look again before reporting the hangup. */
+		__atomic_store_n (&shm->in->waiting, 1, __ATOMIC_SEQ_CST);
+		head = __atomic_load_n (&shm->in->head, __ATOMIC_SEQ_CST);
+		avail = head - tail;
+
+		if (!avail) {
+			if (!alive) {
+				return 0;
+			}
+			errno = EAGAIN;
+			return -1;
+		}
+
+		__atomic_store_n (&shm->in->waiting, 0, __ATOMIC_RELAXED);
+	}
+
+	if (avail > (uint32_t) len) {
+		avail = len;
+	}
+
+	off = tail & (shm->size - 1);
+	first = MIN (avail, shm->size - off);
+
+	memcpy (buffer, shm->in_data + off, first);
+	memcpy (buffer + first, shm->in_data, avail - first);
+
+	__atomic_store_n (&shm->in->tail, tail + avail, __ATOMIC_RELEASE);
+	__atomic_thread_fence (__ATOMIC_SEQ_CST);
+
+	if (__atomic_exchange_n (&shm->in->full, 0, __ATOMIC_SEQ_CST)) {
+		send (ipct->fd, "", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+	}
+
+	return avail;
+}
+
+static int
+xmms_ipc_shm_writev (xmms_ipc_transport_t *ipct, xmms_ipc_iovec_t *iov, int count)
+{
+	xmms_ipc_shm_t *shm;
+	uint32_t head, tail, space, written = 0;
+	int i;
+
+	x_return_val_if_fail (ipct, -1);
+	x_return_val_if_fail (iov, -1);
+
+	shm = ipct->data;
+
+	head = shm->out->head;
+	tail = __atomic_load_n (&shm->out->tail, __ATOMIC_ACQUIRE);
+	space = shm->size - (head - tail);
+
+	if (!space) {
+		/* Pairs with the fence in xmms_ipc_shm_read, either we
+		 * see the room it made or it sees us waiting. */
+		__atomic_store_n (&shm->out->full, 1, __ATOMIC_SEQ_CST);
+		tail = __atomic_load_n (&shm->out->tail, __ATOMIC_SEQ_CST);
+		space = shm->size - (head - tail);
+
+		if (!space) {
+			errno = EAGAIN;
+			return -1;
+		}
+
+		__atomic_store_n (&shm->out->full, 0, __ATOMIC_RELAXED);
+	}
+
+	for (i = 0; i < count && space; i++) {
+		uint32_t n, off, first;
+
+		n = MIN ((uint32_t) iov[i].len, space);
+		off = (head + written) & (shm->size - 1);
+		first = MIN (n, shm->size - off);
+
+		memcpy (shm->out_data + off, iov[i].base, first);
+		memcpy (shm->out_data, iov[i].base + first, n - first);
+
+		written += n;
+		space -= n;
+	}
+
+	if (!written) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	__atomic_store_n (&shm->out->head, head + written, __ATOMIC_RELEASE);
+	__atomic_thread_fence (__ATOMIC_SEQ_CST);
+
+	if (__atomic_exchange_n (&shm->out->waiting, 0, __ATOMIC_SEQ_CST)) {
+		/* A full socket buffer means the reader has a wakeup
+		 * pending already, so a failure here is harmless. */
+		send (ipct->fd, "", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+	}
+
+	return written;
+}
+
+static int
+xmms_ipc_shm_write (xmms_ipc_transport_t *ipct, char *buffer, int len)
+{
+	xmms_ipc_iovec_t iov;
+
+	iov.base = buffer;
+	iov.len = len;
+
+	return xmms_ipc_shm_writev (ipct, &iov, 1);
+}
+
+static bool
+xmms_ipc_shm_write_blocked (xmms_ipc_transport_t *ipct)
+{
+	xmms_ipc_shm_t *shm = ipct->data;
+
+	return __atomic_load_n (&shm->out->full, __ATOMIC_ACQUIRE);
+}
+
+static void
+xmms_ipc_shm_destroy (xmms_ipc_transport_t *ipct)
+{
+	xmms_ipc_shm_t *shm = ipct->data;
+
+	if (shm) {
+		munmap (shm->map, shm->map_size);
+		free (shm);
+	}
+
+	free (ipct->path);
+	close (ipct->fd);
+}
+
+static int
+xmms_ipc_shm_create (void)
+{
+	xmms_ipc_shm_header_t *header;
+	size_t size;
+	int memfd;
+
+	memfd = memfd_create ("xmms2-ipc", MFD_CLOEXEC);
+	if (memfd == -1) {
+		return -1;
+	}
+
+	size = xmms_ipc_shm_map_size (XMMS_IPC_SHM_RING_SIZE);
+	if (ftruncate (memfd, size) == -1) {
+		close (memfd);
+		return -1;
+	}
+
+	header = mmap (NULL, sizeof (*header), PROT_READ | PROT_WRITE,
+	               MAP_SHARED, memfd, 0);
+	if (header == MAP_FAILED) {
+		close (memfd);
+		return -1;
+	}
+
+	header->ring_size = XMMS_IPC_SHM_RING_SIZE;
+	header->magic = XMMS_IPC_SHM_MAGIC;
+
+	/* Neither side has read yet, both wait for the socket to tell
+	 * them about the first message */
+	header->rings[0].waiting = 1;
+	header->rings[1].waiting = 1;
+
+	munmap (header, sizeof (*header));
+
+	return memfd;
+}
+
+static bool
+xmms_ipc_shm_send_fd (int fd, int memfd)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char control[CMSG_SPACE (sizeof (int))];
+	char byte = 0;
+
+	memset (&msg, 0, sizeof (msg));
+	memset (control, 0, sizeof (control));
+
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof (control);
+
+	cmsg = CMSG_FIRSTHDR (&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN (sizeof (int));
+	memcpy (CMSG_DATA (cmsg), &memfd, sizeof (int));
+
+	return sendmsg (fd, &msg, MSG_NOSIGNAL) == 1;
+}
+
+static int
+xmms_ipc_shm_recv_fd (int fd)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char control[CMSG_SPACE (sizeof (int))];
+	char byte;
+	int memfd = -1;
+
+	memset (&msg, 0, sizeof (msg));
+
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof (control);
+
+	if (recvmsg (fd, &msg, MSG_CMSG_CLOEXEC) != 1) {
+		return -1;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+			memcpy (&memfd, CMSG_DATA (cmsg), sizeof (int));
+		}
+	}
+
+	return memfd;
+}
+
+static xmms_ipc_transport_t *
+xmms_ipc_shm_transport_new (int fd, xmms_ipc_shm_t *shm)
+{
+	xmms_ipc_transport_t *ipct;
+
+	ipct = x_new0 (xmms_ipc_transport_t, 1);
+	ipct->fd = fd;
+	ipct->data = shm;
+	ipct->read_func = xmms_ipc_shm_read;
+	ipct->write_func = xmms_ipc_shm_write;
+	ipct->writev_func = xmms_ipc_shm_writev;
+	ipct->destroy_func = xmms_ipc_shm_destroy;
+	ipct->write_blocked_func = xmms_ipc_shm_write_blocked;
+
+	return ipct;
+}
+
+xmms_ipc_transport_t *
+xmms_ipc_shm_client_init (const xmms_url_t *url)
+{
+	xmms_ipc_transport_t *ipct;
+	xmms_ipc_shm_t *shm;
+	struct sockaddr_un saddr;
+	int fd, memfd, flags;
+
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		return NULL;
+	}
+
+	saddr.sun_family = AF_UNIX;
+	snprintf (saddr.sun_path, sizeof (saddr.sun_path), "/%s", url->path);
+
+	if (connect (fd, (struct sockaddr *) &saddr, sizeof (saddr)) == -1) {
+		close (fd);
+		return NULL;
+	}
+
+	/* The socket is still blocking, so this waits for the server */
+	memfd = xmms_ipc_shm_recv_fd (fd);
+	if (memfd == -1) {
+		close (fd);
+		return NULL;
+	}
+
+	shm = xmms_ipc_shm_map (memfd, false);
+	close (memfd);
+
+	if (!shm) {
+		close (fd);
+		return NULL;
+	}
+
+	flags = fcntl (fd, F_GETFL, 0);
+	if (flags == -1 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		munmap (shm->map, shm->map_size);
+		free (shm);
+		close (fd);
+		return NULL;
+	}
+
+	ipct = xmms_ipc_shm_transport_new (fd, shm);
+	ipct->path = strdup (url->path);
+
+	return ipct;
+}
+
+static xmms_ipc_transport_t *
+xmms_ipc_shm_accept (xmms_ipc_transport_t *transport)
+{
+	xmms_ipc_shm_t *shm;
+	int fd, memfd, flags;
+
+	x_return_val_if_fail (transport, NULL);
+
+	fd = accept (transport->fd, NULL, NULL);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	memfd = xmms_ipc_shm_create ();
+	if (memfd == -1) {
+		close (fd);
+		return NULL;
+	}
+
+	shm = xmms_ipc_shm_map (memfd, true);
+	if (!shm || !xmms_ipc_shm_send_fd (fd, memfd)) {
+		if (shm) {
+			munmap (shm->map, shm->map_size);
+			free (shm);
+		}
+		close (memfd);
+		close (fd);
+		return NULL;
+	}
+
+	close (memfd);
+
+	flags = fcntl (fd, F_GETFL, 0);
+	if (flags == -1 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		munmap (shm->map, shm->map_size);
+		free (shm);
+		close (fd);
+		return NULL;
+	}
+
+	return xmms_ipc_shm_transport_new (fd, shm);
+}
+
+xmms_ipc_transport_t *
+xmms_ipc_shm_server_init (const xmms_url_t *url)
+{
+	xmms_ipc_transport_t *ipct;
+
+	/* Listening works exactly like for unix sockets */
+	ipct = xmms_ipc_usocket_server_init (url);
+	if (!ipct) {
+		return NULL;
+	}
+
+	ipct->accept_func = xmms_ipc_shm_accept;
+
+	return ipct;
+}
@@ -20,6 +20,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
@@ -68,6 +69,28 @@ xmms_ipc_usocket_write (xmms_ipc_transport_t *ipct, char *buffer, int len)
 
 }
 
+static int
+xmms_ipc_usocket_writev (xmms_ipc_transport_t *ipct,
+                         xmms_ipc_iovec_t *iov, int count)
+{
+	struct iovec vec[XMMS_IPC_TRANSPORT_MAX_IOVEC];
+	int i;
+
+	x_return_val_if_fail (ipct, -1);
+	x_return_val_if_fail (iov, -1);
+
+	if (count > XMMS_IPC_TRANSPORT_MAX_IOVEC) {
+		count = XMMS_IPC_TRANSPORT_MAX_IOVEC;
+	}
+
+	for (i = 0; i < count; i++) {
+		vec[i].iov_base = iov[i].base;
+		vec[i].iov_len = iov[i].len;
+	}
+
+	return writev (ipct->fd, vec, count);
+}
+
 xmms_ipc_transport_t *
 xmms_ipc_usocket_client_init (const xmms_url_t *url)
 {
@@ -110,6 +133,7 @@ xmms_ipc_usocket_client_init (const xmms_url_t *url)
 	ipct->path = strdup (url->path);
 	ipct->read_func = xmms_ipc_usocket_read;
 	ipct->write_func = xmms_ipc_usocket_write;
+	ipct->writev_func = xmms_ipc_usocket_writev;
 	ipct->destroy_func = xmms_ipc_usocket_destroy;
 
 	return ipct;
@@ -151,6 +175,7 @@ xmms_ipc_usocket_accept (xmms_ipc_transport_t *transport)
 		ret->fd = fd;
 		ret->read_func = xmms_ipc_usocket_read;
 		ret->write_func = xmms_ipc_usocket_write;
+		ret->writev_func = xmms_ipc_usocket_writev;
 		ret->destroy_func = xmms_ipc_usocket_destroy;
 
 		return ret;
@@ -213,6 +238,7 @@ xmms_ipc_usocket_server_init (const xmms_url_t *url)
 	ipct->path = strdup (url->path);
 	ipct->read_func = xmms_ipc_usocket_read;
 	ipct->write_func = xmms_ipc_usocket_write;
+	ipct->writev_func = xmms_ipc_usocket_writev;
 	ipct->accept_func = xmms_ipc_usocket_accept;
 	ipct->destroy_func = xmms_ipc_usocket_destroy;
 
@@ -30,19 +30,160 @@ xmms_ipc_transport_destroy (xmms_ipc_transport_t *ipct)
 
 	ipct->destroy_func (ipct);
 
+	free (ipct->read_buffer);
 	free (ipct);
 }
 
 int
 xmms_ipc_transport_read (xmms_ipc_transport_t *ipct, char *buffer, int len)
 {
-	return ipct->read_func (ipct, buffer, len);
+	int ret;
+
+	ret = ipct->read_func (ipct, buffer, len);
+
+	ipct->stats.read_calls++;
+	if (ret > 0) {
+		ipct->stats.bytes_in += ret;
+	}
+
+	return ret;
 }
 
 int
 xmms_ipc_transport_write (xmms_ipc_transport_t *ipct, char *buffer, int len)
 {
-	return ipct->write_func (ipct, buffer, len);
+	int ret;
+
+	ret = ipct->write_func (ipct, buffer, len);
+
+	ipct->stats.write_calls++;
+	if (ret > 0) {
+		ipct->stats.bytes_out += ret;
+	}
+
+	return ret;
+}
+
+/**
+ * Write several buffers in one go. Transports without support for
+ * gathered writes only get the first non-empty buffer written.
+ *
+ * @returns the number of bytes written, or SOCKET_ERROR.
+ */
+int
+xmms_ipc_transport_writev (xmms_ipc_transport_t *ipct,
+                           xmms_ipc_iovec_t *iov, int count)
+{
+	int i, ret;
+
+	x_return_val_if_fail (ipct, SOCKET_ERROR);
+	x_return_val_if_fail (iov, SOCKET_ERROR);
+
+	if (!ipct->writev_func) {
+		for (i = 0; i < count && !iov[i].len; i++);
+
+		if (i == count) {
+			return 0;
+		}
+
+		return xmms_ipc_transport_write (ipct, iov[i].base, iov[i].len);
+	}
+
+	ret = ipct->writev_func (ipct, iov, count);
+
+	ipct->stats.write_calls++;
+	if (ret > 0) {
+		ipct->stats.bytes_out += ret;
+	}
+
+	return ret;
+}
+
+/**
+ * Get at most len bytes of incoming data. When nothing is buffered, a
+ * single read fills the whole read buffer, so that several small
+ * messages can be picked up with one system call.
+ *
+ * @param data is set to point at the data, which stays valid until the
+ *             next read from the transport.
+ * @returns the number of bytes available at data, 0 on end of file or
+ *          SOCKET_ERROR.
+ */
+int
+xmms_ipc_transport_read_buffered (xmms_ipc_transport_t *ipct,
+                                  char **data, int len)
+{
+	int ret;
+
+	x_return_val_if_fail (ipct, SOCKET_ERROR);
+	x_return_val_if_fail (data, SOCKET_ERROR);
+
+	if (ipct->read_pos == ipct->read_len) {
+		if (!ipct->read_buffer) {
+			ipct->read_buffer = x_malloc (XMMS_IPC_TRANSPORT_READ_BUFFER_SIZE);
+			if (!ipct->read_buffer) {
+				x_oom ();
+				return SOCKET_ERROR;
+			}
+		}
+
+		ret = xmms_ipc_transport_read (ipct, ipct->read_buffer,
+		                               XMMS_IPC_TRANSPORT_READ_BUFFER_SIZE);
+		if (ret <= 0) {
+			return ret;
+		}
+
+		ipct->read_pos = 0;
+		ipct->read_len = ret;
+	}
+
+	ret = MIN (len, ipct->read_len - ipct->read_pos);
+
+	*data = ipct->read_buffer + ipct->read_pos;
+	ipct->read_pos += ret;
+
+	return ret;
+}
+
+/**
+ * Check if there is buffered input that has not been consumed yet.
+ * Such data will not make the socket readable, so anyone waiting for
+ * input with select or poll must check this first.
+ */
+bool
+xmms_ipc_transport_read_pending (xmms_ipc_transport_t *ipct)
+{
+	x_return_val_if_fail (ipct, false);
+
+	return ipct->read_pos < ipct->read_len;
+}
+
+/**
+ * Check if writing stopped because the peer has to read first, and
+ * not because the socket is full. The socket stays writable then, so
+ * anyone waiting to write must wait for input instead: the peer
+ * sends a byte once it has made room.
+ */
+bool
+xmms_ipc_transport_write_blocked (xmms_ipc_transport_t *ipct)
+{
+	x_return_val_if_fail (ipct, false);
+
+	if (!ipct->write_blocked_func) {
+		return false;
+	}
+
+	return ipct->write_blocked_func (ipct);
+}
+
+void
+xmms_ipc_transport_stats_get (xmms_ipc_transport_t *ipct,
+                              xmms_ipc_transport_stats_t *stats)
+{
+	x_return_if_fail (ipct);
+	x_return_if_fail (stats);
+
+	*stats = ipct->stats;
 }
 
 xmms_socket_t
@@ -1,7 +1,11 @@
 #include <stdlib.h>
+#include "xmms_configuration.h"
 #include "xmmsc/xmmsc_ipc_transport.h"
 #include "socket_unix.h"
 #include "socket_tcp.h"
+#ifdef HAVE_MEMFD_CREATE
+#include "socket_shm.h"
+#endif
 #include "xmmsc/xmmsc_stringport.h"
 #include "xmmsc/xmmsc_util.h"
 
@@ -20,6 +24,10 @@ xmms_ipc_client_init (const char *path)
 		transport = xmms_ipc_usocket_client_init (url);
 	} else if (!strcasecmp (url->protocol, "tcp")) {
 		transport = xmms_ipc_tcp_client_init (url, url->ipv6_host);
+#ifdef HAVE_MEMFD_CREATE
+	} else if (!strcasecmp (url->protocol, "shm")) {
+		transport = xmms_ipc_shm_client_init (url);
+#endif
 	}
 
 	free_url (url);
@@ -41,6 +49,10 @@ xmms_ipc_server_init (const char *path)
 		transport = xmms_ipc_usocket_server_init (url);
 	} else if (!strcasecmp (url->protocol, "tcp")) {
 		transport = xmms_ipc_tcp_server_init (url, url->ipv6_host);
+#ifdef HAVE_MEMFD_CREATE
+	} else if (!strcasecmp (url->protocol, "shm")) {
+		transport = xmms_ipc_shm_server_init (url);
+#endif
 	}
 
 	free_url (url);
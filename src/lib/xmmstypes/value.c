@@ -2552,6 +2552,15 @@ xmmsv_bitbuffer_get_bits (xmmsv_t *v, int bits, int *res)
 int
 xmmsv_bitbuffer_get_data (xmmsv_t *v, unsigned char *b, int len)
 {
+	int pos = v->value.bit.pos;
+
+	/* byte aligned, copy it all at once */
+	if (pos % 8 == 0 && len >= 0 && pos + len * 8 <= v->value.bit.len) {
+		memcpy (b, v->value.bit.buf + pos / 8, len);
+		v->value.bit.pos += len * 8;
+		return 1;
+	}
+
 	while (len) {
 		int t;
 		if (!xmmsv_bitbuffer_get_bits (v, 8, &t))
@@ -2621,6 +2630,32 @@ xmmsv_bitbuffer_put_bits_at (xmmsv_t *v, int bits, int d, int offset)
 int
 xmmsv_bitbuffer_put_data (xmmsv_t *v, const unsigned char *b, int len)
 {
+	int pos = v->value.bit.pos;
+
+	x_api_error_if (v->value.bit.ro, "write to readonly bitbuffer", 0);
+
+	/* byte aligned, copy it all at once */
+	if (pos % 8 == 0 && len > 0) {
+		if (pos + len * 8 > v->value.bit.alloclen) {
+			int ol, nl;
+			ol = v->value.bit.alloclen;
+			nl = ol * 2;
+			nl = nl < 128 ? 128 : nl;
+			nl = nl < pos + len * 8 ? pos + len * 8 : nl;
+			nl = (nl + 7) & ~7;
+			v->value.bit.buf = realloc (v->value.bit.buf, nl / 8);
+			memset (v->value.bit.buf + ol / 8, 0, (nl - ol) / 8);
+			v->value.bit.alloclen = nl;
+		}
+
+		memcpy (v->value.bit.buf + pos / 8, b, len);
+
+		v->value.bit.pos += len * 8;
+		if (v->value.bit.pos > v->value.bit.len)
+			v->value.bit.len = v->value.bit.pos;
+		return 1;
+	}
+
 	while (len) {
 		int t;
 		t = *b;
@@ -45,6 +45,8 @@ typedef struct xmms_airplay_data_St {
 	GMutex *raop_mutex;
 	gint wake_pipe[2];
 	xmms_airplay_state_t state;
+	/* flushed while paused, the audio kept for resuming is stale */
+	gboolean flush_pending;
 	gdouble volume;
 } xmms_airplay_data_t;
 
@@ -182,9 +184,12 @@ xmms_airplay_thread (gpointer arg)
 	struct timeval timeout;
 	int stream_fd;
 	int rtsp_fd;
+	int ready_fd;
 	int wake_fd;
 	int max_fd;
 	int ret;
+	gboolean rtsp_pending;
+	gboolean flush;
 	gdouble prev_vol = 0.0;
 
 	data = xmms_output_private_data_get (output);
@@ -209,7 +214,11 @@ xmms_airplay_thread (gpointer arg)
 			g_mutex_lock (data->raop_mutex);
 			break;
 		case STATE_CONNECT:
+			flush = data->flush_pending;
+			data->flush_pending = FALSE;
 			g_mutex_unlock (data->raop_mutex);
+			if (flush)
+				raop_client_flush (rc);
 			val = xmms_output_config_lookup (output, "airport_address");
 			tmp = xmms_config_property_get_string (val);
 			XMMS_DBG ("Connecting to %s", tmp);
@@ -220,7 +229,9 @@ xmms_airplay_thread (gpointer arg)
 				raop_client_get_volume (rc, &data->volume);
 				prev_vol = data->volume;
 				XMMS_DBG ("Connected!");
-				data->state = STATE_RUNNING;
+				/* flushed while connecting */
+				data->state = data->flush_pending ? STATE_FLUSH : STATE_RUNNING;
+				data->flush_pending = FALSE;
 			} else {
 				xmms_error_t error;
 				data->state = STATE_IDLE;
@@ -272,11 +283,15 @@ xmms_airplay_thread (gpointer arg)
 		FD_SET (wake_fd, &rfds);
 		rtsp_fd = raop_client_rtsp_sock (rc);
 		stream_fd = raop_client_stream_sock (rc);
+		ready_fd = raop_client_ready_sock (rc);
+		rtsp_pending = FALSE;
 		if (raop_client_can_read (rc, rtsp_fd)) {
 			FD_SET (rtsp_fd, &rfds);
+			rtsp_pending = TRUE;
 		}
 		if (raop_client_can_write (rc, rtsp_fd)) {
 			FD_SET (rtsp_fd, &wfds);
+			rtsp_pending = TRUE;
 		}
 		if (raop_client_can_read (rc, stream_fd)) {
 			FD_SET (stream_fd, &rfds);
@@ -284,15 +299,19 @@ xmms_airplay_thread (gpointer arg)
 		if (raop_client_can_write (rc, stream_fd)) {
 			FD_SET (stream_fd, &wfds);
 		}
+		if (raop_client_can_read (rc, ready_fd)) {
+			FD_SET (ready_fd, &rfds);
+		}
 		FD_SET (rtsp_fd, &efds);
 		if (stream_fd != -1)
 			FD_SET (stream_fd, &efds);
 
-		max_fd = MAX (wake_fd, MAX (rtsp_fd, stream_fd));
+		max_fd = MAX (MAX (wake_fd, ready_fd), MAX (rtsp_fd, stream_fd));
 		ret = select (max_fd + 1, &rfds, &wfds, &efds, &timeout);
 		if (ret <= 0) {
 			g_mutex_lock (data->raop_mutex);
-			if (!(ret == -1 && errno == EINTR)) {
+			/* a timeout while waiting for audio is just an underrun */
+			if (ret == -1 ? errno != EINTR : rtsp_pending) {
 				data->state = STATE_DISCONNECT;
 			}
 			continue;
@@ -304,6 +323,8 @@ xmms_airplay_thread (gpointer arg)
 			continue;
 		}
 
+		if (FD_ISSET (ready_fd, &rfds))
+			raop_client_handle_io (rc, ready_fd, G_IO_IN);
 		if (FD_ISSET (rtsp_fd, &rfds))
 			raop_client_handle_io (rc, rtsp_fd, G_IO_IN);
 		if (FD_ISSET (rtsp_fd, &wfds))
@@ -317,8 +338,12 @@ xmms_airplay_thread (gpointer arg)
 		if (stream_fd != -1) {
 			if (FD_ISSET (stream_fd, &rfds))
 				raop_client_handle_io (rc, stream_fd, G_IO_IN);
-			if (FD_ISSET (stream_fd, &wfds))
-				raop_client_handle_io (rc, stream_fd, G_IO_OUT);
+			if (FD_ISSET (stream_fd, &wfds) &&
+			    raop_client_handle_io (rc, stream_fd, G_IO_OUT) != RAOP_EOK) {
+				g_mutex_lock (data->raop_mutex);
+				data->state = STATE_DISCONNECT;
+				g_mutex_unlock (data->raop_mutex);
+			}
 			if (FD_ISSET (stream_fd, &efds)) {
 				raop_client_handle_io (rc, stream_fd, G_IO_ERR);
 				g_mutex_lock (data->raop_mutex);
@@ -428,6 +453,8 @@ xmms_airplay_flush (xmms_output_t *output)
 	if (data->state == STATE_RUNNING) {
 		data->state = STATE_FLUSH;
 		write (data->wake_pipe[1], "X", 1);
+	} else if (data->state != STATE_FLUSH) {
+		data->flush_pending = TRUE;
 	}
 	g_mutex_unlock (data->raop_mutex);
 }
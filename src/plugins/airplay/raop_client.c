@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -6,9 +7,9 @@
 #include <openssl/bio.h>
 #include <openssl/engine.h>
 #include <openssl/bn.h>
-#include <openssl/aes.h>
 
 #include "raop_client.h"
+#include "raop_packet.h"
 #include "net_utils.h"
 #include "rtsp.h"
 
@@ -31,6 +32,11 @@
 #define RAOP_RTSP_CONNECTED     0x40
 #define RAOP_RTSP_DONE          0x80
 
+/* packets prepared ahead of the one being sent */
+#define RAOP_PACKET_QUEUE 4
+/* how long to wait before asking for more audio after getting none */
+#define RAOP_PREP_RETRY_USEC 20000
+
 typedef enum audio_jack_status {
 	AUDIO_JACK_CONNECTED,
 	AUDIO_JACK_DISCONNECTED
@@ -73,39 +79,28 @@ struct raop_client_struct {
 	guint8 aes_iv[16];
 	guint8 aes_key_str[16];
 	guint8 challenge[16];
-	AES_KEY *aes_key;
-
-	/* audio sample */
-	guint8 sbuf[RAOP_ALAC_FRAME_SIZE * 2  * 2 + 19]; /* 16-bit stereo */
-	guint32 sbuf_size;
-	guint32 sbuf_offset;
+	raop_packet_cipher_t *cipher;
+
+	/* audio packets, packed and encrypted by the prep thread so the
+	 * I/O loop only has to send them */
+	raop_packet_t *packets;
+	GQueue free_packets;
+	GQueue ready_packets;
+	GMutex *packet_mutex;
+	GCond *packet_cond;
+	GThread *prep_thread;
+	gboolean prep_quit;
+	/* bumped by every flush, a batch prepared across one is dropped */
+	guint flush_generation;
+	/* written to when ready_packets stops being empty */
+	gint ready_pipe[2];
+
+	/* only touched by the I/O loop */
+	raop_packet_t *send_packet;
 };
 
-static gint raop_client_stream_sample (raop_client_t *rc, guint16 *buf, guint32 len);
-
 /* Helper Functions */
 
-/* write upto 8 bits at-a-time into a buffer */
-static void
-write_bits (guint8 *buf, guint8 val, gint nbits, guint32 *offset)
-{
-	int bit_offset = *offset % 8;
-	int byte_offset = *offset / 8;
-	int left = 8 - bit_offset;
-
-	*offset += nbits;
-	if (nbits >= left) {
-		buf[byte_offset] |= (val >> (nbits - left));
-		val = (val << left) >> left;
-		nbits -= left;
-		left = 8;
-		byte_offset++;
-	}
-	if (nbits && nbits < left) {
-		buf[byte_offset] |= (val << (left - nbits));
-	}
-}
-
 static gint
 raop_rsa_encrypt (guchar *text, gint len, guchar *res)
 {
@@ -137,8 +132,13 @@ raop_rsa_encrypt (guchar *text, gint len, guchar *res)
 	static const guchar exp[] = {0x01, 0x00, 0x01};
 
 	rsa = RSA_new ();
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	RSA_set0_key (rsa, BN_bin2bn (mod, 256, NULL), BN_bin2bn (exp, 3, NULL),
+	              NULL);
+#else
 	rsa->n = BN_bin2bn (mod, 256, NULL);
 	rsa->e = BN_bin2bn (exp, 3, NULL);
+#endif
 
 	size = RSA_public_encrypt (len, text, res, rsa, RSA_PKCS1_OAEP_PADDING);
 
@@ -146,26 +146,150 @@ raop_rsa_encrypt (guchar *text, gint len, guchar *res)
 	return size;
 }
 
+/* wake the I/O loop up, called with packet_mutex held */
+static void
+raop_packet_ready_notify (raop_client_t *rc)
+{
+	gssize ret;
+
+	do {
+		ret = write (rc->ready_pipe[1], "X", 1);
+	} while (ret == -1 && errno == EINTR);
+
+	/* a full pipe means a wakeup is pending already */
+	if (ret == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+		g_warning ("Couldn't wake up the AirPlay I/O loop: %s",
+		           g_strerror (errno));
+}
+
+static gpointer
+raop_packet_prep_thread (gpointer arg)
+{
+	raop_client_t *rc = (raop_client_t *) arg;
+	raop_packet_t *batch[RAOP_PACKET_QUEUE];
+	guint16 buf[RAOP_PACKET_PCM_SIZE / 2];
+	gboolean was_empty;
+	GTimeVal until;
+	guint generation;
+	gint i, n, ret;
+
+	g_mutex_lock (rc->packet_mutex);
+	while (!rc->prep_quit) {
+		if (g_queue_is_empty (&rc->free_packets)) {
+			g_cond_wait (rc->packet_cond, rc->packet_mutex);
+			continue;
+		}
+
+		/* fill every free packet, so they can be encrypted together */
+		for (n = 0; !g_queue_is_empty (&rc->free_packets); n++)
+			batch[n] = g_queue_pop_head (&rc->free_packets);
+		generation = rc->flush_generation;
+		g_mutex_unlock (rc->packet_mutex);
+
+		ret = 0;
+		for (i = 0; i < n; i++) {
+			ret = rc->stream_cb.func (rc->stream_cb.data, (guchar *) buf,
+			                          sizeof (buf));
+			if (ret <= 0)
+				break;
+			raop_packet_pack (batch[i], buf, ret);
+		}
+
+		if (i && !raop_packet_encrypt (rc->cipher, batch, i))
+			i = 0;
+
+		g_mutex_lock (rc->packet_mutex);
+
+		/* the audio was read before a flush, it is stale now */
+		if (generation != rc->flush_generation)
+			i = 0;
+
+		was_empty = g_queue_is_empty (&rc->ready_packets);
+		for (n--; n >= i; n--)
+			g_queue_push_head (&rc->free_packets, batch[n]);
+		for (n = 0; n < i; n++)
+			g_queue_push_tail (&rc->ready_packets, batch[n]);
+		if (was_empty && i)
+			raop_packet_ready_notify (rc);
+
+		if (ret <= 0 && !rc->prep_quit) {
+			g_get_current_time (&until);
+			g_time_val_add (&until, RAOP_PREP_RETRY_USEC);
+			g_cond_timed_wait (rc->packet_cond, rc->packet_mutex, &until);
+		}
+	}
+	g_mutex_unlock (rc->packet_mutex);
+
+	return NULL;
+}
+
+static void
+raop_packet_prep_start (raop_client_t *rc)
+{
+	rc->prep_quit = FALSE;
+	rc->prep_thread = g_thread_create (raop_packet_prep_thread, rc, TRUE,
+	                                   NULL);
+}
+
+static void
+raop_packet_prep_stop (raop_client_t *rc)
+{
+	if (!rc->prep_thread)
+		return;
+
+	g_mutex_lock (rc->packet_mutex);
+	rc->prep_quit = TRUE;
+	g_cond_signal (rc->packet_cond);
+	g_mutex_unlock (rc->packet_mutex);
+
+	g_thread_join (rc->prep_thread);
+	rc->prep_thread = NULL;
+}
+
+/* called with the prep thread stopped; the prepared audio has been
+ * read from the output already, so it goes out on the new stream, the
+ * packet that was cut off goes out again from the start */
 static void
+raop_packet_queue_resume (raop_client_t *rc)
+{
+	if (rc->send_packet) {
+		rc->send_packet->offset = 0;
+		g_queue_push_head (&rc->ready_packets, rc->send_packet);
+		rc->send_packet = NULL;
+	}
+}
+
+static gint
 raop_send_sample (raop_client_t *rc)
 {
+	raop_packet_t *packet;
 	gint nwritten;
-	gint nleft = rc->sbuf_size - rc->sbuf_offset;
-
-	if (nleft == 0) {
-		guchar buf[RAOP_ALAC_FRAME_SIZE * 2 * 2];
-		gint ret;
 
-		ret = rc->stream_cb.func (rc->stream_cb.data, buf, sizeof (buf));
-		if (ret > 0)
-			raop_client_stream_sample (rc, (guint16 *)buf, ret);
+	if (!rc->send_packet) {
+		g_mutex_lock (rc->packet_mutex);
+		rc->send_packet = g_queue_pop_head (&rc->ready_packets);
+		g_mutex_unlock (rc->packet_mutex);
+		if (!rc->send_packet)
+			return RAOP_EOK;
+	}
 
-		nleft = rc->sbuf_size - rc->sbuf_offset;
+	packet = rc->send_packet;
+	nwritten = tcp_write (rc->stream_fd,
+	                      (char *) packet->data + packet->offset,
+	                      packet->size - packet->offset);
+	if (nwritten < 0)
+		return RAOP_EIO;
+
+	packet->offset += nwritten;
+	if (packet->offset == packet->size) {
+		g_mutex_lock (rc->packet_mutex);
+		g_queue_push_tail (&rc->free_packets, packet);
+		g_cond_signal (rc->packet_cond);
+		g_mutex_unlock (rc->packet_mutex);
+		rc->send_packet = NULL;
 	}
-	/* XXX: check for error */
-	nwritten = tcp_write (rc->stream_fd, (char *) rc->sbuf + rc->sbuf_offset,
-	                      nleft);
-	rc->sbuf_offset += nwritten;
+
+	return RAOP_EOK;
 }
 
 /* RTSP glue */
@@ -379,6 +503,7 @@ raop_client_init (raop_client_t **client)
 	raop_client_t *rc;
 	guchar rand_buf[8 + 16];
 	int ret;
+	gint i;
 
 	*client = (raop_client_t *) g_malloc (sizeof (raop_client_t));
 	if (!*client)
@@ -401,8 +526,33 @@ raop_client_init (raop_client_t **client)
 	            *((guint *) (rand_buf + 4)));
 
 	ret = RAND_bytes (rc->aes_key_str, sizeof (rc->aes_key_str));
-	rc->aes_key = (AES_KEY *) g_malloc (sizeof (AES_KEY));
-	AES_set_encrypt_key (rc->aes_key_str, 128, rc->aes_key);
+
+	rc->packets = g_new (raop_packet_t, RAOP_PACKET_QUEUE);
+	g_queue_init (&rc->free_packets);
+	g_queue_init (&rc->ready_packets);
+	for (i = 0; i < RAOP_PACKET_QUEUE; i++)
+		g_queue_push_tail (&rc->free_packets, &rc->packets[i]);
+	rc->packet_mutex = g_mutex_new ();
+	rc->packet_cond = g_cond_new ();
+
+	if (pipe (rc->ready_pipe) < 0) {
+		rc->ready_pipe[0] = rc->ready_pipe[1] = -1;
+		raop_client_destroy (rc);
+		*client = NULL;
+		return RAOP_ESYS;
+	}
+	set_sock_nonblock (rc->ready_pipe[0]);
+	set_sock_nonblock (rc->ready_pipe[1]);
+
+	/* kept for every connection, so audio encrypted for one can still
+	 * be sent on the next one after a pause */
+	RAND_bytes (rc->aes_iv, sizeof (rc->aes_iv));
+	rc->cipher = raop_packet_cipher_new (rc->aes_key_str, rc->aes_iv);
+	if (!rc->cipher) {
+		raop_client_destroy (rc);
+		*client = NULL;
+		return RAOP_EFAIL;
+	}
 
 	return RAOP_EOK;
 }
@@ -416,12 +566,10 @@ raop_client_connect (raop_client_t *rc, const gchar *host, gushort port)
 
 	rc->apex_host = g_strdup (host);
 	rc->rtsp_port = port;
-	rc->sbuf_size = 0;
-	rc->sbuf_offset = 0;
+	raop_packet_queue_resume (rc);
 
 	RAND_bytes (rand_buf, sizeof (rand_buf));
 	g_snprintf (rc->session_id, 11, "%u", *((guint *) rand_buf));
-	RAND_bytes (rc->aes_iv, sizeof (rc->aes_iv));
 	RAND_bytes (rc->challenge, sizeof (rc->challenge));
 
 	rtsp_fd = tcp_open ();
@@ -496,7 +644,7 @@ raop_client_handle_io (raop_client_t *rc, int fd, GIOCondition cond)
 			rc->io_state ^= RAOP_IO_RTSP_WRITE;
 			rc->io_state |= RAOP_IO_RTSP_READ;
 		} else if (fd == rc->stream_fd) { /* stream data */
-			raop_send_sample (rc);
+			return raop_send_sample (rc);
 		}
 	} else if (cond == G_IO_IN) {
 		/* get RTSP replies */
@@ -522,6 +670,7 @@ raop_client_handle_io (raop_client_t *rc, int fd, GIOCondition cond)
 				rc->io_state |= RAOP_IO_STREAM_WRITE;
 				rc->io_state |= RAOP_IO_STREAM_READ;
 				rc->rtsp_state = RAOP_RTSP_CONNECTED;
+				raop_packet_prep_start (rc);
 			} else if (rc->rtsp_state != RAOP_RTSP_CONNECTED) {
 				rc->io_state |= RAOP_IO_RTSP_WRITE;
 			}
@@ -531,6 +680,10 @@ raop_client_handle_io (raop_client_t *rc, int fd, GIOCondition cond)
 			 * it is, just read it for now, and doesn't
 			 * even care about returnval */
 			read (rc->stream_fd, buf, 56);
+		} else if (fd == rc->ready_pipe[0]) {
+			char buf[16];
+			/* just a wakeup, the packets are in ready_packets */
+			while (read (fd, buf, sizeof (buf)) > 0);
 		}
 	} else if (cond == G_IO_ERR) {
 		/* XXX */
@@ -539,58 +692,35 @@ raop_client_handle_io (raop_client_t *rc, int fd, GIOCondition cond)
 	return RAOP_EOK;
 }
 
-static gint
-raop_client_stream_sample (raop_client_t *rc, guint16 *buf, guint32 len)
-{
-	guint8 hdr[] = {0x24, 0x00, 0x00, 0x00,
-	                0xF0, 0xFF, 0x00, 0x00,
-	                0x00, 0x00, 0x00, 0x00,
-	                0x00, 0x00, 0x00, 0x00};
-	int i;
-	short cnt;
-	guint8 *pbuf;
-	guint8 iv[16];
-	guint32 offset = 0;
-
-	cnt = len + 3 + 12;
-	cnt = GUINT16_TO_BE (cnt);
-	memcpy (hdr + 2, (void *) &cnt, sizeof (cnt));
-
-	memset (rc->sbuf, 0, sizeof (rc->sbuf));
-	memcpy (rc->sbuf, hdr, sizeof (hdr));
-	pbuf = rc->sbuf + sizeof (hdr);
-
-	/* ALAC frame header */
-	write_bits (pbuf, 1, 3, &offset); /* # of channels */
-	write_bits (pbuf, 0, 4, &offset); /* output waiting? */
-	write_bits (pbuf, 0, 4, &offset); /* unknown */
-	write_bits (pbuf, 0, 8, &offset); /* unknown */
-	write_bits (pbuf, 0, 1, &offset); /* sample size follows the header */
-	write_bits (pbuf, 0, 2, &offset); /* unknown */
-	write_bits (pbuf, 1, 1, &offset); /* uncompressed */
-
-	for (i = 0; i < len/2; i++) {
-		write_bits (pbuf, (buf[i]) >> 8, 8, &offset);
-		write_bits (pbuf, (buf[i]) & 0xff, 8, &offset);
-	}
-	memcpy (iv, rc->aes_iv, sizeof (iv));
-	AES_cbc_encrypt (pbuf, pbuf,
-	                 (len + 3) / 16 * 16,
-	                 rc->aes_key, iv, TRUE);
-
-	rc->sbuf_size = len + 3 + sizeof (hdr);
-	rc->sbuf_offset = 0;
-
-	return RAOP_EOK;
-}
-
 gint
 raop_client_flush (raop_client_t *rc)
 {
+	raop_packet_t *packet;
+
+	/* drop the prepared audio, also the audio kept for the next
+	 * connection while paused */
+	g_mutex_lock (rc->packet_mutex);
+	while ((packet = g_queue_pop_head (&rc->ready_packets)))
+		g_queue_push_tail (&rc->free_packets, packet);
+	rc->flush_generation++;
+	g_cond_signal (rc->packet_cond);
+	g_mutex_unlock (rc->packet_mutex);
+
+	packet = rc->send_packet;
 	if (rc->rtsp_state & RAOP_RTSP_CONNECTED) {
-		memset (rc->sbuf, 0, sizeof (rc->sbuf));
+		/* the packet being sent has to be finished to keep the
+		 * stream in sync, but not with old audio */
+		if (packet)
+			memset (packet->data + packet->offset, 0,
+			        packet->size - packet->offset);
+
 		rc->rtsp_state |= RAOP_RTSP_FLUSH;
 		rc->io_state |= RAOP_IO_RTSP_WRITE;
+	} else if (packet) {
+		g_mutex_lock (rc->packet_mutex);
+		g_queue_push_tail (&rc->free_packets, packet);
+		g_mutex_unlock (rc->packet_mutex);
+		rc->send_packet = NULL;
 	}
 
 	return RAOP_EOK;
@@ -630,6 +760,8 @@ raop_client_can_read (raop_client_t *rc, gint fd)
 		return rc->io_state & RAOP_IO_RTSP_READ;
 	} else if (fd == rc->stream_fd) {
 		return rc->io_state & RAOP_IO_STREAM_READ;
+	} else if (fd == rc->ready_pipe[0]) {
+		return rc->prep_thread != NULL;
 	} else {
 		return FALSE;
 	}
@@ -642,7 +774,17 @@ raop_client_can_write (raop_client_t *rc, gint fd)
 	if (fd == rtsp_fd) {
 		return rc->io_state & RAOP_IO_RTSP_WRITE;
 	} else if (fd == rc->stream_fd) {
-		return rc->io_state & RAOP_IO_STREAM_WRITE;
+		gboolean ready;
+
+		if (!(rc->io_state & RAOP_IO_STREAM_WRITE))
+			return FALSE;
+		if (rc->send_packet)
+			return TRUE;
+
+		g_mutex_lock (rc->packet_mutex);
+		ready = !g_queue_is_empty (&rc->ready_packets);
+		g_mutex_unlock (rc->packet_mutex);
+		return ready;
 	} else {
 		return FALSE;
 	}
@@ -660,12 +802,19 @@ raop_client_stream_sock (raop_client_t *rc)
 	return rc->stream_fd;
 }
 
+gint
+raop_client_ready_sock (raop_client_t *rc)
+{
+	return rc->ready_pipe[0];
+}
+
 gint
 raop_client_disconnect (raop_client_t *rc)
 {
 	if (!rc)
 		return RAOP_EINVAL;
 
+	raop_packet_prep_stop (rc);
 	raop_rtsp_teardown (rc);
 	close (rc->rtsp_conn->fd);
 	close (rc->stream_fd);
@@ -683,7 +832,15 @@ raop_client_destroy (raop_client_t *rc)
 	if (!rc)
 		return RAOP_EINVAL;
 
-	g_free (rc->aes_key);
+	raop_packet_prep_stop (rc);
+	raop_packet_cipher_free (rc->cipher);
+	g_free (rc->packets);
+	g_mutex_free (rc->packet_mutex);
+	g_cond_free (rc->packet_cond);
+	if (rc->ready_pipe[0] != -1) {
+		close (rc->ready_pipe[0]);
+		close (rc->ready_pipe[1]);
+	}
 	g_free (rc->apex_host);
 	g_free (rc->cli_host);
 	g_free (rc);
@@ -49,6 +49,7 @@ gboolean raop_client_can_write(raop_client_t *rc, gint fd);
 
 gint raop_client_rtsp_sock(raop_client_t *rc);
 gint raop_client_stream_sock(raop_client_t *rc);
+gint raop_client_ready_sock(raop_client_t *rc);
 
 gint raop_client_set_volume(raop_client_t *rc, gdouble volume);
 gint raop_client_get_volume(raop_client_t *rc, gdouble *volume);
@@ -0,0 +1,133 @@
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include "raop_packet.h"
+
+#define RAOP_AES_BLOCK_SIZE 16
+
+struct raop_packet_cipher_struct {
+	EVP_CIPHER_CTX *ctx;
+	guint8 iv[RAOP_AES_BLOCK_SIZE];
+};
+
+/*
+ * The ALAC frame header is 23 bits long and the samples follow it
+ * uncompressed, so every sample byte straddles two output bytes with
+ * the same 7 bit shift. Rather than pushing each byte through a bit
+ * writer, load four samples at a time as one big-endian word and
+ * shift it into place, carrying the 7 bits that don't fit over to
+ * the next word.
+ */
+void
+raop_packet_pack (raop_packet_t *packet, const guint16 *samples, guint32 len)
+{
+	static const guint8 hdr[] = {0x24, 0x00, 0x00, 0x00,
+	                             0xF0, 0xFF, 0x00, 0x00,
+	                             0x00, 0x00, 0x00, 0x00,
+	                             0x00, 0x00, 0x00, 0x00};
+	guint8 *pbuf;
+	guint16 cnt, half;
+	guint64 word, out;
+	guint64 carry;
+	guint32 count, i;
+
+	len &= ~1;
+	count = len / 2;
+
+	cnt = GUINT16_TO_BE (len + RAOP_PACKET_ALAC_OVERHEAD + 12);
+	memcpy (packet->data, hdr, sizeof (hdr));
+	memcpy (packet->data + 2, &cnt, sizeof (cnt));
+	pbuf = packet->data + sizeof (hdr);
+
+	/* 3 bits of channel count (1 = stereo), 19 bits of zeroes and
+	 * the uncompressed flag, which is the last of the 7 bits that
+	 * share a byte with the first sample */
+	pbuf[0] = 0x20;
+	pbuf[1] = 0x00;
+	pbuf += 2;
+	carry = 0x01;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		memcpy (&word, samples + i, sizeof (word));
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+		word = GUINT64_SWAP_LE_BE (word);
+		word = ((word >> 8) & G_GUINT64_CONSTANT (0x00FF00FF00FF00FF)) |
+		       ((word & G_GUINT64_CONSTANT (0x00FF00FF00FF00FF)) << 8);
+#endif
+		out = GUINT64_TO_BE ((carry << 57) | (word >> 7));
+		memcpy (pbuf, &out, sizeof (out));
+		carry = word & 0x7F;
+		pbuf += sizeof (out);
+	}
+
+	for (; i < count; i++) {
+		half = GUINT16_TO_BE ((carry << 9) | (samples[i] >> 7));
+		memcpy (pbuf, &half, sizeof (half));
+		carry = samples[i] & 0x7F;
+		pbuf += sizeof (half);
+	}
+
+	*pbuf = carry << 1;
+
+	packet->size = sizeof (hdr) + len + RAOP_PACKET_ALAC_OVERHEAD;
+	packet->offset = 0;
+}
+
+raop_packet_cipher_t *
+raop_packet_cipher_new (const guint8 *key, const guint8 *iv)
+{
+	raop_packet_cipher_t *cipher;
+
+	cipher = g_new0 (raop_packet_cipher_t, 1);
+	memcpy (cipher->iv, iv, sizeof (cipher->iv));
+
+	cipher->ctx = EVP_CIPHER_CTX_new ();
+	if (!cipher->ctx ||
+	    !EVP_EncryptInit_ex (cipher->ctx, EVP_aes_128_cbc (), NULL, key, iv)) {
+		raop_packet_cipher_free (cipher);
+		return NULL;
+	}
+
+	/* only whole blocks are encrypted, the rest is sent as is */
+	EVP_CIPHER_CTX_set_padding (cipher->ctx, 0);
+
+	return cipher;
+}
+
+void
+raop_packet_cipher_free (raop_packet_cipher_t *cipher)
+{
+	if (!cipher)
+		return;
+
+	if (cipher->ctx)
+		EVP_CIPHER_CTX_free (cipher->ctx);
+	g_free (cipher);
+}
+
+/*
+ * Encrypt the ALAC frames of a batch of packets in place. Every frame
+ * starts over from the session IV, so each one is its own CBC run; the
+ * key schedule is set up once and only the IV is reset in between.
+ */
+gboolean
+raop_packet_encrypt (raop_packet_cipher_t *cipher, raop_packet_t **packets,
+                     gint count)
+{
+	guint8 *pbuf;
+	gint i, len, outlen;
+
+	for (i = 0; i < count; i++) {
+		pbuf = packets[i]->data + RAOP_PACKET_HEADER_SIZE;
+		len = packets[i]->size - RAOP_PACKET_HEADER_SIZE;
+		len -= len % RAOP_AES_BLOCK_SIZE;
+
+		if (!EVP_EncryptInit_ex (cipher->ctx, NULL, NULL, NULL, cipher->iv))
+			return FALSE;
+		if (!EVP_EncryptUpdate (cipher->ctx, pbuf, &outlen, pbuf, len))
+			return FALSE;
+	}
+
+	return TRUE;
+}
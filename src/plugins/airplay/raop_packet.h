@@ -0,0 +1,35 @@
+/* RAOP audio packet framing and encryption */
+
+#ifndef _RAOP_PACKET_H
+#define _RAOP_PACKET_H
+
+#include <glib.h>
+
+#include "raop_client.h"
+
+/* interleaved channel header in front of the ALAC frame */
+#define RAOP_PACKET_HEADER_SIZE 16
+/* bytes of ALAC frame header in front of the samples, and the byte
+ * the last sample spills into */
+#define RAOP_PACKET_ALAC_OVERHEAD 3
+
+#define RAOP_PACKET_PCM_SIZE (RAOP_ALAC_FRAME_SIZE * RAOP_ALAC_NUM_CHANNELS * \
+                              RAOP_ALAC_BITS_PER_SAMPLE / 8)
+#define RAOP_PACKET_MAX_SIZE (RAOP_PACKET_HEADER_SIZE + RAOP_PACKET_PCM_SIZE + \
+                              RAOP_PACKET_ALAC_OVERHEAD)
+
+typedef struct raop_packet_struct {
+	guint8 data[RAOP_PACKET_MAX_SIZE];
+	guint32 size;
+	guint32 offset;
+} raop_packet_t;
+
+typedef struct raop_packet_cipher_struct raop_packet_cipher_t;
+
+void raop_packet_pack(raop_packet_t *packet, const guint16 *samples, guint32 len);
+
+raop_packet_cipher_t *raop_packet_cipher_new(const guint8 *key, const guint8 *iv);
+void raop_packet_cipher_free(raop_packet_cipher_t *cipher);
+gboolean raop_packet_encrypt(raop_packet_cipher_t *cipher, raop_packet_t **packets, gint count);
+
+#endif /* _RAOP_PACKET_H */
@@ -16,6 +16,7 @@
 
 #include "xmms/xmms_outputplugin.h"
 #include "xmms/xmms_log.h"
+#include "alsa_pcm.h"
 
 #include <alsa/asoundlib.h>
 #include <alsa/pcm.h>
@@ -25,7 +26,6 @@
 /*
  *  Defines
  */
-#define BUFFER_TIME        500000
 #define MAX_CHANNELS       8
 
 /*
@@ -33,6 +33,7 @@
  */
 typedef struct xmms_alsa_data_St {
 	snd_pcm_t *pcm;
+	xmms_alsa_pcm_t *apcm;
 	snd_mixer_t *mixer;
 	snd_mixer_elem_t *mixer_elem;
 } xmms_alsa_data_t;
@@ -83,7 +84,6 @@ static void xmms_alsa_flush (xmms_output_t *output);
 static void xmms_alsa_close (xmms_output_t *output);
 static void xmms_alsa_write (xmms_output_t *output, gpointer buffer, gint len,
                              xmms_error_t *err);
-static void xmms_alsa_xrun_recover (xmms_alsa_data_t *output, gint err);
 static guint xmms_alsa_buffer_bytes_get (xmms_output_t *output);
 static gboolean xmms_alsa_open (xmms_output_t *output);
 static gboolean xmms_alsa_new (xmms_output_t *output);
@@ -92,6 +92,8 @@ static gboolean xmms_alsa_format_set (xmms_output_t *output,
                                       const xmms_stream_type_t *format);
 static gboolean xmms_alsa_set_hwparams (xmms_alsa_data_t *data,
                                         const xmms_stream_type_t *format);
+static void xmms_alsa_options_get (xmms_output_t *output,
+                                   xmms_alsa_pcm_options_t *options);
 static gboolean xmms_alsa_volume_set (xmms_output_t *output,
                                       const gchar *channel,
                                       guint volume);
@@ -156,6 +158,19 @@ xmms_alsa_plugin_setup (xmms_output_plugin_t *plugin)
 	xmms_output_plugin_config_property_register (plugin, "mixer_index", "0",
 	                                             NULL, NULL);
 
+	/* latency targets in milliseconds, see xmms_alsa_pcm_options_t */
+	xmms_output_plugin_config_property_register (plugin, "buffer_time", "500",
+	                                             NULL, NULL);
+
+	xmms_output_plugin_config_property_register (plugin, "period_time", "0",
+	                                             NULL, NULL);
+
+	xmms_output_plugin_config_property_register (plugin, "buffer_time_max", "0",
+	                                             NULL, NULL);
+
+	xmms_output_plugin_config_property_register (plugin, "mmap", "0",
+	                                             NULL, NULL);
+
 	return TRUE;
 }
 
@@ -332,6 +347,7 @@ static gboolean
 xmms_alsa_open (xmms_output_t *output)
 {
 	xmms_alsa_data_t *data;
+	xmms_alsa_pcm_options_t options;
 	const xmms_config_property_t *cv;
 	const gchar *dev;
 	gint err = 0;
@@ -360,9 +376,30 @@ xmms_alsa_open (xmms_output_t *output)
 
 	snd_pcm_nonblock (data->pcm, 0);
 
+	xmms_alsa_options_get (output, &options);
+	data->apcm = xmms_alsa_pcm_new (data->pcm, &options);
+
 	return TRUE;
 }
 
+static void
+xmms_alsa_options_get (xmms_output_t *output, xmms_alsa_pcm_options_t *options)
+{
+	const xmms_config_property_t *cv;
+
+	cv = xmms_output_config_lookup (output, "buffer_time");
+	options->buffer_time = MAX (xmms_config_property_get_int (cv), 1) * 1000;
+
+	cv = xmms_output_config_lookup (output, "period_time");
+	options->period_time = MAX (xmms_config_property_get_int (cv), 0) * 1000;
+
+	cv = xmms_output_config_lookup (output, "buffer_time_max");
+	options->buffer_time_max = MAX (xmms_config_property_get_int (cv), 0) * 1000;
+
+	cv = xmms_output_config_lookup (output, "mmap");
+	options->mmap = !!xmms_config_property_get_int (cv);
+}
+
 /**
  * Close audio device.
  *
@@ -373,11 +410,20 @@ xmms_alsa_close (xmms_output_t *output)
 {
 	gint err;
 	xmms_alsa_data_t *data;
+	xmms_alsa_pcm_stats_t stats;
 
 	g_return_if_fail (output);
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
+	xmms_alsa_pcm_stats_get (data->apcm, &stats);
+	XMMS_DBG ("%d underruns, delay was %ld to %ld of %lu frames",
+	          stats.underruns, (glong) stats.min_delay,
+	          (glong) stats.max_delay, (gulong) stats.buffer_size);
+
+	xmms_alsa_pcm_free (data->apcm);
+	data->apcm = NULL;
+
 	/* Close device */
 	err = snd_pcm_close (data->pcm);
 	if (err != 0) {
@@ -401,14 +447,11 @@ xmms_alsa_set_hwparams (xmms_alsa_data_t *data,
                         const xmms_stream_type_t *format)
 {
 	snd_pcm_format_t alsa_format = SND_PCM_FORMAT_UNKNOWN;
-	gint err, tmp, i, fmt;
-	guint requested_buffer_time = BUFFER_TIME;
-	snd_pcm_hw_params_t *hwparams;
+	xmms_alsa_pcm_stats_t stats;
+	gint err, i, fmt, channels, rate;
 
 	g_return_val_if_fail (data, FALSE);
 
-	snd_pcm_hw_params_alloca (&hwparams);
-
 	/* what alsa format does this format correspond to? */
 	fmt = xmms_stream_type_get_int (format, XMMS_STREAM_TYPE_FMT_FORMAT);
 	for (i = 0; i < G_N_ELEMENTS (formats); i++) {
@@ -420,71 +463,20 @@ xmms_alsa_set_hwparams (xmms_alsa_data_t *data,
 
 	g_return_val_if_fail (alsa_format != SND_PCM_FORMAT_UNKNOWN, FALSE);
 
-	/* Setup all parameters to configuration space */
-	err = snd_pcm_hw_params_any (data->pcm, hwparams);
-	if (err < 0) {
-		xmms_log_error ("Broken configuration for playback: no configurations "
-		                "available: %s", snd_strerror (err));
-		return FALSE;
-	}
-
-	/* Set the interleaved read/write format */
-	err = snd_pcm_hw_params_set_access (data->pcm, hwparams,
-	                                    SND_PCM_ACCESS_RW_INTERLEAVED);
-	if (err < 0) {
-		xmms_log_error ("Access type not available for playback: %s",
-		                snd_strerror (err));
-		return FALSE;
-	}
+	channels = xmms_stream_type_get_int (format, XMMS_STREAM_TYPE_FMT_CHANNELS);
+	rate = xmms_stream_type_get_int (format, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
 
-	/* Set the sample format */
-	err = snd_pcm_hw_params_set_format (data->pcm, hwparams, alsa_format);
+	err = xmms_alsa_pcm_configure (data->apcm, alsa_format, channels, rate);
 	if (err < 0) {
-		xmms_log_error ("Sample format not available for playback: %s",
-		                snd_strerror (err));
+		xmms_log_error ("Unable to set up %d channels at %iHz for playback: %s",
+		                channels, rate, snd_strerror (err));
 		return FALSE;
 	}
 
-	/* Set the count of channels */
-	tmp = xmms_stream_type_get_int (format, XMMS_STREAM_TYPE_FMT_CHANNELS);
-	err = snd_pcm_hw_params_set_channels (data->pcm, hwparams, tmp);
-	if (err < 0) {
-		xmms_log_error ("Channels count (%i) not available for playbacks: %s",
-		                tmp, snd_strerror (err));
-		return FALSE;
-	}
-
-	/* Set the sample rate.
-	 * Note: don't use snd_pcm_hw_params_set_rate_near(), we want to fail here
-	 *       if the core passed an unsupported samplerate to us!
-	 */
-	tmp = xmms_stream_type_get_int (format, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
-	err = snd_pcm_hw_params_set_rate (data->pcm, hwparams, tmp, 0);
-	if (err < 0) {
-		xmms_log_error ("Rate %iHz not available for playback: %s",
-		                tmp, snd_strerror (err));
-		return FALSE;
-	}
-
-	tmp = requested_buffer_time;
-	err = snd_pcm_hw_params_set_buffer_time_near (data->pcm, hwparams,
-	                                              &requested_buffer_time, NULL);
-	if (err < 0) {
-		xmms_log_error ("Unable to set buffer time %i for playback: %s", tmp,
-		                snd_strerror (err));
-		return FALSE;
-	}
-
-	XMMS_DBG ("Buffer time requested: %dms, got: %dms",
-	          tmp / 1000, requested_buffer_time / 1000);
-
-	/* Put the hardware parameters into good use */
-	err = snd_pcm_hw_params (data->pcm, hwparams);
-	if (err < 0) {
-		xmms_log_error ("Unable to set hw params for playback: %s",
-		                snd_strerror (err));
-		return FALSE;
-	}
+	xmms_alsa_pcm_stats_get (data->apcm, &stats);
+	XMMS_DBG ("Buffer of %lu frames in periods of %lu (%dms requested), %s",
+	          (gulong) stats.buffer_size, (gulong) stats.period_size,
+	          stats.buffer_time / 1000, stats.mmap ? "mmap" : "writei");
 
 	return TRUE;
 }
@@ -770,42 +762,6 @@ xmms_alsa_flush (xmms_output_t *output)
 
 
 
-/**
- * XRUN recovery.
- * Checks if any buffer underrun has happened and performes the
- * necessary 'repairs'. Straight from alsa pcm.c example.
- *
- * @param data The private plugin data.
- */
-static void
-xmms_alsa_xrun_recover (xmms_alsa_data_t *data, gint err)
-{
-	g_return_if_fail (data);
-
-	if (err == -EPIPE) {
-		err = snd_pcm_prepare (data->pcm);
-		if (err < 0) {
-			xmms_log_error ("Unable to recover from underrun, prepare failed: "
-			                "%s", snd_strerror (err));
-		}
-	}
-	else if (err == -ESTRPIPE) {
-		while ((err = snd_pcm_resume (data->pcm)) == -EAGAIN) {
-			sleep (1); /* wait until the suspend flag is released */
-		}
-
-		if (err < 0) {
-			err = snd_pcm_prepare (data->pcm);
-			if (err < 0) {
-				xmms_log_error ("Can't recovery from suspend, prepare failed: "
-				                "%s\n", snd_strerror (err));
-			}
-		}
-	}
-}
-
-
-
 /**
  * Write buffer to the audio device.
  *
@@ -817,31 +773,33 @@ static void
 xmms_alsa_write (xmms_output_t *output, gpointer buffer, gint len,
                  xmms_error_t *err)
 {
-	gint written;
-	gint frames;
+	xmms_alsa_pcm_stats_t stats;
 	xmms_alsa_data_t *data;
+	guint underruns;
+	gint ret;
 
 	g_return_if_fail (output);
 	g_return_if_fail (buffer);
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
-	g_return_if_fail (data->pcm);
+	g_return_if_fail (data->apcm);
 
-	frames = snd_pcm_bytes_to_frames (data->pcm, len);
+	xmms_alsa_pcm_stats_get (data->apcm, &stats);
+	underruns = stats.underruns;
 
-	while (frames > 0) {
-		written = snd_pcm_writei (data->pcm, buffer, frames);
+	ret = xmms_alsa_pcm_write (data->apcm, buffer,
+	                           snd_pcm_bytes_to_frames (data->pcm, len));
+	if (ret < 0) {
+		xmms_log_error ("Write to audio device failed: %s", snd_strerror (ret));
+		xmms_error_set (err, XMMS_ERROR_GENERIC, snd_strerror (ret));
+		return;
+	}
 
-		if (written > 0) {
-			frames -= written;
-			buffer += snd_pcm_frames_to_bytes (data->pcm, written);
-		} else if (written == -EAGAIN || written == -EINTR) {
-			snd_pcm_wait (data->pcm, 100);
-		} else if (written == -EPIPE || written == -ESTRPIPE) {
-			xmms_alsa_xrun_recover (data, written);
-		} else {
-			xmms_log_fatal ("ALSA's doing some funky shit.. please report (%s)", snd_strerror (written));
-		}
+	xmms_alsa_pcm_stats_get (data->apcm, &stats);
+	if (stats.underruns != underruns) {
+		XMMS_DBG ("Underrun, %d so far, buffer is %lu frames (%dms requested)",
+		          stats.underruns, (gulong) stats.buffer_size,
+		          stats.buffer_time / 1000);
 	}
 }
 
@@ -0,0 +1,398 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Setting up an ALSA PCM and getting audio into it.
+ *
+ * The buffer and period sizes are negotiated from latency targets,
+ * and where the device allows it the audio is copied straight into
+ * the mmap'ed hardware buffer, a period at a time. If underruns
+ * happen the buffer can be made larger on the fly.
+ *
+ * Nothing here knows about the output plugin API, so it can be used
+ * with any PCM, like the null and file ones.
+ */
+
+#include "alsa_pcm.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct xmms_alsa_pcm_St {
+	snd_pcm_t *pcm;
+	xmms_alsa_pcm_options_t options;
+
+	/* what the device was last set up with */
+	snd_pcm_format_t format;
+	guint channels;
+	guint rate;
+	gint frame_bytes;
+
+	xmms_alsa_pcm_stats_t stats;
+};
+
+/**
+ * Wrap an open PCM, which stays owned by the caller.
+ */
+xmms_alsa_pcm_t *
+xmms_alsa_pcm_new (snd_pcm_t *pcm, const xmms_alsa_pcm_options_t *options)
+{
+	xmms_alsa_pcm_t *apcm;
+
+	g_return_val_if_fail (pcm, NULL);
+	g_return_val_if_fail (options, NULL);
+
+	apcm = g_new0 (xmms_alsa_pcm_t, 1);
+	apcm->pcm = pcm;
+	apcm->options = *options;
+	apcm->format = SND_PCM_FORMAT_UNKNOWN;
+
+	apcm->stats.buffer_time = options->buffer_time;
+	apcm->stats.min_delay = -1;
+	apcm->stats.max_delay = -1;
+
+	return apcm;
+}
+
+void
+xmms_alsa_pcm_free (xmms_alsa_pcm_t *apcm)
+{
+	g_free (apcm);
+}
+
+/**
+ * Set up the hardware and software parameters.
+ *
+ * @returns 0, or a negative error code from ALSA
+ */
+gint
+xmms_alsa_pcm_configure (xmms_alsa_pcm_t *apcm, snd_pcm_format_t format,
+                         guint channels, guint rate)
+{
+	snd_pcm_hw_params_t *hwparams;
+	snd_pcm_sw_params_t *swparams;
+	snd_pcm_access_t access = SND_PCM_ACCESS_RW_INTERLEAVED;
+	snd_pcm_uframes_t buffer_size, period_size;
+	guint buffer_time, period_time;
+	gint err;
+
+	g_return_val_if_fail (apcm, -EINVAL);
+
+	snd_pcm_hw_params_alloca (&hwparams);
+	snd_pcm_sw_params_alloca (&swparams);
+
+	err = snd_pcm_hw_params_any (apcm->pcm, hwparams);
+	if (err < 0) {
+		return err;
+	}
+
+	if (apcm->options.mmap &&
+	    snd_pcm_hw_params_test_access (apcm->pcm, hwparams,
+	                                   SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0) {
+		access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+	}
+
+	err = snd_pcm_hw_params_set_access (apcm->pcm, hwparams, access);
+	if (err < 0) {
+		return err;
+	}
+
+	err = snd_pcm_hw_params_set_format (apcm->pcm, hwparams, format);
+	if (err < 0) {
+		return err;
+	}
+
+	err = snd_pcm_hw_params_set_channels (apcm->pcm, hwparams, channels);
+	if (err < 0) {
+		return err;
+	}
+
+	/* no _near here, the core must not be given another rate than
+	 * the one it asked for */
+	err = snd_pcm_hw_params_set_rate (apcm->pcm, hwparams, rate, 0);
+	if (err < 0) {
+		return err;
+	}
+
+	buffer_time = apcm->stats.buffer_time;
+	err = snd_pcm_hw_params_set_buffer_time_near (apcm->pcm, hwparams,
+	                                              &buffer_time, NULL);
+	if (err < 0) {
+		return err;
+	}
+
+	period_time = apcm->options.period_time;
+	if (!period_time) {
+		period_time = buffer_time / 4;
+	}
+	err = snd_pcm_hw_params_set_period_time_near (apcm->pcm, hwparams,
+	                                              &period_time, NULL);
+	if (err < 0) {
+		return err;
+	}
+
+	err = snd_pcm_hw_params (apcm->pcm, hwparams);
+	if (err < 0) {
+		return err;
+	}
+
+	snd_pcm_hw_params_get_buffer_size (hwparams, &buffer_size);
+	snd_pcm_hw_params_get_period_size (hwparams, &period_size, NULL);
+
+	/* start once a period is queued and wake up a period at a time */
+	err = snd_pcm_sw_params_current (apcm->pcm, swparams);
+	if (err < 0) {
+		return err;
+	}
+
+	err = snd_pcm_sw_params_set_start_threshold (apcm->pcm, swparams,
+	                                             period_size);
+	if (err < 0) {
+		return err;
+	}
+
+	err = snd_pcm_sw_params_set_avail_min (apcm->pcm, swparams, period_size);
+	if (err < 0) {
+		return err;
+	}
+
+	err = snd_pcm_sw_params (apcm->pcm, swparams);
+	if (err < 0) {
+		return err;
+	}
+
+	apcm->format = format;
+	apcm->channels = channels;
+	apcm->rate = rate;
+	apcm->frame_bytes = snd_pcm_frames_to_bytes (apcm->pcm, 1);
+
+	apcm->stats.buffer_size = buffer_size;
+	apcm->stats.period_size = period_size;
+	apcm->stats.mmap = (access == SND_PCM_ACCESS_MMAP_INTERLEAVED);
+
+	return 0;
+}
+
+/**
+ * Get the PCM going again after an underrun or a suspend.
+ *
+ * If the buffer may grow, an underrun sets the device up again with
+ * twice the buffer time.
+ *
+ * @returns 0, or the error if it couldn't be handled
+ */
+gint
+xmms_alsa_pcm_recover (xmms_alsa_pcm_t *apcm, gint err)
+{
+	xmms_alsa_pcm_stats_t *stats;
+
+	g_return_val_if_fail (apcm, -EINVAL);
+
+	stats = &apcm->stats;
+
+	if (err == -EPIPE) {
+		stats->underruns++;
+
+		if (stats->buffer_time < apcm->options.buffer_time_max &&
+		    apcm->format != SND_PCM_FORMAT_UNKNOWN) {
+			stats->buffer_time = MIN (stats->buffer_time * 2,
+			                          apcm->options.buffer_time_max);
+
+			snd_pcm_drop (apcm->pcm);
+			return xmms_alsa_pcm_configure (apcm, apcm->format,
+			                                apcm->channels, apcm->rate);
+		}
+
+		return snd_pcm_prepare (apcm->pcm);
+	}
+
+	if (err == -ESTRPIPE) {
+		while ((err = snd_pcm_resume (apcm->pcm)) == -EAGAIN) {
+			sleep (1); /* wait until the suspend flag is released */
+		}
+
+		if (err < 0) {
+			err = snd_pcm_prepare (apcm->pcm);
+		}
+	}
+
+	return err;
+}
+
+static gint
+xmms_alsa_pcm_write_rw (xmms_alsa_pcm_t *apcm, const guint8 *buffer,
+                        snd_pcm_uframes_t frames)
+{
+	snd_pcm_sframes_t written;
+	gint err;
+
+	while (frames > 0) {
+		written = snd_pcm_writei (apcm->pcm, buffer, frames);
+
+		if (written > 0) {
+			frames -= written;
+			buffer += written * apcm->frame_bytes;
+		} else if (written == -EAGAIN || written == -EINTR) {
+			snd_pcm_wait (apcm->pcm, 100);
+		} else {
+			err = xmms_alsa_pcm_recover (apcm, written);
+			if (err < 0) {
+				return err;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static gint
+xmms_alsa_pcm_write_mmap (xmms_alsa_pcm_t *apcm, const guint8 *buffer,
+                          snd_pcm_uframes_t frames)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, size, period;
+	snd_pcm_sframes_t avail, committed;
+	guint8 *dest;
+	gint err;
+
+	while (frames > 0) {
+		period = apcm->stats.period_size;
+
+		avail = snd_pcm_avail_update (apcm->pcm);
+		if (avail < 0) {
+			err = xmms_alsa_pcm_recover (apcm, avail);
+			if (err < 0) {
+				return err;
+			}
+			continue;
+		}
+
+		/* wait until there's room for a period, or what's left */
+		if (avail < MIN (frames, period)) {
+			if (snd_pcm_state (apcm->pcm) == SND_PCM_STATE_PREPARED) {
+				err = snd_pcm_start (apcm->pcm);
+			} else {
+				err = snd_pcm_wait (apcm->pcm, 1000);
+			}
+
+			if (err < 0) {
+				err = xmms_alsa_pcm_recover (apcm, err);
+				if (err < 0) {
+					return err;
+				}
+			}
+			continue;
+		}
+
+		size = MIN (frames, avail);
+		err = snd_pcm_mmap_begin (apcm->pcm, &areas, &offset, &size);
+		if (err < 0) {
+			err = xmms_alsa_pcm_recover (apcm, err);
+			if (err < 0) {
+				return err;
+			}
+			continue;
+		}
+
+		/* don't cross a period boundary, that's where the device
+		 * wakes us up */
+		size = MIN (size, period - offset % period);
+
+		/* interleaved, so all channels are in the first area */
+		dest = (guint8 *) areas[0].addr +
+		       (areas[0].first + offset * areas[0].step) / 8;
+		memcpy (dest, buffer, size * apcm->frame_bytes);
+
+		committed = snd_pcm_mmap_commit (apcm->pcm, offset, size);
+		if (committed < 0) {
+			err = xmms_alsa_pcm_recover (apcm, committed);
+			if (err < 0) {
+				return err;
+			}
+			continue;
+		}
+
+		frames -= committed;
+		buffer += committed * apcm->frame_bytes;
+
+		/* unlike writei, committing doesn't start the stream */
+		if (snd_pcm_state (apcm->pcm) == SND_PCM_STATE_PREPARED) {
+			avail = snd_pcm_avail_update (apcm->pcm);
+			if (avail >= 0 && apcm->stats.buffer_size - avail >= period) {
+				err = snd_pcm_start (apcm->pcm);
+				if (err < 0) {
+					return err;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Write interleaved frames, waiting for room in the buffer.
+ *
+ * @returns 0, or a negative error code from ALSA that couldn't be
+ * recovered from
+ */
+gint
+xmms_alsa_pcm_write (xmms_alsa_pcm_t *apcm, gconstpointer buffer,
+                     snd_pcm_uframes_t frames)
+{
+	xmms_alsa_pcm_stats_t *stats;
+	snd_pcm_sframes_t delay;
+	gint err;
+
+	g_return_val_if_fail (apcm, -EINVAL);
+	g_return_val_if_fail (buffer, -EINVAL);
+	g_return_val_if_fail (apcm->format != SND_PCM_FORMAT_UNKNOWN, -EBADFD);
+
+	if (apcm->stats.mmap) {
+		err = xmms_alsa_pcm_write_mmap (apcm, buffer, frames);
+	} else {
+		err = xmms_alsa_pcm_write_rw (apcm, buffer, frames);
+	}
+
+	if (err < 0) {
+		return err;
+	}
+
+	stats = &apcm->stats;
+
+	if (snd_pcm_state (apcm->pcm) == SND_PCM_STATE_RUNNING &&
+	    snd_pcm_delay (apcm->pcm, &delay) == 0) {
+		if (stats->min_delay < 0 || delay < stats->min_delay) {
+			stats->min_delay = delay;
+		}
+		if (delay > stats->max_delay) {
+			stats->max_delay = delay;
+		}
+	}
+
+	return 0;
+}
+
+void
+xmms_alsa_pcm_stats_get (xmms_alsa_pcm_t *apcm, xmms_alsa_pcm_stats_t *stats)
+{
+	g_return_if_fail (apcm);
+	g_return_if_fail (stats);
+
+	*stats = apcm->stats;
+}
@@ -0,0 +1,64 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __ALSA_PCM_H__
+#define __ALSA_PCM_H__
+
+#include <glib.h>
+#include <alsa/asoundlib.h>
+
+typedef struct {
+	/** latency target for the whole hardware buffer, in microseconds */
+	guint buffer_time;
+	/** in microseconds, 0 picks a quarter of the buffer */
+	guint period_time;
+	/** double the buffer on underruns up to this, 0 keeps it fixed */
+	guint buffer_time_max;
+	/** write straight into the hardware buffer where possible */
+	gboolean mmap;
+} xmms_alsa_pcm_options_t;
+
+typedef struct {
+	/** what was negotiated with the device, in frames */
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_uframes_t period_size;
+	/** whether mmap access is in use */
+	gboolean mmap;
+	guint underruns;
+	/** buffer time the device was last set up with, in microseconds */
+	guint buffer_time;
+	/** smallest and largest delay seen while running, in frames,
+	 * -1 when nothing was played yet */
+	snd_pcm_sframes_t min_delay;
+	snd_pcm_sframes_t max_delay;
+} xmms_alsa_pcm_stats_t;
+
+typedef struct xmms_alsa_pcm_St xmms_alsa_pcm_t;
+
+xmms_alsa_pcm_t *xmms_alsa_pcm_new (snd_pcm_t *pcm,
+                                    const xmms_alsa_pcm_options_t *options);
+void xmms_alsa_pcm_free (xmms_alsa_pcm_t *apcm);
+
+gint xmms_alsa_pcm_configure (xmms_alsa_pcm_t *apcm, snd_pcm_format_t format,
+                              guint channels, guint rate);
+gint xmms_alsa_pcm_write (xmms_alsa_pcm_t *apcm, gconstpointer buffer,
+                          snd_pcm_uframes_t frames);
+gint xmms_alsa_pcm_recover (xmms_alsa_pcm_t *apcm, gint err);
+
+void xmms_alsa_pcm_stats_get (xmms_alsa_pcm_t *apcm,
+                              xmms_alsa_pcm_stats_t *stats);
+
+#endif
@@ -22,6 +22,8 @@
 #include "xmms/xmms_log.h"
 #include "xmms/xmms_util.h"
 
+#include "cue_index.h"
+
 #include <glib.h>
 #include <string.h>
 #include <stdio.h>
@@ -120,47 +122,39 @@ typedef struct {
 	gchar title[1024];
 	gchar artist[1024];
 	gchar album[1024];
-	gint index;
-	gint index2;
+	gint pregap; /* INDEX 00 in CD frames, -1 if there is none */
+	gint start; /* INDEX 01 in CD frames, -1 if there is none */
 	GList *tracks;
 } cue_track;
 
 static void
 add_index (cue_track *tr, gchar *idx)
 {
-	guint ms = 0;
-	guint tmp;
-
-	gchar **a = g_strsplit (idx, ":", 0);
-
-	if (a[0] != NULL) {
-		tmp = strtol (a[0], NULL, 10);
-		ms = tmp * 60000;
+	gint number, frames;
 
-		if (a[1] != NULL) {
-			tmp = strtol (a[1], NULL, 10);
-			ms += tmp * 1000;
-
-			if (a[2] != NULL) {
-				tmp = strtol (a[2], NULL, 10);
-				ms += (guint)((gfloat)tmp * 1.0/75.0) * 1000.0;
-			}
-		}
+	if (!xmms_cue_index_parse (idx, &number, &frames)) {
+		xmms_log_info ("Ignoring malformed INDEX '%s'", idx);
+		return;
 	}
 
-	if (!tr->index) {
-		tr->index = ms;
-	} else {
-		tr->index2 = ms;
+	/* higher indexes are only subdivisions of the track */
+	if (number == 0) {
+		tr->pregap = frames;
+	} else if (number == 1) {
+		tr->start = frames;
 	}
+}
 
-	g_strfreev (a);
+static gint
+track_start (cue_track *t)
+{
+	return t->start != -1 ? t->start : t->pregap;
 }
 
 static void
 add_track (xmms_xform_t *xform, cue_track *tr)
 {
-	GList *n;
+	GList *n, *m;
 	gchar *file;
 
 	tr->tracks = g_list_reverse (tr->tracks);
@@ -169,25 +163,54 @@ add_track (xmms_xform_t *xform, cue_track *tr)
 	file = xmms_build_playlist_url (xmms_xform_get_url (xform), tr->file);
 
 	while (n) {
-		gchar arg0[32], arg1[32];
-		gchar *arg[2] = { arg0, arg1 };
-		gint numargs = 1;
+		gchar arg0[32], arg1[32], arg2[32], arg3[32];
+		gchar *arg[4] = { arg0, arg1, arg2, arg3 };
+		gint numargs = 2;
+		gint start;
 		cue_track *t = n->data;
 		if (!t) {
 			continue;
 		}
 
-		g_snprintf (arg0, sizeof (arg0), "startms=%d",
-		            t->index2 ? t->index2 : t->index);
+		start = track_start (t);
+		if (start == -1) {
+			xmms_log_info ("Track without INDEX in '%s', skipping", tr->file);
+			g_free (t);
+			n = g_list_delete_link (n, n);
+			continue;
+		}
+
+		/* The exact CD frames are what the segment xform splits
+		 * at, the milliseconds are for everyone else. A track
+		 * ends where the next one starts so that the pregap is
+		 * played at the end of the previous track, like a CD
+		 * player does, and nothing falls between two tracks. */
+		g_snprintf (arg0, sizeof (arg0), "startframe=%d", start);
+		g_snprintf (arg1, sizeof (arg1), "startms=%d",
+		            xmms_cue_frames_to_ms (start));
+
+		/* the next track that gets added, the ones without an
+		 * INDEX are skipped */
+		for (m = n->next; m; m = m->next) {
+			if (m->data && track_start (m->data) != -1) {
+				break;
+			}
+		}
 
-		if (n->next && n->next->data) {
-			cue_track *t2 = n->next->data;
-			g_snprintf (arg1, sizeof (arg1), "stopms=%d", t2->index);
-			numargs = 2;
+		if (m) {
+			gint stop = track_start (m->data);
+
+			if (stop > start) {
+				g_snprintf (arg2, sizeof (arg2), "stopframe=%d", stop);
+				g_snprintf (arg3, sizeof (arg3), "stopms=%d",
+				            xmms_cue_frames_to_ms (stop));
+				numargs = 4;
+			}
 		}
 
 		xmms_xform_browse_add_symlink_args (xform, NULL, file, numargs, arg);
-		xmms_xform_browse_add_entry_property_int (xform, "intsort", t->index);
+		xmms_xform_browse_add_entry_property_int (xform, "intsort",
+		                                          xmms_cue_frames_to_ms (start));
 		if (*t->title) {
 			xmms_xform_browse_add_entry_property_str (xform, "title", t->title);
 		}
@@ -243,6 +266,7 @@ xmms_cue_browse (xmms_xform_t *xform,
 			p = skip_white_space (p);
 			if (g_ascii_strncasecmp (p, "AUDIO", 5) == 0) {
 				cue_track *t = g_new0 (cue_track, 1);
+				t->pregap = t->start = -1;
 				track.tracks = g_list_prepend (track.tracks, t);
 			}
 		} else if (g_ascii_strncasecmp (p, "INDEX", 5) == 0) {
@@ -252,8 +276,6 @@ xmms_cue_browse (xmms_xform_t *xform,
 			}
 			p = skip_to_char (p, ' ');
 			p = skip_white_space (p);
-			p = skip_to_char (p, ' ');
-			p = skip_white_space (p);
 			add_index (t, p);
 		} else if (g_ascii_strncasecmp (p, "TITLE", 5) == 0) {
 			cue_track *t = g_list_nth_data (track.tracks, 0);
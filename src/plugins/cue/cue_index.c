@@ -0,0 +1,45 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include <stdio.h>
+
+#include "cue_index.h"
+
+gboolean
+xmms_cue_index_parse (const gchar *line, gint *number, gint *frames)
+{
+	gint num, mm, ss, ff;
+
+	if (sscanf (line, "%d %d:%d:%d", &num, &mm, &ss, &ff) != 4) {
+		return FALSE;
+	}
+
+	if (num < 0 || mm < 0 || ss < 0 || ss >= 60 ||
+	    ff < 0 || ff >= XMMS_CUE_FRAMES_PER_SECOND) {
+		return FALSE;
+	}
+
+	*number = num;
+	*frames = (mm * 60 + ss) * XMMS_CUE_FRAMES_PER_SECOND + ff;
+
+	return TRUE;
+}
+
+gint
+xmms_cue_frames_to_ms (gint frames)
+{
+	return (gint) ((gint64) frames * 1000 / XMMS_CUE_FRAMES_PER_SECOND);
+}
@@ -0,0 +1,39 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __CUE_INDEX_H__
+#define __CUE_INDEX_H__
+
+#include <glib.h>
+
+/** CD frames (sectors) per second, the unit of cue sheet positions */
+#define XMMS_CUE_FRAMES_PER_SECOND 75
+
+/**
+ * Parse the "nn mm:ss:ff" part of an INDEX line.
+ *
+ * @param line the text after the INDEX keyword
+ * @param number set to the index number, 0 for the pregap and 1 for
+ *               the start of the track
+ * @param frames set to the position in CD frames
+ * @returns FALSE if the line is malformed
+ */
+gboolean xmms_cue_index_parse (const gchar *line, gint *number, gint *frames);
+
+/** Convert a position in CD frames to milliseconds, rounding down */
+gint xmms_cue_frames_to_ms (gint frames);
+
+#endif
@@ -0,0 +1,667 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Background HTTP fetching for the curl transport.
+ *
+ * Each fetch runs its requests on a thread of its own and keeps the
+ * data in a ring buffer, so readers only block when the network
+ * really can't keep up. The ring also remembers data that has already
+ * been read, which lets short seeks in either direction be answered
+ * without going back to the server; other seeks restart the transfer
+ * with a Range request.
+ *
+ * Easy handles are pooled when a fetch is done with them, and a new
+ * fetch for the same host picks the handle back up together with its
+ * open connection.
+ */
+
+#include <string.h>
+
+#include "curl_fetch.h"
+
+/** Smallest read-ahead buffer we're willing to work with */
+#define XMMS_CURL_FETCH_MIN_SIZE 16384
+
+/** How many idle easy handles to keep around */
+#define XMMS_CURL_POOL_MAX 4
+
+typedef struct xmms_curl_pooled_St {
+	CURL *easy;
+	gchar *host;
+} xmms_curl_pooled_t;
+
+struct xmms_curl_fetch_St {
+	CURL *easy;
+	gchar *url;
+	gchar *host;
+
+	GThread *thread;
+	GMutex *mutex;
+	GCond *cond;
+
+	/* the ring holds the stream bytes from base up to end */
+	guchar *ring;
+	gsize size;
+	/* how far the writer may get ahead of the reader, the rest of
+	   the ring keeps what has been read already */
+	gsize ahead;
+	guint64 base;
+	guint64 end;
+	/* the reader's position, always between base and end */
+	guint64 pos;
+
+	/* where the next request starts */
+	guint64 request_offset;
+	/* set when a new request should replace the current one */
+	gboolean restart;
+	gboolean first_data;
+	/* bytes to throw away if the server ignored our range */
+	guint64 skip;
+	gboolean eof;
+	gboolean quit;
+	gchar *error;
+
+	/* from the first response */
+	gint64 length;
+	gboolean accept_ranges;
+	gboolean seekable;
+
+	xmms_curl_fetch_header_func_t header_func;
+	gpointer udata;
+
+	gchar errbuf[CURL_ERROR_SIZE];
+
+	xmms_curl_fetch_stats_t stats;
+};
+
+static GMutex *pool_lock;
+static GQueue *pool;
+
+static glong
+elapsed_usec (GTimeVal *start)
+{
+	GTimeVal now;
+
+	g_get_current_time (&now);
+
+	return MAX ((now.tv_sec - start->tv_sec) * G_USEC_PER_SEC +
+	            (now.tv_usec - start->tv_usec), 0);
+}
+
+static gchar *
+url_host (const gchar *url)
+{
+	const gchar *start, *end;
+
+	start = strstr (url, "://");
+	if (!start) {
+		return g_strdup ("");
+	}
+	start += 3;
+
+	end = strpbrk (start, "/?#");
+	if (!end) {
+		return g_strdup (start);
+	}
+
+	return g_strndup (start, end - start);
+}
+
+/**
+ * Set up the handle pool, must be called once before any fetch is
+ * created.
+ */
+void
+xmms_curl_fetch_pool_init (void)
+{
+	if (pool_lock) {
+		return;
+	}
+
+	curl_global_init (CURL_GLOBAL_ALL);
+
+	pool_lock = g_mutex_new ();
+	pool = g_queue_new ();
+}
+
+static CURL *
+pool_take (const gchar *host, gboolean *reused)
+{
+	GList *n;
+	CURL *easy = NULL;
+
+	*reused = FALSE;
+
+	if (pool_lock) {
+		g_mutex_lock (pool_lock);
+		for (n = pool->head; n; n = g_list_next (n)) {
+			xmms_curl_pooled_t *pooled = n->data;
+
+			if (strcmp (pooled->host, host) == 0) {
+				easy = pooled->easy;
+				g_queue_delete_link (pool, n);
+				g_free (pooled->host);
+				g_free (pooled);
+				break;
+			}
+		}
+		g_mutex_unlock (pool_lock);
+	}
+
+	if (easy) {
+		/* forgets the options, but keeps the connections */
+		curl_easy_reset (easy);
+		*reused = TRUE;
+		return easy;
+	}
+
+	return curl_easy_init ();
+}
+
+static void
+pool_release (CURL *easy, const gchar *host)
+{
+	xmms_curl_pooled_t *pooled;
+
+	if (!pool_lock) {
+		curl_easy_cleanup (easy);
+		return;
+	}
+
+	pooled = g_new0 (xmms_curl_pooled_t, 1);
+	pooled->easy = easy;
+	pooled->host = g_strdup (host);
+
+	g_mutex_lock (pool_lock);
+	g_queue_push_head (pool, pooled);
+	if (g_queue_get_length (pool) > XMMS_CURL_POOL_MAX) {
+		pooled = g_queue_pop_tail (pool);
+	} else {
+		pooled = NULL;
+	}
+	g_mutex_unlock (pool_lock);
+
+	if (pooled) {
+		curl_easy_cleanup (pooled->easy);
+		g_free (pooled->host);
+		g_free (pooled);
+	}
+}
+
+/* Called with the lock held when the first data of a request arrives */
+static void
+check_response (xmms_curl_fetch_t *fetch)
+{
+	double length = -1;
+	long code = 0;
+
+	curl_easy_getinfo (fetch->easy, CURLINFO_RESPONSE_CODE, &code);
+
+	if (fetch->stats.requests == 1) {
+		curl_easy_getinfo (fetch->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD,
+		                   &length);
+		fetch->length = length > 0 ? (gint64) length : -1;
+		fetch->seekable = fetch->accept_ranges && fetch->length > 0;
+	} else if (fetch->request_offset > 0 && code != 206) {
+		/* the server sent everything, drop what's before the range */
+		fetch->skip = fetch->request_offset;
+	}
+}
+
+static size_t
+xmms_curl_fetch_callback_write (void *ptr, size_t size, size_t nmemb,
+                                void *udata)
+{
+	xmms_curl_fetch_t *fetch = udata;
+	const guchar *src = ptr;
+	gsize len, left, room, idx, n;
+
+	len = left = size * nmemb;
+
+	g_mutex_lock (fetch->mutex);
+
+	if (fetch->first_data) {
+		fetch->first_data = FALSE;
+		check_response (fetch);
+	}
+
+	fetch->stats.bytes += len;
+
+	while (left > 0) {
+		if (fetch->quit || fetch->restart) {
+			/* aborts the transfer */
+			g_mutex_unlock (fetch->mutex);
+			return 0;
+		}
+
+		if (fetch->skip) {
+			n = MIN (fetch->skip, left);
+			fetch->skip -= n;
+			src += n;
+			left -= n;
+			continue;
+		}
+
+		room = fetch->ahead - MIN (fetch->ahead, fetch->end - fetch->pos);
+		if (!room) {
+			g_cond_wait (fetch->cond, fetch->mutex);
+			continue;
+		}
+
+		idx = fetch->end % fetch->size;
+		n = MIN (MIN (room, left), fetch->size - idx);
+
+		memcpy (fetch->ring + idx, src, n);
+		fetch->end += n;
+		if (fetch->end - fetch->base > fetch->size) {
+			fetch->base = fetch->end - fetch->size;
+		}
+
+		src += n;
+		left -= n;
+
+		g_cond_broadcast (fetch->cond);
+	}
+
+	g_mutex_unlock (fetch->mutex);
+
+	return len;
+}
+
+static size_t
+xmms_curl_fetch_callback_header (void *ptr, size_t size, size_t nmemb,
+                                 void *udata)
+{
+	xmms_curl_fetch_t *fetch = udata;
+	const gchar *header = ptr;
+	gsize len = size * nmemb;
+
+	/* only the stream as a whole is interesting, not the ranges of it */
+	if (fetch->stats.requests != 1) {
+		return len;
+	}
+
+	g_mutex_lock (fetch->mutex);
+	if (len >= 5 && g_ascii_strncasecmp (header, "HTTP/", 5) == 0) {
+		/* a new response, e.g. after a redirect */
+		fetch->accept_ranges = FALSE;
+	} else if (len >= 14 && g_ascii_strncasecmp (header, "accept-ranges:", 14) == 0) {
+		fetch->accept_ranges = g_strstr_len (header, len, "bytes") != NULL;
+	}
+	g_mutex_unlock (fetch->mutex);
+
+	if (fetch->header_func) {
+		fetch->header_func (header, len, fetch->udata);
+	}
+
+	return len;
+}
+
+static int
+xmms_curl_fetch_callback_progress (void *udata, double dltotal, double dlnow,
+                                   double ultotal, double ulnow)
+{
+	xmms_curl_fetch_t *fetch = udata;
+	gboolean abort;
+
+	/* lets a stalled transfer be given up when seeking or stopping */
+	g_mutex_lock (fetch->mutex);
+	abort = fetch->quit || fetch->restart;
+	g_mutex_unlock (fetch->mutex);
+
+	return abort;
+}
+
+static gpointer
+xmms_curl_fetch_thread (gpointer udata)
+{
+	xmms_curl_fetch_t *fetch = udata;
+	gchar range[32];
+	GTimeVal start;
+	CURLcode res;
+
+	g_mutex_lock (fetch->mutex);
+
+	while (!fetch->quit) {
+		if (!fetch->restart) {
+			g_cond_wait (fetch->cond, fetch->mutex);
+			continue;
+		}
+
+		fetch->restart = FALSE;
+		fetch->first_data = TRUE;
+		fetch->skip = 0;
+		fetch->stats.requests++;
+
+		if (fetch->request_offset > 0) {
+			g_snprintf (range, sizeof (range), "%" G_GUINT64_FORMAT "-",
+			            fetch->request_offset);
+			curl_easy_setopt (fetch->easy, CURLOPT_RANGE, range);
+		} else {
+			curl_easy_setopt (fetch->easy, CURLOPT_RANGE, NULL);
+		}
+
+		g_mutex_unlock (fetch->mutex);
+
+		fetch->errbuf[0] = '\0';
+		g_get_current_time (&start);
+
+		res = curl_easy_perform (fetch->easy);
+
+		g_mutex_lock (fetch->mutex);
+
+		fetch->stats.transfer_usec += elapsed_usec (&start);
+
+		if (fetch->restart || fetch->quit) {
+			/* given up on purpose, not an error */
+			continue;
+		}
+
+		if (res != CURLE_OK) {
+			fetch->error = g_strdup (fetch->errbuf[0] ? fetch->errbuf
+			                                          : curl_easy_strerror (res));
+		}
+
+		fetch->eof = TRUE;
+		g_cond_broadcast (fetch->cond);
+	}
+
+	g_mutex_unlock (fetch->mutex);
+
+	return NULL;
+}
+
+/**
+ * Start fetching an url in the background.
+ *
+ * @param url the url to fetch
+ * @param readahead how many bytes to buffer ahead of the reader, a
+ * quarter of that is kept behind it for seeking back
+ * @param setup sets the caller's options on the easy handle
+ * @param header sees the headers of the first response
+ * @param udata passed to setup and header
+ * @returns a new fetch, or NULL if the thread couldn't be started
+ */
+xmms_curl_fetch_t *
+xmms_curl_fetch_new (const gchar *url, gsize readahead,
+                     xmms_curl_fetch_setup_func_t setup,
+                     xmms_curl_fetch_header_func_t header, gpointer udata)
+{
+	xmms_curl_fetch_t *fetch;
+
+	g_return_val_if_fail (url, NULL);
+
+	fetch = g_new0 (xmms_curl_fetch_t, 1);
+	fetch->url = g_strdup (url);
+	fetch->host = url_host (url);
+	fetch->ahead = MAX (readahead, XMMS_CURL_FETCH_MIN_SIZE);
+	fetch->size = fetch->ahead + fetch->ahead / 4;
+	fetch->ring = g_malloc (fetch->size);
+	fetch->length = -1;
+	fetch->header_func = header;
+	fetch->udata = udata;
+
+	fetch->easy = pool_take (fetch->host, &fetch->stats.reused);
+	if (!fetch->easy) {
+		g_free (fetch->ring);
+		g_free (fetch->host);
+		g_free (fetch->url);
+		g_free (fetch);
+		return NULL;
+	}
+
+	if (setup) {
+		setup (fetch->easy, udata);
+	}
+
+	/* set last so the caller can't break the machinery */
+	curl_easy_setopt (fetch->easy, CURLOPT_URL, fetch->url);
+	curl_easy_setopt (fetch->easy, CURLOPT_WRITEFUNCTION,
+	                  xmms_curl_fetch_callback_write);
+	curl_easy_setopt (fetch->easy, CURLOPT_WRITEDATA, fetch);
+	curl_easy_setopt (fetch->easy, CURLOPT_HEADERFUNCTION,
+	                  xmms_curl_fetch_callback_header);
+	curl_easy_setopt (fetch->easy, CURLOPT_WRITEHEADER, fetch);
+	curl_easy_setopt (fetch->easy, CURLOPT_NOPROGRESS, 0);
+	curl_easy_setopt (fetch->easy, CURLOPT_PROGRESSFUNCTION,
+	                  xmms_curl_fetch_callback_progress);
+	curl_easy_setopt (fetch->easy, CURLOPT_PROGRESSDATA, fetch);
+	curl_easy_setopt (fetch->easy, CURLOPT_ERRORBUFFER, fetch->errbuf);
+	curl_easy_setopt (fetch->easy, CURLOPT_NOSIGNAL, 1);
+
+	fetch->mutex = g_mutex_new ();
+	fetch->cond = g_cond_new ();
+	fetch->restart = TRUE;
+
+	fetch->thread = g_thread_create (xmms_curl_fetch_thread, fetch, TRUE, NULL);
+	if (!fetch->thread) {
+		fetch->quit = TRUE;
+		xmms_curl_fetch_free (fetch);
+		return NULL;
+	}
+
+	return fetch;
+}
+
+/**
+ * Stop the transfer and free everything. The easy handle is kept for
+ * the next fetch from the same host.
+ */
+void
+xmms_curl_fetch_free (xmms_curl_fetch_t *fetch)
+{
+	g_return_if_fail (fetch);
+
+	if (fetch->thread) {
+		g_mutex_lock (fetch->mutex);
+		fetch->quit = TRUE;
+		g_cond_broadcast (fetch->cond);
+		g_mutex_unlock (fetch->mutex);
+
+		g_thread_join (fetch->thread);
+	}
+
+	pool_release (fetch->easy, fetch->host);
+
+	g_cond_free (fetch->cond);
+	g_mutex_free (fetch->mutex);
+
+	g_free (fetch->error);
+	g_free (fetch->ring);
+	g_free (fetch->host);
+	g_free (fetch->url);
+	g_free (fetch);
+}
+
+/* Called with the lock held */
+static gint
+wait_data (xmms_curl_fetch_t *fetch, gboolean stall)
+{
+	GTimeVal start;
+
+	if (fetch->pos == fetch->end && !fetch->eof) {
+		g_get_current_time (&start);
+
+		while (fetch->pos == fetch->end && !fetch->eof) {
+			g_cond_wait (fetch->cond, fetch->mutex);
+		}
+
+		if (stall) {
+			fetch->stats.stalls++;
+			fetch->stats.stall_usec += elapsed_usec (&start);
+		}
+	}
+
+	if (fetch->pos < fetch->end) {
+		return 1;
+	}
+
+	return fetch->error ? -1 : 0;
+}
+
+/**
+ * Wait until there is data to read, which also means that the headers
+ * of the first response have been seen.
+ *
+ * @param err set to the error message on failure
+ * @returns 1 if there is data, 0 at the end of the stream, -1 on error
+ */
+gint
+xmms_curl_fetch_wait (xmms_curl_fetch_t *fetch, const gchar **err)
+{
+	gint ret;
+
+	g_mutex_lock (fetch->mutex);
+	ret = wait_data (fetch, FALSE);
+	if (ret < 0 && err) {
+		*err = fetch->error;
+	}
+	g_mutex_unlock (fetch->mutex);
+
+	return ret;
+}
+
+/**
+ * Read from the read-ahead buffer, waiting for the network if it is
+ * empty. Might return less than asked for.
+ *
+ * @returns number of bytes read, 0 at the end of the stream, or -1 on
+ * error with err set to the message
+ */
+gint
+xmms_curl_fetch_read (xmms_curl_fetch_t *fetch, gpointer buffer, gint len,
+                      const gchar **err)
+{
+	gsize idx, n;
+	gint ret;
+
+	g_mutex_lock (fetch->mutex);
+
+	ret = wait_data (fetch, TRUE);
+	if (ret > 0) {
+		idx = fetch->pos % fetch->size;
+		n = MIN (MIN ((guint64) len, fetch->end - fetch->pos), fetch->size - idx);
+
+		memcpy (buffer, fetch->ring + idx, n);
+		fetch->pos += n;
+		ret = n;
+
+		/* there's room for the writer again */
+		g_cond_broadcast (fetch->cond);
+	} else if (ret < 0 && err) {
+		*err = fetch->error;
+	}
+
+	g_mutex_unlock (fetch->mutex);
+
+	return ret;
+}
+
+/**
+ * Move the reader to an absolute offset. Offsets still in the ring
+ * are served from there, anything else needs a Range request.
+ *
+ * @returns the new offset, or -1 if it can't be reached
+ */
+gint64
+xmms_curl_fetch_seek (xmms_curl_fetch_t *fetch, gint64 offset)
+{
+	gint64 ret = offset;
+
+	g_mutex_lock (fetch->mutex);
+
+	if (offset >= (gint64) fetch->base && offset <= (gint64) fetch->end) {
+		fetch->pos = offset;
+		fetch->stats.buffered_seeks++;
+		g_cond_broadcast (fetch->cond);
+	} else if (!fetch->seekable || offset < 0 || offset > fetch->length) {
+		ret = -1;
+	} else {
+		fetch->base = fetch->end = fetch->pos = offset;
+
+		g_free (fetch->error);
+		fetch->error = NULL;
+
+		if (offset == fetch->length) {
+			/* nothing left to ask for */
+			fetch->eof = TRUE;
+		} else {
+			fetch->eof = FALSE;
+			fetch->request_offset = offset;
+			fetch->restart = TRUE;
+		}
+
+		g_cond_broadcast (fetch->cond);
+	}
+
+	g_mutex_unlock (fetch->mutex);
+
+	return ret;
+}
+
+gint64
+xmms_curl_fetch_tell (xmms_curl_fetch_t *fetch)
+{
+	gint64 ret;
+
+	g_mutex_lock (fetch->mutex);
+	ret = fetch->pos;
+	g_mutex_unlock (fetch->mutex);
+
+	return ret;
+}
+
+/**
+ * @returns the length of the stream, or -1 if the server didn't say
+ */
+gint64
+xmms_curl_fetch_size (xmms_curl_fetch_t *fetch)
+{
+	gint64 ret;
+
+	g_mutex_lock (fetch->mutex);
+	ret = fetch->length;
+	g_mutex_unlock (fetch->mutex);
+
+	return ret;
+}
+
+/**
+ * @returns whether seeking outside the ring is possible, only known
+ * after #xmms_curl_fetch_wait
+ */
+gboolean
+xmms_curl_fetch_seekable (xmms_curl_fetch_t *fetch)
+{
+	gboolean ret;
+
+	g_mutex_lock (fetch->mutex);
+	ret = fetch->seekable;
+	g_mutex_unlock (fetch->mutex);
+
+	return ret;
+}
+
+void
+xmms_curl_fetch_stats_get (xmms_curl_fetch_t *fetch,
+                           xmms_curl_fetch_stats_t *stats)
+{
+	g_mutex_lock (fetch->mutex);
+	*stats = fetch->stats;
+	g_mutex_unlock (fetch->mutex);
+}
@@ -0,0 +1,70 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __CURL_FETCH_H__
+#define __CURL_FETCH_H__
+
+#include <glib.h>
+#include <curl/curl.h>
+
+typedef struct xmms_curl_fetch_St xmms_curl_fetch_t;
+
+/** Called once with the easy handle before the first request */
+typedef void (*xmms_curl_fetch_setup_func_t) (CURL *easy, gpointer udata);
+
+/**
+ * Called from the fetch thread for every header line of the first
+ * request, before any data of it is made available to the reader.
+ */
+typedef void (*xmms_curl_fetch_header_func_t) (const gchar *header, gsize len,
+                                               gpointer udata);
+
+typedef struct xmms_curl_fetch_stats_St {
+	/** bytes received from the network */
+	guint64 bytes;
+	/** time spent with a request in progress, in microseconds */
+	guint64 transfer_usec;
+	/** reads that had to wait for the network */
+	guint stalls;
+	/** time readers spent waiting, in microseconds */
+	guint64 stall_usec;
+	/** requests made, including the ones for seeking */
+	guint requests;
+	/** seeks that were served from the read-ahead buffer */
+	guint buffered_seeks;
+	/** whether the easy handle came from the connection pool */
+	gboolean reused;
+} xmms_curl_fetch_stats_t;
+
+void xmms_curl_fetch_pool_init (void);
+
+xmms_curl_fetch_t *xmms_curl_fetch_new (const gchar *url, gsize readahead,
+                                        xmms_curl_fetch_setup_func_t setup,
+                                        xmms_curl_fetch_header_func_t header,
+                                        gpointer udata);
+void xmms_curl_fetch_free (xmms_curl_fetch_t *fetch);
+
+gint xmms_curl_fetch_wait (xmms_curl_fetch_t *fetch, const gchar **err);
+gint xmms_curl_fetch_read (xmms_curl_fetch_t *fetch, gpointer buffer, gint len,
+                           const gchar **err);
+gint64 xmms_curl_fetch_seek (xmms_curl_fetch_t *fetch, gint64 offset);
+gint64 xmms_curl_fetch_tell (xmms_curl_fetch_t *fetch);
+gint64 xmms_curl_fetch_size (xmms_curl_fetch_t *fetch);
+gboolean xmms_curl_fetch_seekable (xmms_curl_fetch_t *fetch);
+void xmms_curl_fetch_stats_get (xmms_curl_fetch_t *fetch,
+                                xmms_curl_fetch_stats_t *stats);
+
+#endif
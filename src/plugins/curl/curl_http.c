@@ -28,39 +28,40 @@
 
 #include <curl/curl.h>
 
+#include "curl_fetch.h"
+
 /*
  * Type definitions
  */
 
 typedef struct {
-	CURL *curl_easy;
-	CURLM *curl_multi;
+	xmms_curl_fetch_t *fetch;
 
 	guint meta_offset;
+	gchar *icy_name;
+	gchar *icy_genre;
+	gint content_length;
 
 	gchar *url;
 
 	struct curl_slist *http_200_aliases;
 	struct curl_slist *http_req_headers;
 
-	gchar *buffer;
-	guint bufferpos, bufferlen;
-
-	gint curl_code;
-
-	gboolean done;
-
-	xmms_error_t status;
+	gint verbose;
+	gint connecttimeout;
+	gint readtimeout;
+	const gchar *proxyaddress;
+	gchar proxyuserpass[90];
 
 	gboolean broken_version;
 } xmms_curl_data_t;
 
-typedef void (*handler_func_t) (xmms_xform_t *xform, gchar *header);
+typedef void (*handler_func_t) (xmms_curl_data_t *data, gchar *header);
 
-static void header_handler_contentlength (xmms_xform_t *xform, gchar *header);
-static void header_handler_icy_metaint (xmms_xform_t *xform, gchar *header);
-static void header_handler_icy_name (xmms_xform_t *xform, gchar *header);
-static void header_handler_icy_genre (xmms_xform_t *xform, gchar *header);
+static void header_handler_contentlength (xmms_curl_data_t *data, gchar *header);
+static void header_handler_icy_metaint (xmms_curl_data_t *data, gchar *header);
+static void header_handler_icy_name (xmms_curl_data_t *data, gchar *header);
+static void header_handler_icy_genre (xmms_curl_data_t *data, gchar *header);
 static handler_func_t header_handler_find (gchar *header);
 
 typedef struct {
@@ -84,11 +85,10 @@ handler_t handlers[] = {
 static gboolean xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin);
 static gboolean xmms_curl_init (xmms_xform_t *xform);
 static void xmms_curl_destroy (xmms_xform_t *xform);
-static gint fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, xmms_error_t *error);
 static gint xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len, xmms_error_t *error);
-/* static gint64 xmms_curl_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *error); */
-static size_t xmms_curl_callback_write (void *ptr, size_t size, size_t nmemb, void *stream);
-static size_t xmms_curl_callback_header (void *ptr, size_t size, size_t nmemb, void *stream);
+static gint64 xmms_curl_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *error);
+static void xmms_curl_setup (CURL *easy, gpointer udata);
+static void xmms_curl_callback_header (const gchar *ptr, gsize len, gpointer udata);
 
 static void xmms_curl_free_data (xmms_curl_data_t *data);
 
@@ -110,9 +110,7 @@ xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	methods.init = xmms_curl_init;
 	methods.destroy = xmms_curl_destroy;
 	methods.read = xmms_curl_read;
-	/*
 	methods.seek = xmms_curl_seek;
-	*/
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
@@ -141,6 +139,11 @@ xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	                                            "user", NULL, NULL);
 	xmms_xform_plugin_config_property_register (xform_plugin, "proxypass",
 	                                            "password", NULL, NULL);
+	/* bytes to fetch ahead of the decoder */
+	xmms_xform_plugin_config_property_register (xform_plugin, "readahead",
+	                                            "262144", NULL, NULL);
+
+	xmms_curl_fetch_pool_init ();
 
 	xmms_xform_plugin_indata_add (xform_plugin,
 	                              XMMS_STREAM_TYPE_MIMETYPE,
@@ -168,10 +171,8 @@ xmms_curl_init (xmms_xform_t *xform)
 {
 	xmms_curl_data_t *data;
 	xmms_config_property_t *val;
-	xmms_error_t error;
-	gint metaint, verbose, connecttimeout, readtimeout, useproxy, authproxy;
-	const gchar *proxyaddress, *proxyuser, *proxypass;
-	gchar proxyuserpass[90];
+	gint metaint, useproxy, authproxy, readahead;
+	const gchar *proxyuser, *proxypass, *err = NULL;
 	const gchar *url;
 	curl_version_info_data *version;
 
@@ -181,18 +182,19 @@ xmms_curl_init (xmms_xform_t *xform)
 
 	data = g_new0 (xmms_curl_data_t, 1);
 	data->broken_version = FALSE;
+	data->content_length = -1;
 
 	val = xmms_xform_config_lookup (xform, "connecttimeout");
-	connecttimeout = xmms_config_property_get_int (val);
+	data->connecttimeout = xmms_config_property_get_int (val);
 
 	val = xmms_xform_config_lookup (xform, "readtimeout");
-	readtimeout = xmms_config_property_get_int (val);
+	data->readtimeout = xmms_config_property_get_int (val);
 
 	val = xmms_xform_config_lookup (xform, "shoutcastinfo");
 	metaint = xmms_config_property_get_int (val);
 
 	val = xmms_xform_config_lookup (xform, "verbose");
-	verbose = xmms_config_property_get_int (val);
+	data->verbose = xmms_config_property_get_int (val);
 
 	val = xmms_xform_config_lookup (xform, "useproxy");
 	useproxy = xmms_config_property_get_int (val);
@@ -201,7 +203,9 @@ xmms_curl_init (xmms_xform_t *xform)
 	authproxy = xmms_config_property_get_int (val);
 
 	val = xmms_xform_config_lookup (xform, "proxyaddress");
-	proxyaddress = xmms_config_property_get_string (val);
+	if (useproxy == 1) {
+		data->proxyaddress = xmms_config_property_get_string (val);
+	}
 
 	val = xmms_xform_config_lookup (xform, "proxyuser");
 	proxyuser = xmms_config_property_get_string (val);
@@ -209,10 +213,14 @@ xmms_curl_init (xmms_xform_t *xform)
 	val = xmms_xform_config_lookup (xform, "proxypass");
 	proxypass = xmms_config_property_get_string (val);
 
-	g_snprintf (proxyuserpass, sizeof (proxyuserpass), "%s:%s", proxyuser,
-	            proxypass);
+	val = xmms_xform_config_lookup (xform, "readahead");
+	readahead = xmms_config_property_get_int (val);
+
+	if (useproxy == 1 && authproxy == 1) {
+		g_snprintf (data->proxyuserpass, sizeof (data->proxyuserpass), "%s:%s",
+		            proxyuser, proxypass);
+	}
 
-	data->buffer = g_malloc (CURL_MAX_WRITE_SIZE);
 	data->url = g_strdup (url);
 
 	/* check for broken version of curl here */
@@ -233,67 +241,47 @@ xmms_curl_init (xmms_xform_t *xform)
 		                                            "Icy-MetaData: 1");
 	}
 
-	data->curl_easy = curl_easy_init ();
-
-	curl_easy_setopt (data->curl_easy, CURLOPT_URL, data->url);
-	curl_easy_setopt (data->curl_easy, CURLOPT_HEADER, 0);
-	curl_easy_setopt (data->curl_easy, CURLOPT_HTTPGET, 1);
-	curl_easy_setopt (data->curl_easy, CURLOPT_FOLLOWLOCATION, 1);
-	curl_easy_setopt (data->curl_easy, CURLOPT_AUTOREFERER, 1);
-	curl_easy_setopt (data->curl_easy, CURLOPT_FAILONERROR, 1);
-	curl_easy_setopt (data->curl_easy, CURLOPT_NOPROGRESS, 1);
-	curl_easy_setopt (data->curl_easy, CURLOPT_USERAGENT,
-	                  "XMMS2/" XMMS_VERSION);
-	curl_easy_setopt (data->curl_easy, CURLOPT_WRITEHEADER, xform);
-	curl_easy_setopt (data->curl_easy, CURLOPT_WRITEDATA, xform);
-	curl_easy_setopt (data->curl_easy, CURLOPT_WRITEFUNCTION,
-	                  xmms_curl_callback_write);
-	curl_easy_setopt (data->curl_easy, CURLOPT_HEADERFUNCTION,
-	                  xmms_curl_callback_header);
-	curl_easy_setopt (data->curl_easy, CURLOPT_CONNECTTIMEOUT, connecttimeout);
-	curl_easy_setopt (data->curl_easy, CURLOPT_LOW_SPEED_TIME, readtimeout);
-	curl_easy_setopt (data->curl_easy, CURLOPT_LOW_SPEED_LIMIT, 1);
-
 	if (!data->broken_version) {
 		data->http_200_aliases = curl_slist_append (data->http_200_aliases,
 		                                            "ICY 200 OK");
 		data->http_200_aliases = curl_slist_append (data->http_200_aliases,
 		                                            "ICY 402 Service Unavailabe");
-		curl_easy_setopt (data->curl_easy, CURLOPT_HTTP200ALIASES,
-		                  data->http_200_aliases);
 	}
 
-	if (useproxy == 1) {
-		curl_easy_setopt (data->curl_easy, CURLOPT_PROXY, proxyaddress);
-		if (authproxy == 1) {
-			curl_easy_setopt (data->curl_easy, CURLOPT_PROXYUSERPWD,
-			                  proxyuserpass);
-		}
+	data->fetch = xmms_curl_fetch_new (data->url, MAX (readahead, 0),
+	                                   xmms_curl_setup,
+	                                   xmms_curl_callback_header, data);
+	if (!data->fetch) {
+		xmms_log_error ("Could not start fetching %s", data->url);
+		xmms_curl_free_data (data);
+		return FALSE;
 	}
 
-	curl_easy_setopt (data->curl_easy, CURLOPT_NOSIGNAL, 1);
-	curl_easy_setopt (data->curl_easy, CURLOPT_VERBOSE, verbose);
-	curl_easy_setopt (data->curl_easy, CURLOPT_SSL_VERIFYPEER, 0);
-	curl_easy_setopt (data->curl_easy, CURLOPT_SSL_VERIFYHOST, 0);
-
-	if (data->http_req_headers) {
-		curl_easy_setopt (data->curl_easy, CURLOPT_HTTPHEADER,
-		                  data->http_req_headers);
+	/* wait for the first data to see if it contains shoutcast metadata or not */
+	if (xmms_curl_fetch_wait (data->fetch, &err) <= 0) {
+		/* something went wrong */
+		if (err) {
+			xmms_log_error ("Curl returned error: %s", err);
+		}
+		xmms_curl_free_data (data);
+		return FALSE;
 	}
 
-	data->curl_multi = curl_multi_init ();
-	data->curl_code = CURLM_CALL_MULTI_PERFORM;
+	xmms_xform_private_data_set (xform, data);
 
-	curl_multi_add_handle (data->curl_multi, data->curl_easy);
+	if (data->content_length >= 0) {
+		xmms_xform_metadata_set_int (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE,
+		                             data->content_length);
+	}
 
-	xmms_xform_private_data_set (xform, data);
+	if (data->icy_name) {
+		xmms_xform_metadata_set_str (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_CHANNEL,
+		                             data->icy_name);
+	}
 
-	/* perform initial fill to see if it contains shoutcast metadata or not */
-	if (fill_buffer (xform, data, &error) <= 0) {
-		/* something went wrong */
-		xmms_xform_private_data_set (xform, NULL);
-		xmms_curl_free_data (data);
-		return FALSE;
+	if (data->icy_genre) {
+		xmms_xform_metadata_set_str (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_GENRE,
+		                             data->icy_genre);
 	}
 
 	if (data->meta_offset > 0) {
@@ -314,82 +302,40 @@ xmms_curl_init (xmms_xform_t *xform)
 	return TRUE;
 }
 
-static gint
-fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, xmms_error_t *error)
+static void
+xmms_curl_setup (CURL *easy, gpointer udata)
 {
-	gint handles;
-
-	g_return_val_if_fail (xform, -1);
-	g_return_val_if_fail (data, -1);
-	g_return_val_if_fail (error, -1);
-
-	while (TRUE) {
-		if (data->curl_code == CURLM_OK) {
-			fd_set fdread, fdwrite, fdexcp;
-			struct timeval timeout;
-			gint ret, maxfd;
-			glong milliseconds;
-
-			FD_ZERO (&fdread);
-			FD_ZERO (&fdwrite);
-			FD_ZERO (&fdexcp);
-
-			curl_multi_fdset (data->curl_multi, &fdread, &fdwrite, &fdexcp,
-			                  &maxfd);
-			curl_multi_timeout (data->curl_multi, &milliseconds);
-
-			if (milliseconds <= 0) {
-				milliseconds = 1000;
-			}
-
-			timeout.tv_sec = milliseconds / 1000;
-			timeout.tv_usec = (milliseconds % 1000) * 1000;
-
-			ret = select (maxfd + 1, &fdread, &fdwrite, &fdexcp, &timeout);
-
-			if (ret == -1) {
-				xmms_error_set (error, XMMS_ERROR_GENERIC, "Error select");
-				return -1;
-			}
-		}
-
-		data->curl_code = curl_multi_perform (data->curl_multi, &handles);
-
-		if (data->curl_code != CURLM_CALL_MULTI_PERFORM &&
-		    data->curl_code != CURLM_OK) {
+	xmms_curl_data_t *data = udata;
+
+	curl_easy_setopt (easy, CURLOPT_HEADER, 0);
+	curl_easy_setopt (easy, CURLOPT_HTTPGET, 1);
+	curl_easy_setopt (easy, CURLOPT_FOLLOWLOCATION, 1);
+	curl_easy_setopt (easy, CURLOPT_AUTOREFERER, 1);
+	curl_easy_setopt (easy, CURLOPT_FAILONERROR, 1);
+	curl_easy_setopt (easy, CURLOPT_USERAGENT, "XMMS2/" XMMS_VERSION);
+	curl_easy_setopt (easy, CURLOPT_CONNECTTIMEOUT, data->connecttimeout);
+	curl_easy_setopt (easy, CURLOPT_LOW_SPEED_TIME, data->readtimeout);
+	curl_easy_setopt (easy, CURLOPT_LOW_SPEED_LIMIT, 1);
+
+	if (data->http_200_aliases) {
+		curl_easy_setopt (easy, CURLOPT_HTTP200ALIASES,
+		                  data->http_200_aliases);
+	}
 
-			xmms_error_set (error, XMMS_ERROR_GENERIC,
-			                curl_multi_strerror (data->curl_code));
-			return -1;
+	if (data->proxyaddress) {
+		curl_easy_setopt (easy, CURLOPT_PROXY, data->proxyaddress);
+		if (data->proxyuserpass[0]) {
+			curl_easy_setopt (easy, CURLOPT_PROXYUSERPWD,
+			                  data->proxyuserpass);
 		}
+	}
 
-		/* done */
-		if (handles == 0) {
-			CURLMsg *curlmsg;
-			gint messages;
-
-			do {
-				curlmsg = curl_multi_info_read (data->curl_multi, &messages);
-
-				if (curlmsg == NULL)
-					break;
-
-				if (curlmsg->msg == CURLMSG_DONE && curlmsg->data.result != CURLE_OK) {
-					xmms_log_error ("Curl fill_buffer returned error: (%d) %s",
-					                curlmsg->data.result,
-					                curl_easy_strerror (curlmsg->data.result));
-				} else {
-					XMMS_DBG ("Curl fill_buffer returned unknown message (%d)", curlmsg->msg);
-				}
-			} while (messages > 0);
-
-			data->done = TRUE;
-			return 0;
-		}
+	curl_easy_setopt (easy, CURLOPT_VERBOSE, data->verbose);
+	curl_easy_setopt (easy, CURLOPT_SSL_VERIFYPEER, 0);
+	curl_easy_setopt (easy, CURLOPT_SSL_VERIFYHOST, 0);
 
-		if (data->bufferlen > 0) {
-			return 1;
-		}
+	if (data->http_req_headers) {
+		curl_easy_setopt (easy, CURLOPT_HTTPHEADER, data->http_req_headers);
 	}
 }
 
@@ -398,6 +344,7 @@ xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len,
                 xmms_error_t *error)
 {
 	xmms_curl_data_t *data;
+	const gchar *err = NULL;
 	gint ret;
 
 	g_return_val_if_fail (xform, -1);
@@ -407,29 +354,52 @@ xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len,
 	data = xmms_xform_private_data_get (xform);
 	g_return_val_if_fail (data, -1);
 
-	if (data->done)
-		return 0;
+	ret = xmms_curl_fetch_read (data->fetch, buffer, len, &err);
+	if (ret < 0) {
+		xmms_error_set (error, XMMS_ERROR_GENERIC, err);
+	}
 
-	while (TRUE) {
+	return ret;
+}
 
-		/* if we have data available, just pick it up (even if there's
-		   less bytes available than was requested) */
-		if (data->bufferlen) {
-			len = MIN (len, data->bufferlen);
-			memcpy (buffer, data->buffer, len);
-			data->bufferlen -= len;
-			if (data->bufferlen) {
-				memmove (data->buffer, data->buffer + len, data->bufferlen);
-			}
-			return len;
-		}
+static gint64
+xmms_curl_seek (xmms_xform_t *xform, gint64 offset,
+                xmms_xform_seek_mode_t whence, xmms_error_t *error)
+{
+	xmms_curl_data_t *data;
+	gint64 size;
 
-		ret = fill_buffer (xform, data, error);
+	data = xmms_xform_private_data_get (xform);
+	g_return_val_if_fail (data, -1);
 
-		if (ret == 0 || ret == -1) {
-			return ret;
-		}
+	/* the metadata interleaving depends on the position in the stream */
+	if (data->meta_offset > 0) {
+		xmms_error_set (error, XMMS_ERROR_INVAL, "Can't seek in icy stream");
+		return -1;
 	}
+
+	switch (whence) {
+		case XMMS_XFORM_SEEK_CUR:
+			offset += xmms_curl_fetch_tell (data->fetch);
+			break;
+		case XMMS_XFORM_SEEK_END:
+			size = xmms_curl_fetch_size (data->fetch);
+			if (size < 0) {
+				xmms_error_set (error, XMMS_ERROR_INVAL, "Unknown stream length");
+				return -1;
+			}
+			offset += size;
+			break;
+		case XMMS_XFORM_SEEK_SET:
+			break;
+	}
+
+	offset = xmms_curl_fetch_seek (data->fetch, offset);
+	if (offset < 0) {
+		xmms_error_set (error, XMMS_ERROR_INVAL, "Couldn't seek");
+	}
+
+	return offset;
 }
 
 static void
@@ -449,28 +419,6 @@ xmms_curl_destroy (xmms_xform_t *xform)
  * CURL callback functions
  */
 
-static size_t
-xmms_curl_callback_write (void *ptr, size_t size, size_t nmemb, void *stream)
-{
-	xmms_curl_data_t *data;
-	xmms_xform_t *xform = (xmms_xform_t *) stream;
-	gint len;
-
-	g_return_val_if_fail (xform, 0);
-
-	data = xmms_xform_private_data_get (xform);
-	g_return_val_if_fail (data, 0);
-
-	len = size * nmemb;
-
-	g_return_val_if_fail ((data->bufferlen + len) <= CURL_MAX_WRITE_SIZE, 0);
-
-	memcpy (data->buffer + data->bufferlen, ptr, len);
-	data->bufferlen = data->bufferlen + len;
-
-	return len;
-}
-
 static int
 strlen_no_crlf (char *ptr, int len) {
 	int ep = len - 1;
@@ -482,19 +430,19 @@ strlen_no_crlf (char *ptr, int len) {
 	return ep + 1;
 }
 
-static size_t
-xmms_curl_callback_header (void *ptr, size_t size, size_t nmemb, void *stream)
+static void
+xmms_curl_callback_header (const gchar *ptr, gsize len, gpointer udata)
 {
-	xmms_xform_t *xform = (xmms_xform_t *) stream;
+	xmms_curl_data_t *data = udata;
 	handler_func_t func;
 	gchar *header;
 
-	XMMS_DBG ("%.*s", strlen_no_crlf ((char*)ptr, size * nmemb), (char*)ptr);
+	XMMS_DBG ("%.*s", strlen_no_crlf ((char*)ptr, len), ptr);
 
-	g_return_val_if_fail (xform, 0);
-	g_return_val_if_fail (ptr, 0);
+	g_return_if_fail (data);
+	g_return_if_fail (ptr);
 
-	header = g_strndup ((gchar*)ptr, size * nmemb);
+	header = g_strndup (ptr, len);
 
 	func = header_handler_find (header);
 	if (func != NULL) {
@@ -504,11 +452,10 @@ xmms_curl_callback_header (void *ptr, size_t size, size_t nmemb, void *stream)
 		} else {
 			val = header;
 		}
-		func (xform, val);
+		func (data, val);
 	}
 
 	g_free (header);
-	return size * nmemb;
 }
 
 static handler_func_t
@@ -529,71 +476,61 @@ header_handler_find (gchar *header)
 	return NULL;
 }
 
+/*
+ * The header handlers run on the fetch thread, they only take note of
+ * the values and init picks them up once the first data is in.
+ */
+
 static void
-header_handler_contentlength (xmms_xform_t *xform,
-                              gchar *header)
+header_handler_contentlength (xmms_curl_data_t *data, gchar *header)
 {
-	xmms_curl_data_t *data;
-	int length;
-	const gchar *metakey;
-
-	data = xmms_xform_private_data_get (xform);
-
-	length = strtoul (header, NULL, 10);
-
-	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE,
-	xmms_xform_metadata_set_int (xform, metakey, length);
+	data->content_length = strtoul (header, NULL, 10);
 }
 
 static void
-header_handler_icy_metaint (xmms_xform_t *xform,
-                            gchar *header)
+header_handler_icy_metaint (xmms_curl_data_t *data, gchar *header)
 {
-	xmms_curl_data_t *data;
-
-	data = xmms_xform_private_data_get (xform);
-
 	data->meta_offset = strtoul (header, NULL, 10);
 }
 
 static void
-header_handler_icy_name (xmms_xform_t *xform,
-                         gchar *header)
+header_handler_icy_name (xmms_curl_data_t *data, gchar *header)
 {
-	const gchar *metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_CHANNEL;
-	xmms_xform_metadata_set_str (xform, metakey, header);
+	g_free (data->icy_name);
+	data->icy_name = g_strdup (header);
 }
 
 static void
-header_handler_icy_genre (xmms_xform_t *xform,
-                          gchar *header)
+header_handler_icy_genre (xmms_curl_data_t *data, gchar *header)
 {
-	const gchar *metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_GENRE;
-	xmms_xform_metadata_set_str (xform, metakey, header);
+	g_free (data->icy_genre);
+	data->icy_genre = g_strdup (header);
 }
 
 static void
 xmms_curl_free_data (xmms_curl_data_t *data)
 {
+	xmms_curl_fetch_stats_t stats;
+
 	g_return_if_fail (data);
 
-	curl_multi_cleanup (data->curl_multi);
-	curl_easy_cleanup (data->curl_easy);
+	if (data->fetch) {
+		xmms_curl_fetch_stats_get (data->fetch, &stats);
+		XMMS_DBG ("%s: %" G_GUINT64_FORMAT " bytes in %u request(s) at %.1f KiB/s, "
+		          "%u stall(s) for %" G_GUINT64_FORMAT " ms, %u buffered seek(s)%s",
+		          data->url, stats.bytes, stats.requests,
+		          stats.transfer_usec ? stats.bytes * 1000000.0 / 1024.0 / stats.transfer_usec : 0.0,
+		          stats.stalls, stats.stall_usec / 1000, stats.buffered_seeks,
+		          stats.reused ? ", reused connection" : "");
+
+		xmms_curl_fetch_free (data->fetch);
+	}
 
 	curl_slist_free_all (data->http_200_aliases);
 	curl_slist_free_all (data->http_req_headers);
 
-	g_free (data->buffer);
-
+	g_free (data->icy_name);
+	g_free (data->icy_genre);
 	g_free (data->url);
 	g_free (data);
 }
-
-/*
-static gint64
-xmms_curl_seek (xmms_xform_t *xform, gint64 offset,
-                xmms_xform_seek_mode_t whence, xmms_error_t *error) {
-	xmms_error_set (error, XMMS_ERROR_INVAL, "Couldn't seek");
-	return -1;
-}
-*/
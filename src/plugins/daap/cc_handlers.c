@@ -153,6 +153,21 @@ grab_data (void *container, gchar *data, content_type ct)
 	return offset;
 }
 
+/**
+ * The length of the container at data including its header, limited
+ * to the data that is actually there.
+ */
+static gint
+cc_container_len (gchar *data, gint data_len)
+{
+	gint32 len;
+
+	memcpy (&len, data + DMAP_CC_SZ, DMAP_INT_SZ);
+	endian_swap_int32 (&len);
+
+	return CLAMP (len + 8, 8, data_len);
+}
+
 static gint
 cc_handler_mtco (cc_data_t *fields, gchar *current_data)
 {
@@ -190,7 +205,7 @@ cc_handler_mlit (cc_data_t *fields, gchar *data, gint data_len)
 	cc_item_record_t *item_fields;
 
 	current_data = data + 8;
-	data_end = data + data_len;
+	data_end = data + cc_container_len (data, data_len);
 
 	item_fields = g_new0 (cc_item_record_t, 1);
 
@@ -361,7 +376,8 @@ cc_handler_mlit (cc_data_t *fields, gchar *data, gint data_len)
 
 	fields->record_list = g_slist_prepend (fields->record_list, item_fields);
 
-	return (gint) (current_data - data);
+	/* skip whatever was not understood */
+	return (gint) (data_end - data);
 }
 
 static gint
@@ -371,7 +387,7 @@ cc_handler_mlcl (cc_data_t *fields, gchar *data, gint data_len)
 	gboolean do_break = FALSE;
 	gchar *current_data, *data_end;
 	current_data = data + 8;
-	data_end = data + data_len;
+	data_end = data + cc_container_len (data, data_len);
 
 	while (current_data < data_end && !do_break) {
 		if (CC_TO_INT (current_data[0], current_data[1],
@@ -388,7 +404,35 @@ cc_handler_mlcl (cc_data_t *fields, gchar *data, gint data_len)
 		offset = 0;
 	}
 
-	return (gint)(current_data - data);
+	return (gint) (data_end - data);
+}
+
+static gint
+cc_handler_mudl (cc_data_t *fields, gchar *data, gint data_len)
+{
+	gint offset = 0;
+	gint32 id;
+	gchar *current_data, *data_end;
+
+	current_data = data + 8;
+	data_end = data + cc_container_len (data, data_len);
+
+	while (current_data < data_end) {
+		if (CC_TO_INT (current_data[0], current_data[1],
+		               current_data[2], current_data[3]) ==
+		    CC_TO_INT ('m','i','i','d')) {
+			offset += grab_data (&id, current_data, DMAP_CTYPE_INT);
+			fields->deleted_list = g_slist_prepend (fields->deleted_list,
+			                                        GINT_TO_POINTER (id));
+		} else {
+			break;
+		}
+
+		current_data += offset;
+		offset = 0;
+	}
+
+	return (gint) (data_end - data);
 }
 
 static cc_data_t *
@@ -423,6 +467,10 @@ cc_handler_adbs (gchar *data, gint data_len)
 				offset += cc_handler_mlcl (fields, current_data,
 				                           DMAP_BYTES_REMAINING);
 				break;
+			case CC_TO_INT ('m','u','d','l'):
+				offset += cc_handler_mudl (fields, current_data,
+				                           DMAP_BYTES_REMAINING);
+				break;
 			default:
 				do_break = TRUE;
 				break;
@@ -770,6 +818,7 @@ cc_data_free (cc_data_t *fields)
 	                 (GFunc) cc_item_record_free,
 	                 NULL);
 	g_slist_free (fields->record_list);
+	g_slist_free (fields->deleted_list);
 
 	g_free (fields);
 }
@@ -65,6 +65,9 @@ typedef struct {
 
 	GSList *record_list;
 
+	/* mudl - ids of the items deleted since the requested revision */
+	GSList *deleted_list;
+
 	/* msrv - server info */
 	gint8 has_indexing;
 	gint8 has_extensions;
@@ -17,23 +17,25 @@
 #include "daap_cmd.h"
 #include "daap_conn.h"
 
+static daap_conn_t *
+daap_request (gchar *host, gint port, const gchar *path, guint request_id,
+              daap_response_t *response);
 static cc_data_t *
-daap_request_data (GIOChannel *chan, const gchar *path, gchar *host, guint request_id);
-static gboolean
-daap_request_stream (GIOChannel *chan, gchar *path, gchar *host,
-                     guint request_id, guint *size);
+daap_request_data (gchar *host, gint port, const gchar *path,
+                   guint request_id);
 static gchar *
 daap_url_append_meta (gchar *url, GSList *meta_list);
 
 guint
 daap_command_login (gchar *host, gint port, guint request_id, xmms_error_t *err) {
-	GIOChannel *chan;
-	cc_data_t *cc_data;
+	daap_conn_t *conn;
+	daap_response_t response;
+	cc_data_t *cc_data = NULL;
 
 	guint session_id = 0;
 
-	chan = daap_open_connection (host, port);
-	if (!chan) {
+	conn = daap_request (host, port, "/login", request_id, &response);
+	if (!conn) {
 		xmms_error_set (err, XMMS_ERROR_GENERIC,
 		                "Connection to server failed! "
 		                "Please make sure the url is of the form:\n"
@@ -41,42 +43,35 @@ daap_command_login (gchar *host, gint port, guint request_id, xmms_error_t *err)
 		return 0;
 	}
 
-	cc_data = daap_request_data (chan, "/login", host, request_id);
+	if (response.status == HTTP_OK) {
+		cc_data = daap_conn_handle_data (conn, &response);
+	}
+	daap_conn_release (conn);
+
 	if (cc_data) {
 		session_id = cc_data->session_id;
 		cc_data_free (cc_data);
 	}
 
-	g_io_channel_shutdown (chan, TRUE, NULL);
-	g_io_channel_unref (chan);
-
 	return session_id;
 }
 
 guint
 daap_command_update (gchar *host, gint port, guint session_id, guint request_id)
 {
-	GIOChannel *chan;
 	gchar *request;
 	cc_data_t *cc_data;
 	guint revision_id = 0;
 
-	chan = daap_open_connection (host, port);
-	if (!chan) {
-		return 0;
-	}
-
 	request = g_strdup_printf ("/update?session-id=%d", session_id);
 
-	cc_data = daap_request_data (chan, request, host, request_id);
+	cc_data = daap_request_data (host, port, request, request_id);
 	if (cc_data) {
 		revision_id = cc_data->revision_id;
 		cc_data_free (cc_data);
 	}
 
 	g_free (request);
-	g_io_channel_shutdown (chan, TRUE, NULL);
-	g_io_channel_unref (chan);
 
 	return revision_id;
 }
@@ -84,72 +79,55 @@ daap_command_update (gchar *host, gint port, guint session_id, guint request_id)
 gboolean
 daap_command_logout (gchar *host, gint port, guint session_id, guint request_id)
 {
-	GIOChannel *chan;
+	daap_conn_t *conn;
+	daap_response_t response;
 	gchar *request;
 
-	chan = daap_open_connection (host, port);
-	if (!chan) {
-		return FALSE;
-	}
-
 	request = g_strdup_printf ("/logout?session-id=%d", session_id);
 
 	/* there is no cc_data generated, so we don't need to store it anywhere */
-	daap_request_data (chan, request, host, request_id);
+	conn = daap_request (host, port, request, request_id, &response);
+	daap_conn_release (conn);
 
 	g_free (request);
-	g_io_channel_shutdown (chan, TRUE, NULL);
-	g_io_channel_unref (chan);
 
-	return TRUE;
+	return conn != NULL;
 }
 
 GSList *
 daap_command_db_list (gchar *host, gint port, guint session_id,
                       guint revision_id, guint request_id)
 {
-	GIOChannel *chan;
 	gchar *request;
 	cc_data_t *cc_data;
 	GSList *db_id_list = NULL;
 
-	chan = daap_open_connection (host, port);
-	if (!chan) {
-		return NULL;
-	}
-
 	request = g_strdup_printf ("/databases?session-id=%d&revision-id=%d",
 	                           session_id, revision_id);
 
-	cc_data = daap_request_data (chan, request, host, request_id);
+	cc_data = daap_request_data (host, port, request, request_id);
 	g_free (request);
 	if (cc_data) {
-		db_id_list = cc_record_list_deep_copy (cc_data->record_list);
+		db_id_list = g_slist_reverse (cc_data->record_list);
+		cc_data->record_list = NULL;
 		cc_data_free (cc_data);
 	}
 
-	g_io_channel_shutdown (chan, TRUE, NULL);
-	g_io_channel_unref (chan);
-
 	return db_id_list;
 }
 
 GSList *
 daap_command_song_list (gchar *host, gint port, guint session_id,
-                        guint revision_id, guint request_id, gint db_id)
+                        guint revision_id, guint request_id, gint db_id,
+                        guint delta, gint *total, GSList **deleted,
+                        xmms_error_t *err)
 {
-	GIOChannel *chan;
-	gchar *request;
+	gchar *request, *tmp;
 	cc_data_t *cc_data;
 
 	GSList * song_list;
 	GSList * meta_items = NULL;
 
-	chan = daap_open_connection (host, port);
-	if (!chan) {
-		return NULL;
-	}
-
 	meta_items = g_slist_prepend (meta_items, g_strdup ("dmap.itemid"));
 	meta_items = g_slist_prepend (meta_items, g_strdup ("dmap.itemname"));
 	meta_items = g_slist_prepend (meta_items, g_strdup ("daap.songartist"));
@@ -161,70 +139,121 @@ daap_command_song_list (gchar *host, gint port, guint session_id,
 	                           "session-id=%d&revision-id=%d",
 	                           db_id, session_id, revision_id);
 
+	if (delta) {
+		tmp = request;
+		request = g_strdup_printf ("%s&delta=%u", request, delta);
+		g_free (tmp);
+	}
+
 	if (meta_items) {
 		request = daap_url_append_meta (request, meta_items);
 	}
 
-	cc_data = daap_request_data (chan, request, host, request_id);
-	song_list = cc_record_list_deep_copy (cc_data->record_list);
+	cc_data = daap_request_data (host, port, request, request_id);
 
 	g_free (request);
-	cc_data_free (cc_data);
-	g_io_channel_shutdown (chan, TRUE, NULL);
-	g_io_channel_unref (chan);
 	g_slist_foreach (meta_items, (GFunc) g_free, NULL);
 	g_slist_free (meta_items);
 
+	if (!cc_data) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "Could not list songs");
+		return NULL;
+	}
+
+	/* the handler builds the list back to front */
+	song_list = g_slist_reverse (cc_data->record_list);
+	cc_data->record_list = NULL;
+
+	if (total) {
+		*total = cc_data->n_rec_matches;
+	}
+
+	if (deleted) {
+		*deleted = cc_data->deleted_list;
+		cc_data->deleted_list = NULL;
+	}
+
+	cc_data_free (cc_data);
+
 	return song_list;
 }
 
-GIOChannel *
+daap_conn_t *
 daap_command_init_stream (gchar *host, gint port, guint session_id,
                           guint revision_id, guint request_id,
                           gint dbid, gchar *song, guint *filesize)
 {
-	GIOChannel *chan;
+	daap_conn_t *conn;
+	daap_response_t response;
 	gchar *request;
-	gboolean ok;
-
-	chan = daap_open_connection (host, port);
-	if (!chan) {
-		return NULL;
-	}
 
 	request = g_strdup_printf ("/databases/%d/items%s"
 	                           "?session-id=%d",
 	                           dbid, song, session_id);
 
-	ok = daap_request_stream (chan, request, host, request_id, filesize);
+	conn = daap_request (host, port, request, request_id, &response);
 	g_free (request);
 
-	if (!ok) {
+	if (!conn) {
+		return NULL;
+	}
+
+	if (HTTP_OK != response.status) {
+		daap_conn_free (conn);
 		return NULL;
 	}
 
-	return chan;
+	*filesize = response.content_length;
+
+	return conn;
+}
+
+/**
+ * Send a request and read the header of the response.
+ *
+ * Idle connections from the pool may have been closed by the server
+ * in the meantime without us noticing, so when a reused connection
+ * fails the request is tried again on a new one.
+ */
+static daap_conn_t *
+daap_request (gchar *host, gint port, const gchar *path, guint request_id,
+              daap_response_t *response)
+{
+	daap_conn_t *conn;
+	gboolean reused;
+
+	do {
+		conn = daap_conn_get (host, port);
+		if (!conn) {
+			return NULL;
+		}
+
+		if (daap_conn_send_request (conn, path, host, request_id) &&
+		    daap_conn_receive_header (conn, response)) {
+			return conn;
+		}
+
+		reused = daap_conn_is_reused (conn);
+		daap_conn_free (conn);
+	} while (reused);
+
+	return NULL;
 }
 
 static cc_data_t *
-daap_request_data (GIOChannel *chan, const gchar *path, gchar *host, guint request_id)
+daap_request_data (gchar *host, gint port, const gchar *path,
+                   guint request_id)
 {
-	guint status;
-	gchar *request, *header = NULL;
+	daap_conn_t *conn;
+	daap_response_t response;
 	cc_data_t *retval;
 
-	request = daap_generate_request (path, host, request_id);
-	daap_send_request (chan, request);
-	g_free (request);
-
-	daap_receive_header (chan, &header);
-	if (!header) {
+	conn = daap_request (host, port, path, request_id, &response);
+	if (!conn) {
 		return NULL;
 	}
 
-	status = get_server_status (header);
-
-	switch (status) {
+	switch (response.status) {
 		case UNKNOWN_SERVER_STATUS:
 		case HTTP_BAD_REQUEST:
 		case HTTP_FORBIDDEN:
@@ -234,41 +263,13 @@ daap_request_data (GIOChannel *chan, const gchar *path, gchar *host, guint reque
 			break;
 		case HTTP_OK:
 		default:
-			retval = daap_handle_data (chan, header);
+			retval = daap_conn_handle_data (conn, &response);
 			break;
 	}
-	g_free (header);
-
-	return retval;
-}
-
-static gboolean
-daap_request_stream (GIOChannel *chan, gchar *path, gchar *host,
-                     guint request_id, guint *size)
-{
-	guint status;
-	gchar *request, *header = NULL;
 
-	request = daap_generate_request (path, host, request_id);
-	daap_send_request (chan, request);
-	g_free (request);
+	daap_conn_release (conn);
 
-	daap_receive_header (chan, &header);
-	if (!header) {
-		return FALSE;
-	}
-
-	status = get_server_status (header);
-	if (HTTP_OK != status) {
-		g_free (header);
-		return FALSE;
-	}
-
-	*size = get_data_length (header);
-
-	g_free (header);
-
-	return TRUE;
+	return retval;
 }
 
 static gchar *
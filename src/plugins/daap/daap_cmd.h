@@ -17,6 +17,7 @@
 #define DAAP_CMD_H
 
 #include "cc_handlers.h"
+#include "daap_conn.h"
 #include "xmms/xmms_error.h"
 
 /**
@@ -76,24 +77,35 @@ daap_command_db_list (gchar *host, gint port, guint session_id,
  * Get a list of songs in a database.
  * Issue the command for fetching a list of songs in a database on the server.
  *
+ * If delta is non-zero, only the songs added or changed since that
+ * revision are requested, and the ids of the songs deleted since then
+ * are stored in deleted.  Servers that do not support this send the
+ * full list instead.
+ *
  * @param host host IP of server
  * @param port port that the server uses on host
  * @param session_id the id of the current session
  * @param revision_id the id of the current revision
  * @param request_id the request id
  * @param db_id the database id
+ * @param delta the revision the caller already knows, or 0
+ * @param total where to store the number of songs in the database
+ * @param deleted where to store the list of deleted song ids, may be NULL
+ * @param err error set if the command failed
  * @return a list of songs in the database
  */
 GSList *
 daap_command_song_list (gchar *host, gint port, guint session_id,
-                        guint revision_id, guint request_id, gint db_id);
+                        guint revision_id, guint request_id, gint db_id,
+                        guint delta, gint *total, GSList **deleted,
+                        xmms_error_t *err);
 
 /**
  * Begin streaming a song.
  * Issue the command for streaming a song on the server.
  * NOTE: This command only _begins_ the stream; unlike the other command
- * functions, this one does not close the socket/channel, this must be done
- * manually after reading the data.
+ * functions, this one does not release the connection, this must be done
+ * with daap_conn_release() after reading the data.
  *
  * @param host host IP of server
  * @param port port that the server uses on host
@@ -103,9 +115,9 @@ daap_command_song_list (gchar *host, gint port, guint session_id,
  * @param dbid the database id
  * @param song a string containing the id and file type of the song to stream
  * @param filesize a pointer to an integer that stores the content length 
- * @return: a GIOChannel corresponding to streaming song data
+ * @return: a connection to read the song data from with daap_conn_read()
  */
-GIOChannel *
+daap_conn_t *
 daap_command_init_stream (gchar *host, gint port, guint session_id,
                           guint revision_id, guint request_id,
                           gint dbid, gchar *song, guint *filesize);
@@ -17,6 +17,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -24,52 +25,86 @@
 #include "cc_handlers.h"
 #include "daap_md5.h"
 #include "daap_conn.h"
-#include "daap_util.h"
 
 #include "xmms/xmms_log.h"
-#include "xmmsc/xmmsc_ipc_transport.h"
-#include "xmmsc/xmmsc_ipc_msg.h"
 #include "xmmsc/xmmsc_sockets.h"
 
-GIOChannel *
-daap_open_connection (gchar *host, gint port)
+/**
+ * A connection to a DAAP server.
+ *
+ * Responses are read through a buffer owned by the connection, the
+ * header is parsed in place and whatever follows it is handed out
+ * as body data, so the connection can be used for the next request
+ * once the body has been consumed.
+ */
+struct daap_conn_St {
+	xmms_socket_t fd;
+
+	/** "host:port", the key in the pool */
+	gchar *key;
+
+	/** whether the connection has served a request before */
+	gboolean reused;
+	/** whether the server will keep the connection open */
+	gboolean keep_alive;
+	/** body bytes of the current response not yet read, -1 if unknown */
+	gint64 remaining;
+	/** when the connection was put in the pool */
+	time_t idle_since;
+
+	gsize pos;
+	gsize fill;
+	gchar buf[MAX_HEADER_LENGTH];
+};
+
+static GMutex *pool_lock;
+/* key -> GSList of idle connections, most recently used first */
+static GHashTable *pool;
+
+static gboolean
+daap_conn_wait (xmms_socket_t fd, gboolean write, gint timeout)
 {
-	gint ai_status;
-	gint sockfd;
-	struct sockaddr_in server;
-	struct addrinfo *ai_hint, *ai_result;
-	GIOChannel *sock_chan;
-	GError *err = NULL;
+	fd_set fds;
+	struct timeval tmout;
+	gint ret;
 
-	sockfd = socket (AF_INET, SOCK_STREAM, 0);
-	if (sockfd == -1) {
-		return NULL;
-	}
+	tmout.tv_sec = timeout;
+	tmout.tv_usec = 0;
 
-	sock_chan = g_io_channel_unix_new (sockfd);
-	if (!g_io_channel_get_close_on_unref (sock_chan)) {
-		g_io_channel_set_close_on_unref (sock_chan, TRUE);
-	}
+	FD_ZERO (&fds);
+	FD_SET (fd, &fds);
 
-	g_io_channel_set_flags (sock_chan, G_IO_FLAG_NONBLOCK, &err);
-	if (NULL != err) {
-		XMMS_DBG ("Error setting nonblock flag: %s\n", err->message);
-		g_io_channel_unref (sock_chan);
-		return NULL;
+	if (write) {
+		ret = select (fd + 1, NULL, &fds, NULL, &tmout);
+	} else {
+		ret = select (fd + 1, &fds, NULL, NULL, &tmout);
 	}
 
+	return ret > 0;
+}
+
+static xmms_socket_t
+daap_open_socket (const gchar *host, gint port)
+{
+	gint ai_status;
+	xmms_socket_t sockfd;
+	struct sockaddr_in server;
+	struct addrinfo ai_hint, *ai_result;
+	gint sret;
+	gint err = 0;
+	socklen_t errsize = sizeof (err);
+
 	/* call xmms_getaddrinfo() to convert a hostname to ip */
 
-	ai_hint = g_new0 (struct addrinfo, 1);
+	memset (&ai_hint, 0, sizeof (ai_hint));
 	/* FIXME sometime in the future, we probably want to append
 	 *       " | AF_INET6" for IPv6 support */
-	ai_hint->ai_family = AF_INET;
+	ai_hint.ai_family = AF_INET;
 
-	while ((ai_status = xmms_getaddrinfo (host, NULL, ai_hint, &ai_result))) {
+	while ((ai_status = xmms_getaddrinfo (host, NULL, &ai_hint, &ai_result))) {
 		if (ai_status != EAI_AGAIN) {
 			XMMS_DBG ("Error with getaddrinfo(): %s", gai_strerror (ai_status));
-			g_io_channel_unref (sock_chan);
-			return NULL;
+			return -1;
 		}
 	}
 
@@ -79,69 +114,181 @@ daap_open_connection (gchar *host, gint port)
 	server.sin_family = AF_INET;
 	server.sin_port = htons (port);
 
-	g_free (ai_hint);
 	xmms_freeaddrinfo (ai_result);
 
-	while (42) {
-		fd_set fds;
-		struct timeval tmout;
-		gint sret;
-		gint err = 0;
-		guint errsize = sizeof (err);
+	sockfd = socket (AF_INET, SOCK_STREAM, 0);
+	if (!xmms_socket_valid (sockfd)) {
+		return -1;
+	}
+
+	if (!xmms_socket_set_nonblock (sockfd)) {
+		XMMS_DBG ("Error setting nonblock flag");
+		xmms_socket_close (sockfd);
+		return -1;
+	}
 
-		tmout.tv_sec = 3;
-		tmout.tv_usec = 0;
+	sret = connect (sockfd, (struct sockaddr *) &server,
+	                sizeof (struct sockaddr_in));
+	if (sret == 0) {
+		return sockfd;
+	}
 
-		sret = connect (sockfd,
-		                (struct sockaddr *) &server,
-		                sizeof (struct sockaddr_in));
+	if (xmms_socket_errno () != XMMS_EINPROGRESS) {
+		xmms_log_error ("connect says: %s", strerror (xmms_socket_errno ()));
+		xmms_socket_close (sockfd);
+		return -1;
+	}
 
-		if (sret == 0) {
-			break;
-		} else if (sret == -1 && errno != XMMS_EINPROGRESS) {
-			xmms_log_error ("connect says: %s", strerror (errno));
-			g_io_channel_unref (sock_chan);
-			return NULL;
-		}
+	if (!daap_conn_wait (sockfd, TRUE, DAAP_CONN_TIMEOUT)) {
+		xmms_socket_close (sockfd);
+		return -1;
+	}
 
-		FD_ZERO (&fds);
-		FD_SET (sockfd, &fds);
+	/** Haha, lol lol ololo sockets in POSIX */
+	if (getsockopt (sockfd, SOL_SOCKET, SO_ERROR, (void *) &err, &errsize) < 0 ||
+	    err != 0) {
+		xmms_log_error ("Connect call failed!");
+		xmms_socket_close (sockfd);
+		return -1;
+	}
 
-		sret = select (sockfd + 1, NULL, &fds, NULL, &tmout);
-		if (sret == 0 || sret == SOCKET_ERROR) {
-			g_io_channel_unref (sock_chan);
-			return NULL;
-		}
+	return sockfd;
+}
 
-		/** Haha, lol lol ololo sockets in POSIX */
-		if (getsockopt (sockfd, SOL_SOCKET, SO_ERROR, &err, &errsize) < 0) {
-			g_io_channel_unref (sock_chan);
-			return NULL;
-		}
+/**
+ * Check whether an idle connection is still usable.  A server that
+ * closed its end makes the socket readable, as would any unexpected
+ * data, neither of which leaves the connection fit for a request.
+ */
+static gboolean
+daap_conn_is_alive (daap_conn_t *conn, time_t now)
+{
+	if (now - conn->idle_since > DAAP_CONN_IDLE_TIMEOUT) {
+		return FALSE;
+	}
 
-		if (err != 0) {
-			xmms_log_error ("Connect call failed!");
-			g_io_channel_unref (sock_chan);
-			return NULL;
-		}
+	return !daap_conn_wait (conn->fd, FALSE, 0);
+}
 
-		if (FD_ISSET (sockfd, &fds)) {
-			break;
+void
+daap_conn_pool_init (void)
+{
+	if (!pool_lock) {
+		pool_lock = g_mutex_new ();
+		pool = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	}
+}
+
+/**
+ * Get a connection to a server, an idle one from the pool if there is
+ * one, a new one otherwise.
+ */
+daap_conn_t *
+daap_conn_get (const gchar *host, gint port)
+{
+	daap_conn_t *conn = NULL;
+	GSList *idle, *stale = NULL;
+	gchar *key;
+	time_t now;
+	xmms_socket_t fd;
+
+	key = g_strdup_printf ("%s:%d", host, port);
+	now = time (NULL);
+
+	g_mutex_lock (pool_lock);
+	idle = g_hash_table_lookup (pool, key);
+	while (idle && !conn) {
+		conn = idle->data;
+		idle = g_slist_delete_link (idle, idle);
+		if (!daap_conn_is_alive (conn, now)) {
+			stale = g_slist_prepend (stale, conn);
+			conn = NULL;
 		}
 	}
+	if (idle) {
+		g_hash_table_insert (pool, g_strdup (key), idle);
+	} else {
+		g_hash_table_remove (pool, key);
+	}
+	g_mutex_unlock (pool_lock);
+
+	g_slist_foreach (stale, (GFunc) daap_conn_free, NULL);
+	g_slist_free (stale);
 
-	g_io_channel_set_encoding (sock_chan, NULL, &err);
-	if (NULL != err) {
-		XMMS_DBG ("Error setting encoding: %s\n", err->message);
-		g_io_channel_unref (sock_chan);
+	if (conn) {
+		g_free (key);
+		conn->reused = TRUE;
+		return conn;
+	}
+
+	fd = daap_open_socket (host, port);
+	if (!xmms_socket_valid (fd)) {
+		g_free (key);
 		return NULL;
 	}
 
-	return sock_chan;
+	conn = g_new0 (daap_conn_t, 1);
+	conn->fd = fd;
+	conn->key = key;
+	conn->remaining = -1;
+
+	return conn;
+}
+
+/**
+ * Give a connection back to the pool.  Connections that are in the
+ * middle of a response or that the server is about to close are
+ * freed instead.
+ */
+void
+daap_conn_release (daap_conn_t *conn)
+{
+	GSList *idle;
+
+	if (!conn) {
+		return;
+	}
+
+	if (!conn->keep_alive || conn->remaining != 0 || conn->pos != conn->fill) {
+		daap_conn_free (conn);
+		return;
+	}
+
+	conn->pos = conn->fill = 0;
+	conn->idle_since = time (NULL);
+
+	g_mutex_lock (pool_lock);
+	idle = g_hash_table_lookup (pool, conn->key);
+	if (g_slist_length (idle) >= DAAP_CONN_POOL_SIZE) {
+		g_mutex_unlock (pool_lock);
+		daap_conn_free (conn);
+		return;
+	}
+	idle = g_slist_prepend (idle, conn);
+	g_hash_table_insert (pool, g_strdup (conn->key), idle);
+	g_mutex_unlock (pool_lock);
+}
+
+void
+daap_conn_free (daap_conn_t *conn)
+{
+	if (!conn) {
+		return;
+	}
+
+	xmms_socket_close (conn->fd);
+	g_free (conn->key);
+	g_free (conn);
+}
+
+gboolean
+daap_conn_is_reused (daap_conn_t *conn)
+{
+	return conn->reused;
 }
 
 gchar *
-daap_generate_request (const gchar *path, gchar *host, gint request_id)
+daap_generate_request (const gchar *path, const gchar *host, gint request_id)
 {
 	gchar *req;
 	gint8 hash[33];
@@ -160,102 +307,255 @@ daap_generate_request (const gchar *path, gchar *host, gint request_id)
 	                       "Client-DAAP-Version: 3.0\r\n"
 	                       "Client-DAAP-Validation: %s\r\n"
 	                       "Client-DAAP-Request-ID: %d\r\n"
-	                       "Connection: close\r\n"
+	                       "Connection: keep-alive\r\n"
 	                       "\r\n",
 	                       path, HTTP_VER_STRING, host,
 	                       USER_AGENT, hash, request_id);
 	return req;
 }
 
-void
-daap_send_request (GIOChannel *sock_chan, gchar *request)
+gboolean
+daap_conn_send_request (daap_conn_t *conn, const gchar *path,
+                        const gchar *host, gint request_id)
+{
+	gchar *request;
+	gsize len, sent = 0;
+	gint ret;
+
+	request = daap_generate_request (path, host, request_id);
+	len = strlen (request);
+
+	while (sent < len) {
+		ret = send (conn->fd, request + sent, len - sent, 0);
+		if (ret > 0) {
+			sent += ret;
+		} else if (ret < 0 && xmms_socket_error_recoverable ()) {
+			if (!daap_conn_wait (conn->fd, TRUE, DAAP_CONN_TIMEOUT)) {
+				break;
+			}
+		} else {
+			break;
+		}
+	}
+
+	g_free (request);
+
+	/* a new request invalidates whatever was left of the previous one */
+	conn->pos = conn->fill = 0;
+	conn->remaining = -1;
+
+	return sent == len;
+}
+
+/**
+ * Receive up to len bytes from the socket, waiting for at most
+ * DAAP_CONN_TIMEOUT seconds.
+ *
+ * @return the number of bytes received, 0 on end of stream and -1 on
+ * errors.
+ */
+static gint
+daap_conn_recv (daap_conn_t *conn, gchar *buf, gsize len)
 {
-	gint n_bytes_to_send;
+	gint ret;
 
-	n_bytes_to_send = strlen (request);
+	for (;;) {
+		ret = recv (conn->fd, buf, len, 0);
+		if (ret >= 0) {
+			return ret;
+		}
+
+		if (!xmms_socket_error_recoverable ()) {
+			XMMS_DBG ("Error reading from server: %s",
+			          strerror (xmms_socket_errno ()));
+			return -1;
+		}
 
-	write_buffer_to_channel (sock_chan, request, n_bytes_to_send);
+		if (!daap_conn_wait (conn->fd, FALSE, DAAP_CONN_TIMEOUT)) {
+			XMMS_DBG ("Timed out waiting for the server");
+			return -1;
+		}
+	}
 }
 
-void
-daap_receive_header (GIOChannel *sock_chan, gchar **header)
+static const gchar *
+daap_header_value (const gchar *line, const gchar *end, const gchar *name)
 {
-	guint n_total_bytes_recvd = 0;
-	gsize linelen;
-	gchar *response, *recv_line;
-	GIOStatus io_stat;
-	GError *err = NULL;
+	gsize len = strlen (name);
 
-	if (NULL != header) {
-		*header = NULL;
+	if ((gsize) (end - line) < len || g_ascii_strncasecmp (line, name, len) != 0) {
+		return NULL;
 	}
 
-	response = g_malloc0 (MAX_HEADER_LENGTH);
-	if (NULL == response) {
-		XMMS_DBG ("Error: couldn't allocate memory for response.\n");
-		return;
+	for (line += len; line < end && (*line == ' ' || *line == '\t'); line++);
+
+	return line;
+}
+
+/**
+ * Parse the header in buf[0, len), which ends with an empty line.
+ */
+static gboolean
+daap_parse_header (const gchar *buf, gsize len, daap_response_t *response)
+{
+	const gchar *line, *end, *value, *buf_end = buf + len;
+	gboolean http10;
+
+	response->status = UNKNOWN_SERVER_STATUS;
+	response->content_length = BAD_CONTENT_LENGTH;
+
+	/* status line: HTTP/1.x NNN Reason */
+	if (len < 12 || strncmp (buf, "HTTP/1.", 7) != 0) {
+		return FALSE;
 	}
+	http10 = buf[7] == '0';
+	response->status = atoi (buf + 9);
+
+	/* HTTP/1.1 connections persist unless the server says otherwise */
+	response->keep_alive = !http10;
 
-	/* read data from the io channel one line at a time, looking for
-	 * the end of the header */
-	do {
-		io_stat = g_io_channel_read_line (sock_chan, &recv_line, &linelen,
-		                                  NULL, &err);
-		if (io_stat == G_IO_STATUS_ERROR) {
-			XMMS_DBG ("Error reading from channel: %s\n", err->message);
+	line = memchr (buf, '\n', len) + 1;
+	while (line < buf_end) {
+		end = memchr (line, '\n', buf_end - line);
+		if (!end) {
 			break;
 		}
 
-		if (NULL != recv_line) {
-			memcpy (response+n_total_bytes_recvd, recv_line, linelen);
-			n_total_bytes_recvd += linelen;
-
-			if (strcmp (recv_line, "\r\n") == 0) {
-				g_free (recv_line);
-				if (NULL != header) {
-					*header = g_malloc0 (n_total_bytes_recvd);
-					if (NULL == *header) {
-						XMMS_DBG ("error: couldn't allocate header\n");
-						break;
-					}
-					memcpy (*header, response, n_total_bytes_recvd);
-				}
-				break;
+		if ((value = daap_header_value (line, end, CONTENT_LENGTH))) {
+			response->content_length = atoi (value);
+		} else if ((value = daap_header_value (line, end, CONNECTION))) {
+			if (g_ascii_strncasecmp (value, "close", 5) == 0) {
+				response->keep_alive = FALSE;
+			} else if (g_ascii_strncasecmp (value, "keep-alive", 10) == 0) {
+				response->keep_alive = TRUE;
 			}
+		}
+
+		line = end + 1;
+	}
+
+	return TRUE;
+}
+
+static const gchar *
+daap_find_header_end (const gchar *buf, gsize len)
+{
+	const gchar *p = buf, *end = buf + len;
 
-			g_free (recv_line);
+	while (p + 4 <= end && (p = memchr (p, '\r', end - p - 3))) {
+		if (p[1] == '\n' && p[2] == '\r' && p[3] == '\n') {
+			return p + 4;
 		}
+		p++;
+	}
+
+	return NULL;
+}
 
-		if (io_stat == G_IO_STATUS_EOF) {
+/**
+ * Read and parse the header of a response.  Data following the header
+ * stays in the connection buffer and is returned by #daap_conn_read.
+ */
+gboolean
+daap_conn_receive_header (daap_conn_t *conn, daap_response_t *response)
+{
+	const gchar *end;
+	gsize scanned = 0;
+	gint ret;
+
+	for (;;) {
+		/* the terminator may straddle two reads */
+		end = daap_find_header_end (conn->buf + scanned, conn->fill - scanned);
+		if (end) {
 			break;
 		}
+		scanned = conn->fill > 3 ? conn->fill - 3 : 0;
 
-		if (n_total_bytes_recvd >= MAX_HEADER_LENGTH) {
+		if (conn->fill == sizeof (conn->buf)) {
 			XMMS_DBG ("Warning: Maximum header size reached without finding "
 			          "end of header; bailing.\n");
-			break;
+			return FALSE;
+		}
+
+		ret = daap_conn_recv (conn, conn->buf + conn->fill,
+		                      sizeof (conn->buf) - conn->fill);
+		if (ret <= 0) {
+			return FALSE;
 		}
-	} while (TRUE);
+		conn->fill += ret;
+	}
+
+	if (!daap_parse_header (conn->buf, end - conn->buf, response)) {
+		XMMS_DBG ("Malformed response from server");
+		return FALSE;
+	}
+
+	conn->pos = end - conn->buf;
+	conn->keep_alive = response->keep_alive;
+
+	if (response->status == HTTP_NO_CONTENT) {
+		conn->remaining = 0;
+	} else if (response->content_length != BAD_CONTENT_LENGTH) {
+		conn->remaining = response->content_length;
+	} else {
+		/* the body ends when the server closes the connection */
+		conn->remaining = -1;
+		conn->keep_alive = FALSE;
+	}
 
-	g_free (response);
+	return TRUE;
+}
+
+/**
+ * Read body data of the current response.
+ *
+ * @return the number of bytes read, 0 at the end of the body and -1 on
+ * errors.
+ */
+gint
+daap_conn_read (daap_conn_t *conn, gchar *buf, gint len)
+{
+	gint ret;
 
-	if (sock_chan) {
-		g_io_channel_flush (sock_chan, &err);
-		if (NULL != err) {
-			XMMS_DBG ("Error flushing buffer: %s\n", err->message);
-			return;
+	if (conn->remaining >= 0 && len > conn->remaining) {
+		len = conn->remaining;
+	}
+
+	if (len == 0) {
+		return 0;
+	}
+
+	if (conn->pos < conn->fill) {
+		ret = MIN (len, conn->fill - conn->pos);
+		memcpy (buf, conn->buf + conn->pos, ret);
+		conn->pos += ret;
+	} else {
+		ret = daap_conn_recv (conn, buf, len);
+		if (ret == 0 && conn->remaining > 0) {
+			XMMS_DBG ("Server closed the connection early");
+			ret = -1;
 		}
+		if (ret < 0) {
+			conn->keep_alive = FALSE;
+			return ret;
+		}
+	}
+
+	if (conn->remaining > 0) {
+		conn->remaining -= ret;
 	}
+
+	return ret;
 }
 
 cc_data_t *
-daap_handle_data (GIOChannel *sock_chan, gchar *header)
+daap_conn_handle_data (daap_conn_t *conn, daap_response_t *response)
 {
 	cc_data_t * retval;
-	gint response_length;
+	gint response_length, read_bytes = 0, ret;
 	gchar *response_data;
 
-	response_length = get_data_length (header);
+	response_length = response->content_length;
 
 	if (BAD_CONTENT_LENGTH == response_length) {
 		XMMS_DBG ("warning: Header does not contain a \""CONTENT_LENGTH
@@ -267,51 +567,20 @@ daap_handle_data (GIOChannel *sock_chan, gchar *header)
 		return NULL;
 	}
 
-	response_data = g_malloc0 (response_length);
-	if (NULL == response_data) {
-		XMMS_DBG ("error: could not allocate response memory\n");
-		return NULL;
-	}
+	response_data = g_malloc (response_length);
 
-	read_buffer_from_channel (sock_chan, response_data, response_length);
+	while (read_bytes < response_length) {
+		ret = daap_conn_read (conn, response_data + read_bytes,
+		                      response_length - read_bytes);
+		if (ret <= 0) {
+			g_free (response_data);
+			return NULL;
+		}
+		read_bytes += ret;
+	}
 
 	retval = cc_handler (response_data, response_length);
 	g_free (response_data);
 
 	return retval;
 }
-
-gint
-get_data_length (gchar *header)
-{
-	gint len;
-	gchar *content_length;
-
-	content_length = strstr (header, CONTENT_LENGTH);
-	if (NULL == content_length) {
-		len = BAD_CONTENT_LENGTH;
-	} else {
-		content_length += strlen (CONTENT_LENGTH);
-		len = atoi (content_length);
-	}
-
-	return len;
-}
-
-gint
-get_server_status (gchar *header)
-{
-	gint status;
-	gchar *server_status;
-
-	server_status = strstr (header, HTTP_VER_STRING);
-	if (NULL == server_status) {
-		status = UNKNOWN_SERVER_STATUS;
-	} else {
-		server_status += strlen (HTTP_VER_STRING" ");
-		status = atoi (server_status);
-	}
-
-	return status;
-}
-
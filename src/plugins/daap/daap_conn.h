@@ -16,6 +16,10 @@
 #ifndef DAAP_CONN_H
 #define DAAP_CONN_H
 
+#include <glib.h>
+
+#include "cc_handlers.h"
+
 #define MAX_REQUEST_LENGTH 1024
 #define MAX_HEADER_LENGTH (1024 * 16)
 
@@ -23,6 +27,13 @@
 
 #define DAAP_VERSION 3
 
+/* seconds to wait for a connect or for data from the server */
+#define DAAP_CONN_TIMEOUT 10
+/* seconds an idle keep-alive connection is kept in the pool */
+#define DAAP_CONN_IDLE_TIMEOUT 30
+/* idle connections kept per server */
+#define DAAP_CONN_POOL_SIZE 4
+
 #define HTTP_OK               200
 #define HTTP_NO_CONTENT       204
 #define HTTP_BAD_REQUEST      400
@@ -32,34 +43,49 @@
 
 #define DAAP_URL_PREFIX "daap://"
 #define HTTP_VER_STRING "HTTP/1.1"
-#define CONTENT_LENGTH "Content-Length: "
-#define CONTENT_TYPE "Content-Type: "
+#define CONTENT_LENGTH "Content-Length:"
+#define CONNECTION "Connection:"
 /* TODO does this work ok? */
 #define USER_AGENT "XMMS2 (dev release)"
 /*#define USER_AGENT "iTunes/4.6 (Windows; N)"*/
 
-GIOChannel *
-daap_open_connection (gchar *host, gint port);
+typedef struct daap_conn_St daap_conn_t;
 
-gchar *
-daap_generate_request (const gchar *path, gchar *host, gint request_id);
+typedef struct {
+	gint status;
+	gint content_length;
+	gboolean keep_alive;
+} daap_response_t;
 
 void
-daap_send_request (GIOChannel *sock_chan, gchar *request);
+daap_conn_pool_init (void);
 
-void
-daap_receive_header (GIOChannel *sock_chan, gchar **header);
+daap_conn_t *
+daap_conn_get (const gchar *host, gint port);
 
-cc_data_t *
-daap_handle_data (GIOChannel *sock_chan, gchar *header);
+void
+daap_conn_release (daap_conn_t *conn);
 
 void
-daap_stream_data (GIOChannel *input, GIOChannel *output, gchar *header);
+daap_conn_free (daap_conn_t *conn);
 
-gint
-get_data_length (gchar *header);
+gboolean
+daap_conn_is_reused (daap_conn_t *conn);
+
+gchar *
+daap_generate_request (const gchar *path, const gchar *host, gint request_id);
+
+gboolean
+daap_conn_send_request (daap_conn_t *conn, const gchar *path,
+                        const gchar *host, gint request_id);
+
+gboolean
+daap_conn_receive_header (daap_conn_t *conn, daap_response_t *response);
 
 gint
-get_server_status (gchar *header);
+daap_conn_read (daap_conn_t *conn, gchar *buf, gint len);
+
+cc_data_t *
+daap_conn_handle_data (daap_conn_t *conn, daap_response_t *response);
 
 #endif
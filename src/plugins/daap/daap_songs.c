@@ -0,0 +1,175 @@
+/** @file daap_songs.c
+ *  Incrementally updated song list of a DAAP database.
+ *
+ *  Copyright (C) 2006-2011 XMMS2 Team
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "daap_songs.h"
+#include "daap_cmd.h"
+
+#include "xmms/xmms_log.h"
+
+struct daap_songs_St {
+	gint db_id;
+	guint revision;
+
+	/** cc_item_record_t in the order the server listed them */
+	GQueue *list;
+	/** dbid -> link in list */
+	GHashTable *index;
+};
+
+daap_songs_t *
+daap_songs_new (void)
+{
+	daap_songs_t *songs;
+
+	songs = g_new0 (daap_songs_t, 1);
+	songs->list = g_queue_new ();
+	songs->index = g_hash_table_new (NULL, NULL);
+
+	return songs;
+}
+
+static void
+daap_songs_clear (daap_songs_t *songs)
+{
+	GList *n;
+
+	for (n = songs->list->head; n; n = g_list_next (n)) {
+		cc_item_record_free (n->data);
+	}
+
+	g_queue_clear (songs->list);
+	g_hash_table_remove_all (songs->index);
+}
+
+void
+daap_songs_free (daap_songs_t *songs)
+{
+	daap_songs_clear (songs);
+	g_queue_free (songs->list);
+	g_hash_table_destroy (songs->index);
+	g_free (songs);
+}
+
+/**
+ * Add new songs and replace the ones that changed, taking ownership
+ * of the records.
+ */
+static void
+daap_songs_add (daap_songs_t *songs, GSList *records)
+{
+	cc_item_record_t *record;
+	GList *link;
+	GSList *n;
+
+	for (n = records; n; n = g_slist_next (n)) {
+		record = n->data;
+
+		link = g_hash_table_lookup (songs->index,
+		                            GINT_TO_POINTER (record->dbid));
+		if (link) {
+			cc_item_record_free (link->data);
+			link->data = record;
+		} else {
+			g_queue_push_tail (songs->list, record);
+			g_hash_table_insert (songs->index, GINT_TO_POINTER (record->dbid),
+			                     songs->list->tail);
+		}
+	}
+
+	g_slist_free (records);
+}
+
+static void
+daap_songs_remove (daap_songs_t *songs, GSList *deleted)
+{
+	GList *link;
+	GSList *n;
+
+	for (n = deleted; n; n = g_slist_next (n)) {
+		link = g_hash_table_lookup (songs->index, n->data);
+		if (link) {
+			g_hash_table_remove (songs->index, n->data);
+			cc_item_record_free (link->data);
+			g_queue_delete_link (songs->list, link);
+		}
+	}
+
+	g_slist_free (deleted);
+}
+
+gboolean
+daap_songs_update (daap_songs_t *songs, gchar *host, gint port,
+                   guint session_id, guint revision_id, guint request_id,
+                   gint db_id, xmms_error_t *err)
+{
+	GSList *records, *deleted = NULL;
+	guint delta = 0;
+	gint total = 0;
+
+	if (songs->revision && songs->db_id == db_id) {
+		if (songs->revision == revision_id) {
+			return TRUE;
+		}
+		delta = songs->revision;
+	}
+
+	records = daap_command_song_list (host, port, session_id, revision_id,
+	                                  request_id, db_id, delta, &total,
+	                                  &deleted, err);
+	if (xmms_error_iserror (err)) {
+		return FALSE;
+	}
+
+	if (!delta) {
+		daap_songs_clear (songs);
+	}
+
+	daap_songs_add (songs, records);
+	daap_songs_remove (songs, deleted);
+
+	/* A server that doesn't do deltas sends everything again without
+	 * mentioning what was deleted, start over if the count is off. */
+	if (delta && total != songs->list->length) {
+		XMMS_DBG ("Song list out of sync (%d songs on server, %u known), "
+		          "fetching the whole list", total, songs->list->length);
+		songs->revision = 0;
+		return daap_songs_update (songs, host, port, session_id,
+		                          revision_id, request_id, db_id, err);
+	}
+
+	songs->db_id = db_id;
+	songs->revision = revision_id;
+
+	return TRUE;
+}
+
+guint
+daap_songs_revision (daap_songs_t *songs)
+{
+	return songs->revision;
+}
+
+guint
+daap_songs_length (daap_songs_t *songs)
+{
+	return songs->list->length;
+}
+
+void
+daap_songs_foreach (daap_songs_t *songs, GFunc func, gpointer udata)
+{
+	g_queue_foreach (songs->list, func, udata);
+}
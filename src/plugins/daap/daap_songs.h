@@ -0,0 +1,56 @@
+/** @file daap_songs.h
+ *
+ *  Copyright (C) 2006-2011 XMMS2 Team
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef DAAP_SONGS_H
+#define DAAP_SONGS_H
+
+#include <glib.h>
+
+#include "cc_handlers.h"
+#include "xmms/xmms_error.h"
+
+typedef struct daap_songs_St daap_songs_t;
+
+daap_songs_t *
+daap_songs_new (void);
+
+void
+daap_songs_free (daap_songs_t *songs);
+
+/**
+ * Bring the song list up to date with a revision of a database.
+ * The first call fetches the whole list, later calls only ask for the
+ * changes since the last revision that was fetched, and calls for the
+ * same revision again don't talk to the server at all.
+ *
+ * @return TRUE on success, FALSE otherwise.
+ */
+gboolean
+daap_songs_update (daap_songs_t *songs, gchar *host, gint port,
+                   guint session_id, guint revision_id, guint request_id,
+                   gint db_id, xmms_error_t *err);
+
+/** The revision the list was last updated to, 0 if never */
+guint
+daap_songs_revision (daap_songs_t *songs);
+
+guint
+daap_songs_length (daap_songs_t *songs);
+
+/** Call func for each cc_item_record_t in the list, in server order */
+void
+daap_songs_foreach (daap_songs_t *songs, GFunc func, gpointer udata);
+
+#endif
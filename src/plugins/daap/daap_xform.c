@@ -22,7 +22,8 @@
 #include "xmms/xmms_log.h"
 
 #include "daap_cmd.h"
-#include "daap_util.h"
+#include "daap_conn.h"
+#include "daap_songs.h"
 #include "daap_mdns_browse.h"
 
 #include <stdlib.h>
@@ -39,7 +40,7 @@ typedef struct {
 	gchar *host;
 	guint port;
 
-	GIOChannel *channel;
+	daap_conn_t *conn;
 
 	xmms_error_t status;
 } xmms_daap_data_t;
@@ -50,8 +51,13 @@ typedef struct {
 	guint session_id;
 	guint revision_id;
 	guint request_id;
+
+	/* the database used, 0 until it has been looked up */
+	gint db_id;
+	daap_songs_t *songs;
 } xmms_daap_login_data_t;
 
+static GMutex *login_lock = NULL;
 static GHashTable *login_sessions = NULL;
 
 /*
@@ -157,9 +163,12 @@ xmms_daap_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	}
 
 	if (!login_sessions) {
+		login_lock = g_mutex_new ();
 		login_sessions = g_hash_table_new (g_str_hash, g_str_equal);
 	}
 
+	daap_conn_pool_init ();
+
 	return TRUE;
 }
 
@@ -168,7 +177,7 @@ xmms_daap_plugin_setup (xmms_xform_plugin_t *xform_plugin)
  * Add a song to the browsing list.
  */
 static void
-daap_add_song_to_list (xmms_xform_t *xform, cc_item_record_t *song)
+daap_add_song_to_list (cc_item_record_t *song, xmms_xform_t *xform)
 {
 	gchar *songurl;
 
@@ -197,47 +206,20 @@ daap_add_song_to_list (xmms_xform_t *xform, cc_item_record_t *song)
 
 
 /**
- * Scan a daap server for songs.
+ * Look up the database to use.
  */
 static gboolean
-daap_get_urls_from_server (xmms_xform_t *xform, gchar *host, guint port,
-                           xmms_error_t *err)
+daap_get_db_id (gchar *host, guint port, xmms_daap_login_data_t *login_data)
 {
-	GSList *dbid_list = NULL;
-	GSList *song_list = NULL, *song_el;
-	cc_item_record_t *db_data;
-	xmms_daap_login_data_t *login_data;
-	gchar *hash;
+	GSList *dbid_list;
 
-	hash = g_strdup_printf ("%s:%u", host, port);
-
-	login_data = g_hash_table_lookup (login_sessions, hash);
-
-	if (!login_data) {
-		login_data = g_new0 (xmms_daap_login_data_t, 1);
-
-		login_data->session_id = daap_command_login (host, port, 0, err);
-		if (xmms_error_iserror (err)) {
-			g_free (login_data);
-			return FALSE;
-		}
-
-		login_data->revision_id = daap_command_update (host, port,
-		                                               login_data->session_id,
-		                                               0);
-
-		login_data->request_id = 1;
-		login_data->logged_in = TRUE;
-
-		g_hash_table_insert (login_sessions, hash, login_data);
-	} else {
-		login_data->revision_id = daap_command_update (host, port,
-		                                               login_data->session_id,
-		                                               0);
+	if (login_data->db_id) {
+		return TRUE;
 	}
 
 	dbid_list = daap_command_db_list (host, port, login_data->session_id,
-	                                  login_data->revision_id, 0);
+	                                  login_data->revision_id,
+	                                  login_data->request_id);
 	if (!dbid_list) {
 		return FALSE;
 	}
@@ -245,26 +227,95 @@ daap_get_urls_from_server (xmms_xform_t *xform, gchar *host, guint port,
 	/* XXX i've never seen more than one db per server out in the wild,
 	 *     let's hope that never changes *wink*
 	 *     just use the first db in the list */
-	db_data = (cc_item_record_t *) dbid_list->data;
-	song_list = daap_command_song_list (host, port, login_data->session_id,
-	                                    login_data->revision_id,
-	                                    0, db_data->dbid);
+	login_data->db_id = ((cc_item_record_t *) dbid_list->data)->dbid;
 
 	g_slist_foreach (dbid_list, (GFunc) cc_item_record_free, NULL);
 	g_slist_free (dbid_list);
 
-	if (!song_list) {
-		return FALSE;
+	return TRUE;
+}
+
+/**
+ * Get the login data for a server, logging in if necessary.
+ * Must be called with login_lock held.
+ */
+static xmms_daap_login_data_t *
+daap_get_login_data (gchar *host, guint port, xmms_error_t *err)
+{
+	xmms_daap_login_data_t *login_data;
+	gchar *hash;
+
+	hash = g_strdup_printf ("%s:%u", host, port);
+
+	login_data = g_hash_table_lookup (login_sessions, hash);
+	if (login_data) {
+		g_free (hash);
+		return login_data;
 	}
 
-	for (song_el = song_list; song_el; song_el = g_slist_next (song_el)) {
-		daap_add_song_to_list (xform, song_el->data);
+	XMMS_DBG ("creating login data for %s", hash);
+	login_data = g_new0 (xmms_daap_login_data_t, 1);
+
+	login_data->request_id = 1;
+	login_data->session_id = daap_command_login (host, port,
+	                                             login_data->request_id,
+	                                             err);
+	if (xmms_error_iserror (err)) {
+		g_free (login_data);
+		g_free (hash);
+		return NULL;
 	}
 
-	g_slist_foreach (song_list, (GFunc) cc_item_record_free, NULL);
-	g_slist_free (song_list);
+	login_data->logged_in = TRUE;
+	login_data->songs = daap_songs_new ();
 
-	return TRUE;
+	g_hash_table_insert (login_sessions, hash, login_data);
+
+	return login_data;
+}
+
+/**
+ * Scan a daap server for songs.
+ *
+ * The song list of every server is kept between scans, and only the
+ * changes since the previous scan are fetched.
+ */
+static gboolean
+daap_get_urls_from_server (xmms_xform_t *xform, gchar *host, guint port,
+                           xmms_error_t *err)
+{
+	xmms_daap_login_data_t *login_data;
+	gboolean ret = FALSE;
+
+	g_mutex_lock (login_lock);
+
+	login_data = daap_get_login_data (host, port, err);
+	if (!login_data) {
+		goto out;
+	}
+
+	login_data->revision_id = daap_command_update (host, port,
+	                                               login_data->session_id,
+	                                               0);
+
+	if (!daap_get_db_id (host, port, login_data)) {
+		goto out;
+	}
+
+	if (!daap_songs_update (login_data->songs, host, port,
+	                        login_data->session_id, login_data->revision_id,
+	                        0, login_data->db_id, err)) {
+		goto out;
+	}
+
+	daap_songs_foreach (login_data->songs, (GFunc) daap_add_song_to_list,
+	                    xform);
+	ret = TRUE;
+
+out:
+	g_mutex_unlock (login_lock);
+
+	return ret;
 }
 
 
@@ -275,14 +326,12 @@ daap_get_urls_from_server (xmms_xform_t *xform, gchar *host, guint port,
 static gboolean
 xmms_daap_init (xmms_xform_t *xform)
 {
-	gint dbid;
-	GSList *dbid_list = NULL;
 	xmms_daap_data_t *data;
 	xmms_daap_login_data_t *login_data;
 	xmms_error_t err;
 	const gchar *url;
 	const gchar *metakey;
-	gchar *command, *hash;
+	gchar *command = NULL;
 	guint filesize;
 
 	g_return_val_if_fail (xform, FALSE);
@@ -299,51 +348,34 @@ xmms_daap_init (xmms_xform_t *xform)
 		goto init_error;
 	}
 
-	hash = g_strdup_printf ("%s:%u", data->host, data->port);
+	g_mutex_lock (login_lock);
 
-	login_data = g_hash_table_lookup (login_sessions, hash);
+	login_data = daap_get_login_data (data->host, data->port, &err);
 	if (!login_data) {
-		XMMS_DBG ("creating login data for %s", hash);
-		login_data = g_new0 (xmms_daap_login_data_t, 1);
-
-		login_data->request_id = 1;
-		login_data->logged_in = TRUE;
-
-		login_data->session_id = daap_command_login (data->host, data->port,
-		                                             login_data->request_id,
-		                                             &err);
-		if (xmms_error_iserror (&err)) {
-			g_free (login_data);
-			goto init_error;
-		}
-
-		g_hash_table_insert (login_sessions, hash, login_data);
+		goto init_error_locked;
 	}
 
 	login_data->revision_id = daap_command_update (data->host, data->port,
 	                                               login_data->session_id,
 	                                               login_data->request_id);
-	dbid_list = daap_command_db_list (data->host, data->port,
-	                                  login_data->session_id,
-	                                  login_data->revision_id,
-	                                  login_data->request_id);
-	if (!dbid_list) {
-		goto init_error;
+	if (!daap_get_db_id (data->host, data->port, login_data)) {
+		goto init_error_locked;
 	}
 
-	/* XXX: see XXX in the browse function above */
-	dbid = ((cc_item_record_t *) dbid_list->data)->dbid;
 	/* want to request a stream, but don't read the data yet */
-	data->channel = daap_command_init_stream (data->host, data->port,
-	                                          login_data->session_id,
-	                                          login_data->revision_id,
-	                                          login_data->request_id, dbid,
-	                                          command, &filesize);
-	if (! data->channel) {
-		goto init_error;
+	data->conn = daap_command_init_stream (data->host, data->port,
+	                                       login_data->session_id,
+	                                       login_data->revision_id,
+	                                       login_data->request_id,
+	                                       login_data->db_id,
+	                                       command, &filesize);
+	if (! data->conn) {
+		goto init_error_locked;
 	}
 	login_data->request_id++;
 
+	g_mutex_unlock (login_lock);
+
 	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE;
 	xmms_xform_metadata_set_int (xform, metakey, filesize);
 
@@ -354,18 +386,19 @@ xmms_daap_init (xmms_xform_t *xform)
 	                             "application/octet-stream",
 	                             XMMS_STREAM_TYPE_END);
 
-	g_slist_foreach (dbid_list, (GFunc) cc_item_record_free, NULL);
-	g_slist_free (dbid_list);
 	g_free (command);
 
 	return TRUE;
 
+init_error_locked:
+	g_mutex_unlock (login_lock);
 init_error:
 	if (data) {
 		if (data->host)
 			g_free (data->host);
 		g_free (data);
 	}
+	g_free (command);
 	return FALSE;
 }
 
@@ -376,8 +409,8 @@ xmms_daap_destroy (xmms_xform_t *xform)
 
 	data = xmms_xform_private_data_get (xform);
 
-	g_io_channel_shutdown (data->channel, TRUE, NULL);
-	g_io_channel_unref (data->channel);
+	/* the connection is reused if the song was read to the end */
+	daap_conn_release (data->conn);
 
 	g_free (data->host);
 	g_free (data);
@@ -387,21 +420,17 @@ static gint
 xmms_daap_read (xmms_xform_t *xform, void *buffer, gint len, xmms_error_t *error)
 {
 	xmms_daap_data_t *data;
-	gsize read_bytes = 0;
-	GIOStatus status;
+	gint ret;
 
 	data = xmms_xform_private_data_get (xform);
 
 	/* request is performed, header is stripped. now read the data. */
-	while (read_bytes == 0) {
-		status = g_io_channel_read_chars (data->channel, buffer, len,
-		                                  &read_bytes, NULL);
-		if (status == G_IO_STATUS_EOF || status == G_IO_STATUS_ERROR) {
-			break;
-		}
+	ret = daap_conn_read (data->conn, buffer, len);
+	if (ret < 0) {
+		xmms_error_set (error, XMMS_ERROR_GENERIC, "Error reading from server");
 	}
 
-	return read_bytes;
+	return ret;
 }
 
 
@@ -22,7 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include "iir.h"
+#include "eq_iir.h"
 
 #define EQ_BANDS_LEGACY 10
 
@@ -45,6 +45,8 @@ typedef struct xmms_equalizer_priv_St {
 	xmms_config_property_t *gain[EQ_MAX_BANDS];
 	xmms_config_property_t *legacy[EQ_BANDS_LEGACY];
 	gboolean enabled;
+	gint channels;
+	xmms_eq_iir_t *iir;
 } xmms_equalizer_data_t;
 
 XMMS_XFORM_PLUGIN ("equalizer",
@@ -133,7 +135,8 @@ xmms_eq_init (xmms_xform_t *xform)
 {
 	xmms_equalizer_data_t *priv;
 	xmms_config_property_t *config;
-	gint i, j, srate;
+	xmms_eq_iir_impl_t impl;
+	gint i, srate;
 	gfloat gain;
 
 	g_return_val_if_fail (xform, FALSE);
@@ -143,6 +146,13 @@ xmms_eq_init (xmms_xform_t *xform)
 
 	xmms_xform_private_data_set (xform, priv);
 
+	/* before any callback is set up that could use it */
+	impl = xmms_eq_iir_impl_best ();
+	srate = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+	priv->channels = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
+	priv->iir = xmms_eq_iir_new (srate, priv->channels, impl);
+	g_return_val_if_fail (priv->iir, FALSE);
+
 	config = xmms_xform_config_lookup (xform, "enabled");
 	g_return_val_if_fail (config, FALSE);
 	xmms_config_property_callback_set (config, xmms_eq_config_changed, priv);
@@ -167,10 +177,7 @@ xmms_eq_init (xmms_xform_t *xform)
 	g_return_val_if_fail (config, FALSE);
 	xmms_config_property_callback_set (config, xmms_eq_gain_changed, priv);
 	gain = xmms_config_property_get_float (config);
-
-	for (i=0; i<EQ_CHANNELS; i++) {
-		set_preamp (i, xmms_eq_gain_scale (gain, TRUE));
-	}
+	xmms_eq_iir_preamp_set (priv->iir, xmms_eq_gain_scale (gain, TRUE));
 
 	for (i=0; i<EQ_BANDS_LEGACY; i++) {
 		gchar buf[16];
@@ -184,9 +191,7 @@ xmms_eq_init (xmms_xform_t *xform)
 
 		gain = xmms_config_property_get_float (config);
 		if (priv->use_legacy) {
-			for (j = 0; j < EQ_CHANNELS; j++) {
-				set_gain (i, j, xmms_eq_gain_scale (gain, FALSE));
-			}
+			xmms_eq_iir_gain_set (priv->iir, i, xmms_eq_gain_scale (gain, FALSE));
 		}
 	}
 
@@ -202,23 +207,20 @@ xmms_eq_init (xmms_xform_t *xform)
 
 		gain = xmms_config_property_get_float (config);
 		if (!priv->use_legacy) {
-			for (j = 0; j < EQ_CHANNELS; j++) {
-				set_gain (i, j, xmms_eq_gain_scale (gain, FALSE));
-			}
+			xmms_eq_iir_gain_set (priv->iir, i, xmms_eq_gain_scale (gain, FALSE));
 		}
 	}
 
-	init_iir ();
-	srate = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
 	if (priv->use_legacy) {
-		config_iir (srate, EQ_BANDS_LEGACY, 1);
+		xmms_eq_iir_bands_set (priv->iir, EQ_BANDS_LEGACY, TRUE);
 	} else {
-		config_iir (srate, priv->bands, 0);
+		xmms_eq_iir_bands_set (priv->iir, priv->bands, FALSE);
 	}
 
 	xmms_xform_outdata_type_copy (xform);
 
-	XMMS_DBG ("Equalizer initialized successfully!");
+	XMMS_DBG ("Equalizer initialized successfully, using %s filters!",
+	          xmms_eq_iir_impl_name (impl));
 
 	return TRUE;
 }
@@ -227,7 +229,7 @@ static void
 xmms_eq_destroy (xmms_xform_t *xform)
 {
 	xmms_config_property_t *config;
-	gpointer priv;
+	xmms_equalizer_data_t *priv;
 	gchar buf[16];
 	gint i;
 
@@ -262,6 +264,7 @@ xmms_eq_destroy (xmms_xform_t *xform)
 		xmms_config_property_callback_remove (config, xmms_eq_gain_changed, priv);
 	}
 
+	xmms_eq_iir_free (priv->iir);
 	g_free (priv);
 }
 
@@ -270,7 +273,7 @@ xmms_eq_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
               xmms_error_t *error)
 {
 	xmms_equalizer_data_t *priv;
-	gint read, chan;
+	gint read;
 
 	g_return_val_if_fail (xform, -1);
 
@@ -278,9 +281,9 @@ xmms_eq_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
 	g_return_val_if_fail (priv, -1);
 
 	read = xmms_xform_read (xform, buf, len, error);
-	chan = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
 	if (read > 0 && priv->enabled) {
-		iir (buf, read, chan, priv->extra_filtering);
+		xmms_eq_iir_process (priv->iir, buf, read / (2 * priv->channels),
+		                     priv->extra_filtering);
 	}
 
 	return read;
@@ -299,7 +302,6 @@ xmms_eq_gain_changed (xmms_object_t *object, xmmsv_t *_data,
 	xmms_config_property_t *val;
 	xmms_equalizer_data_t *priv;
 	const gchar *name;
-	gint i;
 	gfloat gain;
 
 	g_return_if_fail (object);
@@ -331,9 +333,7 @@ xmms_eq_gain_changed (xmms_object_t *object, xmmsv_t *_data,
 
 	if (!strcmp (name, "preamp")) {
 		/* scale the -20.0 - 20.0 value to correct one */
-		for (i=0; i<EQ_CHANNELS; i++) {
-			set_preamp (i, xmms_eq_gain_scale (gain, TRUE));
-		}
+		xmms_eq_iir_preamp_set (priv->iir, xmms_eq_gain_scale (gain, TRUE));
 	} else {
 		gint band = -1;
 
@@ -343,11 +343,9 @@ xmms_eq_gain_changed (xmms_object_t *object, xmmsv_t *_data,
 			band = atoi (name + 6);
 		}
 
-		if (band >= 0) {
+		if (band >= 0 && band < EQ_MAX_BANDS) {
 			/* scale the -20.0 - 20.0 value to correct one */
-			for (i=0; i<EQ_CHANNELS; i++) {
-				set_gain (band, i, xmms_eq_gain_scale (gain, FALSE));
-			}
+			xmms_eq_iir_gain_set (priv->iir, band, xmms_eq_gain_scale (gain, FALSE));
 		}
 	}
 }
@@ -358,7 +356,7 @@ xmms_eq_config_changed (xmms_object_t * object, xmmsv_t *_data, gpointer userdat
 	xmms_config_property_t *val;
 	xmms_equalizer_data_t *priv;
 	const gchar *name;
-	gint value, i, j;
+	gint value, i;
 
 	g_return_if_fail (object);
 	g_return_if_fail (userdata);
@@ -388,17 +386,15 @@ xmms_eq_config_changed (xmms_object_t * object, xmmsv_t *_data, gpointer userdat
 		if (priv->use_legacy) {
 			for (i=0; i<EQ_BANDS_LEGACY; i++) {
 				gain = xmms_config_property_get_float (priv->legacy[i]);
-				for (j=0; j<EQ_CHANNELS; j++) {
-					set_gain (j, i, xmms_eq_gain_scale (gain, FALSE));
-				}
+				xmms_eq_iir_gain_set (priv->iir, i, xmms_eq_gain_scale (gain, FALSE));
 			}
+			xmms_eq_iir_bands_set (priv->iir, EQ_BANDS_LEGACY, TRUE);
 		} else {
 			for (i=0; i<priv->bands; i++) {
 				gain = xmms_config_property_get_float (priv->gain[i]);
-				for (j=0; j<EQ_CHANNELS; j++) {
-					set_gain (j, i, xmms_eq_gain_scale (gain, FALSE));
-				}
+				xmms_eq_iir_gain_set (priv->iir, i, xmms_eq_gain_scale (gain, FALSE));
 			}
+			xmms_eq_iir_bands_set (priv->iir, priv->bands, FALSE);
 		}
 	} else if (!strcmp (name, "bands")) {
 		if (value != 10 && value != 15 && value != 25 && value != 31) {
@@ -412,11 +408,12 @@ xmms_eq_config_changed (xmms_object_t * object, xmmsv_t *_data, gpointer userdat
 			for (i=0; i<EQ_MAX_BANDS; i++) {
 				xmms_config_property_set_data (priv->gain[i], "0.0");
 				if (!priv->use_legacy) {
-					for (j=0; j<EQ_CHANNELS; j++) {
-						set_gain (j, i, xmms_eq_gain_scale (0.0, FALSE));
-					}
+					xmms_eq_iir_gain_set (priv->iir, i, xmms_eq_gain_scale (0.0, FALSE));
 				}
 			}
+			if (!priv->use_legacy) {
+				xmms_eq_iir_bands_set (priv->iir, priv->bands, FALSE);
+			}
 		}
 	}
 }
@@ -0,0 +1,492 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2006-2011 XMMS2 Team
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * @file
+ * The equalizer's IIR filter bank.
+ *
+ * Based on the PCM time-domain equalizer by Felipe Rivera, every band
+ * is a filter
+ *
+ *   y(n) = alpha * (x(n) - x(n-2)) + gamma * y(n-1) - beta * y(n-2)
+ *
+ * whose output is added up with the band's gain, optionally running
+ * the sum through all the filters once more.
+ *
+ * The samples are handled a block at a time, one channel after the
+ * other. All bands get the same input, so they are computed several at
+ * a time where the compiler has vector extensions, using the vector
+ * unit every CPU of the architecture has or AVX2 on x86 CPUs that
+ * support it, picked at runtime.
+ *
+ * Changes don't take effect at once, as that would be heard as a
+ * click. New gains are moved to over RAMP_FRAMES, and when the bands
+ * change the old filters keep running for FADE_FRAMES while their
+ * output is faded over to that of the new ones.
+ */
+
+#include "xmms_configuration.h"
+#include "eq_iir.h"
+#include "iir_cfs.h"
+
+#include <string.h>
+
+#define BLOCK_FRAMES 256
+#define RAMP_FRAMES 512
+#define FADE_FRAMES 1024
+#define DITHER_SIZE 256
+
+typedef struct xmms_eq_iir_bank_St {
+	xmms_eq_iir_coeffs_t cf;
+	/** two filter stages per channel */
+	xmms_eq_iir_history_t *hist;
+} xmms_eq_iir_bank_t;
+
+struct xmms_eq_iir_St {
+	gint srate;
+	gint channels;
+	xmms_eq_iir_func_t func;
+
+	/* what the config callbacks change, protected by mutex */
+	GMutex *mutex;
+	gdouble target_gain[EQ_BANDS_PADDED];
+	gdouble target_preamp;
+	xmms_eq_iir_bank_t *pending;
+	gboolean dirty;
+
+	/* only used from xmms_eq_iir_process */
+	gboolean started;
+	xmms_eq_iir_bank_t *bank;
+	xmms_eq_iir_bank_t *old_bank;
+	gint fade_left;
+
+	gdouble gain[EQ_BANDS_PADDED];
+	gdouble gain_step[EQ_BANDS_PADDED];
+	gdouble gain_end[EQ_BANDS_PADDED];
+	gdouble preamp;
+	gdouble preamp_step;
+	gdouble preamp_end;
+	gint ramp_left;
+
+	/* noise that keeps the filters out of denormal numbers */
+	gdouble dither[DITHER_SIZE];
+	gint di;
+
+	gdouble in[BLOCK_FRAMES];
+	gdouble out[BLOCK_FRAMES];
+	gdouble old_out[BLOCK_FRAMES];
+};
+
+static gdouble
+filter_scalar (const xmms_eq_iir_coeffs_t *cf, xmms_eq_iir_history_t *h,
+               const gdouble *gain, const gdouble *step, gint i, gdouble x)
+{
+	gdouble *y1 = h->y[h->cur], *y2 = h->y[!h->cur];
+	gdouble dx = x - h->x2, acc = 0.0, g;
+	gint b;
+
+	for (b = 0; b < cf->bands; b++) {
+		/* y(n) goes where y(n-2) was */
+		y2[b] = cf->alpha[b] * dx + cf->gamma[b] * y1[b] - cf->beta[b] * y2[b];
+
+		g = gain[b];
+		if (step) {
+			g += step[b] * i;
+		}
+		acc += y2[b] * g;
+	}
+
+	h->cur = !h->cur;
+	h->x2 = h->x1;
+	h->x1 = x;
+
+	return acc;
+}
+
+static void
+apply_scalar (const xmms_eq_iir_coeffs_t *cf, xmms_eq_iir_history_t *hist,
+              const gdouble *gain, const gdouble *step,
+              const gdouble *in, gdouble *out, gint frames,
+              gboolean extra_filtering)
+{
+	gint i;
+
+	for (i = 0; i < frames; i++) {
+		out[i] = filter_scalar (cf, &hist[0], gain, step, i, in[i]);
+		if (extra_filtering) {
+			out[i] += filter_scalar (cf, &hist[1], gain, step, i, out[i]);
+		}
+	}
+}
+
+#ifdef HAVE_VECTOR_EXTENSIONS
+
+#define EQ_BYTES 16
+#define EQ_NAME(n) vector_##n
+#define EQ_TARGET
+#include "eq_iir_kernels.h"
+#undef EQ_BYTES
+#undef EQ_NAME
+#undef EQ_TARGET
+
+#ifdef HAVE_CPU_DISPATCH
+#define EQ_BYTES 32
+#define EQ_NAME(n) avx2_##n
+#define EQ_TARGET __attribute__ ((target ("avx2")))
+#include "eq_iir_kernels.h"
+#undef EQ_BYTES
+#undef EQ_NAME
+#undef EQ_TARGET
+#endif
+
+#endif
+
+/**
+ * The fastest implementation the CPU we're running on supports.
+ */
+xmms_eq_iir_impl_t
+xmms_eq_iir_impl_best (void)
+{
+#ifdef HAVE_CPU_DISPATCH
+	if (__builtin_cpu_supports ("avx2")) {
+		return XMMS_EQ_IIR_IMPL_AVX2;
+	}
+#endif
+
+#ifdef HAVE_VECTOR_EXTENSIONS
+	return XMMS_EQ_IIR_IMPL_VECTOR;
+#else
+	return XMMS_EQ_IIR_IMPL_SCALAR;
+#endif
+}
+
+const gchar *
+xmms_eq_iir_impl_name (xmms_eq_iir_impl_t impl)
+{
+	switch (impl) {
+		case XMMS_EQ_IIR_IMPL_SCALAR:
+			return "scalar";
+		case XMMS_EQ_IIR_IMPL_VECTOR:
+			return "vector";
+		case XMMS_EQ_IIR_IMPL_AVX2:
+			return "avx2";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * Look up the filter function of an implementation.
+ *
+ * @returns the function, or NULL if impl is better than what
+ * #xmms_eq_iir_impl_best returns.
+ */
+xmms_eq_iir_func_t
+xmms_eq_iir_func (xmms_eq_iir_impl_t impl)
+{
+	if (impl > xmms_eq_iir_impl_best ()) {
+		return NULL;
+	}
+
+	switch (impl) {
+		case XMMS_EQ_IIR_IMPL_SCALAR:
+			return apply_scalar;
+#ifdef HAVE_VECTOR_EXTENSIONS
+		case XMMS_EQ_IIR_IMPL_VECTOR:
+			return vector_apply;
+#ifdef HAVE_CPU_DISPATCH
+		case XMMS_EQ_IIR_IMPL_AVX2:
+			return avx2_apply;
+#endif
+#endif
+		default:
+			return NULL;
+	}
+}
+
+static gpointer
+xmms_eq_iir_calc_coeffs (gpointer data)
+{
+	calc_coeffs ();
+	return NULL;
+}
+
+static xmms_eq_iir_bank_t *
+xmms_eq_iir_bank_new (gint srate, gint channels, gint bands, gboolean original)
+{
+	static GOnce coeffs_once = G_ONCE_INIT;
+	xmms_eq_iir_bank_t *bank;
+	sIIRCoefficients *cfs;
+	gint i;
+
+	g_once (&coeffs_once, xmms_eq_iir_calc_coeffs, NULL);
+
+	/* get_coeffs falls back to the 10 band table for anything else,
+	 * but keeps bands as it was */
+	if (bands != 15 && bands != 25 && bands != 31) {
+		bands = 10;
+	}
+
+	/* may change bands to what there are coefficients for */
+	cfs = get_coeffs (&bands, srate, original);
+
+	bank = g_new0 (xmms_eq_iir_bank_t, 1);
+	bank->hist = g_new0 (xmms_eq_iir_history_t, channels * 2);
+
+	bank->cf.bands = bands;
+	for (i = 0; i < bands; i++) {
+		bank->cf.alpha[i] = cfs[i].alpha;
+		bank->cf.beta[i] = cfs[i].beta;
+		bank->cf.gamma[i] = cfs[i].gamma;
+	}
+
+	return bank;
+}
+
+static void
+xmms_eq_iir_bank_free (xmms_eq_iir_bank_t *bank)
+{
+	if (bank) {
+		g_free (bank->hist);
+		g_free (bank);
+	}
+}
+
+/**
+ * Create a filter bank of the 10 original XMMS bands.
+ *
+ * @returns the filter bank, or NULL if impl isn't supported
+ */
+xmms_eq_iir_t *
+xmms_eq_iir_new (gint srate, gint channels, xmms_eq_iir_impl_t impl)
+{
+	xmms_eq_iir_t *iir;
+	guint32 x = 0x9e3779b9;
+	gint i;
+
+	g_return_val_if_fail (channels > 0, NULL);
+
+	iir = g_new0 (xmms_eq_iir_t, 1);
+	iir->srate = srate;
+	iir->channels = channels;
+
+	iir->func = xmms_eq_iir_func (impl);
+	if (!iir->func) {
+		g_free (iir);
+		return NULL;
+	}
+
+	iir->mutex = g_mutex_new ();
+	iir->bank = xmms_eq_iir_bank_new (srate, channels, 10, TRUE);
+	iir->target_preamp = iir->preamp = 1.0;
+
+	/* always the same noise, so that every implementation gives
+	 * the same output */
+	for (i = 0; i < DITHER_SIZE; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		iir->dither[i] = (gint) (x % 4) - 2;
+	}
+
+	return iir;
+}
+
+void
+xmms_eq_iir_free (xmms_eq_iir_t *iir)
+{
+	g_return_if_fail (iir);
+
+	xmms_eq_iir_bank_free (iir->bank);
+	xmms_eq_iir_bank_free (iir->old_bank);
+	xmms_eq_iir_bank_free (iir->pending);
+	g_mutex_free (iir->mutex);
+	g_free (iir);
+}
+
+/**
+ * Switch to another set of bands, fading over from the current ones.
+ * The gains stay the same.
+ *
+ * @returns the number of bands that will be used, which is 10 for the
+ * rates there are no other coefficients for.
+ */
+gint
+xmms_eq_iir_bands_set (xmms_eq_iir_t *iir, gint bands, gboolean original)
+{
+	xmms_eq_iir_bank_t *bank;
+
+	g_return_val_if_fail (iir, 0);
+
+	bank = xmms_eq_iir_bank_new (iir->srate, iir->channels, bands, original);
+
+	g_mutex_lock (iir->mutex);
+	xmms_eq_iir_bank_free (iir->pending);
+	iir->pending = bank;
+	g_mutex_unlock (iir->mutex);
+
+	return bank->cf.bands;
+}
+
+void
+xmms_eq_iir_gain_set (xmms_eq_iir_t *iir, gint band, gfloat gain)
+{
+	g_return_if_fail (iir);
+	g_return_if_fail (band >= 0 && band < EQ_MAX_BANDS);
+
+	g_mutex_lock (iir->mutex);
+	iir->target_gain[band] = gain;
+	iir->dirty = TRUE;
+	g_mutex_unlock (iir->mutex);
+}
+
+void
+xmms_eq_iir_preamp_set (xmms_eq_iir_t *iir, gfloat preamp)
+{
+	g_return_if_fail (iir);
+
+	g_mutex_lock (iir->mutex);
+	iir->target_preamp = preamp;
+	iir->dirty = TRUE;
+	g_mutex_unlock (iir->mutex);
+}
+
+/* Pick up what the config callbacks changed */
+static void
+xmms_eq_iir_sync (xmms_eq_iir_t *iir)
+{
+	gint i;
+
+	g_mutex_lock (iir->mutex);
+
+	/* a fade is only started once the last one is done */
+	if (iir->pending && !iir->old_bank) {
+		if (iir->started) {
+			iir->old_bank = iir->bank;
+			iir->fade_left = FADE_FRAMES;
+		} else {
+			xmms_eq_iir_bank_free (iir->bank);
+		}
+		iir->bank = iir->pending;
+		iir->pending = NULL;
+	}
+
+	if (iir->dirty && !iir->started) {
+		/* nothing has been heard yet, no need to ramp */
+		memcpy (iir->gain, iir->target_gain, sizeof (iir->gain));
+		iir->preamp = iir->target_preamp;
+	} else if (iir->dirty) {
+		for (i = 0; i < EQ_BANDS_PADDED; i++) {
+			iir->gain_end[i] = iir->target_gain[i];
+			iir->gain_step[i] = (iir->gain_end[i] - iir->gain[i]) / RAMP_FRAMES;
+		}
+		iir->preamp_end = iir->target_preamp;
+		iir->preamp_step = (iir->preamp_end - iir->preamp) / RAMP_FRAMES;
+		iir->ramp_left = RAMP_FRAMES;
+	}
+	iir->dirty = FALSE;
+
+	g_mutex_unlock (iir->mutex);
+
+	iir->started = TRUE;
+}
+
+static void
+xmms_eq_iir_block (xmms_eq_iir_t *iir, gint16 *data, gint frames,
+                   gboolean extra_filtering)
+{
+	const gdouble *step = iir->ramp_left ? iir->gain_step : NULL;
+	gdouble preamp_step = iir->ramp_left ? iir->preamp_step : 0.0;
+	gdouble d, t, v;
+	gint channels = iir->channels;
+	gint ch, i;
+
+	for (ch = 0; ch < channels; ch++) {
+		for (i = 0; i < frames; i++) {
+			d = iir->dither[(iir->di + i) % DITHER_SIZE];
+			iir->in[i] = data[i * channels + ch] * (iir->preamp + preamp_step * i) + d;
+		}
+
+		iir->func (&iir->bank->cf, &iir->bank->hist[ch * 2], iir->gain, step,
+		           iir->in, iir->out, frames, extra_filtering);
+
+		if (iir->old_bank) {
+			iir->func (&iir->old_bank->cf, &iir->old_bank->hist[ch * 2],
+			           iir->gain, step, iir->in, iir->old_out, frames,
+			           extra_filtering);
+
+			for (i = 0; i < frames; i++) {
+				t = (gdouble) (FADE_FRAMES - iir->fade_left + i) / FADE_FRAMES;
+				iir->out[i] = iir->old_out[i] + (iir->out[i] - iir->old_out[i]) * t;
+			}
+		}
+
+		for (i = 0; i < frames; i++) {
+			d = iir->dither[(iir->di + i) % DITHER_SIZE];
+
+			/* mix in the input scaled down, and take the noise
+			 * out again */
+			v = iir->out[i] + iir->in[i] * 0.25 - d * 0.25;
+			data[i * channels + ch] = CLAMP (v, -32768.0, 32767.0);
+		}
+	}
+
+	iir->di = (iir->di + frames) % DITHER_SIZE;
+}
+
+/**
+ * Equalize interleaved 16 bit samples in place.
+ */
+void
+xmms_eq_iir_process (xmms_eq_iir_t *iir, gint16 *data, gint frames,
+                     gboolean extra_filtering)
+{
+	gint n, i;
+
+	g_return_if_fail (iir);
+
+	xmms_eq_iir_sync (iir);
+
+	for (; frames > 0; frames -= n, data += n * iir->channels) {
+		n = MIN (frames, BLOCK_FRAMES);
+		if (iir->ramp_left) {
+			n = MIN (n, iir->ramp_left);
+		}
+		if (iir->fade_left) {
+			n = MIN (n, iir->fade_left);
+		}
+
+		xmms_eq_iir_block (iir, data, n, extra_filtering);
+
+		if (iir->ramp_left) {
+			iir->ramp_left -= n;
+			for (i = 0; i < EQ_BANDS_PADDED; i++) {
+				iir->gain[i] = iir->ramp_left ?
+				               iir->gain[i] + iir->gain_step[i] * n :
+				               iir->gain_end[i];
+			}
+			iir->preamp = iir->ramp_left ?
+			              iir->preamp + iir->preamp_step * n :
+			              iir->preamp_end;
+		}
+
+		if (iir->fade_left) {
+			iir->fade_left -= n;
+			if (!iir->fade_left) {
+				xmms_eq_iir_bank_free (iir->old_bank);
+				iir->old_bank = NULL;
+			}
+		}
+	}
+}
@@ -0,0 +1,76 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2006-2011 XMMS2 Team
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __EQ_IIR_H__
+#define __EQ_IIR_H__
+
+#include <glib.h>
+
+#define EQ_MAX_BANDS 31
+/* room for the bands in whole vectors of the widest kind */
+#define EQ_BANDS_PADDED 32
+
+typedef struct xmms_eq_iir_St xmms_eq_iir_t;
+
+typedef enum {
+	XMMS_EQ_IIR_IMPL_SCALAR,
+	/** the vector unit every CPU of the architecture has */
+	XMMS_EQ_IIR_IMPL_VECTOR,
+	XMMS_EQ_IIR_IMPL_AVX2,
+	XMMS_EQ_IIR_IMPL_COUNT
+} xmms_eq_iir_impl_t;
+
+/** Coefficients of all bands, 0 for the bands that aren't used */
+typedef struct xmms_eq_iir_coeffs_St {
+	gint bands;
+	gdouble alpha[EQ_BANDS_PADDED];
+	gdouble beta[EQ_BANDS_PADDED];
+	gdouble gamma[EQ_BANDS_PADDED];
+} xmms_eq_iir_coeffs_t;
+
+/** What one filter stage of one channel remembers between samples */
+typedef struct xmms_eq_iir_history_St {
+	gdouble x1, x2;
+	gdouble y[2][EQ_BANDS_PADDED];
+	/** which of y holds y(n-1), the other one has y(n-2) */
+	gint cur;
+} xmms_eq_iir_history_t;
+
+/**
+ * Run frames samples of one channel through the band filters, once or
+ * twice, and store the sum of the filter outputs times their gains in
+ * out. If step isn't NULL it is added to the gains after every sample.
+ */
+typedef void (*xmms_eq_iir_func_t) (const xmms_eq_iir_coeffs_t *cf,
+                                    xmms_eq_iir_history_t *hist,
+                                    const gdouble *gain, const gdouble *step,
+                                    const gdouble *in, gdouble *out,
+                                    gint frames, gboolean extra_filtering);
+
+xmms_eq_iir_impl_t xmms_eq_iir_impl_best (void);
+const gchar *xmms_eq_iir_impl_name (xmms_eq_iir_impl_t impl);
+xmms_eq_iir_func_t xmms_eq_iir_func (xmms_eq_iir_impl_t impl);
+
+xmms_eq_iir_t *xmms_eq_iir_new (gint srate, gint channels,
+                                xmms_eq_iir_impl_t impl);
+void xmms_eq_iir_free (xmms_eq_iir_t *iir);
+
+gint xmms_eq_iir_bands_set (xmms_eq_iir_t *iir, gint bands, gboolean original);
+void xmms_eq_iir_gain_set (xmms_eq_iir_t *iir, gint band, gfloat gain);
+void xmms_eq_iir_preamp_set (xmms_eq_iir_t *iir, gfloat preamp);
+
+void xmms_eq_iir_process (xmms_eq_iir_t *iir, gint16 *data, gint frames,
+                          gboolean extra_filtering);
+
+#endif
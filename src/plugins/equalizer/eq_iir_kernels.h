@@ -0,0 +1,88 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2006-2011 XMMS2 Team
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/*
+ * Vector versions of the band filters, included by eq_iir.c once for
+ * every instruction set with these defined:
+ *
+ *   EQ_BYTES   size of a vector register
+ *   EQ_NAME(n) name of a function of this instruction set
+ *   EQ_TARGET  attribute making the compiler use it
+ *
+ * As many bands as fit in a register are filtered at a time. The
+ * bands past the last one have all coefficients 0, so their output is
+ * 0 too. The gained outputs are summed up per lane and only then
+ * across them, so the result may differ from the scalar version in
+ * the last bits.
+ */
+
+#define EQ_LANES (EQ_BYTES / 8)
+
+typedef gdouble EQ_NAME (vd) __attribute__ ((vector_size (EQ_BYTES)));
+
+static EQ_TARGET inline gdouble
+EQ_NAME (filter) (const xmms_eq_iir_coeffs_t *cf, xmms_eq_iir_history_t *h,
+                  const gdouble *gain, const gdouble *step, gint i, gdouble x)
+{
+	gdouble *y1 = h->y[h->cur], *y2 = h->y[!h->cur];
+	gdouble dx = x - h->x2, sum = 0.0;
+	EQ_NAME (vd) alpha, beta, gamma, v1, v2, g, s, acc = {};
+	gint b, l;
+
+	for (b = 0; b < cf->bands; b += EQ_LANES) {
+		memcpy (&alpha, cf->alpha + b, sizeof (alpha));
+		memcpy (&beta, cf->beta + b, sizeof (beta));
+		memcpy (&gamma, cf->gamma + b, sizeof (gamma));
+		memcpy (&v1, y1 + b, sizeof (v1));
+		memcpy (&v2, y2 + b, sizeof (v2));
+
+		v2 = alpha * dx + gamma * v1 - beta * v2;
+		memcpy (y2 + b, &v2, sizeof (v2));
+
+		memcpy (&g, gain + b, sizeof (g));
+		if (step) {
+			memcpy (&s, step + b, sizeof (s));
+			g += s * (gdouble) i;
+		}
+		acc += v2 * g;
+	}
+
+	for (l = 0; l < EQ_LANES; l++) {
+		sum += acc[l];
+	}
+
+	h->cur = !h->cur;
+	h->x2 = h->x1;
+	h->x1 = x;
+
+	return sum;
+}
+
+static EQ_TARGET void
+EQ_NAME (apply) (const xmms_eq_iir_coeffs_t *cf, xmms_eq_iir_history_t *hist,
+                 const gdouble *gain, const gdouble *step,
+                 const gdouble *in, gdouble *out, gint frames,
+                 gboolean extra_filtering)
+{
+	gint i;
+
+	for (i = 0; i < frames; i++) {
+		out[i] = EQ_NAME (filter) (cf, &hist[0], gain, step, i, in[i]);
+		if (extra_filtering) {
+			out[i] += EQ_NAME (filter) (cf, &hist[1], gain, step, i, out[i]);
+		}
+	}
+}
+
+#undef EQ_LANES
@@ -26,17 +26,14 @@
 #include <string.h>
 
 #include "browse/browse.h"
+#include "file_io.h"
 
-/* not available everywhere. */
-#if !defined(O_BINARY)
-# define O_BINARY 0
-#endif
 /*
  * Type definitions
  */
 
 typedef struct {
-	gint fd;
+	xmms_file_io_t *io;
 } xmms_file_data_t;
 
 /*
@@ -72,6 +69,23 @@ xmms_file_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
+	/* hint the kernel to read ahead */
+	xmms_xform_plugin_config_property_register (xform_plugin, "fadvise",
+	                                            "1", NULL, NULL);
+	/* files up to this many bytes are mapped into memory. Off by
+	 * default: a mapped file that another program truncates kills
+	 * the server with SIGBUS, where read() would just come up short. */
+	xmms_xform_plugin_config_property_register (xform_plugin, "mmap_max_size",
+	                                            "0", NULL, NULL);
+	/* bytes mapped of the start of larger files, where tags and
+	 * headers are looked for, off by default for the same reason */
+	xmms_xform_plugin_config_property_register (xform_plugin,
+	                                            "mmap_header_size",
+	                                            "0", NULL, NULL);
+	/* reads of 64 KiB to keep queued with io_uring, 0 disables it */
+	xmms_xform_plugin_config_property_register (xform_plugin, "io_uring",
+	                                            "0", NULL, NULL);
+
 	xmms_xform_plugin_indata_add (xform_plugin,
 	                              XMMS_STREAM_TYPE_MIMETYPE,
 	                              "application/x-url",
@@ -85,14 +99,25 @@ xmms_file_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 /*
  * Member functions
  */
+static gint
+xmms_file_config_int (xmms_xform_t *xform, const gchar *key)
+{
+	xmms_config_property_t *val;
+
+	val = xmms_xform_config_lookup (xform, key);
+	g_return_val_if_fail (val, 0);
+
+	return xmms_config_property_get_int (val);
+}
+
 static gboolean
 xmms_file_init (xmms_xform_t *xform)
 {
-	gint fd;
+	xmms_file_io_options_t options;
+	xmms_file_io_t *io;
 	xmms_file_data_t *data;
 	const gchar *url;
 	const gchar *metakey;
-	struct stat st;
 
 	url = xmms_xform_indata_get_str (xform, XMMS_STREAM_TYPE_URL);
 
@@ -102,23 +127,20 @@ xmms_file_init (xmms_xform_t *xform)
 	/* strip file:// */
 	url += 7;
 
-	if (stat (url, &st) == -1) {
-		XMMS_DBG ("Couldn't stat file '%s': %s", url, strerror (errno));
-		return FALSE;
-	}
-
-	if (!S_ISREG (st.st_mode)) {
-		return FALSE;
-	}
+	options.fadvise = xmms_file_config_int (xform, "fadvise");
+	options.mmap_max = xmms_file_config_int (xform, "mmap_max_size");
+	options.mmap_header = xmms_file_config_int (xform, "mmap_header_size");
+	options.uring_depth = xmms_file_config_int (xform, "io_uring");
 
 	XMMS_DBG ("Opening %s", url);
-	fd = open (url, O_RDONLY | O_BINARY);
-	if (fd == -1) {
+	io = xmms_file_io_open (url, &options);
+	if (!io) {
+		XMMS_DBG ("Couldn't open file '%s': %s", url, strerror (errno));
 		return FALSE;
 	}
 
 	data = g_new0 (xmms_file_data_t, 1);
-	data->fd = fd;
+	data->io = io;
 	xmms_xform_private_data_set (xform, data);
 
 	xmms_xform_outdata_type_add (xform,
@@ -127,10 +149,10 @@ xmms_file_init (xmms_xform_t *xform)
 	                             XMMS_STREAM_TYPE_END);
 
 	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE;
-	xmms_xform_metadata_set_int (xform, metakey, st.st_size);
+	xmms_xform_metadata_set_int (xform, metakey, xmms_file_io_size (io));
 
 	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_LMOD;
-	xmms_xform_metadata_set_int (xform, metakey, st.st_mtime);
+	xmms_xform_metadata_set_int (xform, metakey, xmms_file_io_mtime (io));
 
 	return TRUE;
 }
@@ -145,8 +167,10 @@ xmms_file_destroy (xmms_xform_t *xform)
 	if (!data)
 		return;
 
-	if (data->fd != -1)
-		close (data->fd);
+	XMMS_DBG ("%u system calls%s", xmms_file_io_syscalls (data->io),
+	          xmms_file_io_uses_uring (data->io) ? " (io_uring)" : "");
+
+	xmms_file_io_close (data->io);
 
 	g_free (data);
 }
@@ -164,7 +188,7 @@ xmms_file_read (xmms_xform_t *xform, void *buffer, gint len, xmms_error_t *error
 	data = xmms_xform_private_data_get (xform);
 	g_return_val_if_fail (data, -1);
 
-	ret = read (data->fd, buffer, len);
+	ret = xmms_file_io_read (data->io, buffer, len);
 
 	if (ret == -1) {
 		xmms_log_error ("errno(%d) %s", errno, strerror (errno));
@@ -178,8 +202,8 @@ static gint64
 xmms_file_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *error)
 {
 	xmms_file_data_t *data;
-	gint w = 0;
-	off_t res;
+	xmms_file_io_whence_t w = XMMS_FILE_IO_SEEK_SET;
+	gint64 res;
 
 	g_return_val_if_fail (xform, -1);
 	data = xmms_xform_private_data_get (xform);
@@ -187,18 +211,18 @@ xmms_file_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whenc
 
 	switch (whence) {
 		case XMMS_XFORM_SEEK_SET:
-			w = SEEK_SET;
+			w = XMMS_FILE_IO_SEEK_SET;
 			break;
 		case XMMS_XFORM_SEEK_END:
-			w = SEEK_END;
+			w = XMMS_FILE_IO_SEEK_END;
 			break;
 		case XMMS_XFORM_SEEK_CUR:
-			w = SEEK_CUR;
+			w = XMMS_FILE_IO_SEEK_CUR;
 			break;
 	}
 
-	res = lseek (data->fd, offset, w);
-	if (res == (off_t)-1) {
+	res = xmms_file_io_seek (data->io, offset, w);
+	if (res == -1) {
 		xmms_error_set (error, XMMS_ERROR_INVAL, "Couldn't seek");
 		return -1;
 	}
@@ -0,0 +1,490 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Reading local files with as few system calls as possible.
+ *
+ * The position is kept here rather than in the kernel, so seeking
+ * is free and reads are pread()s. If asked to, the start of the
+ * file, or all of it if it's small, is mapped so that probing headers
+ * and tags is just a memcpy. With io_uring the rest is read a few
+ * chunks ahead in one submission.
+ */
+
+#include "xmms_configuration.h"
+#include "file_io.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
+
+#ifdef HAVE_LIBURING
+# include <liburing.h>
+#endif
+
+/* not available everywhere. */
+#if !defined(O_BINARY)
+# define O_BINARY 0
+#endif
+
+#define URING_CHUNK (64 * 1024)
+
+#ifdef HAVE_LIBURING
+typedef struct {
+	guchar *buf;
+	gint64 offset;
+	/** bytes read, or -errno */
+	gint len;
+	gboolean pending;
+} xmms_file_io_slot_t;
+#endif
+
+struct xmms_file_io_St {
+	gint fd;
+	gint64 pos;
+	gint64 size;
+	glong mtime;
+
+	guchar *map;
+	gsize map_len;
+
+	guint syscalls;
+
+#ifdef HAVE_LIBURING
+	struct io_uring ring;
+	xmms_file_io_slot_t *slots;
+	gint depth;
+	/** offset of the next chunk to queue */
+	gint64 next;
+#endif
+};
+
+#ifdef HAVE_LIBURING
+static gboolean xmms_file_io_uring_init (xmms_file_io_t *io, gint depth);
+static void xmms_file_io_uring_free (xmms_file_io_t *io);
+static gint xmms_file_io_uring_read (xmms_file_io_t *io, gpointer buf, gint len);
+#endif
+
+/**
+ * Open a regular file for reading.
+ *
+ * Anything the system doesn't support is silently left out, the
+ * file is then read with plain pread()s.
+ *
+ * @returns the file, or NULL with errno set
+ */
+xmms_file_io_t *
+xmms_file_io_open (const gchar *path, const xmms_file_io_options_t *options)
+{
+	xmms_file_io_t *io;
+	struct stat st;
+	gint fd;
+
+	/* O_NONBLOCK keeps us from hanging on a fifo before we had a
+	 * chance to look at it, it has no effect on regular files */
+	fd = open (path, O_RDONLY | O_BINARY | O_NONBLOCK);
+	if (fd == -1) {
+		return NULL;
+	}
+
+	if (fstat (fd, &st) == -1) {
+		close (fd);
+		return NULL;
+	}
+
+	if (!S_ISREG (st.st_mode)) {
+		close (fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	io = g_new0 (xmms_file_io_t, 1);
+	io->fd = fd;
+	io->size = st.st_size;
+	io->mtime = st.st_mtime;
+	io->syscalls = 2;
+
+#ifdef HAVE_POSIX_FADVISE
+	if (options->fadvise) {
+		posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		io->syscalls++;
+	}
+#endif
+
+#ifdef HAVE_MMAP
+	if (io->size > 0 && io->size <= options->mmap_max) {
+		io->map_len = io->size;
+	} else if (options->mmap_header > 0) {
+		io->map_len = MIN (io->size, options->mmap_header);
+	}
+
+	/* Touching a page past the end of a file that was truncated
+	 * after mapping it raises SIGBUS, so only map when the caller
+	 * has asked for it. */
+	if (io->map_len) {
+		io->map = mmap (NULL, io->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+		io->syscalls++;
+		if (io->map == MAP_FAILED) {
+			io->map = NULL;
+			io->map_len = 0;
+		}
+	}
+#endif
+
+#ifdef HAVE_LIBURING
+	if (options->uring_depth > 0 && io->size > io->map_len) {
+		xmms_file_io_uring_init (io, options->uring_depth);
+	}
+#endif
+
+	return io;
+}
+
+void
+xmms_file_io_close (xmms_file_io_t *io)
+{
+	g_return_if_fail (io);
+
+#ifdef HAVE_LIBURING
+	xmms_file_io_uring_free (io);
+#endif
+
+#ifdef HAVE_MMAP
+	if (io->map) {
+		munmap (io->map, io->map_len);
+	}
+#endif
+
+	close (io->fd);
+	g_free (io);
+}
+
+/**
+ * Read from the current position.
+ *
+ * @returns number of bytes read, 0 at the end of the file and -1
+ * on error with errno set.
+ */
+gint
+xmms_file_io_read (xmms_file_io_t *io, gpointer buf, gint len)
+{
+	gint ret;
+
+	g_return_val_if_fail (io, -1);
+	g_return_val_if_fail (buf, -1);
+
+	if (io->pos < io->map_len) {
+		ret = MIN (len, io->map_len - io->pos);
+		memcpy (buf, io->map + io->pos, ret);
+		io->pos += ret;
+		return ret;
+	}
+
+	if (io->pos >= io->size) {
+		return 0;
+	}
+
+#ifdef HAVE_LIBURING
+	if (io->slots) {
+		ret = xmms_file_io_uring_read (io, buf, len);
+		if (ret > 0) {
+			io->pos += ret;
+		}
+		return ret;
+	}
+#endif
+
+	do {
+		ret = pread (io->fd, buf, len, io->pos);
+		io->syscalls++;
+	} while (ret == -1 && errno == EINTR);
+
+	if (ret > 0) {
+		io->pos += ret;
+	}
+
+	return ret;
+}
+
+/**
+ * Move the position, without telling the kernel.
+ *
+ * @returns the new position, or -1 if it would be negative.
+ */
+gint64
+xmms_file_io_seek (xmms_file_io_t *io, gint64 offset,
+                   xmms_file_io_whence_t whence)
+{
+	g_return_val_if_fail (io, -1);
+
+	switch (whence) {
+		case XMMS_FILE_IO_SEEK_CUR:
+			offset += io->pos;
+			break;
+		case XMMS_FILE_IO_SEEK_END:
+			offset += io->size;
+			break;
+		default:
+			break;
+	}
+
+	if (offset < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	io->pos = offset;
+
+	return offset;
+}
+
+gint64
+xmms_file_io_size (xmms_file_io_t *io)
+{
+	return io->size;
+}
+
+glong
+xmms_file_io_mtime (xmms_file_io_t *io)
+{
+	return io->mtime;
+}
+
+guint
+xmms_file_io_syscalls (xmms_file_io_t *io)
+{
+	return io->syscalls;
+}
+
+gboolean
+xmms_file_io_uses_uring (xmms_file_io_t *io)
+{
+#ifdef HAVE_LIBURING
+	return io->slots != NULL;
+#else
+	return FALSE;
+#endif
+}
+
+#ifdef HAVE_LIBURING
+
+static gboolean
+xmms_file_io_uring_init (xmms_file_io_t *io, gint depth)
+{
+	gint i;
+
+	io->syscalls++;
+	if (io_uring_queue_init (depth, &io->ring, 0) < 0) {
+		/* not supported by the kernel, or not allowed */
+		return FALSE;
+	}
+
+	io->depth = depth;
+	io->slots = g_new0 (xmms_file_io_slot_t, depth);
+	for (i = 0; i < depth; i++) {
+		io->slots[i].buf = g_malloc (URING_CHUNK);
+		io->slots[i].offset = -1;
+	}
+
+	return TRUE;
+}
+
+/* Wait for one read to complete */
+static void
+xmms_file_io_uring_reap (xmms_file_io_t *io)
+{
+	struct io_uring_cqe *cqe;
+	xmms_file_io_slot_t *slot;
+	gint i, ret;
+
+	do {
+		ret = io_uring_wait_cqe (&io->ring, &cqe);
+		io->syscalls++;
+	} while (ret == -EINTR);
+
+	if (ret < 0) {
+		/* the ring is unusable, fail everything in flight */
+		for (i = 0; i < io->depth; i++) {
+			if (io->slots[i].pending) {
+				io->slots[i].len = ret;
+				io->slots[i].pending = FALSE;
+			}
+		}
+		return;
+	}
+
+	slot = io_uring_cqe_get_data (cqe);
+	slot->len = cqe->res;
+	slot->pending = FALSE;
+
+	io_uring_cqe_seen (&io->ring, cqe);
+}
+
+static void
+xmms_file_io_uring_drain (xmms_file_io_t *io)
+{
+	gint i;
+
+	for (i = 0; i < io->depth; i++) {
+		while (io->slots[i].pending) {
+			xmms_file_io_uring_reap (io);
+		}
+	}
+}
+
+static void
+xmms_file_io_uring_free (xmms_file_io_t *io)
+{
+	gint i;
+
+	if (!io->slots) {
+		return;
+	}
+
+	xmms_file_io_uring_drain (io);
+	io_uring_queue_exit (&io->ring);
+
+	for (i = 0; i < io->depth; i++) {
+		g_free (io->slots[i].buf);
+	}
+	g_free (io->slots);
+	io->slots = NULL;
+}
+
+/**
+ * Queue the next chunks of the file into all slots that hold
+ * nothing at or after pos, and submit them all at once.
+ */
+static void
+xmms_file_io_uring_queue (xmms_file_io_t *io, gint64 pos)
+{
+	struct io_uring_sqe *sqe;
+	xmms_file_io_slot_t *slot;
+	gint i, queued = 0;
+
+	for (i = 0; i < io->depth && io->next < io->size; i++) {
+		slot = &io->slots[i];
+
+		if (slot->pending) {
+			continue;
+		}
+		if (slot->offset >= 0 && slot->len > 0 &&
+		    pos < slot->offset + slot->len) {
+			continue;
+		}
+
+		sqe = io_uring_get_sqe (&io->ring);
+		if (!sqe) {
+			break;
+		}
+
+		io_uring_prep_read (sqe, io->fd, slot->buf, URING_CHUNK, io->next);
+		io_uring_sqe_set_data (sqe, slot);
+
+		slot->offset = io->next;
+		slot->len = 0;
+		slot->pending = TRUE;
+
+		io->next += URING_CHUNK;
+		queued++;
+	}
+
+	if (queued) {
+		io_uring_submit (&io->ring);
+		io->syscalls++;
+	}
+}
+
+static xmms_file_io_slot_t *
+xmms_file_io_uring_find (xmms_file_io_t *io)
+{
+	gint i;
+
+	for (i = 0; i < io->depth; i++) {
+		xmms_file_io_slot_t *slot = &io->slots[i];
+
+		if (slot->offset >= 0 && io->pos >= slot->offset &&
+		    io->pos < slot->offset + URING_CHUNK) {
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+static gint
+xmms_file_io_uring_read (xmms_file_io_t *io, gpointer buf, gint len)
+{
+	xmms_file_io_slot_t *slot;
+	gint off;
+
+	slot = xmms_file_io_uring_find (io);
+	if (slot && slot->pending) {
+		while (slot->pending) {
+			xmms_file_io_uring_reap (io);
+		}
+	}
+
+	/* not where the reads are going, start over from here */
+	if (!slot || (slot->len >= 0 && io->pos >= slot->offset + slot->len)) {
+		xmms_file_io_uring_drain (io);
+		for (off = 0; off < io->depth; off++) {
+			io->slots[off].offset = -1;
+		}
+
+		io->next = io->pos - io->pos % URING_CHUNK;
+		xmms_file_io_uring_queue (io, io->pos);
+
+		slot = xmms_file_io_uring_find (io);
+		g_return_val_if_fail (slot, -1);
+
+		while (slot->pending) {
+			xmms_file_io_uring_reap (io);
+		}
+	}
+
+	if (slot->len < 0) {
+		errno = -slot->len;
+		slot->offset = -1;
+		return -1;
+	}
+
+	off = io->pos - slot->offset;
+	if (off >= slot->len) {
+		/* a short read, end of file */
+		return 0;
+	}
+
+	len = MIN (len, slot->len - off);
+	memcpy (buf, slot->buf + off, len);
+
+	/* keep the pipeline full once a chunk has been used up */
+	if (off + len == slot->len) {
+		xmms_file_io_uring_queue (io, io->pos + len);
+	}
+
+	return len;
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_FILE_IO_H__
+#define __XMMS_FILE_IO_H__
+
+#include <glib.h>
+
+typedef struct xmms_file_io_St xmms_file_io_t;
+
+typedef struct {
+	/** tell the kernel the file will be read sequentially */
+	gboolean fadvise;
+	/** map files up to this size completely, 0 disables it. Reading
+	 *  a mapped file that is truncated meanwhile raises SIGBUS. */
+	gint64 mmap_max;
+	/** map this much of the start of larger files, for header
+	 *  probing, 0 disables it */
+	gint mmap_header;
+	/** number of reads to keep in flight with io_uring, 0 disables it */
+	gint uring_depth;
+} xmms_file_io_options_t;
+
+typedef enum {
+	XMMS_FILE_IO_SEEK_SET,
+	XMMS_FILE_IO_SEEK_CUR,
+	XMMS_FILE_IO_SEEK_END
+} xmms_file_io_whence_t;
+
+xmms_file_io_t *xmms_file_io_open (const gchar *path,
+                                   const xmms_file_io_options_t *options);
+void xmms_file_io_close (xmms_file_io_t *io);
+
+gint xmms_file_io_read (xmms_file_io_t *io, gpointer buf, gint len);
+gint64 xmms_file_io_seek (xmms_file_io_t *io, gint64 offset,
+                          xmms_file_io_whence_t whence);
+
+gint64 xmms_file_io_size (xmms_file_io_t *io);
+glong xmms_file_io_mtime (xmms_file_io_t *io);
+
+/** Number of system calls made on the file so far */
+guint xmms_file_io_syscalls (xmms_file_io_t *io);
+/** TRUE if reads go through io_uring */
+gboolean xmms_file_io_uses_uring (xmms_file_io_t *io);
+
+#endif
@@ -15,12 +15,14 @@
  */
 
 #include "xmms/xmms_xformplugin.h"
+#include "xmms/xmms_readahead.h"
 #include "xmms/xmms_log.h"
 
 #include <gio/gio.h>
 
 typedef struct {
 	GInputStream *handle;
+	xmms_readahead_t *readahead;
 } xmms_gvfs_data_t;
 
 static const struct {
@@ -55,6 +57,11 @@ static gint64 xmms_gvfs_seek (xmms_xform_t *xform, gint64 offset,
                               xmms_error_t *error);
 static gboolean xmms_gvfs_browse (xmms_xform_t *xform, const gchar *url,
                                   xmms_error_t *error);
+static gint xmms_gvfs_read_stream (gpointer udata, gpointer buffer, gint len,
+                                   xmms_error_t *error);
+static gint64 xmms_gvfs_seek_stream (gpointer udata, gint64 offset,
+                                     xmms_xform_seek_mode_t whence,
+                                     xmms_error_t *error);
 
 XMMS_XFORM_PLUGIN ("gvfs",
                    "gvfs transport",
@@ -87,6 +94,14 @@ xmms_gvfs_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
+	/* bytes to read ahead of the decoder, 0 reads on demand */
+	xmms_xform_plugin_config_property_register (xform_plugin, "readahead",
+	                                            "262144", NULL, NULL);
+	/* seconds to remember a directory listing */
+	xmms_xform_plugin_config_property_register (xform_plugin,
+	                                            "browse_cache_ttl",
+	                                            "10", NULL, NULL);
+
 	xmms_xform_plugin_indata_add (xform_plugin,
 	                              XMMS_STREAM_TYPE_MIMETYPE,
 	                              "application/x-url",
@@ -127,7 +142,10 @@ xmms_gvfs_init (xmms_xform_t *xform)
 	GFileInfo *info;
 	GFileInputStream *handle;
 	GError *error = NULL;
+	xmms_config_property_t *val;
 	const gchar *url;
+	gint64 length = -1;
+	gint readahead;
 
 	url = xmms_xform_indata_get_str (xform, XMMS_STREAM_TYPE_URL);
 	g_return_val_if_fail (url, FALSE);
@@ -148,7 +166,7 @@ xmms_gvfs_init (xmms_xform_t *xform)
 		return FALSE;
 	}
 
-	data = g_new (xmms_gvfs_data_t, 1);
+	data = g_new0 (xmms_gvfs_data_t, 1);
 	data->handle = G_INPUT_STREAM (handle);
 	xmms_xform_private_data_set (xform, data);
 
@@ -160,6 +178,10 @@ xmms_gvfs_init (xmms_xform_t *xform)
 	} else {
 		int i;
 
+		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE)) {
+			length = g_file_info_get_size (info);
+		}
+
 		for (i = 0; i < G_N_ELEMENTS (attr_map); i++) {
 			if (!g_file_info_has_attribute (info, attr_map[i].gvfs)) {
 				continue;
@@ -194,6 +216,14 @@ xmms_gvfs_init (xmms_xform_t *xform)
 		g_object_unref (info);
 	}
 
+	val = xmms_xform_config_lookup (xform, "readahead");
+	readahead = xmms_config_property_get_int (val);
+	if (readahead > 0) {
+		data->readahead = xmms_readahead_new (xmms_gvfs_read_stream,
+		                                      xmms_gvfs_seek_stream, data,
+		                                      0, length, readahead);
+	}
+
 	xmms_xform_outdata_type_add (xform,
 	                             XMMS_STREAM_TYPE_MIMETYPE,
 	                             "application/octet-stream",
@@ -208,19 +238,20 @@ xmms_gvfs_destroy (xmms_xform_t *xform)
 	xmms_gvfs_data_t *data = xmms_xform_private_data_get (xform);
 	g_return_if_fail (data);
 
+	if (data->readahead) {
+		xmms_readahead_free (data->readahead);
+	}
+
 	g_object_unref (data->handle);
 }
 
 static gint
-xmms_gvfs_read (xmms_xform_t *xform, gpointer buffer, gint len,
-                xmms_error_t *error)
+xmms_gvfs_read_stream (gpointer udata, gpointer buffer, gint len,
+                       xmms_error_t *error)
 {
 	gint ret;
 	GError *err = NULL;
-	xmms_gvfs_data_t *data = xmms_xform_private_data_get (xform);
-
-	g_return_val_if_fail (data, -1);
-	g_return_val_if_fail (!g_input_stream_is_closed (data->handle), -1);
+	xmms_gvfs_data_t *data = udata;
 
 	ret = g_input_stream_read (data->handle, buffer, len, NULL, &err);
 
@@ -231,17 +262,30 @@ xmms_gvfs_read (xmms_xform_t *xform, gpointer buffer, gint len,
 	return ret;
 }
 
-static gint64
-xmms_gvfs_seek (xmms_xform_t *xform, gint64 offset,
-                xmms_xform_seek_mode_t whence, xmms_error_t *error)
+static gint
+xmms_gvfs_read (xmms_xform_t *xform, gpointer buffer, gint len,
+                xmms_error_t *error)
 {
-	GSeekType type;
-	GError *err = NULL;
 	xmms_gvfs_data_t *data = xmms_xform_private_data_get (xform);
 
 	g_return_val_if_fail (data, -1);
 	g_return_val_if_fail (!g_input_stream_is_closed (data->handle), -1);
 
+	if (data->readahead) {
+		return xmms_readahead_read (data->readahead, buffer, len, error);
+	}
+
+	return xmms_gvfs_read_stream (data, buffer, len, error);
+}
+
+static gint64
+xmms_gvfs_seek_stream (gpointer udata, gint64 offset,
+                       xmms_xform_seek_mode_t whence, xmms_error_t *error)
+{
+	GSeekType type;
+	GError *err = NULL;
+	xmms_gvfs_data_t *data = udata;
+
 	switch (whence) {
 		case XMMS_XFORM_SEEK_CUR:
 			type = G_SEEK_CUR;
@@ -262,6 +306,22 @@ xmms_gvfs_seek (xmms_xform_t *xform, gint64 offset,
 	return -1;
 }
 
+static gint64
+xmms_gvfs_seek (xmms_xform_t *xform, gint64 offset,
+                xmms_xform_seek_mode_t whence, xmms_error_t *error)
+{
+	xmms_gvfs_data_t *data = xmms_xform_private_data_get (xform);
+
+	g_return_val_if_fail (data, -1);
+	g_return_val_if_fail (!g_input_stream_is_closed (data->handle), -1);
+
+	if (data->readahead) {
+		return xmms_readahead_seek (data->readahead, offset, whence, error);
+	}
+
+	return xmms_gvfs_seek_stream (data, offset, whence, error);
+}
+
 static gboolean
 xmms_gvfs_browse (xmms_xform_t *xform, const gchar *url, xmms_error_t *error)
 {
@@ -21,6 +21,7 @@
 #include <math.h>
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <shout/shout.h>
 
@@ -28,15 +29,48 @@
 #include <vorbis/codec.h>
 
 #include "encode.h"
+#include "ices_pipe.h"
+
+/* how many writes to do between looking for dropped audio */
+#define DROP_CHECK_INTERVAL 256
 
 typedef struct xmms_ices_data_St {
 	shout_t *shout;
-	vorbis_comment vc;
+	/* open and close happen while the sender thread may be sending */
+	GMutex *shout_mutex;
+	xmms_ices_pipe_t *pipe;
+
+	/* only used on the encoder thread */
 	encoder_state *encoder;
 	gint rate;
 	gint channels;
+
+	/* only used by the output */
+	gboolean streaming;
+	gint writes;
+	guint64 reported_drops;
 } xmms_ices_data_t;
 
+/** What the encoder thread needs to start a new logical stream */
+typedef struct xmms_ices_restart_St {
+	gint min_br;
+	gint nom_br;
+	gint max_br;
+	/* 0 to keep the current format */
+	gint rate;
+	gint channels;
+	vorbis_comment vc;
+} xmms_ices_restart_t;
+
+static const struct {
+	const gchar *name;
+	xmms_ices_pipe_policy_t policy;
+} policies[] = {
+	{ "block", XMMS_ICES_PIPE_BLOCK },
+	{ "dropoldest", XMMS_ICES_PIPE_DROP_OLDEST },
+	{ "dropnewest", XMMS_ICES_PIPE_DROP_NEWEST },
+};
+
 /*
  * Forward definitions.
  */
@@ -58,34 +92,148 @@ static void on_playlist_entry_changed (xmms_object_t *object, xmmsv_t *arg,
 /*
  * Internal helper functions.
  */
+
+/* Hand all pages the encoder has ready to the sender. Runs on the
+ * encoder thread, like everything else touching the encoder. */
 static void
-xmms_ices_send_shout (xmms_ices_data_t *data, xmms_error_t *err)
+xmms_ices_pages_push (xmms_ices_data_t *data)
 {
 	ogg_page og;
 
 	while (xmms_ices_encoder_output (data->encoder, &og) == TRUE) {
-		if (shout_send (data->shout, og.header, og.header_len) < 0) {
-			if (err)
-				xmms_error_set (err, XMMS_ERROR_GENERIC,
-				                "Disconnected or something.");
-			return;
-		} else if (shout_send (data->shout, og.body, og.body_len) < 0) {
-			if (err)
-				xmms_error_set (err, XMMS_ERROR_GENERIC,
-				                "Error when sending data to icecast server");
-			return;
-		}
+		xmms_ices_pipe_page_push (data->pipe, og.header, og.header_len,
+		                          og.body, og.body_len);
+	}
+}
+
+static void
+xmms_ices_encode (gpointer udata, gconstpointer buf, gint len)
+{
+	xmms_ices_data_t *data = udata;
+
+	if (!data->encoder)
+		return;
+
+	xmms_ices_encoder_input (data->encoder, (xmms_samplefloat_t *) buf, len);
+	xmms_ices_pages_push (data);
+}
+
+/* The pacing libshout does in shout_sync is done by the pipe, which
+ * paces the writer instead of the sender. */
+static gboolean
+xmms_ices_send (gpointer udata, gconstpointer buf, gint len)
+{
+	xmms_ices_data_t *data = udata;
+	gint ret;
 
-		shout_sync (data->shout);
+	g_mutex_lock (data->shout_mutex);
+	ret = shout_send (data->shout, buf, len);
+	g_mutex_unlock (data->shout_mutex);
+
+	if (ret != SHOUTERR_SUCCESS) {
+		xmms_log_error ("Error when sending data to icecast server: %s",
+		                shout_get_error (data->shout));
+		return FALSE;
 	}
+
+	return TRUE;
 }
 
+/* End the current logical stream, if there is one, and start a new
+ * one with the metadata and format in the restart data. */
 static void
-xmms_ices_flush_internal (xmms_ices_data_t *data)
+xmms_ices_restart (gpointer udata, gpointer arg)
 {
+	xmms_ices_data_t *data = udata;
+	xmms_ices_restart_t *restart = arg;
+
+	if (data->encoder) {
+		xmms_ices_encoder_finish (data->encoder);
+		xmms_ices_pages_push (data);
+	} else if (restart->rate) {
+		data->encoder = xmms_ices_encoder_init (restart->min_br,
+		                                        restart->nom_br,
+		                                        restart->max_br);
+	}
+
+	if (!data->encoder)
+		return;
+
+	if (restart->rate) {
+		data->rate = restart->rate;
+		data->channels = restart->channels;
+	}
+
+	if (!xmms_ices_encoder_stream_change (data->encoder, data->rate,
+	                                      data->channels, &restart->vc)) {
+		xmms_log_error ("Couldn't set up encoder for rate %d, channels %d",
+		                data->rate, data->channels);
+	}
+}
+
+static void
+xmms_ices_restart_free (gpointer arg)
+{
+	xmms_ices_restart_t *restart = arg;
+
+	vorbis_comment_clear (&restart->vc);
+	g_free (restart);
+}
+
+/* Flush out the current logical stream and get rid of the encoder */
+static void
+xmms_ices_finish (gpointer udata, gpointer arg)
+{
+	xmms_ices_data_t *data = udata;
+
+	if (!data->encoder)
+		return;
+
 	xmms_ices_encoder_finish (data->encoder);
+	xmms_ices_pages_push (data);
 
-	xmms_ices_send_shout (data, NULL);
+	xmms_ices_encoder_fini (data->encoder);
+	data->encoder = NULL;
+}
+
+static void
+xmms_ices_stats_log (xmms_ices_data_t *data)
+{
+	xmms_ices_pipe_stats_t stats;
+
+	xmms_ices_pipe_stats_get (data->pipe, &stats);
+
+	XMMS_DBG ("Streamed %" G_GUINT64_FORMAT " ms in %" G_GUINT64_FORMAT
+	          " pages (%" G_GUINT64_FORMAT " bytes), dropped %"
+	          G_GUINT64_FORMAT " ms, writer waited %" G_GUINT64_FORMAT " ms",
+	          stats.written_usec / 1000, stats.pages_sent, stats.bytes_sent,
+	          stats.dropped_usec / 1000, stats.blocked_usec / 1000);
+	XMMS_DBG ("Encoder lag %" G_GUINT64_FORMAT " ms (max %" G_GUINT64_FORMAT
+	          " ms), send latency %" G_GUINT64_FORMAT " ms (max %"
+	          G_GUINT64_FORMAT " ms)",
+	          stats.encoder_lag_usec / 1000, stats.encoder_lag_max_usec / 1000,
+	          stats.send_usec / 1000, stats.send_max_usec / 1000);
+}
+
+/* Let the user know when audio has been thrown away, now and then */
+static void
+xmms_ices_drops_check (xmms_ices_data_t *data)
+{
+	xmms_ices_pipe_stats_t stats;
+
+	if (++data->writes % DROP_CHECK_INTERVAL)
+		return;
+
+	xmms_ices_pipe_stats_get (data->pipe, &stats);
+	if (stats.dropped_usec > data->reported_drops) {
+		xmms_log_info ("Dropped %" G_GUINT64_FORMAT " ms of audio, the "
+		               "encoder or the connection can't keep up "
+		               "(encoder lag %" G_GUINT64_FORMAT " ms, send "
+		               "latency %" G_GUINT64_FORMAT " ms)",
+		               (stats.dropped_usec - data->reported_drops) / 1000,
+		               stats.encoder_lag_usec / 1000, stats.send_usec / 1000);
+		data->reported_drops = stats.dropped_usec;
+	}
 }
 
 /*
@@ -120,6 +268,8 @@ xmms_ices_plugin_setup (xmms_output_plugin_t *plugin)
 		{ "streamdescription", "" },
 		{ "streamgenre", "" },
 		{ "streamurl", "" },
+		{ "backlog", "2000" },
+		{ "droppolicy", "dropoldest" },
 		{ NULL, NULL },
 	};
 
@@ -149,11 +299,15 @@ xmms_ices_new (xmms_output_t *output)
 {
 	xmms_ices_data_t *data;
 	xmms_config_property_t *val;
+	xmms_ices_pipe_policy_t policy = XMMS_ICES_PIPE_DROP_OLDEST;
+	const gchar *name;
+	gint backlog, i;
 
 	shout_init ();
 
 	data = g_new0 (xmms_ices_data_t, 1);
 	data->shout = shout_new ();
+	data->shout_mutex = g_mutex_new ();
 
 	shout_set_format (data->shout, SHOUT_FORMAT_VORBIS);
 	shout_set_protocol (data->shout, SHOUT_PROTOCOL_HTTP);
@@ -190,6 +344,24 @@ xmms_ices_new (xmms_output_t *output)
 	val = xmms_output_config_lookup (output, "streamurl");
 	shout_set_url (data->shout, xmms_config_property_get_string (val));
 
+	val = xmms_output_config_lookup (output, "backlog");
+	backlog = xmms_config_property_get_int (val);
+
+	val = xmms_output_config_lookup (output, "droppolicy");
+	name = xmms_config_property_get_string (val);
+	for (i = 0; i < G_N_ELEMENTS (policies); i++) {
+		if (!strcmp (name, policies[i].name))
+			break;
+	}
+	if (i < G_N_ELEMENTS (policies)) {
+		policy = policies[i].policy;
+	} else {
+		xmms_log_error ("Unknown drop policy '%s', using dropoldest", name);
+	}
+
+	data->pipe = xmms_ices_pipe_new (xmms_ices_encode, xmms_ices_send, data,
+	                                 backlog, policy);
+
 	xmms_output_private_data_set (output, data);
 	xmms_output_format_add (output, XMMS_SAMPLE_FORMAT_FLOAT, 2, 44100);
 
@@ -214,13 +386,15 @@ xmms_ices_destroy (xmms_output_t *output)
 	                        on_playlist_entry_changed,
 	                        data);
 
+	/* the threads are gone after this, so the encoder is ours */
+	xmms_ices_pipe_free (data->pipe);
+
 	if (data->encoder)
 		xmms_ices_encoder_fini (data->encoder);
 
-	vorbis_comment_clear (&data->vc);
-
 	shout_close (data->shout);
 	shout_free (data->shout);
+	g_mutex_free (data->shout_mutex);
 
 	g_free (data);
 
@@ -231,11 +405,16 @@ static gboolean
 xmms_ices_open (xmms_output_t *output)
 {
 	xmms_ices_data_t *data;
+	gint ret;
 	g_return_val_if_fail (output, FALSE);
 	data = xmms_output_private_data_get (output);
 	g_return_val_if_fail (data, FALSE);
 
-	if (shout_open (data->shout) == SHOUTERR_SUCCESS) {
+	g_mutex_lock (data->shout_mutex);
+	ret = shout_open (data->shout);
+	g_mutex_unlock (data->shout_mutex);
+
+	if (ret == SHOUTERR_SUCCESS) {
 		XMMS_DBG ("Connected to http://%s:%d/%s",
 		          shout_get_host (data->shout),
 		          shout_get_port (data->shout),
@@ -245,6 +424,9 @@ xmms_ices_open (xmms_output_t *output)
 		return FALSE;
 	}
 
+	xmms_ices_pipe_reset (data->pipe);
+	data->writes = 0;
+
 	return TRUE;
 }
 
@@ -256,17 +438,16 @@ xmms_ices_close (xmms_output_t *output)
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
-	if (!data->encoder) {
-		shout_close (data->shout);
-		return;
-	}
+	/* send what is left of the stream before hanging up */
+	xmms_ices_pipe_call (data->pipe, xmms_ices_finish, NULL, NULL);
+	xmms_ices_pipe_drain (data->pipe);
+	data->streaming = FALSE;
 
-	xmms_ices_flush_internal (data);
+	xmms_ices_stats_log (data);
 
+	g_mutex_lock (data->shout_mutex);
 	shout_close (data->shout);
-
-	xmms_ices_encoder_fini (data->encoder);
-	data->encoder = NULL;
+	g_mutex_unlock (data->shout_mutex);
 }
 
 static void
@@ -278,6 +459,7 @@ static gboolean
 xmms_ices_format_set (xmms_output_t *output, const xmms_stream_type_t *format)
 {
 	xmms_ices_data_t *data;
+	xmms_ices_restart_t *restart;
 	xmms_config_property_t *val;
 	xmms_medialib_entry_t entry;
 
@@ -285,45 +467,44 @@ xmms_ices_format_set (xmms_output_t *output, const xmms_stream_type_t *format)
 	data = xmms_output_private_data_get (output);
 	g_return_val_if_fail (data, FALSE);
 
-	if (data->encoder)
-		xmms_ices_flush_internal (data);
-
-	/* Set the Vorbis comment to the current track metadata. */
-	vorbis_comment_clear (&data->vc);
-	vorbis_comment_init (&data->vc);
-
-	entry = xmms_output_current_id (output);
-	xmms_ices_update_comment (entry, &data->vc);
-
+	restart = g_new0 (xmms_ices_restart_t, 1);
 
-	/* If there is no encoder around, we need to build one. */
-	if (!data->encoder) {
-		int minbr, nombr, maxbr;
+	val = xmms_output_config_lookup (output, "encodingnombr");
+	restart->nom_br = xmms_config_property_get_int (val);
+	val = xmms_output_config_lookup (output, "encodingminbr");
+	restart->min_br = xmms_config_property_get_int (val);
+	val = xmms_output_config_lookup (output, "encodingmaxbr");
+	restart->max_br = xmms_config_property_get_int (val);
 
-		val = xmms_output_config_lookup (output, "encodingnombr");
-		nombr = xmms_config_property_get_int (val);
-		val = xmms_output_config_lookup (output, "encodingminbr");
-		minbr = xmms_config_property_get_int (val);
-		val = xmms_output_config_lookup (output, "encodingmaxbr");
-		maxbr = xmms_config_property_get_int (val);
-
-		data->encoder = xmms_ices_encoder_init (minbr, nombr, maxbr);
-		if (!data->encoder)
-			return FALSE;
+	/* The encoder won't be built without a bitrate. */
+	if (restart->nom_br <= 0) {
+		g_free (restart);
+		return FALSE;
 	}
 
-	/* Get this stream's data and fire up the encoder. */
-	data->rate = xmms_stream_type_get_int (format,
-	                                       XMMS_STREAM_TYPE_FMT_SAMPLERATE);
-	data->channels = xmms_stream_type_get_int (format,
-	                                           XMMS_STREAM_TYPE_FMT_CHANNELS);
+	/* Get this stream's data. */
+	restart->rate = xmms_stream_type_get_int (format,
+	                                          XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+	restart->channels = xmms_stream_type_get_int (format,
+	                                              XMMS_STREAM_TYPE_FMT_CHANNELS);
 
 	XMMS_DBG ("Setting format to rate: %i, channels: %i",
-	          data->rate,
-	          data->channels);
+	          restart->rate,
+	          restart->channels);
+
+	/* Set the Vorbis comment to the current track metadata. */
+	vorbis_comment_init (&restart->vc);
+
+	entry = xmms_output_current_id (output);
+	xmms_ices_update_comment (entry, &restart->vc);
 
-	xmms_ices_encoder_stream_change (data->encoder, data->rate, data->channels,
-	                                 &data->vc);
+	/* The encoder thread builds the encoder if there is none, and
+	 * fires it up after the audio of the last stream. */
+	xmms_ices_pipe_rate_set (data->pipe, restart->rate * restart->channels *
+	                                     sizeof (xmms_samplefloat_t));
+	xmms_ices_pipe_call (data->pipe, xmms_ices_restart, restart,
+	                     xmms_ices_restart_free);
+	data->streaming = TRUE;
 
 	return TRUE;
 }
@@ -337,14 +518,18 @@ xmms_ices_write (xmms_output_t *output, gpointer buffer,
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
-	if (!data->encoder) {
+	if (!data->streaming) {
 		xmms_error_set (err, XMMS_ERROR_GENERIC, "encoding is not initialized");
 		return;
 	}
 
-	xmms_ices_encoder_input (data->encoder, buffer, len);
+	if (!xmms_ices_pipe_write (data->pipe, buffer, len)) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC,
+		                "Error when sending data to icecast server");
+		return;
+	}
 
-	xmms_ices_send_shout (data, err);
+	xmms_ices_drops_check (data);
 }
 
 static void
@@ -384,22 +569,21 @@ static void
 on_playlist_entry_changed (xmms_object_t *object, xmmsv_t *arg, gpointer udata)
 {
 	xmms_ices_data_t * data = udata;
+	xmms_ices_restart_t *restart;
 	xmms_medialib_entry_t entry;
 
 	if (!xmmsv_get_int (arg, &entry))
 		return;
 
-	if (data->encoder)
-		xmms_ices_flush_internal (data);
+	/* rate 0 keeps the format, and makes it a no-op if the encoder
+	 * isn't running */
+	restart = g_new0 (xmms_ices_restart_t, 1);
+	vorbis_comment_init (&restart->vc);
 
-	vorbis_comment_clear (&data->vc);
-	vorbis_comment_init (&data->vc);
-
-	xmms_ices_update_comment (entry, &data->vc);
+	xmms_ices_update_comment (entry, &restart->vc);
 
 	XMMS_DBG ("Updating comment");
 
-	xmms_ices_encoder_stream_change (data->encoder, data->rate, data->channels,
-	                                 &data->vc);
-
+	xmms_ices_pipe_call (data->pipe, xmms_ices_restart, restart,
+	                     xmms_ices_restart_free);
 }
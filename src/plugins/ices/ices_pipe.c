@@ -0,0 +1,586 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Encode-and-send pipeline of the ices output.
+ *
+ * Audio written by the output thread is queued for an encoder thread,
+ * which hands the encoded pages to a sender thread through a second
+ * queue. A slow encoder or a stalled connection thus only fills the
+ * queues instead of holding up the output thread. How much audio may
+ * wait to be encoded is limited by the backlog; what happens to audio
+ * beyond that is up to the policy.
+ *
+ * As nothing waits for the network anymore, the writer is instead
+ * paced to real time here, so that the backlog only fills up when the
+ * encoder or the connection can't keep up.
+ */
+
+#include <string.h>
+
+#include "ices_pipe.h"
+
+/* how far the writer may get ahead of real time */
+#define PACE_LEAD_USEC 200000
+/* encoded data waiting to be sent before the encoder waits too */
+#define PAGE_BACKLOG (32 * 1024)
+
+typedef enum {
+	CHUNK_AUDIO,
+	CHUNK_CALL,
+	CHUNK_MARK
+} xmms_ices_pipe_chunk_type_t;
+
+typedef struct xmms_ices_pipe_chunk_St {
+	xmms_ices_pipe_chunk_type_t type;
+	gpointer data;
+	gint len;
+	guint64 duration;
+	guint64 queued_at;
+	xmms_ices_pipe_call_func_t func;
+	GDestroyNotify destroy;
+	guint64 mark;
+} xmms_ices_pipe_chunk_t;
+
+typedef struct xmms_ices_pipe_page_St {
+	guchar *data;
+	gint len;
+	/** if not 0 this is no page, but tells drain how far we got */
+	guint64 mark;
+} xmms_ices_pipe_page_t;
+
+struct xmms_ices_pipe_St {
+	xmms_ices_pipe_encode_func_t encode;
+	xmms_ices_pipe_send_func_t send;
+	gpointer udata;
+	guint64 backlog_usec;
+	xmms_ices_pipe_policy_t policy;
+
+	GTimer *clock;
+	GThread *encoder;
+	GThread *sender;
+
+	GMutex *mutex;
+	/** signalled when there is something to encode */
+	GCond *encode_cond;
+	/** signalled when there is something to send */
+	GCond *send_cond;
+	/** signalled when either queue shrinks or sending failed */
+	GCond *room_cond;
+	/** signalled when a mark has been reached */
+	GCond *mark_cond;
+
+	GQueue *chunks;
+	guint64 queued_usec;
+	GQueue *pages;
+	gint queued_bytes;
+	gint bytes_per_second;
+	gboolean quit;
+	gboolean failed;
+	guint64 next_mark;
+	guint64 sent_mark;
+	xmms_ices_pipe_stats_t stats;
+
+	/* only used by the writer */
+	guint64 pace_start;
+	guint64 paced_usec;
+};
+
+static guint64
+xmms_ices_pipe_now (xmms_ices_pipe_t *pipe)
+{
+	return g_timer_elapsed (pipe->clock, NULL) * G_USEC_PER_SEC;
+}
+
+static void
+xmms_ices_pipe_chunk_free (xmms_ices_pipe_chunk_t *chunk)
+{
+	if (chunk->type == CHUNK_CALL) {
+		if (chunk->destroy) {
+			chunk->destroy (chunk->data);
+		}
+	} else {
+		g_free (chunk->data);
+	}
+	g_free (chunk);
+}
+
+static void
+xmms_ices_pipe_page_free (xmms_ices_pipe_page_t *page)
+{
+	g_free (page->data);
+	g_free (page);
+}
+
+/* Must be called with the mutex held. */
+static void
+xmms_ices_pipe_chunk_queue (xmms_ices_pipe_t *pipe,
+                            xmms_ices_pipe_chunk_t *chunk)
+{
+	chunk->queued_at = xmms_ices_pipe_now (pipe);
+	pipe->queued_usec += chunk->duration;
+	g_queue_push_tail (pipe->chunks, chunk);
+	g_cond_signal (pipe->encode_cond);
+}
+
+/* Must be called with the mutex held. The page is dropped if nothing
+ * is going to be sent anyway. */
+static void
+xmms_ices_pipe_page_queue (xmms_ices_pipe_t *pipe, xmms_ices_pipe_page_t *page)
+{
+	while (!pipe->quit && !pipe->failed && pipe->queued_bytes > 0 &&
+	       pipe->queued_bytes + page->len > PAGE_BACKLOG) {
+		g_cond_wait (pipe->room_cond, pipe->mutex);
+	}
+
+	if (pipe->quit || (pipe->failed && !page->mark)) {
+		xmms_ices_pipe_page_free (page);
+		return;
+	}
+
+	pipe->queued_bytes += page->len;
+	g_queue_push_tail (pipe->pages, page);
+	g_cond_signal (pipe->send_cond);
+}
+
+/* Throw away the audio that has waited the longest to make room; calls
+ * are kept. Must be called with the mutex held. */
+static gboolean
+xmms_ices_pipe_drop_oldest (xmms_ices_pipe_t *pipe)
+{
+	xmms_ices_pipe_chunk_t *chunk;
+	GList *n;
+
+	for (n = pipe->chunks->head; n; n = g_list_next (n)) {
+		chunk = n->data;
+		if (chunk->type == CHUNK_AUDIO) {
+			g_queue_delete_link (pipe->chunks, n);
+			pipe->queued_usec -= chunk->duration;
+			pipe->stats.dropped_usec += chunk->duration;
+			xmms_ices_pipe_chunk_free (chunk);
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gpointer
+xmms_ices_pipe_encoder (gpointer udata)
+{
+	xmms_ices_pipe_t *pipe = udata;
+	xmms_ices_pipe_chunk_t *chunk;
+	xmms_ices_pipe_page_t *page;
+	guint64 lag;
+
+	g_mutex_lock (pipe->mutex);
+
+	while (!pipe->quit) {
+		chunk = g_queue_pop_head (pipe->chunks);
+		if (!chunk) {
+			g_cond_wait (pipe->encode_cond, pipe->mutex);
+			continue;
+		}
+
+		pipe->queued_usec -= chunk->duration;
+		if (chunk->type == CHUNK_AUDIO) {
+			lag = xmms_ices_pipe_now (pipe) - chunk->queued_at;
+			pipe->stats.encoder_lag_usec = lag;
+			pipe->stats.encoder_lag_max_usec = MAX (lag, pipe->stats.encoder_lag_max_usec);
+		}
+		g_cond_broadcast (pipe->room_cond);
+
+		if (chunk->type == CHUNK_MARK) {
+			/* passed on to the sender, so that it arrives there
+			 * after everything encoded before it */
+			page = g_new0 (xmms_ices_pipe_page_t, 1);
+			page->mark = chunk->mark;
+			xmms_ices_pipe_page_queue (pipe, page);
+			xmms_ices_pipe_chunk_free (chunk);
+			continue;
+		}
+
+		g_mutex_unlock (pipe->mutex);
+
+		if (chunk->type == CHUNK_AUDIO) {
+			pipe->encode (pipe->udata, chunk->data, chunk->len);
+		} else {
+			chunk->func (pipe->udata, chunk->data);
+		}
+		xmms_ices_pipe_chunk_free (chunk);
+
+		g_mutex_lock (pipe->mutex);
+	}
+
+	g_mutex_unlock (pipe->mutex);
+
+	return NULL;
+}
+
+static gpointer
+xmms_ices_pipe_sender (gpointer udata)
+{
+	xmms_ices_pipe_t *pipe = udata;
+	xmms_ices_pipe_page_t *page;
+	guint64 start, took;
+	gboolean ret;
+
+	g_mutex_lock (pipe->mutex);
+
+	while (!pipe->quit) {
+		page = g_queue_pop_head (pipe->pages);
+		if (!page) {
+			g_cond_wait (pipe->send_cond, pipe->mutex);
+			continue;
+		}
+
+		pipe->queued_bytes -= page->len;
+		g_cond_broadcast (pipe->room_cond);
+
+		if (page->mark) {
+			pipe->sent_mark = page->mark;
+			g_cond_broadcast (pipe->mark_cond);
+			xmms_ices_pipe_page_free (page);
+			continue;
+		}
+
+		if (pipe->failed) {
+			xmms_ices_pipe_page_free (page);
+			continue;
+		}
+
+		g_mutex_unlock (pipe->mutex);
+
+		start = xmms_ices_pipe_now (pipe);
+		ret = pipe->send (pipe->udata, page->data, page->len);
+		took = xmms_ices_pipe_now (pipe) - start;
+
+		g_mutex_lock (pipe->mutex);
+
+		pipe->stats.send_usec = took;
+		pipe->stats.send_max_usec = MAX (took, pipe->stats.send_max_usec);
+		if (ret) {
+			pipe->stats.pages_sent++;
+			pipe->stats.bytes_sent += page->len;
+		} else {
+			pipe->failed = TRUE;
+			g_cond_broadcast (pipe->room_cond);
+			g_cond_broadcast (pipe->mark_cond);
+		}
+
+		xmms_ices_pipe_page_free (page);
+	}
+
+	g_mutex_unlock (pipe->mutex);
+
+	return NULL;
+}
+
+/**
+ * Create a pipeline and start its threads.
+ *
+ * @param encode called on the encoder thread for the written audio
+ * @param send called on the sender thread for the pushed pages
+ * @param udata passed to encode, send and the functions given to
+ * #xmms_ices_pipe_call
+ * @param backlog_ms how much audio may wait to be encoded
+ * @param policy what to do with audio beyond that
+ */
+xmms_ices_pipe_t *
+xmms_ices_pipe_new (xmms_ices_pipe_encode_func_t encode,
+                    xmms_ices_pipe_send_func_t send,
+                    gpointer udata, gint backlog_ms,
+                    xmms_ices_pipe_policy_t policy)
+{
+	xmms_ices_pipe_t *pipe;
+
+	g_return_val_if_fail (encode, NULL);
+	g_return_val_if_fail (send, NULL);
+
+	pipe = g_new0 (xmms_ices_pipe_t, 1);
+	pipe->encode = encode;
+	pipe->send = send;
+	pipe->udata = udata;
+	pipe->backlog_usec = (guint64) MAX (backlog_ms, 0) * 1000;
+	pipe->policy = policy;
+
+	pipe->clock = g_timer_new ();
+	pipe->mutex = g_mutex_new ();
+	pipe->encode_cond = g_cond_new ();
+	pipe->send_cond = g_cond_new ();
+	pipe->room_cond = g_cond_new ();
+	pipe->mark_cond = g_cond_new ();
+	pipe->chunks = g_queue_new ();
+	pipe->pages = g_queue_new ();
+
+	pipe->encoder = g_thread_create (xmms_ices_pipe_encoder, pipe, TRUE, NULL);
+	pipe->sender = g_thread_create (xmms_ices_pipe_sender, pipe, TRUE, NULL);
+
+	return pipe;
+}
+
+/**
+ * Stop the threads and free the pipeline. Whatever is still queued is
+ * thrown away, use #xmms_ices_pipe_drain first to get it sent.
+ */
+void
+xmms_ices_pipe_free (xmms_ices_pipe_t *pipe)
+{
+	xmms_ices_pipe_chunk_t *chunk;
+	xmms_ices_pipe_page_t *page;
+
+	g_return_if_fail (pipe);
+
+	g_mutex_lock (pipe->mutex);
+	pipe->quit = TRUE;
+	g_cond_broadcast (pipe->encode_cond);
+	g_cond_broadcast (pipe->send_cond);
+	g_cond_broadcast (pipe->room_cond);
+	g_cond_broadcast (pipe->mark_cond);
+	g_mutex_unlock (pipe->mutex);
+
+	g_thread_join (pipe->encoder);
+	g_thread_join (pipe->sender);
+
+	while ((chunk = g_queue_pop_head (pipe->chunks))) {
+		xmms_ices_pipe_chunk_free (chunk);
+	}
+	while ((page = g_queue_pop_head (pipe->pages))) {
+		xmms_ices_pipe_page_free (page);
+	}
+
+	g_queue_free (pipe->chunks);
+	g_queue_free (pipe->pages);
+	g_cond_free (pipe->encode_cond);
+	g_cond_free (pipe->send_cond);
+	g_cond_free (pipe->room_cond);
+	g_cond_free (pipe->mark_cond);
+	g_mutex_free (pipe->mutex);
+	g_timer_destroy (pipe->clock);
+	g_free (pipe);
+}
+
+/**
+ * Set how many bytes of the audio written from now on make a second.
+ * Until this is set the written audio takes no time, so it is neither
+ * paced nor limited by the backlog.
+ */
+void
+xmms_ices_pipe_rate_set (xmms_ices_pipe_t *pipe, gint bytes_per_second)
+{
+	g_return_if_fail (pipe);
+
+	g_mutex_lock (pipe->mutex);
+	pipe->bytes_per_second = bytes_per_second;
+	g_mutex_unlock (pipe->mutex);
+}
+
+/* Sleep for as long as the writer is ahead of real time. After a long
+ * stall the clock is moved on, so that no more than the backlog is
+ * sent in a burst afterwards. */
+static void
+xmms_ices_pipe_pace (xmms_ices_pipe_t *pipe, guint64 duration)
+{
+	guint64 now = xmms_ices_pipe_now (pipe);
+	gint64 ahead;
+
+	pipe->paced_usec += duration;
+	ahead = (gint64) (pipe->pace_start + pipe->paced_usec) - (gint64) now;
+
+	if (ahead < -(gint64) pipe->backlog_usec) {
+		pipe->pace_start = now - pipe->paced_usec;
+	} else if (ahead > PACE_LEAD_USEC) {
+		g_usleep (ahead - PACE_LEAD_USEC);
+	}
+}
+
+/**
+ * Queue audio for encoding, and wait if the writer is ahead of real
+ * time. If the backlog is full, the policy decides whether to wait
+ * for room or to throw audio away.
+ *
+ * @returns FALSE if sending has failed
+ */
+gboolean
+xmms_ices_pipe_write (xmms_ices_pipe_t *pipe, gconstpointer buf, gint len)
+{
+	xmms_ices_pipe_chunk_t *chunk;
+	guint64 duration = 0, start;
+
+	g_return_val_if_fail (pipe, FALSE);
+	g_return_val_if_fail (buf, FALSE);
+
+	g_mutex_lock (pipe->mutex);
+
+	if (pipe->bytes_per_second > 0) {
+		duration = (guint64) len * G_USEC_PER_SEC / pipe->bytes_per_second;
+	}
+
+	while (!pipe->failed && pipe->queued_usec > 0 &&
+	       pipe->queued_usec + duration > pipe->backlog_usec) {
+		if (pipe->policy == XMMS_ICES_PIPE_DROP_NEWEST) {
+			pipe->stats.written_usec += duration;
+			pipe->stats.dropped_usec += duration;
+			g_mutex_unlock (pipe->mutex);
+
+			xmms_ices_pipe_pace (pipe, duration);
+			return TRUE;
+		} else if (pipe->policy == XMMS_ICES_PIPE_DROP_OLDEST) {
+			if (!xmms_ices_pipe_drop_oldest (pipe)) {
+				break;
+			}
+		} else {
+			start = xmms_ices_pipe_now (pipe);
+			g_cond_wait (pipe->room_cond, pipe->mutex);
+			pipe->stats.blocked_usec += xmms_ices_pipe_now (pipe) - start;
+		}
+	}
+
+	if (pipe->failed) {
+		g_mutex_unlock (pipe->mutex);
+		return FALSE;
+	}
+
+	chunk = g_new0 (xmms_ices_pipe_chunk_t, 1);
+	chunk->type = CHUNK_AUDIO;
+	chunk->data = g_memdup (buf, len);
+	chunk->len = len;
+	chunk->duration = duration;
+	xmms_ices_pipe_chunk_queue (pipe, chunk);
+
+	pipe->stats.written_usec += duration;
+
+	g_mutex_unlock (pipe->mutex);
+
+	xmms_ices_pipe_pace (pipe, duration);
+
+	return TRUE;
+}
+
+/**
+ * Run func on the encoder thread, after the audio written so far has
+ * been encoded. This is how the encoder is reconfigured without
+ * locking. The data is freed with destroy afterwards, or if the
+ * pipeline is freed before getting to it.
+ */
+void
+xmms_ices_pipe_call (xmms_ices_pipe_t *pipe, xmms_ices_pipe_call_func_t func,
+                     gpointer data, GDestroyNotify destroy)
+{
+	xmms_ices_pipe_chunk_t *chunk;
+
+	g_return_if_fail (pipe);
+	g_return_if_fail (func);
+
+	chunk = g_new0 (xmms_ices_pipe_chunk_t, 1);
+	chunk->type = CHUNK_CALL;
+	chunk->func = func;
+	chunk->data = data;
+	chunk->destroy = destroy;
+
+	g_mutex_lock (pipe->mutex);
+	xmms_ices_pipe_chunk_queue (pipe, chunk);
+	g_mutex_unlock (pipe->mutex);
+}
+
+/**
+ * Queue an encoded page for sending, waiting if too much is queued
+ * already. Meant to be called from the encode function or functions
+ * run with #xmms_ices_pipe_call.
+ */
+void
+xmms_ices_pipe_page_push (xmms_ices_pipe_t *pipe,
+                          gconstpointer header, gint header_len,
+                          gconstpointer body, gint body_len)
+{
+	xmms_ices_pipe_page_t *page;
+
+	g_return_if_fail (pipe);
+
+	page = g_new0 (xmms_ices_pipe_page_t, 1);
+	page->len = header_len + body_len;
+	page->data = g_malloc (page->len);
+	memcpy (page->data, header, header_len);
+	memcpy (page->data + header_len, body, body_len);
+
+	g_mutex_lock (pipe->mutex);
+	xmms_ices_pipe_page_queue (pipe, page);
+	g_mutex_unlock (pipe->mutex);
+}
+
+/**
+ * Wait until everything written and called so far has been encoded,
+ * and everything encoded from it has been sent.
+ *
+ * @returns FALSE if sending failed
+ */
+gboolean
+xmms_ices_pipe_drain (xmms_ices_pipe_t *pipe)
+{
+	xmms_ices_pipe_chunk_t *chunk;
+	guint64 mark;
+	gboolean ret;
+
+	g_return_val_if_fail (pipe, FALSE);
+
+	chunk = g_new0 (xmms_ices_pipe_chunk_t, 1);
+	chunk->type = CHUNK_MARK;
+
+	g_mutex_lock (pipe->mutex);
+
+	/* the chunk is freed by the encoder thread */
+	mark = chunk->mark = ++pipe->next_mark;
+	xmms_ices_pipe_chunk_queue (pipe, chunk);
+
+	while (!pipe->failed && !pipe->quit && pipe->sent_mark < mark) {
+		g_cond_wait (pipe->mark_cond, pipe->mutex);
+	}
+	ret = !pipe->failed;
+
+	g_mutex_unlock (pipe->mutex);
+
+	return ret;
+}
+
+/**
+ * Start sending again after a failure, and restart the clock the
+ * writer is paced by. For when a new connection has been made.
+ */
+void
+xmms_ices_pipe_reset (xmms_ices_pipe_t *pipe)
+{
+	g_return_if_fail (pipe);
+
+	g_mutex_lock (pipe->mutex);
+	pipe->failed = FALSE;
+	g_mutex_unlock (pipe->mutex);
+
+	pipe->pace_start = xmms_ices_pipe_now (pipe);
+	pipe->paced_usec = 0;
+}
+
+void
+xmms_ices_pipe_stats_get (xmms_ices_pipe_t *pipe,
+                          xmms_ices_pipe_stats_t *stats)
+{
+	g_return_if_fail (pipe);
+	g_return_if_fail (stats);
+
+	g_mutex_lock (pipe->mutex);
+	*stats = pipe->stats;
+	stats->queued_usec = pipe->queued_usec;
+	g_mutex_unlock (pipe->mutex);
+}
@@ -0,0 +1,93 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __ICES_PIPE_H__
+#define __ICES_PIPE_H__
+
+#include <glib.h>
+
+typedef struct xmms_ices_pipe_St xmms_ices_pipe_t;
+
+/** What to do with new audio when the backlog is full */
+typedef enum {
+	/** make the writer wait, nothing is lost */
+	XMMS_ICES_PIPE_BLOCK,
+	/** throw away the audio that has waited the longest */
+	XMMS_ICES_PIPE_DROP_OLDEST,
+	/** throw away the audio being written */
+	XMMS_ICES_PIPE_DROP_NEWEST
+} xmms_ices_pipe_policy_t;
+
+/**
+ * Called on the encoder thread with audio in the order it was written.
+ * Encoded data is handed on with #xmms_ices_pipe_page_push.
+ */
+typedef void (*xmms_ices_pipe_encode_func_t) (gpointer udata,
+                                              gconstpointer buf, gint len);
+
+/**
+ * Called on the sender thread for every pushed page.
+ *
+ * @returns FALSE if the connection failed; nothing more is sent after
+ * that until #xmms_ices_pipe_reset is called.
+ */
+typedef gboolean (*xmms_ices_pipe_send_func_t) (gpointer udata,
+                                                gconstpointer buf, gint len);
+
+/** Called on the encoder thread by #xmms_ices_pipe_call */
+typedef void (*xmms_ices_pipe_call_func_t) (gpointer udata, gpointer data);
+
+typedef struct xmms_ices_pipe_stats_St {
+	/** audio written, in microseconds */
+	guint64 written_usec;
+	/** audio thrown away because the backlog was full */
+	guint64 dropped_usec;
+	/** time writers spent waiting for room, in microseconds */
+	guint64 blocked_usec;
+	/** audio waiting to be encoded right now, in microseconds */
+	guint64 queued_usec;
+	/** how long the last chunk of audio waited to be encoded */
+	guint64 encoder_lag_usec;
+	guint64 encoder_lag_max_usec;
+	/** how long the last page took to send, and the longest one did */
+	guint64 send_usec;
+	guint64 send_max_usec;
+	guint64 pages_sent;
+	guint64 bytes_sent;
+} xmms_ices_pipe_stats_t;
+
+xmms_ices_pipe_t *xmms_ices_pipe_new (xmms_ices_pipe_encode_func_t encode,
+                                      xmms_ices_pipe_send_func_t send,
+                                      gpointer udata, gint backlog_ms,
+                                      xmms_ices_pipe_policy_t policy);
+void xmms_ices_pipe_free (xmms_ices_pipe_t *pipe);
+
+void xmms_ices_pipe_rate_set (xmms_ices_pipe_t *pipe, gint bytes_per_second);
+gboolean xmms_ices_pipe_write (xmms_ices_pipe_t *pipe, gconstpointer buf,
+                               gint len);
+void xmms_ices_pipe_call (xmms_ices_pipe_t *pipe,
+                          xmms_ices_pipe_call_func_t func, gpointer data,
+                          GDestroyNotify destroy);
+void xmms_ices_pipe_page_push (xmms_ices_pipe_t *pipe,
+                               gconstpointer header, gint header_len,
+                               gconstpointer body, gint body_len);
+gboolean xmms_ices_pipe_drain (xmms_ices_pipe_t *pipe);
+void xmms_ices_pipe_reset (xmms_ices_pipe_t *pipe);
+
+void xmms_ices_pipe_stats_get (xmms_ices_pipe_t *pipe,
+                               xmms_ices_pipe_stats_t *stats);
+
+#endif
@@ -16,9 +16,12 @@
 
 #include "xmms/xmms_outputplugin.h"
 #include "xmms/xmms_log.h"
+#include "xmms/xmms_stats.h"
 
 #include <glib.h>
+#include <string.h>
 #include <jack/jack.h>
+#include <jack/ringbuffer.h>
 
 
 /*
@@ -28,24 +31,55 @@
 /* this isn't really what we want... */
 #define CHANNELS 2
 
+/* periods of audio kept between the feeder and the process callback */
+#define BUFFER_PERIODS "4"
+
 
 /*
  * Type definitions
  */
 
+/*
+ * The process callback runs in JACK's realtime thread and must not
+ * block, so it never touches the output's ringbuffer. A feeder thread
+ * reads from it instead and hands the samples over, one lock-free
+ * jack_ringbuffer per channel. Everything shared with the callback
+ * is either one of those or accessed atomically.
+ */
 typedef struct xmms_jack_data_St {
 	jack_client_t *jack;
 	jack_port_t *ports[CHANNELS];
 	/*           ports */
 	gint chunksiz;
 	gboolean error;
-	gboolean running;
-	guint underruns;
-	guint volume[CHANNELS];
-	gfloat volume_actual[CHANNELS];
-	gfloat new_volume_actual[CHANNELS];
-	gint last_sign[CHANNELS];
+	gint running;
+	gint volume[CHANNELS];
+	/** gain the last period ended at, only used by the callback */
+	gfloat gain[CHANNELS];
 	GMutex *volume_change; /* This should not be needed once the server doesn't allow multiple clients to set the volume at the same time */
+
+	jack_ringbuffer_t *rb[CHANNELS];
+	/** set by flush, the callback drops what's buffered and clears it */
+	gint flush;
+
+	GThread *feeder;
+	GMutex *feeder_mutex;
+	GCond *feeder_cond;
+	gboolean feeder_quit;
+	/** interleaved and per channel scratch space of the feeder */
+	xmms_samplefloat_t *feed_buf;
+	xmms_samplefloat_t *feed_chan[CHANNELS];
+	gint feed_frames;
+
+	/** periods where the callback ran out of samples while playing */
+	gint late_fills;
+	/** xruns reported by the JACK server */
+	gint xruns;
+	/** how much of the two the feeder has added to the stats */
+	gint reported_late_fills;
+	gint reported_xruns;
+	xmms_stats_counter_t *late_fills_stat;
+	xmms_stats_counter_t *xruns_stat;
 } xmms_jack_data_t;
 
 
@@ -61,6 +95,10 @@ static void xmms_jack_flush (xmms_output_t *output);
 static gboolean xmms_jack_volume_set (xmms_output_t *output, const gchar *channel, guint volume);
 static gboolean xmms_jack_volume_get (xmms_output_t *output, const gchar **names, guint *values, guint *num_channels);
 static int xmms_jack_process (jack_nframes_t frames, void *arg);
+static int xmms_jack_xrun (void *arg);
+static void xmms_jack_free (xmms_jack_data_t *data);
+static gpointer xmms_jack_feeder (gpointer arg);
+static void xmms_jack_report (xmms_jack_data_t *data);
 static void xmms_jack_shutdown (void *arg);
 static void xmms_jack_error (const gchar *desc);
 static gboolean xmms_jack_ports_connected (xmms_output_t *output);
@@ -106,6 +144,9 @@ xmms_jack_plugin_setup (xmms_output_plugin_t *plugin)
 	xmms_output_plugin_config_property_register (plugin, "volume.right", "100",
 	                                             NULL, NULL);
 
+	xmms_output_plugin_config_property_register (plugin, "buffer_periods",
+	                                             BUFFER_PERIODS, NULL, NULL);
+
 	jack_set_error_function (xmms_jack_error);
 
 	return TRUE;
@@ -120,7 +161,7 @@ xmms_jack_plugin_setup (xmms_output_plugin_t *plugin)
 static gboolean
 xmms_jack_connect (xmms_output_t *output)
 {
-	int i;
+	int i, periods;
 	const xmms_config_property_t *cv;
 	const gchar *clientname;
 	xmms_jack_data_t *data;
@@ -137,7 +178,8 @@ xmms_jack_connect (xmms_output_t *output)
 		return FALSE;
 	}
 
-	jack_set_process_callback (data->jack, xmms_jack_process, output);
+	jack_set_process_callback (data->jack, xmms_jack_process, data);
+	jack_set_xrun_callback (data->jack, xmms_jack_xrun, data);
 	jack_on_shutdown (data->jack, xmms_jack_shutdown, output);
 
 
@@ -152,9 +194,29 @@ xmms_jack_connect (xmms_output_t *output)
 
 	data->chunksiz = jack_get_buffer_size (data->jack);
 
+	cv = xmms_output_config_lookup (output, "buffer_periods");
+	periods = MAX (xmms_config_property_get_int (cv), 2);
+
+	/* the ringbuffer rounds up to a power of two, use all of it */
+	for (i = 0; i < CHANNELS; i++) {
+		data->rb[i] = jack_ringbuffer_create (periods * data->chunksiz *
+		                                      sizeof (xmms_samplefloat_t));
+		jack_ringbuffer_mlock (data->rb[i]);
+	}
+	data->feed_frames = jack_ringbuffer_write_space (data->rb[0]) /
+	                    sizeof (xmms_samplefloat_t);
+
+	data->feed_buf = g_new (xmms_samplefloat_t, data->feed_frames * CHANNELS);
+	for (i = 0; i < CHANNELS; i++) {
+		data->feed_chan[i] = g_new (xmms_samplefloat_t, data->feed_frames);
+	}
+
+	data->feeder = g_thread_create (xmms_jack_feeder, output, TRUE, NULL);
+
 	if (jack_activate (data->jack)) {
 		/* jadda jadda */
 		jack_client_close (data->jack);
+		data->jack = NULL;
 		return FALSE;
 	}
 
@@ -169,34 +231,34 @@ xmms_jack_new (xmms_output_t *output)
 {
 	xmms_jack_data_t *data;
 	xmms_config_property_t *cv;
-	int connect;
+	int connect, i;
 
 	g_return_val_if_fail (output, FALSE);
 
 	data = g_new0 (xmms_jack_data_t, 1);
 
-	data->underruns = 0;
-
 	cv = xmms_output_config_lookup (output, "volume.left");
 	data->volume[0] = xmms_config_property_get_int (cv);
 
 	cv = xmms_output_config_lookup (output, "volume.right");
 	data->volume[1] = xmms_config_property_get_int (cv);
 
-	data->volume_actual[0] = (gfloat)(data->volume[0] / 100.0);
-	data->volume_actual[0] *= data->volume_actual[0];
-	data->new_volume_actual[0] = data->volume_actual[0];
-	data->volume_actual[1] = (gfloat)(data->volume[1] / 100.0);
-	data->volume_actual[1] *= data->volume_actual[1];
-	data->new_volume_actual[1] = data->volume_actual[1];
+	for (i = 0; i < CHANNELS; i++) {
+		data->gain[i] = (gfloat)(data->volume[i] / 100.0);
+		data->gain[i] *= data->gain[i];
+	}
 
 	data->volume_change = g_mutex_new ();
+	data->feeder_mutex = g_mutex_new ();
+	data->feeder_cond = g_cond_new ();
+
+	data->late_fills_stat = xmms_stats_counter_register ("jack.late_fills");
+	data->xruns_stat = xmms_stats_counter_register ("jack.xruns");
 
 	xmms_output_private_data_set (output, data);
 
 	if (!xmms_jack_connect (output)) {
-		g_mutex_free (data->volume_change);
-		g_free (data);
+		xmms_jack_free (data);
 		return FALSE;
 	}
 
@@ -209,8 +271,7 @@ xmms_jack_new (xmms_output_t *output)
 	if (connect == 1) {
 
 		if (!xmms_jack_ports_connected (output) && !xmms_jack_connect_ports (output)) {
-			g_mutex_free (data->volume_change);
-			g_free (data);
+			xmms_jack_free (data);
 			return FALSE;
 		}
 
@@ -229,13 +290,48 @@ xmms_jack_destroy (xmms_output_t *output)
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
-	g_mutex_free (data->volume_change);
+	XMMS_DBG ("jack output had %d late periods and %d xruns",
+	          g_atomic_int_get (&data->late_fills),
+	          g_atomic_int_get (&data->xruns));
+
+	xmms_jack_free (data);
+}
+
+
+/* Closes the client first, so that nothing runs the callback anymore */
+static void
+xmms_jack_free (xmms_jack_data_t *data)
+{
+	gint i;
 
 	if (data->jack) {
 		jack_deactivate (data->jack);
 		jack_client_close (data->jack);
 	}
 
+	if (data->feeder) {
+		g_mutex_lock (data->feeder_mutex);
+		data->feeder_quit = TRUE;
+		g_cond_signal (data->feeder_cond);
+		g_mutex_unlock (data->feeder_mutex);
+
+		g_thread_join (data->feeder);
+
+		xmms_jack_report (data);
+	}
+
+	for (i = 0; i < CHANNELS; i++) {
+		if (data->rb[i]) {
+			jack_ringbuffer_free (data->rb[i]);
+		}
+		g_free (data->feed_chan[i]);
+	}
+	g_free (data->feed_buf);
+
+	g_cond_free (data->feeder_cond);
+	g_mutex_free (data->feeder_mutex);
+	g_mutex_free (data->volume_change);
+
 	g_free (data);
 }
 
@@ -309,11 +405,11 @@ xmms_jack_status (xmms_output_t *output, xmms_playback_status_t status)
 	data = xmms_output_private_data_get (output);
 	g_return_val_if_fail (data, FALSE);
 
-	if (status == XMMS_PLAYBACK_STATUS_PLAY) {
-		data->running = TRUE;
-	} else {
-		data->running = FALSE;
-	}
+	g_atomic_int_set (&data->running, status == XMMS_PLAYBACK_STATUS_PLAY);
+
+	g_mutex_lock (data->feeder_mutex);
+	g_cond_signal (data->feeder_cond);
+	g_mutex_unlock (data->feeder_mutex);
 
 	return TRUE;
 }
@@ -322,126 +418,242 @@ xmms_jack_status (xmms_output_t *output, xmms_playback_status_t status)
 static void
 xmms_jack_flush (xmms_output_t *output)
 {
-	/* do nothing... */
+	xmms_jack_data_t *data;
+
+	g_return_if_fail (output);
+	data = xmms_output_private_data_get (output);
+	g_return_if_fail (data);
+
+	/* only the reading side may empty the ringbuffers */
+	g_atomic_int_set (&data->flush, TRUE);
 }
 
 
-static int
-xmms_jack_process (jack_nframes_t frames, void *arg)
+/**
+ * Move what the output has into the ringbuffers, without waiting
+ * for more.
+ *
+ * @returns TRUE if anything was moved
+ */
+static gboolean
+xmms_jack_feed (xmms_output_t *output, xmms_jack_data_t *data)
 {
-	xmms_output_t *output = (xmms_output_t*) arg;
+	gint i, j, frames, res;
+	gint framesize = CHANNELS * sizeof (xmms_samplefloat_t);
+
+	/* written in step, so the last channel has the least room */
+	frames = jack_ringbuffer_write_space (data->rb[CHANNELS - 1]) /
+	         sizeof (xmms_samplefloat_t);
+	frames = MIN (frames, xmms_output_bytes_available (output) / framesize);
+
+	if (frames <= 0) {
+		return FALSE;
+	}
+
+	res = xmms_output_read (output, (gchar *) data->feed_buf,
+	                        frames * framesize);
+	if (res <= 0) {
+		return FALSE;
+	}
+
+	frames = res / framesize;
+
+	for (j = 0; j < CHANNELS; j++) {
+		for (i = 0; i < frames; i++) {
+			data->feed_chan[j][i] = data->feed_buf[i * CHANNELS + j];
+		}
+	}
+
+	for (j = 0; j < CHANNELS; j++) {
+		jack_ringbuffer_write (data->rb[j], (const char *) data->feed_chan[j],
+		                       frames * sizeof (xmms_samplefloat_t));
+	}
+
+	return TRUE;
+}
+
+
+/* Add the late periods and xruns counted since the last call to
+ * the stats, the realtime thread can't do that itself */
+static void
+xmms_jack_report (xmms_jack_data_t *data)
+{
+	gint late_fills, xruns;
+
+	late_fills = g_atomic_int_get (&data->late_fills);
+	xruns = g_atomic_int_get (&data->xruns);
+
+	if (late_fills != data->reported_late_fills ||
+	    xruns != data->reported_xruns) {
+		XMMS_DBG ("jack output underrun, %d late periods and %d xruns so far",
+		          late_fills, xruns);
+		xmms_stats_counter_add (data->late_fills_stat,
+		                        late_fills - data->reported_late_fills);
+		xmms_stats_counter_add (data->xruns_stat,
+		                        xruns - data->reported_xruns);
+		data->reported_late_fills = late_fills;
+		data->reported_xruns = xruns;
+	}
+}
+
+
+static gpointer
+xmms_jack_feeder (gpointer arg)
+{
+	xmms_output_t *output = (xmms_output_t *) arg;
 	xmms_jack_data_t *data;
-	xmms_samplefloat_t *buf[CHANNELS];
-	xmms_samplefloat_t tbuf[CHANNELS*4096];
-	gint i, j, res, toread, sign;
+	gboolean fed;
 
-	g_return_val_if_fail (output, -1);
 	data = xmms_output_private_data_get (output);
-	g_return_val_if_fail (data, -1);
+
+	g_mutex_lock (data->feeder_mutex);
+
+	while (!data->feeder_quit) {
+		fed = FALSE;
+
+		/* the read may set the status, which takes feeder_mutex */
+		if (g_atomic_int_get (&data->running) &&
+		    !g_atomic_int_get (&data->flush)) {
+			g_mutex_unlock (data->feeder_mutex);
+			fed = xmms_jack_feed (output, data);
+			g_mutex_lock (data->feeder_mutex);
+		}
+
+		xmms_jack_report (data);
+
+		if (fed || data->feeder_quit) {
+			continue;
+		}
+
+		/* while playing the callback wakes us up every period, a
+		 * wakeup it missed is made up for by the next one. Otherwise
+		 * only a status change or the shutdown does. */
+		g_cond_wait (data->feeder_cond, data->feeder_mutex);
+	}
+
+	g_mutex_unlock (data->feeder_mutex);
+
+	return NULL;
+}
+
+
+/**
+ * Multiply by a gain going linearly from gain to gain + step * n.
+ * Kept free of branches and done four samples at a time so that the
+ * compiler can turn it into vector instructions, a constant gain is
+ * just a step of zero.
+ */
+static void
+xmms_jack_apply_gain (xmms_samplefloat_t *restrict out,
+                      const xmms_samplefloat_t *restrict in,
+                      gint n, gfloat gain, gfloat step)
+{
+	gfloat g0, g1, g2, g3;
+	gint i;
+
+	g0 = gain;
+	g1 = gain + step;
+	g2 = gain + step * 2;
+	g3 = gain + step * 3;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		out[i] = in[i] * g0;
+		out[i + 1] = in[i + 1] * g1;
+		out[i + 2] = in[i + 2] * g2;
+		out[i + 3] = in[i + 3] * g3;
+
+		g0 += step * 4;
+		g1 += step * 4;
+		g2 += step * 4;
+		g3 += step * 4;
+	}
+
+	for (; i < n; i++) {
+		out[i] = in[i] * (gain + step * i);
+	}
+}
+
+
+/* Runs in the realtime thread: no locks, allocations or logging here */
+static int
+xmms_jack_process (jack_nframes_t frames, void *arg)
+{
+	xmms_jack_data_t *data = (xmms_jack_data_t *) arg;
+	xmms_samplefloat_t *buf[CHANNELS];
+	jack_ringbuffer_data_t vec[2];
+	gint i, j, avail, n, done;
+	gfloat target, step;
 
 	for (i = 0; i < CHANNELS; i++) {
 		buf[i] = jack_port_get_buffer (data->ports[i], frames);
 	}
 
-	toread = frames;
-
-	if (data->running) {
-		while (toread) {
-			gint t, avail;
-
-			t = MIN (toread * CHANNELS * sizeof (xmms_samplefloat_t),
-			         sizeof (tbuf));
-
-			avail = xmms_output_bytes_available (output);
-
-			if (avail < t) {
-				data->underruns++;
-				XMMS_DBG ("jack output underun number %d! Not enough bytes available. Wanted: %d Available: %d", data->underruns, t, avail);
-				break;
-			}
-
-			res = xmms_output_read (output, (gchar *)tbuf, t);
-
-			if (res <= 0) {
-				XMMS_DBG ("Output read returned %d unexpectedly", res);
-				break;
-			}
-
-			if (res < t) {
-				XMMS_DBG ("Less bytes read than expected. (Probably a ringbuffer hotspot)");
-			}
-
-			res /= CHANNELS * sizeof (xmms_samplefloat_t);
-
-			for (j = 0; j < CHANNELS; j++) {
-				if (data->new_volume_actual[j] == data->volume_actual[j]) {
-					for (i = 0; i < res; i++) {
-						buf[j][i] = (tbuf[i * CHANNELS + j] * data->volume_actual[j]);
-					}
-				} else {
-				
-					/* The way the volume change is set up here, the volume can only change once per callback, but thats 
-					   allways plenty of times per second */
-				
-					/* last_sign: 0 = unset, -1 neg, +1 pos */
-					
-					if (data->last_sign[j] == 0) {
-						if (tbuf[j] > 0.0f) {
-							data->last_sign[j] = 1;
-						} else {
-							/* Zero counts as negative here, but its moot */
-							data->last_sign[j] = -1;
-						}
-					}
-				
-					for (i = 0; i < res; i++) {
-					
-						if (data->last_sign[j] != 0) {
-							if (tbuf[i*CHANNELS + j] > 0.0f) {
-								sign = 1;
-							} else {
-								sign = -1;
-							}
-					
-							if ((sign != data->last_sign[j]) || (tbuf[i * CHANNELS + j] == 0.0f)) {						
-						
-								data->volume_actual[j] = data->new_volume_actual[j];
-								data->last_sign[j] = 0;
-							}
-						}
-						
-						buf[j][i] = (tbuf[i * CHANNELS + j] * data->volume_actual[j]);
-						
-					}
-
-					if (data->last_sign[j] != 0) {
-						data->last_sign[j] = sign;
-					}
-				}
-			}
-			
-			toread -= res;
+	/* the channels are written one after the other and always read
+	 * in step, so the last one has the fewest samples */
+	avail = jack_ringbuffer_read_space (data->rb[CHANNELS - 1]) /
+	        sizeof (xmms_samplefloat_t);
+
+	if (g_atomic_int_get (&data->flush)) {
+		for (j = 0; j < CHANNELS; j++) {
+			jack_ringbuffer_read_advance (data->rb[j],
+			                              avail * sizeof (xmms_samplefloat_t));
 		}
+		g_atomic_int_set (&data->flush, FALSE);
+		avail = 0;
+	}
+
+	if (!g_atomic_int_get (&data->running)) {
+		avail = 0;
+	} else if (avail < frames) {
+		g_atomic_int_inc (&data->late_fills);
 	}
 
-	if ((!data->running) || ((frames - toread) != frames)) {
+	n = MIN (avail, frames);
+
+	for (j = 0; j < CHANNELS; j++) {
+		target = g_atomic_int_get (&data->volume[j]) / 100.0f;
+		target *= target;
+		step = (target - data->gain[j]) / frames;
+
+		jack_ringbuffer_get_read_vector (data->rb[j], vec);
+
+		done = MIN (n, vec[0].len / sizeof (xmms_samplefloat_t));
+		xmms_jack_apply_gain (buf[j], (xmms_samplefloat_t *) vec[0].buf,
+		                      done, data->gain[j], step);
+		xmms_jack_apply_gain (buf[j] + done, (xmms_samplefloat_t *) vec[1].buf,
+		                      n - done, data->gain[j] + step * done, step);
+
+		jack_ringbuffer_read_advance (data->rb[j],
+		                              n * sizeof (xmms_samplefloat_t));
+
 		/* fill rest of buffer with silence */
-		if (data->running) {
-			XMMS_DBG ("Silence for %d frames", toread);
-		}
-		for (j = 0; j < CHANNELS; j++) {
-			if (data->new_volume_actual[j] != data->volume_actual[j]) {
-				data->volume_actual[j] = data->new_volume_actual[j];
-			}
-			for (i = frames - toread; i < frames; i++) {
-				buf[j][i] = 0.0f;
-			}
-		}
+		memset (buf[j] + n, 0, (frames - n) * sizeof (xmms_samplefloat_t));
+
+		data->gain[j] = target;
+	}
+
+	/* a blocking lock isn't allowed here, if the feeder holds it it's
+	 * awake anyway. There is nothing to feed while not playing. */
+	if (g_atomic_int_get (&data->running) &&
+	    g_mutex_trylock (data->feeder_mutex)) {
+		g_cond_signal (data->feeder_cond);
+		g_mutex_unlock (data->feeder_mutex);
 	}
 
 	return 0;
 }
 
+
+static int
+xmms_jack_xrun (void *arg)
+{
+	xmms_jack_data_t *data = (xmms_jack_data_t *) arg;
+
+	g_atomic_int_inc (&data->xruns);
+
+	return 0;
+}
+
 static gboolean
 xmms_jack_volume_set (xmms_output_t *output,
                       const gchar *channel_name, guint volume)
@@ -450,7 +662,6 @@ xmms_jack_volume_set (xmms_output_t *output,
 	xmms_config_property_t *cv;
 	gchar *volume_strp;
 	gchar volume_str[4];
-	gfloat new_volume; /* For atomicness with zero crossing respect */
 
 	g_return_val_if_fail (output, FALSE);
 	g_return_val_if_fail (channel_name, FALSE);
@@ -465,19 +676,14 @@ xmms_jack_volume_set (xmms_output_t *output,
 	g_return_val_if_fail (data, FALSE);
 
 	if (g_ascii_strcasecmp (channel_name, "Left") == 0) {
-		data->volume[0] = volume;
-		new_volume = (gfloat)(volume / 100.0);
-		new_volume *= new_volume;
-		data->new_volume_actual[0] = new_volume;
+		/* the process callback ramps to it over the next period */
+		g_atomic_int_set (&data->volume[0], volume);
 		cv = xmms_output_config_lookup (output, "volume.left");
 		sprintf (volume_str, "%d", data->volume[0]);
 		xmms_config_property_set_data (cv, volume_strp);
 	} else {
 		/* If its not left, its right */
-		data->volume[1] = volume;
-		new_volume = (gfloat)(volume / 100.0);
-		new_volume *= new_volume;
-		data->new_volume_actual[1] = new_volume;
+		g_atomic_int_set (&data->volume[1], volume);
 		cv = xmms_output_config_lookup (output, "volume.right");
 		sprintf (volume_str, "%d", data->volume[1]);
 		xmms_config_property_set_data (cv, volume_strp);
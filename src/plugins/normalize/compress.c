@@ -73,6 +73,31 @@ compress_free (compress_t *compress)
 	g_free (compress);
 }
 
+/* The largest absolute value, at least 1, and where it first occurs.
+** Finding the value first keeps the loop over every sample free of
+** branches, so the compiler can vectorize it, and the position is
+** then only looked for when there is one.
+*/
+static gint
+find_peak (const gint16 *audio, gint count, gint *pos)
+{
+	gint peak = 1;
+	gint i, val;
+
+	for (i = 0; i < count; i++) {
+		val = ABS (audio[i]);
+		peak = MAX (peak, val);
+	}
+
+	*pos = 0;
+	if (peak > 1) {
+		for (i = 0; ABS (audio[i]) != peak; i++);
+		*pos = i;
+	}
+
+	return peak;
+}
+
 void
 compress_do (compress_t *compress, void *data, guint length)
 {
@@ -98,25 +123,11 @@ compress_do (compress_t *compress, void *data, guint length)
 #endif
 
 	/* Determine peak's value and position */
-	peak = 1;
-	pos = 0;
-
 #ifdef DEBUG
 	fprintf (stderr, "finding peak(b=%d)\n", compress->pn);
 #endif
 
-	ap = audio;
-	for (i = 0; i < length/2; i++) {
-		gint val = *ap;
-		if (val > peak) {
-			peak = val;
-			pos = i;
-		} else if (-val > peak) {
-			peak = -val;
-			pos = i;
-		}
-		ap++;
-	}
+	peak = find_peak (audio, length/2, &pos);
 
 	compress->peaks[compress->pn] = peak;
 
@@ -23,6 +23,7 @@
  */
 typedef struct xmms_null_data_St {
 	gint us_per_byte;
+	gboolean realtime;
 } xmms_null_data_t;
 
 /*
@@ -67,6 +68,10 @@ xmms_null_plugin_setup (xmms_output_plugin_t *plugin)
 
 	xmms_output_plugin_methods_set (plugin, &methods);
 
+	/* with 0, audio is thrown away as fast as it is decoded */
+	xmms_output_plugin_config_property_register (plugin, "realtime", "1",
+	                                             NULL, NULL);
+
 	return TRUE;
 }
 
@@ -121,8 +126,17 @@ xmms_null_destroy (xmms_output_t *output)
 static gboolean
 xmms_null_open (xmms_output_t *output)
 {
+	const xmms_config_property_t *cv;
+	xmms_null_data_t *data;
+
 	g_return_val_if_fail (output, FALSE);
 
+	data = xmms_output_private_data_get (output);
+	g_return_val_if_fail (data, FALSE);
+
+	cv = xmms_output_config_lookup (output, "realtime");
+	data->realtime = xmms_config_property_get_int (cv);
+
 	return TRUE;
 }
 
@@ -200,5 +214,7 @@ xmms_null_write (xmms_output_t *output, gpointer buffer, gint len,
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
-	g_usleep (len * data->us_per_byte);
+	if (data->realtime) {
+		g_usleep (len * data->us_per_byte);
+	}
 }
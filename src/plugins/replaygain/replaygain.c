@@ -22,14 +22,15 @@
 #include "xmms/xmms_xformplugin.h"
 #include "xmms/xmms_config.h"
 #include "xmms/xmms_log.h"
+#include "rg_gain.h"
 
 #include <math.h>
 #include <glib.h>
 #include <stdlib.h>
 #include <string.h>
 
-typedef void (*xmms_replaygain_apply_func_t)
-	(void *buf, gint len, gfloat gain);
+/* how many samples get dither noise generated at a time */
+#define DITHER_BLOCK 1024
 
 /**
  * Replaygain modes.
@@ -47,7 +48,11 @@ typedef struct xmms_replaygain_data_St {
 	gfloat gain;
 	gboolean has_replaygain;
 	gboolean enabled;
-	xmms_replaygain_apply_func_t apply;
+	gboolean dither;
+	guint32 dither_state;
+	gint sample_size;
+	xmms_rg_gain_func_t apply;
+	gfloat noise[DITHER_BLOCK];
 } xmms_replaygain_data_t;
 
 static const xmms_sample_format_t formats[] = {
@@ -74,15 +79,6 @@ static void xmms_replaygain_config_changed (xmms_object_t *obj, xmmsv_t *_val, g
 static void compute_gain (xmms_xform_t *xform, xmms_replaygain_data_t *data);
 static xmms_replaygain_mode_t parse_mode (const char *s);
 
-static void apply_s8 (void *buf, gint len, gfloat gain);
-static void apply_u8 (void *buf, gint len, gfloat gain);
-static void apply_s16 (void *buf, gint len, gfloat gain);
-static void apply_u16 (void *buf, gint len, gfloat gain);
-static void apply_s32 (void *buf, gint len, gfloat gain);
-static void apply_u32 (void *buf, gint len, gfloat gain);
-static void apply_float (void *buf, gint len, gfloat gain);
-static void apply_double (void *buf, gint len, gfloat gain);
-
 /*
  * Plugin header
  */
@@ -127,6 +123,9 @@ xmms_replaygain_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	xmms_xform_plugin_config_property_register (xform_plugin,
 	                                            "preamp", "6.0",
 	                                            NULL, NULL);
+	xmms_xform_plugin_config_property_register (xform_plugin,
+	                                            "dither", "0",
+	                                            NULL, NULL);
 
 	return TRUE;
 }
@@ -137,6 +136,7 @@ xmms_replaygain_init (xmms_xform_t *xform)
 	xmms_replaygain_data_t *data;
 	xmms_config_property_t *cfgv;
 	xmms_sample_format_t fmt;
+	xmms_rg_gain_impl_t impl;
 
 	g_return_val_if_fail (xform, FALSE);
 
@@ -173,44 +173,31 @@ xmms_replaygain_init (xmms_xform_t *xform)
 
 	data->enabled = !!xmms_config_property_get_int (cfgv);
 
+	cfgv = xmms_xform_config_lookup (xform, "dither");
+	xmms_config_property_callback_set (cfgv,
+	                                   xmms_replaygain_config_changed,
+	                                   xform);
+
+	data->dither = !!xmms_config_property_get_int (cfgv);
+	data->dither_state = g_random_int () | 1;
+
 	xmms_xform_outdata_type_copy (xform);
 
 	compute_gain (xform, data);
 
 	fmt = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_FORMAT);
 
-	switch (fmt) {
-		case XMMS_SAMPLE_FORMAT_S8:
-			data->apply = apply_s8;
-			break;
-		case XMMS_SAMPLE_FORMAT_U8:
-			data->apply = apply_u8;
-			break;
-		case XMMS_SAMPLE_FORMAT_S16:
-			data->apply = apply_s16;
-			break;
-		case XMMS_SAMPLE_FORMAT_U16:
-			data->apply = apply_u16;
-			break;
-		case XMMS_SAMPLE_FORMAT_S32:
-			data->apply = apply_s32;
-			break;
-		case XMMS_SAMPLE_FORMAT_U32:
-			data->apply = apply_u32;
-			break;
-		case XMMS_SAMPLE_FORMAT_FLOAT:
-			data->apply = apply_float;
-			break;
-		case XMMS_SAMPLE_FORMAT_DOUBLE:
-			data->apply = apply_double;
-			break;
-		default:
-			/* we shouldn't ever get here, since we told the daemon
-			 * earlier about this list of supported formats.
-			 */
-			g_assert_not_reached ();
-			break;
-	}
+	impl = xmms_rg_gain_impl_best ();
+	data->apply = xmms_rg_gain_func (fmt, impl);
+	data->sample_size = xmms_sample_size_get (fmt);
+
+	/* there's a kernel for every format we told the daemon
+	 * earlier that we support.
+	 */
+	g_assert (data->apply);
+
+	XMMS_DBG ("Applying gain with the %s kernels",
+	          xmms_rg_gain_impl_name (impl));
 
 	return TRUE;
 }
@@ -239,6 +226,10 @@ xmms_replaygain_destroy (xmms_xform_t *xform)
 	cfgv = xmms_xform_config_lookup (xform, "enabled");
 	xmms_config_property_callback_remove (cfgv,
 	                                      xmms_replaygain_config_changed, xform);
+
+	cfgv = xmms_xform_config_lookup (xform, "dither");
+	xmms_config_property_callback_remove (cfgv,
+	                                      xmms_replaygain_config_changed, xform);
 }
 
 static gint
@@ -246,8 +237,8 @@ xmms_replaygain_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
                       xmms_error_t *error)
 {
 	xmms_replaygain_data_t *data;
-	xmms_sample_format_t fmt;
-	gint read;
+	guint8 *samples;
+	gint read, count, n;
 
 	g_return_val_if_fail (xform, -1);
 
@@ -256,14 +247,25 @@ xmms_replaygain_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
 
 	read = xmms_xform_read (xform, buf, len, error);
 
-	if (!data->has_replaygain || !data->enabled) {
+	if (read <= 0 || !data->has_replaygain || !data->enabled) {
 		return read;
 	}
 
-	fmt = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_FORMAT);
-	len /= xmms_sample_size_get (fmt);
+	count = read / data->sample_size;
 
-	data->apply (buf, len, data->gain);
+	/* only the 8 and 16 bit formats have few enough bits to need
+	 * dither, the kernels ignore the noise for the others */
+	if (!data->dither || data->sample_size > 2) {
+		data->apply (buf, count, data->gain, NULL);
+		return read;
+	}
+
+	for (samples = buf; count > 0; count -= n) {
+		n = MIN (count, DITHER_BLOCK);
+		xmms_rg_gain_dither (&data->dither_state, data->noise, n);
+		data->apply (samples, n, data->gain, data->noise);
+		samples += n * data->sample_size;
+	}
 
 	return read;
 }
@@ -303,6 +305,8 @@ xmms_replaygain_config_changed (xmms_object_t *obj, xmmsv_t *_val, gpointer udat
 		dirty = TRUE;
 	} else if (!g_ascii_strcasecmp (name, "replaygain.enabled")) {
 		data->enabled = !!atoi (value);
+	} else if (!g_ascii_strcasecmp (name, "replaygain.dither")) {
+		data->dither = !!atoi (value);
 	}
 
 	if (dirty) {
@@ -362,101 +366,3 @@ parse_mode (const char *s)
 		return XMMS_REPLAYGAIN_MODE_TRACK;
 	}
 }
-
-static void
-apply_s8 (void *buf, gint len, gfloat gain)
-{
-	xmms_samples8_t *samples = (xmms_samples8_t *) buf;
-	gint i;
-
-	for (i = 0; i < len; i++) {
-		gfloat sample = samples[i] * gain;
-		samples[i] = CLAMP (sample, XMMS_SAMPLES8_MIN,
-		                    XMMS_SAMPLES8_MAX);
-	}
-}
-
-static void
-apply_u8 (void *buf, gint len, gfloat gain)
-{
-	xmms_sampleu8_t *samples = (xmms_sampleu8_t *) buf;
-	gint i;
-
-	for (i = 0; i < len; i++) {
-		gfloat sample = samples[i] * gain;
-		samples[i] = CLAMP (sample, 0, XMMS_SAMPLEU8_MAX);
-	}
-}
-
-static void
-apply_s16 (void *buf, gint len, gfloat gain)
-{
-	xmms_samples16_t *samples = (xmms_samples16_t *) buf;
-	gint i;
-
-	for (i = 0; i < len; i++) {
-		gfloat sample = samples[i] * gain;
-		samples[i] = CLAMP (sample, XMMS_SAMPLES16_MIN,
-		                    XMMS_SAMPLES16_MAX);
-	}
-}
-
-static void
-apply_u16 (void *buf, gint len, gfloat gain)
-{
-	xmms_sampleu16_t *samples = (xmms_sampleu16_t *) buf;
-	gint i;
-
-	for (i = 0; i < len; i++) {
-		gfloat sample = samples[i] * gain;
-		samples[i] = CLAMP (sample, 0, XMMS_SAMPLEU16_MAX);
-	}
-}
-
-static void
-apply_s32 (void *buf, gint len, gfloat gain)
-{
-	xmms_samples32_t *samples = (xmms_samples32_t *) buf;
-	gint i;
-
-	for (i = 0; i < len; i++) {
-		gdouble sample = samples[i] * gain;
-		samples[i] = CLAMP (sample, XMMS_SAMPLES32_MIN,
-		                    XMMS_SAMPLES32_MAX);
-	}
-}
-
-static void
-apply_u32 (void *buf, gint len, gfloat gain)
-{
-	xmms_sampleu32_t *samples = (xmms_sampleu32_t *) buf;
-	gint i;
-
-	for (i = 0; i < len; i++) {
-		gdouble sample = samples[i] * gain;
-		samples[i] = CLAMP (sample, 0, XMMS_SAMPLEU32_MAX);
-	}
-}
-
-static void
-apply_float (void *buf, gint len, gfloat gain)
-{
-	xmms_samplefloat_t *samples = (xmms_samplefloat_t *) buf;
-	gint i;
-
-	for (i = 0; i < len; i++) {
-		samples[i] *= gain;
-	}
-}
-
-static void
-apply_double (void *buf, gint len, gfloat gain)
-{
-	xmms_sampledouble_t *samples = (xmms_sampledouble_t *) buf;
-	gint i;
-
-	for (i = 0; i < len; i++) {
-		samples[i] *= gain;
-	}
-}
-
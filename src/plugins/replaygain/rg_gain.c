@@ -0,0 +1,273 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Applying a gain to every sample format.
+ *
+ * The plain C versions are the reference. Where the compiler has
+ * vector extensions there are versions doing several samples at a
+ * time, one for the vector unit every CPU of the architecture has and
+ * one using AVX2 on x86 CPUs that support it, picked at runtime.
+ */
+
+#include "xmms_configuration.h"
+#include "rg_gain.h"
+
+#include <string.h>
+
+static void
+apply_s8 (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_samples8_t *samples = (xmms_samples8_t *) buf;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		gfloat sample = samples[i] * gain;
+		if (noise) {
+			sample += noise[i];
+		}
+		samples[i] = CLAMP (sample, XMMS_SAMPLES8_MIN,
+		                    XMMS_SAMPLES8_MAX);
+	}
+}
+
+static void
+apply_u8 (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_sampleu8_t *samples = (xmms_sampleu8_t *) buf;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		gfloat sample = samples[i] * gain;
+		if (noise) {
+			sample += noise[i];
+		}
+		samples[i] = CLAMP (sample, 0, XMMS_SAMPLEU8_MAX);
+	}
+}
+
+static void
+apply_s16 (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_samples16_t *samples = (xmms_samples16_t *) buf;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		gfloat sample = samples[i] * gain;
+		if (noise) {
+			sample += noise[i];
+		}
+		samples[i] = CLAMP (sample, XMMS_SAMPLES16_MIN,
+		                    XMMS_SAMPLES16_MAX);
+	}
+}
+
+static void
+apply_u16 (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_sampleu16_t *samples = (xmms_sampleu16_t *) buf;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		gfloat sample = samples[i] * gain;
+		if (noise) {
+			sample += noise[i];
+		}
+		samples[i] = CLAMP (sample, 0, XMMS_SAMPLEU16_MAX);
+	}
+}
+
+static void
+apply_s32 (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_samples32_t *samples = (xmms_samples32_t *) buf;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		gdouble sample = (gdouble) samples[i] * gain;
+		samples[i] = CLAMP (sample, XMMS_SAMPLES32_MIN,
+		                    XMMS_SAMPLES32_MAX);
+	}
+}
+
+static void
+apply_u32 (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_sampleu32_t *samples = (xmms_sampleu32_t *) buf;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		gdouble sample = (gdouble) samples[i] * gain;
+		samples[i] = CLAMP (sample, 0, XMMS_SAMPLEU32_MAX);
+	}
+}
+
+static void
+apply_float (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_samplefloat_t *samples = (xmms_samplefloat_t *) buf;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		samples[i] *= gain;
+	}
+}
+
+static void
+apply_double (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_sampledouble_t *samples = (xmms_sampledouble_t *) buf;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		samples[i] *= gain;
+	}
+}
+
+static const xmms_rg_gain_func_t scalar_kernels[] = {
+	[XMMS_SAMPLE_FORMAT_S8] = apply_s8,
+	[XMMS_SAMPLE_FORMAT_U8] = apply_u8,
+	[XMMS_SAMPLE_FORMAT_S16] = apply_s16,
+	[XMMS_SAMPLE_FORMAT_U16] = apply_u16,
+	[XMMS_SAMPLE_FORMAT_S32] = apply_s32,
+	[XMMS_SAMPLE_FORMAT_U32] = apply_u32,
+	[XMMS_SAMPLE_FORMAT_FLOAT] = apply_float,
+	[XMMS_SAMPLE_FORMAT_DOUBLE] = apply_double,
+};
+
+#ifdef HAVE_VECTOR_EXTENSIONS
+
+#define RG_BYTES 16
+#define RG_NAME(n) vector_##n
+#define RG_TARGET
+#include "rg_gain_kernels.h"
+#undef RG_BYTES
+#undef RG_NAME
+#undef RG_TARGET
+
+#ifdef HAVE_CPU_DISPATCH
+#define RG_BYTES 32
+#define RG_NAME(n) avx2_##n
+#define RG_TARGET __attribute__ ((target ("avx2")))
+#include "rg_gain_kernels.h"
+#undef RG_BYTES
+#undef RG_NAME
+#undef RG_TARGET
+#endif
+
+#endif
+
+/**
+ * The fastest implementation the CPU we're running on supports.
+ */
+xmms_rg_gain_impl_t
+xmms_rg_gain_impl_best (void)
+{
+#ifdef HAVE_CPU_DISPATCH
+	if (__builtin_cpu_supports ("avx2")) {
+		return XMMS_RG_GAIN_IMPL_AVX2;
+	}
+#endif
+
+#ifdef HAVE_VECTOR_EXTENSIONS
+	return XMMS_RG_GAIN_IMPL_VECTOR;
+#else
+	return XMMS_RG_GAIN_IMPL_SCALAR;
+#endif
+}
+
+const gchar *
+xmms_rg_gain_impl_name (xmms_rg_gain_impl_t impl)
+{
+	switch (impl) {
+		case XMMS_RG_GAIN_IMPL_SCALAR:
+			return "scalar";
+		case XMMS_RG_GAIN_IMPL_VECTOR:
+			return "vector";
+		case XMMS_RG_GAIN_IMPL_AVX2:
+			return "avx2";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * Look up the kernel for a sample format.
+ *
+ * @returns the kernel, or NULL if the format is unknown or impl is
+ * better than what #xmms_rg_gain_impl_best returns.
+ */
+xmms_rg_gain_func_t
+xmms_rg_gain_func (xmms_sample_format_t format, xmms_rg_gain_impl_t impl)
+{
+	const xmms_rg_gain_func_t *kernels = NULL;
+
+	if (format <= XMMS_SAMPLE_FORMAT_UNKNOWN ||
+	    format >= G_N_ELEMENTS (scalar_kernels) ||
+	    impl > xmms_rg_gain_impl_best ()) {
+		return NULL;
+	}
+
+	switch (impl) {
+		case XMMS_RG_GAIN_IMPL_SCALAR:
+			kernels = scalar_kernels;
+			break;
+#ifdef HAVE_VECTOR_EXTENSIONS
+		case XMMS_RG_GAIN_IMPL_VECTOR:
+			kernels = vector_kernels;
+			break;
+#ifdef HAVE_CPU_DISPATCH
+		case XMMS_RG_GAIN_IMPL_AVX2:
+			kernels = avx2_kernels;
+			break;
+#endif
+#endif
+		default:
+			break;
+	}
+
+	return kernels ? kernels[format] : NULL;
+}
+
+/**
+ * Fill noise with triangular dither of one LSB either way.
+ *
+ * Each value is the difference of two uniform ones, taken from a
+ * xorshift generator whose state is kept in state, which must not
+ * be 0.
+ */
+void
+xmms_rg_gain_dither (guint32 *state, gfloat *noise, gint len)
+{
+	guint32 x = *state, a;
+	gint i;
+
+	for (i = 0; i < len; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		a = x;
+
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+
+		noise[i] = ((gint32) (a >> 8) - (gint32) (x >> 8)) / 16777216.0f;
+	}
+
+	*state = x;
+}
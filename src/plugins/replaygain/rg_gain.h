@@ -0,0 +1,49 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __RG_GAIN_H__
+#define __RG_GAIN_H__
+
+#include <glib.h>
+#include "xmms/xmms_sample.h"
+
+/**
+ * Multiply len samples by gain, clipping integer formats to their
+ * range. If noise isn't NULL, it holds len values that are added to
+ * 8 and 16 bit samples before they are converted back, it's ignored
+ * for the other formats.
+ */
+typedef void (*xmms_rg_gain_func_t) (void *buf, gint len, gfloat gain,
+                                     const gfloat *noise);
+
+typedef enum {
+	XMMS_RG_GAIN_IMPL_SCALAR,
+	/** the vector unit every CPU of the architecture has, like SSE2
+	 * on x86-64 or NEON on aarch64 */
+	XMMS_RG_GAIN_IMPL_VECTOR,
+	XMMS_RG_GAIN_IMPL_AVX2,
+	XMMS_RG_GAIN_IMPL_COUNT
+} xmms_rg_gain_impl_t;
+
+xmms_rg_gain_impl_t xmms_rg_gain_impl_best (void);
+const gchar *xmms_rg_gain_impl_name (xmms_rg_gain_impl_t impl);
+
+xmms_rg_gain_func_t xmms_rg_gain_func (xmms_sample_format_t format,
+                                       xmms_rg_gain_impl_t impl);
+
+void xmms_rg_gain_dither (guint32 *state, gfloat *noise, gint len);
+
+#endif
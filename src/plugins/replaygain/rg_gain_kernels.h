@@ -0,0 +1,194 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ * Vector versions of the gain kernels, included by rg_gain.c once
+ * for every instruction set with these defined:
+ *
+ *   RG_BYTES   size of a vector register
+ *   RG_NAME(n) name of a function of this instruction set
+ *   RG_TARGET  attribute making the compiler use it
+ *
+ * The samples are worked on in float or double, as many as fit in a
+ * register. Larger vectors than that would be split up by the
+ * compiler, which does comparisons one lane at a time then.
+ *
+ * Every step is the same one the scalar version does, in the same
+ * order and precision, so the result is identical to the last bit.
+ * What doesn't fill a vector at the end is left to the scalar code.
+ */
+
+#define RG_FLANES (RG_BYTES / 4)
+#define RG_DLANES (RG_BYTES / 8)
+
+typedef gint16 RG_NAME (vs16) __attribute__ ((vector_size (RG_FLANES * 2)));
+typedef guint16 RG_NAME (vu16) __attribute__ ((vector_size (RG_FLANES * 2)));
+typedef gint32 RG_NAME (vs32) __attribute__ ((vector_size (RG_BYTES)));
+typedef gfloat RG_NAME (vf) __attribute__ ((vector_size (RG_BYTES)));
+
+typedef gint32 RG_NAME (vs32d) __attribute__ ((vector_size (RG_DLANES * 4)));
+typedef guint32 RG_NAME (vu32d) __attribute__ ((vector_size (RG_DLANES * 4)));
+typedef gint64 RG_NAME (vs64) __attribute__ ((vector_size (RG_BYTES)));
+typedef gdouble RG_NAME (vd) __attribute__ ((vector_size (RG_BYTES)));
+
+/* CLAMP () without the ?:, which C has no vector version of. A macro
+ * as functions passing wide vectors around warn about the ABI. */
+#define RG_CLAMP(x, lo, hi, vtype, mtype) ({ \
+	RG_NAME (mtype) below = (x) < (lo), above = (x) > (hi); \
+	RG_NAME (vtype) vlo = (RG_NAME (vtype)) {} + (lo); \
+	RG_NAME (vtype) vhi = (RG_NAME (vtype)) {} + (hi); \
+	RG_NAME (mtype) bits = (RG_NAME (mtype)) (x); \
+	bits = (bits & ~below) | ((RG_NAME (mtype)) vlo & below); \
+	bits = (bits & ~above) | ((RG_NAME (mtype)) vhi & above); \
+	(RG_NAME (vtype)) bits; \
+})
+
+/* 16 bit samples, done in float like the scalar code. There are no
+ * 8 bit versions, the compiler converts vectors of bytes one at a
+ * time, which is no faster than the scalar code. */
+#define RG_SMALL_KERNEL(fmt, type, vtype, lo, hi) \
+static RG_TARGET void \
+RG_NAME (apply_##fmt) (void *buf, gint len, gfloat gain, \
+                       const gfloat *noise) \
+{ \
+	type *samples = (type *) buf; \
+	RG_NAME (vtype) in; \
+	RG_NAME (vs32) wide; \
+	RG_NAME (vf) x, n; \
+	gint i; \
+\
+	for (i = 0; i + RG_FLANES <= len; i += RG_FLANES) { \
+		memcpy (&in, samples + i, sizeof (in)); \
+		wide = __builtin_convertvector (in, RG_NAME (vs32)); \
+		x = __builtin_convertvector (wide, RG_NAME (vf)) * gain; \
+		if (noise) { \
+			memcpy (&n, noise + i, sizeof (n)); \
+			x += n; \
+		} \
+		x = RG_CLAMP (x, lo, hi, vf, vs32); \
+		/* only int32 converts to and from float directly */ \
+		wide = __builtin_convertvector (x, RG_NAME (vs32)); \
+		in = __builtin_convertvector (wide, RG_NAME (vtype)); \
+		memcpy (samples + i, &in, sizeof (in)); \
+	} \
+\
+	apply_##fmt (samples + i, len - i, gain, noise ? noise + i : NULL); \
+}
+
+RG_SMALL_KERNEL (s16, xmms_samples16_t, vs16, XMMS_SAMPLES16_MIN, XMMS_SAMPLES16_MAX)
+RG_SMALL_KERNEL (u16, xmms_sampleu16_t, vu16, 0, XMMS_SAMPLEU16_MAX)
+
+#undef RG_SMALL_KERNEL
+
+/* 32 bit samples need double to keep all their bits */
+#define RG_LARGE_KERNEL(fmt, type, vtype, lo, hi) \
+static RG_TARGET void \
+RG_NAME (apply_##fmt) (void *buf, gint len, gfloat gain, \
+                       const gfloat *noise) \
+{ \
+	type *samples = (type *) buf; \
+	RG_NAME (vtype) in; \
+	RG_NAME (vd) x; \
+	gint i; \
+\
+	for (i = 0; i + RG_DLANES <= len; i += RG_DLANES) { \
+		memcpy (&in, samples + i, sizeof (in)); \
+		x = __builtin_convertvector (in, RG_NAME (vd)) * (gdouble) gain; \
+		x = RG_CLAMP (x, lo, hi, vd, vs64); \
+		in = __builtin_convertvector (x, RG_NAME (vtype)); \
+		memcpy (samples + i, &in, sizeof (in)); \
+	} \
+\
+	apply_##fmt (samples + i, len - i, gain, NULL); \
+}
+
+RG_LARGE_KERNEL (s32, xmms_samples32_t, vs32d, XMMS_SAMPLES32_MIN, XMMS_SAMPLES32_MAX)
+
+#undef RG_LARGE_KERNEL
+
+/* Vector units can only convert between double and signed 32 bit
+ * integers, so the upper half of the unsigned range is moved down
+ * before converting and back up after. Subtracting 2^31 from those
+ * values is exact, so the result still is what the cast gives. */
+static RG_TARGET void
+RG_NAME (apply_u32) (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_sampleu32_t *samples = (xmms_sampleu32_t *) buf;
+	RG_NAME (vu32d) in;
+	RG_NAME (vs64) upper;
+	RG_NAME (vd) x;
+	gint i;
+
+	for (i = 0; i + RG_DLANES <= len; i += RG_DLANES) {
+		memcpy (&in, samples + i, sizeof (in));
+		x = __builtin_convertvector (in, RG_NAME (vd)) * (gdouble) gain;
+		x = RG_CLAMP (x, 0, XMMS_SAMPLEU32_MAX, vd, vs64);
+		upper = x >= 2147483648.0;
+		x -= (RG_NAME (vd)) (upper & (RG_NAME (vs64)) ((RG_NAME (vd)) {} + 2147483648.0));
+		in = (RG_NAME (vu32d)) __builtin_convertvector (x, RG_NAME (vs32d));
+		in |= (RG_NAME (vu32d)) __builtin_convertvector (upper, RG_NAME (vs32d)) & 0x80000000u;
+		memcpy (samples + i, &in, sizeof (in));
+	}
+
+	apply_u32 (samples + i, len - i, gain, NULL);
+}
+
+static RG_TARGET void
+RG_NAME (apply_float) (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_samplefloat_t *samples = (xmms_samplefloat_t *) buf;
+	RG_NAME (vf) x;
+	gint i;
+
+	for (i = 0; i + RG_FLANES <= len; i += RG_FLANES) {
+		memcpy (&x, samples + i, sizeof (x));
+		x *= gain;
+		memcpy (samples + i, &x, sizeof (x));
+	}
+
+	apply_float (samples + i, len - i, gain, NULL);
+}
+
+static RG_TARGET void
+RG_NAME (apply_double) (void *buf, gint len, gfloat gain, const gfloat *noise)
+{
+	xmms_sampledouble_t *samples = (xmms_sampledouble_t *) buf;
+	RG_NAME (vd) x;
+	gint i;
+
+	for (i = 0; i + RG_DLANES <= len; i += RG_DLANES) {
+		memcpy (&x, samples + i, sizeof (x));
+		x *= (gdouble) gain;
+		memcpy (samples + i, &x, sizeof (x));
+	}
+
+	apply_double (samples + i, len - i, gain, NULL);
+}
+
+#undef RG_CLAMP
+#undef RG_FLANES
+#undef RG_DLANES
+
+static const xmms_rg_gain_func_t RG_NAME (kernels)[] = {
+	[XMMS_SAMPLE_FORMAT_S8] = apply_s8,
+	[XMMS_SAMPLE_FORMAT_U8] = apply_u8,
+	[XMMS_SAMPLE_FORMAT_S16] = RG_NAME (apply_s16),
+	[XMMS_SAMPLE_FORMAT_U16] = RG_NAME (apply_u16),
+	[XMMS_SAMPLE_FORMAT_S32] = RG_NAME (apply_s32),
+	[XMMS_SAMPLE_FORMAT_U32] = RG_NAME (apply_u32),
+	[XMMS_SAMPLE_FORMAT_FLOAT] = RG_NAME (apply_float),
+	[XMMS_SAMPLE_FORMAT_DOUBLE] = RG_NAME (apply_double),
+};
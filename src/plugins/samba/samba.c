@@ -21,6 +21,7 @@
 #define _FILE_OFFSET_BITS 64
 
 #include "xmms/xmms_xformplugin.h"
+#include "xmms/xmms_readahead.h"
 #include "xmms/xmms_log.h"
 
 #include <errno.h>
@@ -40,6 +41,7 @@ static GStaticMutex mutex = G_STATIC_MUTEX_INIT;
 
 typedef struct {
 	gint fd;
+	xmms_readahead_t *readahead;
 } xmms_samba_data_t;
 
 /*
@@ -55,6 +57,11 @@ static gint64 xmms_samba_seek (xmms_xform_t *xform, gint64 offset,
                                xmms_error_t *error);
 static gboolean xmms_samba_plugin_setup (xmms_xform_plugin_t *xform_plugin);
 static gboolean xmms_samba_browse (xmms_xform_t *xform, const gchar *url, xmms_error_t *error);
+static gint xmms_samba_read_fd (gpointer udata, gpointer buffer, gint len,
+                                xmms_error_t *error);
+static gint64 xmms_samba_seek_fd (gpointer udata, gint64 offset,
+                                  xmms_xform_seek_mode_t whence,
+                                  xmms_error_t *error);
 
 /*
  * Plugin header
@@ -87,6 +94,14 @@ xmms_samba_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
+	/* bytes to read ahead of the decoder, 0 reads on demand */
+	xmms_xform_plugin_config_property_register (xform_plugin, "readahead",
+	                                            "262144", NULL, NULL);
+	/* seconds to remember a directory listing */
+	xmms_xform_plugin_config_property_register (xform_plugin,
+	                                            "browse_cache_ttl",
+	                                            "10", NULL, NULL);
+
 	xmms_xform_plugin_indata_add (xform_plugin, XMMS_STREAM_TYPE_MIMETYPE,
 	                              "application/x-url", XMMS_STREAM_TYPE_URL,
 	                              "smb://*", XMMS_STREAM_TYPE_END);
@@ -113,8 +128,9 @@ xmms_samba_init (xmms_xform_t *xform)
 	xmms_samba_data_t *data;
 	const gchar *url;
 	const gchar *metakey;
+	xmms_config_property_t *val;
 	struct stat st;
-	gint fd, err;
+	gint fd, err, readahead;
 
 	g_return_val_if_fail (xform, FALSE);
 
@@ -147,6 +163,14 @@ xmms_samba_init (xmms_xform_t *xform)
 	data = g_new0 (xmms_samba_data_t, 1);
 	data->fd = fd;
 
+	val = xmms_xform_config_lookup (xform, "readahead");
+	readahead = xmms_config_property_get_int (val);
+	if (readahead > 0) {
+		data->readahead = xmms_readahead_new (xmms_samba_read_fd,
+		                                      xmms_samba_seek_fd, data,
+		                                      0, st.st_size, readahead);
+	}
+
 	xmms_xform_private_data_set (xform, data);
 
 	xmms_xform_outdata_type_add (xform, XMMS_STREAM_TYPE_MIMETYPE,
@@ -173,6 +197,10 @@ xmms_samba_destroy (xmms_xform_t *xform)
 	data = xmms_xform_private_data_get (xform);
 	g_return_if_fail (data);
 
+	if (data->readahead) {
+		xmms_readahead_free (data->readahead);
+	}
+
 	if (data->fd != -1) {
 		g_static_mutex_lock (&mutex);
 		err = smbc_close (data->fd);
@@ -188,19 +216,12 @@ xmms_samba_destroy (xmms_xform_t *xform)
 
 
 static gint
-xmms_samba_read (xmms_xform_t *xform, void *buffer, gint len,
-                 xmms_error_t *error)
+xmms_samba_read_fd (gpointer udata, gpointer buffer, gint len,
+                    xmms_error_t *error)
 {
-	xmms_samba_data_t *data;
+	xmms_samba_data_t *data = udata;
 	gint ret;
 
-	g_return_val_if_fail (xform, -1);
-	g_return_val_if_fail (buffer, -1);
-	g_return_val_if_fail (error, -1);
-
-	data = xmms_xform_private_data_get (xform);
-	g_return_val_if_fail (data, -1);
-
 	g_static_mutex_lock (&mutex);
 	ret = smbc_read (data->fd, buffer, len);
 	g_static_mutex_unlock (&mutex);
@@ -213,18 +234,35 @@ xmms_samba_read (xmms_xform_t *xform, void *buffer, gint len,
 }
 
 
-static gint64
-xmms_samba_seek (xmms_xform_t *xform, gint64 offset,
-                 xmms_xform_seek_mode_t whence, xmms_error_t *error)
+static gint
+xmms_samba_read (xmms_xform_t *xform, void *buffer, gint len,
+                 xmms_error_t *error)
 {
 	xmms_samba_data_t *data;
-	gint w = 0;
-	off_t res;
 
 	g_return_val_if_fail (xform, -1);
+	g_return_val_if_fail (buffer, -1);
+	g_return_val_if_fail (error, -1);
+
 	data = xmms_xform_private_data_get (xform);
 	g_return_val_if_fail (data, -1);
 
+	if (data->readahead) {
+		return xmms_readahead_read (data->readahead, buffer, len, error);
+	}
+
+	return xmms_samba_read_fd (data, buffer, len, error);
+}
+
+
+static gint64
+xmms_samba_seek_fd (gpointer udata, gint64 offset,
+                    xmms_xform_seek_mode_t whence, xmms_error_t *error)
+{
+	xmms_samba_data_t *data = udata;
+	gint w = 0;
+	off_t res;
+
 	switch (whence) {
 		case XMMS_XFORM_SEEK_SET:
 			w = SEEK_SET;
@@ -247,6 +285,25 @@ xmms_samba_seek (xmms_xform_t *xform, gint64 offset,
 
 	return res;
 }
+
+
+static gint64
+xmms_samba_seek (xmms_xform_t *xform, gint64 offset,
+                 xmms_xform_seek_mode_t whence, xmms_error_t *error)
+{
+	xmms_samba_data_t *data;
+
+	g_return_val_if_fail (xform, -1);
+	data = xmms_xform_private_data_get (xform);
+	g_return_val_if_fail (data, -1);
+
+	if (data->readahead) {
+		return xmms_readahead_seek (data->readahead, offset, whence, error);
+	}
+
+	return xmms_samba_seek_fd (data, offset, whence, error);
+}
+
 static gboolean
 xmms_samba_browse (xmms_xform_t *xform,
                    const gchar *url,
@@ -15,6 +15,7 @@
  */
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,9 +38,37 @@
 #include "xmmspriv/xmms_bindata.h"
 #include "xmmspriv/xmms_utils.h"
 
+/** Default size of the in-memory cache, in bytes */
+#define XMMS_BINDATA_DEFAULT_CACHESIZE "8388608"
+
+/** Number of hash characters used for the shard directory */
+#define XMMS_BINDATA_SHARD_LEN 2
+
+/**
+ * A blob kept in the cache. The data is a read-only mapping of the
+ * file in the bindata directory.
+ */
+typedef struct xmms_bindata_entry_St {
+	gchar hash[33];
+	GMappedFile *file;
+	gsize size;
+	GList link;
+} xmms_bindata_entry_t;
+
 struct xmms_bindata_St {
 	xmms_object_t obj;
 	const gchar *bindir;
+
+	/* Everything below is protected by cache_lock */
+	GMutex *cache_lock;
+	GHashTable *cache;
+	GQueue lru; /* most recently used first */
+	gsize cache_size;
+	gsize cache_max;
+
+	guint64 hits;
+	guint64 misses;
+	guint64 evictions;
 };
 
 static xmms_bindata_t *global_bindata;
@@ -62,11 +91,17 @@ static void md5_append (md5_state_t *pms, const md5_byte_t *data, int nbytes);
 static void md5_finish (md5_state_t *pms, md5_byte_t digest[16]);
 
 static gchar *xmms_bindata_build_path (xmms_bindata_t *bindata, const gchar *hash);
+static gchar *xmms_bindata_find_path (xmms_bindata_t *bindata, const gchar *hash);
+static gboolean xmms_bindata_hash_valid (const gchar *hash);
+static void xmms_bindata_cache_trim (xmms_bindata_t *bindata);
+static void xmms_bindata_cache_remove (xmms_bindata_t *bindata, const gchar *hash);
+static void on_bindata_cachesize_changed (xmms_object_t *object, xmmsv_t *_data, gpointer udata);
 
 static gchar *xmms_bindata_client_add (xmms_bindata_t *bindata, GString *data, xmms_error_t *err);
 static xmmsv_t *xmms_bindata_client_retrieve (xmms_bindata_t *bindata, const gchar *hash, xmms_error_t *err);
 static void xmms_bindata_client_remove (xmms_bindata_t *bindata, const gchar *hash, xmms_error_t *);
 static GList *xmms_bindata_client_list (xmms_bindata_t *bindata, xmms_error_t *err);
+static GTree *xmms_bindata_client_stats (xmms_bindata_t *bindata, xmms_error_t *err);
 static gboolean _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar hash[33], xmms_error_t *err);
 
 #include "bindata_ipc.c"
@@ -94,6 +129,15 @@ xmms_bindata_init ()
 		}
 	}
 
+	obj->cache_lock = g_mutex_new ();
+	obj->cache = g_hash_table_new (g_str_hash, g_str_equal);
+	g_queue_init (&obj->lru);
+
+	cv = xmms_config_property_register ("bindata.cachesize",
+	                                    XMMS_BINDATA_DEFAULT_CACHESIZE,
+	                                    on_bindata_cachesize_changed, obj);
+	obj->cache_max = MAX (xmms_config_property_get_int (cv), 0);
+
 	global_bindata = obj;
 
 	return obj;
@@ -102,7 +146,146 @@ xmms_bindata_init ()
 static void
 xmms_bindata_destroy (xmms_object_t *obj)
 {
+	xmms_bindata_t *bindata = (xmms_bindata_t *) obj;
+	xmms_config_property_t *val;
+
 	xmms_bindata_unregister_ipc_commands ();
+
+	val = xmms_config_lookup ("bindata.cachesize");
+	xmms_config_property_callback_remove (val, on_bindata_cachesize_changed, bindata);
+
+	g_mutex_lock (bindata->cache_lock);
+	bindata->cache_max = 0;
+	xmms_bindata_cache_trim (bindata);
+	g_mutex_unlock (bindata->cache_lock);
+
+	g_hash_table_destroy (bindata->cache);
+	g_mutex_free (bindata->cache_lock);
+}
+
+/**
+ * Drop the least recently used blobs until the cache fits within its
+ * limit. Must be called with cache_lock held.
+ */
+static void
+xmms_bindata_cache_trim (xmms_bindata_t *bindata)
+{
+	xmms_bindata_entry_t *entry;
+	GList *link;
+
+	while (bindata->cache_size > bindata->cache_max) {
+		link = g_queue_pop_tail_link (&bindata->lru);
+		entry = link->data;
+
+		g_hash_table_remove (bindata->cache, entry->hash);
+		bindata->cache_size -= entry->size;
+		bindata->evictions++;
+
+		g_mapped_file_free (entry->file);
+		g_free (entry);
+	}
+}
+
+static void
+xmms_bindata_cache_remove (xmms_bindata_t *bindata, const gchar *hash)
+{
+	xmms_bindata_entry_t *entry;
+
+	g_mutex_lock (bindata->cache_lock);
+
+	entry = g_hash_table_lookup (bindata->cache, hash);
+	if (entry) {
+		g_hash_table_remove (bindata->cache, entry->hash);
+		g_queue_unlink (&bindata->lru, &entry->link);
+		bindata->cache_size -= entry->size;
+
+		g_mapped_file_free (entry->file);
+		g_free (entry);
+	}
+
+	g_mutex_unlock (bindata->cache_lock);
+}
+
+/**
+ * Look up a blob in the cache, returning a copy of it as a binary
+ * value, or NULL if it isn't cached.
+ */
+static xmmsv_t *
+xmms_bindata_cache_lookup (xmms_bindata_t *bindata, const gchar *hash)
+{
+	xmms_bindata_entry_t *entry;
+	xmmsv_t *res = NULL;
+
+	g_mutex_lock (bindata->cache_lock);
+
+	entry = g_hash_table_lookup (bindata->cache, hash);
+	if (entry) {
+		g_queue_unlink (&bindata->lru, &entry->link);
+		g_queue_push_head_link (&bindata->lru, &entry->link);
+
+		res = xmmsv_new_bin ((unsigned char *) g_mapped_file_get_contents (entry->file),
+		                     entry->size);
+		bindata->hits++;
+	} else {
+		bindata->misses++;
+	}
+
+	g_mutex_unlock (bindata->cache_lock);
+
+	return res;
+}
+
+/**
+ * Hand a freshly mapped blob over to the cache. The cache takes
+ * ownership of the mapping.
+ */
+static void
+xmms_bindata_cache_insert (xmms_bindata_t *bindata, const gchar *hash,
+                           GMappedFile *file)
+{
+	xmms_bindata_entry_t *entry;
+	gsize size;
+
+	size = g_mapped_file_get_length (file);
+
+	g_mutex_lock (bindata->cache_lock);
+
+	/* Too big, or another thread beat us to it */
+	if (size > bindata->cache_max ||
+	    g_hash_table_lookup (bindata->cache, hash)) {
+		g_mutex_unlock (bindata->cache_lock);
+		g_mapped_file_free (file);
+		return;
+	}
+
+	entry = g_new0 (xmms_bindata_entry_t, 1);
+	g_strlcpy (entry->hash, hash, sizeof (entry->hash));
+	entry->file = file;
+	entry->size = size;
+	entry->link.data = entry;
+
+	g_hash_table_insert (bindata->cache, entry->hash, entry);
+	g_queue_push_head_link (&bindata->lru, &entry->link);
+	bindata->cache_size += size;
+
+	xmms_bindata_cache_trim (bindata);
+
+	g_mutex_unlock (bindata->cache_lock);
+}
+
+static void
+on_bindata_cachesize_changed (xmms_object_t *object, xmmsv_t *_data,
+                              gpointer udata)
+{
+	xmms_bindata_t *bindata = udata;
+	gint value;
+
+	value = xmms_config_property_get_int ((xmms_config_property_t *) object);
+
+	g_mutex_lock (bindata->cache_lock);
+	bindata->cache_max = MAX (value, 0);
+	xmms_bindata_cache_trim (bindata);
+	g_mutex_unlock (bindata->cache_lock);
 }
 
 gchar *
@@ -128,10 +311,63 @@ xmms_bindata_calculate_md5 (const guchar *data, gsize size, gchar ret[33])
 	return ret;
 }
 
+/**
+ * Build the path a blob is stored at. Blobs are spread out over
+ * subdirectories named after the first characters of their hash, so
+ * that large stores don't end up with one huge directory.
+ */
 static gchar *
 xmms_bindata_build_path (xmms_bindata_t *bindata, const gchar *hash)
 {
-	return g_build_path (G_DIR_SEPARATOR_S, bindata->bindir, hash, NULL);
+	gchar shard[XMMS_BINDATA_SHARD_LEN + 1];
+
+	if (!hash) {
+		return g_build_path (G_DIR_SEPARATOR_S, bindata->bindir, NULL);
+	}
+
+	g_strlcpy (shard, hash, sizeof (shard));
+
+	return g_build_path (G_DIR_SEPARATOR_S, bindata->bindir, shard, hash, NULL);
+}
+
+/**
+ * Find the file holding a blob, also looking at the flat layout used
+ * by older versions.
+ *
+ * @returns the path, or NULL if the blob isn't stored.
+ */
+static gchar *
+xmms_bindata_find_path (xmms_bindata_t *bindata, const gchar *hash)
+{
+	gchar *path;
+
+	path = xmms_bindata_build_path (bindata, hash);
+	if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+		return path;
+	}
+	g_free (path);
+
+	path = g_build_path (G_DIR_SEPARATOR_S, bindata->bindir, hash, NULL);
+	if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+		return path;
+	}
+	g_free (path);
+
+	return NULL;
+}
+
+static gboolean
+xmms_bindata_hash_valid (const gchar *hash)
+{
+	gint i;
+
+	for (i = 0; i < 32; i++) {
+		if (!g_ascii_isxdigit (hash[i])) {
+			return FALSE;
+		}
+	}
+
+	return hash[32] == '\0';
 }
 
 /** Add binary data from a plugin */
@@ -147,24 +383,46 @@ _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar
 {
 	const guchar *ptr;
 	gsize left;
-	gchar *path;
+	gchar *path, *tmp, *dir;
 	FILE *fp;
+	gint fd;
 
 	xmms_bindata_calculate_md5 (data, len, hash);
 
-	path = xmms_bindata_build_path (bindata, hash);
-
-	if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+	path = xmms_bindata_find_path (bindata, hash);
+	if (path) {
 		XMMS_DBG ("file %s is already in bindata dir", hash);
 		g_free (path);
 		return TRUE;
 	}
 
+	path = xmms_bindata_build_path (bindata, hash);
+
+	dir = g_path_get_dirname (path);
+	if (g_mkdir_with_parents (dir, 0755) == -1) {
+		xmms_log_error ("Couldn't create %s", dir);
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't create file on server!");
+		g_free (dir);
+		g_free (path);
+		return FALSE;
+	}
+	g_free (dir);
+
+	/* Write to a temporary file and move it into place when done, so
+	 * that nobody ever maps a partially written blob. */
+	tmp = g_strconcat (path, ".XXXXXX", NULL);
+
 	XMMS_DBG ("Creating %s", path);
-	fp = fopen (path, "wb");
+	fd = g_mkstemp (tmp);
+	fp = fd != -1 ? fdopen (fd, "wb") : NULL;
 	if (!fp) {
-		xmms_log_error ("Couldn't create %s", path);
+		xmms_log_error ("Couldn't create %s", tmp);
 		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't create file on server!");
+		if (fd != -1) {
+			close (fd);
+			g_unlink (tmp);
+		}
+		g_free (tmp);
 		g_free (path);
 		return FALSE;
 	}
@@ -179,11 +437,12 @@ _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar
 		w = fwrite (ptr, 1, left, fp);
 		if (!w && ferror (fp)) {
 			fclose (fp);
-			unlink (path);
+			g_unlink (tmp);
 
 			xmms_log_error ("Couldn't write data");
 			xmms_error_set (err, XMMS_ERROR_GENERIC,
 			                "Couldn't write data!");
+			g_free (tmp);
 			g_free (path);
 			return FALSE;
 		}
@@ -192,7 +451,17 @@ _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar
 		ptr += w;
 	}
 
-	fclose (fp);
+	if (fclose (fp) != 0 || g_rename (tmp, path) == -1) {
+		g_unlink (tmp);
+
+		xmms_log_error ("Couldn't write data");
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't write data!");
+		g_free (tmp);
+		g_free (path);
+		return FALSE;
+	}
+
+	g_free (tmp);
 	g_free (path);
 
 	return TRUE;
@@ -211,44 +480,40 @@ static xmmsv_t *
 xmms_bindata_client_retrieve (xmms_bindata_t *bindata, const gchar *hash,
                               xmms_error_t *err)
 {
+	GMappedFile *file;
 	xmmsv_t *res;
 	gchar *path;
-	GString *str;
-	FILE *fp;
 
-	path = xmms_bindata_build_path (bindata, hash);
+	if (!xmms_bindata_hash_valid (hash)) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "Invalid hash!");
+		return NULL;
+	}
 
-	fp = fopen (path, "rb");
-	if (!fp) {
+	res = xmms_bindata_cache_lookup (bindata, hash);
+	if (res) {
+		return res;
+	}
+
+	path = xmms_bindata_find_path (bindata, hash);
+	if (!path) {
 		xmms_log_error ("Requesting '%s' which is not on the server", hash);
 		xmms_error_set (err, XMMS_ERROR_NOENT, "File not found!");
-		g_free (path);
 		return NULL;
 	}
 
+	file = g_mapped_file_new (path, FALSE, NULL);
 	g_free (path);
 
-	str = g_string_new (NULL);
-	while (!feof (fp)) {
-		gchar buf[1024];
-		gint l;
-
-		l = fread (buf, 1, 1024, fp);
-		if (ferror (fp)) {
-			g_string_free (str, TRUE);
-			xmms_log_error ("Error reading bindata '%s'", hash);
-			xmms_error_set (err, XMMS_ERROR_GENERIC, "Error reading file");
-			fclose (fp);
-			return NULL;
-		}
-		g_string_append_len (str, buf, l);
+	if (!file) {
+		xmms_log_error ("Error reading bindata '%s'", hash);
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "Error reading file");
+		return NULL;
 	}
 
-	fclose (fp);
-
-	res = xmmsv_new_bin ((unsigned char *)str->str, str->len);
+	res = xmmsv_new_bin ((unsigned char *) g_mapped_file_get_contents (file),
+	                     g_mapped_file_get_length (file));
 
-	g_string_free (str, TRUE);
+	xmms_bindata_cache_insert (bindata, hash, file);
 
 	return res;
 }
@@ -258,8 +523,16 @@ xmms_bindata_client_remove (xmms_bindata_t *bindata, const gchar *hash,
                             xmms_error_t *err)
 {
 	gchar *path;
-	path = xmms_bindata_build_path (bindata, hash);
-	if (unlink (path) == -1) {
+
+	if (!xmms_bindata_hash_valid (hash)) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "Invalid hash!");
+		return;
+	}
+
+	xmms_bindata_cache_remove (bindata, hash);
+
+	path = xmms_bindata_find_path (bindata, hash);
+	if (!path || g_unlink (path) == -1) {
 		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't remove file");
 	}
 	g_free (path);
@@ -267,25 +540,25 @@ xmms_bindata_client_remove (xmms_bindata_t *bindata, const gchar *hash,
 }
 
 static GList *
-xmms_bindata_client_list (xmms_bindata_t *bindata, xmms_error_t *err)
+xmms_bindata_list_dir (const gchar *path, gboolean recurse, GList *entries)
 {
-	GList *entries = NULL;
-	gchar *path;
 	const gchar *file;
+	gchar *sub;
 	GDir *dir;
 
-	path = xmms_bindata_build_path (bindata, NULL);
 	dir = g_dir_open (path, 0, NULL);
-	g_free (path);
-
 	if (!dir) {
-		xmms_error_set (err, XMMS_ERROR_GENERIC,
-		                "Couldn't open bindata directory");
-		return NULL;
+		return entries;
 	}
 
 	while ((file = g_dir_read_name (dir))) {
-		entries = g_list_prepend (entries, xmmsv_new_string (file));
+		if (xmms_bindata_hash_valid (file)) {
+			entries = g_list_prepend (entries, xmmsv_new_string (file));
+		} else if (recurse && strlen (file) == XMMS_BINDATA_SHARD_LEN) {
+			sub = g_build_path (G_DIR_SEPARATOR_S, path, file, NULL);
+			entries = xmms_bindata_list_dir (sub, FALSE, entries);
+			g_free (sub);
+		}
 	}
 
 	g_dir_close (dir);
@@ -293,6 +566,51 @@ xmms_bindata_client_list (xmms_bindata_t *bindata, xmms_error_t *err)
 	return entries;
 }
 
+static GList *
+xmms_bindata_client_list (xmms_bindata_t *bindata, xmms_error_t *err)
+{
+	gchar *path;
+
+	path = xmms_bindata_build_path (bindata, NULL);
+
+	if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC,
+		                "Couldn't open bindata directory");
+		g_free (path);
+		return NULL;
+	}
+
+	return xmms_bindata_list_dir (path, TRUE, NULL);
+}
+
+static GTree *
+xmms_bindata_client_stats (xmms_bindata_t *bindata, xmms_error_t *err)
+{
+	GTree *ret;
+
+	ret = g_tree_new_full ((GCompareDataFunc) strcmp, NULL,
+	                       NULL, (GDestroyNotify) xmmsv_unref);
+
+	g_mutex_lock (bindata->cache_lock);
+
+	g_tree_insert (ret, (gpointer) "hits",
+	               xmmsv_new_int (MIN (bindata->hits, G_MAXINT32)));
+	g_tree_insert (ret, (gpointer) "misses",
+	               xmmsv_new_int (MIN (bindata->misses, G_MAXINT32)));
+	g_tree_insert (ret, (gpointer) "evictions",
+	               xmmsv_new_int (MIN (bindata->evictions, G_MAXINT32)));
+	g_tree_insert (ret, (gpointer) "entries",
+	               xmmsv_new_int (g_hash_table_size (bindata->cache)));
+	g_tree_insert (ret, (gpointer) "size",
+	               xmmsv_new_int (MIN (bindata->cache_size, G_MAXINT32)));
+	g_tree_insert (ret, (gpointer) "capacity",
+	               xmmsv_new_int (MIN (bindata->cache_max, G_MAXINT32)));
+
+	g_mutex_unlock (bindata->cache_lock);
+
+	return ret;
+}
+
 /*
   Copyright (C) 1999, 2000, 2002 Aladdin Enterprises.  All rights reserved.
 
@@ -31,6 +31,8 @@
 #include "xmmspriv/xmms_collquery.h"
 #include "xmmspriv/xmms_collserial.h"
 #include "xmmspriv/xmms_collsync.h"
+#include "xmmspriv/xmms_collindex.h"
+#include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_xform.h"
 #include "xmmspriv/xmms_streamtype.h"
 #include "xmms/xmms_ipc.h"
@@ -76,6 +78,15 @@ typedef enum {
 	XMMS_COLLECTION_FIND_STATE_NOMATCH,
 } coll_find_state_t;
 
+typedef struct {
+	xmms_medialib_entry_t mid;
+	/* the properties of the media, read when first needed */
+	GHashTable *info;
+	/* the medialib property stamp from before they were read */
+	guint32 stamp;
+	xmms_error_t *err;
+} coll_find_media_t;
+
 typedef struct add_metadata_from_tree_user_data_St {
 	xmms_medialib_session_t *session;
 	xmms_medialib_entry_t entry;
@@ -108,6 +119,7 @@ static void check_for_reference (xmms_coll_dag_t *dag, xmmsv_coll_t *coll, xmmsv
 static void coll_unref (void *coll);
 
 static GHashTable *xmms_collection_media_info (xmms_medialib_entry_t mid, xmms_error_t *err);
+static GHashTable *xmms_collection_find_media_info (coll_find_media_t *media);
 
 static gboolean filter_get_mediainfo_field_string (xmmsv_coll_t *coll, GHashTable *mediainfo, gchar **val);
 static gboolean filter_get_mediainfo_field_int (xmmsv_coll_t *coll, GHashTable *mediainfo, gint *val);
@@ -119,14 +131,15 @@ static void build_match_table (gpointer key, gpointer value, gpointer udata);
 static gboolean find_unchecked (gpointer name, gpointer value, gpointer udata);
 static void build_list_matches (gpointer key, gpointer value, gpointer udata);
 
-static gboolean xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
-static gboolean xmms_collection_media_match_operand (xmms_coll_dag_t *dag, GHashTable *mediainfo, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
-static gboolean xmms_collection_media_match_reference (xmms_coll_dag_t *dag, GHashTable *mediainfo, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table, const gchar *refname, const gchar *refns);
-static gboolean xmms_collection_media_filter_has (xmms_coll_dag_t *dag, GHashTable *mediainfo, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
-static gboolean xmms_collection_media_filter_equals (xmms_coll_dag_t *dag, GHashTable *mediainfo, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
-static gboolean xmms_collection_media_filter_match (xmms_coll_dag_t *dag, GHashTable *mediainfo, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
-static gboolean xmms_collection_media_filter_smaller (xmms_coll_dag_t *dag, GHashTable *mediainfo, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
-static gboolean xmms_collection_media_filter_greater (xmms_coll_dag_t *dag, GHashTable *mediainfo, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
+static gboolean xmms_collection_media_match (xmms_coll_dag_t *dag, coll_find_media_t *media, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
+static gboolean xmms_collection_media_match_operand (xmms_coll_dag_t *dag, coll_find_media_t *media, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
+static gboolean xmms_collection_media_match_reference (xmms_coll_dag_t *dag, coll_find_media_t *media, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table, const gchar *refname, const gchar *refns);
+static gboolean xmms_collection_media_filter (xmms_coll_dag_t *dag, coll_find_media_t *media, xmmsv_coll_t *coll, guint nsid, GHashTable *match_table);
+static gboolean xmms_collection_media_filter_has (xmmsv_coll_t *coll, GHashTable *mediainfo);
+static gboolean xmms_collection_media_filter_equals (xmmsv_coll_t *coll, GHashTable *mediainfo);
+static gboolean xmms_collection_media_filter_match (xmmsv_coll_t *coll, GHashTable *mediainfo);
+static gboolean xmms_collection_media_filter_smaller (xmmsv_coll_t *coll, GHashTable *mediainfo);
+static gboolean xmms_collection_media_filter_greater (xmmsv_coll_t *coll, GHashTable *mediainfo);
 
 static xmmsv_coll_t * xmms_collection_client_get (xmms_coll_dag_t *dag, const gchar *collname, const gchar *namespace, xmms_error_t *error);
 static GList * xmms_collection_client_list (xmms_coll_dag_t *dag, const gchar *namespace, xmms_error_t *error);
@@ -221,7 +234,11 @@ xmms_collection_init (xmms_playlist_t *playlist)
 	ret->mutex = g_mutex_new ();
 	ret->playlist = playlist;
 
+	/* Rewrite all collections on every save instead of what changed */
+	xmms_config_property_register ("collection.full_save", "0", NULL, NULL);
+
 	xmms_coll_sync_init (ret);
+	xmms_coll_index_init ();
 
 	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
 		ret->collrefs[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
@@ -600,7 +617,7 @@ GList *
 xmms_collection_client_find (xmms_coll_dag_t *dag, gint32 mid, const gchar *namespace,
                              xmms_error_t *err)
 {
-	GHashTable *mediainfo;
+	coll_find_media_t media;
 	GList *ret = NULL;
 	guint nsid;
 	gchar *open_name;
@@ -618,18 +635,25 @@ xmms_collection_client_find (xmms_coll_dag_t *dag, gint32 mid, const gchar *name
 		return NULL;
 	}
 
+	/* The infos for the given mid are only read if a filter needs them */
+	media.mid = mid;
+	media.info = NULL;
+	media.stamp = xmms_medialib_property_stamp (NULL);
+	media.err = err;
+
+	g_mutex_lock (dag->mutex);
+
+	xmms_coll_index_prune (dag);
+
 	/* Prepare the match table of all collections for the given namespace */
 	match_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 	xmms_collection_foreach_in_namespace (dag, nsid, build_match_table, match_table);
 
-	/* Get all infos for the given mid */
-	mediainfo = xmms_collection_media_info (mid, err);
-
 	/* While not all collections have been checked, check next */
 	while (g_hash_table_find (match_table, find_unchecked, &open_name) != NULL) {
 		coll_find_state_t *match = g_new (coll_find_state_t, 1);
 		coll = xmms_collection_get_pointer (dag, open_name, nsid);
-		if (xmms_collection_media_match (dag, mediainfo, coll, nsid, match_table)) {
+		if (xmms_collection_media_match (dag, &media, coll, nsid, match_table)) {
 			*match = XMMS_COLLECTION_FIND_STATE_MATCH;
 		} else {
 			*match = XMMS_COLLECTION_FIND_STATE_NOMATCH;
@@ -637,11 +661,15 @@ xmms_collection_client_find (xmms_coll_dag_t *dag, gint32 mid, const gchar *name
 		g_hash_table_replace (match_table, g_strdup (open_name), match);
 	}
 
+	g_mutex_unlock (dag->mutex);
+
 	/* List matching collections */
 	g_hash_table_foreach (match_table, build_list_matches, &ret);
 	g_hash_table_destroy (match_table);
 
-	g_hash_table_destroy (mediainfo);
+	if (media.info) {
+		g_hash_table_destroy (media.info);
+	}
 
 	return ret;
 }
@@ -860,6 +888,7 @@ xmms_collection_dag_replace (xmms_coll_dag_t *dag,
                              gchar *key, xmmsv_coll_t *newcoll)
 {
 	g_hash_table_replace (dag->collrefs[nsid], key, newcoll);
+	xmms_coll_index_schedule_prune ();
 }
 
 /** Find the collection structure corresponding to the given name in the given namespace.
@@ -1018,9 +1047,12 @@ xmms_collection_destroy (xmms_object_t *object)
 
 	xmms_coll_sync_shutdown ();
 	xmms_collection_dag_save (dag);
+	xmms_collection_dag_forget ();
 
 	g_mutex_free (dag->mutex);
 
+	xmms_coll_index_shutdown ();
+
 	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
 		g_hash_table_destroy (dag->collrefs[i]);  /* dag is freed here */
 	}
@@ -1282,6 +1314,8 @@ xmms_collection_unreference (xmms_coll_dag_t *dag, const gchar *name, guint nsid
 			g_hash_table_remove (dag->collrefs[nsid], matchkey);
 		}
 
+		xmms_coll_index_schedule_prune ();
+
 		retval = TRUE;
 	}
 
@@ -1713,17 +1747,17 @@ build_list_matches (gpointer key, gpointer value, gpointer udata)
 	}
 }
 
-/** Determine whether the mediainfos match the given collection.
+/** Determine whether the media matches the given collection.
  *
  * @param dag  The collection DAG.
- * @param mediainfo  The properties of the media to match against.
- * @param coll  The collection to match with the mediainfos.
+ * @param media  The media to match against.
+ * @param coll  The collection to match with the media.
  * @param nsid  The namespace id of the collection.
  * @param match_table  The match_table for all collections in that namespace.
  * @return  TRUE if the collection matches, FALSE otherwise.
  */
 static gboolean
-xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
+xmms_collection_media_match (xmms_coll_dag_t *dag, coll_find_media_t *media,
                              xmmsv_coll_t *coll, guint nsid,
                              GHashTable *match_table)
 {
@@ -1731,7 +1765,6 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 	xmmsv_coll_t *op;
 	gchar *attr1 = NULL, *attr2 = NULL;
 	xmmsv_t *val;
-	xmms_medialib_entry_t entry, id;
 	xmmsv_list_iter_t *iter;
 
 	switch (xmmsv_coll_get_type (coll)) {
@@ -1740,7 +1773,7 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 			if (strcmp (attr1, "All Media") == 0) {
 				match = TRUE;
 			} else if (xmmsv_coll_attribute_get (coll, "namespace", &attr2)) {
-				match = xmms_collection_media_match_reference (dag, mediainfo,
+				match = xmms_collection_media_match_reference (dag, media,
 				                                               coll, nsid,
 				                                               match_table,
 				                                               attr1, attr2);
@@ -1759,7 +1792,7 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 			xmmsv_list_iter_entry (iter, &val);
 			xmmsv_get_coll (val, &op);
 
-			match = xmms_collection_media_match (dag, mediainfo, op,
+			match = xmms_collection_media_match (dag, media, op,
 			                                     nsid, match_table);
 		}
 		xmmsv_list_iter_explicit_destroy (iter);
@@ -1777,7 +1810,7 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 			xmmsv_list_iter_entry (iter, &val);
 			xmmsv_get_coll (val, &op);
 
-			match = xmms_collection_media_match (dag, mediainfo, op,
+			match = xmms_collection_media_match (dag, media, op,
 			                                     nsid, match_table);
 		}
 		xmmsv_list_iter_explicit_destroy (iter);
@@ -1785,56 +1818,24 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 
 	case XMMS_COLLECTION_TYPE_COMPLEMENT:
 		/* invert result from operand */
-		match = !xmms_collection_media_match_operand (dag, mediainfo, coll,
+		match = !xmms_collection_media_match_operand (dag, media, coll,
 		                                              nsid, match_table);
 		break;
 
 	case XMMS_COLLECTION_TYPE_HAS:
-		match = xmms_collection_media_filter_has (dag, mediainfo, coll,
-		                                          nsid, match_table);
-		break;
-
 	case XMMS_COLLECTION_TYPE_EQUALS:
-		match = xmms_collection_media_filter_equals (dag, mediainfo, coll,
-		                                            nsid, match_table);
-		break;
-
 	case XMMS_COLLECTION_TYPE_MATCH:
-		match = xmms_collection_media_filter_match (dag, mediainfo, coll,
-		                                               nsid, match_table);
-		break;
-
 	case XMMS_COLLECTION_TYPE_SMALLER:
-		match = xmms_collection_media_filter_smaller (dag, mediainfo, coll,
-		                                              nsid, match_table);
-		break;
-
 	case XMMS_COLLECTION_TYPE_GREATER:
-		match = xmms_collection_media_filter_greater (dag, mediainfo, coll,
-		                                              nsid, match_table);
+		match = xmms_collection_media_filter (dag, media, coll,
+		                                      nsid, match_table);
 		break;
 
 	case XMMS_COLLECTION_TYPE_IDLIST:
 	case XMMS_COLLECTION_TYPE_QUEUE:
 	case XMMS_COLLECTION_TYPE_PARTYSHUFFLE:
 		/* check if id in idlist */
-		val = g_hash_table_lookup (mediainfo, "id");
-		if (val != NULL) {
-			xmmsv_get_int (val, &id);
-
-			xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &iter);
-			for (xmmsv_list_iter_first (iter);
-			     xmmsv_list_iter_valid (iter);
-			     xmmsv_list_iter_next (iter)) {
-
-				xmmsv_list_iter_entry_int (iter, &entry);
-				if (entry == id) {
-					match = TRUE;
-					break;
-				}
-			}
-			xmmsv_list_iter_explicit_destroy (iter);
-		}
+		match = xmms_coll_index_contains (coll, media->mid);
 		break;
 
 	/* invalid type */
@@ -1847,11 +1848,11 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 	return match;
 }
 
-/** Determine whether the mediainfos match the given reference operator.
+/** Determine whether the media matches the given reference operator.
  *
  * @param dag  The collection DAG.
- * @param mediainfo  The properties of the media to match against.
- * @param coll  The collection (ref op) to match with the mediainfos.
+ * @param media  The media to match against.
+ * @param coll  The collection (ref op) to match with the media.
  * @param nsid  The namespace id of the collection.
  * @param match_table  The match_table for all collections in that namespace.
  * @param refname  The name of the referenced collection.
@@ -1859,7 +1860,7 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
  * @return  TRUE if the collection matches, FALSE otherwise.
  */
 static gboolean
-xmms_collection_media_match_reference (xmms_coll_dag_t *dag, GHashTable *mediainfo,
+xmms_collection_media_match_reference (xmms_coll_dag_t *dag, coll_find_media_t *media,
                                        xmmsv_coll_t *coll, guint nsid,
                                        GHashTable *match_table,
                                        const gchar *refname, const gchar *refns)
@@ -1876,7 +1877,7 @@ xmms_collection_media_match_reference (xmms_coll_dag_t *dag, GHashTable *mediain
 			/* Check ref'd collection match status and save it */
 			matchstate = g_new (coll_find_state_t, 1);
 			match = xmms_collection_media_match_operand (dag,
-			                                             mediainfo,
+			                                             media,
 			                                             coll, nsid,
 			                                             match_table);
 
@@ -1894,25 +1895,25 @@ xmms_collection_media_match_reference (xmms_coll_dag_t *dag, GHashTable *mediain
 
 	/* In another NS, just check if it matches */
 	} else {
-		match = xmms_collection_media_match_operand (dag, mediainfo, coll,
+		match = xmms_collection_media_match_operand (dag, media, coll,
 		                                             nsid, match_table);
 	}
 
 	return match;
 }
 
-/** Determine whether the mediainfos match the first operand of the
+/** Determine whether the media matches the first operand of the
  * given operator.
  *
  * @param dag  The collection DAG.
- * @param mediainfo  The properties of the media to match against.
- * @param coll  Match the mediainfos with the operand of that collection.
+ * @param media  The media to match against.
+ * @param coll  Match the media with the operand of that collection.
  * @param nsid  The namespace id of the collection.
  * @param match_table  The match_table for all collections in that namespace.
  * @return  TRUE if the collection matches, FALSE otherwise.
  */
 static gboolean
-xmms_collection_media_match_operand (xmms_coll_dag_t *dag, GHashTable *mediainfo,
+xmms_collection_media_match_operand (xmms_coll_dag_t *dag, coll_find_media_t *media,
                                      xmmsv_coll_t *coll, guint nsid,
                                      GHashTable *match_table)
 {
@@ -1923,7 +1924,7 @@ xmms_collection_media_match_operand (xmms_coll_dag_t *dag, GHashTable *mediainfo
 	if (xmmsv_list_get (xmmsv_coll_operands_get (coll), 0, &tmp)) {
 		xmmsv_get_coll (tmp, &op);
 
-		match = xmms_collection_media_match (dag, mediainfo, op, nsid, match_table);
+		match = xmms_collection_media_match (dag, media, op, nsid, match_table);
 	}
 
 	return match;
@@ -1981,6 +1982,22 @@ xmms_collection_media_info (xmms_medialib_entry_t mid, xmms_error_t *err)
 	return infos;
 }
 
+/** Get all the properties of the media being matched, reading them
+ *  the first time.
+ *
+ * @param media  The media.
+ * @return  A HashTable with all the properties.
+ */
+static GHashTable *
+xmms_collection_find_media_info (coll_find_media_t *media)
+{
+	if (!media->info) {
+		media->info = xmms_collection_media_info (media->mid, media->err);
+	}
+
+	return media->info;
+}
+
 /** Get the string associated to the property of the mediainfo
  *  identified by the "field" attribute of the collection.
  *
@@ -2093,20 +2110,79 @@ filter_get_operator_case (xmmsv_coll_t *coll, gboolean *val)
 	return TRUE;
 }
 
-/* Check whether the HAS filter operator matches the mediainfo. */
+/** Determine whether the media matches the given filter operator.
+ *
+ * Whether the media matches the filter itself is remembered until the
+ * property it filters on changes, the operand is checked every time.
+ *
+ * @param dag  The collection DAG.
+ * @param media  The media to match against.
+ * @param coll  The filter operator to match with the media.
+ * @param nsid  The namespace id of the collection.
+ * @param match_table  The match_table for all collections in that namespace.
+ * @return  TRUE if the collection matches, FALSE otherwise.
+ */
 static gboolean
-xmms_collection_media_filter_has (xmms_coll_dag_t *dag, GHashTable *mediainfo,
-                                  xmmsv_coll_t *coll, guint nsid,
-                                  GHashTable *match_table)
+xmms_collection_media_filter (xmms_coll_dag_t *dag, coll_find_media_t *media,
+                              xmmsv_coll_t *coll, guint nsid,
+                              GHashTable *match_table)
 {
+	GHashTable *mediainfo;
 	gboolean match = FALSE;
-	gchar *mediaval;
+	gint cached;
+
+	cached = xmms_coll_index_filter_lookup (coll, media->mid);
+	if (cached >= 0) {
+		match = cached;
+	} else {
+		mediainfo = xmms_collection_find_media_info (media);
+
+		switch (xmmsv_coll_get_type (coll)) {
+		case XMMS_COLLECTION_TYPE_HAS:
+			match = xmms_collection_media_filter_has (coll, mediainfo);
+			break;
+		case XMMS_COLLECTION_TYPE_EQUALS:
+			match = xmms_collection_media_filter_equals (coll, mediainfo);
+			break;
+		case XMMS_COLLECTION_TYPE_MATCH:
+			match = xmms_collection_media_filter_match (coll, mediainfo);
+			break;
+		case XMMS_COLLECTION_TYPE_SMALLER:
+			match = xmms_collection_media_filter_smaller (coll, mediainfo);
+			break;
+		case XMMS_COLLECTION_TYPE_GREATER:
+			match = xmms_collection_media_filter_greater (coll, mediainfo);
+			break;
+		default:
+			g_assert_not_reached ();
+			break;
+		}
+
+		/* the infos are missing if they couldn't be read */
+		if (xmms_error_isok (media->err)) {
+			xmms_coll_index_filter_store (coll, media->mid, media->stamp,
+			                              match);
+		}
+	}
 
 	/* If operator matches, recurse upwards in the operand */
-	if (filter_get_mediainfo_field_string (coll, mediainfo, &mediaval)) {
-		match = xmms_collection_media_match_operand (dag, mediainfo, coll,
+	if (match) {
+		match = xmms_collection_media_match_operand (dag, media, coll,
 		                                             nsid, match_table);
+	}
+
+	return match;
+}
+
+/* Check whether the HAS filter operator matches the mediainfo. */
+static gboolean
+xmms_collection_media_filter_has (xmmsv_coll_t *coll, GHashTable *mediainfo)
+{
+	gboolean match = FALSE;
+	gchar *mediaval;
 
+	if (filter_get_mediainfo_field_string (coll, mediainfo, &mediaval)) {
+		match = TRUE;
 		g_free (mediaval);
 	}
 
@@ -2115,9 +2191,7 @@ xmms_collection_media_filter_has (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 
 /* Check whether the MATCH filter operator matches the mediainfo. */
 static gboolean
-xmms_collection_media_filter_equals (xmms_coll_dag_t *dag, GHashTable *mediainfo,
-                                    xmmsv_coll_t *coll, guint nsid,
-                                    GHashTable *match_table)
+xmms_collection_media_filter_equals (xmmsv_coll_t *coll, GHashTable *mediainfo)
 {
 	gboolean match = FALSE;
 	gchar *mediaval = NULL;
@@ -2135,12 +2209,6 @@ xmms_collection_media_filter_equals (xmms_coll_dag_t *dag, GHashTable *mediainfo
 		}
 	}
 
-	/* If operator matches, recurse upwards in the operand */
-	if (match) {
-		match = xmms_collection_media_match_operand (dag, mediainfo, coll,
-		                                             nsid, match_table);
-	}
-
 	if (mediaval != NULL) {
 		g_free (mediaval);
 	}
@@ -2150,9 +2218,7 @@ xmms_collection_media_filter_equals (xmms_coll_dag_t *dag, GHashTable *mediainfo
 
 /* Check whether the MATCH filter operator matches the mediainfo. */
 static gboolean
-xmms_collection_media_filter_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
-                                       xmmsv_coll_t *coll, guint nsid,
-                                       GHashTable *match_table)
+xmms_collection_media_filter_match (xmmsv_coll_t *coll, GHashTable *mediainfo)
 {
 	gboolean match = FALSE;
 	gchar *buf, *opval, *mediaval;
@@ -2177,12 +2243,6 @@ xmms_collection_media_filter_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 		g_free (buf);
 		g_free (opval);
 		g_free (mediaval);
-
-		/* If operator matches, recurse upwards in the operand */
-		if (match) {
-			match = xmms_collection_media_match_operand (dag, mediainfo, coll,
-			                                             nsid, match_table);
-		}
 	}
 
 	return match;
@@ -2190,44 +2250,24 @@ xmms_collection_media_filter_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 
 /* Check whether the SMALLER filter operator matches the mediainfo. */
 static gboolean
-xmms_collection_media_filter_smaller (xmms_coll_dag_t *dag, GHashTable *mediainfo,
-                                      xmmsv_coll_t *coll, guint nsid,
-                                      GHashTable *match_table)
+xmms_collection_media_filter_smaller (xmmsv_coll_t *coll, GHashTable *mediainfo)
 {
-	gboolean match = FALSE;
 	gint mediaval;
 	gint opval;
 
-	/* If operator matches, recurse upwards in the operand */
-	if (filter_get_mediainfo_field_int (coll, mediainfo, &mediaval) &&
-	    filter_get_operator_value_int (coll, &opval) &&
-	    (mediaval < opval) ) {
-
-		match = xmms_collection_media_match_operand (dag, mediainfo, coll,
-		                                             nsid, match_table);
-	}
-
-	return match;
+	return (filter_get_mediainfo_field_int (coll, mediainfo, &mediaval) &&
+	        filter_get_operator_value_int (coll, &opval) &&
+	        (mediaval < opval));
 }
 
 /* Check whether the GREATER filter operator matches the mediainfo. */
 static gboolean
-xmms_collection_media_filter_greater (xmms_coll_dag_t *dag, GHashTable *mediainfo,
-                                      xmmsv_coll_t *coll, guint nsid,
-                                      GHashTable *match_table)
+xmms_collection_media_filter_greater (xmmsv_coll_t *coll, GHashTable *mediainfo)
 {
-	gboolean match = FALSE;
 	gint mediaval;
 	gint opval;
 
-	/* If operator matches, recurse upwards in the operand */
-	if (filter_get_mediainfo_field_int (coll, mediainfo, &mediaval) &&
-	    filter_get_operator_value_int (coll, &opval) &&
-	    (mediaval > opval) ) {
-
-		match = xmms_collection_media_match_operand (dag, mediainfo, coll,
-		                                             nsid, match_table);
-	}
-
-	return match;
+	return (filter_get_mediainfo_field_int (coll, mediainfo, &mediaval) &&
+	        filter_get_operator_value_int (coll, &opval) &&
+	        (mediaval > opval));
 }
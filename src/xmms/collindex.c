@@ -0,0 +1,423 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+
+/** @file
+ *  Indexes to find the collections containing a media quickly.
+ *
+ *  Idlists are indexed by media id the first time they are looked at,
+ *  and the playlist keeps the index up to date as it adds and removes
+ *  entries. Other collections only change by being replaced, so
+ *  operators no longer in the DAG are pruned once it changed.
+ *
+ *  Filter operators remember whether a media matched them until the
+ *  property they filter on changes in the medialib.
+ */
+
+#include "xmmspriv/xmms_collindex.h"
+#include "xmmspriv/xmms_medialib.h"
+#include <glib.h>
+
+/* Forget the results of a filter rather than let it grow beyond this */
+#define XMMS_COLL_INDEX_FILTER_MAX 65536
+
+typedef struct {
+	xmmsv_coll_t *coll;
+	guint count;
+} coll_index_entry_t;
+
+typedef struct {
+	/* the stamp of the property when the oldest result was read */
+	guint32 stamp;
+	/* mid -> match + 1 */
+	GHashTable *results;
+} coll_index_filter_t;
+
+typedef struct {
+	GHashTable *used;
+	GHashTable *drop;
+} coll_index_prune_t;
+
+static GMutex *mutex;
+/* mid -> GArray of coll_index_entry_t, the reverse index */
+static GHashTable *media;
+/* xmmsv_coll_t * -> TRUE for the idlists in the reverse index */
+static GHashTable *idlists;
+/* xmmsv_coll_t * -> coll_index_filter_t */
+static GHashTable *filters;
+static gboolean want_prune = FALSE;
+
+static void
+coll_index_filter_free (gpointer data)
+{
+	coll_index_filter_t *filter = data;
+
+	g_hash_table_destroy (filter->results);
+	g_free (filter);
+}
+
+static void
+coll_index_entries_free (gpointer data)
+{
+	g_array_free (data, TRUE);
+}
+
+/**
+ * Set up the indexes, they start out empty.
+ */
+void
+xmms_coll_index_init (void)
+{
+	mutex = g_mutex_new ();
+	media = g_hash_table_new_full (NULL, NULL, NULL, coll_index_entries_free);
+	idlists = g_hash_table_new_full (NULL, NULL,
+	                                 (GDestroyNotify) xmmsv_coll_unref, NULL);
+	filters = g_hash_table_new_full (NULL, NULL,
+	                                 (GDestroyNotify) xmmsv_coll_unref,
+	                                 coll_index_filter_free);
+}
+
+void
+xmms_coll_index_shutdown (void)
+{
+	g_hash_table_destroy (filters);
+	g_hash_table_destroy (idlists);
+	g_hash_table_destroy (media);
+	g_mutex_free (mutex);
+}
+
+static void
+xmms_coll_index_add_unlocked (xmmsv_coll_t *coll, xmms_medialib_entry_t mid)
+{
+	coll_index_entry_t *entry, new_entry;
+	GArray *entries;
+	gint i;
+
+	entries = g_hash_table_lookup (media, GINT_TO_POINTER (mid));
+	if (!entries) {
+		entries = g_array_sized_new (FALSE, FALSE,
+		                             sizeof (coll_index_entry_t), 1);
+		g_hash_table_insert (media, GINT_TO_POINTER (mid), entries);
+	}
+
+	for (i = 0; i < entries->len; i++) {
+		entry = &g_array_index (entries, coll_index_entry_t, i);
+		if (entry->coll == coll) {
+			entry->count++;
+			return;
+		}
+	}
+
+	new_entry.coll = coll;
+	new_entry.count = 1;
+	g_array_append_val (entries, new_entry);
+}
+
+static void
+xmms_coll_index_remove_unlocked (xmmsv_coll_t *coll, xmms_medialib_entry_t mid)
+{
+	coll_index_entry_t *entry;
+	GArray *entries;
+	gint i;
+
+	entries = g_hash_table_lookup (media, GINT_TO_POINTER (mid));
+	if (!entries) {
+		return;
+	}
+
+	for (i = 0; i < entries->len; i++) {
+		entry = &g_array_index (entries, coll_index_entry_t, i);
+		if (entry->coll == coll) {
+			if (--entry->count == 0) {
+				g_array_remove_index_fast (entries, i);
+			}
+			break;
+		}
+	}
+
+	if (entries->len == 0) {
+		g_hash_table_remove (media, GINT_TO_POINTER (mid));
+	}
+}
+
+/* Drop the entries of the collections in udata from a media. */
+static gboolean
+xmms_coll_index_drop_entries (gpointer key, gpointer value, gpointer udata)
+{
+	GHashTable *drop = udata;
+	GArray *entries = value;
+	coll_index_entry_t *entry;
+	gint i;
+
+	for (i = entries->len - 1; i >= 0; i--) {
+		entry = &g_array_index (entries, coll_index_entry_t, i);
+		if (g_hash_table_lookup (drop, entry->coll)) {
+			g_array_remove_index_fast (entries, i);
+		}
+	}
+
+	return entries->len == 0;
+}
+
+/**
+ * Check whether an idlist contains a media, indexing the idlist if
+ * it's the first time it is asked about.
+ *
+ * @param coll  An idlist, queue or party shuffle operator.
+ * @param mid  The media.
+ * @returns TRUE if the media is in the idlist.
+ */
+gboolean
+xmms_coll_index_contains (xmmsv_coll_t *coll, xmms_medialib_entry_t mid)
+{
+	coll_index_entry_t *entry;
+	xmmsv_list_iter_t *iter;
+	xmms_medialib_entry_t id;
+	gboolean ret = FALSE;
+	GArray *entries;
+	gint i;
+
+	g_mutex_lock (mutex);
+
+	if (!g_hash_table_lookup (idlists, coll)) {
+		g_hash_table_insert (idlists, xmmsv_coll_ref (coll),
+		                     GINT_TO_POINTER (TRUE));
+
+		xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &iter);
+		for (xmmsv_list_iter_first (iter);
+		     xmmsv_list_iter_valid (iter);
+		     xmmsv_list_iter_next (iter)) {
+
+			xmmsv_list_iter_entry_int (iter, &id);
+			xmms_coll_index_add_unlocked (coll, id);
+		}
+		xmmsv_list_iter_explicit_destroy (iter);
+	}
+
+	entries = g_hash_table_lookup (media, GINT_TO_POINTER (mid));
+	for (i = 0; entries && !ret && i < entries->len; i++) {
+		entry = &g_array_index (entries, coll_index_entry_t, i);
+		ret = (entry->coll == coll);
+	}
+
+	g_mutex_unlock (mutex);
+
+	return ret;
+}
+
+/**
+ * Tell the index a media was added to an idlist.
+ */
+void
+xmms_coll_index_add (xmmsv_coll_t *coll, xmms_medialib_entry_t mid)
+{
+	g_mutex_lock (mutex);
+	if (g_hash_table_lookup (idlists, coll)) {
+		xmms_coll_index_add_unlocked (coll, mid);
+	}
+	g_mutex_unlock (mutex);
+}
+
+/**
+ * Tell the index a media was removed from an idlist, once for every
+ * time it was removed.
+ */
+void
+xmms_coll_index_remove (xmmsv_coll_t *coll, xmms_medialib_entry_t mid)
+{
+	g_mutex_lock (mutex);
+	if (g_hash_table_lookup (idlists, coll)) {
+		xmms_coll_index_remove_unlocked (coll, mid);
+	}
+	g_mutex_unlock (mutex);
+}
+
+/**
+ * Forget about an idlist whose contents changed wholesale, it is
+ * indexed again the next time it's asked about.
+ */
+void
+xmms_coll_index_invalidate (xmmsv_coll_t *coll)
+{
+	GHashTable *drop;
+
+	g_mutex_lock (mutex);
+
+	if (g_hash_table_lookup (idlists, coll)) {
+		drop = g_hash_table_new (NULL, NULL);
+		g_hash_table_insert (drop, coll, GINT_TO_POINTER (TRUE));
+		g_hash_table_foreach_remove (media, xmms_coll_index_drop_entries,
+		                             drop);
+		g_hash_table_destroy (drop);
+
+		g_hash_table_remove (idlists, coll);
+	}
+
+	g_mutex_unlock (mutex);
+}
+
+/**
+ * Look up whether a media matched a filter operator, not taking its
+ * operand into account.
+ *
+ * @returns 1 if it matched, 0 if it didn't and -1 if it isn't known
+ * or the property has changed since.
+ */
+gint
+xmms_coll_index_filter_lookup (xmmsv_coll_t *coll, xmms_medialib_entry_t mid)
+{
+	coll_index_filter_t *filter;
+	gchar *field;
+	gint ret = -1;
+
+	if (!xmmsv_coll_attribute_get (coll, "field", &field)) {
+		return -1;
+	}
+
+	g_mutex_lock (mutex);
+
+	filter = g_hash_table_lookup (filters, coll);
+	if (filter) {
+		if (xmms_medialib_property_stamp (field) > filter->stamp) {
+			g_hash_table_remove_all (filter->results);
+		} else {
+			ret = GPOINTER_TO_INT (g_hash_table_lookup (filter->results,
+			                                            GINT_TO_POINTER (mid)));
+			ret--;
+		}
+	}
+
+	g_mutex_unlock (mutex);
+
+	return ret;
+}
+
+/**
+ * Remember whether a media matched a filter operator.
+ *
+ * @param coll  The filter operator.
+ * @param mid  The media.
+ * @param stamp  The property stamp from before the properties of the
+ * media were read, see xmms_medialib_property_stamp.
+ * @param match  Whether the media matched, not taking the operand
+ * into account.
+ */
+void
+xmms_coll_index_filter_store (xmmsv_coll_t *coll, xmms_medialib_entry_t mid,
+                              guint32 stamp, gboolean match)
+{
+	coll_index_filter_t *filter;
+
+	g_mutex_lock (mutex);
+
+	filter = g_hash_table_lookup (filters, coll);
+	if (!filter) {
+		filter = g_new0 (coll_index_filter_t, 1);
+		filter->results = g_hash_table_new (NULL, NULL);
+		g_hash_table_insert (filters, xmmsv_coll_ref (coll), filter);
+	}
+
+	if (g_hash_table_size (filter->results) >= XMMS_COLL_INDEX_FILTER_MAX) {
+		g_hash_table_remove_all (filter->results);
+	}
+
+	if (g_hash_table_size (filter->results) == 0) {
+		filter->stamp = stamp;
+	} else {
+		filter->stamp = MIN (filter->stamp, stamp);
+	}
+
+	g_hash_table_replace (filter->results, GINT_TO_POINTER (mid),
+	                      GINT_TO_POINTER (match + 1));
+
+	g_mutex_unlock (mutex);
+}
+
+/**
+ * Note that collections were replaced or removed in the DAG, so the
+ * indexes may hold operators that are no longer used.
+ */
+void
+xmms_coll_index_schedule_prune (void)
+{
+	g_mutex_lock (mutex);
+	want_prune = TRUE;
+	g_mutex_unlock (mutex);
+}
+
+static void
+xmms_coll_index_mark_used (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
+                           xmmsv_coll_t *parent, void *udata)
+{
+	GHashTable *used = udata;
+	g_hash_table_insert (used, coll, GINT_TO_POINTER (TRUE));
+}
+
+static gboolean
+xmms_coll_index_unused (gpointer key, gpointer value, gpointer udata)
+{
+	GHashTable *used = udata;
+	return g_hash_table_lookup (used, key) == NULL;
+}
+
+static void
+xmms_coll_index_collect_unused (gpointer key, gpointer value, gpointer udata)
+{
+	coll_index_prune_t *prune = udata;
+
+	if (!g_hash_table_lookup (prune->used, key)) {
+		g_hash_table_insert (prune->drop, key, GINT_TO_POINTER (TRUE));
+	}
+}
+
+/**
+ * Drop the operators that are no longer in the DAG from the indexes,
+ * if the DAG changed since the last time. Must be called with the DAG
+ * locked.
+ */
+void
+xmms_coll_index_prune (xmms_coll_dag_t *dag)
+{
+	coll_index_prune_t prune;
+
+	g_mutex_lock (mutex);
+
+	if (!want_prune) {
+		g_mutex_unlock (mutex);
+		return;
+	}
+	want_prune = FALSE;
+
+	prune.used = g_hash_table_new (NULL, NULL);
+	prune.drop = g_hash_table_new (NULL, NULL);
+
+	xmms_collection_apply_to_all_collections (dag, xmms_coll_index_mark_used,
+	                                          prune.used);
+
+	g_hash_table_foreach (idlists, xmms_coll_index_collect_unused, &prune);
+	if (g_hash_table_size (prune.drop)) {
+		g_hash_table_foreach_remove (media, xmms_coll_index_drop_entries,
+		                             prune.drop);
+		g_hash_table_foreach_remove (idlists, xmms_coll_index_unused,
+		                             prune.used);
+	}
+	g_hash_table_foreach_remove (filters, xmms_coll_index_unused, prune.used);
+
+	g_hash_table_destroy (prune.drop);
+	g_hash_table_destroy (prune.used);
+
+	g_mutex_unlock (mutex);
+}
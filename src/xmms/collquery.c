@@ -23,6 +23,7 @@
 #include <glib.h>
 
 #include "xmmspriv/xmms_collquery.h"
+#include "xmmspriv/xmms_sqlite.h"
 #include "xmms/xmms_log.h"
 
 
@@ -73,6 +74,7 @@ static void query_append_protect_string (coll_query_t *query, gchar *s);
 static void query_append_operand (coll_query_t *query, xmms_coll_dag_t *dag, xmmsv_coll_t *coll);
 static void query_append_intersect_operand (coll_query_t *query, xmms_coll_dag_t *dag, xmmsv_coll_t *coll);
 static void query_append_filter (coll_query_t *query, xmmsv_coll_type_t type, gchar *key, gchar *value, gboolean case_sens);
+static void query_append_text_index (coll_query_t *query, coll_query_alias_t *alias, const gchar *key, gchar *pattern);
 static void query_string_append_joins (gpointer key, gpointer val, gpointer udata);
 static void query_string_append_alias_list (coll_query_t *query, GString *qstring, xmmsv_t *fields);
 static void query_string_append_fetch (coll_query_t *query, GString *qstring);
@@ -528,6 +530,7 @@ query_append_filter (coll_query_t *query, xmmsv_coll_type_t type,
 				}
 			}
 			query_append_protect_string (query, temp);
+			query_append_text_index (query, alias, key, temp);
 			g_free(temp);
 		} else {
 			query_append_protect_string (query, value);
@@ -560,6 +563,61 @@ query_append_filter (coll_query_t *query, xmmsv_coll_type_t type,
 	}
 }
 
+/* Restrict a LIKE on the value of the alias to the rows the text index
+ * finds for the pattern, if the pattern allows it. */
+static void
+query_append_text_index (coll_query_t *query, coll_query_alias_t *alias,
+                         const gchar *key, gchar *pattern)
+{
+	GString *match;
+	gchar **runs, **parts, *phrase;
+	gint i;
+
+	if (alias->type != XMMS_QUERY_ALIAS_PROP || !xmms_sqlite_text_indexed (key)) {
+		return;
+	}
+
+	/* Without a leading wildcard the (key, value) index does better */
+	if (*pattern != '%' && *pattern != '_') {
+		return;
+	}
+
+	/* The index is made of trigrams, so it can only look for the
+	 * parts between wildcards that are at least three characters
+	 * long. Rows containing all of them are a superset of the rows
+	 * matching the pattern, the LIKE sorts out the rest. */
+	match = g_string_new (NULL);
+	runs = g_strsplit_set (pattern, "%_", 0);
+	for (i = 0; runs[i]; i++) {
+		if (g_utf8_strlen (runs[i], -1) < 3) {
+			continue;
+		}
+
+		if (match->len > 0) {
+			g_string_append (match, " AND ");
+		}
+
+		/* quotes are doubled inside a phrase */
+		parts = g_strsplit (runs[i], "\"", 0);
+		phrase = g_strjoinv ("\"\"", parts);
+		g_string_append_printf (match, "\"%s\"", phrase);
+		g_free (phrase);
+		g_strfreev (parts);
+	}
+	g_strfreev (runs);
+
+	if (match->len > 0) {
+		g_string_append_printf (query->conditions,
+		                        " AND m%u.rowid IN (SELECT rowid FROM MediaText "
+		                                           "WHERE MediaText MATCH ",
+		                        alias->id);
+		query_append_protect_string (query, match->str);
+		query_append_string (query, ")");
+	}
+
+	g_string_free (match, TRUE);
+}
+
 /* Append SELECT joins to the argument string for each alias of the hashtable. */
 static void
 query_string_append_joins (gpointer key, gpointer val, gpointer udata)
@@ -22,6 +22,10 @@
 #include "xmmspriv/xmms_collserial.h"
 #include "xmmspriv/xmms_collection.h"
 #include "xmmspriv/xmms_medialib.h"
+#include "xmms/xmms_config.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 
 /* Internal helper structures */
@@ -30,22 +34,68 @@ typedef struct {
 	xmms_medialib_session_t *session;
 	guint collid;
 	xmms_collection_namespace_id_t nsid;
+	/* labels written during this save, "nsid/label" -> id */
+	GHashTable *labels;
 } coll_dbwrite_t;
 
-
-static xmmsv_coll_t *xmms_collection_dbread_operator (xmms_medialib_session_t *session, gint id, xmmsv_coll_type_t type);
+/* What was last written to the DB for a labelled collection. A
+ * collection is dirty when it no longer matches this, and only the
+ * parts that differ are written again. */
+typedef struct {
+	guint id;
+	xmmsv_coll_type_t type;
+	GString *attributes;
+	GArray *idlist;
+	GString *operands;
+	/* the operands were written with the ids [first, last) */
+	guint operands_first;
+	guint operands_last;
+	/* already written during the current save */
+	gboolean seen;
+} coll_saved_t;
+
+
+static xmmsv_coll_t *xmms_collection_dbread_operator (xmms_medialib_session_t *session, gint id, xmmsv_coll_type_t type, guint *first, guint *last);
 static guint xmms_collection_dbwrite_operator (xmms_medialib_session_t *session, guint collid, xmmsv_coll_t *coll);
+static guint xmms_collection_dbwrite_operands (xmms_medialib_session_t *session, guint collid, xmmsv_coll_t *coll, guint newid);
+static void xmms_collection_dbread_idlist_positions (xmms_medialib_session_t *session, coll_saved_t *saved);
+static void xmms_collection_dbwrite_idlist (xmms_medialib_session_t *session, guint collid, xmmsv_coll_t *coll, gint from);
+static void xmms_collection_dbwrite_changes (xmms_medialib_session_t *session, coll_saved_t *saved, xmmsv_coll_t *coll);
+static void xmms_collection_dag_saved_init (void);
+static void xmms_collection_dbdelete_range (xmms_medialib_session_t *session, guint first, guint last);
 
 static void dbwrite_operator (void *key, void *value, void *udata);
 static void dbwrite_coll_attributes (const char *key, xmmsv_t *value, void *udata);
-static void dbwrite_strip_tmpprops (void *key, void *value, void *udata);
+static void dbwrite_unseen (gpointer key, gpointer value, gpointer udata);
+static void dbwrite_removed_label (gpointer key, gpointer value, gpointer udata);
+static gboolean dbwrite_removed_coll (gpointer key, gpointer value, gpointer udata);
+
+static coll_saved_t *coll_saved_new (xmmsv_coll_t *coll, guint id, guint first, guint last);
+static void coll_saved_free (gpointer data);
+static void coll_signature_attribute_key (const char *key, xmmsv_t *value, void *udata);
+static void coll_signature_attributes (xmmsv_coll_t *coll, GString *str);
+static void coll_signature_operands (xmmsv_coll_t *coll, GString *str);
+static GArray *coll_idlist_copy (xmmsv_coll_t *coll);
 
 static gint value_get_dict_int (xmmsv_t *val, const gchar *key);
 static const gchar *value_get_dict_string (xmmsv_t *val, const gchar *key);
 
 
+/* The saved state of the DAG, NULL until it's been restored or fully
+ * written. Only touched with the DAG mutex held. */
+static GHashTable *saved_colls = NULL;  /* xmmsv_coll_t * -> coll_saved_t */
+static GHashTable *saved_labels = NULL; /* "nsid/label" -> id */
+static guint saved_nextid = 1;
+
 
 /** Save the collection DAG in the database.
+ *
+ * Only the collections that changed since the last save are written,
+ * playlists that were appended to or truncated only get the
+ * difference in their idlist. If the collection.full_save config
+ * property is set, all tables are emptied and everything is written
+ * again instead, which also gets rid of anything in the DB that
+ * doesn't belong there.
  *
  * @param dag  The collection DAG to save.
  */
@@ -54,29 +104,81 @@ xmms_collection_dag_save (xmms_coll_dag_t *dag)
 {
 	gint i;
 	xmms_medialib_session_t *session;
+	xmms_config_property_t *prop;
+	coll_dbwrite_t dbinfos;
+	gboolean full;
+
+	full = (saved_colls == NULL);
+
+	prop = xmms_config_lookup ("collection.full_save");
+	if (prop && xmms_config_property_get_int (prop)) {
+		full = TRUE;
+	}
 
 	session = xmms_medialib_begin_write ();
 
-	/* Empty Collection* tables */
-	xmms_medialib_select (session, "DELETE FROM CollectionAttributes", NULL);
-	xmms_medialib_select (session, "DELETE FROM CollectionConnections", NULL);
-	xmms_medialib_select (session, "DELETE FROM CollectionIdlists", NULL);
-	xmms_medialib_select (session, "DELETE FROM CollectionLabels", NULL);
-	xmms_medialib_select (session, "DELETE FROM CollectionOperators", NULL);
+	if (full) {
+		/* Empty Collection* tables */
+		xmms_medialib_select (session, "DELETE FROM CollectionAttributes", NULL);
+		xmms_medialib_select (session, "DELETE FROM CollectionConnections", NULL);
+		xmms_medialib_select (session, "DELETE FROM CollectionIdlists", NULL);
+		xmms_medialib_select (session, "DELETE FROM CollectionLabels", NULL);
+		xmms_medialib_select (session, "DELETE FROM CollectionOperators", NULL);
+
+		xmms_collection_dag_saved_init ();
+		saved_nextid = 1; /* ids start at 1 */
+	}
+
+	g_hash_table_foreach (saved_colls, dbwrite_unseen, NULL);
 
-	/* Write all collections in all namespaces */
-	coll_dbwrite_t dbinfos = { session, 1, 0 }; /* ids start at 1 */
+	/* Write all changed collections in all namespaces */
+	dbinfos.session = session;
+	dbinfos.collid = 0;
+	dbinfos.labels = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                        g_free, NULL);
 	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
 		dbinfos.nsid = i;
 		xmms_collection_foreach_in_namespace (dag, i, dbwrite_operator, &dbinfos);
 	}
 
-	xmms_collection_foreach_in_namespace (dag, XMMS_COLLECTION_NSID_ALL,
-	                                      dbwrite_strip_tmpprops, NULL);
+	/* Remove what is no longer there */
+	g_hash_table_foreach (saved_labels, dbwrite_removed_label, &dbinfos);
+	g_hash_table_foreach_remove (saved_colls, dbwrite_removed_coll, session);
+
+	g_hash_table_destroy (saved_labels);
+	saved_labels = dbinfos.labels;
 
 	xmms_medialib_end (session);
 }
 
+/** Forget what has been saved, the next save rewrites everything.
+ */
+void
+xmms_collection_dag_forget (void)
+{
+	if (saved_colls) {
+		g_hash_table_destroy (saved_colls);
+		saved_colls = NULL;
+	}
+	if (saved_labels) {
+		g_hash_table_destroy (saved_labels);
+		saved_labels = NULL;
+	}
+}
+
+/* Start over with nothing saved. */
+static void
+xmms_collection_dag_saved_init (void)
+{
+	xmms_collection_dag_forget ();
+
+	saved_colls = g_hash_table_new_full (NULL, NULL,
+	                                     (GDestroyNotify) xmmsv_coll_unref,
+	                                     coll_saved_free);
+	saved_labels = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                      g_free, NULL);
+}
+
 /** Restore the collection DAG from the database.
  *
  * @param dag  The collection DAG to restore to.
@@ -86,6 +188,7 @@ xmms_collection_dag_restore (xmms_coll_dag_t *dag)
 {
 	xmmsv_coll_t *coll = NULL;
 	xmms_medialib_session_t *session;
+	coll_saved_t *saved;
 	xmmsv_t *cmdval;
 	const gchar *query;
 	GList *res;
@@ -93,6 +196,8 @@ xmms_collection_dag_restore (xmms_coll_dag_t *dag)
 
 	session = xmms_medialib_begin ();
 
+	xmms_collection_dag_saved_init ();
+
 	/* Fetch all label-coll_operator for all namespaces, register in table */
 	query = "SELECT op.id AS id, lbl.name AS label, "
 	        "       lbl.namespace AS nsid, op.type AS type "
@@ -105,6 +210,7 @@ xmms_collection_dag_restore (xmms_coll_dag_t *dag)
 
 	while (res) {
 		gint id, type, nsid;
+		guint first, last;
 		const gchar *label;
 
 		cmdval = (xmmsv_t*) res->data;
@@ -115,19 +221,39 @@ xmms_collection_dag_restore (xmms_coll_dag_t *dag)
 
 		/* Do not duplicate operator if same id */
 		if (previd < 0 || id != previd) {
-			coll = xmms_collection_dbread_operator (session, id, type);
+			first = last = 0;
+			coll = xmms_collection_dbread_operator (session, id, type,
+			                                        &first, &last);
 			previd = id;
+
+			/* references aren't bound yet, and don't count anyway */
+			saved = coll_saved_new (coll, id, first, last);
+			xmms_collection_dbread_idlist_positions (session, saved);
+			g_hash_table_insert (saved_colls, xmmsv_coll_ref (coll), saved);
 		}
 		else {
 			xmmsv_coll_ref (coll);  /* New label references the coll */
 		}
 
 		xmms_collection_dag_replace (dag, nsid, g_strdup (label), coll);
+		g_hash_table_insert (saved_labels,
+		                     g_strdup_printf ("%d/%s", nsid, label),
+		                     GUINT_TO_POINTER (id));
 
 		xmmsv_unref (cmdval);
 		res = g_list_delete_link (res, res);
 	}
 
+	/* New operators are written after everything that's there */
+	query = "SELECT IFNULL(MAX(id), 0) AS id FROM CollectionOperators";
+	res = xmms_medialib_select (session, query, NULL);
+	saved_nextid = 1;
+	if (res) {
+		saved_nextid = value_get_dict_int (res->data, "id") + 1;
+		xmmsv_unref (res->data);
+		g_list_free (res);
+	}
+
 	xmms_medialib_end (session);
 
 	/* FIXME: validate ? */
@@ -142,11 +268,14 @@ xmms_collection_dag_restore (xmms_coll_dag_t *dag)
  * @param session  The medialib session connected to the DB.
  * @param id  The id of the collection to create.
  * @param type  The type of the collection operator.
+ * @param first  Lowest id of the operands read so far, or 0.
+ * @param last  One past the highest id of the operands read so far.
  * @return  The created collection DAG.
  */
 static xmmsv_coll_t *
 xmms_collection_dbread_operator (xmms_medialib_session_t *session,
-                                 gint id, xmmsv_coll_type_t type)
+                                 gint id, xmmsv_coll_type_t type,
+                                 guint *first, guint *last)
 {
 	xmmsv_coll_t *coll;
 	xmmsv_coll_t *op;
@@ -208,7 +337,14 @@ xmms_collection_dbread_operator (xmms_medialib_session_t *session,
 		_id = value_get_dict_int (cmdval, "id");
 		type = value_get_dict_int (cmdval, "type");
 
-		op = xmms_collection_dbread_operator (session, _id, type);
+		if (*first == 0 || _id < *first) {
+			*first = _id;
+		}
+		if (_id >= *last) {
+			*last = _id + 1;
+		}
+
+		op = xmms_collection_dbread_operator (session, _id, type, first, last);
 		xmmsv_coll_add_operand (coll, op);
 
 		xmmsv_coll_unref (op);
@@ -231,13 +367,8 @@ xmms_collection_dbwrite_operator (xmms_medialib_session_t *session,
                                   guint collid, xmmsv_coll_t *coll)
 {
 	gchar query[128];
-	xmms_medialib_entry_t entry;
-	xmmsv_list_iter_t *it;
-	gint i;
-	xmmsv_coll_t *op;
 	xmmsv_t *attrs;
-	gint newid, nextid;
-	coll_dbwrite_t dbwrite_infos = { session, collid, 0 };
+	coll_dbwrite_t dbwrite_infos = { session, collid, 0, NULL };
 
 	/* Write operator */
 	g_snprintf (query, sizeof (query),
@@ -252,51 +383,233 @@ xmms_collection_dbwrite_operator (xmms_medialib_session_t *session,
 	attrs = NULL; /* no unref needed. */
 
 	/* Write idlist */
-	xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &it);
-	for (xmmsv_list_iter_first (it), i = 0;
-	     xmmsv_list_iter_valid (it);
-	     xmmsv_list_iter_next (it), i++) {
+	xmms_collection_dbwrite_idlist (session, collid, coll, 0);
+
+	/* Save operands and connections, return next available id */
+	return xmms_collection_dbwrite_operands (session, collid, coll, collid + 1);
+}
+
+/** Write the operands of the given operator to the database.
+ *
+ * @param session  The medialib session connected to the DB.
+ * @param collid  The id of the operator.
+ * @param coll  The operator.
+ * @param newid  The id to write the first operand under.
+ * @return  The next free collection id.
+ */
+static guint
+xmms_collection_dbwrite_operands (xmms_medialib_session_t *session,
+                                  guint collid, xmmsv_coll_t *coll,
+                                  guint newid)
+{
+	gchar query[128];
+	xmmsv_coll_t *op;
+	gint nextid;
+	xmmsv_t *tmp;
+	xmmsv_list_iter_t *iter;
+
+	/* don't recurse in ref operand */
+	if (xmmsv_coll_get_type (coll) == XMMS_COLLECTION_TYPE_REFERENCE) {
+		return newid;
+	}
+
+	xmmsv_get_list_iter (xmmsv_coll_operands_get (coll), &iter);
 
-		xmmsv_list_iter_entry_int (it, &entry);
+	for (xmmsv_list_iter_first (iter);
+	     xmmsv_list_iter_valid (iter);
+	     xmmsv_list_iter_next (iter)) {
+
+		xmmsv_list_iter_entry (iter, &tmp);
+		xmmsv_get_coll (tmp, &op);
+
+		nextid = xmms_collection_dbwrite_operator (session, newid, op);
+		g_snprintf (query, sizeof (query),
+		            "INSERT INTO CollectionConnections VALUES(%d, %d)",
+		            newid, collid);
+		xmms_medialib_select (session, query, NULL);
+		newid = nextid;
+	}
+	xmmsv_list_iter_explicit_destroy (iter);
+
+	return newid;
+}
+
+/** Only keep the start of the saved idlist that is stored at the
+ * positions it has in the list, the rest is written again by the next
+ * save. A new DB has the default playlist at position 1.
+ *
+ * @param session  The medialib session connected to the DB.
+ * @param saved  What was restored for a collection.
+ */
+static void
+xmms_collection_dbread_idlist_positions (xmms_medialib_session_t *session,
+                                         coll_saved_t *saved)
+{
+	gchar query[128];
+	GList *res, *n;
+	guint i;
+
+	g_snprintf (query, sizeof (query),
+	            "SELECT position FROM CollectionIdlists "
+	            "WHERE collid=%d ORDER BY position", saved->id);
+
+	res = xmms_medialib_select (session, query, NULL);
+	for (i = 0, n = res; n; i++, n = n->next) {
+		if (value_get_dict_int (n->data, "position") != i) {
+			break;
+		}
+	}
+	g_list_foreach (res, (GFunc) xmmsv_unref, NULL);
+	g_list_free (res);
+
+	if (i < saved->idlist->len) {
+		g_array_set_size (saved->idlist, i);
+	}
+}
+
+/** Write the idlist of the given operator from a position on.
+ *
+ * @param session  The medialib session connected to the DB.
+ * @param collid  The id of the operator.
+ * @param coll  The operator.
+ * @param from  The first position to write.
+ */
+static void
+xmms_collection_dbwrite_idlist (xmms_medialib_session_t *session,
+                                guint collid, xmmsv_coll_t *coll, gint from)
+{
+	gchar query[128];
+	xmmsv_t *idlist;
+	gint i, size;
+	int32_t entry;
+
+	idlist = xmmsv_coll_idlist_get (coll);
+	size = xmmsv_list_get_size (idlist);
+
+	for (i = from; i < size; i++) {
+		xmmsv_list_get_int (idlist, i, &entry);
 		g_snprintf (query, sizeof (query),
 		            "INSERT INTO CollectionIdlists VALUES(%d, %d, %d)",
 		            collid, i, entry);
 
 		xmms_medialib_select (session, query, NULL);
 	}
-	xmmsv_list_iter_explicit_destroy (it);
+}
 
-	/* Save operands and connections (don't recurse in ref operand) */
-	newid = collid + 1;
-	if (xmmsv_coll_get_type (coll) != XMMS_COLLECTION_TYPE_REFERENCE) {
-		xmmsv_t *tmp;
-		xmmsv_list_iter_t *iter;
+/** Write what changed in a collection since it was last saved.
+ *
+ * @param session  The medialib session connected to the DB.
+ * @param saved  What was last written for the collection, updated.
+ * @param coll  The collection as it is now.
+ */
+static void
+xmms_collection_dbwrite_changes (xmms_medialib_session_t *session,
+                                 coll_saved_t *saved, xmmsv_coll_t *coll)
+{
+	gchar query[128];
+	coll_dbwrite_t dbwrite_infos = { session, saved->id, 0, NULL };
+	GString *str;
+	gint i, size;
+	int32_t entry;
 
-		xmmsv_get_list_iter (xmmsv_coll_operands_get (coll), &iter);
+	if (xmmsv_coll_get_type (coll) != saved->type) {
+		saved->type = xmmsv_coll_get_type (coll);
+		g_snprintf (query, sizeof (query),
+		            "UPDATE CollectionOperators SET type=%d WHERE id=%d",
+		            saved->type, saved->id);
+		xmms_medialib_select (session, query, NULL);
+	}
 
-		for (xmmsv_list_iter_first (iter);
-		     xmmsv_list_iter_valid (iter);
-		     xmmsv_list_iter_next (iter)) {
+	str = g_string_new (NULL);
+	coll_signature_attributes (coll, str);
+	if (!g_string_equal (str, saved->attributes)) {
+		g_snprintf (query, sizeof (query),
+		            "DELETE FROM CollectionAttributes WHERE collid=%d",
+		            saved->id);
+		xmms_medialib_select (session, query, NULL);
+		xmmsv_dict_foreach (xmmsv_coll_attributes_get (coll),
+		                    dbwrite_coll_attributes, &dbwrite_infos);
 
-			xmmsv_list_iter_entry (iter, &tmp);
-			xmmsv_get_coll (tmp, &op);
+		g_string_free (saved->attributes, TRUE);
+		saved->attributes = str;
+	} else {
+		g_string_free (str, TRUE);
+	}
 
-			nextid = xmms_collection_dbwrite_operator (session, newid, op);
-			g_snprintf (query, sizeof (query),
-			            "INSERT INTO CollectionConnections VALUES(%d, %d)",
-			            newid, collid);
-			xmms_medialib_select (session, query, NULL);
-			newid = nextid;
+	/* Keep what the idlist still starts with, then drop the rest and
+	 * write the new tail. Appending and truncating touch nothing but
+	 * the difference. */
+	size = xmmsv_coll_idlist_get_size (coll);
+	for (i = 0; i < size && i < saved->idlist->len; i++) {
+		xmmsv_coll_idlist_get_index (coll, i, &entry);
+		if (entry != g_array_index (saved->idlist, int32_t, i)) {
+			break;
 		}
-		xmmsv_list_iter_explicit_destroy (iter);
 	}
 
-	/* return next available id */
-	return newid;
+	if (i < saved->idlist->len || i < size) {
+		g_snprintf (query, sizeof (query),
+		            "DELETE FROM CollectionIdlists "
+		            "WHERE collid=%d AND position>=%d", saved->id, i);
+		xmms_medialib_select (session, query, NULL);
+		xmms_collection_dbwrite_idlist (session, saved->id, coll, i);
+		g_array_free (saved->idlist, TRUE);
+		saved->idlist = coll_idlist_copy (coll);
+	}
+
+	/* Operands are small, rewrite them all if anything changed */
+	str = g_string_new (NULL);
+	coll_signature_operands (coll, str);
+	if (!g_string_equal (str, saved->operands)) {
+		xmms_collection_dbdelete_range (session, saved->operands_first,
+		                                saved->operands_last);
+
+		saved->operands_first = saved_nextid;
+		saved_nextid = xmms_collection_dbwrite_operands (session, saved->id,
+		                                                 coll, saved_nextid);
+		saved->operands_last = saved_nextid;
+
+		g_string_free (saved->operands, TRUE);
+		saved->operands = str;
+	} else {
+		g_string_free (str, TRUE);
+	}
+}
+
+/** Delete the operators with ids in [first, last) from the database,
+ * along with everything that belongs to them.
+ */
+static void
+xmms_collection_dbdelete_range (xmms_medialib_session_t *session,
+                                guint first, guint last)
+{
+	gchar query[128];
+
+	if (first >= last) {
+		return;
+	}
+
+	g_snprintf (query, sizeof (query),
+	            "DELETE FROM CollectionOperators "
+	            "WHERE id>=%d AND id<%d", first, last);
+	xmms_medialib_select (session, query, NULL);
+	g_snprintf (query, sizeof (query),
+	            "DELETE FROM CollectionAttributes "
+	            "WHERE collid>=%d AND collid<%d", first, last);
+	xmms_medialib_select (session, query, NULL);
+	g_snprintf (query, sizeof (query),
+	            "DELETE FROM CollectionIdlists "
+	            "WHERE collid>=%d AND collid<%d", first, last);
+	xmms_medialib_select (session, query, NULL);
+	g_snprintf (query, sizeof (query),
+	            "DELETE FROM CollectionConnections "
+	            "WHERE from_id>=%d AND from_id<%d", first, last);
+	xmms_medialib_select (session, query, NULL);
 }
 
 /* For all label-operator pairs, write the operator and all its
- * operands to the DB recursively. */
+ * operands to the DB recursively, or what changed if it was written
+ * before. */
 static void
 dbwrite_operator (void *key, void *value, void *udata)
 {
@@ -304,20 +617,43 @@ dbwrite_operator (void *key, void *value, void *udata)
 	gchar *label = key;
 	xmmsv_coll_t *coll = value;
 	coll_dbwrite_t *dbinfos = udata;
-	gchar *esc_label;
-	gint serial_id;
-
-	/* Only serialize each operator once, get previous id if exists */
-	if (!xmms_collection_get_int_attr (coll, XMMS_COLLSERIAL_ATTR_ID, &serial_id)) {
-		serial_id = dbinfos->collid;
-		dbinfos->collid = xmms_collection_dbwrite_operator (dbinfos->session,
-		                                                    dbinfos->collid, coll);
-		xmms_collection_set_int_attr (coll, XMMS_COLLSERIAL_ATTR_ID, serial_id);
+	coll_saved_t *saved;
+	gchar *esc_label, *name;
+	guint id;
+
+	/* Only serialize each operator once */
+	saved = g_hash_table_lookup (saved_colls, coll);
+	if (!saved) {
+		id = saved_nextid;
+		saved_nextid = xmms_collection_dbwrite_operator (dbinfos->session,
+		                                                 id, coll);
+		saved = coll_saved_new (coll, id, id + 1, saved_nextid);
+		g_hash_table_insert (saved_colls, xmmsv_coll_ref (coll), saved);
+	} else if (!saved->seen) {
+		xmms_collection_dbwrite_changes (dbinfos->session, saved, coll);
+	}
+	saved->seen = TRUE;
+
+	name = g_strdup_printf ("%d/%s", dbinfos->nsid, label);
+	g_hash_table_insert (dbinfos->labels, name, GUINT_TO_POINTER (saved->id));
+
+	id = GPOINTER_TO_UINT (g_hash_table_lookup (saved_labels, name));
+	if (id == saved->id) {
+		return;
 	}
 
 	esc_label = sqlite_prepare_string (label);
+
+	if (id) {
+		query = g_strdup_printf ("DELETE FROM CollectionLabels "
+		                         "WHERE namespace=%d AND name=%s",
+		                         dbinfos->nsid, esc_label);
+		xmms_medialib_select (dbinfos->session, query, NULL);
+		g_free (query);
+	}
+
 	query = g_strdup_printf ("INSERT INTO CollectionLabels VALUES(%d, %d, %s)",
-	                         serial_id, dbinfos->nsid, esc_label);
+	                         saved->id, dbinfos->nsid, esc_label);
 	xmms_medialib_select (dbinfos->session, query, NULL);
 
 	g_free (query);
@@ -349,12 +685,178 @@ dbwrite_coll_attributes (const char *key, xmmsv_t *value, void *udata)
 	g_free (esc_val);
 }
 
-/* Remove all temp utility properties used to write collections to the DB. */
+/* Mark a saved collection as not written yet in this save. */
 static void
-dbwrite_strip_tmpprops (void *key, void *value, void *udata)
+dbwrite_unseen (gpointer key, gpointer value, gpointer udata)
 {
-	xmmsv_coll_t *coll = value;
-	xmmsv_coll_attribute_remove (coll, XMMS_COLLSERIAL_ATTR_ID);
+	coll_saved_t *saved = value;
+	saved->seen = FALSE;
+}
+
+/* Delete a label that was saved before but is gone now. */
+static void
+dbwrite_removed_label (gpointer key, gpointer value, gpointer udata)
+{
+	coll_dbwrite_t *dbinfos = udata;
+	gchar *query, *esc_label;
+	const gchar *label;
+	gint nsid;
+
+	if (g_hash_table_lookup (dbinfos->labels, key)) {
+		return;
+	}
+
+	nsid = atoi (key);
+	label = strchr (key, '/') + 1;
+
+	esc_label = sqlite_prepare_string (label);
+	query = g_strdup_printf ("DELETE FROM CollectionLabels "
+	                         "WHERE namespace=%d AND name=%s",
+	                         nsid, esc_label);
+	xmms_medialib_select (dbinfos->session, query, NULL);
+
+	g_free (query);
+	g_free (esc_label);
+}
+
+/* Delete a collection that was saved before but has no label left. */
+static gboolean
+dbwrite_removed_coll (gpointer key, gpointer value, gpointer udata)
+{
+	xmms_medialib_session_t *session = udata;
+	coll_saved_t *saved = value;
+
+	if (saved->seen) {
+		return FALSE;
+	}
+
+	xmms_collection_dbdelete_range (session, saved->id, saved->id + 1);
+	xmms_collection_dbdelete_range (session, saved->operands_first,
+	                                saved->operands_last);
+
+	return TRUE;
+}
+
+/* Remember what was written for a collection. */
+static coll_saved_t *
+coll_saved_new (xmmsv_coll_t *coll, guint id, guint first, guint last)
+{
+	coll_saved_t *saved;
+
+	saved = g_new0 (coll_saved_t, 1);
+	saved->id = id;
+	saved->type = xmmsv_coll_get_type (coll);
+	saved->attributes = g_string_new (NULL);
+	coll_signature_attributes (coll, saved->attributes);
+	saved->idlist = coll_idlist_copy (coll);
+	saved->operands = g_string_new (NULL);
+	coll_signature_operands (coll, saved->operands);
+	saved->operands_first = first;
+	saved->operands_last = last;
+
+	return saved;
+}
+
+static void
+coll_saved_free (gpointer data)
+{
+	coll_saved_t *saved = data;
+
+	g_string_free (saved->attributes, TRUE);
+	g_array_free (saved->idlist, TRUE);
+	g_string_free (saved->operands, TRUE);
+	g_free (saved);
+}
+
+static void
+coll_signature_attribute_key (const char *key, xmmsv_t *value, void *udata)
+{
+	GList **keys = udata;
+	*keys = g_list_prepend (*keys, (gpointer) key);
+}
+
+/* Append the attributes of a collection to str in a form that can be
+ * compared, independent of the order they're stored in. */
+static void
+coll_signature_attributes (xmmsv_coll_t *coll, GString *str)
+{
+	xmmsv_t *attrs;
+	GList *keys = NULL, *n;
+	const gchar *s;
+
+	attrs = xmmsv_coll_attributes_get (coll);
+	xmmsv_dict_foreach (attrs, coll_signature_attribute_key, &keys);
+	keys = g_list_sort (keys, (GCompareFunc) strcmp);
+
+	for (n = keys; n; n = n->next) {
+		if (!xmmsv_dict_entry_get_string (attrs, n->data, &s)) {
+			continue;
+		}
+		/* neither can contain a nul byte */
+		g_string_append_len (str, n->data, strlen (n->data) + 1);
+		g_string_append_len (str, s, strlen (s) + 1);
+	}
+
+	g_list_free (keys);
+}
+
+/* Append everything that gets written for the operands of a collection
+ * to str, the way dbwrite_operands walks them. */
+static void
+coll_signature_operands (xmmsv_coll_t *coll, GString *str)
+{
+	xmmsv_list_iter_t *iter;
+	xmmsv_coll_t *op;
+	xmmsv_t *tmp;
+	gint i, size;
+	int32_t entry;
+
+	if (xmmsv_coll_get_type (coll) == XMMS_COLLECTION_TYPE_REFERENCE) {
+		return;
+	}
+
+	xmmsv_get_list_iter (xmmsv_coll_operands_get (coll), &iter);
+
+	for (xmmsv_list_iter_first (iter);
+	     xmmsv_list_iter_valid (iter);
+	     xmmsv_list_iter_next (iter)) {
+
+		xmmsv_list_iter_entry (iter, &tmp);
+		xmmsv_get_coll (tmp, &op);
+
+		g_string_append_printf (str, "(%d", xmmsv_coll_get_type (op));
+		coll_signature_attributes (op, str);
+
+		size = xmmsv_coll_idlist_get_size (op);
+		g_string_append_printf (str, "[%d", size);
+		for (i = 0; i < size; i++) {
+			xmmsv_coll_idlist_get_index (op, i, &entry);
+			g_string_append_printf (str, ",%d", entry);
+		}
+		g_string_append_c (str, ']');
+
+		coll_signature_operands (op, str);
+		g_string_append_c (str, ')');
+	}
+	xmmsv_list_iter_explicit_destroy (iter);
+}
+
+static GArray *
+coll_idlist_copy (xmmsv_coll_t *coll)
+{
+	GArray *idlist;
+	gint i, size;
+	int32_t entry;
+
+	size = xmmsv_coll_idlist_get_size (coll);
+	idlist = g_array_sized_new (FALSE, FALSE, sizeof (int32_t), size);
+
+	for (i = 0; i < size; i++) {
+		xmmsv_coll_idlist_get_index (coll, i, &entry);
+		g_array_append_val (idlist, entry);
+	}
+
+	return idlist;
 }
 
 
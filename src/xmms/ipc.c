@@ -21,6 +21,7 @@
 #include "xmms/xmms_config.h"
 #include "xmmspriv/xmms_thread_name.h"
 #include "xmmspriv/xmms_ipc.h"
+#include "xmmspriv/xmms_stats.h"
 #include "xmmsc/xmmsc_ipc_msg.h"
 
 
@@ -57,40 +58,116 @@ struct xmms_ipc_St {
 };
 
 
+/**
+ * An event loop thread. Clients are spread over a fixed number of
+ * these instead of getting a thread each.
+ */
+typedef struct xmms_ipc_loop_St {
+	GMainContext *context;
+	GMainLoop *ml;
+	GThread *thread;
+} xmms_ipc_loop_t;
+
+
 /**
  * A IPC client representation.
  */
 typedef struct xmms_ipc_client_St {
-	GMainLoop *ml;
+	/** The event loop this client is served by */
+	xmms_ipc_loop_t *loop;
 	GIOChannel *iochan;
 
 	xmms_ipc_transport_t *transport;
 	xmms_ipc_msg_t *read_msg;
 	xmms_ipc_t *ipc;
 
-	/* this lock protects out_msg, pendingsignals and broadcasts,
-	   which can be accessed from other threads than the
-	   client-thread */
+	/* Held by the read watch, the write watch and any command
+	   running in the worker pool. */
+	gint ref;
+
+	/* this lock protects out_msg, jobs, pendingsignals, broadcasts
+	   and disconnected, which can be accessed from other threads
+	   than the loop-thread */
 	GMutex *lock;
 
+	/** Set when the connection is gone, nothing more will be queued */
+	gboolean disconnected;
+
 	/** Messages waiting to be written */
 	GQueue *out_msg;
 
+	/** Commands that came in while one was in the worker pool, run
+	    by that worker in order once it is done */
+	GQueue *jobs;
+	/** Set while a worker is running commands for this client */
+	gboolean in_worker;
+
 	guint pendingsignals[XMMS_IPC_SIGNAL_END];
 	GList *broadcasts[XMMS_IPC_SIGNAL_END];
+
+	/** The part of the transport counters already added to the
+	    ipc.* stats, only touched by the loop-thread */
+	xmms_ipc_transport_stats_t reported;
 } xmms_ipc_client_t;
 
+
+/** commands with an id past this share the per object histogram */
+#define XMMS_IPC_CMD_STATS_MAX 64
+
+static const gchar *ipc_object_names[XMMS_IPC_OBJECT_END] = {
+	"signal", "main", "playlist", "config", "playback", "medialib",
+	"collection", "visualization", "mediainfo_reader", "xform", "bindata"
+};
+
+static xmms_stats_counter_t *ipc_commands;
+static xmms_stats_histogram_t *ipc_command_time;
+static xmms_stats_histogram_t *ipc_worker_wait;
+static xmms_stats_counter_t *ipc_bytes_in;
+static xmms_stats_counter_t *ipc_bytes_out;
+static xmms_stats_counter_t *ipc_msgs_in;
+static xmms_stats_counter_t *ipc_msgs_out;
+static xmms_stats_counter_t *ipc_read_calls;
+static xmms_stats_counter_t *ipc_write_calls;
+/* created the first time a command is called */
+static xmms_stats_histogram_t *ipc_cmd_time[XMMS_IPC_OBJECT_END][XMMS_IPC_CMD_STATS_MAX + 1];
+
+/**
+ * A command that has been handed over to the worker pool.
+ */
+typedef struct xmms_ipc_job_St {
+	xmms_ipc_client_t *client;
+	uint32_t objid;
+	uint32_t cmdid;
+	uint32_t cookie;
+	xmmsv_t *arguments;
+	/** when it was handed over, for the stats */
+	gint64 queued;
+} xmms_ipc_job_t;
+
+#define XMMS_IPC_DEFAULT_THREADS "4"
+#define XMMS_IPC_DEFAULT_WORKERS "4"
+#define XMMS_IPC_MAX_THREADS 64
+
+static xmms_ipc_loop_t *ipc_loops = NULL;
+static guint ipc_loop_count = 0;
+static guint ipc_loop_next = 0;
+
+static GThreadPool *ipc_workers = NULL;
+
 static GMutex *ipc_servers_lock;
 static GList *ipc_servers = NULL;
 
 static GMutex *ipc_object_pool_lock;
 static struct xmms_ipc_object_pool_t *ipc_object_pool = NULL;
 
+static xmms_ipc_client_t *xmms_ipc_client_ref (xmms_ipc_client_t *client);
+static void xmms_ipc_client_unref (xmms_ipc_client_t *client);
 static void xmms_ipc_client_destroy (xmms_ipc_client_t *client);
 
 static void xmms_ipc_register_signal (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg, xmmsv_t *arguments);
 static void xmms_ipc_register_broadcast (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg, xmmsv_t *arguments);
 static gboolean xmms_ipc_client_msg_write (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg);
+static void xmms_ipc_client_write_watch (xmms_ipc_client_t *client, GIOCondition cond);
 
 static void
 xmms_ipc_handle_cmd_value (xmms_ipc_msg_t *msg, xmmsv_t *val)
@@ -163,42 +240,79 @@ xmms_ipc_register_broadcast (xmms_ipc_client_t *client,
 	g_mutex_unlock (client->lock);
 }
 
-static void
-process_msg (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
+/**
+ * Tell whether a command may take long enough to hold up every other
+ * client sharing the event loop. Such commands run in the worker pool.
+ */
+static gboolean
+xmms_ipc_cmd_is_slow (uint32_t objid, uint32_t cmdid)
 {
-	xmms_object_t *object;
-	xmms_object_cmd_arg_t arg;
-	xmms_ipc_msg_t *retmsg;
-	xmmsv_t *error, *arguments;
-	uint32_t objid, cmdid;
-
-	g_return_if_fail (msg);
-
-	objid = xmms_ipc_msg_get_object (msg);
-	cmdid = xmms_ipc_msg_get_cmd (msg);
+	switch (objid) {
+		case XMMS_IPC_OBJECT_MEDIALIB:
+			return cmdid == XMMS_IPC_CMD_PATH_IMPORT ||
+			       cmdid == XMMS_IPC_CMD_REHASH;
+		case XMMS_IPC_OBJECT_COLLECTION:
+			return cmdid == XMMS_IPC_CMD_QUERY_IDS ||
+			       cmdid == XMMS_IPC_CMD_QUERY_INFOS ||
+			       cmdid == XMMS_IPC_CMD_COLLECTION_FIND ||
+			       cmdid == XMMS_IPC_CMD_IDLIST_FROM_PLS;
+		case XMMS_IPC_OBJECT_PLAYLIST:
+			return cmdid == XMMS_IPC_CMD_RADD ||
+			       cmdid == XMMS_IPC_CMD_RINSERT;
+		default:
+			return FALSE;
+	}
+}
 
-	if (!xmms_ipc_msg_get_value (msg, &arguments)) {
-		xmms_log_error ("Cannot read command arguments. "
-		                "Ignoring command.");
+/**
+ * The histogram for the time spent on a command, named after the
+ * object and the command id, like ipc.medialib.33.
+ */
+static xmms_stats_histogram_t *
+xmms_ipc_cmd_stats (uint32_t objid, uint32_t cmdid)
+{
+	xmms_stats_histogram_t *hist;
+	guint index;
+	gchar name[64];
 
-		return;
+	index = cmdid - XMMS_IPC_CMD_FIRST;
+	if (cmdid < XMMS_IPC_CMD_FIRST || index > XMMS_IPC_CMD_STATS_MAX) {
+		index = XMMS_IPC_CMD_STATS_MAX;
 	}
 
-	if (objid == XMMS_IPC_OBJECT_SIGNAL) {
-	    if (cmdid == XMMS_IPC_CMD_SIGNAL) {
-			xmms_ipc_register_signal (client, msg, arguments);
-		} else if (cmdid == XMMS_IPC_CMD_BROADCAST) {
-			xmms_ipc_register_broadcast (client, msg, arguments);
+	hist = g_atomic_pointer_get (&ipc_cmd_time[objid][index]);
+	if (G_UNLIKELY (!hist)) {
+		if (index == XMMS_IPC_CMD_STATS_MAX) {
+			g_snprintf (name, sizeof (name), "ipc.%s.other",
+			            ipc_object_names[objid]);
 		} else {
-			xmms_log_error ("Bad command id (%d) for signal object", cmdid);
+			g_snprintf (name, sizeof (name), "ipc.%s.%u",
+			            ipc_object_names[objid], cmdid);
 		}
-
-		goto out;
+		/* registering twice gives the same histogram */
+		hist = xmms_stats_histogram_register (name);
+		g_atomic_pointer_set (&ipc_cmd_time[objid][index], hist);
 	}
 
+	return hist;
+}
+
+/**
+ * Run a command on its object and queue the reply for the client.
+ */
+static void
+xmms_ipc_client_call (xmms_ipc_client_t *client, uint32_t objid,
+                      uint32_t cmdid, uint32_t cookie, xmmsv_t *arguments)
+{
+	xmms_object_t *object;
+	xmms_object_cmd_arg_t arg;
+	xmms_ipc_msg_t *retmsg;
+	xmmsv_t *error;
+	gint64 start, elapsed;
+
 	if (objid >= XMMS_IPC_OBJECT_END) {
 		xmms_log_error ("Bad object id (%d)", objid);
-		goto out;
+		return;
 	}
 
 	g_mutex_lock (ipc_object_pool_lock);
@@ -206,14 +320,16 @@ process_msg (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
 	g_mutex_unlock (ipc_object_pool_lock);
 	if (!object) {
 		xmms_log_error ("Object %d was not found!", objid);
-		goto out;
+		return;
 	}
 
 	if (!g_tree_lookup (object->cmds, GUINT_TO_POINTER (cmdid))) {
 		xmms_log_error ("No such cmd %d on object %d", cmdid, objid);
-		goto out;
+		return;
 	}
 
+	start = xmms_stats_time ();
+
 	xmms_object_cmd_arg_init (&arg);
 	arg.args = arguments;
 
@@ -241,17 +357,182 @@ process_msg (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
 	if (arg.retval)
 		xmmsv_unref (arg.retval);
 
-	xmms_ipc_msg_set_cookie (retmsg, xmms_ipc_msg_get_cookie (msg));
+	xmms_ipc_msg_set_cookie (retmsg, cookie);
 	g_mutex_lock (client->lock);
 	xmms_ipc_client_msg_write (client, retmsg);
 	g_mutex_unlock (client->lock);
 
+	elapsed = xmms_stats_time () - start;
+	xmms_stats_counter_inc (ipc_commands);
+	xmms_stats_histogram_add (ipc_command_time, elapsed);
+	xmms_stats_histogram_add (xmms_ipc_cmd_stats (objid, cmdid), elapsed);
+}
+
+static xmms_ipc_job_t *
+xmms_ipc_job_new (xmms_ipc_client_t *client, uint32_t objid, uint32_t cmdid,
+                  uint32_t cookie, xmmsv_t *arguments)
+{
+	xmms_ipc_job_t *job;
+
+	job = g_new0 (xmms_ipc_job_t, 1);
+	job->client = xmms_ipc_client_ref (client);
+	job->objid = objid;
+	job->cmdid = cmdid;
+	job->cookie = cookie;
+	job->arguments = arguments;
+	job->queued = xmms_stats_time ();
+
+	return job;
+}
+
+static void
+xmms_ipc_job_free (xmms_ipc_job_t *job)
+{
+	if (job->arguments) {
+		xmmsv_unref (job->arguments);
+	}
+
+	xmms_ipc_client_unref (job->client);
+	g_free (job);
+}
+
+/**
+ * Entry point of the worker pool threads. Runs the slow command it
+ * was handed, and then whatever the client sent after it, so that
+ * the client gets its replies in the order it asked.
+ */
+static void
+xmms_ipc_worker_run (gpointer data, gpointer udata)
+{
+	xmms_ipc_job_t *job = data;
+	xmms_ipc_client_t *client;
+
+	xmms_set_thread_name ("x2 ipc worker");
+
+	client = xmms_ipc_client_ref (job->client);
+
+	while (job) {
+		xmms_stats_histogram_add_since (ipc_worker_wait, job->queued);
+
+		xmms_ipc_client_call (client, job->objid, job->cmdid,
+		                      job->cookie, job->arguments);
+		xmms_ipc_job_free (job);
+
+		g_mutex_lock (client->lock);
+		job = g_queue_pop_head (client->jobs);
+		if (!job) {
+			client->in_worker = FALSE;
+		}
+		g_mutex_unlock (client->lock);
+	}
+
+	xmms_ipc_client_unref (client);
+}
+
+static void
+process_msg (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
+{
+	xmms_ipc_job_t *job;
+	xmmsv_t *arguments;
+	uint32_t objid, cmdid, cookie;
+	gboolean slow;
+
+	g_return_if_fail (msg);
+
+	objid = xmms_ipc_msg_get_object (msg);
+	cmdid = xmms_ipc_msg_get_cmd (msg);
+
+	if (!xmms_ipc_msg_get_value (msg, &arguments)) {
+		xmms_log_error ("Cannot read command arguments. "
+		                "Ignoring command.");
+
+		return;
+	}
+
+	if (objid == XMMS_IPC_OBJECT_SIGNAL) {
+	    if (cmdid == XMMS_IPC_CMD_SIGNAL) {
+			xmms_ipc_register_signal (client, msg, arguments);
+		} else if (cmdid == XMMS_IPC_CMD_BROADCAST) {
+			xmms_ipc_register_broadcast (client, msg, arguments);
+		} else {
+			xmms_log_error ("Bad command id (%d) for signal object", cmdid);
+		}
+
+		goto out;
+	}
+
+	cookie = xmms_ipc_msg_get_cookie (msg);
+	slow = ipc_workers && xmms_ipc_cmd_is_slow (objid, cmdid);
+
+	/* Nothing may overtake a command that is still in the worker
+	 * pool, the commands after it wait for it in the queue. */
+	g_mutex_lock (client->lock);
+	if (client->in_worker || slow) {
+		job = xmms_ipc_job_new (client, objid, cmdid, cookie, arguments);
+		if (client->in_worker) {
+			g_queue_push_tail (client->jobs, job);
+			job = NULL;
+		}
+		client->in_worker = TRUE;
+		g_mutex_unlock (client->lock);
+
+		if (job) {
+			g_thread_pool_push (ipc_workers, job, NULL);
+		}
+		return;
+	}
+	g_mutex_unlock (client->lock);
+
+	xmms_ipc_client_call (client, objid, cmdid, cookie, arguments);
+
 out:
 	if (arguments) {
 		xmmsv_unref (arguments);
 	}
 }
 
+/**
+ * Stop accepting messages for a client that went away and take it
+ * out of the client list, so broadcasts no longer reach it.
+ */
+static void
+xmms_ipc_client_disconnect (xmms_ipc_client_t *client)
+{
+	xmms_ipc_t *ipc;
+
+	g_mutex_lock (client->lock);
+	client->disconnected = TRUE;
+	g_mutex_unlock (client->lock);
+
+	ipc = client->ipc;
+	if (ipc) {
+		g_mutex_lock (ipc->mutex_lock);
+		ipc->clients = g_list_remove (ipc->clients, client);
+		g_mutex_unlock (ipc->mutex_lock);
+		client->ipc = NULL;
+	}
+}
+
+/**
+ * Add what the client's transport has done since the last call to
+ * the ipc.* counters.
+ */
+static void
+xmms_ipc_client_stats_report (xmms_ipc_client_t *client)
+{
+	xmms_ipc_transport_stats_t stats;
+
+	xmms_ipc_transport_stats_get (client->transport, &stats);
+
+	xmms_stats_counter_add (ipc_bytes_in, stats.bytes_in - client->reported.bytes_in);
+	xmms_stats_counter_add (ipc_bytes_out, stats.bytes_out - client->reported.bytes_out);
+	xmms_stats_counter_add (ipc_msgs_in, stats.msgs_in - client->reported.msgs_in);
+	xmms_stats_counter_add (ipc_msgs_out, stats.msgs_out - client->reported.msgs_out);
+	xmms_stats_counter_add (ipc_read_calls, stats.read_calls - client->reported.read_calls);
+	xmms_stats_counter_add (ipc_write_calls, stats.write_calls - client->reported.write_calls);
+
+	client->reported = stats;
+}
 
 static gboolean
 xmms_ipc_client_read_cb (GIOChannel *iochan,
@@ -278,6 +559,8 @@ xmms_ipc_client_read_cb (GIOChannel *iochan,
 				break;
 			}
 		}
+
+		xmms_ipc_client_stats_report (client);
 	}
 
 	if (disconnect || (cond & G_IO_HUP)) {
@@ -286,13 +569,13 @@ xmms_ipc_client_read_cb (GIOChannel *iochan,
 			client->read_msg = NULL;
 		}
 		XMMS_DBG ("disconnect was true!");
-		g_main_loop_quit (client->ml);
+		xmms_ipc_client_disconnect (client);
 		return FALSE;
 	}
 
 	if (cond & G_IO_ERR) {
 		xmms_log_error ("Client got error, maybe connection died?");
-		g_main_loop_quit (client->ml);
+		xmms_ipc_client_disconnect (client);
 		return FALSE;
 	}
 
@@ -309,74 +592,104 @@ xmms_ipc_client_write_cb (GIOChannel *iochan,
 
 	g_return_val_if_fail (client, FALSE);
 
+	if (cond & (G_IO_ERR | G_IO_HUP)) {
+		/* the read watch takes care of the disconnect */
+		return FALSE;
+	}
+
 	while (TRUE) {
-		xmms_ipc_msg_t *msg;
+		xmms_ipc_msg_t *msgs[XMMS_IPC_TRANSPORT_MAX_IOVEC];
+		GList *n;
+		gint i, count = 0, written;
 
+		/* Only this thread removes messages, so the head of the
+		 * queue stays put while it is written without the lock.
+		 */
 		g_mutex_lock (client->lock);
-		msg = g_queue_peek_head (client->out_msg);
+		for (n = client->out_msg->head; n && count < G_N_ELEMENTS (msgs);
+		     n = g_list_next (n)) {
+			msgs[count++] = n->data;
+		}
 		g_mutex_unlock (client->lock);
 
-		if (!msg)
+		if (!count)
 			break;
 
-		if (!xmms_ipc_msg_write_transport (msg,
-		                                   client->transport,
-		                                   &disconnect)) {
+		written = xmms_ipc_msg_write_transport_many (msgs, count,
+		                                             client->transport,
+		                                             &disconnect);
+
+		g_mutex_lock (client->lock);
+		for (i = 0; i < written; i++) {
+			g_queue_pop_head (client->out_msg);
+		}
+		g_mutex_unlock (client->lock);
+
+		for (i = 0; i < written; i++) {
+			xmms_ipc_msg_destroy (msgs[i]);
+		}
+
+		xmms_ipc_client_stats_report (client);
+
+		if (written < count) {
+			GIOCondition want;
+
 			if (disconnect) {
 				break;
+			}
+
+			/* try sending the rest again later, once the peer has
+			 * read some if the socket isn't what is full */
+			if (xmms_ipc_transport_write_blocked (client->transport)) {
+				want = G_IO_IN;
 			} else {
-				/* try sending again later */
-				return TRUE;
+				want = G_IO_OUT;
 			}
-		}
 
-		g_mutex_lock (client->lock);
-		g_queue_pop_head (client->out_msg);
-		g_mutex_unlock (client->lock);
+			if (cond & want) {
+				return TRUE;
+			}
 
-		xmms_ipc_msg_destroy (msg);
+			xmms_ipc_client_write_watch (client, want);
+			return FALSE;
+		}
 	}
 
 	return FALSE;
 }
 
-static gpointer
-xmms_ipc_client_thread (gpointer data)
+/**
+ * Call the write callback when the client's socket gets to cond.
+ */
+static void
+xmms_ipc_client_write_watch (xmms_ipc_client_t *client, GIOCondition cond)
 {
-	xmms_ipc_client_t *client = data;
+	GMainContext *context = client->loop->context;
 	GSource *source;
 
-	xmms_set_thread_name ("x2 client");
-
-	source = g_io_create_watch (client->iochan, G_IO_IN | G_IO_ERR | G_IO_HUP);
+	source = g_io_create_watch (client->iochan, cond | G_IO_ERR | G_IO_HUP);
 	g_source_set_callback (source,
-	                       (GSourceFunc) xmms_ipc_client_read_cb,
-	                       (gpointer) client,
-	                       NULL);
-	g_source_attach (source, g_main_loop_get_context (client->ml));
+	                       (GSourceFunc) xmms_ipc_client_write_cb,
+	                       (gpointer) xmms_ipc_client_ref (client),
+	                       (GDestroyNotify) xmms_ipc_client_unref);
+	g_source_attach (source, context);
 	g_source_unref (source);
 
-	g_main_loop_run (client->ml);
-
-	xmms_ipc_client_destroy (client);
-
-	return NULL;
+	g_main_context_wakeup (context);
 }
 
 static xmms_ipc_client_t *
 xmms_ipc_client_new (xmms_ipc_t *ipc, xmms_ipc_transport_t *transport)
 {
 	xmms_ipc_client_t *client;
-	GMainContext *context;
 	int fd;
 
 	g_return_val_if_fail (transport, NULL);
 
 	client = g_new0 (xmms_ipc_client_t, 1);
 
-	context = g_main_context_new ();
-	client->ml = g_main_loop_new (context, FALSE);
-	g_main_context_unref (context);
+	/* Hand out the event loops round-robin */
+	client->loop = &ipc_loops[ipc_loop_next++ % ipc_loop_count];
 
 	fd = xmms_ipc_transport_fd_get (transport);
 	client->iochan = g_io_channel_unix_new (fd);
@@ -388,28 +701,68 @@ xmms_ipc_client_new (xmms_ipc_t *ipc, xmms_ipc_transport_t *transport)
 	g_io_channel_set_encoding (client->iochan, NULL, NULL);
 	g_io_channel_set_buffered (client->iochan, FALSE);
 
+	client->ref = 1;
 	client->transport = transport;
 	client->ipc = ipc;
 	client->out_msg = g_queue_new ();
+	client->jobs = g_queue_new ();
 	client->lock = g_mutex_new ();
 
 	return client;
 }
 
+/**
+ * Start reading messages from the client on its event loop. The
+ * reference the client was created with is handed over to the
+ * read watch.
+ */
+static void
+xmms_ipc_client_start (xmms_ipc_client_t *client)
+{
+	GSource *source;
+
+	source = g_io_create_watch (client->iochan, G_IO_IN | G_IO_ERR | G_IO_HUP);
+	g_source_set_callback (source,
+	                       (GSourceFunc) xmms_ipc_client_read_cb,
+	                       (gpointer) client,
+	                       (GDestroyNotify) xmms_ipc_client_unref);
+	g_source_attach (source, client->loop->context);
+	g_source_unref (source);
+
+	g_main_context_wakeup (client->loop->context);
+}
+
+static xmms_ipc_client_t *
+xmms_ipc_client_ref (xmms_ipc_client_t *client)
+{
+	g_atomic_int_inc (&client->ref);
+	return client;
+}
+
+static void
+xmms_ipc_client_unref (xmms_ipc_client_t *client)
+{
+	if (g_atomic_int_dec_and_test (&client->ref)) {
+		xmms_ipc_client_destroy (client);
+	}
+}
+
 static void
 xmms_ipc_client_destroy (xmms_ipc_client_t *client)
 {
+	xmms_ipc_transport_stats_t stats;
 	guint i;
 
-	XMMS_DBG ("Destroying client!");
+	xmms_ipc_transport_stats_get (client->transport, &stats);
+	xmms_ipc_client_stats_report (client);
 
-	if (client->ipc) {
-		g_mutex_lock (client->ipc->mutex_lock);
-		client->ipc->clients = g_list_remove (client->ipc->clients, client);
-		g_mutex_unlock (client->ipc->mutex_lock);
-	}
+	XMMS_DBG ("Destroying client! (in: %" G_GUINT64_FORMAT " bytes, %"
+	          G_GUINT64_FORMAT " msgs, %" G_GUINT64_FORMAT " reads; out: %"
+	          G_GUINT64_FORMAT " bytes, %" G_GUINT64_FORMAT " msgs, %"
+	          G_GUINT64_FORMAT " writes)",
+	          stats.bytes_in, stats.msgs_in, stats.read_calls,
+	          stats.bytes_out, stats.msgs_out, stats.write_calls);
 
-	g_main_loop_unref (client->ml);
 	g_io_channel_unref (client->iochan);
 
 	xmms_ipc_transport_destroy (client->transport);
@@ -422,6 +775,9 @@ xmms_ipc_client_destroy (xmms_ipc_client_t *client)
 
 	g_queue_free (client->out_msg);
 
+	/* every queued job holds a reference, so there are none left */
+	g_queue_free (client->jobs);
+
 	for (i = 0; i < XMMS_IPC_SIGNAL_END; i++) {
 		g_list_free (client->broadcasts[i]);
 	}
@@ -458,22 +814,17 @@ xmms_ipc_client_msg_write (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
 	g_return_val_if_fail (client, FALSE);
 	g_return_val_if_fail (msg, FALSE);
 
+	if (client->disconnected) {
+		xmms_ipc_msg_destroy (msg);
+		return FALSE;
+	}
+
 	queue_empty = g_queue_is_empty (client->out_msg);
 	g_queue_push_tail (client->out_msg, msg);
 
 	/* If there's no write in progress, add a new callback */
 	if (queue_empty) {
-		GMainContext *context = g_main_loop_get_context (client->ml);
-		GSource *source = g_io_create_watch (client->iochan, G_IO_OUT);
-
-		g_source_set_callback (source,
-		                       (GSourceFunc) xmms_ipc_client_write_cb,
-		                       (gpointer) client,
-		                       NULL);
-		g_source_attach (source, context);
-		g_source_unref (source);
-
-		g_main_context_wakeup (context);
+		xmms_ipc_client_write_watch (client, G_IO_OUT);
 	}
 
 	return TRUE;
@@ -509,13 +860,74 @@ xmms_ipc_source_accept (GIOChannel *chan, GIOCondition cond, gpointer data)
 	g_mutex_unlock (ipc->mutex_lock);
 
 	/* Now that the client has been registered in the ipc->clients list
-	 * we may safely start its thread.
+	 * we may safely start listening to it.
 	 */
-	g_thread_create (xmms_ipc_client_thread, client, FALSE, NULL);
+	xmms_ipc_client_start (client);
 
 	return TRUE;
 }
 
+static gpointer
+xmms_ipc_loop_thread (gpointer data)
+{
+	xmms_ipc_loop_t *loop = data;
+
+	xmms_set_thread_name ("x2 ipc loop");
+
+	g_main_loop_run (loop->ml);
+
+	return NULL;
+}
+
+/**
+ * Start the event loop threads that serve the clients, and the worker
+ * pool that runs the commands listed in #xmms_ipc_cmd_is_slow.
+ * Both are shared by all IPC servers and are only started once.
+ */
+static void
+xmms_ipc_loops_init (void)
+{
+	xmms_config_property_t *cv;
+	gint i, threads, workers;
+
+	if (ipc_loops) {
+		return;
+	}
+
+	cv = xmms_config_property_register ("core.ipcthreads",
+	                                    XMMS_IPC_DEFAULT_THREADS,
+	                                    NULL, NULL);
+	threads = CLAMP (xmms_config_property_get_int (cv), 1,
+	                 XMMS_IPC_MAX_THREADS);
+
+	cv = xmms_config_property_register ("core.ipcworkers",
+	                                    XMMS_IPC_DEFAULT_WORKERS,
+	                                    NULL, NULL);
+	workers = MIN (xmms_config_property_get_int (cv), XMMS_IPC_MAX_THREADS);
+
+	ipc_loops = g_new0 (xmms_ipc_loop_t, threads);
+
+	for (i = 0; i < threads; i++) {
+		xmms_ipc_loop_t *loop = &ipc_loops[i];
+
+		loop->context = g_main_context_new ();
+		loop->ml = g_main_loop_new (loop->context, FALSE);
+		loop->thread = g_thread_create (xmms_ipc_loop_thread, loop,
+		                                FALSE, NULL);
+	}
+
+	ipc_loop_count = threads;
+
+	/* With no workers, everything runs on the event loops */
+	if (workers > 0) {
+		ipc_workers = g_thread_pool_new (xmms_ipc_worker_run, NULL,
+		                                 workers, FALSE, NULL);
+	}
+
+	XMMS_DBG ("IPC using %d event loops and %d workers.",
+	          threads, MAX (workers, 0));
+}
+
 /**
  * Enable IPC
  */
@@ -725,6 +1137,17 @@ xmms_ipc_init (void)
 	ipc_servers_lock = g_mutex_new ();
 	ipc_object_pool_lock = g_mutex_new ();
 	ipc_object_pool = g_new0 (xmms_ipc_object_pool_t, 1);
+
+	ipc_commands = xmms_stats_counter_register ("ipc.commands");
+	ipc_command_time = xmms_stats_histogram_register ("ipc.command_us");
+	ipc_worker_wait = xmms_stats_histogram_register ("ipc.worker_wait_us");
+	ipc_bytes_in = xmms_stats_counter_register ("ipc.bytes_in");
+	ipc_bytes_out = xmms_stats_counter_register ("ipc.bytes_out");
+	ipc_msgs_in = xmms_stats_counter_register ("ipc.msgs_in");
+	ipc_msgs_out = xmms_stats_counter_register ("ipc.msgs_out");
+	ipc_read_calls = xmms_stats_counter_register ("ipc.read_calls");
+	ipc_write_calls = xmms_stats_counter_register ("ipc.write_calls");
+
 	return NULL;
 }
 
@@ -790,6 +1213,8 @@ xmms_ipc_setup_server (const gchar *path)
 	gint i = 0, num_init = 0;
 	g_return_val_if_fail (path, FALSE);
 
+	xmms_ipc_loops_init ();
+
 	split = g_strsplit (path, ";", 0);
 
 	for (i = 0; split && split[i]; i++) {
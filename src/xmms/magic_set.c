@@ -0,0 +1,829 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Magic byte matching.
+ *
+ * Each xmms_magic_add call produces a tree of tests, and a set of
+ * trees is tried one after another, most complex first, until one of
+ * them matches. To avoid running every tree against every file, the
+ * set also keeps an index over the first byte each top level test
+ * looks at. One lookup per distinct offset then rules out nearly all
+ * trees, and only the remaining candidates are walked, in the same
+ * order as before, so the result is exactly the same.
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "xmms/xmms_log.h"
+#include "xmmspriv/xmms_magic.h"
+
+/** Tests further into the data than this are not indexed */
+#define XMMS_MAGIC_INDEX_MAX_OFFSET 64
+
+#define SWAP16(v, endian) \
+	if (endian == G_LITTLE_ENDIAN) { \
+		v = GUINT16_TO_LE (v); \
+	} else if (endian == G_BIG_ENDIAN) { \
+		v = GUINT16_TO_BE (v); \
+	}
+
+#define SWAP32(v, endian) \
+	if (endian == G_LITTLE_ENDIAN) { \
+		v = GUINT32_TO_LE (v); \
+	} else if (endian == G_BIG_ENDIAN) { \
+		v = GUINT32_TO_BE (v); \
+	}
+
+#define CMP(v1, entry, v2) \
+	if (entry->pre_test_and_op) { \
+		v1 &= entry->pre_test_and_op; \
+	} \
+\
+	switch (entry->oper) { \
+		case XMMS_MAGIC_ENTRY_OPERATOR_EQUAL: \
+			return v1 == v2; \
+		case XMMS_MAGIC_ENTRY_OPERATOR_LESS_THAN: \
+			return v1 < v2; \
+		case XMMS_MAGIC_ENTRY_OPERATOR_GREATER_THAN: \
+			return v1 > v2; \
+		case XMMS_MAGIC_ENTRY_OPERATOR_AND: \
+			return (v1 & v2) == v2; \
+		case XMMS_MAGIC_ENTRY_OPERATOR_NAND: \
+			return (v1 & v2) != v2; \
+	} \
+
+typedef enum xmms_magic_entry_type_St {
+	XMMS_MAGIC_ENTRY_TYPE_UNKNOWN = 0,
+	XMMS_MAGIC_ENTRY_TYPE_BYTE,
+	XMMS_MAGIC_ENTRY_TYPE_INT16,
+	XMMS_MAGIC_ENTRY_TYPE_INT32,
+	XMMS_MAGIC_ENTRY_TYPE_STRING,
+	XMMS_MAGIC_ENTRY_TYPE_STRINGC,
+} xmms_magic_entry_type_t;
+
+typedef enum xmms_magic_entry_operator_St {
+	XMMS_MAGIC_ENTRY_OPERATOR_EQUAL = 0,
+	XMMS_MAGIC_ENTRY_OPERATOR_LESS_THAN,
+	XMMS_MAGIC_ENTRY_OPERATOR_GREATER_THAN,
+	XMMS_MAGIC_ENTRY_OPERATOR_AND,
+	XMMS_MAGIC_ENTRY_OPERATOR_NAND
+} xmms_magic_entry_operator_t;
+
+typedef struct xmms_magic_entry_St {
+	guint offset;
+	xmms_magic_entry_type_t type;
+	gint endian;
+	guint len;
+	guint pre_test_and_op;
+	xmms_magic_entry_operator_t oper;
+
+	union {
+		guint8 i8;
+		guint16 i16;
+		guint32 i32;
+		gchar s[32];
+	} value;
+} xmms_magic_entry_t;
+
+
+/** The trees with a top level test accepting a byte at some offset */
+typedef struct xmms_magic_index_St {
+	guint offset;
+	guint32 *rows; /* 256 bit sets of set->words words each */
+} xmms_magic_index_t;
+
+struct xmms_magic_set_St {
+	GList *list; /* trees, most complex first */
+
+	/* the index, rebuilt whenever a tree is added */
+	GNode **trees; /* the trees in list order */
+	guint n_trees;
+	guint words;
+	guint32 *wild; /* trees that are always candidates */
+	xmms_magic_index_t *index;
+	guint n_index;
+};
+
+static void xmms_magic_tree_free (GNode *tree);
+static guint xmms_magic_complexity (GNode *tree);
+
+static void
+xmms_magic_entry_free (xmms_magic_entry_t *e)
+{
+	g_free (e);
+}
+
+static xmms_magic_entry_type_t
+parse_type (gchar **s, gint *endian)
+{
+	struct {
+		const gchar *string;
+		xmms_magic_entry_type_t type;
+		gint endian;
+	} *t, types[] = {
+		{"byte", XMMS_MAGIC_ENTRY_TYPE_BYTE, G_BYTE_ORDER},
+		{"short", XMMS_MAGIC_ENTRY_TYPE_INT16, G_BYTE_ORDER},
+		{"long", XMMS_MAGIC_ENTRY_TYPE_INT16, G_BYTE_ORDER},
+		{"beshort", XMMS_MAGIC_ENTRY_TYPE_INT16, G_BIG_ENDIAN},
+		{"belong", XMMS_MAGIC_ENTRY_TYPE_INT32, G_BIG_ENDIAN},
+		{"leshort", XMMS_MAGIC_ENTRY_TYPE_INT16, G_LITTLE_ENDIAN},
+		{"lelong", XMMS_MAGIC_ENTRY_TYPE_INT32, G_LITTLE_ENDIAN},
+		{"string/c", XMMS_MAGIC_ENTRY_TYPE_STRINGC, G_BYTE_ORDER},
+		{"string", XMMS_MAGIC_ENTRY_TYPE_STRING, G_BYTE_ORDER},
+		{NULL, XMMS_MAGIC_ENTRY_TYPE_UNKNOWN, G_BYTE_ORDER}
+	};
+
+	for (t = types; t; t++) {
+		int l = t->string ? strlen (t->string) : 0;
+
+		if (!l || !strncmp (*s, t->string, l)) {
+			*s += l;
+			*endian = t->endian;
+
+			return t->type;
+		}
+	}
+
+	g_assert_not_reached ();
+}
+
+
+static xmms_magic_entry_operator_t
+parse_oper (gchar **s)
+{
+	gchar c = **s;
+	struct {
+		gchar c;
+		xmms_magic_entry_operator_t o;
+	} *o, opers[] = {
+		{'=', XMMS_MAGIC_ENTRY_OPERATOR_EQUAL},
+		{'<', XMMS_MAGIC_ENTRY_OPERATOR_LESS_THAN},
+		{'>', XMMS_MAGIC_ENTRY_OPERATOR_GREATER_THAN},
+		{'&', XMMS_MAGIC_ENTRY_OPERATOR_AND},
+		{'^', XMMS_MAGIC_ENTRY_OPERATOR_NAND},
+		{'\0', XMMS_MAGIC_ENTRY_OPERATOR_EQUAL}
+	};
+
+	for (o = opers; o; o++) {
+		if (!o->c) {
+			/* no operator found */
+			return o->o;
+		} else if (c == o->c) {
+			(*s)++; /* skip operator */
+			return o->o;
+		}
+	}
+
+	g_assert_not_reached ();
+}
+
+static gboolean
+parse_pre_test_and_op (xmms_magic_entry_t *entry, gchar **end)
+{
+	gboolean ret = FALSE;
+
+	if (**end == ' ') {
+		(*end)++;
+		return TRUE;
+	}
+
+	switch (entry->type) {
+		case XMMS_MAGIC_ENTRY_TYPE_BYTE:
+		case XMMS_MAGIC_ENTRY_TYPE_INT16:
+		case XMMS_MAGIC_ENTRY_TYPE_INT32:
+			if (**end == '&') {
+				(*end)++;
+				entry->pre_test_and_op = strtoul (*end, end, 0);
+				ret = TRUE;
+			}
+		default:
+			break;
+	}
+
+	return ret;
+}
+
+static xmms_magic_entry_t *
+parse_entry (const gchar *s)
+{
+	xmms_magic_entry_t *entry;
+	gchar *end = NULL;
+
+	entry = g_new0 (xmms_magic_entry_t, 1);
+	entry->endian = G_BYTE_ORDER;
+	entry->oper = XMMS_MAGIC_ENTRY_OPERATOR_EQUAL;
+	entry->offset = strtoul (s, &end, 0);
+
+	end++;
+
+	entry->type = parse_type (&end, &entry->endian);
+	if (entry->type == XMMS_MAGIC_ENTRY_TYPE_UNKNOWN) {
+		g_free (entry);
+		return NULL;
+	}
+
+	if (!parse_pre_test_and_op (entry, &end)) {
+		g_free (entry);
+		return NULL;
+	}
+
+	/* @todo Implement string operators */
+	switch (entry->type) {
+		case XMMS_MAGIC_ENTRY_TYPE_STRING:
+		case XMMS_MAGIC_ENTRY_TYPE_STRINGC:
+			break;
+		default:
+			entry->oper = parse_oper (&end);
+			break;
+	}
+
+	switch (entry->type) {
+		case XMMS_MAGIC_ENTRY_TYPE_BYTE:
+			entry->value.i8 = strtoul (end, &end, 0);
+			entry->len = 1;
+			break;
+		case XMMS_MAGIC_ENTRY_TYPE_INT16:
+			entry->value.i16 = strtoul (end, &end, 0);
+			entry->len = 2;
+			break;
+		case XMMS_MAGIC_ENTRY_TYPE_INT32:
+			entry->value.i32 = strtoul (end, &end, 0);
+			entry->len = 4;
+			break;
+		case XMMS_MAGIC_ENTRY_TYPE_STRING:
+		case XMMS_MAGIC_ENTRY_TYPE_STRINGC:
+			g_strlcpy (entry->value.s, end, sizeof (entry->value.s));
+			entry->len = strlen (entry->value.s);
+			break;
+		default:
+			break; /* won't get here, handled above */
+	}
+
+	return entry;
+}
+
+static gboolean
+free_node (GNode *node, xmms_magic_entry_t *entry)
+{
+	if (G_NODE_IS_ROOT (node)) {
+		gpointer *data = node->data;
+
+		/* this isn't a magic entry, but the description of the tree */
+		g_free (data[0]); /* desc */
+		g_free (data[1]); /* mime */
+		g_free (data);
+	} else {
+		xmms_magic_entry_free (entry);
+	}
+
+	return FALSE; /* continue traversal */
+}
+
+static void
+xmms_magic_tree_free (GNode *tree)
+{
+	g_node_traverse (tree, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+	                 (GNodeTraverseFunc) free_node, NULL);
+}
+
+static GNode *
+xmms_magic_add_node (GNode *tree, const gchar *s, GNode *prev_node)
+{
+	xmms_magic_entry_t *entry;
+	gpointer *data = tree->data;
+	guint indent = 0, prev_indent;
+
+	g_assert (s);
+
+	XMMS_DBG ("adding magic spec to tree '%s'", (gchar *) data[0]);
+
+	/* indent level is number of leading '>' characters */
+	while (*s == '>') {
+		indent++;
+		s++;
+	}
+
+	entry = parse_entry (s);
+	if (!entry) {
+		XMMS_DBG ("cannot parse magic entry");
+		return NULL;
+	}
+
+	if (!indent) {
+		return g_node_append_data (tree, entry);
+	}
+
+	if (!prev_node) {
+		XMMS_DBG ("invalid indent level");
+		xmms_magic_entry_free (entry);
+		return NULL;
+	}
+
+	prev_indent = g_node_depth (prev_node) - 2;
+
+	if (indent > prev_indent) {
+		/* larger jumps are invalid */
+		if (indent != prev_indent + 1) {
+			XMMS_DBG ("invalid indent level");
+			xmms_magic_entry_free (entry);
+			return NULL;
+		}
+
+		return g_node_append_data (prev_node, entry);
+	} else {
+		while (indent < prev_indent) {
+			prev_indent--;
+			prev_node = prev_node->parent;
+		}
+
+		return g_node_insert_after (prev_node->parent, prev_node,
+		                            g_node_new (entry));
+	}
+}
+
+static gboolean
+read_data (xmms_magic_checker_t *c, guint needed)
+{
+	gint tmp;
+
+	/* do we have enough data ready for this check?
+	 * if not, read some more
+	 */
+	if (c->read >= needed) {
+		return TRUE;
+	}
+
+	if (needed > c->alloc) {
+		c->alloc = needed;
+		c->buf = g_realloc (c->buf, c->alloc);
+	}
+
+	tmp = c->read_func (c->udata, c->buf, needed);
+	if (tmp == -1) {
+		return FALSE;
+	}
+
+	c->read = tmp;
+
+	/* couldn't read enough data? */
+	return c->read >= needed;
+}
+
+static gboolean
+byte_match (xmms_magic_entry_t *entry, guint8 i8)
+{
+	CMP (i8, entry, entry->value.i8); /* returns */
+
+	return FALSE;
+}
+
+static gboolean
+node_match (xmms_magic_checker_t *c, GNode *node)
+{
+	xmms_magic_entry_t *entry = node->data;
+	guint needed = entry->offset + entry->len;
+	guint8 i8;
+	guint16 i16;
+	guint32 i32;
+	gchar *ptr;
+
+	/* do we have enough data ready for this check?
+	 * if not, read some more
+	 */
+	if (!read_data (c, needed)) {
+		return FALSE;
+	}
+
+	ptr = &c->buf[entry->offset];
+
+	switch (entry->type) {
+		case XMMS_MAGIC_ENTRY_TYPE_BYTE:
+			memcpy (&i8, ptr, sizeof (i8));
+			CMP (i8, entry, entry->value.i8); /* returns */
+		case XMMS_MAGIC_ENTRY_TYPE_INT16:
+			memcpy (&i16, ptr, sizeof (i16));
+			SWAP16 (i16, entry->endian);
+			CMP (i16, entry, entry->value.i16); /* returns */
+		case XMMS_MAGIC_ENTRY_TYPE_INT32:
+			memcpy (&i32, ptr, sizeof (i32));
+			SWAP32 (i32, entry->endian);
+			CMP (i32, entry, entry->value.i32); /* returns */
+		case XMMS_MAGIC_ENTRY_TYPE_STRING:
+			return !strncmp (ptr, entry->value.s, entry->len);
+		case XMMS_MAGIC_ENTRY_TYPE_STRINGC:
+			return !g_ascii_strncasecmp (ptr, entry->value.s, entry->len);
+		default:
+			return FALSE;
+	}
+}
+
+static gboolean
+tree_match (xmms_magic_checker_t *c, GNode *tree)
+{
+	GNode *n;
+
+	/* empty subtrees match anything */
+	if (!tree->children) {
+		return TRUE;
+	}
+
+	for (n = tree->children; n; n = n->next) {
+		if (node_match (c, n) && tree_match (c, n)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static guint
+xmms_magic_complexity (GNode *tree)
+{
+	return g_node_n_nodes (tree, G_TRAVERSE_ALL);
+}
+
+static gint
+cb_sort_magic_list (GNode *a, GNode *b)
+{
+	guint n1, n2;
+
+	n1 = xmms_magic_complexity (a);
+	n2 = xmms_magic_complexity (b);
+
+	if (n1 > n2) {
+		return -1;
+	} else if (n1 < n2) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+
+/**
+ * Work out whether a test can be decided by looking at the byte at its
+ * offset alone, and if so, whether that byte may pass.
+ *
+ * Multi byte values are judged by the byte stored first, so the test
+ * is only a necessary condition for them; the full test still runs
+ * on every candidate.
+ *
+ * @returns FALSE if the test can't be indexed at all
+ */
+static gboolean
+entry_byte_test (xmms_magic_entry_t *entry, guint8 b, gboolean *pass)
+{
+	guint32 mask, value, shift;
+
+	if (entry->offset >= XMMS_MAGIC_INDEX_MAX_OFFSET) {
+		return FALSE;
+	}
+
+	switch (entry->type) {
+		case XMMS_MAGIC_ENTRY_TYPE_STRING:
+			if (!entry->len) {
+				return FALSE;
+			}
+			*pass = b == (guint8) entry->value.s[0];
+			return TRUE;
+		case XMMS_MAGIC_ENTRY_TYPE_STRINGC:
+			if (!entry->len) {
+				return FALSE;
+			}
+			*pass = g_ascii_tolower (b) == g_ascii_tolower (entry->value.s[0]);
+			return TRUE;
+		case XMMS_MAGIC_ENTRY_TYPE_BYTE:
+			*pass = byte_match (entry, b);
+			return TRUE;
+		case XMMS_MAGIC_ENTRY_TYPE_INT16:
+			value = entry->value.i16;
+			break;
+		case XMMS_MAGIC_ENTRY_TYPE_INT32:
+			value = entry->value.i32;
+			break;
+		default:
+			return FALSE;
+	}
+
+	/* the byte stored first is the least significant one for
+	 * little endian values and the most significant one otherwise */
+	shift = entry->endian == G_LITTLE_ENDIAN ? 0 : (entry->len - 1) * 8;
+	mask = entry->pre_test_and_op ? (entry->pre_test_and_op >> shift) & 0xff : 0xff;
+	value = (value >> shift) & 0xff;
+
+	switch (entry->oper) {
+		case XMMS_MAGIC_ENTRY_OPERATOR_EQUAL:
+			*pass = (b & mask) == value;
+			return TRUE;
+		case XMMS_MAGIC_ENTRY_OPERATOR_AND:
+			*pass = (b & mask & value) == value;
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+static xmms_magic_index_t *
+index_get (xmms_magic_set_t *set, guint offset)
+{
+	xmms_magic_index_t *idx;
+	guint i;
+
+	for (i = 0; i < set->n_index; i++) {
+		if (set->index[i].offset == offset) {
+			return &set->index[i];
+		}
+	}
+
+	set->index = g_renew (xmms_magic_index_t, set->index, set->n_index + 1);
+
+	/* keep the offsets sorted, so data is read front to back */
+	for (i = set->n_index; i > 0 && set->index[i - 1].offset > offset; i--) {
+		set->index[i] = set->index[i - 1];
+	}
+
+	idx = &set->index[i];
+	idx->offset = offset;
+	idx->rows = g_new0 (guint32, 256 * set->words);
+
+	set->n_index++;
+
+	return idx;
+}
+
+static void
+index_clear (xmms_magic_set_t *set)
+{
+	guint i;
+
+	for (i = 0; i < set->n_index; i++) {
+		g_free (set->index[i].rows);
+	}
+
+	g_free (set->index);
+	g_free (set->trees);
+	g_free (set->wild);
+
+	set->index = NULL;
+	set->n_index = 0;
+	set->trees = NULL;
+	set->n_trees = 0;
+	set->wild = NULL;
+}
+
+static void
+index_build (xmms_magic_set_t *set)
+{
+	xmms_magic_index_t *idx;
+	GList *l;
+	GNode *n;
+	gboolean pass;
+	guint i, b;
+
+	index_clear (set);
+
+	set->n_trees = g_list_length (set->list);
+	set->words = (set->n_trees + 31) / 32;
+	set->trees = g_new (GNode *, set->n_trees);
+	set->wild = g_new0 (guint32, set->words);
+
+	for (i = 0, l = set->list; l; l = g_list_next (l), i++) {
+		GNode *tree = l->data;
+		guint32 bit = 1U << (i % 32);
+		guint word = i / 32;
+
+		set->trees[i] = tree;
+
+		/* a tree is a candidate if any of its top level tests
+		 * may pass */
+		for (n = tree->children; n; n = n->next) {
+			xmms_magic_entry_t *entry = n->data;
+
+			if (!entry_byte_test (entry, 0, &pass)) {
+				set->wild[word] |= bit;
+				break;
+			}
+
+			idx = index_get (set, entry->offset);
+			for (b = 0; b < 256; b++) {
+				entry_byte_test (entry, b, &pass);
+				if (pass) {
+					idx->rows[b * set->words + word] |= bit;
+				}
+			}
+		}
+	}
+}
+
+xmms_magic_set_t *
+xmms_magic_set_new (void)
+{
+	return g_new0 (xmms_magic_set_t, 1);
+}
+
+void
+xmms_magic_set_free (xmms_magic_set_t *set)
+{
+	GList *l;
+
+	index_clear (set);
+
+	for (l = set->list; l; l = g_list_next (l)) {
+		xmms_magic_tree_free (l->data);
+	}
+	g_list_free (set->list);
+
+	g_free (set);
+}
+
+gboolean
+xmms_magic_set_add (xmms_magic_set_t *set, const gchar *desc,
+                    const gchar *mime, ...)
+{
+	gboolean ret;
+	va_list ap;
+
+	va_start (ap, mime);
+	ret = xmms_magic_set_add_valist (set, desc, mime, ap);
+	va_end (ap);
+
+	return ret;
+}
+
+gboolean
+xmms_magic_set_add_valist (xmms_magic_set_t *set, const gchar *desc,
+                           const gchar *mime, va_list ap)
+{
+	GNode *tree, *node = NULL;
+	gchar *s, *copy;
+	gpointer *root_props;
+	gboolean ret = TRUE;
+
+	g_return_val_if_fail (set, FALSE);
+	g_return_val_if_fail (desc, FALSE);
+	g_return_val_if_fail (mime, FALSE);
+
+	/* now process the magic specs in the argument list */
+	s = va_arg (ap, gchar *);
+	if (!s) { /* no magic specs passed -> failure */
+		return FALSE;
+	}
+
+	/* root node stores the description and the mimetype */
+	root_props = g_new0 (gpointer, 2);
+	root_props[0] = g_strdup (desc);
+	root_props[1] = g_strdup (mime);
+	tree = g_node_new (root_props);
+
+	do {
+		if (!*s) {
+			ret = FALSE;
+			xmms_log_error ("invalid magic spec: '%s'", s);
+			break;
+		}
+
+		copy = g_strdup (s); /* we need our own copy */
+		node = xmms_magic_add_node (tree, copy, node);
+		g_free (copy);
+
+		if (!node) {
+			xmms_log_error ("invalid magic spec: '%s'", s);
+			ret = FALSE;
+			break;
+		}
+	} while ((s = va_arg (ap, gchar *)));
+
+	/* only add this tree to the list if all spec chunks are valid */
+	if (ret) {
+		set->list = g_list_insert_sorted (set->list, tree,
+		                                  (GCompareFunc) cb_sort_magic_list);
+		index_build (set);
+	} else {
+		xmms_magic_tree_free (tree);
+	}
+
+	return ret;
+}
+
+static const gchar *
+tree_result (GNode *tree, const gchar **desc)
+{
+	gpointer *data = tree->data;
+
+	if (desc) {
+		*desc = data[0];
+	}
+
+	return data[1];
+}
+
+/**
+ * Find the first tree in the set matching the data.
+ *
+ * @param set the magic set
+ * @param c checker reading the data
+ * @param desc if non-NULL, set to the description of the match
+ * @returns the mimetype of the match, or NULL
+ */
+const gchar *
+xmms_magic_set_match (xmms_magic_set_t *set, xmms_magic_checker_t *c,
+                      const gchar **desc)
+{
+	guint32 *candidates, *row, bits;
+	guint i, w;
+
+	g_return_val_if_fail (set, NULL);
+	g_return_val_if_fail (c, NULL);
+
+	if (!set->n_trees) {
+		return NULL;
+	}
+
+	candidates = g_newa (guint32, set->words);
+	memcpy (candidates, set->wild, set->words * sizeof (guint32));
+
+	for (i = 0; i < set->n_index; i++) {
+		xmms_magic_index_t *idx = &set->index[i];
+
+		/* without this byte none of these tests can pass */
+		if (!read_data (c, idx->offset + 1)) {
+			break;
+		}
+
+		row = &idx->rows[(guint8) c->buf[idx->offset] * set->words];
+		for (w = 0; w < set->words; w++) {
+			candidates[w] |= row[w];
+		}
+	}
+
+	for (w = 0; w < set->words; w++) {
+		for (bits = candidates[w]; bits; bits &= bits - 1) {
+			GNode *tree = set->trees[w * 32 + g_bit_nth_lsf (bits, -1)];
+
+			if (tree_match (c, tree)) {
+				return tree_result (tree, desc);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Like #xmms_magic_set_match, but tries every tree in turn without
+ * looking at the index.
+ */
+const gchar *
+xmms_magic_set_match_linear (xmms_magic_set_t *set, xmms_magic_checker_t *c,
+                             const gchar **desc)
+{
+	GList *l;
+
+	g_return_val_if_fail (set, NULL);
+	g_return_val_if_fail (c, NULL);
+
+	/* only one of the contained sets has to match */
+	for (l = set->list; l; l = g_list_next (l)) {
+		if (tree_match (c, l->data)) {
+			return tree_result (l->data, desc);
+		}
+	}
+
+	return NULL;
+}
+
+void
+xmms_magic_checker_init (xmms_magic_checker_t *c, xmms_magic_read_func_t func,
+                         gpointer udata)
+{
+	c->read_func = func;
+	c->udata = udata;
+	c->read = 0;
+	c->alloc = 128; /* start with a 128 bytes buffer */
+	c->buf = g_malloc (c->alloc);
+}
+
+void
+xmms_magic_checker_clear (xmms_magic_checker_t *c)
+{
+	g_free (c->buf);
+	c->buf = NULL;
+	c->alloc = c->read = 0;
+}
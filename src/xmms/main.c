@@ -45,6 +45,7 @@
 #include "xmmspriv/xmms_bindata.h"
 #include "xmmspriv/xmms_utils.h"
 #include "xmmspriv/xmms_visualization.h"
+#include "xmmspriv/xmms_stats.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -90,6 +91,8 @@ struct xmms_main_St {
 	xmms_output_t *output;
 	xmms_visualization_t *vis;
 	time_t starttime;
+	/** timer for the stats broadcast, 0 when turned off */
+	guint stats_source;
 };
 
 typedef struct xmms_main_St xmms_main_t;
@@ -100,28 +103,94 @@ static GMainLoop *mainloop;
 /** The path of the configfile */
 static gchar *conffile = NULL;
 
-/**
- * This returns the main stats for the server
- */
+static void
+xmms_main_stats_insert (const gchar *name, xmmsv_t *value, gpointer udata)
+{
+	g_tree_insert ((GTree *) udata, (gpointer) name, xmmsv_ref (value));
+}
+
 static GTree *
-xmms_main_client_stats (xmms_object_t *object, xmms_error_t *error)
+xmms_main_stats_tree (xmms_main_t *mainobj)
 {
 	GTree *ret;
 	gint starttime;
+	guint hits, misses, saved;
 
 	ret = g_tree_new_full ((GCompareDataFunc) strcmp, NULL,
 	                       NULL, (GDestroyNotify) xmmsv_unref);
 
-	starttime = ((xmms_main_t*)object)->starttime;
+	starttime = mainobj->starttime;
 
 	g_tree_insert (ret, (gpointer) "version",
 	               xmmsv_new_string (XMMS_VERSION));
 	g_tree_insert (ret, (gpointer) "uptime",
 	               xmmsv_new_int (time (NULL) - starttime));
 
+	xmms_xform_route_stats_get (&hits, &misses, &saved);
+	g_tree_insert (ret, (gpointer) "xform_route_hits",
+	               xmmsv_new_int (MIN (hits, G_MAXINT32)));
+	g_tree_insert (ret, (gpointer) "xform_route_misses",
+	               xmmsv_new_int (MIN (misses, G_MAXINT32)));
+	g_tree_insert (ret, (gpointer) "xform_route_saved_ms",
+	               xmmsv_new_int (saved));
+
+	/* counters and histograms from all over the server */
+	xmms_stats_foreach (xmms_main_stats_insert, ret);
+
 	return ret;
 }
 
+/**
+ * This returns the main stats for the server
+ */
+static GTree *
+xmms_main_client_stats (xmms_object_t *object, xmms_error_t *error)
+{
+	return xmms_main_stats_tree ((xmms_main_t *) object);
+}
+
+static gboolean
+xmms_main_stats_broadcast (gpointer data)
+{
+	xmms_main_t *mainobj = (xmms_main_t *) data;
+	GTree *stats;
+
+	stats = xmms_main_stats_tree (mainobj);
+	xmms_object_emit_f (XMMS_OBJECT (mainobj), XMMS_IPC_SIGNAL_MAIN_STATS,
+	                    XMMSV_TYPE_DICT, stats);
+	g_tree_destroy (stats);
+
+	return TRUE;
+}
+
+/**
+ * (Re)start broadcasting the stats every interval seconds, or stop if
+ * it is 0.
+ */
+static void
+xmms_main_stats_interval_set (xmms_main_t *mainobj, gint interval)
+{
+	if (mainobj->stats_source) {
+		g_source_remove (mainobj->stats_source);
+		mainobj->stats_source = 0;
+	}
+
+	if (interval > 0) {
+		mainobj->stats_source = g_timeout_add (interval * 1000,
+		                                       xmms_main_stats_broadcast,
+		                                       mainobj);
+	}
+}
+
+static void
+change_stats_interval (xmms_object_t *object, xmmsv_t *_data, gpointer userdata)
+{
+	xmms_config_property_t *cv = (xmms_config_property_t *) object;
+
+	xmms_main_stats_interval_set ((xmms_main_t *) userdata,
+	                              xmms_config_property_get_int (cv));
+}
+
 static gboolean
 xmms_main_client_list_foreach (xmms_plugin_t *plugin, gpointer data)
 {
@@ -274,6 +343,10 @@ xmms_main_destroy (xmms_object_t *object)
 	cv = xmms_config_lookup ("core.shutdownpath");
 	do_scriptdir (xmms_config_property_get_string (cv), "stop");
 
+	if (mainobj->stats_source) {
+		g_source_remove (mainobj->stats_source);
+	}
+
 	/* stop output */
 	xmms_object_cmd_arg_init (&arg);
 	arg.args = xmmsv_new_list ();
@@ -505,6 +578,8 @@ main (int argc, char **argv)
 
 	g_thread_init (NULL);
 
+	xmms_stats_init ();
+
 	g_random_set_seed (time (NULL));
 
 	xmms_log_init (loglevel);
@@ -583,6 +658,11 @@ main (int argc, char **argv)
 	/* Save the time we started in order to count uptime */
 	mainobj->starttime = time (NULL);
 
+	/* Seconds between stats broadcasts, 0 turns them off */
+	cv = xmms_config_property_register ("core.stats_interval", "0",
+	                                    change_stats_interval, mainobj);
+	xmms_main_stats_interval_set (mainobj, xmms_config_property_get_int (cv));
+
 	/* Dirty hack to tell XMMS_PATH a valid path */
 	g_strlcpy (default_path, ipcpath, sizeof (default_path));
 
@@ -30,6 +30,7 @@
 #include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_xform.h"
 #include "xmmspriv/xmms_thread_name.h"
+#include "xmmspriv/xmms_stats.h"
 
 
 #include <glib.h>
@@ -52,6 +53,11 @@ struct xmms_mediainfo_reader_St {
 	GCond *cond;
 
 	gboolean running;
+
+	/** entries waiting to be read, as of the last count */
+	xmms_stats_counter_t *unresolved;
+	xmms_stats_counter_t *resolved;
+	xmms_stats_counter_t *failed;
 };
 
 static void xmms_mediainfo_reader_stop (xmms_object_t *o);
@@ -76,6 +82,11 @@ xmms_mediainfo_reader_start (void)
 	mrt->mutex = g_mutex_new ();
 	mrt->cond = g_cond_new ();
 	mrt->running = TRUE;
+
+	mrt->unresolved = xmms_stats_counter_register ("mediainfo.unresolved");
+	mrt->resolved = xmms_stats_counter_register ("mediainfo.resolved");
+	mrt->failed = xmms_stats_counter_register ("mediainfo.failed");
+
 	mrt->thread = g_thread_create (xmms_mediainfo_reader_thread, mrt, TRUE, NULL);
 
 	return mrt;
@@ -157,13 +168,18 @@ xmms_mediainfo_reader_thread (gpointer data)
 		if (!entry) {
 			xmms_medialib_end (session);
 
+			xmms_stats_counter_set (mrt->unresolved, 0);
+
 			xmms_object_emit_f (XMMS_OBJECT (mrt),
 			                    XMMS_IPC_SIGNAL_MEDIAINFO_READER_STATUS,
 			                    XMMSV_TYPE_INT32,
 			                    XMMS_MEDIAINFO_READER_STATUS_IDLE);
 
+			/* don't miss a stop that came in since the loop checked */
 			g_mutex_lock (mrt->mutex);
-			g_cond_wait (mrt->cond, mrt->mutex);
+			if (mrt->running) {
+				g_cond_wait (mrt->cond, mrt->mutex);
+			}
 			g_mutex_unlock (mrt->mutex);
 
 			num = 0;
@@ -181,10 +197,13 @@ xmms_mediainfo_reader_thread (gpointer data)
 		lmod = xmms_medialib_entry_property_get_int (session, entry, XMMS_MEDIALIB_ENTRY_PROPERTY_LMOD);
 
 		if (num == 0) {
+			guint unresolved = xmms_medialib_num_not_resolved (session);
+
 			xmms_object_emit_f (XMMS_OBJECT (mrt),
 			                    XMMS_IPC_SIGNAL_MEDIAINFO_READER_UNINDEXED,
 			                    XMMSV_TYPE_INT32,
-			                    xmms_medialib_num_not_resolved (session));
+			                    unresolved);
+			xmms_stats_counter_set (mrt->unresolved, unresolved);
 			num = 10;
 		} else {
 			num--;
@@ -194,6 +213,8 @@ xmms_mediainfo_reader_thread (gpointer data)
 		xform = xmms_xform_chain_setup (entry, goal_format, TRUE);
 
 		if (!xform) {
+			xmms_stats_counter_inc (mrt->failed);
+
 			if (prev_status == XMMS_MEDIALIB_ENTRY_STATUS_NEW) {
 				xmms_medialib_entry_remove (entry);
 			} else {
@@ -206,6 +227,7 @@ xmms_mediainfo_reader_thread (gpointer data)
 		}
 
 		xmms_object_unref (xform);
+		xmms_stats_counter_inc (mrt->resolved);
 		g_get_current_time (&timeval);
 
 		session = xmms_medialib_begin_write ();
@@ -18,6 +18,7 @@
 #include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_xform.h"
 #include "xmmspriv/xmms_utils.h"
+#include "xmmspriv/xmms_stats.h"
 #include "xmms/xmms_error.h"
 #include "xmms/xmms_config.h"
 #include "xmms/xmms_object.h"
@@ -75,6 +76,15 @@ struct xmms_medialib_St {
 
 	GMutex *source_lock;
 	GHashTable *sources;
+
+	/** protects the property change stamps */
+	GMutex *stamp_lock;
+	/** property name -> stamp of its last change */
+	GHashTable *stamps;
+	/** stamp of the last change to any property */
+	guint32 stamp;
+	/** stamp of the last change that may have hit every property */
+	guint32 stamp_all;
 };
 
 /**
@@ -123,6 +133,9 @@ static GMutex *global_medialib_session_mutex;
 static GMutex *xmms_medialib_debug_mutex;
 static GHashTable *xmms_medialib_debug_hash;
 
+/** Time spent getting hold of the database for writing */
+static xmms_stats_histogram_t *write_begin_time;
+
 static void
 xmms_medialib_destroy (xmms_object_t *object)
 {
@@ -133,6 +146,8 @@ xmms_medialib_destroy (xmms_object_t *object)
 	}
 	g_mutex_free (mlib->source_lock);
 	g_hash_table_destroy (mlib->sources);
+	g_mutex_free (mlib->stamp_lock);
+	g_hash_table_destroy (mlib->stamps);
 	g_mutex_free (global_medialib_session_mutex);
 
 	xmms_medialib_unregister_ipc_commands ();
@@ -329,6 +344,8 @@ xmms_medialib_init (xmms_playlist_t *playlist)
 	xmms_config_property_register ("medialib.analyze_on_startup", "0", NULL, NULL);
 	xmms_config_property_register ("medialib.allow_remote_fs",
 	                               "0", NULL, NULL);
+	/* Index artist, album, title and url for faster MATCH searches */
+	xmms_config_property_register ("medialib.text_index", "1", NULL, NULL);
 
 	g_free (path);
 
@@ -352,12 +369,18 @@ xmms_medialib_init (xmms_playlist_t *playlist)
 
 	global_medialib_session_mutex = g_mutex_new ();
 
+	write_begin_time = xmms_stats_histogram_register ("medialib.write_begin_us");
+
 	/**
 	 * this dummy just wants to put the default song in the playlist
 	 */
 	medialib->source_lock = g_mutex_new ();
 	medialib->sources = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
 
+	medialib->stamp_lock = g_mutex_new ();
+	medialib->stamps = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                          g_free, NULL);
+
 	session = xmms_medialib_begin_write ();
 	sqlite3_exec (session->sql, "SELECT id, source FROM Sources",
 	              add_to_source, medialib->sources, NULL);
@@ -410,10 +433,14 @@ _xmms_medialib_begin (gboolean write, const char *file, int line)
 	session->write = write;
 
 	if (write) {
+		gint64 start = xmms_stats_time ();
+
 		/* Start a exclusive transaction */
 		if (!xmms_sqlite_exec (session->sql, "BEGIN EXCLUSIVE TRANSACTION")) {
 			xmms_log_error ("transaction failed!");
 		}
+
+		xmms_stats_histogram_add_since (write_begin_time, start);
 	}
 
 	session->next_id = -1;
@@ -602,6 +629,8 @@ xmms_medialib_entry_property_set_int_source (xmms_medialib_session_t *session,
 	                        "(%d, '%d', %d, %Q, %d)",
 	                        entry, value, value, property, source);
 
+	xmms_medialib_property_changed (property);
+
 	return ret;
 
 }
@@ -657,6 +686,8 @@ xmms_medialib_entry_property_set_str_source (xmms_medialib_session_t *session,
 	                        "(%d, %Q, NULL, %Q, %d)",
 	                        entry, value, property, source);
 
+	xmms_medialib_property_changed (property);
+
 	return ret;
 
 }
@@ -678,6 +709,60 @@ xmms_medialib_entry_send_update (xmms_medialib_entry_t entry)
 	                    XMMSV_TYPE_INT32, entry);
 }
 
+/**
+ * Note that a property changed, for any entry. This is what
+ * xmms_medialib_property_stamp reports, callers setting properties
+ * through the functions here don't need to bother.
+ *
+ * @param property The property that changed, or NULL if any of them
+ * may have.
+ */
+void
+xmms_medialib_property_changed (const gchar *property)
+{
+	g_mutex_lock (medialib->stamp_lock);
+
+	medialib->stamp++;
+	if (property) {
+		g_hash_table_replace (medialib->stamps, g_strdup (property),
+		                      GUINT_TO_POINTER (medialib->stamp));
+	} else {
+		medialib->stamp_all = medialib->stamp;
+	}
+
+	g_mutex_unlock (medialib->stamp_lock);
+}
+
+/**
+ * Get the stamp of the last change to a property, of any entry.
+ * Stamps only ever grow. Anything derived from the property, read
+ * after getting the stamp of the last change to any property, stays
+ * valid as long as the stamp of the property is no larger than that.
+ *
+ * @param property The property, or NULL for the last change to any
+ * property.
+ * @returns The stamp.
+ */
+guint32
+xmms_medialib_property_stamp (const gchar *property)
+{
+	guint32 ret;
+
+	g_mutex_lock (medialib->stamp_lock);
+
+	if (property) {
+		ret = GPOINTER_TO_UINT (g_hash_table_lookup (medialib->stamps,
+		                                             property));
+		ret = MAX (ret, medialib->stamp_all);
+	} else {
+		ret = medialib->stamp;
+	}
+
+	g_mutex_unlock (medialib->stamp_lock);
+
+	return ret;
+}
+
 /**
  * Trigger an added siginal to the client. This should be
  * called when a new entry has been added to the medialib
@@ -715,6 +800,8 @@ xmms_medialib_entry_remove (xmms_medialib_entry_t entry)
 	xmms_sqlite_exec (session->sql, "DELETE FROM Media WHERE id=%d", entry);
 	xmms_medialib_end (session);
 
+	xmms_medialib_property_changed (NULL);
+
 	/** @todo safe ? */
 	xmms_playlist_remove_by_entry (medialib->playlist, entry);
 }
@@ -819,6 +906,7 @@ xmms_medialib_entry_cleanup (xmms_medialib_session_t *session,
 	                   "AND source != 'plugin/playlist')",
 	                  entry);
 
+	xmms_medialib_property_changed (NULL);
 }
 
 static void
@@ -847,6 +935,8 @@ xmms_medialib_client_rehash (xmms_medialib_t *medialib, gint32 id, xmms_error_t
 
 	xmms_medialib_end (session);
 
+	xmms_medialib_property_changed (XMMS_MEDIALIB_ENTRY_PROPERTY_STATUS);
+
 	mr = xmms_playlist_mediainfo_reader_get (medialib->playlist);
 	xmms_mediainfo_reader_wakeup (mr);
 
@@ -937,6 +1027,8 @@ xmms_medialib_entry_new_insert (xmms_medialib_session_t *session,
 		return 0;
 	}
 
+	xmms_medialib_property_changed (XMMS_MEDIALIB_ENTRY_PROPERTY_URL);
+
 	xmms_medialib_entry_status_set (session, id, XMMS_MEDIALIB_ENTRY_STATUS_NEW);
 	mr = xmms_playlist_mediainfo_reader_get (medialib->playlist);
 	xmms_mediainfo_reader_wakeup (mr);
@@ -1350,6 +1442,8 @@ xmms_medialib_property_remove (xmms_medialib_t *medialib, gint32 entry,
 	                  sourceid, key, entry);
 	xmms_medialib_end (session);
 
+	xmms_medialib_property_changed (key);
+
 	xmms_medialib_entry_send_update (entry);
 }
 
@@ -30,6 +30,7 @@
 #include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_outputplugin.h"
 #include "xmmspriv/xmms_thread_name.h"
+#include "xmmspriv/xmms_stats.h"
 #include "xmms/xmms_log.h"
 #include "xmms/xmms_ipc.h"
 #include "xmms/xmms_object.h"
@@ -148,6 +149,10 @@ struct xmms_output_St {
 	 */
 	gint32 buffer_underruns;
 
+	/** the same, and the bytes that were missing, for main.stats */
+	xmms_stats_counter_t *underrun_stats;
+	xmms_stats_counter_t *underrun_bytes_stats;
+
 	GThread *monitor_volume_thread;
 	gboolean monitor_volume_running;
 };
@@ -551,6 +556,8 @@ xmms_output_read (xmms_output_t *output, char *buffer, gint len)
 			xmms_log_error ("***********************************");
 		}
 		output->buffer_underruns++;
+		xmms_stats_counter_inc (output->underrun_stats);
+		xmms_stats_counter_add (output->underrun_bytes_stats, len - ret);
 	}
 
 	output->bytes_written += ret;
@@ -942,6 +949,9 @@ xmms_output_new (xmms_output_plugin_t *plugin, xmms_playlist_t *playlist)
 	output->status_mutex = g_mutex_new ();
 	output->playtime_mutex = g_mutex_new ();
 
+	output->underrun_stats = xmms_stats_counter_register ("output.underruns");
+	output->underrun_bytes_stats = xmms_stats_counter_register ("output.underrun_bytes");
+
 	prop = xmms_config_property_register ("output.buffersize", "32768", NULL, NULL);
 	size = xmms_config_property_get_int (prop);
 	XMMS_DBG ("Using buffersize %d", size);
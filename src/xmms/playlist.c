@@ -32,6 +32,7 @@
 #include "xmms/xmms_config.h"
 #include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_collection.h"
+#include "xmmspriv/xmms_collindex.h"
 #include "xmms/xmms_log.h"
 /*
 #include "xmms/plsplugins.h"
@@ -604,6 +605,7 @@ static gboolean
 xmms_playlist_remove_unlocked (xmms_playlist_t *playlist, const gchar *plname,
                                xmmsv_coll_t *plcoll, guint pos, xmms_error_t *err)
 {
+	xmms_medialib_entry_t entry;
 	gint currpos;
 	GTree *dict;
 
@@ -611,11 +613,14 @@ xmms_playlist_remove_unlocked (xmms_playlist_t *playlist, const gchar *plname,
 
 	currpos = xmms_playlist_coll_get_currpos (plcoll);
 
-	if (!xmmsv_coll_idlist_remove (plcoll, pos)) {
+	if (!xmmsv_coll_idlist_get_index (plcoll, pos, &entry) ||
+	    !xmmsv_coll_idlist_remove (plcoll, pos)) {
 		if (err) xmms_error_set (err, XMMS_ERROR_NOENT, "Entry was not in list!");
 		return FALSE;
 	}
 
+	xmms_coll_index_remove (plcoll, entry);
+
 	dict = xmms_playlist_changed_msg_new (playlist, XMMS_PLAYLIST_CHANGED_REMOVE, 0, plname);
 	g_tree_insert (dict, (gpointer) "position", xmmsv_new_int (pos));
 	xmms_playlist_changed_msg_send (playlist, dict);
@@ -909,6 +914,7 @@ xmms_playlist_insert_entry (xmms_playlist_t *playlist, const gchar *plname,
 		return;
 	}
 	xmmsv_coll_idlist_insert (plcoll, pos, file);
+	xmms_coll_index_add (plcoll, file);
 
 	/** propagate the MID ! */
 	dict = xmms_playlist_changed_msg_new (playlist, XMMS_PLAYLIST_CHANGED_INSERT, file, plname);
@@ -1090,6 +1096,7 @@ xmms_playlist_add_entry_unlocked (xmms_playlist_t *playlist,
 
 	prev_size = xmms_playlist_coll_get_size (plcoll);
 	xmmsv_coll_idlist_append (plcoll, file);
+	xmms_coll_index_add (plcoll, file);
 
 	/** propagate the MID ! */
 	dict = xmms_playlist_changed_msg_new (playlist, XMMS_PLAYLIST_CHANGED_ADD, file, plname);
@@ -1115,6 +1122,7 @@ xmms_playlist_client_clear (xmms_playlist_t *playlist, const gchar *plname,
 	}
 
 	xmmsv_coll_idlist_clear (plcoll);
+	xmms_coll_index_invalidate (plcoll);
 	xmms_collection_set_int_attr (plcoll, "position", -1);
 
 	XMMS_PLAYLIST_CHANGED_MSG (XMMS_PLAYLIST_CHANGED_CLEAR, 0, plname);
@@ -1551,6 +1559,15 @@ xmms_playlist_mediainfo_reader_get (xmms_playlist_t *playlist)
 	return playlist->mediainfordr;
 }
 
+/** returns pointer to the collection DAG. */
+xmms_coll_dag_t *
+xmms_playlist_colldag_get (xmms_playlist_t *playlist)
+{
+	g_return_val_if_fail (playlist, NULL);
+
+	return playlist->colldag;
+}
+
 /** @} */
 
 /** Free the playlist and other memory in the xmms_playlist_t
@@ -49,7 +49,6 @@ static GList *xmms_plugin_list;
  * Function prototypes
  */
 static gboolean xmms_plugin_setup (xmms_plugin_t *plugin, const xmms_plugin_desc_t *desc);
-static gboolean xmms_plugin_load (const xmms_plugin_desc_t *desc, GModule *module);
 static gboolean xmms_plugin_scan_directory (const gchar *dir);
 
 /*
@@ -265,7 +264,13 @@ xmms_plugin_shutdown ()
 }
 
 
-static gboolean
+/**
+ * Load a plugin from its descriptor. Used for the builtin plugins,
+ * module is NULL for those, and for every plugin found on disk.
+ *
+ * @returns TRUE if the plugin was set up and registered
+ */
+gboolean
 xmms_plugin_load (const xmms_plugin_desc_t *desc, GModule *module)
 {
 	xmms_plugin_t *plugin;
@@ -0,0 +1,361 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Background read-ahead for transports.
+ *
+ * The buffer is a ring holding the stream bytes [base, end), the
+ * reader is somewhere in between. The thread keeps reading until
+ * the reader is 3/4 of the buffer behind, the rest is what was
+ * read last and lets short seeks backwards be served from the
+ * buffer as well.
+ */
+
+#include <string.h>
+
+#include "xmms/xmms_readahead.h"
+#include "xmms/xmms_log.h"
+
+struct xmms_readahead_St {
+	GMutex *mutex;
+	GCond *cond;
+	GThread *thread;
+
+	xmms_readahead_read_func_t read_func;
+	xmms_readahead_seek_func_t seek_func;
+	gpointer udata;
+
+	guchar *buffer;
+	gint size;
+	/** bytes asked of the transport at a time */
+	gint chunk;
+	/** how far ahead of the reader the thread fills the buffer */
+	gint ahead;
+
+	gint64 base;
+	gint64 end;
+	gint64 pos;
+	gint64 length;
+
+	gboolean running;
+	gboolean eos;
+	gboolean failed;
+	xmms_error_t error;
+
+	/** a seek the thread has to do on the transport */
+	gboolean seek_pending;
+	gint64 seek_offset;
+	xmms_xform_seek_mode_t seek_whence;
+	gint64 seek_result;
+	xmms_error_t seek_error;
+
+	guint reads;
+	guint seeks;
+	guint buffered_seeks;
+	guint stalls;
+};
+
+static gpointer xmms_readahead_thread (gpointer udata);
+
+/**
+ * Start reading ahead on a transport.
+ *
+ * @param read_func function reading from the transport
+ * @param seek_func function seeking the transport, or NULL if it
+ * can't seek
+ * @param udata passed to read_func and seek_func
+ * @param offset the current offset of the transport
+ * @param length the length of the stream, or -1 if unknown
+ * @param size how many bytes to buffer
+ * @returns a new read-ahead, or NULL if the thread couldn't be started
+ */
+xmms_readahead_t *
+xmms_readahead_new (xmms_readahead_read_func_t read_func,
+                    xmms_readahead_seek_func_t seek_func,
+                    gpointer udata, gint64 offset, gint64 length, gint size)
+{
+	xmms_readahead_t *ra;
+
+	g_return_val_if_fail (read_func, NULL);
+	g_return_val_if_fail (size > 0, NULL);
+
+	ra = g_new0 (xmms_readahead_t, 1);
+	ra->read_func = read_func;
+	ra->seek_func = seek_func;
+	ra->udata = udata;
+
+	ra->size = size;
+	ra->chunk = MAX (size / 4, 1);
+	ra->ahead = MAX (size / 4 * 3, 1);
+	ra->buffer = g_malloc (size);
+
+	ra->base = ra->end = ra->pos = offset;
+	ra->length = length;
+
+	xmms_error_reset (&ra->error);
+
+	ra->mutex = g_mutex_new ();
+	ra->cond = g_cond_new ();
+	ra->running = TRUE;
+
+	ra->thread = g_thread_create (xmms_readahead_thread, ra, TRUE, NULL);
+	if (!ra->thread) {
+		xmms_log_error ("Could not start read-ahead thread");
+		g_cond_free (ra->cond);
+		g_mutex_free (ra->mutex);
+		g_free (ra->buffer);
+		g_free (ra);
+		return NULL;
+	}
+
+	return ra;
+}
+
+/**
+ * Stop the read-ahead thread and free the buffer. Waits for a
+ * transport call in progress to return.
+ */
+void
+xmms_readahead_free (xmms_readahead_t *ra)
+{
+	g_return_if_fail (ra);
+
+	g_mutex_lock (ra->mutex);
+	ra->running = FALSE;
+	g_cond_broadcast (ra->cond);
+	g_mutex_unlock (ra->mutex);
+
+	g_thread_join (ra->thread);
+
+	XMMS_DBG ("Read-ahead: %u reads, %u seeks, %u seeks from buffer, "
+	          "%u stalls", ra->reads, ra->seeks, ra->buffered_seeks,
+	          ra->stalls);
+
+	g_cond_free (ra->cond);
+	g_mutex_free (ra->mutex);
+	g_free (ra->buffer);
+	g_free (ra);
+}
+
+/**
+ * Read from the buffer, waiting for the thread if it's empty.
+ *
+ * @returns number of bytes read, 0 on end of stream and -1 on error.
+ */
+gint
+xmms_readahead_read (xmms_readahead_t *ra, gpointer buf, gint len,
+                     xmms_error_t *err)
+{
+	gint ret, off, n;
+
+	g_return_val_if_fail (ra, -1);
+	g_return_val_if_fail (buf, -1);
+
+	g_mutex_lock (ra->mutex);
+
+	if (ra->pos == ra->end && !ra->eos && !ra->failed) {
+		ra->stalls++;
+		while (ra->pos == ra->end && !ra->eos && !ra->failed) {
+			g_cond_wait (ra->cond, ra->mutex);
+		}
+	}
+
+	if (ra->pos < ra->end) {
+		ret = MIN (len, ra->end - ra->pos);
+
+		off = ra->pos % ra->size;
+		n = MIN (ret, ra->size - off);
+		memcpy (buf, ra->buffer + off, n);
+		memcpy ((guchar *) buf + n, ra->buffer, ret - n);
+
+		ra->pos += ret;
+		g_cond_broadcast (ra->cond);
+	} else if (ra->failed) {
+		*err = ra->error;
+		ret = -1;
+	} else {
+		ret = 0;
+	}
+
+	g_mutex_unlock (ra->mutex);
+
+	return ret;
+}
+
+/**
+ * Seek in the stream. Seeks within the buffer are handled right away,
+ * others wait for the thread to seek the transport and start over.
+ *
+ * @returns the new offset, or -1 on error.
+ */
+gint64
+xmms_readahead_seek (xmms_readahead_t *ra, gint64 offset,
+                     xmms_xform_seek_mode_t whence, xmms_error_t *err)
+{
+	gint64 ret;
+
+	g_return_val_if_fail (ra, -1);
+
+	g_mutex_lock (ra->mutex);
+
+	/* the transport is somewhere after the reader, so offsets
+	 * relative to the current position must be made absolute */
+	if (whence == XMMS_XFORM_SEEK_CUR) {
+		offset += ra->pos;
+		whence = XMMS_XFORM_SEEK_SET;
+	} else if (whence == XMMS_XFORM_SEEK_END && ra->length >= 0) {
+		offset += ra->length;
+		whence = XMMS_XFORM_SEEK_SET;
+	}
+
+	if (whence == XMMS_XFORM_SEEK_SET &&
+	    offset >= ra->base && offset <= ra->end) {
+		ra->pos = offset;
+		ra->buffered_seeks++;
+		g_cond_broadcast (ra->cond);
+		g_mutex_unlock (ra->mutex);
+		return offset;
+	}
+
+	if (!ra->seek_func) {
+		g_mutex_unlock (ra->mutex);
+		xmms_error_set (err, XMMS_ERROR_INVAL, "Couldn't seek");
+		return -1;
+	}
+
+	ra->seek_offset = offset;
+	ra->seek_whence = whence;
+	ra->seek_pending = TRUE;
+	g_cond_broadcast (ra->cond);
+
+	while (ra->seek_pending) {
+		g_cond_wait (ra->cond, ra->mutex);
+	}
+
+	ret = ra->seek_result;
+	if (ret < 0) {
+		*err = ra->seek_error;
+	}
+
+	g_mutex_unlock (ra->mutex);
+
+	return ret;
+}
+
+void
+xmms_readahead_stats_get (xmms_readahead_t *ra, guint *reads, guint *seeks,
+                          guint *buffered_seeks, guint *stalls)
+{
+	g_return_if_fail (ra);
+
+	g_mutex_lock (ra->mutex);
+	*reads = ra->reads;
+	*seeks = ra->seeks;
+	*buffered_seeks = ra->buffered_seeks;
+	*stalls = ra->stalls;
+	g_mutex_unlock (ra->mutex);
+}
+
+static void
+xmms_readahead_do_seek (xmms_readahead_t *ra)
+{
+	xmms_error_t err;
+	gint64 ret;
+
+	xmms_error_reset (&err);
+
+	g_mutex_unlock (ra->mutex);
+	ret = ra->seek_func (ra->udata, ra->seek_offset, ra->seek_whence, &err);
+	g_mutex_lock (ra->mutex);
+
+	ra->seeks++;
+
+	if (ret >= 0) {
+		ra->base = ra->end = ra->pos = ret;
+		ra->eos = FALSE;
+		ra->failed = FALSE;
+	} else {
+		ra->seek_error = err;
+	}
+
+	ra->seek_result = ret;
+	ra->seek_pending = FALSE;
+	g_cond_broadcast (ra->cond);
+}
+
+static void
+xmms_readahead_do_read (xmms_readahead_t *ra)
+{
+	xmms_error_t err;
+	gint off, len, ret;
+
+	off = ra->end % ra->size;
+	len = MIN (ra->chunk, ra->size - off);
+
+	/* the bytes about to be overwritten are no longer buffered */
+	ra->base = MAX (ra->base, ra->end + len - ra->size);
+
+	xmms_error_reset (&err);
+
+	g_mutex_unlock (ra->mutex);
+	ret = ra->read_func (ra->udata, ra->buffer + off, len, &err);
+	g_mutex_lock (ra->mutex);
+
+	ra->reads++;
+
+	/* the reader went elsewhere while we were reading */
+	if (ra->seek_pending) {
+		return;
+	}
+
+	if (ret < 0) {
+		ra->error = err;
+		ra->failed = TRUE;
+	} else if (ret == 0) {
+		ra->eos = TRUE;
+	} else {
+		ra->end += ret;
+	}
+
+	g_cond_broadcast (ra->cond);
+}
+
+static gpointer
+xmms_readahead_thread (gpointer udata)
+{
+	xmms_readahead_t *ra = udata;
+
+	g_mutex_lock (ra->mutex);
+
+	while (ra->running) {
+		if (ra->seek_pending) {
+			xmms_readahead_do_seek (ra);
+		} else if (!ra->eos && !ra->failed &&
+		           ra->end - ra->pos <= ra->ahead - ra->chunk) {
+			/* wait for room for a whole chunk, a decoder
+			 * reading a few kilobytes at a time would
+			 * otherwise turn into as many small reads */
+			xmms_readahead_do_read (ra);
+		} else {
+			g_cond_wait (ra->cond, ra->mutex);
+		}
+	}
+
+	g_mutex_unlock (ra->mutex);
+
+	return NULL;
+}
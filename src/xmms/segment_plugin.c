@@ -31,23 +31,24 @@ typedef struct xmms_segment_data_St {
 	gint64 unit; /* channels * sample_size_in_bytes */
 } xmms_segment_data_t;
 
+/** CD frames per second, the unit of startframe and stopframe */
+#define FRAMES_PER_SECOND 75
+
 
 /*
  * Helper functions
  */
 
-static gint64 ms_to_samples (gint rate,
-                             gint milliseconds);
-
-static gint ms_to_bytes (gint rate,
-                         gint64 unit,
-                         gint milliseconds);
+static gboolean position_get (xmms_xform_t *xform,
+                              const gchar *key,
+                              gint64 per_second,
+                              gint rate,
+                              gint64 *samples);
 
-static gint samples_to_bytes (gint64 unit,
-                              gint64 samples);
-
-static gint64 bytes_to_samples (gint64 unit,
-                                gint bytes);
+static void position_set (xmms_xform_t *xform,
+                          xmms_segment_data_t *data,
+                          gint64 position,
+                          gint64 target);
 
 
 /*
@@ -70,33 +71,76 @@ static gint64 xmms_segment_seek (xmms_xform_t *xform,
  * Plugin header
  */
 
-static inline gint64
-ms_to_samples (gint rate,
-               gint milliseconds)
+/* Get a position from the metadata in samples, per_second being the
+ * number of units the position is given in per second */
+static gboolean
+position_get (xmms_xform_t *xform,
+              const gchar *key,
+              gint64 per_second,
+              gint rate,
+              gint64 *samples)
 {
-	return (gint64)(((gdouble) rate) * milliseconds / 1000);
-}
+	const gchar *nptr;
+	gchar *endptr;
+	gint64 val;
 
-static inline gint
-ms_to_bytes (gint rate,
-             gint64 unit,
-             gint milliseconds)
-{
-	return (gint) ms_to_samples (rate, milliseconds) * unit;
-}
+	if (!xmms_xform_metadata_get_str (xform, key, &nptr)) {
+		return FALSE;
+	}
 
-static inline gint
-samples_to_bytes (gint64 unit,
-                  gint64 samples)
-{
-	return (gint) samples * unit;
+	val = g_ascii_strtoll (nptr, &endptr, 10);
+	if (*endptr != '\0' || val < 0) {
+		xmms_log_info ("\"%s\" has garbage, ignoring", key);
+		return FALSE;
+	}
+
+	*samples = val * rate / per_second;
+
+	return TRUE;
 }
 
-static inline gint64
-bytes_to_samples (gint64 unit,
-                  gint bytes)
+/* Get the chain from position to target, both in samples. Seek if
+ * it can, and read up to target if it can't or lands short of it. */
+static void
+position_set (xmms_xform_t *xform,
+              xmms_segment_data_t *data,
+              gint64 position,
+              gint64 target)
 {
-	return (gint64) bytes / unit;
+	xmms_error_t error;
+	gchar buf[4096];
+	gint64 current, goal;
+	gint res;
+
+	xmms_error_reset (&error);
+
+	if (position != target) {
+		current = xmms_xform_seek (xform, target, XMMS_XFORM_SEEK_SET, &error);
+		if (current != -1) {
+			position = current;
+		} else {
+			XMMS_DBG ("Couldn't seek, reading up to the segment instead");
+		}
+	}
+
+	if (position > target) {
+		xmms_log_info ("Segment starts %" G_GINT64_FORMAT " samples late",
+		               position - target);
+	}
+
+	current = position * data->unit;
+	goal = target * data->unit;
+
+	while (current < goal) {
+		res = xmms_xform_read (xform, buf, MIN (goal - current, (gint64) sizeof (buf)),
+		                       &error);
+		if (res <= 0) {
+			break;
+		}
+		current += res;
+	}
+
+	data->current_bytes = current;
 }
 
 
@@ -124,82 +168,71 @@ xmms_segment_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 static gboolean
 xmms_segment_init (xmms_xform_t *xform)
 {
-	const gchar *nptr;
-	char *endptr;
-	gint startms;
-	gint stopms;
 	const gchar *metakey;
-	xmms_error_t error;
 	xmms_segment_data_t *data;
 	gint fmt;
 	gint channels;
 	gint samplerate;
-	gint sample_size_in_bytes;
-	gint64 samples;
+	gint32 duration;
+	gint64 start;
+	gint64 stop;
+	gint64 resumed;
 
 	g_return_val_if_fail (xform, FALSE);
 
 	xmms_xform_outdata_type_copy (xform);
 
-	/* get startms */
-	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_STARTMS;
-	if (!xmms_xform_metadata_get_str (xform, metakey, &nptr)) {
-		return TRUE;
-	}
+	channels = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
+	fmt = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_FORMAT);
+	samplerate = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
 
-	startms = (gint) strtol (nptr, &endptr, 10);
-	if (*endptr != '\0') {
-		XMMS_DBG ("\"startms\" has garbage!");
+	/* CD frames are exact to the sample, milliseconds aren't */
+	if (!position_get (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_STARTFRAME,
+	                   FRAMES_PER_SECOND, samplerate, &start) &&
+	    !position_get (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_STARTMS,
+	                   1000, samplerate, &start)) {
 		return TRUE;
 	}
 
-	/* get stopms */
-	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_STOPMS;
-	if (xmms_xform_metadata_get_str (xform, metakey, &nptr)) {
-		stopms = (gint) strtol (nptr, &endptr, 10);
-		if (*endptr != '\0') {
-			xmms_log_info ("\"stopms\" has garbage, ignoring");
-			stopms = INT_MAX;
-		}
-	} else {
+	if (!position_get (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_STOPFRAME,
+	                   FRAMES_PER_SECOND, samplerate, &stop) &&
+	    !position_get (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_STOPMS,
+	                   1000, samplerate, &stop)) {
 		/* This is the last track, stopms is the playback duration */
 		metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_DURATION;
-		if (!xmms_xform_metadata_get_int (xform, metakey, &stopms)) {
+		if (xmms_xform_metadata_get_int (xform, metakey, &duration)) {
+			stop = (gint64) duration * samplerate / 1000;
+		} else {
 			XMMS_DBG ("\"duration\" doesnt exist, ignore stopms.");
-			/* ignore stopms by setting it to the maximum value */
-			stopms = INT_MAX;
+			stop = -1;
 		}
 	}
 
+	if (stop != -1 && stop < start) {
+		xmms_log_info ("Segment stops before it starts, ignoring stop");
+		stop = -1;
+	}
+
 	/* set the correct duration */
-	if (stopms != INT_MAX) {
+	if (stop != -1) {
 		metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_DURATION;
-		xmms_xform_metadata_set_int (xform, metakey, stopms - startms);
+		xmms_xform_metadata_set_int (xform, metakey,
+		                             (stop - start) * 1000 / samplerate);
 	}
 
-	/* some calculation */
-	channels = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
-	fmt = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_FORMAT);
-	samplerate = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
-
-	sample_size_in_bytes = xmms_sample_size_get (fmt);
-
 	/* allocate and set data */
 	data = g_new0 (xmms_segment_data_t, 1);
-	data->unit = channels * sample_size_in_bytes;
-	data->current_bytes = data->start_bytes = ms_to_bytes (samplerate,
-	                                                       data->unit,
-	                                                       startms);
-	data->stop_bytes = ms_to_bytes (samplerate,
-	                                data->unit,
-	                                stopms);
+	data->unit = channels * xmms_sample_size_get (fmt);
+	data->start_bytes = start * data->unit;
+	/* without a stop, play until the stream ends */
+	data->stop_bytes = stop != -1 ? stop * data->unit : G_MAXINT64;
 
 	xmms_xform_private_data_set (xform, data);
 
-	/* Now seek to startms */
-
-	samples = ms_to_samples (samplerate, startms);
-	xmms_xform_seek (xform, samples, XMMS_XFORM_SEEK_SET, &error);
+	/* A chain handed on by the previous segment of the file is
+	 * usually right at the start already, a new one is at 0. */
+	resumed = xmms_xform_chain_resumed_at (xform);
+	position_set (xform, data, MAX (resumed, 0), start);
 
 	return TRUE;
 }
@@ -210,8 +243,15 @@ xmms_segment_destroy (xmms_xform_t *xform)
 	xmms_segment_data_t *data;
 
 	data = xmms_xform_private_data_get (xform);
-	if (data)
+	if (data) {
+		/* played up to the stop, the next segment may continue
+		 * with the same decoder */
+		if (data->current_bytes == data->stop_bytes) {
+			xmms_xform_chain_park (xform,
+			                       data->current_bytes / data->unit);
+		}
 		g_free (data);
+	}
 }
 
 static gint
@@ -229,6 +269,10 @@ xmms_segment_read (xmms_xform_t *xform,
 		len = data->stop_bytes - data->current_bytes;
 	}
 
+	if (len <= 0) {
+		return 0;
+	}
+
 	res = xmms_xform_read (xform, buf, len, error);
 	if (data && (res > 0)) {
 		data->current_bytes += res;
@@ -245,7 +289,7 @@ xmms_segment_seek (xmms_xform_t *xform,
 {
 	xmms_segment_data_t *data;
 	gint64 res;
-	gint64 tmp;
+	gint64 start;
 
 	data = xmms_xform_private_data_get (xform);
 
@@ -256,29 +300,29 @@ xmms_segment_seek (xmms_xform_t *xform,
 	g_return_val_if_fail (whence == XMMS_XFORM_SEEK_SET, -1);
 
 	if (samples < 0 ||
-	    samples > bytes_to_samples (data->unit,
-	                                data->stop_bytes
-	                                  - data->start_bytes)) {
+	    samples > (data->stop_bytes - data->start_bytes) / data->unit) {
 		xmms_error_set (error,
 		                XMMS_ERROR_INVAL,
 		                "Seeking out of range");
 		return -1;
 	}
 
-	tmp = bytes_to_samples (data->unit,
-	                        data->start_bytes);
+	start = data->start_bytes / data->unit;
 	res = xmms_xform_seek (xform,
-	                       samples + tmp,
+	                       samples + start,
 	                       whence,
 	                       error);
-	data->current_bytes = samples_to_bytes (data->unit,
-	                                        res);
-	return res - tmp;
+	if (res == -1) {
+		return -1;
+	}
+
+	data->current_bytes = res * data->unit;
+	return res - start;
 }
 
 XMMS_XFORM_BUILTIN (segment,
                     "Segment Effect",
                     XMMS_VERSION,
-                    "Handling segment information specified by startms/stopms",
+                    "Handling segment information specified by startframe/stopframe or startms/stopms",
                     xmms_segment_plugin_setup);
 
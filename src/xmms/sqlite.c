@@ -27,6 +27,7 @@
 #include "xmmspriv/xmms_statfs.h"
 #include "xmmspriv/xmms_utils.h"
 #include "xmmspriv/xmms_collection.h"
+#include "xmmspriv/xmms_stats.h"
 #include "xmmsc/xmmsc_idnumbers.h"
 
 #include <sqlite3.h>
@@ -99,6 +100,75 @@ const char *indices[] = {
 	NULL
 };
 
+/* The properties in the text index, searched by MATCH filters */
+#define TEXT_INDEX_KEYS "'artist', 'album', 'title', 'url'"
+
+static const gchar *text_index_keys[] = {
+	"artist", "album", "title", "url", NULL
+};
+
+/**
+ * A trigram index over the values of some properties, so that
+ * searching for a substring doesn't have to scan all of Media. The
+ * triggers keep it up to date however Media is changed.
+ */
+const char *text_index[] = {
+	"CREATE VIRTUAL TABLE MediaText "
+	       "USING fts5 (value, content='Media', tokenize='trigram')",
+
+	"CREATE TRIGGER mediatext_insert AFTER INSERT ON Media "
+	       "WHEN new.key IN (" TEXT_INDEX_KEYS ") BEGIN "
+	"INSERT INTO MediaText (rowid, value) VALUES (new.rowid, new.value); "
+	"END",
+
+	"CREATE TRIGGER mediatext_delete AFTER DELETE ON Media "
+	       "WHEN old.key IN (" TEXT_INDEX_KEYS ") BEGIN "
+	"INSERT INTO MediaText (MediaText, rowid, value) "
+	       "VALUES ('delete', old.rowid, old.value); "
+	"END",
+
+	"CREATE TRIGGER mediatext_update AFTER UPDATE OF key, value ON Media BEGIN "
+	"INSERT INTO MediaText (MediaText, rowid, value) "
+	       "SELECT 'delete', old.rowid, old.value "
+	       "WHERE old.key IN (" TEXT_INDEX_KEYS "); "
+	"INSERT INTO MediaText (rowid, value) "
+	       "SELECT new.rowid, new.value "
+	       "WHERE new.key IN (" TEXT_INDEX_KEYS "); "
+	"END",
+
+	"INSERT INTO MediaText (rowid, value) "
+	       "SELECT rowid, value FROM Media WHERE key IN (" TEXT_INDEX_KEYS ")",
+
+	NULL
+};
+
+/**
+ * Without these, sqlite takes looking up all values of a key to be
+ * cheaper than looking up the rows found in the text index. Databases
+ * created before the (key, value) indices got stats of their own.
+ */
+const char fill_text_index_stats[] = "INSERT INTO sqlite_stat1 "
+                                         "SELECT 'Media', 'key_value_1x', '199568 6653 3' "
+                                         "WHERE NOT EXISTS (SELECT 1 FROM sqlite_stat1 "
+                                                           "WHERE idx='key_value_1x');"
+                                     "INSERT INTO sqlite_stat1 "
+                                         "SELECT 'Media', 'key_value_2x', '199568 6653 3' "
+                                         "WHERE NOT EXISTS (SELECT 1 FROM sqlite_stat1 "
+                                                           "WHERE idx='key_value_2x');";
+
+const char drop_text_index_stm[] = "DROP TRIGGER IF EXISTS mediatext_insert;"
+                                   "DROP TRIGGER IF EXISTS mediatext_delete;"
+                                   "DROP TRIGGER IF EXISTS mediatext_update;"
+                                   "DROP TABLE IF EXISTS MediaText;";
+
+static gboolean text_index_enabled = FALSE;
+
+/** How long to wait for another connection to let go of the database */
+#define XMMS_SQLITE_BUSY_TIMEOUT_MS 60000
+
+static xmms_stats_counter_t *busy_waits;
+static xmms_stats_counter_t *busy_wait_ms;
+
 const char create_CollectionAttributes_stm[] = "create table CollectionAttributes (collid integer, key text, value text)";
 const char create_CollectionConnections_stm[] = "create table CollectionConnections (from_id integer, to_id integer)";
 const char create_CollectionIdlists_stm[] = "create table CollectionIdlists (collid integer, position integer, mid integer)";
@@ -110,7 +180,10 @@ const char create_CollectionOperators_stm[] = "create table CollectionOperators
  * layout drasticly we need to redo them!
  */
 const char fill_stats[] = "INSERT INTO sqlite_stat1 VALUES('Media', 'key_idx', '199568 14 1 1');"
-                          "INSERT INTO sqlite_stat1 VALUES('Media', 'prop_idx', '199568 6653 3');"
+                          "INSERT INTO sqlite_stat1 VALUES('Media', 'id_key_value_1x', '199568 14 1 1');"
+                          "INSERT INTO sqlite_stat1 VALUES('Media', 'id_key_value_2x', '199568 14 1 1');"
+                          "INSERT INTO sqlite_stat1 VALUES('Media', 'key_value_1x', '199568 6653 3');"
+                          "INSERT INTO sqlite_stat1 VALUES('Media', 'key_value_2x', '199568 6653 3');"
                           "INSERT INTO sqlite_stat1 VALUES('PlaylistEntries', 'playlistentries_idx', '12784 12784 1');"
                           "INSERT INTO sqlite_stat1 VALUES('Playlist', 'playlist_idx', '2 1');"
                           "INSERT INTO sqlite_stat1 VALUES('Playlist', 'sqlite_autoindex_Playlist_1', '2 1');"
@@ -346,6 +419,41 @@ try_upgrade (sqlite3 *sql, gint version)
 	return can_upgrade;
 }
 
+/**
+ * Wait for a lock held by another connection, backing off like the
+ * handler sqlite3_busy_timeout installs, but keeping count of how
+ * often and how long we waited.
+ */
+static int
+xmms_sqlite_busy_handler (void *udata, int count)
+{
+	static const gint delays[] = { 1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100 };
+	static const gint totals[] = { 0, 1, 3, 8, 18, 33, 53, 78, 103, 128, 178, 228 };
+	const gint last = G_N_ELEMENTS (delays) - 1;
+	gint delay, waited;
+
+	if (count <= last) {
+		delay = delays[count];
+		waited = totals[count];
+	} else {
+		delay = delays[last];
+		waited = totals[last] + delays[last] * (count - last);
+	}
+
+	if (waited >= XMMS_SQLITE_BUSY_TIMEOUT_MS) {
+		return 0;
+	}
+
+	delay = MIN (delay, XMMS_SQLITE_BUSY_TIMEOUT_MS - waited);
+
+	xmms_stats_counter_inc (busy_waits);
+	xmms_stats_counter_add (busy_wait_ms, delay);
+
+	g_usleep (delay * 1000);
+
+	return 1;
+}
+
 static void
 xmms_sqlite_set_common_properties (sqlite3 *sql)
 {
@@ -353,14 +461,92 @@ xmms_sqlite_set_common_properties (sqlite3 *sql)
 	sqlite3_exec (sql, "PRAGMA auto_vacuum = 1", NULL, NULL, NULL);
 	sqlite3_exec (sql, "PRAGMA cache_size = 8000", NULL, NULL, NULL);
 	sqlite3_exec (sql, "PRAGMA temp_store = MEMORY", NULL, NULL, NULL);
+	/* rows replaced by INSERT OR REPLACE must go through the delete
+	 * trigger of the text index as well */
+	sqlite3_exec (sql, "PRAGMA recursive_triggers = ON", NULL, NULL, NULL);
 
-	/* One minute */
-	sqlite3_busy_timeout (sql, 60000);
+	sqlite3_busy_handler (sql, xmms_sqlite_busy_handler, NULL);
 
 	sqlite3_create_collation (sql, "INTCOLL", SQLITE_UTF8, NULL,
 	                          xmms_sqlite_integer_coll);
 }
 
+/**
+ * Create or drop the text index, depending on the config. Sqlite
+ * versions without fts5 or the trigram tokenizer just don't get one.
+ */
+static void
+xmms_sqlite_text_index_setup (sqlite3 *sql)
+{
+	xmms_config_property_t *cv;
+	gboolean want;
+	guint exists = 0;
+	gchar *err = NULL;
+	guint i;
+
+	cv = xmms_config_lookup ("medialib.text_index");
+	want = xmms_config_property_get_int (cv);
+
+	sqlite3_exec (sql, "SELECT COUNT (*) FROM sqlite_master "
+	                   "WHERE type='table' AND name='MediaText'",
+	              xmms_sqlite_version_cb, &exists, NULL);
+
+	if (!want) {
+		if (exists) {
+			XMMS_DBG ("Dropping the text index");
+			sqlite3_exec (sql, drop_text_index_stm, NULL, NULL, NULL);
+		}
+		text_index_enabled = FALSE;
+		return;
+	}
+
+	if (exists) {
+		text_index_enabled = TRUE;
+		return;
+	}
+
+	xmms_log_info ("Building the text index, please wait a few seconds");
+
+	sqlite3_exec (sql, "BEGIN", NULL, NULL, NULL);
+	for (i = 0; text_index[i]; i++) {
+		if (sqlite3_exec (sql, text_index[i], NULL, NULL, &err) != SQLITE_OK) {
+			xmms_log_info ("Could not create the text index (%s), "
+			               "searches will be slower", err);
+			sqlite3_free (err);
+			sqlite3_exec (sql, "ROLLBACK", NULL, NULL, NULL);
+			text_index_enabled = FALSE;
+			return;
+		}
+	}
+	sqlite3_exec (sql, "COMMIT", NULL, NULL, NULL);
+
+	sqlite3_exec (sql, fill_text_index_stats, NULL, NULL, NULL);
+
+	text_index_enabled = TRUE;
+}
+
+/**
+ * Check whether the values of a property can be searched through
+ * the text index.
+ */
+gboolean
+xmms_sqlite_text_indexed (const gchar *key)
+{
+	guint i;
+
+	if (!text_index_enabled) {
+		return FALSE;
+	}
+
+	for (i = 0; text_index_keys[i]; i++) {
+		if (strcmp (key, text_index_keys[i]) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
 gboolean
 xmms_sqlite_create (gboolean *create)
 {
@@ -374,6 +560,9 @@ xmms_sqlite_create (gboolean *create)
 
 	*create = FALSE;
 
+	busy_waits = xmms_stats_counter_register ("medialib.sqlite_busy_waits");
+	busy_wait_ms = xmms_stats_counter_register ("medialib.sqlite_busy_ms");
+
 	cv = xmms_config_lookup ("medialib.path");
 	dbpath = xmms_config_property_get_string (cv);
 
@@ -500,6 +689,8 @@ xmms_sqlite_create (gboolean *create)
 		sqlite3_exec (sql, set_version_stm, NULL, NULL, NULL);
 	}
 
+	xmms_sqlite_text_index_setup (sql);
+
 	sqlite3_close (sql);
 
 	XMMS_DBG ("xmms_sqlite_create done!");
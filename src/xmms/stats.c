@@ -0,0 +1,485 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Counters and latency histograms for the server's hot paths.
+ *
+ * Every value is split in a number of slots, each the size of a cache
+ * line, and a thread always updates the same slot. Updates are
+ * plain relaxed atomic adds that hardly ever meet another thread,
+ * the slots are only summed up when someone asks for the numbers.
+ *
+ * Counters and histograms live until the server shuts down, so the
+ * code updating them can keep the pointers around.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmmspriv/xmms_stats.h"
+
+/** number of slots a value is split in, a power of two */
+#define XMMS_STATS_SLOTS 16
+
+/** histogram bucket i > 0 holds [2^(i-1), 2^i) microseconds */
+#define XMMS_STATS_BUCKETS 32
+
+#define XMMS_STATS_CACHE_LINE 64
+
+/* the alignment also rounds the size up to whole cache lines, the
+ * entries holding the slots are allocated aligned to match */
+typedef struct {
+	gint64 value;
+} __attribute__ ((aligned (XMMS_STATS_CACHE_LINE))) xmms_stats_slot_t;
+
+typedef struct {
+	gint64 buckets[XMMS_STATS_BUCKETS];
+	gint64 sum;
+} __attribute__ ((aligned (XMMS_STATS_CACHE_LINE))) xmms_stats_histogram_slot_t;
+
+typedef enum {
+	XMMS_STATS_COUNTER,
+	XMMS_STATS_HISTOGRAM
+} xmms_stats_kind_t;
+
+struct xmms_stats_counter_St {
+	xmms_stats_kind_t kind;
+	gchar *name;
+	xmms_stats_slot_t slots[XMMS_STATS_SLOTS];
+};
+
+struct xmms_stats_histogram_St {
+	xmms_stats_kind_t kind;
+	gchar *name;
+	xmms_stats_histogram_slot_t slots[XMMS_STATS_SLOTS];
+};
+
+static GMutex *stats_lock;
+/* name -> counter or histogram */
+static GHashTable *stats;
+static GPrivate *stats_slot_key;
+static gint stats_next_slot;
+
+static void
+xmms_stats_entry_free (gpointer data)
+{
+	xmms_stats_counter_t *entry = (xmms_stats_counter_t *) data;
+
+	g_free (entry->name);
+	free (entry);
+}
+
+/**
+ * Set up the registry, has to be called after g_thread_init and
+ * before anything registers a counter.
+ */
+void
+xmms_stats_init (void)
+{
+	stats_lock = g_mutex_new ();
+	stats = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+	                               xmms_stats_entry_free);
+	/* threads keep their slot across a restart of the registry */
+	if (!stats_slot_key) {
+		stats_slot_key = g_private_new (NULL);
+	}
+}
+
+void
+xmms_stats_shutdown (void)
+{
+	if (!stats) {
+		return;
+	}
+
+	g_hash_table_destroy (stats);
+	g_mutex_free (stats_lock);
+	stats = NULL;
+	stats_lock = NULL;
+}
+
+/**
+ * The slot this thread updates. Threads are handed slots round-robin
+ * the first time they update something.
+ */
+static inline gint
+xmms_stats_slot (void)
+{
+	gint slot;
+
+	slot = GPOINTER_TO_INT (g_private_get (stats_slot_key));
+	if (G_UNLIKELY (!slot)) {
+		slot = g_atomic_int_exchange_and_add (&stats_next_slot, 1);
+		slot = (slot % XMMS_STATS_SLOTS) + 1;
+		g_private_set (stats_slot_key, GINT_TO_POINTER (slot));
+	}
+
+	return slot - 1;
+}
+
+static gpointer
+xmms_stats_register (const gchar *name, xmms_stats_kind_t kind, gsize size)
+{
+	xmms_stats_counter_t *entry;
+
+	g_return_val_if_fail (name, NULL);
+
+	if (!stats) {
+		return NULL;
+	}
+
+	g_mutex_lock (stats_lock);
+	entry = g_hash_table_lookup (stats, name);
+	if (!entry) {
+		gpointer mem;
+
+		if (posix_memalign (&mem, XMMS_STATS_CACHE_LINE, size)) {
+			g_error ("Out of memory registering statistic '%s'", name);
+		}
+		entry = memset (mem, 0, size);
+		entry->kind = kind;
+		entry->name = g_strdup (name);
+		g_hash_table_insert (stats, entry->name, entry);
+	}
+	g_mutex_unlock (stats_lock);
+
+	if (entry->kind != kind) {
+		g_warning ("Statistic '%s' registered with another type", name);
+		return NULL;
+	}
+
+	return entry;
+}
+
+/**
+ * Get the counter with the given name, creating it if needed.
+ *
+ * @returns the counter, or NULL if the registry isn't set up. All
+ * functions taking a counter accept NULL and do nothing.
+ */
+xmms_stats_counter_t *
+xmms_stats_counter_register (const gchar *name)
+{
+	return xmms_stats_register (name, XMMS_STATS_COUNTER,
+	                            sizeof (xmms_stats_counter_t));
+}
+
+void
+xmms_stats_counter_add (xmms_stats_counter_t *counter, gint64 n)
+{
+	if (!counter) {
+		return;
+	}
+
+	__atomic_fetch_add (&counter->slots[xmms_stats_slot ()].value, n,
+	                    __ATOMIC_RELAXED);
+}
+
+/**
+ * Set a counter to a value, for counters used as gauges. Mixing
+ * this with #xmms_stats_counter_add from other threads gives
+ * unpredictable results.
+ */
+void
+xmms_stats_counter_set (xmms_stats_counter_t *counter, gint64 value)
+{
+	gint i;
+
+	if (!counter) {
+		return;
+	}
+
+	__atomic_store_n (&counter->slots[0].value, value, __ATOMIC_RELAXED);
+	for (i = 1; i < XMMS_STATS_SLOTS; i++) {
+		__atomic_store_n (&counter->slots[i].value, 0, __ATOMIC_RELAXED);
+	}
+}
+
+gint64
+xmms_stats_counter_get (xmms_stats_counter_t *counter)
+{
+	gint64 value = 0;
+	gint i;
+
+	if (!counter) {
+		return 0;
+	}
+
+	for (i = 0; i < XMMS_STATS_SLOTS; i++) {
+		value += __atomic_load_n (&counter->slots[i].value, __ATOMIC_RELAXED);
+	}
+
+	return value;
+}
+
+/**
+ * Get the histogram with the given name, creating it if needed.
+ * Histograms count durations in microseconds in power of two
+ * buckets.
+ */
+xmms_stats_histogram_t *
+xmms_stats_histogram_register (const gchar *name)
+{
+	return xmms_stats_register (name, XMMS_STATS_HISTOGRAM,
+	                            sizeof (xmms_stats_histogram_t));
+}
+
+static inline gint
+xmms_stats_bucket (gint64 usec)
+{
+	gint bucket = 0;
+
+	while (usec > 0 && bucket < XMMS_STATS_BUCKETS - 1) {
+		usec >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+void
+xmms_stats_histogram_add (xmms_stats_histogram_t *hist, gint64 usec)
+{
+	xmms_stats_histogram_slot_t *slot;
+
+	if (!hist) {
+		return;
+	}
+
+	usec = MAX (usec, 0);
+	slot = &hist->slots[xmms_stats_slot ()];
+
+	__atomic_fetch_add (&slot->buckets[xmms_stats_bucket (usec)], 1,
+	                    __ATOMIC_RELAXED);
+	__atomic_fetch_add (&slot->sum, usec, __ATOMIC_RELAXED);
+}
+
+/**
+ * A timestamp in microseconds, to measure durations with.
+ */
+gint64
+xmms_stats_time (void)
+{
+	GTimeVal now;
+
+	g_get_current_time (&now);
+
+	return (gint64) now.tv_sec * G_USEC_PER_SEC + now.tv_usec;
+}
+
+/**
+ * Add the time passed since a timestamp from #xmms_stats_time.
+ */
+void
+xmms_stats_histogram_add_since (xmms_stats_histogram_t *hist, gint64 start)
+{
+	if (!hist) {
+		return;
+	}
+
+	xmms_stats_histogram_add (hist, xmms_stats_time () - start);
+}
+
+static void
+xmms_stats_histogram_sum (xmms_stats_histogram_t *hist,
+                          gint64 *buckets, gint64 *sum)
+{
+	gint i, j;
+
+	memset (buckets, 0, sizeof (gint64) * XMMS_STATS_BUCKETS);
+	*sum = 0;
+
+	for (i = 0; i < XMMS_STATS_SLOTS; i++) {
+		for (j = 0; j < XMMS_STATS_BUCKETS; j++) {
+			buckets[j] += __atomic_load_n (&hist->slots[i].buckets[j],
+			                               __ATOMIC_RELAXED);
+		}
+		*sum += __atomic_load_n (&hist->slots[i].sum, __ATOMIC_RELAXED);
+	}
+}
+
+gint64
+xmms_stats_histogram_count (xmms_stats_histogram_t *hist)
+{
+	gint64 buckets[XMMS_STATS_BUCKETS], sum, count = 0;
+	gint i;
+
+	if (!hist) {
+		return 0;
+	}
+
+	xmms_stats_histogram_sum (hist, buckets, &sum);
+	for (i = 0; i < XMMS_STATS_BUCKETS; i++) {
+		count += buckets[i];
+	}
+
+	return count;
+}
+
+static gint64
+xmms_stats_buckets_percentile (gint64 *buckets, gint64 count, gint percent)
+{
+	gint64 rank, seen = 0;
+	gint i;
+
+	if (!count) {
+		return 0;
+	}
+
+	/* the sample the percentile falls on, counting from one */
+	rank = MAX ((count * percent + 99) / 100, 1);
+
+	for (i = 0; i < XMMS_STATS_BUCKETS; i++) {
+		seen += buckets[i];
+		if (seen >= rank) {
+			break;
+		}
+	}
+
+	/* upper bound of the bucket */
+	return i ? (G_GINT64_CONSTANT (1) << i) - 1 : 0;
+}
+
+/**
+ * Estimate a percentile of a histogram, to within a factor of two.
+ *
+ * @returns the upper bound of the bucket the percentile falls in,
+ * in microseconds.
+ */
+gint64
+xmms_stats_histogram_percentile (xmms_stats_histogram_t *hist, gint percent)
+{
+	gint64 buckets[XMMS_STATS_BUCKETS], sum, count = 0;
+	gint i;
+
+	if (!hist) {
+		return 0;
+	}
+
+	xmms_stats_histogram_sum (hist, buckets, &sum);
+	for (i = 0; i < XMMS_STATS_BUCKETS; i++) {
+		count += buckets[i];
+	}
+
+	return xmms_stats_buckets_percentile (buckets, count, percent);
+}
+
+static xmmsv_t *
+xmms_stats_int (gint64 value)
+{
+	return xmmsv_new_int (CLAMP (value, G_MININT32, G_MAXINT32));
+}
+
+static xmmsv_t *
+xmms_stats_histogram_to_dict (xmms_stats_histogram_t *hist)
+{
+	gint64 buckets[XMMS_STATS_BUCKETS], sum, count = 0;
+	xmmsv_t *dict, *list, *v;
+	gint i, last = 0;
+
+	xmms_stats_histogram_sum (hist, buckets, &sum);
+	for (i = 0; i < XMMS_STATS_BUCKETS; i++) {
+		count += buckets[i];
+		if (buckets[i]) {
+			last = i;
+		}
+	}
+
+	dict = xmmsv_new_dict ();
+
+#define DICT_SET(key, value) \
+	v = xmms_stats_int (value); \
+	xmmsv_dict_set (dict, key, v); \
+	xmmsv_unref (v);
+
+	DICT_SET ("count", count);
+	DICT_SET ("total_ms", sum / 1000);
+	DICT_SET ("p50_us", xmms_stats_buckets_percentile (buckets, count, 50));
+	DICT_SET ("p90_us", xmms_stats_buckets_percentile (buckets, count, 90));
+	DICT_SET ("p99_us", xmms_stats_buckets_percentile (buckets, count, 99));
+
+#undef DICT_SET
+
+	/* only up to the last bucket that has anything in it */
+	list = xmmsv_new_list ();
+	for (i = 0; count && i <= last; i++) {
+		v = xmms_stats_int (buckets[i]);
+		xmmsv_list_append (list, v);
+		xmmsv_unref (v);
+	}
+	xmmsv_dict_set (dict, "buckets", list);
+	xmmsv_unref (list);
+
+	return dict;
+}
+
+static void
+xmms_stats_collect (gpointer key, gpointer value, gpointer udata)
+{
+	g_ptr_array_add ((GPtrArray *) udata, value);
+}
+
+static gint
+xmms_stats_compare (gconstpointer a, gconstpointer b)
+{
+	const xmms_stats_counter_t *sa = *(const xmms_stats_counter_t **) a;
+	const xmms_stats_counter_t *sb = *(const xmms_stats_counter_t **) b;
+
+	return strcmp (sa->name, sb->name);
+}
+
+/**
+ * Call a function with the value of every counter and histogram, in
+ * order of their names. Counters are ints, histograms dicts with the
+ * count, the total time in milliseconds, estimates of a few
+ * percentiles and the buckets themselves. The value is unreffed
+ * after the call, the name lives as long as the registry.
+ */
+void
+xmms_stats_foreach (xmms_stats_foreach_func_t func, gpointer udata)
+{
+	GPtrArray *entries;
+	guint i;
+
+	if (!stats) {
+		return;
+	}
+
+	entries = g_ptr_array_new ();
+
+	g_mutex_lock (stats_lock);
+	g_hash_table_foreach (stats, xmms_stats_collect, entries);
+	g_mutex_unlock (stats_lock);
+
+	g_ptr_array_sort (entries, xmms_stats_compare);
+
+	for (i = 0; i < entries->len; i++) {
+		xmms_stats_counter_t *counter = g_ptr_array_index (entries, i);
+		xmmsv_t *value;
+
+		if (counter->kind == XMMS_STATS_COUNTER) {
+			value = xmms_stats_int (xmms_stats_counter_get (counter));
+		} else {
+			value = xmms_stats_histogram_to_dict ((xmms_stats_histogram_t *) counter);
+		}
+
+		func (counter->name, value, udata);
+		xmmsv_unref (value);
+	}
+
+	g_ptr_array_free (entries, TRUE);
+}
@@ -20,51 +20,109 @@
  */
 
 #include <glib.h>
+#include <string.h>
 
 #include "xmmspriv/xmms_xform.h"
 #include "xmms/xmms_log.h"
 #include "xmms/xmms_object.h"
 
 
-struct xmms_stream_type_St {
-	xmms_object_t obj;
-	gint priority;
-	gchar *name;
-	GList *list;
-};
+/** Number of keys that can carry a value, priority and name are separate */
+#define XMMS_STREAM_TYPE_KEY_COUNT (XMMS_STREAM_TYPE_FMT_SAMPLERATE + 1)
+#define KEY_BIT(key) (1U << (key))
 
 typedef enum xmms_stream_type_val_type_E {
+	NONE,
+	/* interned string, equal strings share the same pointer */
+	ATOM,
 	STRING,
 	INT,
 } xmms_stream_type_val_type_t;
 
 typedef struct xmms_stream_type_val_St {
-	xmms_stream_type_key_t key;
 	xmms_stream_type_val_type_t type;
-	union {
-		char *string;
-		int num;
-	} d;
+	const gchar *string;
+	/* set when the string is a pattern rather than a literal */
+	GPatternSpec *pattern;
+	gint num;
 } xmms_stream_type_val_t;
 
+/**
+ * Stream types never change after they've been parsed, so everything
+ * needed to compare them is worked out up front: values are stored by
+ * key, mimetypes are interned and wildcards compiled, and the hash is
+ * computed once.
+ */
+struct xmms_stream_type_St {
+	xmms_object_t obj;
+	gint priority;
+	gchar *name;
+	/** Bitmask of the keys that have a value */
+	guint keys;
+	guint hash;
+	xmms_stream_type_val_t vals[XMMS_STREAM_TYPE_KEY_COUNT];
+};
+
 
 static void
 xmms_stream_type_destroy (xmms_object_t *obj)
 {
 	xmms_stream_type_t *st = (xmms_stream_type_t *)obj;
-	GList *n;
+	gint i;
 
 	g_free (st->name);
 
-	for (n = st->list; n; n = g_list_next (n)) {
-		xmms_stream_type_val_t *val = n->data;
+	for (i = 0; i < XMMS_STREAM_TYPE_KEY_COUNT; i++) {
+		xmms_stream_type_val_t *val = &st->vals[i];
 		if (val->type == STRING) {
-			g_free (val->d.string);
+			g_free ((gchar *) val->string);
+		}
+		if (val->pattern) {
+			g_pattern_spec_free (val->pattern);
 		}
-		g_free (val);
+	}
+}
+
+static void
+set_string (xmms_stream_type_val_t *val, const gchar *s, gboolean intern)
+{
+	if (intern) {
+		val->type = ATOM;
+		val->string = g_intern_string (s);
+	} else {
+		val->type = STRING;
+		val->string = g_strdup (s);
 	}
 
-	g_list_free (st->list);
+	if (s && strpbrk (s, "*?")) {
+		val->pattern = g_pattern_spec_new (s);
+	}
+}
+
+static guint
+compute_hash (const xmms_stream_type_t *st)
+{
+	guint hash = 0;
+	gint i;
+
+	for (i = 0; i < XMMS_STREAM_TYPE_KEY_COUNT; i++) {
+		const xmms_stream_type_val_t *val = &st->vals[i];
+
+		switch (val->type) {
+		case NONE:
+			continue;
+		case ATOM:
+		case STRING:
+			hash = hash * 31 + g_str_hash (val->string);
+			break;
+		case INT:
+			hash = hash * 31 + val->num;
+			break;
+		}
+		hash = hash * 31 + i;
+	}
+
+	return hash;
 }
 
 xmms_stream_type_t *
@@ -81,7 +139,7 @@ xmms_stream_type_parse (va_list ap)
 	res->name = NULL;
 
 	for (;;) {
-		xmms_stream_type_val_t *val;
+		xmms_stream_type_val_t *val, dummy = { NONE };
 		xmms_stream_type_key_t key;
 
 		key = va_arg (ap, int);
@@ -98,28 +156,45 @@ xmms_stream_type_parse (va_list ap)
 			continue;
 		}
 
-		val = g_new0 (xmms_stream_type_val_t, 1);
-		val->key = key;
+		if (key < 0 || key >= XMMS_STREAM_TYPE_KEY_COUNT) {
+			XMMS_DBG ("UNKNOWN TYPE!!");
+			xmms_object_unref (res);
+			return NULL;
+		}
+
+		/* the first value given for a key wins */
+		val = (res->keys & KEY_BIT (key)) ? &dummy : &res->vals[key];
 
-		switch (val->key) {
+		switch (key) {
 		case XMMS_STREAM_TYPE_MIMETYPE:
+			set_string (val, va_arg (ap, char *), TRUE);
+			break;
 		case XMMS_STREAM_TYPE_URL:
-			val->type = STRING;
-			val->d.string = g_strdup (va_arg (ap, char *));
+			/* urls differ for every file, don't let them pile up */
+			set_string (val, va_arg (ap, char *), FALSE);
 			break;
 		case XMMS_STREAM_TYPE_FMT_FORMAT:
 		case XMMS_STREAM_TYPE_FMT_CHANNELS:
 		case XMMS_STREAM_TYPE_FMT_SAMPLERATE:
 			val->type = INT;
-			val->d.num = va_arg (ap, int);
+			val->num = va_arg (ap, int);
 			break;
 		default:
 			XMMS_DBG ("UNKNOWN TYPE!!");
-			g_free (val);
 			xmms_object_unref (res);
 			return NULL;
 		}
-		res->list = g_list_append (res->list, val);
+
+		if (val == &dummy) {
+			if (dummy.type == STRING) {
+				g_free ((gchar *) dummy.string);
+			}
+			if (dummy.pattern) {
+				g_pattern_spec_free (dummy.pattern);
+			}
+		}
+
+		res->keys |= KEY_BIT (key);
 	}
 
 	if (!res->name) {
@@ -141,67 +216,136 @@ xmms_stream_type_parse (va_list ap)
 		res->priority = XMMS_STREAM_TYPE_PRIORITY_DEFAULT;
 	}
 
+	res->hash = compute_hash (res);
+
 	return res;
 }
 
 const char *
 xmms_stream_type_get_str (const xmms_stream_type_t *st, xmms_stream_type_key_t key)
 {
-	GList *n;
+	const xmms_stream_type_val_t *val;
 
 	if (key == XMMS_STREAM_TYPE_NAME) {
 		return st->name;
 	}
 
-	for (n = st->list; n; n = g_list_next (n)) {
-		xmms_stream_type_val_t *val = n->data;
-		if (val->key == key) {
-			if (val->type != STRING) {
-				XMMS_DBG ("Key passed to get_str is not string");
-				return NULL;
-			}
-			return val->d.string;
-		}
+	if (key < 0 || key >= XMMS_STREAM_TYPE_KEY_COUNT) {
+		return NULL;
 	}
-	return NULL;
+
+	val = &st->vals[key];
+	if (val->type == NONE) {
+		return NULL;
+	}
+
+	if (val->type != ATOM && val->type != STRING) {
+		XMMS_DBG ("Key passed to get_str is not string");
+		return NULL;
+	}
+
+	return val->string;
 }
 
 
 gint
 xmms_stream_type_get_int (const xmms_stream_type_t *st, xmms_stream_type_key_t key)
 {
-	GList *n;
+	const xmms_stream_type_val_t *val;
 
 	if (key == XMMS_STREAM_TYPE_PRIORITY) {
 		return st->priority;
 	}
 
-	for (n = st->list; n; n = g_list_next (n)) {
-		xmms_stream_type_val_t *val = n->data;
-		if (val->key == key) {
-			if (val->type != INT) {
-				XMMS_DBG ("Key passed to get_int is not int");
-				return -1;
-			}
-			return val->d.num;
-		}
+	if (key < 0 || key >= XMMS_STREAM_TYPE_KEY_COUNT) {
+		return -1;
 	}
-	return -1;
+
+	val = &st->vals[key];
+	if (val->type == NONE) {
+		return -1;
+	}
+
+	if (val->type != INT) {
+		XMMS_DBG ("Key passed to get_int is not int");
+		return -1;
+	}
+
+	return val->num;
 }
 
+/**
+ * Hash function for stream types, for use with GHashTable.
+ * Only the keys and values are considered, not name or priority.
+ */
+guint
+xmms_stream_type_hash (gconstpointer v)
+{
+	const xmms_stream_type_t *st = v;
 
+	return st->hash;
+}
 
+/**
+ * Check if two stream types have exactly the same keys and values,
+ * for use with GHashTable. Wildcards are compared literally.
+ */
+gboolean
+xmms_stream_type_equal (gconstpointer a, gconstpointer b)
+{
+	const xmms_stream_type_t *sa = a, *sb = b;
+	gint i;
+
+	if (sa == sb) {
+		return TRUE;
+	}
+
+	if (sa->hash != sb->hash || sa->keys != sb->keys) {
+		return FALSE;
+	}
+
+	for (i = 0; i < XMMS_STREAM_TYPE_KEY_COUNT; i++) {
+		const xmms_stream_type_val_t *va = &sa->vals[i], *vb = &sb->vals[i];
+
+		switch (va->type) {
+		case NONE:
+			break;
+		case ATOM:
+			if (va->string != vb->string)
+				return FALSE;
+			break;
+		case STRING:
+			if (strcmp (va->string, vb->string) != 0)
+				return FALSE;
+			break;
+		case INT:
+			if (va->num != vb->num)
+				return FALSE;
+			break;
+		}
+	}
+
+	return TRUE;
+}
 
 static gboolean
-match_val (xmms_stream_type_val_t *vin, xmms_stream_type_val_t *vout)
+match_val (const xmms_stream_type_val_t *vin, const xmms_stream_type_val_t *vout)
 {
 	if (vin->type != vout->type)
 		return FALSE;
 	switch (vin->type) {
+	case NONE:
+		return TRUE;
+	case ATOM:
+		if (!vin->pattern)
+			return vin->string == vout->string;
+		return g_pattern_match_string (vin->pattern, vout->string);
 	case STRING:
-		return g_pattern_match_simple (vin->d.string, vout->d.string);
+		if (!vin->pattern)
+			return strcmp (vin->string, vout->string) == 0;
+		return g_pattern_match_string (vin->pattern, vout->string);
 	case INT:
-		return vin->d.num == vout->d.num;
+		return vin->num == vout->num;
 	}
 	return FALSE;
 }
@@ -209,23 +353,16 @@ match_val (xmms_stream_type_val_t *vin, xmms_stream_type_val_t *vout)
 gboolean
 xmms_stream_type_match (const xmms_stream_type_t *in_type, const xmms_stream_type_t *out_type)
 {
-	GList *in;
-
-	for (in = in_type->list; in; in = g_list_next (in)) {
-		xmms_stream_type_val_t *inval = in->data;
-		GList *n;
-
-		for (n = out_type->list; n; n = g_list_next (n)) {
-			xmms_stream_type_val_t *outval = n->data;
-			if (inval->key == outval->key) {
-				if (!match_val (inval, outval))
-					return FALSE;
-				break;
-			}
+	guint keys;
+	gint i;
 
-		}
-		if (!n) {
-			/* didn't exist in out */
+	/* every key in in_type must exist in out_type */
+	if (in_type->keys & ~out_type->keys) {
+		return FALSE;
+	}
+
+	for (keys = in_type->keys, i = 0; keys; keys >>= 1, i++) {
+		if ((keys & 1) && !match_val (&in_type->vals[i], &out_type->vals[i])) {
 			return FALSE;
 		}
 	}
@@ -245,7 +382,9 @@ xmms_stream_type_coerce (const xmms_stream_type_t *in, const GList *goal_types)
 	gint bestscore = 100000;
 	gint format, samplerate, channels;
 	gint gformat, gsamplerate, gchannels;
-	const gchar *gmime;
+	const gchar *gmime, *pcm;
+
+	pcm = g_intern_static_string ("audio/pcm");
 
 	format = xmms_stream_type_get_int (in, XMMS_STREAM_TYPE_FMT_FORMAT);
 	samplerate = xmms_stream_type_get_int (in, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
@@ -262,7 +401,7 @@ xmms_stream_type_coerce (const xmms_stream_type_t *in, const GList *goal_types)
 		gint score = 0;
 
 		mime = xmms_stream_type_get_str (goal, XMMS_STREAM_TYPE_MIMETYPE);
-		if (strcmp (mime, "audio/pcm") != 0) {
+		if (mime != pcm) {
 			continue;
 		}
 
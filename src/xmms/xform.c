@@ -19,7 +19,9 @@
  * xforms
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "xmmspriv/xmms_plugin.h"
 #include "xmmspriv/xmms_xform.h"
@@ -27,6 +29,7 @@
 #include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_utils.h"
 #include "xmmspriv/xmms_xform_plugin.h"
+#include "xmmspriv/xmms_stats.h"
 #include "xmms/xmms_ipc.h"
 #include "xmms/xmms_log.h"
 #include "xmms/xmms_object.h"
@@ -53,6 +56,9 @@ struct xmms_xform_St {
 	gboolean eos;
 	gboolean error;
 
+	/** position in samples this chain was parked at, -1 if it wasn't */
+	gint64 parked_at;
+
 	char *buffer;
 	gint buffered;
 	gint buffersize;
@@ -76,6 +82,72 @@ struct xmms_xform_St {
 	} lr;
 };
 
+/** Upper bound on the number of stream types with a cached route */
+#define XMMS_XFORM_ROUTE_CACHE_MAX 256
+
+/**
+ * The plugins accepting a stream type, best first. Routes are cached
+ * by stream type so that setting up a chain doesn't have
+ * to ask every plugin about the same handful of types over and over.
+ */
+typedef struct xmms_xform_route_St {
+	GList *candidates;
+	/** How long it took to find the candidates, in microseconds */
+	glong cost;
+} xmms_xform_route_t;
+
+typedef struct xmms_xform_candidate_St {
+	xmms_xform_plugin_t *plugin;
+	gint priority;
+} xmms_xform_candidate_t;
+
+static GMutex *route_lock;
+static GHashTable *route_cache;
+static guint route_hits;
+static guint route_misses;
+static guint64 route_saved;
+
+static xmms_stats_histogram_t *chain_setup_time;
+static xmms_stats_counter_t *chain_setup_failures;
+static xmms_stats_counter_t *chain_resumes;
+
+/** Upper bound on the number of urls with a cached listing */
+#define XMMS_XFORM_BROWSE_CACHE_MAX 64
+
+/**
+ * A directory listing kept around for plugins that set a
+ * browse_cache_ttl, so that walking a slow network share
+ * doesn't list the same directories over and over.
+ */
+typedef struct xmms_xform_browse_cached_St {
+	GList *list;
+	time_t expires;
+} xmms_xform_browse_cached_t;
+
+static GMutex *browse_lock;
+static GHashTable *browse_cache;
+
+/** Upper bound on the number of parked chains */
+#define XMMS_XFORM_PARKED_MAX 4
+/** Seconds a parked chain is kept open waiting for its next segment */
+#define XMMS_XFORM_PARKED_TTL 30
+
+/**
+ * The decoding part of a chain whose segment played up to its stop
+ * frame. It is kept open so that the segment that starts at that
+ * frame, usually the next track of a cue sheet, continues with the
+ * same decoder instead of opening and seeking the file again.
+ */
+typedef struct xmms_xform_parked_St {
+	gchar *url;
+	gint stopframe;
+	xmms_xform_t *xform;
+	time_t expires;
+} xmms_xform_parked_t;
+
+static GMutex *parked_lock;
+static GList *parked_chains; /* newest first */
+
 typedef struct xmms_xform_hotspot_St {
 	guint pos;
 	gchar *key;
@@ -273,6 +345,89 @@ xmms_xform_browse_method (xmms_xform_t *xform, const gchar *url,
 	return list;
 }
 
+static GList *
+xmms_xform_browse_list_copy (GList *list)
+{
+	GList *n;
+
+	list = g_list_copy (list);
+	for (n = list; n; n = g_list_next (n)) {
+		xmmsv_ref (n->data);
+	}
+
+	return list;
+}
+
+static void
+xmms_xform_browse_cached_free (xmms_xform_browse_cached_t *cached)
+{
+	g_list_foreach (cached->list, (GFunc) xmmsv_unref, NULL);
+	g_list_free (cached->list);
+	g_free (cached);
+}
+
+static gint
+xmms_xform_browse_cache_ttl (xmms_xform_t *xform)
+{
+	xmms_config_property_t *val;
+
+	val = xmms_xform_config_lookup (xform, "browse_cache_ttl");
+	if (!val) {
+		return 0;
+	}
+
+	return xmms_config_property_get_int (val);
+}
+
+/**
+ * Look up a listing that hasn't expired yet.
+ *
+ * @returns TRUE and a new reference to the list in ret if found.
+ */
+static gboolean
+xmms_xform_browse_cache_lookup (const gchar *url, GList **ret)
+{
+	xmms_xform_browse_cached_t *cached;
+	gboolean found = FALSE;
+
+	g_mutex_lock (browse_lock);
+
+	cached = browse_cache ? g_hash_table_lookup (browse_cache, url) : NULL;
+	if (cached && cached->expires > time (NULL)) {
+		*ret = xmms_xform_browse_list_copy (cached->list);
+		found = TRUE;
+	} else if (cached) {
+		g_hash_table_remove (browse_cache, url);
+	}
+
+	g_mutex_unlock (browse_lock);
+
+	return found;
+}
+
+static void
+xmms_xform_browse_cache_insert (const gchar *url, GList *list, gint ttl)
+{
+	xmms_xform_browse_cached_t *cached;
+
+	cached = g_new0 (xmms_xform_browse_cached_t, 1);
+	cached->list = xmms_xform_browse_list_copy (list);
+	cached->expires = time (NULL) + ttl;
+
+	g_mutex_lock (browse_lock);
+
+	if (browse_cache) {
+		if (g_hash_table_size (browse_cache) >= XMMS_XFORM_BROWSE_CACHE_MAX) {
+			g_hash_table_remove_all (browse_cache);
+		}
+		g_hash_table_replace (browse_cache, g_strdup (url), cached);
+	} else {
+		xmms_xform_browse_cached_free (cached);
+	}
+
+	g_mutex_unlock (browse_lock);
+}
+
 GList *
 xmms_xform_browse (const gchar *url, xmms_error_t *error)
 {
@@ -280,6 +435,7 @@ xmms_xform_browse (const gchar *url, xmms_error_t *error)
 	gchar *durl;
 	xmms_xform_t *xform = NULL;
 	xmms_xform_t *xform2 = NULL;
+	gint ttl;
 
 	xform = xmms_xform_new (NULL, NULL, 0, NULL);
 
@@ -304,7 +460,16 @@ xmms_xform_browse (const gchar *url, xmms_error_t *error)
 		return NULL;
 	}
 
-	list = xmms_xform_browse_method (xform2, durl, error);
+	ttl = xmms_xform_browse_cache_ttl (xform2);
+
+	if (ttl > 0 && xmms_xform_browse_cache_lookup (durl, &list)) {
+		XMMS_DBG ("using cached listing of %s", durl);
+	} else {
+		list = xmms_xform_browse_method (xform2, durl, error);
+		if (ttl > 0 && xmms_error_isok (error)) {
+			xmms_xform_browse_cache_insert (durl, list, ttl);
+		}
+	}
 
 	xmms_object_unref (xform);
 	xmms_object_unref (xform2);
@@ -321,10 +486,41 @@ xmms_xform_client_browse (xmms_xform_object_t *obj, const gchar *url,
 	return xmms_xform_browse (url, error);
 }
 
+static void
+xmms_xform_route_free (xmms_xform_route_t *route)
+{
+	g_list_free (route->candidates);
+	g_free (route);
+}
+
+static void
+xmms_xform_parked_free (xmms_xform_parked_t *parked)
+{
+	xmms_object_unref (parked->xform);
+	g_free (parked->url);
+	g_free (parked);
+}
+
 static void
 xmms_xform_object_destroy (xmms_object_t *obj)
 {
 	xmms_xform_unregister_ipc_commands ();
+
+	g_mutex_lock (route_lock);
+	g_hash_table_destroy (route_cache);
+	route_cache = NULL;
+	g_mutex_unlock (route_lock);
+
+	g_mutex_lock (browse_lock);
+	g_hash_table_destroy (browse_cache);
+	browse_cache = NULL;
+	g_mutex_unlock (browse_lock);
+
+	g_mutex_lock (parked_lock);
+	g_list_foreach (parked_chains, (GFunc) xmms_xform_parked_free, NULL);
+	g_list_free (parked_chains);
+	parked_chains = NULL;
+	g_mutex_unlock (parked_lock);
 }
 
 xmms_xform_object_t *
@@ -336,11 +532,67 @@ xmms_xform_object_init (void)
 
 	xmms_xform_register_ipc_commands (XMMS_OBJECT (obj));
 
+	route_lock = g_mutex_new ();
+	route_cache = g_hash_table_new_full (xmms_stream_type_hash,
+	                                     xmms_stream_type_equal,
+	                                     (GDestroyNotify) __int_xmms_object_unref,
+	                                     (GDestroyNotify) xmms_xform_route_free);
+
+	browse_lock = g_mutex_new ();
+	browse_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                      (GDestroyNotify) xmms_xform_browse_cached_free);
+
+	parked_lock = g_mutex_new ();
+
 	effect_callbacks_init ();
 
+	chain_setup_time = xmms_stats_histogram_register ("xform.chain_setup_us");
+	chain_setup_failures = xmms_stats_counter_register ("xform.chain_setup_failures");
+	chain_resumes = xmms_stats_counter_register ("xform.chain_resumes");
+
 	return obj;
 }
 
+/**
+ * Forget all cached routes, needed whenever the set of plugins or
+ * their priorities change.
+ */
+void
+xmms_xform_route_cache_invalidate (void)
+{
+	if (!route_lock) {
+		return;
+	}
+
+	g_mutex_lock (route_lock);
+	if (route_cache) {
+		g_hash_table_remove_all (route_cache);
+	}
+	g_mutex_unlock (route_lock);
+}
+
+/**
+ * Get the route cache statistics.
+ *
+ * @param hits number of chain setup steps that found a cached route
+ * @param misses number of steps that had to ask the plugins
+ * @param saved_ms approximate time the cache has saved, in milliseconds
+ */
+void
+xmms_xform_route_stats_get (guint *hits, guint *misses, guint *saved_ms)
+{
+	if (!route_lock) {
+		*hits = *misses = *saved_ms = 0;
+		return;
+	}
+
+	g_mutex_lock (route_lock);
+	*hits = route_hits;
+	*misses = route_misses;
+	*saved_ms = MIN (route_saved / 1000, G_MAXINT32);
+	g_mutex_unlock (route_lock);
+}
+
 static void
 xmms_xform_destroy (xmms_object_t *object)
 {
@@ -383,6 +635,7 @@ xmms_xform_new (xmms_xform_plugin_t *plugin, xmms_xform_t *prev,
 	xform->plugin = plugin;
 	xform->entry = entry;
 	xform->goal_hints = goal_hints;
+	xform->parked_at = -1;
 	xform->lr.bufend = &xform->lr.buf[0];
 
 	if (prev) {
@@ -1141,9 +1394,8 @@ xmms_xform_get_url (xmms_xform_t *xform)
 
 
 typedef struct match_state_St {
-	xmms_xform_plugin_t *match;
 	xmms_stream_type_t *out_type;
-	gint priority;
+	GList *candidates;
 } match_state_t;
 
 static gboolean
@@ -1151,6 +1403,7 @@ xmms_xform_match (xmms_plugin_t *plugin, gpointer user_data)
 {
 	xmms_xform_plugin_t *xform_plugin = (xmms_xform_plugin_t *) plugin;
 	match_state_t *state = (match_state_t *) user_data;
+	xmms_xform_candidate_t *candidate;
 	gint priority = 0;
 
 	g_assert (plugin->type == XMMS_PLUGIN_TYPE_XFORM);
@@ -1163,37 +1416,145 @@ xmms_xform_match (xmms_plugin_t *plugin, gpointer user_data)
 	XMMS_DBG ("Plugin '%s' matched (priority %d)",
 	          xmms_plugin_shortname_get (plugin), priority);
 
-	if (priority > state->priority) {
-		if (state->match) {
-			xmms_plugin_t *previous_plugin = (xmms_plugin_t *) state->match;
-			XMMS_DBG ("Using plugin '%s' (priority %d) instead of '%s' (priority %d)",
-			          xmms_plugin_shortname_get (plugin), priority,
-			          xmms_plugin_shortname_get (previous_plugin),
-			          state->priority);
+	/* A negative priority disables the plugin for this type */
+	if (priority < 0) {
+		return TRUE;
+	}
+
+	candidate = g_new (xmms_xform_candidate_t, 1);
+	candidate->plugin = xform_plugin;
+	candidate->priority = priority;
+
+	state->candidates = g_list_append (state->candidates, candidate);
+
+	return TRUE;
+}
+
+static gint
+xmms_xform_candidate_compare (gconstpointer a, gconstpointer b)
+{
+	const xmms_xform_candidate_t *ca = a, *cb = b;
+
+	return cb->priority - ca->priority;
+}
+
+/**
+ * Ask every plugin whether it accepts a stream type.
+ *
+ * @returns the accepting plugins, best first. For equal priorities
+ * the plugin loaded first wins.
+ */
+static GList *
+xmms_xform_find_candidates (xmms_stream_type_t *out_type)
+{
+	match_state_t state;
+	GList *candidates, *ret = NULL, *n;
+
+	state.out_type = out_type;
+	state.candidates = NULL;
+
+	xmms_plugin_foreach (XMMS_PLUGIN_TYPE_XFORM, xmms_xform_match, &state);
+
+	/* g_list_sort is stable, which keeps plugin order on ties */
+	candidates = g_list_sort (state.candidates, xmms_xform_candidate_compare);
+
+	for (n = candidates; n; n = g_list_next (n)) {
+		xmms_xform_candidate_t *candidate = n->data;
+		ret = g_list_prepend (ret, candidate->plugin);
+		g_free (candidate);
+	}
+	g_list_free (candidates);
+
+	return g_list_reverse (ret);
+}
+
+static glong
+xmms_xform_elapsed_usec (GTimeVal *start)
+{
+	GTimeVal now;
+
+	g_get_current_time (&now);
+
+	return (now.tv_sec - start->tv_sec) * G_USEC_PER_SEC +
+	       (now.tv_usec - start->tv_usec);
+}
+
+/**
+ * Find the best plugin for a stream type, going through the route
+ * cache when possible. Types carrying an url are never cached as
+ * they are different for every single file.
+ */
+static xmms_xform_plugin_t *
+xmms_xform_route (xmms_stream_type_t *out_type)
+{
+	xmms_xform_plugin_t *plugin = NULL;
+	xmms_xform_route_t *route;
+	GTimeVal start;
+	GList *candidates;
+
+	if (!route_lock || xmms_stream_type_get_str (out_type, XMMS_STREAM_TYPE_URL)) {
+		candidates = xmms_xform_find_candidates (out_type);
+		if (candidates) {
+			plugin = candidates->data;
+		}
+		g_list_free (candidates);
+		return plugin;
+	}
+
+	g_mutex_lock (route_lock);
+	route = route_cache ? g_hash_table_lookup (route_cache, out_type) : NULL;
+	if (route) {
+		if (route->candidates) {
+			plugin = route->candidates->data;
 		}
+		route_hits++;
+		route_saved += route->cost;
+		g_mutex_unlock (route_lock);
 
-		state->match = xform_plugin;
-		state->priority = priority;
+		return plugin;
 	}
+	g_mutex_unlock (route_lock);
 
-	return TRUE;
+	g_get_current_time (&start);
+	candidates = xmms_xform_find_candidates (out_type);
+
+	route = g_new0 (xmms_xform_route_t, 1);
+	route->candidates = candidates;
+	route->cost = MAX (xmms_xform_elapsed_usec (&start), 0);
+
+	if (candidates) {
+		plugin = candidates->data;
+	}
+
+	g_mutex_lock (route_lock);
+	route_misses++;
+	if (route_cache) {
+		if (g_hash_table_size (route_cache) >= XMMS_XFORM_ROUTE_CACHE_MAX) {
+			g_hash_table_remove_all (route_cache);
+		}
+		xmms_object_ref (out_type);
+		g_hash_table_replace (route_cache, out_type, route);
+	} else {
+		xmms_xform_route_free (route);
+	}
+	g_mutex_unlock (route_lock);
+
+	return plugin;
 }
 
 xmms_xform_t *
 xmms_xform_find (xmms_xform_t *prev, xmms_medialib_entry_t entry,
                  GList *goal_hints)
 {
-	match_state_t state;
+	xmms_xform_plugin_t *plugin;
 	xmms_xform_t *xform = NULL;
 
-	state.out_type = prev->out_type;
-	state.match = NULL;
-	state.priority = -1;
-
-	xmms_plugin_foreach (XMMS_PLUGIN_TYPE_XFORM, xmms_xform_match, &state);
+	plugin = xmms_xform_route (prev->out_type);
 
-	if (state.match) {
-		xform = xmms_xform_new (state.match, prev, entry, goal_hints);
+	if (plugin) {
+		XMMS_DBG ("Using plugin '%s'",
+		          xmms_plugin_shortname_get ((xmms_plugin_t *) plugin));
+		xform = xmms_xform_new (plugin, prev, entry, goal_hints);
 	} else {
 		XMMS_DBG ("Found no matching plugin...");
 	}
@@ -1287,6 +1648,68 @@ outdata_type_metadata_collect (xmms_xform_t *xform)
 	}
 }
 
+/* Split an url into the decoded location and its decoded arguments,
+ * which point into the returned string */
+static gchar *
+chain_url_split (const gchar *url, gchar **args)
+{
+	gchar *durl;
+
+	durl = g_strdup (url);
+
+	*args = strchr (durl, '?');
+	if (*args) {
+		**args = 0;
+		(*args)++;
+		xmms_medialib_decode_url (*args);
+	}
+	xmms_medialib_decode_url (durl);
+
+	return durl;
+}
+
+static void
+chain_args_set (xmms_xform_t *xform, const gchar *args)
+{
+	gchar **params;
+	gint i;
+
+	params = g_strsplit (args, "&", 0);
+
+	for (i = 0; params && params[i]; i++) {
+		gchar *v;
+		v = strchr (params[i], '=');
+		if (v) {
+			*v = 0;
+			v++;
+			xmms_xform_metadata_set_str (xform, params[i], v);
+		} else {
+			xmms_xform_metadata_set_int (xform, params[i], 1);
+		}
+	}
+	g_strfreev (params);
+}
+
+static gint
+chain_args_get_int (const gchar *args, const gchar *key)
+{
+	gchar **params;
+	gint i, len, ret = -1;
+
+	params = g_strsplit (args, "&", 0);
+	len = strlen (key);
+
+	for (i = 0; params && params[i]; i++) {
+		if (strncmp (params[i], key, len) == 0 && params[i][len] == '=') {
+			ret = strtol (params[i] + len + 1, NULL, 10);
+			break;
+		}
+	}
+	g_strfreev (params);
+
+	return ret;
+}
+
 static xmms_xform_t *
 chain_setup (xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats)
 {
@@ -1299,32 +1722,10 @@ chain_setup (xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats)
 
 	xform = xmms_xform_new (NULL, NULL, 0, goal_formats);
 
-	durl = g_strdup (url);
-
-	args = strchr (durl, '?');
+	durl = chain_url_split (url, &args);
 	if (args) {
-		gchar **params;
-		gint i;
-		*args = 0;
-		args++;
-		xmms_medialib_decode_url (args);
-
-		params = g_strsplit (args, "&", 0);
-
-		for (i = 0; params && params[i]; i++) {
-			gchar *v;
-			v = strchr (params[i], '=');
-			if (v) {
-				*v = 0;
-				v++;
-				xmms_xform_metadata_set_str (xform, params[i], v);
-			} else {
-				xmms_xform_metadata_set_int (xform, params[i], 1);
-			}
-		}
-		g_strfreev (params);
+		chain_args_set (xform, args);
 	}
-	xmms_medialib_decode_url (durl);
 
 	xmms_xform_outdata_type_add (xform, XMMS_STREAM_TYPE_MIMETYPE,
 	                             "application/x-url", XMMS_STREAM_TYPE_URL,
@@ -1401,9 +1802,187 @@ xmms_xform_chain_setup (xmms_medialib_entry_t entry, GList *goal_formats,
 	return xform;
 }
 
-xmms_xform_t *
-xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
-                            GList *goal_formats, gboolean rehash)
+/* Unlink the parked chains that expired or don't fit anymore, to be
+ * freed by the caller once it has let go of parked_lock */
+static GList *
+xmms_xform_parked_expire (void)
+{
+	GList *n, *next, *ret = NULL;
+	time_t now;
+	gint kept = 0;
+
+	now = time (NULL);
+
+	for (n = parked_chains; n; n = next) {
+		xmms_xform_parked_t *parked = n->data;
+
+		next = g_list_next (n);
+
+		if (parked->expires > now && kept < XMMS_XFORM_PARKED_MAX) {
+			kept++;
+			continue;
+		}
+
+		parked_chains = g_list_delete_link (parked_chains, n);
+		ret = g_list_prepend (ret, parked);
+	}
+
+	return ret;
+}
+
+static void
+xmms_xform_parked_free_list (GList *list)
+{
+	g_list_foreach (list, (GFunc) xmms_xform_parked_free, NULL);
+	g_list_free (list);
+}
+
+/**
+ * Keep the chain before a segment xform that played up to its stop
+ * frame open, so that the segment starting at that frame can
+ * continue where it stopped. Segments not split at CD frames
+ * aren't parked, there is no telling which one comes next.
+ *
+ * @param xform the segment xform, about to be destroyed
+ * @param position where the chain before it is, in samples
+ */
+void
+xmms_xform_chain_park (xmms_xform_t *xform, gint64 position)
+{
+	xmms_xform_parked_t *parked;
+	const gchar *url, *stopframe;
+	GList *expired;
+
+	g_return_if_fail (xform->prev);
+
+	if (xform->prev->eos || xform->prev->error) {
+		return;
+	}
+
+	url = xmms_xform_get_url (xform);
+	if (!url) {
+		return;
+	}
+
+	if (!xmms_xform_metadata_get_str (xform,
+	                                  XMMS_MEDIALIB_ENTRY_PROPERTY_STOPFRAME,
+	                                  &stopframe)) {
+		return;
+	}
+
+	parked = g_new0 (xmms_xform_parked_t, 1);
+	parked->url = g_strdup (url);
+	parked->stopframe = strtol (stopframe, NULL, 10);
+	parked->xform = xform->prev;
+	parked->expires = time (NULL) + XMMS_XFORM_PARKED_TTL;
+
+	xmms_object_ref (parked->xform);
+	parked->xform->parked_at = position;
+
+	XMMS_DBG ("Parking chain for '%s' at frame %d", url, parked->stopframe);
+
+	g_mutex_lock (parked_lock);
+	parked_chains = g_list_prepend (parked_chains, parked);
+	expired = xmms_xform_parked_expire ();
+	g_mutex_unlock (parked_lock);
+
+	xmms_xform_parked_free_list (expired);
+}
+
+/**
+ * Get the position the chain before a segment xform was parked at.
+ * Only answers once, the position is stale as soon as the segment
+ * starts reading.
+ *
+ * @returns the position in samples, or -1 if the chain was set up
+ * from scratch
+ */
+gint64
+xmms_xform_chain_resumed_at (xmms_xform_t *xform)
+{
+	gint64 ret;
+
+	g_return_val_if_fail (xform->prev, -1);
+
+	ret = xform->prev->parked_at;
+	xform->prev->parked_at = -1;
+
+	return ret;
+}
+
+/* Pick up the chain parked by the segment that stopped where the
+ * segment in url starts, if there is one */
+static xmms_xform_t *
+chain_resume (xmms_medialib_entry_t entry, const gchar *url,
+              GList *goal_formats)
+{
+	xmms_xform_parked_t *parked = NULL;
+	xmms_xform_t *last, *x;
+	gchar *durl, *args;
+	GList *n, *expired;
+	gint startframe = -1;
+
+	durl = chain_url_split (url, &args);
+	if (args) {
+		startframe = chain_args_get_int (args,
+		                                 XMMS_MEDIALIB_ENTRY_PROPERTY_STARTFRAME);
+	}
+
+	if (startframe < 0) {
+		g_free (durl);
+		return NULL;
+	}
+
+	g_mutex_lock (parked_lock);
+	expired = xmms_xform_parked_expire ();
+	for (n = parked_chains; n; n = g_list_next (n)) {
+		xmms_xform_parked_t *p = n->data;
+
+		if (p->stopframe == startframe && strcmp (p->url, durl) == 0 &&
+		    has_goalformat (p->xform, goal_formats)) {
+			parked_chains = g_list_delete_link (parked_chains, n);
+			parked = p;
+			break;
+		}
+	}
+	g_mutex_unlock (parked_lock);
+
+	xmms_xform_parked_free_list (expired);
+
+	if (!parked) {
+		g_free (durl);
+		return NULL;
+	}
+
+	XMMS_DBG ("Resuming chain for '%s' at frame %d", durl, startframe);
+	xmms_stats_counter_inc (chain_resumes);
+
+	last = parked->xform;
+	g_free (parked->url);
+	g_free (parked);
+
+	/* The chain plays the new entry now, and everything it knows
+	 * about the file goes into that entry too. Only the url
+	 * arguments differ between the segments. */
+	for (x = last; x; x = x->prev) {
+		x->entry = entry;
+		x->goal_hints = goal_formats;
+		x->metadata_changed = TRUE;
+
+		if (!x->prev) {
+			g_hash_table_remove_all (x->metadata);
+			chain_args_set (x, args);
+		}
+	}
+
+	g_free (durl);
+
+	return last;
+}
+
+static xmms_xform_t *
+chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
+                 GList *goal_formats, gboolean rehash)
 {
 	xmms_xform_t *last;
 	xmms_plugin_t *plugin;
@@ -1411,9 +1990,16 @@ xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
 	gboolean add_segment = FALSE;
 	gint priority;
 
-	last = chain_setup (entry, url, goal_formats);
+	last = NULL;
+	if (!rehash) {
+		last = chain_resume (entry, url, goal_formats);
+	}
+
 	if (!last) {
-		return NULL;
+		last = chain_setup (entry, url, goal_formats);
+		if (!last) {
+			return NULL;
+		}
 	}
 
 	/* first check that segment plugin is available in the system */
@@ -1449,6 +2035,25 @@ xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
 	return last;
 }
 
+xmms_xform_t *
+xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
+                            GList *goal_formats, gboolean rehash)
+{
+	xmms_xform_t *xform;
+	gint64 start;
+
+	start = xmms_stats_time ();
+
+	xform = chain_setup_url (entry, url, goal_formats, rehash);
+	if (xform) {
+		xmms_stats_histogram_add_since (chain_setup_time, start);
+	} else {
+		xmms_stats_counter_inc (chain_setup_failures);
+	}
+
+	return xform;
+}
+
 xmms_config_property_t *
 xmms_xform_config_lookup (xmms_xform_t *xform, const gchar *path)
 {
@@ -75,6 +75,13 @@ xmms_xform_plugin_verify (xmms_plugin_t *_plugin)
 	return TRUE;
 }
 
+static void
+on_xform_priority_changed (xmms_object_t *object, xmmsv_t *_data,
+                           gpointer udata)
+{
+	xmms_xform_route_cache_invalidate ();
+}
+
 void
 xmms_xform_plugin_indata_add (xmms_xform_plugin_t *plugin, ...)
 {
@@ -93,10 +100,14 @@ xmms_xform_plugin_indata_add (xmms_xform_plugin_t *plugin, ...)
 	priority = xmms_stream_type_get_int (t, XMMS_STREAM_TYPE_PRIORITY);
 	g_snprintf (config_value, sizeof (config_value), "%d", priority);
 	xmms_xform_plugin_config_property_register (plugin, config_key,
-	                                            config_value, NULL, NULL);
+	                                            config_value,
+	                                            on_xform_priority_changed,
+	                                            NULL);
 	g_free (config_key);
 
 	plugin->in_types = g_list_prepend (plugin->in_types, t);
+
+	xmms_xform_route_cache_invalidate ();
 }
 
 gboolean
@@ -0,0 +1,473 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file AirPlay streaming benchmark.
+ *
+ * Measures the CPU time the AirPlay output spends per second of audio.
+ * The packing and encryption steps are timed on their own, next to
+ * the bit writer and the one-packet-at-a-time AES they replaced, and
+ * then the RAOP client streams to a stand-in receiver running in a
+ * forked process, which answers the RTSP handshake and reads the
+ * audio as fast as it arrives.
+ *
+ * The number of seconds of audio to stream can be given on the command
+ * line. Results are printed one per line as
+ * "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <glib.h>
+
+#include <openssl/aes.h>
+
+#include "raop_client.h"
+#include "raop_packet.h"
+
+#define DEFAULT_SECONDS 120
+#define PACK_PASSES 2000
+#define BATCH 4
+#define BYTES_PER_SECOND (44100 * RAOP_ALAC_NUM_CHANNELS * \
+                          RAOP_ALAC_BITS_PER_SAMPLE / 8)
+
+static const guint8 key[16] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+                                0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 };
+static const guint8 iv[16] = { 0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+                               0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0 };
+
+static gdouble
+cpu_ms (void)
+{
+	struct rusage ru;
+
+	getrusage (RUSAGE_SELF, &ru);
+
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 +
+	       (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+static void
+report (const gchar *name, gdouble ms, guint packets)
+{
+	gdouble audio_s = (gdouble) packets * RAOP_PACKET_PCM_SIZE / BYTES_PER_SECOND;
+
+	printf ("%s\ttotal_ms\t%.2f\n", name, ms);
+	printf ("%s\tcpu_per_audio_s_ms\t%.4f\n", name, ms / audio_s);
+}
+
+static void
+fill_noise (guint16 *buf, gint count)
+{
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		buf[i] = g_random_int ();
+	}
+}
+
+/* the bit writer the packets used to be put together with */
+static void
+write_bits (guint8 *buf, guint8 val, gint nbits, guint32 *offset)
+{
+	int bit_offset = *offset % 8;
+	int byte_offset = *offset / 8;
+	int left = 8 - bit_offset;
+
+	*offset += nbits;
+	if (nbits >= left) {
+		buf[byte_offset] |= (val >> (nbits - left));
+		val = (val << left) >> left;
+		nbits -= left;
+		left = 8;
+		byte_offset++;
+	}
+	if (nbits && nbits < left) {
+		buf[byte_offset] |= (val << (left - nbits));
+	}
+}
+
+static void
+bit_writer_pack (raop_packet_t *packet, const guint16 *buf, guint32 len)
+{
+	guint8 *pbuf = packet->data + RAOP_PACKET_HEADER_SIZE;
+	guint32 offset = 0;
+	gint i;
+
+	memset (packet->data, 0, sizeof (packet->data));
+
+	write_bits (pbuf, 1, 3, &offset);
+	write_bits (pbuf, 0, 4, &offset);
+	write_bits (pbuf, 0, 4, &offset);
+	write_bits (pbuf, 0, 8, &offset);
+	write_bits (pbuf, 0, 1, &offset);
+	write_bits (pbuf, 0, 2, &offset);
+	write_bits (pbuf, 1, 1, &offset);
+
+	for (i = 0; i < len / 2; i++) {
+		write_bits (pbuf, buf[i] >> 8, 8, &offset);
+		write_bits (pbuf, buf[i] & 0xff, 8, &offset);
+	}
+
+	packet->size = RAOP_PACKET_HEADER_SIZE + len + RAOP_PACKET_ALAC_OVERHEAD;
+}
+
+static void
+bench_pack (guint passes)
+{
+	guint16 samples[RAOP_PACKET_PCM_SIZE / 2];
+	raop_packet_t *packet;
+	gdouble start;
+	guint n;
+
+	packet = g_new (raop_packet_t, 1);
+	fill_noise (samples, G_N_ELEMENTS (samples));
+
+	start = cpu_ms ();
+	for (n = 0; n < passes; n++) {
+		bit_writer_pack (packet, samples, sizeof (samples));
+	}
+	report ("pack_bit_writer", cpu_ms () - start, passes);
+
+	start = cpu_ms ();
+	for (n = 0; n < passes; n++) {
+		raop_packet_pack (packet, samples, sizeof (samples));
+	}
+	report ("pack_word", cpu_ms () - start, passes);
+
+	g_free (packet);
+}
+
+static void
+bench_encrypt (guint passes)
+{
+	guint16 samples[RAOP_PACKET_PCM_SIZE / 2];
+	raop_packet_t *packets, *batch[BATCH];
+	raop_packet_cipher_t *cipher;
+	AES_KEY aes_key;
+	guint8 aes_iv[16];
+	gdouble start;
+	guint n;
+	gint i, len;
+
+	packets = g_new (raop_packet_t, BATCH);
+	for (i = 0; i < BATCH; i++) {
+		fill_noise (samples, G_N_ELEMENTS (samples));
+		raop_packet_pack (&packets[i], samples, sizeof (samples));
+		batch[i] = &packets[i];
+	}
+	len = (packets[0].size - RAOP_PACKET_HEADER_SIZE) / 16 * 16;
+
+	AES_set_encrypt_key (key, 128, &aes_key);
+	start = cpu_ms ();
+	for (n = 0; n < passes; n++) {
+		memcpy (aes_iv, iv, sizeof (aes_iv));
+		AES_cbc_encrypt (packets[n % BATCH].data + RAOP_PACKET_HEADER_SIZE,
+		                 packets[n % BATCH].data + RAOP_PACKET_HEADER_SIZE,
+		                 len, &aes_key, aes_iv, AES_ENCRYPT);
+	}
+	report ("aes_cbc_encrypt", cpu_ms () - start, passes);
+
+	cipher = raop_packet_cipher_new (key, iv);
+
+	start = cpu_ms ();
+	for (n = 0; n < passes; n++) {
+		raop_packet_encrypt (cipher, &batch[n % BATCH], 1);
+	}
+	report ("evp_single", cpu_ms () - start, passes);
+
+	start = cpu_ms ();
+	for (n = 0; n < passes; n += BATCH) {
+		raop_packet_encrypt (cipher, batch, BATCH);
+	}
+	report ("evp_batch", cpu_ms () - start, n);
+
+	raop_packet_cipher_free (cipher);
+	g_free (packets);
+}
+
+/* Stand-in receiver */
+
+static int
+listen_any (gushort *port)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof (addr);
+	int fd, one = 1;
+
+	fd = socket (AF_INET, SOCK_STREAM, 0);
+	setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+	    listen (fd, 1) < 0) {
+		close (fd);
+		return -1;
+	}
+
+	getsockname (fd, (struct sockaddr *) &addr, &len);
+	*port = ntohs (addr.sin_port);
+
+	return fd;
+}
+
+/* Answer one request waiting in buf, if it's all there. Returns the
+ * number of bytes used up, or 0 if more is needed */
+static gsize
+receiver_reply (int fd, GString *buf, gushort stream_port)
+{
+	gchar *end, *hdr, *reply, *transport = NULL;
+	gsize used;
+	gint cseq = 0, length = 0;
+
+	end = strstr (buf->str, "\r\n\r\n");
+	if (!end)
+		return 0;
+
+	used = end + 4 - buf->str;
+	if ((hdr = strstr (buf->str, "Content-Length: ")) && hdr < end)
+		length = atoi (hdr + strlen ("Content-Length: "));
+	if (buf->len < used + length)
+		return 0;
+	used += length;
+
+	if ((hdr = strstr (buf->str, "CSeq: ")) && hdr < end)
+		cseq = atoi (hdr + strlen ("CSeq: "));
+
+	if (g_str_has_prefix (buf->str, "SETUP "))
+		transport = g_strdup_printf ("Transport: RTP/AVP/TCP;unicast;"
+		                            "mode=record;server_port=%d\r\n",
+		                            stream_port);
+
+	reply = g_strdup_printf ("RTSP/1.0 200 OK\r\n"
+	                         "CSeq: %d\r\n"
+	                         "Audio-Jack-Status: connected; type=analog\r\n"
+	                         "%s\r\n", cseq, transport ? transport : "");
+	write (fd, reply, strlen (reply));
+
+	g_free (transport);
+	g_free (reply);
+
+	return used;
+}
+
+/* Runs in the child. Returns the number of stream bytes read */
+static guint64
+receiver (int rtsp_listen, int stream_listen, gushort stream_port)
+{
+	struct pollfd fds[2];
+	GString *request;
+	guint64 received = 0;
+	gchar buf[65536];
+	gsize used;
+	gint n;
+
+	fds[0].fd = accept (rtsp_listen, NULL, NULL);
+	fds[0].events = POLLIN;
+	fds[1].fd = stream_listen;
+	fds[1].events = POLLIN;
+
+	request = g_string_new ("");
+
+	while (fds[0].fd != -1 || fds[1].fd != -1) {
+		if (poll (fds, 2, 10000) <= 0)
+			break;
+
+		if (fds[0].revents) {
+			n = read (fds[0].fd, buf, sizeof (buf));
+			if (n <= 0) {
+				close (fds[0].fd);
+				fds[0].fd = -1;
+			} else {
+				g_string_append_len (request, buf, n);
+				while ((used = receiver_reply (fds[0].fd, request,
+				                               stream_port))) {
+					g_string_erase (request, 0, used);
+				}
+			}
+		}
+
+		if (fds[1].revents && fds[1].fd == stream_listen) {
+			fds[1].fd = accept (stream_listen, NULL, NULL);
+		} else if (fds[1].revents) {
+			n = read (fds[1].fd, buf, sizeof (buf));
+			if (n <= 0) {
+				close (fds[1].fd);
+				fds[1].fd = -1;
+			} else {
+				received += n;
+			}
+		}
+	}
+
+	g_string_free (request, TRUE);
+
+	return received;
+}
+
+/* Client side */
+
+typedef struct {
+	guint packets;
+	guint wanted;
+	gboolean done;
+} source_t;
+
+static int
+source_cb (void *arg, guchar *buf, int len)
+{
+	source_t *source = (source_t *) arg;
+
+	if (source->packets == source->wanted) {
+		source->done = TRUE;
+		return -1;
+	}
+
+	/* the audio itself doesn't matter, leave what was there */
+	source->packets++;
+	return len;
+}
+
+static gint
+bench_stream (guint seconds)
+{
+	raop_client_t *rc;
+	source_t source = { 0 };
+	fd_set rfds, wfds;
+	struct timeval timeout;
+	gushort rtsp_port, stream_port;
+	int rtsp_listen, stream_listen;
+	int rtsp_fd, stream_fd, ready_fd, max_fd;
+	gdouble start, elapsed;
+	guint64 expected;
+	gint status, ret;
+	pid_t pid;
+
+	source.wanted = (guint64) seconds * BYTES_PER_SECOND / RAOP_PACKET_PCM_SIZE;
+	expected = (guint64) source.wanted * (RAOP_PACKET_MAX_SIZE);
+
+	rtsp_listen = listen_any (&rtsp_port);
+	stream_listen = listen_any (&stream_port);
+	if (rtsp_listen < 0 || stream_listen < 0) {
+		fprintf (stderr, "stream: could not listen\n");
+		return -1;
+	}
+
+	pid = fork ();
+	if (pid == 0) {
+		_exit (receiver (rtsp_listen, stream_listen, stream_port) == expected
+		       ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	close (rtsp_listen);
+	close (stream_listen);
+
+	raop_client_init (&rc);
+	raop_client_set_stream_cb (rc, source_cb, &source);
+
+	start = cpu_ms ();
+
+	ret = raop_client_connect (rc, "127.0.0.1", rtsp_port);
+	while (ret == RAOP_EOK) {
+		FD_ZERO (&rfds);
+		FD_ZERO (&wfds);
+		timeout.tv_sec = 5;
+		timeout.tv_usec = 0;
+
+		rtsp_fd = raop_client_rtsp_sock (rc);
+		stream_fd = raop_client_stream_sock (rc);
+		ready_fd = raop_client_ready_sock (rc);
+		if (raop_client_can_read (rc, rtsp_fd))
+			FD_SET (rtsp_fd, &rfds);
+		if (raop_client_can_write (rc, rtsp_fd))
+			FD_SET (rtsp_fd, &wfds);
+		if (raop_client_can_read (rc, stream_fd))
+			FD_SET (stream_fd, &rfds);
+		if (raop_client_can_write (rc, stream_fd))
+			FD_SET (stream_fd, &wfds);
+		else if (source.done)
+			timeout.tv_sec = 1; /* nothing more should be coming */
+		if (raop_client_can_read (rc, ready_fd))
+			FD_SET (ready_fd, &rfds);
+
+		max_fd = MAX (MAX (rtsp_fd, stream_fd), ready_fd);
+		ret = select (max_fd + 1, &rfds, &wfds, NULL, &timeout);
+		if (ret <= 0) {
+			ret = source.done ? RAOP_EOK : RAOP_EIO;
+			break;
+		}
+
+		ret = RAOP_EOK;
+		if (FD_ISSET (ready_fd, &rfds))
+			ret = raop_client_handle_io (rc, ready_fd, G_IO_IN);
+		if (FD_ISSET (rtsp_fd, &rfds))
+			ret = raop_client_handle_io (rc, rtsp_fd, G_IO_IN);
+		if (ret == RAOP_EOK && FD_ISSET (rtsp_fd, &wfds))
+			ret = raop_client_handle_io (rc, rtsp_fd, G_IO_OUT);
+		if (stream_fd != -1 && ret == RAOP_EOK) {
+			if (FD_ISSET (stream_fd, &rfds))
+				ret = raop_client_handle_io (rc, stream_fd, G_IO_IN);
+			if (FD_ISSET (stream_fd, &wfds))
+				ret = raop_client_handle_io (rc, stream_fd, G_IO_OUT);
+		}
+	}
+
+	elapsed = cpu_ms () - start;
+
+	raop_client_disconnect (rc);
+	raop_client_destroy (rc);
+
+	waitpid (pid, &status, 0);
+	if (ret != RAOP_EOK || !WIFEXITED (status) ||
+	    WEXITSTATUS (status) != EXIT_SUCCESS) {
+		fprintf (stderr, "stream: receiver didn't get all the audio\n");
+		return -1;
+	}
+
+	report ("stream", elapsed, source.packets);
+
+	return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+	guint seconds = DEFAULT_SECONDS;
+
+	if (argc > 1) {
+		seconds = atoi (argv[1]);
+	}
+
+	signal (SIGPIPE, SIG_IGN);
+	g_thread_init (NULL);
+
+	bench_pack (PACK_PASSES);
+	bench_encrypt (PACK_PASSES);
+
+	return bench_stream (seconds) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,498 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Collection query benchmark.
+ *
+ * Builds a synthetic medialib with the schema and indices of the real
+ * one, and for the kinds of collections clients send, times turning
+ * the collection into SQL with xmms_collection_get_query and running
+ * the result. The default library has 100k songs, pass -n 1000000 for
+ * the big one. Every song has its properties set by the server, and
+ * every tenth one has a title and duration from a plugin as well, so
+ * that the source preference has something to do.
+ *
+ * The made up data comes from a fixed seed so runs can be compared.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "xmmspriv/xmms_collquery.h"
+#include "xmmsc/xmmsv.h"
+#include "xmmsc/xmmsv_coll.h"
+
+#define DEFAULT_SONGS 100000
+#define DEFAULT_ROUNDS 5
+#define GEN_ITERATIONS 1000
+#define PLAYLIST_SIZE 10000
+#define WORDS 5000
+#define SEED 4711
+
+#define SOURCE_SERVER 1
+#define SOURCE_PLUGIN 2
+
+static const gchar *syllables[] = {
+	"ka", "lo", "mi", "ra", "ne", "to", "su", "vi", "de", "ba",
+	"zo", "pe", "li", "gu", "fa", "ho", "ri", "ma", "no", "se"
+};
+
+static const gchar *genres[] = {
+	"Rock", "Pop", "Jazz", "Classical", "Electronic", "Folk", "Metal", "Blues"
+};
+
+static gchar *words[WORDS];
+static GRand *rnd;
+
+typedef struct {
+	const gchar *name;
+	xmmsv_coll_t *coll;
+	guint limit_len;
+	xmmsv_t *order;
+	xmmsv_t *fetch;
+	xmmsv_t *group;
+} query_t;
+
+static void
+make_words (void)
+{
+	GString *word;
+	gint i, j, k;
+
+	for (i = 0; i < WORDS; i++) {
+		word = g_string_new (NULL);
+		for (j = g_rand_int_range (rnd, 2, 5); j > 0; j--) {
+			k = g_rand_int_range (rnd, 0, G_N_ELEMENTS (syllables));
+			g_string_append (word, syllables[k]);
+		}
+		words[i] = g_string_free (word, FALSE);
+	}
+}
+
+static gchar *
+random_words (gint count)
+{
+	GString *str;
+	gint i;
+
+	str = g_string_new (NULL);
+	for (i = 0; i < count; i++) {
+		if (i) {
+			g_string_append_c (str, ' ');
+		}
+		g_string_append (str, words[g_rand_int_range (rnd, 0, WORDS)]);
+	}
+
+	return g_string_free (str, FALSE);
+}
+
+/* The server prefers its own values over the ones from plugins */
+static void
+source_pref (sqlite3_context *context, int args, sqlite3_value **val)
+{
+	sqlite3_result_int (context,
+	                    sqlite3_value_int (val[0]) == SOURCE_SERVER ? 0 : 1);
+}
+
+static void
+insert_str (sqlite3_stmt *stm, gint id, const gchar *key, gchar *value,
+            gint source)
+{
+	sqlite3_bind_int (stm, 1, id);
+	sqlite3_bind_text (stm, 2, key, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stm, 3, value, -1, g_free);
+	sqlite3_bind_int (stm, 4, source);
+	sqlite3_bind_null (stm, 5);
+	sqlite3_step (stm);
+	sqlite3_reset (stm);
+}
+
+/* Integers are stored as strings as well, like the medialib does */
+static void
+insert_int (sqlite3_stmt *stm, gint id, const gchar *key, gint value,
+            gint source)
+{
+	sqlite3_bind_int (stm, 1, id);
+	sqlite3_bind_text (stm, 2, key, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stm, 3, g_strdup_printf ("%d", value), -1, g_free);
+	sqlite3_bind_int (stm, 4, source);
+	sqlite3_bind_int (stm, 5, value);
+	sqlite3_step (stm);
+	sqlite3_reset (stm);
+}
+
+static void
+fill (sqlite3 *sql, gint songs)
+{
+	sqlite3_stmt *stm;
+	gchar *artist = NULL, *album = NULL;
+	gint id, track = 0;
+
+	sqlite3_exec (sql,
+	              "CREATE TABLE Media (id INTEGER, key, value, source INTEGER, "
+	                                  "intval INTEGER DEFAULT NULL);"
+	              "CREATE UNIQUE INDEX key_idx ON Media (id, key, source);"
+	              "CREATE TABLE Sources (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+	                                    "source);"
+	              "INSERT INTO Sources (source) VALUES ('server');"
+	              "INSERT INTO Sources (source) VALUES ('plugin/id3v2');",
+	              NULL, NULL, NULL);
+
+	sqlite3_prepare_v2 (sql, "INSERT INTO Media VALUES (?, ?, ?, ?, ?)",
+	                    -1, &stm, NULL);
+
+	sqlite3_exec (sql, "BEGIN", NULL, NULL, NULL);
+	for (id = 1; id <= songs; id++) {
+		/* albums of twelve songs, artists of a few albums */
+		if (id % 12 == 1) {
+			if (g_rand_int_range (rnd, 0, 3) == 0 || !artist) {
+				g_free (artist);
+				artist = random_words (2);
+			}
+			g_free (album);
+			album = random_words (g_rand_int_range (rnd, 1, 4));
+			track = 0;
+		}
+		track++;
+
+		insert_str (stm, id, "url",
+		            g_strdup_printf ("file:///music/%d/%d.mp3", id / 12, id),
+		            SOURCE_SERVER);
+		insert_str (stm, id, "artist", g_strdup (artist), SOURCE_SERVER);
+		insert_str (stm, id, "album", g_strdup (album), SOURCE_SERVER);
+		insert_str (stm, id, "title",
+		            random_words (g_rand_int_range (rnd, 1, 5)), SOURCE_SERVER);
+		insert_str (stm, id, "genre",
+		            g_strdup (genres[(id / 12) % G_N_ELEMENTS (genres)]),
+		            SOURCE_SERVER);
+		insert_int (stm, id, "tracknr", track, SOURCE_SERVER);
+		insert_int (stm, id, "duration",
+		            g_rand_int_range (rnd, 60000, 600000), SOURCE_SERVER);
+		insert_int (stm, id, "bitrate", 192000, SOURCE_SERVER);
+		insert_int (stm, id, "added", 1300000000 + id, SOURCE_SERVER);
+		insert_int (stm, id, "status", 1, SOURCE_SERVER);
+
+		if (id % 10 == 0) {
+			insert_str (stm, id, "title", random_words (2), SOURCE_PLUGIN);
+			insert_int (stm, id, "duration",
+			            g_rand_int_range (rnd, 60000, 600000), SOURCE_PLUGIN);
+		}
+	}
+	sqlite3_exec (sql, "COMMIT", NULL, NULL, NULL);
+
+	sqlite3_finalize (stm);
+	g_free (album);
+	g_free (artist);
+
+	sqlite3_exec (sql,
+	              "CREATE INDEX id_key_value_1x ON Media (id, key, value COLLATE BINARY);"
+	              "CREATE INDEX id_key_value_2x ON Media (id, key, value COLLATE NOCASE);"
+	              "CREATE INDEX key_value_1x ON Media (key, value COLLATE BINARY);"
+	              "CREATE INDEX key_value_2x ON Media (key, value COLLATE NOCASE);"
+	              "ANALYZE;",
+	              NULL, NULL, NULL);
+}
+
+static gchar *
+first_value (sqlite3 *sql, const gchar *query)
+{
+	sqlite3_stmt *stm;
+	gchar *value = NULL;
+
+	sqlite3_prepare_v2 (sql, query, -1, &stm, NULL);
+	if (sqlite3_step (stm) == SQLITE_ROW) {
+		value = g_strdup ((const gchar *) sqlite3_column_text (stm, 0));
+	}
+	sqlite3_finalize (stm);
+
+	return value;
+}
+
+static xmmsv_coll_t *
+filter (xmmsv_coll_type_t type, const gchar *field, const gchar *value,
+        xmmsv_coll_t *operand)
+{
+	xmmsv_coll_t *coll;
+
+	coll = xmmsv_coll_new (type);
+	xmmsv_coll_attribute_set (coll, "field", field);
+	xmmsv_coll_attribute_set (coll, "value", value);
+	xmmsv_coll_add_operand (coll, operand);
+	xmmsv_coll_unref (operand);
+
+	return coll;
+}
+
+static xmmsv_t *
+strings (const gchar *first, ...)
+{
+	const gchar *s;
+	xmmsv_t *list;
+	va_list ap;
+
+	list = xmmsv_new_list ();
+
+	va_start (ap, first);
+	for (s = first; s; s = va_arg (ap, const gchar *)) {
+		xmmsv_list_append_string (list, s);
+	}
+	va_end (ap);
+
+	return list;
+}
+
+static void
+add_query (GPtrArray *queries, const gchar *name, xmmsv_coll_t *coll,
+           guint limit_len, xmmsv_t *order, xmmsv_t *fetch, xmmsv_t *group)
+{
+	query_t *q;
+
+	q = g_new0 (query_t, 1);
+	q->name = name;
+	q->coll = coll;
+	q->limit_len = limit_len;
+	q->order = order;
+	q->fetch = fetch;
+	q->group = group;
+
+	g_ptr_array_add (queries, q);
+}
+
+/* What clients ask for: sorting the library, browsing, searching and
+ * filtering a playlist */
+static GPtrArray *
+make_queries (sqlite3 *sql, gint songs)
+{
+	GPtrArray *queries;
+	xmmsv_coll_t *coll, *op, *playlist;
+	gchar *artist, *title, *stm, *pattern;
+	gint i;
+
+	queries = g_ptr_array_new ();
+
+	stm = g_strdup_printf ("SELECT value FROM Media WHERE id=%d AND "
+	                       "key='artist' AND source=%d", songs / 2, SOURCE_SERVER);
+	artist = first_value (sql, stm);
+	g_free (stm);
+
+	stm = g_strdup_printf ("SELECT value FROM Media WHERE id=%d AND "
+	                       "key='title' AND source=%d", songs / 3, SOURCE_SERVER);
+	title = first_value (sql, stm);
+	g_free (stm);
+
+	add_query (queries, "sort_library", xmmsv_coll_universe (), 0,
+	           strings ("artist", "album", "tracknr", NULL),
+	           strings ("id", NULL), strings (NULL));
+
+	add_query (queries, "page_titles", xmmsv_coll_universe (), 50,
+	           strings ("title", NULL),
+	           strings ("id", "artist", "title", NULL), strings (NULL));
+
+	add_query (queries, "browse_albums", xmmsv_coll_universe (), 0,
+	           strings ("artist", "album", NULL),
+	           strings ("artist", "album", NULL),
+	           strings ("artist", "album", NULL));
+
+	add_query (queries, "artist_equals",
+	           filter (XMMS_COLLECTION_TYPE_EQUALS, "artist", artist,
+	                   xmmsv_coll_universe ()), 0,
+	           strings ("album", "tracknr", NULL),
+	           strings ("id", "album", "title", NULL), strings (NULL));
+
+	/* a search for the first word of a title, with the wildcards a
+	 * client puts around it */
+	if (strchr (title, ' ')) {
+		*strchr (title, ' ') = '\0';
+	}
+	pattern = g_strdup_printf ("*%s*", title);
+	add_query (queries, "title_match",
+	           filter (XMMS_COLLECTION_TYPE_MATCH, "title", pattern,
+	                   xmmsv_coll_universe ()), 0,
+	           strings (NULL), strings ("id", NULL), strings (NULL));
+	g_free (pattern);
+
+	coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_INTERSECTION);
+	op = filter (XMMS_COLLECTION_TYPE_EQUALS, "genre", genres[0],
+	             xmmsv_coll_universe ());
+	xmmsv_coll_add_operand (coll, op);
+	xmmsv_coll_unref (op);
+	op = filter (XMMS_COLLECTION_TYPE_GREATER, "duration", "300000",
+	             xmmsv_coll_universe ());
+	xmmsv_coll_add_operand (coll, op);
+	xmmsv_coll_unref (op);
+	add_query (queries, "genre_and_long", coll, 0,
+	           strings ("-duration", NULL),
+	           strings ("id", "duration", NULL), strings (NULL));
+
+	playlist = xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+	for (i = 0; i < MIN (songs, PLAYLIST_SIZE); i++) {
+		xmmsv_coll_idlist_append (playlist, g_rand_int_range (rnd, 1, songs + 1));
+	}
+	add_query (queries, "playlist_sort", playlist, 0,
+	           strings ("artist", "album", "tracknr", NULL),
+	           strings ("id", NULL), strings (NULL));
+
+	g_free (title);
+	g_free (artist);
+
+	return queries;
+}
+
+static gint
+run_query (sqlite3 *sql, const gchar *query)
+{
+	sqlite3_stmt *stm;
+	gint rows = 0;
+
+	if (sqlite3_prepare_v2 (sql, query, -1, &stm, NULL) != SQLITE_OK) {
+		fprintf (stderr, "%s: %s\n", query, sqlite3_errmsg (sql));
+		exit (EXIT_FAILURE);
+	}
+
+	while (sqlite3_step (stm) == SQLITE_ROW) {
+		rows++;
+	}
+
+	sqlite3_finalize (stm);
+
+	return rows;
+}
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	const gdouble *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+static void
+run (sqlite3 *sql, query_t *q, gint rounds)
+{
+	GString *qstring = NULL;
+	gdouble *times;
+	GTimer *timer;
+	gint i, rows = 0;
+
+	times = g_new (gdouble, rounds);
+	timer = g_timer_new ();
+
+	g_timer_start (timer);
+	for (i = 0; i < GEN_ITERATIONS; i++) {
+		if (qstring) {
+			g_string_free (qstring, TRUE);
+		}
+		qstring = xmms_collection_get_query (NULL, q->coll, 0, q->limit_len,
+		                                     q->order, q->fetch, q->group);
+	}
+	printf ("%s\tgen_us\t%.2f\n", q->name,
+	        g_timer_elapsed (timer, NULL) * 1e6 / GEN_ITERATIONS);
+	printf ("%s\tquery_bytes\t%" G_GSIZE_FORMAT "\n", q->name, qstring->len);
+
+	if (sql) {
+		for (i = 0; i < rounds; i++) {
+			g_timer_start (timer);
+			rows = run_query (sql, qstring->str);
+			times[i] = g_timer_elapsed (timer, NULL) * 1000.0;
+		}
+
+		qsort (times, rounds, sizeof (gdouble), compare_doubles);
+
+		printf ("%s\texec_ms\t%.3f\n", q->name, times[rounds / 2]);
+		printf ("%s\trow_count\t%d\n", q->name, rows);
+	}
+
+	g_string_free (qstring, TRUE);
+	g_timer_destroy (timer);
+	g_free (times);
+}
+
+static void
+free_query (query_t *q)
+{
+	xmmsv_coll_unref (q->coll);
+	xmmsv_unref (q->order);
+	xmmsv_unref (q->fetch);
+	xmmsv_unref (q->group);
+	g_free (q);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint songs = DEFAULT_SONGS, rounds = DEFAULT_ROUNDS, opt, i;
+	gboolean generate_only = FALSE;
+	GPtrArray *queries;
+	GTimer *timer;
+	sqlite3 *sql;
+
+	while ((opt = getopt (argc, argv, "n:r:g")) != -1) {
+		switch (opt) {
+			case 'n':
+				songs = MAX (atoi (optarg), 12);
+				break;
+			case 'r':
+				rounds = MAX (atoi (optarg), 1);
+				break;
+			case 'g':
+				generate_only = TRUE;
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-n songs] [-r rounds] [-g]\n"
+				         "  -g  only time generating the queries\n",
+				         argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	g_thread_init (NULL);
+	rnd = g_rand_new_with_seed (SEED);
+
+	if (sqlite3_open (":memory:", &sql)) {
+		fprintf (stderr, "Could not open database: %s\n", sqlite3_errmsg (sql));
+		return EXIT_FAILURE;
+	}
+
+	sqlite3_create_function (sql, "xmms_source_pref", 1, SQLITE_UTF8, NULL,
+	                         source_pref, NULL, NULL);
+
+	make_words ();
+
+	timer = g_timer_new ();
+	fill (sql, songs);
+	printf ("setup\tsong_count\t%d\n", songs);
+	printf ("setup\tfill_ms\t%.3f\n", g_timer_elapsed (timer, NULL) * 1000.0);
+	g_timer_destroy (timer);
+
+	queries = make_queries (sql, songs);
+	for (i = 0; i < queries->len; i++) {
+		run (generate_only ? NULL : sql, g_ptr_array_index (queries, i), rounds);
+	}
+
+	g_ptr_array_foreach (queries, (GFunc) free_query, NULL);
+	g_ptr_array_free (queries, TRUE);
+
+	sqlite3_close (sql);
+	g_rand_free (rnd);
+
+	return EXIT_SUCCESS;
+}
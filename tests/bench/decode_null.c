@@ -0,0 +1,283 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Decode throughput benchmark.
+ *
+ * Plays the given files through a running xmms2d that uses the null
+ * output, with null.realtime turned off so that the audio is thrown
+ * away as fast as the xform chain delivers it, and reports how much
+ * faster than realtime the whole playlist went. This covers
+ * everything between the file and the output: reading, decoding,
+ * effects and sample conversion.
+ *
+ * Start the server with "xmms2d -o null". The files are played from a
+ * playlist of their own, and the config values changed for the run
+ * and the active playlist are put back afterwards.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <xmmsclient/xmmsclient.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#define PLAYLIST "_bench_decode"
+#define POLL_US 20000
+
+static const char *overrides[][2] = {
+	{ "null.realtime", "0" },
+	{ "playlist.repeat_all", "0" },
+	{ "playlist.repeat_one", "0" },
+};
+
+static double
+now_ms (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* Wait for a result, bailing out if the server says no */
+static xmmsv_t *
+wait_value (xmmsc_result_t *res, const char *what)
+{
+	const char *err;
+	xmmsv_t *val;
+
+	xmmsc_result_wait (res);
+	val = xmmsc_result_get_value (res);
+
+	if (xmmsv_get_error (val, &err)) {
+		fprintf (stderr, "%s failed: %s\n", what, err);
+		exit (EXIT_FAILURE);
+	}
+
+	return val;
+}
+
+static void
+run_command (xmmsc_result_t *res, const char *what)
+{
+	wait_value (res, what);
+	xmmsc_result_unref (res);
+}
+
+static char *
+get_config (xmmsc_connection_t *conn, const char *key)
+{
+	xmmsc_result_t *res;
+	const char *value;
+	char *ret;
+
+	res = xmmsc_config_get_value (conn, key);
+	xmmsv_get_string (wait_value (res, key), &value);
+	ret = strdup (value);
+	xmmsc_result_unref (res);
+
+	return ret;
+}
+
+static char *
+make_url (const char *arg)
+{
+	char path[PATH_MAX], *url;
+
+	if (strstr (arg, "://")) {
+		return strdup (arg);
+	}
+
+	if (!realpath (arg, path)) {
+		fprintf (stderr, "Could not find %s\n", arg);
+		exit (EXIT_FAILURE);
+	}
+
+	url = malloc (strlen (path) + 8);
+	sprintf (url, "file://%s", path);
+
+	return url;
+}
+
+static int
+playback_status (xmmsc_connection_t *conn)
+{
+	xmmsc_result_t *res;
+	int32_t status = XMMS_PLAYBACK_STATUS_STOP;
+
+	res = xmmsc_playback_status (conn);
+	xmmsv_get_int (wait_value (res, "playback_status"), &status);
+	xmmsc_result_unref (res);
+
+	return status;
+}
+
+/* The length of the playlist in milliseconds, and how many entries
+ * had a duration */
+static double
+playlist_duration (xmmsc_connection_t *conn, int *known)
+{
+	xmmsc_result_t *res, *info;
+	xmmsv_list_iter_t *it;
+	xmmsv_t *entries, *dict;
+	double total = 0;
+	int32_t id, duration;
+
+	*known = 0;
+
+	res = xmmsc_playlist_list_entries (conn, PLAYLIST);
+	entries = wait_value (res, "list_entries");
+
+	for (xmmsv_get_list_iter (entries, &it);
+	     xmmsv_list_iter_valid (it);
+	     xmmsv_list_iter_next (it)) {
+		xmmsv_list_iter_entry_int (it, &id);
+
+		info = xmmsc_medialib_get_info (conn, id);
+		dict = xmmsv_propdict_to_dict (wait_value (info, "get_info"), NULL);
+		if (xmmsv_dict_entry_get_int (dict, "duration", &duration)) {
+			total += duration;
+			(*known)++;
+		}
+		xmmsv_unref (dict);
+		xmmsc_result_unref (info);
+	}
+
+	xmmsc_result_unref (res);
+
+	return total;
+}
+
+static void
+usage (const char *prog)
+{
+	fprintf (stderr, "Usage: %s [-p path] file...\n"
+	         "  -p  ipc path of the server (default $XMMS_PATH)\n",
+	         prog);
+	exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char **argv)
+{
+	xmmsc_connection_t *conn;
+	xmmsc_result_t *res;
+	const char *path = NULL, *active;
+	char *saved[sizeof (overrides) / sizeof (overrides[0])];
+	char *output, *previous, *url;
+	double start, wall, audio;
+	int i, opt, known;
+
+	while ((opt = getopt (argc, argv, "p:")) != -1) {
+		switch (opt) {
+			case 'p':
+				path = optarg;
+				break;
+			default:
+				usage (argv[0]);
+		}
+	}
+
+	if (optind >= argc) {
+		usage (argv[0]);
+	}
+
+	conn = xmmsc_init ("decode-null");
+	if (!xmmsc_connect (conn, path)) {
+		fprintf (stderr, "Connection failed: %s\n",
+		         xmmsc_get_last_error (conn));
+		return EXIT_FAILURE;
+	}
+
+	output = get_config (conn, "output.plugin");
+	if (strcmp (output, "null") != 0) {
+		fprintf (stderr, "The server uses the %s output, "
+		         "start it with \"xmms2d -o null\"\n", output);
+		return EXIT_FAILURE;
+	}
+	free (output);
+
+	res = xmmsc_playlist_current_active (conn);
+	xmmsv_get_string (wait_value (res, "current_active"), &active);
+	previous = strdup (active);
+	xmmsc_result_unref (res);
+
+	for (i = 0; i < sizeof (overrides) / sizeof (overrides[0]); i++) {
+		saved[i] = get_config (conn, overrides[i][0]);
+		run_command (xmmsc_config_set_value (conn, overrides[i][0],
+		                                     overrides[i][1]),
+		             overrides[i][0]);
+	}
+
+	run_command (xmmsc_playback_stop (conn), "stop");
+
+	/* start from scratch if a previous run was interrupted */
+	xmmsc_result_unref (xmmsc_playlist_remove (conn, PLAYLIST));
+	run_command (xmmsc_playlist_create (conn, PLAYLIST), "create");
+
+	for (i = optind; i < argc; i++) {
+		url = make_url (argv[i]);
+		run_command (xmmsc_playlist_add_url (conn, PLAYLIST, url), url);
+		free (url);
+	}
+
+	run_command (xmmsc_playlist_load (conn, PLAYLIST), "load");
+	run_command (xmmsc_playlist_set_next (conn, 0), "set_next");
+	run_command (xmmsc_playback_tickle (conn), "tickle");
+
+	start = now_ms ();
+	run_command (xmmsc_playback_start (conn), "start");
+
+	/* wait for it to start, then for it to run off the end */
+	while (playback_status (conn) == XMMS_PLAYBACK_STATUS_STOP &&
+	       now_ms () - start < 5000) {
+		usleep (POLL_US);
+	}
+	while (playback_status (conn) != XMMS_PLAYBACK_STATUS_STOP) {
+		usleep (POLL_US);
+	}
+	wall = now_ms () - start;
+
+	audio = playlist_duration (conn, &known);
+
+	printf ("decode_null\tfile_count\t%d\n", argc - optind);
+	printf ("decode_null\ttimed_file_count\t%d\n", known);
+	printf ("decode_null\taudio_second_count\t%.1f\n", audio / 1000.0);
+	printf ("decode_null\twall_ms\t%.3f\n", wall);
+	printf ("decode_null\tx_realtime\t%.1f\n", wall > 0 ? audio / wall : 0);
+
+	/* put things back the way they were */
+	run_command (xmmsc_playlist_load (conn, previous), "load");
+	run_command (xmmsc_playlist_remove (conn, PLAYLIST), "remove");
+
+	for (i = 0; i < sizeof (overrides) / sizeof (overrides[0]); i++) {
+		run_command (xmmsc_config_set_value (conn, overrides[i][0], saved[i]),
+		             overrides[i][0]);
+		free (saved[i]);
+	}
+
+	free (previous);
+	xmmsc_unref (conn);
+
+	return EXIT_SUCCESS;
+}
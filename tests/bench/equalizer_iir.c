@@ -0,0 +1,114 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Equalizer filter benchmark.
+ *
+ * Equalizes a buffer of 16 bit stereo with every band count the
+ * equalizer plugin offers, using each of the filter implementations
+ * the CPU supports, with and without the extra filtering pass.
+ *
+ * The number of passes can be given on the command line. Results are
+ * printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "eq_iir.h"
+
+#define DEFAULT_PASSES 500
+#define SRATE 44100
+#define CHANNELS 2
+/* what a decoder typically hands the equalizer plugin */
+#define BUFFER_FRAMES 1024
+
+static const gint bands[] = { 10, 15, 25, 31 };
+
+static void
+run (const gchar *name, xmms_eq_iir_impl_t impl, gint nbands,
+     gboolean extra_filtering, guint passes)
+{
+	gint16 orig[BUFFER_FRAMES * CHANNELS], buf[BUFFER_FRAMES * CHANNELS];
+	xmms_eq_iir_t *iir;
+	GTimer *timer;
+	gdouble elapsed;
+	guint n;
+	gint i;
+
+	for (i = 0; i < G_N_ELEMENTS (orig); i++) {
+		orig[i] = g_random_int_range (-8192, 8192);
+	}
+
+	iir = xmms_eq_iir_new (SRATE, CHANNELS, impl);
+	xmms_eq_iir_bands_set (iir, nbands, FALSE);
+	for (i = 0; i < EQ_MAX_BANDS; i++) {
+		xmms_eq_iir_gain_set (iir, i, (i % 3) * 0.2 - 0.1);
+	}
+
+	timer = g_timer_new ();
+
+	for (n = 0; n < passes; n++) {
+		memcpy (buf, orig, sizeof (buf));
+		xmms_eq_iir_process (iir, buf, BUFFER_FRAMES, extra_filtering);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+	xmms_eq_iir_free (iir);
+
+	printf ("%s\ttotal_ms\t%.2f\n", name, elapsed * 1000.0);
+	printf ("%s\tframes_per_sec\t%.0f\n", name,
+	        (gdouble) passes * BUFFER_FRAMES / elapsed);
+}
+
+int
+main (int argc, char **argv)
+{
+	xmms_eq_iir_impl_t impl;
+	guint passes = DEFAULT_PASSES;
+	gchar *name;
+	gint i, extra;
+
+	if (argc > 1) {
+		passes = atoi (argv[1]);
+	}
+
+	g_thread_init (NULL);
+
+	printf ("equalizer\tbest\t%s\n",
+	        xmms_eq_iir_impl_name (xmms_eq_iir_impl_best ()));
+
+	for (i = 0; i < G_N_ELEMENTS (bands); i++) {
+		for (impl = 0; impl < XMMS_EQ_IIR_IMPL_COUNT; impl++) {
+			if (!xmms_eq_iir_func (impl)) {
+				continue;
+			}
+
+			for (extra = 0; extra < 2; extra++) {
+				name = g_strdup_printf ("%d_%s%s", bands[i],
+				                        xmms_eq_iir_impl_name (impl),
+				                        extra ? "_extra" : "");
+				run (name, impl, bands[i], extra, passes);
+				g_free (name);
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file File transport import benchmark.
+ *
+ * Reads a set of files the way importing them into the medialib
+ * does: probing the header, looking for an id3v1 tag at the end and
+ * letting a decoder scan the first frames, all in 4 KiB reads. This
+ * is done once with plain read() and lseek() and once with each of
+ * the file transport's I/O strategies, counting system calls.
+ *
+ * The files are given on the command line, or generated in a
+ * temporary directory. Results are printed one per line as
+ * "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "file_io.h"
+
+#define DEFAULT_FILES 50
+#define DEFAULT_SIZE (2 * 1024 * 1024)
+#define READ_SIZE 4096
+#define HEADER_PROBE (16 * 1024)
+#define DECODER_SCAN (64 * 1024)
+
+/* What the file transport did before, for comparison */
+static guint
+import_read_lseek (const gchar *path)
+{
+	gchar buf[READ_SIZE];
+	struct stat st;
+	guint syscalls = 0;
+	gint fd, i;
+
+	syscalls++;
+	if (stat (path, &st) == -1) {
+		return syscalls;
+	}
+
+	syscalls++;
+	fd = open (path, O_RDONLY);
+	if (fd == -1) {
+		return syscalls;
+	}
+
+	for (i = 0; i < HEADER_PROBE; i += READ_SIZE) {
+		syscalls++;
+		if (read (fd, buf, READ_SIZE) <= 0) {
+			break;
+		}
+	}
+
+	syscalls += 2;
+	lseek (fd, -128, SEEK_END);
+	read (fd, buf, 128);
+
+	syscalls++;
+	lseek (fd, 0, SEEK_SET);
+	for (i = 0; i < DECODER_SCAN; i += READ_SIZE) {
+		syscalls++;
+		if (read (fd, buf, READ_SIZE) <= 0) {
+			break;
+		}
+	}
+
+	syscalls++;
+	close (fd);
+
+	return syscalls;
+}
+
+static guint
+import_file_io (const gchar *path, const xmms_file_io_options_t *options)
+{
+	xmms_file_io_t *io;
+	gchar buf[READ_SIZE];
+	guint syscalls;
+	gint i;
+
+	io = xmms_file_io_open (path, options);
+	if (!io) {
+		return 1;
+	}
+
+	for (i = 0; i < HEADER_PROBE; i += READ_SIZE) {
+		if (xmms_file_io_read (io, buf, READ_SIZE) <= 0) {
+			break;
+		}
+	}
+
+	xmms_file_io_seek (io, -128, XMMS_FILE_IO_SEEK_END);
+	xmms_file_io_read (io, buf, 128);
+
+	xmms_file_io_seek (io, 0, XMMS_FILE_IO_SEEK_SET);
+	for (i = 0; i < DECODER_SCAN; i += READ_SIZE) {
+		if (xmms_file_io_read (io, buf, READ_SIZE) <= 0) {
+			break;
+		}
+	}
+
+	/* and the close */
+	syscalls = xmms_file_io_syscalls (io) + 1;
+	xmms_file_io_close (io);
+
+	return syscalls;
+}
+
+static void
+run (const gchar *name, gchar **paths, const xmms_file_io_options_t *options)
+{
+	GTimer *timer;
+	gdouble elapsed;
+	guint64 syscalls = 0;
+	guint count = 0;
+
+	timer = g_timer_new ();
+
+	for (; *paths; paths++, count++) {
+		if (options) {
+			syscalls += import_file_io (*paths, options);
+		} else {
+			syscalls += import_read_lseek (*paths);
+		}
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL) * 1000.0;
+	g_timer_destroy (timer);
+
+	printf ("%s\tfile_count\t%u\n", name, count);
+	printf ("%s\tper_file_calls\t%.1f\n", name, (gdouble) syscalls / count);
+	printf ("%s\ttotal_ms\t%.3f\n", name, elapsed);
+}
+
+/* Without io_uring the files would be read with pread again */
+static gboolean
+uring_available (const gchar *path, const xmms_file_io_options_t *options)
+{
+	xmms_file_io_t *io;
+	gboolean ret;
+
+	if (!path || !(io = xmms_file_io_open (path, options))) {
+		return FALSE;
+	}
+
+	ret = xmms_file_io_uses_uring (io);
+	xmms_file_io_close (io);
+
+	return ret;
+}
+
+static gchar **
+generate (const gchar *dir, gint count, gint size)
+{
+	gchar **paths, *data;
+	gint i;
+
+	data = g_malloc (size);
+	for (i = 0; i < size; i++) {
+		data[i] = i * 31;
+	}
+
+	paths = g_new0 (gchar *, count + 1);
+	for (i = 0; i < count; i++) {
+		paths[i] = g_strdup_printf ("%s/%04d.mp3", dir, i);
+		g_file_set_contents (paths[i], data, size, NULL);
+	}
+
+	g_free (data);
+
+	return paths;
+}
+
+int
+main (int argc, char **argv)
+{
+	xmms_file_io_options_t plain = { FALSE, 0, 0, 0 };
+	xmms_file_io_options_t mapped = { TRUE, 1024 * 1024, 128 * 1024, 0 };
+	xmms_file_io_options_t uring = { TRUE, 1024 * 1024, 128 * 1024, 4 };
+	gchar **paths, *dir = NULL;
+	gint count = DEFAULT_FILES, size = DEFAULT_SIZE, opt, i;
+
+	while ((opt = getopt (argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+			case 'n':
+				count = atoi (optarg);
+				break;
+			case 's':
+				size = atoi (optarg);
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-n files] [-s size] [file...]\n",
+				         argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (optind < argc) {
+		paths = g_strdupv (argv + optind);
+	} else {
+		dir = g_build_filename (g_get_tmp_dir (), "xmms2-bench-XXXXXX", NULL);
+		if (!mkdtemp (dir)) {
+			fprintf (stderr, "Could not create a temporary directory\n");
+			return EXIT_FAILURE;
+		}
+		paths = generate (dir, count, size);
+	}
+
+	run ("read_lseek", paths, NULL);
+	run ("pread", paths, &plain);
+	run ("fadvise_mmap", paths, &mapped);
+	if (uring_available (paths[0], &uring)) {
+		run ("io_uring", paths, &uring);
+	} else {
+		fprintf (stderr, "io_uring isn't available, skipping it\n");
+	}
+
+	if (dir) {
+		for (i = 0; paths[i]; i++) {
+			unlink (paths[i]);
+		}
+		rmdir (dir);
+		g_free (dir);
+	}
+	g_strfreev (paths);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,475 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file IPC load test.
+ *
+ * Opens a large number of connections to a running xmms2d and measures
+ * the latency of a cheap command on each of them, both one at a time
+ * and with all connections in flight at once. Optionally a slow
+ * collection query is kept running on the side, to check that it does
+ * not hold up the other clients.
+ *
+ * Instead of the cheap command, the connections can run a script of
+ * commands, one per line, taken in turn:
+ *
+ *   status              playback status
+ *   playtime            playback playtime
+ *   list [playlist]     entries of a playlist, the active one by default
+ *   info <id>           medialib info of an entry
+ *   query <pattern>     ids matching a collection pattern
+ *   stats               server statistics
+ *
+ * Empty lines and lines starting with # are skipped. Latencies are
+ * then reported for each kind of command as well.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <xmmsclient/xmmsclient.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define DEFAULT_CONNECTIONS 1000
+#define DEFAULT_ROUNDS 10
+
+typedef enum {
+	COMMAND_STATUS,
+	COMMAND_PLAYTIME,
+	COMMAND_LIST,
+	COMMAND_INFO,
+	COMMAND_QUERY,
+	COMMAND_STATS,
+	COMMAND_COUNT
+} command_type_t;
+
+static const char *command_names[COMMAND_COUNT] = {
+	"status", "playtime", "list", "info", "query", "stats"
+};
+
+typedef struct {
+	command_type_t type;
+	char *playlist;
+	int id;
+	xmmsv_coll_t *coll;
+} command_t;
+
+static command_t *script;
+static int script_len;
+
+static double
+now_ms (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int
+compare_double (const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+report (const char *phase, double *samples, int count, double elapsed)
+{
+	double sum = 0;
+	int i;
+
+	if (count == 0) {
+		return;
+	}
+
+	qsort (samples, count, sizeof (double), compare_double);
+
+	for (i = 0; i < count; i++) {
+		sum += samples[i];
+	}
+
+	printf ("ipc_load\t%s.command_count\t%d\n", phase, count);
+	printf ("ipc_load\t%s.min_ms\t%.3f\n", phase, samples[0]);
+	printf ("ipc_load\t%s.avg_ms\t%.3f\n", phase, sum / count);
+	printf ("ipc_load\t%s.p50_ms\t%.3f\n", phase, samples[count / 2]);
+	printf ("ipc_load\t%s.p99_ms\t%.3f\n", phase, samples[(count * 99) / 100]);
+	printf ("ipc_load\t%s.max_ms\t%.3f\n", phase, samples[count - 1]);
+	printf ("ipc_load\t%s.commands_per_sec\t%.1f\n", phase,
+	        count / (elapsed / 1000.0));
+}
+
+/* Report the samples of each kind of command on its own, before
+ * report () sorts them */
+static void
+report_commands (const char *phase, double *samples, int *kinds, int count,
+                 double elapsed)
+{
+	char name[64];
+	double *subset;
+	int k, i, n;
+
+	if (!script) {
+		return;
+	}
+
+	subset = calloc (count, sizeof (double));
+
+	for (k = 0; k < COMMAND_COUNT; k++) {
+		for (i = n = 0; i < count; i++) {
+			if (kinds[i] == k) {
+				subset[n++] = samples[i];
+			}
+		}
+
+		snprintf (name, sizeof (name), "%s.%s", phase, command_names[k]);
+		report (name, subset, n, elapsed);
+	}
+
+	free (subset);
+}
+
+static void
+load_script (const char *path)
+{
+	char line[1024], *word, *arg;
+	command_t *cmd;
+	FILE *f;
+	int k;
+
+	f = fopen (path, "r");
+	if (!f) {
+		fprintf (stderr, "Could not open %s\n", path);
+		exit (EXIT_FAILURE);
+	}
+
+	while (fgets (line, sizeof (line), f)) {
+		word = strtok (line, " \t\r\n");
+		if (!word || *word == '#') {
+			continue;
+		}
+
+		arg = strtok (NULL, "\r\n");
+
+		for (k = 0; k < COMMAND_COUNT; k++) {
+			if (strcmp (word, command_names[k]) == 0) {
+				break;
+			}
+		}
+		if (k == COMMAND_COUNT) {
+			fprintf (stderr, "Unknown command in script: %s\n", word);
+			exit (EXIT_FAILURE);
+		}
+
+		script = realloc (script, (script_len + 1) * sizeof (command_t));
+		cmd = &script[script_len++];
+		memset (cmd, 0, sizeof (command_t));
+		cmd->type = k;
+
+		switch (k) {
+			case COMMAND_LIST:
+				cmd->playlist = arg ? strdup (arg) : NULL;
+				break;
+			case COMMAND_INFO:
+				cmd->id = arg ? atoi (arg) : 0;
+				if (cmd->id <= 0) {
+					fprintf (stderr, "info needs a medialib id\n");
+					exit (EXIT_FAILURE);
+				}
+				break;
+			case COMMAND_QUERY:
+				if (!arg || !xmmsv_coll_parse (arg, &cmd->coll)) {
+					fprintf (stderr, "Could not parse pattern: %s\n",
+					         arg ? arg : "");
+					exit (EXIT_FAILURE);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	fclose (f);
+
+	if (script_len == 0) {
+		fprintf (stderr, "No commands in %s\n", path);
+		exit (EXIT_FAILURE);
+	}
+}
+
+static void
+free_script (void)
+{
+	int i;
+
+	for (i = 0; i < script_len; i++) {
+		free (script[i].playlist);
+		if (script[i].coll) {
+			xmmsv_coll_unref (script[i].coll);
+		}
+	}
+
+	free (script);
+}
+
+/* Send the n:th command of the script, or the cheap one without */
+static xmmsc_result_t *
+send_command (xmmsc_connection_t *conn, int n, int *kind)
+{
+	xmmsc_result_t *res;
+	command_t *cmd;
+	xmmsv_t *order;
+
+	if (!script) {
+		*kind = COMMAND_STATUS;
+		return xmmsc_playback_status (conn);
+	}
+
+	cmd = &script[n % script_len];
+	*kind = cmd->type;
+
+	switch (cmd->type) {
+		case COMMAND_PLAYTIME:
+			return xmmsc_playback_playtime (conn);
+		case COMMAND_LIST:
+			return xmmsc_playlist_list_entries (conn, cmd->playlist);
+		case COMMAND_INFO:
+			return xmmsc_medialib_get_info (conn, cmd->id);
+		case COMMAND_QUERY:
+			order = xmmsv_new_list ();
+			res = xmmsc_coll_query_ids (conn, cmd->coll, order, 0, 0);
+			xmmsv_unref (order);
+			return res;
+		case COMMAND_STATS:
+			return xmmsc_main_stats (conn);
+		default:
+			return xmmsc_playback_status (conn);
+	}
+}
+
+static void
+raise_fd_limit (int wanted)
+{
+	struct rlimit rl;
+
+	if (getrlimit (RLIMIT_NOFILE, &rl) != 0) {
+		return;
+	}
+
+	if (rl.rlim_cur >= (rlim_t) wanted) {
+		return;
+	}
+
+	rl.rlim_cur = rl.rlim_max == RLIM_INFINITY ? (rlim_t) wanted
+	              : (rl.rlim_max < (rlim_t) wanted ? rl.rlim_max
+	                                               : (rlim_t) wanted);
+
+	if (setrlimit (RLIMIT_NOFILE, &rl) != 0) {
+		fprintf (stderr, "Could not raise file descriptor limit\n");
+	}
+}
+
+static xmmsc_result_t *
+slow_query (xmmsc_connection_t *conn)
+{
+	xmmsc_result_t *res;
+	xmmsv_coll_t *universe;
+	xmmsv_t *order, *fetch, *group;
+
+	universe = xmmsv_coll_universe ();
+	order = xmmsv_new_list ();
+	fetch = xmmsv_build_list (XMMSV_LIST_ENTRY_STR ("artist"),
+	                          XMMSV_LIST_ENTRY_STR ("album"),
+	                          XMMSV_LIST_ENTRY_STR ("title"),
+	                          XMMSV_LIST_END);
+	group = xmmsv_new_list ();
+
+	res = xmmsc_coll_query_infos (conn, universe, order, 0, 0, fetch, group);
+
+	xmmsv_unref (group);
+	xmmsv_unref (fetch);
+	xmmsv_unref (order);
+	xmmsv_coll_unref (universe);
+
+	return res;
+}
+
+static void
+usage (const char *prog)
+{
+	fprintf (stderr, "Usage: %s [-n connections] [-r rounds] [-q] [-s script] "
+	         "[-p path]\n"
+	         "  -n  number of connections to open (default %d)\n"
+	         "  -r  number of rounds over all connections (default %d)\n"
+	         "  -q  keep a slow query_infos running on the side\n"
+	         "  -s  run the commands of a script instead of playback_status\n"
+	         "  -p  ipc path of the server (default $XMMS_PATH)\n",
+	         prog, DEFAULT_CONNECTIONS, DEFAULT_ROUNDS);
+	exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char **argv)
+{
+	xmmsc_connection_t **conns, *side = NULL;
+	xmmsc_result_t **results, *slow = NULL;
+	const char *path = NULL;
+	double *samples, *sent, start, t;
+	int *kinds;
+	int connections = DEFAULT_CONNECTIONS;
+	int rounds = DEFAULT_ROUNDS;
+	int with_slow = 0;
+	int i, r, n, opt;
+
+	while ((opt = getopt (argc, argv, "n:r:qs:p:")) != -1) {
+		switch (opt) {
+			case 'n':
+				connections = atoi (optarg);
+				break;
+			case 'r':
+				rounds = atoi (optarg);
+				break;
+			case 'q':
+				with_slow = 1;
+				break;
+			case 's':
+				load_script (optarg);
+				break;
+			case 'p':
+				path = optarg;
+				break;
+			default:
+				usage (argv[0]);
+		}
+	}
+
+	if (connections < 1 || rounds < 1) {
+		usage (argv[0]);
+	}
+
+	raise_fd_limit (connections + 32);
+
+	conns = calloc (connections, sizeof (xmmsc_connection_t *));
+	results = calloc (connections, sizeof (xmmsc_result_t *));
+	sent = calloc (connections, sizeof (double));
+	samples = calloc (connections * rounds, sizeof (double));
+	kinds = calloc (connections * rounds, sizeof (int));
+
+	start = now_ms ();
+	for (i = 0; i < connections; i++) {
+		conns[i] = xmmsc_init ("ipc-load");
+		if (!xmmsc_connect (conns[i], path)) {
+			fprintf (stderr, "Connection %d failed: %s\n", i,
+			         xmmsc_get_last_error (conns[i]));
+			exit (EXIT_FAILURE);
+		}
+	}
+	t = now_ms () - start;
+
+	printf ("ipc_load\tconnection_count\t%d\n", connections);
+	printf ("ipc_load\tconnect.total_ms\t%.3f\n", t);
+
+	if (with_slow) {
+		side = xmmsc_init ("ipc-load-slow");
+		if (!xmmsc_connect (side, path)) {
+			fprintf (stderr, "Side connection failed: %s\n",
+			         xmmsc_get_last_error (side));
+			exit (EXIT_FAILURE);
+		}
+	}
+
+	/* One command at a time, round-robin over all connections */
+	n = 0;
+	start = now_ms ();
+	for (r = 0; r < rounds; r++) {
+		if (side) {
+			slow = slow_query (side);
+		}
+
+		for (i = 0; i < connections; i++) {
+			xmmsc_result_t *res;
+
+			t = now_ms ();
+			res = send_command (conns[i], n, &kinds[n]);
+			xmmsc_result_wait (res);
+			samples[n++] = now_ms () - t;
+			xmmsc_result_unref (res);
+		}
+
+		if (slow) {
+			xmmsc_result_wait (slow);
+			xmmsc_result_unref (slow);
+			slow = NULL;
+		}
+	}
+	t = now_ms () - start;
+	report_commands ("sequential", samples, kinds, n, t);
+	report ("sequential", samples, n, t);
+
+	/* Every connection has a command in flight at the same time */
+	n = 0;
+	start = now_ms ();
+	for (r = 0; r < rounds; r++) {
+		if (side) {
+			slow = slow_query (side);
+		}
+
+		for (i = 0; i < connections; i++) {
+			sent[i] = now_ms ();
+			results[i] = send_command (conns[i], n + i, &kinds[n + i]);
+		}
+
+		for (i = 0; i < connections; i++) {
+			xmmsc_result_wait (results[i]);
+			samples[n++] = now_ms () - sent[i];
+			xmmsc_result_unref (results[i]);
+		}
+
+		if (slow) {
+			xmmsc_result_wait (slow);
+			xmmsc_result_unref (slow);
+			slow = NULL;
+		}
+	}
+	t = now_ms () - start;
+	report_commands ("concurrent", samples, kinds, n, t);
+	report ("concurrent", samples, n, t);
+
+	for (i = 0; i < connections; i++) {
+		xmmsc_unref (conns[i]);
+	}
+
+	if (side) {
+		xmmsc_unref (side);
+	}
+
+	free_script ();
+	free (kinds);
+	free (samples);
+	free (sent);
+	free (results);
+	free (conns);
+
+	return EXIT_SUCCESS;
+}
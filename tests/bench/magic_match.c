@@ -0,0 +1,188 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Magic matching benchmark.
+ *
+ * Registers the magic specs shipped with the plugins and identifies a
+ * synthetic corpus of file headers, once by walking every tree in turn
+ * and once through the first-byte index.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "xmmspriv/xmms_magic.h"
+
+#define DEFAULT_ROUNDS 20000
+#define HEADER_SIZE 64
+
+typedef struct {
+	const gchar *data;
+	guint len;
+} memory_t;
+
+static const gchar *specs[][5] = {
+	{ "mpc header", "audio/x-ape", "0 string MAC ", NULL },
+	{ "asf header", "video/x-ms-asf", "0 belong 0x3026b275", NULL },
+	{ "ASX header", "application/x-asx-playlist", "0 string/c <ASX", NULL },
+	{ "mpeg aac header", "audio/aac", "0 beshort&0xfff6 0xfff0", NULL },
+	{ "adif header", "audio/aac", "0 string ADIF", NULL },
+	{ "flac header", "audio/x-flac", "0 string fLaC", NULL },
+	{ "FLV header", "video/x-flv", "0 string FLV", NULL },
+	{ "html doctype", "text/html", "0 string/c <!DOCTYPE HTML ", NULL },
+	{ "html tag", "text/html", "0 string/c <html ", NULL },
+	{ "html header tag", "text/html", "0 string/c <head ", NULL },
+	{ "id3 header", "application/id3v2", "0 string ID3", ">3 byte <0xff", NULL },
+	{ "Extended M3U header", "audio/x-mpegurl", "0 string #EXTM3U", NULL },
+	{ "mpeg header", "audio/mpeg", "0 beshort&0xfff6 0xfff6",
+	  "0 beshort&0xfff6 0xfff4", "0 beshort&0xffe6 0xffe2" },
+	{ "Fasttracker II module", "audio/xm", "0 string Extended Module:", NULL },
+	{ "ScreamTracker III module", "audio/s3m", "44 string SCRM", NULL },
+	{ "Impulse Tracker module", "audio/it", "0 string IMPM", NULL },
+	{ "MED module", "audio/med", "0 string MMD", NULL },
+	{ "AMF module", "audio/amf", "0 string AMF", NULL },
+	{ "Unreal Engine package", "audio/umx", "0 belong 0xc1832a9e", NULL },
+	{ "mpeg-4 header", "video/mp4", "4 string ftyp", ">8 string isom", NULL },
+	{ "iTunes header", "audio/mp4", "4 string ftyp", ">8 string M4A ", NULL },
+	{ "mpc header", "audio/x-mpc", "0 string MP+", NULL },
+	{ "mpc header", "audio/x-mpc", "0 string MPCK", NULL },
+	{ "pls header", "audio/x-scpls", "0 string/c [playlist]", NULL },
+	{ "ogg/speex header", "audio/x-speex", "0 string OggS", ">4 byte 0",
+	  ">>28 string Speex   " },
+	{ "ogg/vorbis header", "application/ogg", "0 string OggS", ">4 byte 0",
+	  ">>28 string \x01vorbis" },
+	{ "wave header", "audio/x-wav", "0 string RIFF", ">8 string WAVE",
+	  ">>12 string fmt " },
+	{ "sidplay infofile", "audio/prs.sid", "0 string SIDPLAY INFOFILE", NULL },
+	{ "psid header", "audio/prs.sid", "0 string PSID", NULL },
+	{ "rsid header", "audio/prs.sid", "0 string RSID", NULL },
+	{ "wavpack header v4", "audio/x-wavpack", "0 string wvpk", NULL },
+	{ "NUL padded", "application/x-nul-padded", "0 byte 0x0", NULL },
+};
+
+#define HEADER(s) { s, sizeof (s) - 1 }
+
+static const memory_t corpus[] = {
+	HEADER ("RIFF\x24\x08\0\0WAVEfmt \x10\0\0\0"),
+	HEADER ("OggS\0\x02\0\0\0\0\0\0\0\0"),
+	HEADER ("ID3\x03\0\0\0\0\x0f\x76"),
+	HEADER ("\xff\xfb\x90\x64\0\0\0\0"),
+	HEADER ("fLaC\0\0\0\x22\x10\0"),
+	HEADER ("\0\0\0\x20" "ftypM4A \0\0\0\0"),
+	HEADER ("wvpk\x2c\0\0\0"),
+	HEADER ("#EXTM3U\n#EXTINF:"),
+	HEADER ("[playlist]\nFile1="),
+	HEADER ("unknown data here"),
+};
+
+static gint
+memory_read (gpointer udata, gchar *buf, guint len)
+{
+	memory_t *mem = udata;
+
+	len = MIN (len, mem->len);
+	memcpy (buf, mem->data, len);
+
+	return len;
+}
+
+static void
+run (const gchar *name, xmms_magic_set_t *set, gchar **headers,
+     guint count, gint rounds, gboolean linear)
+{
+	xmms_magic_checker_t c;
+	memory_t mem;
+	GTimer *timer;
+	gdouble elapsed;
+	guint found = 0, i;
+	gint r;
+
+	timer = g_timer_new ();
+
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < count; i++) {
+			mem.data = headers[i];
+			mem.len = HEADER_SIZE;
+
+			xmms_magic_checker_init (&c, memory_read, &mem);
+			if (linear) {
+				found += !!xmms_magic_set_match_linear (set, &c, NULL);
+			} else {
+				found += !!xmms_magic_set_match (set, &c, NULL);
+			}
+			xmms_magic_checker_clear (&c);
+		}
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL) * 1000.0;
+	g_timer_destroy (timer);
+
+	printf ("%s\tlookup_count\t%u\n", name, rounds * count);
+	printf ("%s\tmatch_count\t%u\n", name, found);
+	printf ("%s\ttotal_ms\t%.3f\n", name, elapsed);
+	printf ("%s\tlookup_ns\t%.1f\n", name,
+	        elapsed * 1000000.0 / (rounds * count));
+}
+
+int
+main (int argc, char **argv)
+{
+	xmms_magic_set_t *set;
+	gchar **headers;
+	guint count, i;
+	gint rounds = DEFAULT_ROUNDS, opt;
+
+	while ((opt = getopt (argc, argv, "n:")) != -1) {
+		switch (opt) {
+			case 'n':
+				rounds = atoi (optarg);
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-n rounds]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	set = xmms_magic_set_new ();
+	for (i = 0; i < G_N_ELEMENTS (specs); i++) {
+		xmms_magic_set_add (set, specs[i][0], specs[i][1], specs[i][2],
+		                    specs[i][3], specs[i][4], NULL);
+	}
+
+	count = G_N_ELEMENTS (corpus);
+	headers = g_new (gchar *, count);
+	for (i = 0; i < count; i++) {
+		headers[i] = g_malloc0 (HEADER_SIZE);
+		memcpy (headers[i], corpus[i].data, corpus[i].len);
+	}
+
+	run ("magic_linear", set, headers, count, rounds, TRUE);
+	run ("magic_indexed", set, headers, count, rounds, FALSE);
+
+	for (i = 0; i < count; i++) {
+		g_free (headers[i]);
+	}
+	g_free (headers);
+	xmms_magic_set_free (set);
+
+	return EXIT_SUCCESS;
+}
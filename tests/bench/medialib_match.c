@@ -0,0 +1,300 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file MATCH filter benchmark.
+ *
+ * Fills a Media table laid out like the medialib's, ten properties
+ * per song with titles made of a few thousand made up words, and
+ * times the query a MATCH filter on the title turns into for every
+ * keystroke of a search, once with a plain LIKE and once narrowed
+ * down by the trigram text index. There is only one source, so the
+ * source preference is left out of the queries.
+ *
+ * The search defaults to the title of a song in the middle.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <sqlite3.h>
+
+#define DEFAULT_SONGS 100000
+#define DEFAULT_ROUNDS 5
+#define WORDS 5000
+
+static const gchar *syllables[] = {
+	"ka", "lo", "mi", "ra", "ne", "to", "su", "vi", "de", "ba",
+	"zo", "pe", "li", "gu", "fa", "ho", "ri", "ma", "no", "se"
+};
+
+static gchar *words[WORDS];
+
+static const gchar *keys[] = {
+	"album", "artist", "bitrate", "duration", "genre",
+	"status", "title", "tracknr", "url", "added"
+};
+
+static gchar *
+random_words (gint count)
+{
+	GString *str;
+	gint i;
+
+	str = g_string_new (NULL);
+	for (i = 0; i < count; i++) {
+		if (i) {
+			g_string_append_c (str, ' ');
+		}
+		g_string_append (str, words[g_random_int_range (0, WORDS)]);
+	}
+
+	return g_string_free (str, FALSE);
+}
+
+static void
+make_words (void)
+{
+	GString *word;
+	gint i, j, k;
+
+	for (i = 0; i < WORDS; i++) {
+		word = g_string_new (NULL);
+		for (j = g_random_int_range (2, 5); j > 0; j--) {
+			k = g_random_int_range (0, G_N_ELEMENTS (syllables));
+			g_string_append (word, syllables[k]);
+		}
+		words[i] = g_string_free (word, FALSE);
+	}
+}
+
+static void
+fill (sqlite3 *sql, gint songs)
+{
+	sqlite3_stmt *stm;
+	gchar *value;
+	gint id, i;
+
+	/* with the stats the medialib gets when it's created */
+	sqlite3_exec (sql,
+	              "CREATE TABLE Media (id INTEGER, key, value, source INTEGER, "
+	                                  "intval INTEGER DEFAULT NULL);"
+	              "CREATE UNIQUE INDEX key_idx ON Media (id, key, source);"
+	              "CREATE INDEX key_value_2x ON Media (key, value COLLATE NOCASE);"
+	              "ANALYZE;"
+	              "INSERT INTO sqlite_stat1 VALUES('Media', 'key_idx', '199568 14 1 1');"
+	              "INSERT INTO sqlite_stat1 VALUES('Media', 'key_value_2x', '199568 6653 3');"
+	              "ANALYZE sqlite_master;",
+	              NULL, NULL, NULL);
+
+	sqlite3_prepare_v2 (sql, "INSERT INTO Media VALUES (?, ?, ?, 1, NULL)",
+	                    -1, &stm, NULL);
+
+	sqlite3_exec (sql, "BEGIN", NULL, NULL, NULL);
+	for (id = 1; id <= songs; id++) {
+		for (i = 0; i < G_N_ELEMENTS (keys); i++) {
+			if (strcmp (keys[i], "title") == 0) {
+				value = random_words (g_random_int_range (1, 5));
+			} else if (strcmp (keys[i], "url") == 0) {
+				value = g_strdup_printf ("file:///music/%d/%d.mp3", id / 12, id);
+			} else if (strcmp (keys[i], "artist") == 0 ||
+			           strcmp (keys[i], "album") == 0) {
+				value = random_words (2);
+			} else {
+				value = g_strdup_printf ("%d", g_random_int_range (0, 1000));
+			}
+
+			sqlite3_bind_int (stm, 1, id);
+			sqlite3_bind_text (stm, 2, keys[i], -1, SQLITE_STATIC);
+			sqlite3_bind_text (stm, 3, value, -1, g_free);
+			sqlite3_step (stm);
+			sqlite3_reset (stm);
+		}
+	}
+	sqlite3_exec (sql, "COMMIT", NULL, NULL, NULL);
+
+	sqlite3_finalize (stm);
+}
+
+/* Same as medialib's, without the triggers as nothing is written */
+static void
+build_text_index (sqlite3 *sql)
+{
+	sqlite3_exec (sql,
+	              "CREATE VIRTUAL TABLE MediaText "
+	                     "USING fts5 (value, content='Media', tokenize='trigram');"
+	              "INSERT INTO MediaText (rowid, value) "
+	                     "SELECT rowid, value FROM Media "
+	                     "WHERE key IN ('artist', 'album', 'title', 'url');",
+	              NULL, NULL, NULL);
+}
+
+static gint
+run_query (sqlite3 *sql, const gchar *query)
+{
+	sqlite3_stmt *stm;
+	gint rows = 0;
+
+	if (sqlite3_prepare_v2 (sql, query, -1, &stm, NULL) != SQLITE_OK) {
+		fprintf (stderr, "%s: %s\n", query, sqlite3_errmsg (sql));
+		exit (EXIT_FAILURE);
+	}
+
+	while (sqlite3_step (stm) == SQLITE_ROW) {
+		rows++;
+	}
+
+	sqlite3_finalize (stm);
+
+	return rows;
+}
+
+static int
+first_value (void *udata, int argc, char **argv, char **columns)
+{
+	gchar **value = udata;
+
+	g_free (*value);
+	*value = g_strdup (argv[0]);
+
+	return 1;
+}
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	const gdouble *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+/* Type the search one character at a time, reporting the median time */
+static void
+run (const gchar *name, sqlite3 *sql, const gchar *search, gint rounds,
+     gboolean indexed)
+{
+	gchar *prefix, *pattern, *match, *query;
+	gdouble *times, total = 0;
+	GTimer *timer;
+	gint len, i, rows = 0;
+
+	times = g_new (gdouble, rounds);
+	timer = g_timer_new ();
+
+	for (len = 1; len <= strlen (search); len++) {
+		prefix = g_strndup (search, len);
+		pattern = sqlite3_mprintf ("'%%%q%%'", prefix);
+
+		/* what the query generator does, as the search has no
+		 * wildcards of its own */
+		if (indexed && g_utf8_strlen (prefix, -1) >= 3) {
+			match = sqlite3_mprintf ("'\"%w\"'", prefix);
+			query = g_strdup_printf ("SELECT DISTINCT m0.id FROM Media AS m0 "
+			                         "WHERE m0.key='title' AND "
+			                         "((m0.value COLLATE NOCASE) LIKE %s "
+			                         "AND m0.rowid IN (SELECT rowid FROM MediaText "
+			                                          "WHERE MediaText MATCH %s))",
+			                         pattern, match);
+			sqlite3_free (match);
+		} else {
+			query = g_strdup_printf ("SELECT DISTINCT m0.id FROM Media AS m0 "
+			                         "WHERE m0.key='title' AND "
+			                         "((m0.value COLLATE NOCASE) LIKE %s)",
+			                         pattern);
+		}
+
+		for (i = 0; i < rounds; i++) {
+			g_timer_start (timer);
+			rows = run_query (sql, query);
+			times[i] = g_timer_elapsed (timer, NULL) * 1000.0;
+		}
+
+		qsort (times, rounds, sizeof (gdouble), compare_doubles);
+		total += times[rounds / 2];
+
+		printf ("%s\tkeystroke_%d_ms\t%.3f\n", name, len, times[rounds / 2]);
+		printf ("%s\tkeystroke_%d_row_count\t%d\n", name, len, rows);
+
+		g_free (query);
+		g_free (prefix);
+		sqlite3_free (pattern);
+	}
+
+	printf ("%s\ttotal_ms\t%.3f\n", name, total);
+
+	g_timer_destroy (timer);
+	g_free (times);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *search = NULL;
+	gint songs = DEFAULT_SONGS, rounds = DEFAULT_ROUNDS, opt;
+	GTimer *timer;
+	sqlite3 *sql;
+
+	while ((opt = getopt (argc, argv, "n:r:s:")) != -1) {
+		switch (opt) {
+			case 'n':
+				songs = atoi (optarg);
+				break;
+			case 'r':
+				rounds = MAX (atoi (optarg), 1);
+				break;
+			case 's':
+				search = g_strdup (optarg);
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-n songs] [-r rounds] [-s search]\n",
+				         argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (sqlite3_open (":memory:", &sql)) {
+		fprintf (stderr, "Could not open database: %s\n", sqlite3_errmsg (sql));
+		return EXIT_FAILURE;
+	}
+
+	make_words ();
+	fill (sql, songs);
+	printf ("setup\tmedia_row_count\t%d\n", songs * (gint) G_N_ELEMENTS (keys));
+
+	if (!search) {
+		search = g_strdup_printf ("SELECT value FROM Media "
+		                          "WHERE id=%d AND key='title'", songs / 2);
+		sqlite3_exec (sql, search, first_value, &search, NULL);
+	}
+
+	run ("like", sql, search, rounds, FALSE);
+
+	timer = g_timer_new ();
+	build_text_index (sql);
+	printf ("setup\ttext_index_build_ms\t%.3f\n",
+	        g_timer_elapsed (timer, NULL) * 1000.0);
+	g_timer_destroy (timer);
+
+	run ("text_index", sql, search, rounds, TRUE);
+
+	sqlite3_close (sql);
+	g_free (search);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Pipelined request benchmark.
+ *
+ * Queues a large number of medialib_get_info requests on a single
+ * connection before waiting for any of them, so that the client keeps
+ * that many results outstanding at once. This mostly exercises the
+ * client side result registry and the IPC write/read path.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <xmmsclient/xmmsclient.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define DEFAULT_REQUESTS 100000
+
+static double
+now_ms (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void
+usage (const char *prog)
+{
+	fprintf (stderr, "Usage: %s [-n requests] [-i id] [-p path]\n"
+	         "  -n  number of requests to keep in flight (default %d)\n"
+	         "  -i  medialib id to ask for (default 1)\n"
+	         "  -p  ipc path of the server (default $XMMS_PATH)\n",
+	         prog, DEFAULT_REQUESTS);
+	exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char **argv)
+{
+	xmmsc_connection_t *conn;
+	xmmsc_result_t **results;
+	const char *path = NULL;
+	double start, queued, elapsed;
+	int requests = DEFAULT_REQUESTS;
+	int id = 1, errors = 0;
+	int i, opt;
+
+	while ((opt = getopt (argc, argv, "n:i:p:")) != -1) {
+		switch (opt) {
+			case 'n':
+				requests = atoi (optarg);
+				break;
+			case 'i':
+				id = atoi (optarg);
+				break;
+			case 'p':
+				path = optarg;
+				break;
+			default:
+				usage (argv[0]);
+		}
+	}
+
+	if (requests < 1) {
+		usage (argv[0]);
+	}
+
+	conn = xmmsc_init ("pipelined-get-info");
+	if (!xmmsc_connect (conn, path)) {
+		fprintf (stderr, "Connection failed: %s\n",
+		         xmmsc_get_last_error (conn));
+		return EXIT_FAILURE;
+	}
+
+	results = calloc (requests, sizeof (xmmsc_result_t *));
+
+	start = now_ms ();
+	for (i = 0; i < requests; i++) {
+		results[i] = xmmsc_medialib_get_info (conn, id);
+	}
+	queued = now_ms () - start;
+
+	/* Waiting for the last one first lets the replies be looked up
+	 * while every other result is still registered. */
+	xmmsc_result_wait (results[requests - 1]);
+
+	for (i = 0; i < requests; i++) {
+		xmmsc_result_wait (results[i]);
+		if (xmmsv_is_error (xmmsc_result_get_value (results[i]))) {
+			errors++;
+		}
+		xmmsc_result_unref (results[i]);
+	}
+	elapsed = now_ms () - start;
+
+	printf ("pipelined_get_info\trequest_count\t%d\n", requests);
+	printf ("pipelined_get_info\terror_count\t%d\n", errors);
+	printf ("pipelined_get_info\tqueue_ms\t%.3f\n", queued);
+	printf ("pipelined_get_info\ttotal_ms\t%.3f\n", elapsed);
+	printf ("pipelined_get_info\trequests_per_sec\t%.1f\n",
+	        requests / (elapsed / 1000.0));
+
+	free (results);
+	xmmsc_unref (conn);
+
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Playlist benchmark.
+ *
+ * Times the playlist object the way clients use it: adding and
+ * inserting medialib entries, moving and removing entries and
+ * clearing the playlist, with the change broadcasts and the
+ * collection index updates that come with them. Moves, removes and
+ * clears go through the same commands the ipc calls.
+ *
+ * Every figure is the median of a number of rounds, and the
+ * positions come from a fixed seed so runs can be compared.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "core_fixture.h"
+
+#include "xmmsc/xmmsc_idnumbers.h"
+#include "xmmsc/xmmsv.h"
+
+#define DEFAULT_ENTRIES 10000
+#define DEFAULT_ROUNDS 5
+#define SEED 4711
+
+static GRand *rnd;
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	const gdouble *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+static gdouble
+median (gdouble *times, gint rounds)
+{
+	qsort (times, rounds, sizeof (gdouble), compare_doubles);
+	return times[rounds / 2];
+}
+
+/* Run a playlist command like the ipc does, the arguments are
+ * taken over */
+static void
+call (xmms_playlist_t *playlist, guint cmdid, xmmsv_t *args)
+{
+	xmms_object_cmd_arg_t arg;
+
+	xmms_object_cmd_arg_init (&arg);
+	arg.args = args;
+
+	xmms_object_cmd_call (XMMS_OBJECT (playlist), cmdid, &arg);
+	if (xmms_error_iserror (&arg.error)) {
+		fprintf (stderr, "Playlist command %u failed: %s\n", cmdid,
+		         xmms_error_message_get (&arg.error));
+		exit (EXIT_FAILURE);
+	}
+
+	if (arg.retval) {
+		xmmsv_unref (arg.retval);
+	}
+	xmmsv_unref (args);
+}
+
+static xmmsv_t *
+make_args (gint count, ...)
+{
+	xmmsv_t *args;
+	va_list ap;
+	gint i;
+
+	args = xmmsv_new_list ();
+	xmmsv_list_append_string (args, XMMS_ACTIVE_PLAYLIST);
+
+	va_start (ap, count);
+	for (i = 0; i < count; i++) {
+		xmmsv_list_append_int (args, va_arg (ap, gint));
+	}
+	va_end (ap);
+
+	return args;
+}
+
+static void
+bench_playlist (gint entries, gint rounds)
+{
+	gdouble *add, *insert, *move, *remove, *clear;
+	xmms_medialib_entry_t *ids;
+	xmms_playlist_t *playlist;
+	xmms_error_t err;
+	GTimer *timer;
+	gint ops, i, r;
+	gchar *url;
+
+	playlist = core_fixture_playlist ();
+
+	ids = g_new (xmms_medialib_entry_t, entries);
+	for (i = 0; i < entries; i++) {
+		url = g_strdup_printf ("file:///music/%d/%d.ogg", i / 12, i);
+		ids[i] = core_fixture_entry (url);
+		g_free (url);
+	}
+
+	add = g_new (gdouble, rounds);
+	insert = g_new (gdouble, rounds);
+	move = g_new (gdouble, rounds);
+	remove = g_new (gdouble, rounds);
+	clear = g_new (gdouble, rounds);
+	timer = g_timer_new ();
+
+	xmms_error_reset (&err);
+
+	/* the ones in the middle shift half the playlist each */
+	ops = MIN (entries, 1000);
+
+	for (r = 0; r < rounds; r++) {
+		g_timer_start (timer);
+		for (i = 0; i < entries; i++) {
+			xmms_playlist_add_entry (playlist, XMMS_ACTIVE_PLAYLIST,
+			                         ids[i], &err);
+		}
+		add[r] = g_timer_elapsed (timer, NULL) * 1e9 / entries;
+
+		g_timer_start (timer);
+		for (i = 0; i < ops; i++) {
+			xmms_playlist_insert_entry (playlist, XMMS_ACTIVE_PLAYLIST,
+			                            g_rand_int_range (rnd, 0, entries),
+			                            ids[i], &err);
+		}
+		insert[r] = g_timer_elapsed (timer, NULL) * 1e9 / ops;
+
+		g_timer_start (timer);
+		for (i = 0; i < ops; i++) {
+			call (playlist, XMMS_IPC_CMD_MOVE_ENTRY,
+			      make_args (2, g_rand_int_range (rnd, 0, entries),
+			                 g_rand_int_range (rnd, 0, entries)));
+		}
+		move[r] = g_timer_elapsed (timer, NULL) * 1e9 / ops;
+
+		g_timer_start (timer);
+		for (i = 0; i < ops; i++) {
+			call (playlist, XMMS_IPC_CMD_REMOVE_ENTRY,
+			      make_args (1, g_rand_int_range (rnd, 0, entries)));
+		}
+		remove[r] = g_timer_elapsed (timer, NULL) * 1e9 / ops;
+
+		if (xmms_error_iserror (&err)) {
+			fprintf (stderr, "Adding to the playlist failed: %s\n",
+			         xmms_error_message_get (&err));
+			exit (EXIT_FAILURE);
+		}
+
+		g_timer_start (timer);
+		call (playlist, XMMS_IPC_CMD_CLEAR, make_args (0));
+		clear[r] = g_timer_elapsed (timer, NULL) * 1e6;
+	}
+
+	printf ("playlist\tentry_count\t%d\n", entries);
+	printf ("playlist\tadd_ns\t%.1f\n", median (add, rounds));
+	printf ("playlist\tinsert_ns\t%.1f\n", median (insert, rounds));
+	printf ("playlist\tmove_ns\t%.1f\n", median (move, rounds));
+	printf ("playlist\tremove_ns\t%.1f\n", median (remove, rounds));
+	printf ("playlist\tclear_us\t%.1f\n", median (clear, rounds));
+
+	g_timer_destroy (timer);
+	g_free (clear);
+	g_free (remove);
+	g_free (move);
+	g_free (insert);
+	g_free (add);
+	g_free (ids);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint entries = DEFAULT_ENTRIES, rounds = DEFAULT_ROUNDS, opt;
+
+	while ((opt = getopt (argc, argv, "n:r:")) != -1) {
+		switch (opt) {
+			case 'n':
+				entries = MAX (atoi (optarg), 1);
+				break;
+			case 'r':
+				rounds = MAX (atoi (optarg), 1);
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-n entries] [-r rounds]\n",
+				         argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (!core_fixture_init ()) {
+		fprintf (stderr, "Could not set up the server\n");
+		core_fixture_fini ();
+		return EXIT_FAILURE;
+	}
+
+	rnd = g_rand_new_with_seed (SEED);
+
+	bench_playlist (entries, rounds);
+
+	g_rand_free (rnd);
+
+	core_fixture_fini ();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Replaygain kernel benchmark.
+ *
+ * Applies a gain to a buffer of every sample format with each of the
+ * kernel implementations the CPU supports, the same way the replaygain
+ * plugin does for every read, and with dither for the formats it is
+ * used with.
+ *
+ * The number of passes can be given on the command line. Results are
+ * printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "rg_gain.h"
+
+#define DEFAULT_PASSES 2000
+/* what a decoder typically hands the replaygain plugin */
+#define BUFFER_BYTES 4096
+
+static const struct {
+	xmms_sample_format_t format;
+	const gchar *name;
+} formats[] = {
+	{ XMMS_SAMPLE_FORMAT_S8, "s8" },
+	{ XMMS_SAMPLE_FORMAT_U8, "u8" },
+	{ XMMS_SAMPLE_FORMAT_S16, "s16" },
+	{ XMMS_SAMPLE_FORMAT_U16, "u16" },
+	{ XMMS_SAMPLE_FORMAT_S32, "s32" },
+	{ XMMS_SAMPLE_FORMAT_U32, "u32" },
+	{ XMMS_SAMPLE_FORMAT_FLOAT, "float" },
+	{ XMMS_SAMPLE_FORMAT_DOUBLE, "double" },
+};
+
+/* random samples, but only sensible values for the floating point
+ * formats */
+static void
+fill (xmms_sample_format_t format, guint8 *buf)
+{
+	gint i;
+
+	for (i = 0; i < BUFFER_BYTES / sizeof (guint32); i++) {
+		((guint32 *) buf)[i] = g_random_int ();
+	}
+
+	if (format == XMMS_SAMPLE_FORMAT_FLOAT) {
+		for (i = 0; i < BUFFER_BYTES / sizeof (gfloat); i++) {
+			((gfloat *) buf)[i] = g_random_double_range (-1.0, 1.0);
+		}
+	} else if (format == XMMS_SAMPLE_FORMAT_DOUBLE) {
+		for (i = 0; i < BUFFER_BYTES / sizeof (gdouble); i++) {
+			((gdouble *) buf)[i] = g_random_double_range (-1.0, 1.0);
+		}
+	}
+}
+
+static void
+run (const gchar *name, xmms_rg_gain_func_t func,
+     xmms_sample_format_t format, guint passes, gboolean dither)
+{
+	guint8 orig[BUFFER_BYTES], buf[BUFFER_BYTES];
+	gfloat noise[BUFFER_BYTES];
+	guint32 state = 1;
+	GTimer *timer;
+	gdouble elapsed;
+	gint count;
+	guint n;
+
+	count = BUFFER_BYTES / xmms_sample_size_get (format);
+	fill (format, orig);
+
+	timer = g_timer_new ();
+
+	for (n = 0; n < passes; n++) {
+		/* start from the same samples every time, like the next
+		 * buffer from the decoder */
+		memcpy (buf, orig, BUFFER_BYTES);
+		if (dither) {
+			xmms_rg_gain_dither (&state, noise, count);
+		}
+		func (buf, count, 1.7, dither ? noise : NULL);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	printf ("%s\ttotal_ms\t%.2f\n", name, elapsed * 1000.0);
+	printf ("%s\tmb_per_sec\t%.1f\n", name,
+	        (gdouble) passes * BUFFER_BYTES / elapsed / (1024 * 1024));
+}
+
+int
+main (int argc, char **argv)
+{
+	xmms_rg_gain_impl_t impl;
+	xmms_rg_gain_func_t func;
+	guint passes = DEFAULT_PASSES;
+	gchar *name;
+	gint i, size;
+
+	if (argc > 1) {
+		passes = atoi (argv[1]);
+	}
+
+	printf ("replaygain\tbest\t%s\n",
+	        xmms_rg_gain_impl_name (xmms_rg_gain_impl_best ()));
+
+	for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+		size = xmms_sample_size_get (formats[i].format);
+
+		for (impl = 0; impl < XMMS_RG_GAIN_IMPL_COUNT; impl++) {
+			func = xmms_rg_gain_func (formats[i].format, impl);
+			if (!func) {
+				continue;
+			}
+
+			name = g_strdup_printf ("%s_%s", formats[i].name,
+			                        xmms_rg_gain_impl_name (impl));
+			run (name, func, formats[i].format, passes, FALSE);
+			g_free (name);
+
+			if (size <= 2) {
+				name = g_strdup_printf ("%s_%s_dither", formats[i].name,
+				                        xmms_rg_gain_impl_name (impl));
+				run (name, func, formats[i].format, passes, TRUE);
+				g_free (name);
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Ringbuffer throughput benchmark.
+ *
+ * Pushes a fixed amount of data through a ringbuffer of the default
+ * output.buffersize, from a filler thread to a reader thread sharing
+ * one mutex the way the output does, for a few chunk sizes.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "xmmspriv/xmms_ringbuf.h"
+
+#define DEFAULT_MEGABYTES 1024
+#define BUFFER_SIZE 32768
+
+typedef struct {
+	xmms_ringbuf_t *ringbuf;
+	GMutex *mutex;
+	guint chunk;
+	guint64 total;
+} pipe_t;
+
+static gpointer
+filler (gpointer udata)
+{
+	pipe_t *p = udata;
+	guint64 written = 0;
+	guint8 *buf;
+
+	buf = g_malloc0 (p->chunk);
+
+	g_mutex_lock (p->mutex);
+	while (written < p->total) {
+		written += xmms_ringbuf_write_wait (p->ringbuf, buf, p->chunk,
+		                                    p->mutex);
+	}
+	xmms_ringbuf_set_eos (p->ringbuf, TRUE);
+	g_mutex_unlock (p->mutex);
+
+	g_free (buf);
+
+	return NULL;
+}
+
+static void
+run (guint chunk, guint64 total)
+{
+	GThread *thread;
+	GTimer *timer;
+	guint8 *buf;
+	guint64 read = 0;
+	guint res;
+	gdouble secs;
+	pipe_t p;
+
+	p.ringbuf = xmms_ringbuf_new (BUFFER_SIZE);
+	p.mutex = g_mutex_new ();
+	p.chunk = chunk;
+	p.total = total;
+
+	buf = g_malloc (chunk);
+	timer = g_timer_new ();
+
+	thread = g_thread_create (filler, &p, TRUE, NULL);
+
+	g_mutex_lock (p.mutex);
+	do {
+		res = xmms_ringbuf_read_wait (p.ringbuf, buf, chunk, p.mutex);
+		read += res;
+	} while (res > 0 || !xmms_ringbuf_iseos (p.ringbuf));
+	g_mutex_unlock (p.mutex);
+
+	secs = g_timer_elapsed (timer, NULL);
+
+	g_thread_join (thread);
+
+	if (read != total) {
+		fprintf (stderr, "Read %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+		         " bytes\n", read, total);
+		exit (EXIT_FAILURE);
+	}
+
+	printf ("chunk_%u\tmb_per_sec\t%.1f\n", chunk, total / 1048576.0 / secs);
+	printf ("chunk_%u\tchunk_ns\t%.1f\n", chunk,
+	        secs * 1e9 / (total / chunk));
+
+	g_timer_destroy (timer);
+	g_free (buf);
+	g_mutex_free (p.mutex);
+	xmms_ringbuf_destroy (p.ringbuf);
+}
+
+int
+main (int argc, char **argv)
+{
+	guint chunks[] = { 512, 4096, 16384 };
+	guint64 total;
+	gint megabytes = DEFAULT_MEGABYTES, opt, i;
+
+	while ((opt = getopt (argc, argv, "m:")) != -1) {
+		switch (opt) {
+			case 'm':
+				megabytes = MAX (atoi (optarg), 1);
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-m megabytes]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	g_thread_init (NULL);
+
+	total = (guint64) megabytes * 1024 * 1024;
+
+	printf ("setup\tbuffer_bytes\t%d\n", BUFFER_SIZE);
+	printf ("setup\tdata_bytes\t%" G_GUINT64_FORMAT "\n", total);
+
+	for (i = 0; i < G_N_ELEMENTS (chunks); i++) {
+		run (chunks[i], total);
+	}
+
+	return EXIT_SUCCESS;
+}
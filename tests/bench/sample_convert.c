@@ -0,0 +1,200 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file Sample conversion benchmark.
+ *
+ * Runs the generated sample converters over a minute of noise in the
+ * buffer sizes the converter xform gets them, for the conversions
+ * that are common between decoders and outputs, and reports how many
+ * times faster than realtime each one is.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "xmmspriv/xmms_sample.h"
+#include "xmmspriv/xmms_streamtype.h"
+#include "xmms/xmms_object.h"
+
+#define DEFAULT_SECONDS 60
+#define DEFAULT_ROUNDS 5
+#define CHUNK_FRAMES 1024
+#define SEED 4711
+
+typedef struct {
+	const gchar *name;
+	xmms_sample_format_t from_format;
+	gint from_channels;
+	gint from_rate;
+	xmms_sample_format_t to_format;
+	gint to_channels;
+	gint to_rate;
+} conversion_t;
+
+static const conversion_t conversions[] = {
+	{ "s16_to_float", XMMS_SAMPLE_FORMAT_S16, 2, 44100,
+	  XMMS_SAMPLE_FORMAT_FLOAT, 2, 44100 },
+	{ "float_to_s16", XMMS_SAMPLE_FORMAT_FLOAT, 2, 44100,
+	  XMMS_SAMPLE_FORMAT_S16, 2, 44100 },
+	{ "s16_to_s32", XMMS_SAMPLE_FORMAT_S16, 2, 44100,
+	  XMMS_SAMPLE_FORMAT_S32, 2, 44100 },
+	{ "mono_to_stereo", XMMS_SAMPLE_FORMAT_S16, 1, 44100,
+	  XMMS_SAMPLE_FORMAT_S16, 2, 44100 },
+	{ "resample_44100_48000", XMMS_SAMPLE_FORMAT_S16, 2, 44100,
+	  XMMS_SAMPLE_FORMAT_S16, 2, 48000 },
+	{ "resample_48000_44100", XMMS_SAMPLE_FORMAT_FLOAT, 2, 48000,
+	  XMMS_SAMPLE_FORMAT_S16, 2, 44100 },
+};
+
+static xmms_stream_type_t *
+pcm_type (xmms_sample_format_t format, gint channels, gint rate)
+{
+	return _xmms_stream_type_new (XMMS_STREAM_TYPE_BEGIN,
+	                              XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                              XMMS_STREAM_TYPE_FMT_FORMAT, format,
+	                              XMMS_STREAM_TYPE_FMT_CHANNELS, channels,
+	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE, rate,
+	                              XMMS_STREAM_TYPE_END);
+}
+
+/* Noise that is valid for the format, floats stay within [-1, 1] */
+static gpointer
+make_input (xmms_sample_format_t format, gint samples)
+{
+	GRand *rnd;
+	gfloat *f;
+	gint16 *s;
+	gint i;
+
+	rnd = g_rand_new_with_seed (SEED);
+
+	if (format == XMMS_SAMPLE_FORMAT_FLOAT) {
+		f = g_new (gfloat, samples);
+		for (i = 0; i < samples; i++) {
+			f[i] = g_rand_double_range (rnd, -1.0, 1.0);
+		}
+		g_rand_free (rnd);
+		return f;
+	}
+
+	s = g_new (gint16, samples);
+	for (i = 0; i < samples; i++) {
+		s[i] = g_rand_int_range (rnd, -32768, 32768);
+	}
+	g_rand_free (rnd);
+	return s;
+}
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	const gdouble *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+static void
+run (const conversion_t *c, gint seconds, gint rounds)
+{
+	xmms_stream_type_t *from, *to;
+	xmms_sample_converter_t *conv;
+	xmms_sample_t *out;
+	gdouble *times, secs;
+	GTimer *timer;
+	guint8 *in;
+	guint frame, len, chunk, outlen, pos;
+	guint64 produced = 0;
+	gint r;
+
+	from = pcm_type (c->from_format, c->from_channels, c->from_rate);
+	to = pcm_type (c->to_format, c->to_channels, c->to_rate);
+
+	conv = xmms_sample_converter_init (from, to);
+	if (!conv) {
+		fprintf (stderr, "No converter for %s\n", c->name);
+		exit (EXIT_FAILURE);
+	}
+
+	frame = xmms_sample_frame_size_get (from);
+	len = seconds * c->from_rate * frame;
+	chunk = CHUNK_FRAMES * frame;
+
+	in = make_input (c->from_format,
+	                 seconds * c->from_rate * c->from_channels);
+
+	times = g_new (gdouble, rounds);
+	timer = g_timer_new ();
+
+	for (r = 0; r < rounds; r++) {
+		xmms_sample_convert_reset (conv);
+		produced = 0;
+
+		g_timer_start (timer);
+		for (pos = 0; pos + chunk <= len; pos += chunk) {
+			xmms_sample_convert (conv, in + pos, chunk, &out, &outlen);
+			produced += outlen;
+		}
+		times[r] = g_timer_elapsed (timer, NULL);
+	}
+
+	qsort (times, rounds, sizeof (gdouble), compare_doubles);
+	secs = times[rounds / 2];
+
+	printf ("%s\ttotal_ms\t%.3f\n", c->name, secs * 1000.0);
+	printf ("%s\tx_realtime\t%.1f\n", c->name, seconds / secs);
+	printf ("%s\tin_mb_per_sec\t%.1f\n", c->name, len / 1048576.0 / secs);
+	printf ("%s\tout_bytes\t%" G_GUINT64_FORMAT "\n", c->name, produced);
+
+	g_timer_destroy (timer);
+	g_free (times);
+	g_free (in);
+	xmms_object_unref (conv);
+	xmms_object_unref (to);
+	xmms_object_unref (from);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint seconds = DEFAULT_SECONDS, rounds = DEFAULT_ROUNDS, opt, i;
+
+	while ((opt = getopt (argc, argv, "s:r:")) != -1) {
+		switch (opt) {
+			case 's':
+				seconds = MAX (atoi (optarg), 1);
+				break;
+			case 'r':
+				rounds = MAX (atoi (optarg), 1);
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-s seconds] [-r rounds]\n",
+				         argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	g_thread_init (NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (conversions); i++) {
+		run (&conversions[i], seconds, rounds);
+	}
+
+	return EXIT_SUCCESS;
+}
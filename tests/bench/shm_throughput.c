@@ -0,0 +1,242 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file IPC transport throughput benchmark.
+ *
+ * Pushes a stream of messages carrying a binary payload from a client
+ * transport to a forked sink process, once over unix:// and once over
+ * shm://, and reports how fast each one moved the data. No server is
+ * needed, the transports are driven directly.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+
+#include "xmms_configuration.h"
+#include "xmmsc/xmmsv.h"
+#include "xmmsc/xmmsc_ipc_msg.h"
+#include "xmmsc/xmmsc_ipc_transport.h"
+
+#define DEFAULT_MESSAGES 100000
+#define DEFAULT_PAYLOAD 4096
+
+static double
+now_ms (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void
+wait_fd (int fd, bool out)
+{
+	fd_set fds;
+
+	FD_ZERO (&fds);
+	FD_SET (fd, &fds);
+
+	select (fd + 1, out ? NULL : &fds, out ? &fds : NULL, NULL, NULL);
+}
+
+/* Reads messages until the writer hangs up, returns how many arrived */
+static int
+sink (xmms_ipc_transport_t *server)
+{
+	xmms_ipc_transport_t *client;
+	xmms_ipc_msg_t *msg;
+	bool disconnected = false;
+	int count = 0;
+
+	do {
+		wait_fd (server->fd, false);
+	} while (!(client = xmms_ipc_server_accept (server)));
+
+	msg = xmms_ipc_msg_alloc ();
+
+	while (!disconnected) {
+		if (xmms_ipc_msg_read_transport (msg, client, &disconnected)) {
+			xmms_ipc_msg_destroy (msg);
+			msg = xmms_ipc_msg_alloc ();
+			count++;
+		} else if (!disconnected && !xmms_ipc_transport_read_pending (client)) {
+			wait_fd (client->fd, false);
+		}
+	}
+
+	xmms_ipc_msg_destroy (msg);
+	xmms_ipc_transport_destroy (client);
+
+	return count;
+}
+
+static int
+run (const char *name, const char *url, int messages, int payload)
+{
+	xmms_ipc_transport_t *server, *client;
+	xmms_ipc_transport_stats_t stats;
+	xmms_ipc_msg_t *batch[XMMS_IPC_TRANSPORT_MAX_IOVEC];
+	unsigned char *data;
+	xmmsv_t *value;
+	double start, elapsed;
+	bool disconnected = false;
+	int queued = 0, sent = 0, status, i, n;
+	pid_t pid;
+
+	server = xmms_ipc_server_init (url);
+	if (!server) {
+		fprintf (stderr, "%s: could not listen on %s\n", name, url);
+		return -1;
+	}
+
+	pid = fork ();
+	if (pid == 0) {
+		n = sink (server);
+		_exit (n == messages ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	client = xmms_ipc_client_init (url);
+	if (!client) {
+		fprintf (stderr, "%s: could not connect to %s\n", name, url);
+		kill (pid, SIGTERM);
+		waitpid (pid, NULL, 0);
+		xmms_ipc_transport_destroy (server);
+		return -1;
+	}
+
+	data = calloc (1, payload);
+	value = xmmsv_new_bin (data, payload);
+
+	start = now_ms ();
+
+	while (sent < messages && !disconnected) {
+		while (queued < XMMS_IPC_TRANSPORT_MAX_IOVEC && sent + queued < messages) {
+			batch[queued] = xmms_ipc_msg_new (0, 0);
+			xmms_ipc_msg_put_value (batch[queued], value);
+			queued++;
+		}
+
+		n = xmms_ipc_msg_write_transport_many (batch, queued, client,
+		                                       &disconnected);
+		if (n <= 0) {
+			wait_fd (client->fd, true);
+			continue;
+		}
+
+		for (i = 0; i < n; i++) {
+			xmms_ipc_msg_destroy (batch[i]);
+		}
+		memmove (batch, batch + n, (queued - n) * sizeof (batch[0]));
+		queued -= n;
+		sent += n;
+	}
+
+	xmms_ipc_transport_stats_get (client, &stats);
+	xmms_ipc_transport_destroy (client);
+
+	/* The sink exits once it has read everything */
+	waitpid (pid, &status, 0);
+	elapsed = now_ms () - start;
+
+	for (i = 0; i < queued; i++) {
+		xmms_ipc_msg_destroy (batch[i]);
+	}
+	xmmsv_unref (value);
+	free (data);
+	xmms_ipc_transport_destroy (server);
+
+	if (!WIFEXITED (status) || WEXITSTATUS (status) != EXIT_SUCCESS) {
+		fprintf (stderr, "%s: sink lost messages\n", name);
+		return -1;
+	}
+
+	printf ("%s\tmessage_count\t%d\n", name, sent);
+	printf ("%s\ttotal_ms\t%.3f\n", name, elapsed);
+	printf ("%s\tmsgs_per_sec\t%.1f\n", name, sent / (elapsed / 1000.0));
+	printf ("%s\tmb_per_sec\t%.1f\n", name,
+	        stats.bytes_out / (1024.0 * 1024.0) / (elapsed / 1000.0));
+	printf ("%s\twrite_calls\t%llu\n", name,
+	        (unsigned long long) stats.write_calls);
+
+	return 0;
+}
+
+static void
+usage (const char *prog)
+{
+	fprintf (stderr, "Usage: %s [-n messages] [-s bytes] [-d dir]\n"
+	         "  -n  number of messages to send (default %d)\n"
+	         "  -s  payload size of each message (default %d)\n"
+	         "  -d  directory for the sockets (default /tmp)\n",
+	         prog, DEFAULT_MESSAGES, DEFAULT_PAYLOAD);
+	exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char **argv)
+{
+	const char *dir = "/tmp";
+	char url[256];
+	int messages = DEFAULT_MESSAGES;
+	int payload = DEFAULT_PAYLOAD;
+	int ret = 0, opt;
+
+	while ((opt = getopt (argc, argv, "n:s:d:")) != -1) {
+		switch (opt) {
+			case 'n':
+				messages = atoi (optarg);
+				break;
+			case 's':
+				payload = atoi (optarg);
+				break;
+			case 'd':
+				dir = optarg;
+				break;
+			default:
+				usage (argv[0]);
+		}
+	}
+
+	if (messages < 1 || payload < 0 || dir[0] != '/') {
+		usage (argv[0]);
+	}
+
+	signal (SIGPIPE, SIG_IGN);
+
+	snprintf (url, sizeof (url), "unix://%s/xmms2-bench-%d", dir, getpid ());
+	ret |= run ("ipc_unix", url, messages, payload);
+	unlink (url + strlen ("unix://"));
+
+#ifdef HAVE_MEMFD_CREATE
+	snprintf (url, sizeof (url), "shm://%s/xmms2-bench-%d", dir, getpid ());
+	ret |= run ("ipc_shm", url, messages, payload);
+	unlink (url + strlen ("shm://"));
+#endif
+
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,320 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file xmmsv benchmark.
+ *
+ * Times the value operations every command and broadcast goes
+ * through: serializing and deserializing a query_infos sized reply,
+ * setting and looking up keys in per song property dicts, and the
+ * idlist operations a playlist is made of.
+ *
+ * Every figure is the median of a number of rounds, and the made up
+ * data comes from a fixed seed so runs can be compared.
+ *
+ * Results are printed one per line as "benchmark<TAB>metric<TAB>value".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "xmmsc/xmmsv.h"
+#include "xmmsc/xmmsv_coll.h"
+
+#define DEFAULT_ENTRIES 100000
+#define DEFAULT_ROUNDS 5
+#define SEED 4711
+
+static const gchar *keys[] = {
+	"album", "artist", "bitrate", "duration", "genre",
+	"id", "title", "tracknr", "url", "added"
+};
+
+static GRand *rnd;
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	const gdouble *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+static gdouble
+median (gdouble *times, gint rounds)
+{
+	qsort (times, rounds, sizeof (gdouble), compare_doubles);
+	return times[rounds / 2];
+}
+
+/* A list of dicts, like the reply to a query_infos on the medialib */
+static xmmsv_t *
+make_infos (gint entries)
+{
+	xmmsv_t *list, *dict;
+	gchar *value;
+	gint i, j;
+
+	list = xmmsv_new_list ();
+
+	for (i = 0; i < entries; i++) {
+		dict = xmmsv_new_dict ();
+		for (j = 0; j < G_N_ELEMENTS (keys); j++) {
+			if (strcmp (keys[j], "url") == 0) {
+				value = g_strdup_printf ("file:///music/%d/%d.ogg", i / 12, i);
+				xmmsv_dict_set_string (dict, keys[j], value);
+				g_free (value);
+			} else if (j % 2) {
+				value = g_strdup_printf ("%s %u", keys[j],
+				                         g_rand_int_range (rnd, 0, 5000));
+				xmmsv_dict_set_string (dict, keys[j], value);
+				g_free (value);
+			} else {
+				xmmsv_dict_set_int (dict, keys[j],
+				                    g_rand_int_range (rnd, 0, 1000000));
+			}
+		}
+		xmmsv_list_append (list, dict);
+		xmmsv_unref (dict);
+	}
+
+	return list;
+}
+
+static void
+bench_serialize (gint entries, gint rounds)
+{
+	xmmsv_t *infos, *bin, *back;
+	const unsigned char *data;
+	unsigned int len = 0;
+	gdouble *ser, *deser, ser_ms, deser_ms;
+	GTimer *timer;
+	gint i;
+
+	ser = g_new (gdouble, rounds);
+	deser = g_new (gdouble, rounds);
+	timer = g_timer_new ();
+
+	infos = make_infos (entries);
+
+	for (i = 0; i < rounds; i++) {
+		g_timer_start (timer);
+		bin = xmmsv_serialize (infos);
+		ser[i] = g_timer_elapsed (timer, NULL) * 1000.0;
+
+		xmmsv_get_bin (bin, &data, &len);
+
+		g_timer_start (timer);
+		back = xmmsv_deserialize (bin);
+		deser[i] = g_timer_elapsed (timer, NULL) * 1000.0;
+
+		if (!back || xmmsv_list_get_size (back) != entries) {
+			fprintf (stderr, "Round trip lost entries\n");
+			exit (EXIT_FAILURE);
+		}
+
+		xmmsv_unref (back);
+		xmmsv_unref (bin);
+	}
+
+	ser_ms = median (ser, rounds);
+	deser_ms = median (deser, rounds);
+
+	printf ("serialize\tentry_count\t%d\n", entries);
+	printf ("serialize\tserialized_bytes\t%u\n", len);
+	printf ("serialize\tserialize_ms\t%.3f\n", ser_ms);
+	printf ("serialize\tserialize_mb_per_sec\t%.1f\n",
+	        len / 1048576.0 / (ser_ms / 1000.0));
+	printf ("serialize\tdeserialize_ms\t%.3f\n", deser_ms);
+	printf ("serialize\tdeserialize_mb_per_sec\t%.1f\n",
+	        len / 1048576.0 / (deser_ms / 1000.0));
+
+	xmmsv_unref (infos);
+	g_timer_destroy (timer);
+	g_free (deser);
+	g_free (ser);
+}
+
+static void
+count_entry (const char *key, xmmsv_t *value, void *udata)
+{
+	(*(gint *) udata)++;
+}
+
+/* One small dict per song, the way the medialib hands out properties */
+static void
+bench_dict (gint entries, gint rounds)
+{
+	gdouble *set, *get, *iter;
+	xmmsv_t **dicts;
+	GTimer *timer;
+	gint32 value;
+	gint ops, i, j, r, seen;
+
+	set = g_new (gdouble, rounds);
+	get = g_new (gdouble, rounds);
+	iter = g_new (gdouble, rounds);
+	dicts = g_new (xmmsv_t *, entries);
+	timer = g_timer_new ();
+
+	ops = entries * G_N_ELEMENTS (keys);
+
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < entries; i++) {
+			dicts[i] = xmmsv_new_dict ();
+		}
+
+		g_timer_start (timer);
+		for (i = 0; i < entries; i++) {
+			for (j = 0; j < G_N_ELEMENTS (keys); j++) {
+				xmmsv_dict_set_int (dicts[i], keys[j], i);
+			}
+		}
+		set[r] = g_timer_elapsed (timer, NULL) * 1e9 / ops;
+
+		g_timer_start (timer);
+		for (i = 0; i < entries; i++) {
+			for (j = G_N_ELEMENTS (keys) - 1; j >= 0; j--) {
+				xmmsv_dict_entry_get_int (dicts[i], keys[j], &value);
+			}
+		}
+		get[r] = g_timer_elapsed (timer, NULL) * 1e9 / ops;
+
+		seen = 0;
+		g_timer_start (timer);
+		for (i = 0; i < entries; i++) {
+			xmmsv_dict_foreach (dicts[i], count_entry, &seen);
+		}
+		iter[r] = g_timer_elapsed (timer, NULL) * 1e9 / MAX (seen, 1);
+
+		for (i = 0; i < entries; i++) {
+			xmmsv_unref (dicts[i]);
+		}
+	}
+
+	printf ("dict\tentry_count\t%d\n", entries);
+	printf ("dict\tkey_count\t%d\n", (gint) G_N_ELEMENTS (keys));
+	printf ("dict\tset_ns\t%.1f\n", median (set, rounds));
+	printf ("dict\tget_ns\t%.1f\n", median (get, rounds));
+	printf ("dict\tforeach_ns\t%.1f\n", median (iter, rounds));
+
+	g_timer_destroy (timer);
+	g_free (dicts);
+	g_free (iter);
+	g_free (get);
+	g_free (set);
+}
+
+/* What a playlist does to its idlist as entries are added and shuffled about */
+static void
+bench_idlist (gint entries, gint rounds)
+{
+	gdouble *append, *insert, *move, *remove;
+	xmmsv_coll_t *coll;
+	GTimer *timer;
+	gint ops, i, r;
+
+	append = g_new (gdouble, rounds);
+	insert = g_new (gdouble, rounds);
+	move = g_new (gdouble, rounds);
+	remove = g_new (gdouble, rounds);
+	timer = g_timer_new ();
+
+	/* the ones in the middle shift half the list each */
+	ops = MIN (entries, 1000);
+
+	for (r = 0; r < rounds; r++) {
+		coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+
+		g_timer_start (timer);
+		for (i = 0; i < entries; i++) {
+			xmmsv_coll_idlist_append (coll, i + 1);
+		}
+		append[r] = g_timer_elapsed (timer, NULL) * 1e9 / entries;
+
+		g_timer_start (timer);
+		for (i = 0; i < ops; i++) {
+			xmmsv_coll_idlist_insert (coll, g_rand_int_range (rnd, 0, entries),
+			                          entries + i + 1);
+		}
+		insert[r] = g_timer_elapsed (timer, NULL) * 1e9 / ops;
+
+		g_timer_start (timer);
+		for (i = 0; i < ops; i++) {
+			xmmsv_coll_idlist_move (coll, g_rand_int_range (rnd, 0, entries),
+			                        g_rand_int_range (rnd, 0, entries));
+		}
+		move[r] = g_timer_elapsed (timer, NULL) * 1e9 / ops;
+
+		g_timer_start (timer);
+		for (i = 0; i < ops; i++) {
+			xmmsv_coll_idlist_remove (coll, g_rand_int_range (rnd, 0, entries));
+		}
+		remove[r] = g_timer_elapsed (timer, NULL) * 1e9 / ops;
+
+		if (xmmsv_coll_idlist_get_size (coll) != entries) {
+			fprintf (stderr, "Idlist has the wrong size\n");
+			exit (EXIT_FAILURE);
+		}
+
+		xmmsv_coll_unref (coll);
+	}
+
+	printf ("idlist\tentry_count\t%d\n", entries);
+	printf ("idlist\tappend_ns\t%.1f\n", median (append, rounds));
+	printf ("idlist\tinsert_ns\t%.1f\n", median (insert, rounds));
+	printf ("idlist\tmove_ns\t%.1f\n", median (move, rounds));
+	printf ("idlist\tremove_ns\t%.1f\n", median (remove, rounds));
+
+	g_timer_destroy (timer);
+	g_free (remove);
+	g_free (move);
+	g_free (insert);
+	g_free (append);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint entries = DEFAULT_ENTRIES, rounds = DEFAULT_ROUNDS, opt;
+
+	while ((opt = getopt (argc, argv, "n:r:")) != -1) {
+		switch (opt) {
+			case 'n':
+				entries = MAX (atoi (optarg), 1);
+				break;
+			case 'r':
+				rounds = MAX (atoi (optarg), 1);
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-n entries] [-r rounds]\n",
+				         argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	rnd = g_rand_new_with_seed (SEED);
+
+	bench_serialize (entries, rounds);
+	bench_dict (entries, rounds);
+	bench_idlist (entries, rounds);
+
+	g_rand_free (rnd);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,261 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xmmsc/xmmsc_ipc_msg.h"
+#include "xmmsc/xmmsc_ipc_transport.h"
+#include "xmmsclientpriv/xmmsclient.h"
+#include "xmmsclientpriv/xmmsclient_ipc.h"
+
+#define MANY 1000
+
+/* The results the client library hands the ipc, only the cookie
+ * matters to it */
+struct xmmsc_result_St {
+	uint32_t cookie;
+	int runs;
+};
+
+static xmmsc_ipc_t *ipc;
+static xmms_ipc_transport_t *server, *peer;
+static char url[64];
+static int disconnects;
+
+uint32_t
+xmmsc_result_cookie_get (xmmsc_result_t *res)
+{
+	return res->cookie;
+}
+
+void
+xmmsc_result_run (xmmsc_result_t *res, xmms_ipc_msg_t *msg)
+{
+	res->runs++;
+	xmms_ipc_msg_destroy (msg);
+}
+
+static void
+on_disconnect (void *data)
+{
+	disconnects++;
+}
+
+/* Send a reply for the cookie from the server end, and let the client
+ * read it */
+static int
+reply (uint32_t cookie)
+{
+	xmms_ipc_msg_t *msg;
+	bool disconnected = false;
+
+	msg = xmms_ipc_msg_new (0, 0);
+	xmms_ipc_msg_set_cookie (msg, cookie);
+	xmms_ipc_msg_write_transport (msg, peer, &disconnected);
+	xmms_ipc_msg_destroy (msg);
+
+	return xmmsc_ipc_io_in_callback (ipc);
+}
+
+SETUP (ipc_results) {
+	snprintf (url, sizeof (url), "unix:///tmp/xmms2-ipc-results-%d",
+	          (int) getpid ());
+
+	server = xmms_ipc_server_init (url);
+	if (!server) {
+		return 1;
+	}
+
+	ipc = xmmsc_ipc_init ();
+	xmmsc_ipc_disconnect_set (ipc, on_disconnect, NULL, NULL);
+	if (!xmmsc_ipc_connect (ipc, url)) {
+		return 1;
+	}
+
+	peer = xmms_ipc_server_accept (server);
+
+	return peer == NULL;
+}
+
+CLEANUP () {
+	if (peer) {
+		xmms_ipc_transport_destroy (peer);
+		peer = NULL;
+	}
+	xmmsc_ipc_destroy (ipc);
+	ipc = NULL;
+	xmms_ipc_transport_destroy (server);
+	unlink (url + strlen ("unix://"));
+
+	return 0;
+}
+
+CASE (test_unknown_cookie)
+{
+	xmmsc_result_t res = { 7, 0 };
+
+	CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, 7));
+
+	/* a reply nobody waits for is dropped */
+	CU_ASSERT_TRUE (reply (7));
+
+	xmmsc_ipc_result_register (ipc, &res);
+	CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, 7), &res);
+	CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, 8));
+	CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, 0));
+
+	CU_ASSERT_TRUE (reply (8));
+	CU_ASSERT_EQUAL (res.runs, 0);
+	CU_ASSERT_TRUE (reply (7));
+	CU_ASSERT_EQUAL (res.runs, 1);
+
+	xmmsc_ipc_result_unregister (ipc, &res);
+	CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, 7));
+	CU_ASSERT_TRUE (reply (7));
+	CU_ASSERT_EQUAL (res.runs, 1);
+}
+
+CASE (test_remove_while_pending)
+{
+	xmmsc_result_t *res;
+	int i;
+
+	/* enough to make the table grow a few times */
+	res = calloc (MANY, sizeof (xmmsc_result_t));
+	for (i = 0; i < MANY; i++) {
+		res[i].cookie = 1000 + i * 3;
+		xmmsc_ipc_result_register (ipc, &res[i]);
+	}
+
+	/* drop every other one, in an order that moves entries around
+	 * in the probe sequences */
+	for (i = MANY - 1; i >= 0; i -= 2) {
+		xmmsc_ipc_result_unregister (ipc, &res[i]);
+	}
+
+	for (i = 0; i < MANY; i++) {
+		if (i % 2) {
+			CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, res[i].cookie));
+		} else {
+			CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, res[i].cookie),
+			                     &res[i]);
+		}
+	}
+
+	/* replies still reach the ones left */
+	CU_ASSERT_TRUE (reply (res[0].cookie));
+	CU_ASSERT_TRUE (reply (res[1].cookie));
+	CU_ASSERT_TRUE (reply (res[MANY - 2].cookie));
+	CU_ASSERT_EQUAL (res[0].runs, 1);
+	CU_ASSERT_EQUAL (res[1].runs, 0);
+	CU_ASSERT_EQUAL (res[MANY - 2].runs, 1);
+
+	/* unregistering one that is gone already does nothing */
+	xmmsc_ipc_result_unregister (ipc, &res[1]);
+	CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, res[0].cookie),
+	                     &res[0]);
+
+	for (i = 0; i < MANY; i += 2) {
+		xmmsc_ipc_result_unregister (ipc, &res[i]);
+		CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, res[i].cookie));
+	}
+	for (i = 0; i < MANY; i++) {
+		CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, res[i].cookie));
+	}
+
+	free (res);
+}
+
+CASE (test_restart_signal)
+{
+	xmmsc_result_t signal = { 20, 0 }, other = { 21, 0 }, again = { 22, 0 };
+
+	xmmsc_ipc_result_register (ipc, &signal);
+	xmmsc_ipc_result_register (ipc, &other);
+
+	/* a restarted signal is registered again under its new cookie,
+	 * the way xmmsc_result_restart does it */
+	xmmsc_ipc_result_unregister (ipc, &signal);
+	signal.cookie = 22;
+	xmmsc_ipc_result_register (ipc, &signal);
+
+	CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, 20));
+	CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, 22), &signal);
+	CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, 21), &other);
+
+	CU_ASSERT_TRUE (reply (20));
+	CU_ASSERT_TRUE (reply (22));
+	CU_ASSERT_EQUAL (signal.runs, 1);
+
+	/* restarting it again under the same cookie keeps it */
+	xmmsc_ipc_result_unregister (ipc, &signal);
+	xmmsc_ipc_result_register (ipc, &signal);
+	CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, 22), &signal);
+
+	/* if a cookie does come around again, the newest result gets
+	 * the replies as it did with the list, and the old one going
+	 * away doesn't take the new one with it */
+	xmmsc_ipc_result_register (ipc, &again);
+	CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, 22), &again);
+	xmmsc_ipc_result_unregister (ipc, &signal);
+	CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, 22), &again);
+
+	CU_ASSERT_TRUE (reply (22));
+	CU_ASSERT_EQUAL (again.runs, 1);
+	CU_ASSERT_EQUAL (signal.runs, 1);
+
+	xmmsc_ipc_result_unregister (ipc, &again);
+	xmmsc_ipc_result_unregister (ipc, &other);
+	CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, 22));
+	CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, 21));
+}
+
+/* Runs last, it leaves the connection closed */
+CASE (test_zz_disconnect)
+{
+	xmmsc_result_t res[3] = { { 30, 0 }, { 31, 0 }, { 32, 0 } };
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		xmmsc_ipc_result_register (ipc, &res[i]);
+	}
+
+	xmms_ipc_transport_destroy (peer);
+	peer = NULL;
+
+	CU_ASSERT_FALSE (xmmsc_ipc_io_in_callback (ipc));
+	CU_ASSERT_TRUE (xmmsc_ipc_disconnected (ipc));
+	CU_ASSERT_EQUAL (disconnects, 1);
+
+	/* the results stay until their owners free them, which
+	 * unregisters them */
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, res[i].cookie),
+		                     &res[i]);
+	}
+	xmmsc_ipc_result_unregister (ipc, &res[1]);
+	CU_ASSERT_PTR_NULL (xmmsc_ipc_result_lookup (ipc, 31));
+	CU_ASSERT_PTR_EQUAL (xmmsc_ipc_result_lookup (ipc, 30), &res[0]);
+
+	/* the ones left when the connection goes are just forgotten,
+	 * CLEANUP destroys it with these still registered */
+	CU_ASSERT_EQUAL (res[0].runs + res[1].runs + res[2].runs, 0);
+}
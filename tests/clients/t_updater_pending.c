@@ -0,0 +1,210 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <glib.h>
+
+#include "pending.h"
+
+#define SETTLE 1000
+
+static updater_pending_t *pending;
+
+/* take out everything that is due at 'now', expecting exactly one op */
+static updater_op_t *
+take_one (gint64 now)
+{
+	updater_op_t *op;
+	GPtrArray *ops;
+
+	ops = updater_pending_take_due (pending, now);
+	CU_ASSERT_EQUAL_FATAL (ops->len, 1);
+
+	op = g_ptr_array_index (ops, 0);
+	g_ptr_array_free (ops, TRUE);
+
+	return op;
+}
+
+static void
+free_ops (GPtrArray *ops)
+{
+	g_ptr_array_foreach (ops, (GFunc) updater_op_free, NULL);
+	g_ptr_array_free (ops, TRUE);
+}
+
+SETUP (updater_pending) {
+	pending = updater_pending_new (SETTLE);
+	return 0;
+}
+
+CLEANUP () {
+	updater_pending_free (pending);
+	return 0;
+}
+
+CASE (test_write_burst_is_one_add)
+{
+	updater_op_t *op;
+	gint i;
+
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_CREATED, 0);
+	for (i = 1; i <= 50; i++) {
+		updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_CHANGED, i * 10);
+	}
+
+	CU_ASSERT_EQUAL (updater_pending_size (pending), 1);
+	CU_ASSERT_EQUAL (updater_pending_next_due (pending), 500 + SETTLE);
+
+	op = take_one (500 + SETTLE);
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_ADD);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///a.ogg");
+	updater_op_free (op);
+
+	CU_ASSERT_EQUAL (updater_pending_size (pending), 0);
+	CU_ASSERT_EQUAL (updater_pending_next_due (pending), -1);
+}
+
+CASE (test_not_due_until_settled)
+{
+	GPtrArray *ops;
+
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_CHANGED, 0);
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_CHANGED, 800);
+
+	ops = updater_pending_take_due (pending, SETTLE);
+	CU_ASSERT_EQUAL (ops->len, 0);
+	g_ptr_array_free (ops, TRUE);
+
+	CU_ASSERT_EQUAL (updater_pending_size (pending), 1);
+	free_ops (updater_pending_take_due (pending, 800 + SETTLE));
+}
+
+CASE (test_merge_rules)
+{
+	updater_op_t *op;
+
+	/* a change to a known file is a rehash */
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_CHANGED, 0);
+	op = take_one (SETTLE);
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_REHASH);
+	updater_op_free (op);
+
+	/* deleted and created again, the medialib may still have it */
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_DELETED, 0);
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_CREATED, 10);
+	op = take_one (10 + SETTLE);
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_REHASH);
+	updater_op_free (op);
+
+	/* created and deleted before it settled */
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_CREATED, 0);
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_DELETED, 10);
+	op = take_one (10 + SETTLE);
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_REMOVE);
+	updater_op_free (op);
+}
+
+CASE (test_remove_dir_replaces_children)
+{
+	updater_op_t *op;
+
+	updater_pending_event (pending, "file:///music/x/a.ogg", UPDATER_EVENT_CHANGED, 0);
+	updater_pending_event (pending, "file:///music/x/y/b.ogg", UPDATER_EVENT_CREATED, 0);
+	updater_pending_event (pending, "file:///music/xy.ogg", UPDATER_EVENT_CREATED, 0);
+
+	updater_pending_remove_dir (pending, "file:///music/x", 100);
+
+	CU_ASSERT_EQUAL (updater_pending_size (pending), 2);
+
+	op = take_one (SETTLE);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///music/xy.ogg");
+	updater_op_free (op);
+
+	op = take_one (100 + SETTLE);
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_REMOVE_DIR);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///music/x/");
+	updater_op_free (op);
+}
+
+CASE (test_set_keeps_newer_events)
+{
+	GPtrArray *ops;
+	updater_op_t *op;
+
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_DELETED, 0);
+	updater_pending_set (pending, "file:///a.ogg", UPDATER_OP_REHASH, 7, 0);
+
+	updater_pending_event (pending, "file:///b.ogg", UPDATER_EVENT_CREATED, 0);
+	updater_pending_set (pending, "file:///b.ogg", UPDATER_OP_REHASH, 8, 0);
+
+	updater_pending_set (pending, "file:///c.ogg", UPDATER_OP_REMOVE, 9, 0);
+
+	CU_ASSERT_EQUAL (updater_pending_size (pending), 3);
+
+	op = take_one (0);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///c.ogg");
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_REMOVE);
+	CU_ASSERT_EQUAL (op->id, 9);
+	updater_op_free (op);
+
+	ops = updater_pending_take_due (pending, SETTLE);
+	CU_ASSERT_EQUAL_FATAL (ops->len, 2);
+
+	/* the event wins, but the id found for it is kept */
+	op = g_ptr_array_index (ops, 0);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///a.ogg");
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_REMOVE);
+	CU_ASSERT_EQUAL (op->id, 7);
+
+	/* a new file has no id to learn */
+	op = g_ptr_array_index (ops, 1);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///b.ogg");
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_ADD);
+	CU_ASSERT_EQUAL (op->id, 0);
+
+	free_ops (ops);
+}
+
+CASE (test_take_due_sorted)
+{
+	GPtrArray *ops;
+	updater_op_t *op;
+	gint64 due;
+
+	updater_pending_event (pending, "file:///c.ogg", UPDATER_EVENT_CREATED, 0);
+	updater_pending_event (pending, "file:///a.ogg", UPDATER_EVENT_DELETED, 0);
+	updater_pending_event (pending, "file:///b.ogg", UPDATER_EVENT_CHANGED, 0);
+
+	ops = updater_pending_take_due (pending, SETTLE);
+	CU_ASSERT_EQUAL_FATAL (ops->len, 3);
+
+	op = g_ptr_array_index (ops, 0);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///a.ogg");
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_REMOVE);
+	op = g_ptr_array_index (ops, 1);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///b.ogg");
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_REHASH);
+	op = g_ptr_array_index (ops, 2);
+	CU_ASSERT_STRING_EQUAL (op->url, "file:///c.ogg");
+	CU_ASSERT_EQUAL (op->type, UPDATER_OP_ADD);
+
+	free_ops (ops);
+
+	due = updater_pending_next_due (pending);
+	CU_ASSERT_EQUAL (due, -1);
+}
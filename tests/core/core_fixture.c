@@ -0,0 +1,296 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "core_fixture.h"
+
+#include "xmmsc/xmmsc_util.h"
+#include "xmmspriv/xmms_config.h"
+#include "xmmspriv/xmms_ipc.h"
+#include "xmmspriv/xmms_plugin.h"
+#include "xmmspriv/xmms_stats.h"
+#include "xmmspriv/xmms_utils.h"
+#include "xmmspriv/xmms_xform.h"
+
+static gint users;
+static gchar *tmpdir;
+static gchar *old_config_home;
+static xmms_playlist_t *playlist;
+static xmms_xform_object_t *xform_obj;
+static gchar *conffile;
+
+/* Remove a directory and everything below it */
+static void
+remove_tree (const gchar *path)
+{
+	const gchar *name;
+	gchar *sub;
+	GDir *dir;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name (dir))) {
+			sub = g_build_filename (path, name, NULL);
+			if (g_file_test (sub, G_FILE_TEST_IS_DIR) &&
+			    !g_file_test (sub, G_FILE_TEST_IS_SYMLINK)) {
+				remove_tree (sub);
+			} else {
+				g_unlink (sub);
+			}
+			g_free (sub);
+		}
+		g_dir_close (dir);
+	}
+
+	g_rmdir (path);
+}
+
+/* A new medialib comes with the default song in the Default playlist,
+ * wait for the media info reader to be done with it so it doesn't
+ * change the playlist under the suites. */
+static void
+wait_for_default_song (void)
+{
+	xmms_medialib_session_t *session;
+	xmmsv_t *args, *entries;
+	gint i, id, status;
+
+	for (i = 0; i < 500; i++) {
+		args = xmmsv_new_list ();
+		xmmsv_list_append_string (args, "Default");
+		if (!core_fixture_call (playlist, XMMS_IPC_CMD_LIST, args, &entries)) {
+			return;
+		}
+		if (!xmmsv_list_get_int (entries, 0, &id)) {
+			xmmsv_unref (entries);
+			return;
+		}
+		xmmsv_unref (entries);
+
+		session = xmms_medialib_begin ();
+		status = xmms_medialib_entry_property_get_int (session, id,
+		                                               XMMS_MEDIALIB_ENTRY_PROPERTY_STATUS);
+		xmms_medialib_end (session);
+
+		if (status == XMMS_MEDIALIB_ENTRY_STATUS_OK) {
+			return;
+		}
+		g_usleep (10000);
+	}
+}
+
+gboolean
+core_fixture_init (void)
+{
+	gchar configdir[XMMS_PATH_MAX];
+	gchar *plugindir;
+
+	if (users++) {
+		return playlist != NULL;
+	}
+
+	if (!g_thread_supported ()) {
+		g_thread_init (NULL);
+	}
+
+	tmpdir = g_build_filename (g_get_tmp_dir (), "xmms2-core-XXXXXX", NULL);
+	if (!mkdtemp (tmpdir)) {
+		g_free (tmpdir);
+		tmpdir = NULL;
+		return FALSE;
+	}
+
+	/* the medialib and the collections go below the config dir */
+	old_config_home = g_strdup (g_getenv ("XDG_CONFIG_HOME"));
+	g_setenv ("XDG_CONFIG_HOME", tmpdir, TRUE);
+
+	if (!xmms_userconfdir_get (configdir, sizeof (configdir))) {
+		return FALSE;
+	}
+	g_mkdir_with_parents (configdir, 0755);
+
+	xmms_stats_init ();
+	xmms_ipc_init ();
+
+	conffile = XMMS_BUILD_PATH ("xmms2.conf");
+	xmms_config_init (conffile);
+
+	/* just the builtin plugins, and whatever the suites load */
+	plugindir = XMMS_BUILD_PATH ("plugins");
+	g_mkdir_with_parents (plugindir, 0755);
+	xmms_plugin_init (plugindir);
+	g_free (plugindir);
+
+	/* the media info reader the playlist starts sets up xforms */
+	xform_obj = xmms_xform_object_init ();
+	playlist = xmms_playlist_init ();
+	if (!playlist) {
+		return FALSE;
+	}
+
+	wait_for_default_song ();
+
+	return TRUE;
+}
+
+void
+core_fixture_fini (void)
+{
+	g_return_if_fail (users > 0);
+
+	if (--users) {
+		return;
+	}
+
+	if (playlist) {
+		xmms_object_unref (playlist);
+		playlist = NULL;
+	}
+	if (xform_obj) {
+		xmms_object_unref (xform_obj);
+		xform_obj = NULL;
+	}
+
+	/* init may have given up before bringing the server up */
+	if (conffile) {
+		xmms_config_shutdown ();
+		xmms_plugin_shutdown ();
+		xmms_ipc_shutdown ();
+		xmms_stats_shutdown ();
+
+		g_free (conffile);
+		conffile = NULL;
+	}
+
+	if (tmpdir) {
+		if (old_config_home) {
+			g_setenv ("XDG_CONFIG_HOME", old_config_home, TRUE);
+		} else {
+			g_unsetenv ("XDG_CONFIG_HOME");
+		}
+		g_free (old_config_home);
+		old_config_home = NULL;
+
+		remove_tree (tmpdir);
+		g_free (tmpdir);
+		tmpdir = NULL;
+	}
+}
+
+xmms_playlist_t *
+core_fixture_playlist (void)
+{
+	return playlist;
+}
+
+xmms_coll_dag_t *
+core_fixture_colldag (void)
+{
+	return xmms_playlist_colldag_get (playlist);
+}
+
+xmms_medialib_entry_t
+core_fixture_entry (const gchar *url)
+{
+	xmms_medialib_session_t *session;
+	xmms_medialib_entry_t entry;
+	xmms_error_t err;
+
+	xmms_error_reset (&err);
+
+	session = xmms_medialib_begin_write ();
+	entry = xmms_medialib_entry_new_encoded (session, url, &err);
+	/* keep the media info reader away from it */
+	xmms_medialib_entry_status_set (session, entry,
+	                                XMMS_MEDIALIB_ENTRY_STATUS_OK);
+	xmms_medialib_end (session);
+
+	return entry;
+}
+
+void
+core_fixture_entries (const gchar *dir, xmms_medialib_entry_t *entries,
+                      gint count)
+{
+	gchar *url;
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		url = g_strdup_printf ("file:///%s/%d.ogg", dir, i);
+		entries[i] = core_fixture_entry (url);
+		g_free (url);
+	}
+}
+
+gboolean
+core_fixture_call (gpointer object, guint cmdid, xmmsv_t *args,
+                   xmmsv_t **retval)
+{
+	xmms_object_cmd_arg_t arg;
+
+	xmms_object_cmd_arg_init (&arg);
+	arg.args = args;
+
+	xmms_object_cmd_call (XMMS_OBJECT (object), cmdid, &arg);
+
+	if (retval) {
+		*retval = arg.retval;
+	} else if (arg.retval) {
+		xmmsv_unref (arg.retval);
+	}
+	xmmsv_unref (args);
+
+	return !xmms_error_iserror (&arg.error);
+}
+
+gboolean
+core_fixture_coll_save (const gchar *name, const gchar *namespace,
+                        xmmsv_coll_t *coll)
+{
+	xmmsv_t *args;
+
+	args = xmmsv_new_list ();
+	xmmsv_list_append_string (args, name);
+	xmmsv_list_append_string (args, namespace);
+	xmmsv_list_append_coll (args, coll);
+	xmmsv_coll_unref (coll);
+
+	return core_fixture_call (core_fixture_colldag (),
+	                          XMMS_IPC_CMD_COLLECTION_SAVE, args, NULL);
+}
+
+gboolean
+core_fixture_playlist_call (guint cmdid, const gchar *plname, gint count, ...)
+{
+	xmmsv_t *args;
+	va_list ap;
+	gint i;
+
+	args = xmmsv_new_list ();
+	xmmsv_list_append_string (args, plname);
+
+	va_start (ap, count);
+	for (i = 0; i < count; i++) {
+		xmmsv_list_append_int (args, va_arg (ap, gint));
+	}
+	va_end (ap);
+
+	return core_fixture_call (playlist, cmdid, args, NULL);
+}
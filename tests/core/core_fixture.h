@@ -0,0 +1,73 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __CORE_FIXTURE_H__
+#define __CORE_FIXTURE_H__
+
+#include <glib.h>
+
+#include "xmmsc/xmmsc_idnumbers.h"
+#include "xmmsc/xmmsv.h"
+#include "xmmspriv/xmms_playlist.h"
+#include "xmmspriv/xmms_medialib.h"
+
+/**
+ * Bring up the parts of the server the core suites work on, config,
+ * plugins, medialib, collections and xforms, with everything kept in
+ * a temporary directory. The server is shared by everyone who called
+ * this and hasn't called core_fixture_fini yet, only the first call
+ * brings it up.
+ *
+ * @returns FALSE if the server couldn't be set up
+ */
+gboolean core_fixture_init (void);
+
+/**
+ * Drop what core_fixture_init got, also when it failed. The last one
+ * shuts the server down and removes the temporary directory, the next
+ * init starts over.
+ */
+void core_fixture_fini (void);
+
+xmms_playlist_t *core_fixture_playlist (void);
+xmms_coll_dag_t *core_fixture_colldag (void);
+
+/** Add a resolved medialib entry for the encoded url, returns its id */
+xmms_medialib_entry_t core_fixture_entry (const gchar *url);
+
+/** Add count entries named file:///dir/<n>.ogg */
+void core_fixture_entries (const gchar *dir, xmms_medialib_entry_t *entries,
+                           gint count);
+
+/**
+ * Run a command on a server object like the ipc does. The arguments
+ * are taken over, the return value is handed back in retval if it
+ * isn't NULL.
+ *
+ * @returns FALSE if the command failed
+ */
+gboolean core_fixture_call (gpointer object, guint cmdid, xmmsv_t *args,
+                            xmmsv_t **retval);
+
+/** Save a collection with the collection command, takes it over */
+gboolean core_fixture_coll_save (const gchar *name, const gchar *namespace,
+                                 xmmsv_coll_t *coll);
+
+/** Run a playlist command on plname with count int arguments */
+gboolean core_fixture_playlist_call (guint cmdid, const gchar *plname,
+                                     gint count, ...);
+
+#endif
@@ -0,0 +1,216 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "core_fixture.h"
+
+#include "xmmsc/xmmsc_idnumbers.h"
+#include "xmmsc/xmmsv.h"
+#include "xmmspriv/xmms_collection.h"
+#include "xmmspriv/xmms_collindex.h"
+
+static xmms_coll_dag_t *dag;
+static xmms_medialib_entry_t mids[3];
+
+/* Whether collection.find says the media is in the collection */
+static gboolean
+found (xmms_medialib_entry_t mid, const gchar *namespace, const gchar *name)
+{
+	xmmsv_t *args, *names;
+	const gchar *s;
+	gboolean ret = FALSE;
+	gint i;
+
+	args = xmmsv_new_list ();
+	xmmsv_list_append_int (args, mid);
+	xmmsv_list_append_string (args, namespace);
+
+	if (!core_fixture_call (dag, XMMS_IPC_CMD_COLLECTION_FIND, args, &names)) {
+		return FALSE;
+	}
+
+	for (i = 0; !ret && xmmsv_list_get_string (names, i, &s); i++) {
+		ret = !strcmp (s, name);
+	}
+	xmmsv_unref (names);
+
+	return ret;
+}
+
+static gboolean
+in_playlist (xmms_medialib_entry_t mid)
+{
+	return found (mid, XMMS_COLLECTION_NS_PLAYLISTS, "Findable");
+}
+
+static gboolean
+is_rock (xmms_medialib_entry_t mid)
+{
+	return found (mid, XMMS_COLLECTION_NS_COLLECTIONS, "Rock music");
+}
+
+static void
+set_property (xmms_medialib_entry_t mid, const gchar *key, const gchar *value)
+{
+	xmms_medialib_session_t *session;
+
+	session = xmms_medialib_begin_write ();
+	xmms_medialib_entry_property_set_str (session, mid, key, value);
+	xmms_medialib_end (session);
+}
+
+SETUP (coll_find) {
+	xmmsv_coll_t *coll, *all;
+
+	if (!core_fixture_init ()) {
+		core_fixture_fini ();
+		return 1;
+	}
+
+	dag = core_fixture_colldag ();
+	core_fixture_entries ("coll_find", mids, G_N_ELEMENTS (mids));
+
+	all = xmmsv_coll_universe ();
+	coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_EQUALS);
+	xmmsv_coll_attribute_set (coll, "field", "genre");
+	xmmsv_coll_attribute_set (coll, "value", "Rock");
+	xmmsv_coll_add_operand (coll, all);
+	xmmsv_coll_unref (all);
+
+	if (!core_fixture_coll_save ("Rock music",
+	                             XMMS_COLLECTION_NS_COLLECTIONS, coll) ||
+	    !core_fixture_coll_save ("Findable", XMMS_COLLECTION_NS_PLAYLISTS,
+	                             xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST))) {
+		core_fixture_fini ();
+		return 1;
+	}
+
+	return 0;
+}
+
+CLEANUP () {
+	core_fixture_fini ();
+	return 0;
+}
+
+CASE (test_find_follows_playlist)
+{
+	xmms_playlist_t *playlist;
+	xmms_error_t err;
+
+	playlist = core_fixture_playlist ();
+	xmms_error_reset (&err);
+
+	/* looking at it the first time indexes the idlist, the changes
+	 * after that have to keep the index up to date */
+	CU_ASSERT_FALSE (in_playlist (mids[0]));
+
+	xmms_playlist_add_entry (playlist, "Findable", mids[0], &err);
+	CU_ASSERT_TRUE (in_playlist (mids[0]));
+	CU_ASSERT_FALSE (in_playlist (mids[1]));
+
+	xmms_playlist_insert_entry (playlist, "Findable", 0, mids[1], &err);
+	CU_ASSERT_TRUE (in_playlist (mids[0]));
+	CU_ASSERT_TRUE (in_playlist (mids[1]));
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+
+	/* [1, 0] -> [0] */
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_REMOVE_ENTRY,
+	                                            "Findable", 1, 0));
+	CU_ASSERT_TRUE (in_playlist (mids[0]));
+	CU_ASSERT_FALSE (in_playlist (mids[1]));
+
+	/* in there twice, it's still there after removing one of them */
+	xmms_playlist_add_entry (playlist, "Findable", mids[2], &err);
+	xmms_playlist_add_entry (playlist, "Findable", mids[0], &err);
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_REMOVE_ENTRY,
+	                                            "Findable", 1, 0));
+	CU_ASSERT_TRUE (in_playlist (mids[0]));
+	CU_ASSERT_TRUE (in_playlist (mids[2]));
+
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_CLEAR,
+	                                            "Findable", 0));
+	CU_ASSERT_FALSE (in_playlist (mids[0]));
+	CU_ASSERT_FALSE (in_playlist (mids[2]));
+
+	xmms_playlist_add_entry (playlist, "Findable", mids[2], &err);
+	CU_ASSERT_TRUE (in_playlist (mids[2]));
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_CLEAR,
+	                                            "Findable", 0));
+}
+
+CASE (test_filter_match_invalidated)
+{
+	xmmsv_coll_t *rock;
+
+	rock = xmms_collection_get_pointer (dag, "Rock music",
+	                                    XMMS_COLLECTION_NSID_COLLECTIONS);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (rock);
+
+	set_property (mids[0], "genre", "Rock");
+	set_property (mids[1], "genre", "Jazz");
+
+	CU_ASSERT_TRUE (is_rock (mids[0]));
+	CU_ASSERT_FALSE (is_rock (mids[1]));
+	CU_ASSERT_EQUAL (xmms_coll_index_filter_lookup (rock, mids[0]), 1);
+	CU_ASSERT_EQUAL (xmms_coll_index_filter_lookup (rock, mids[1]), 0);
+
+	/* writing a property the filter doesn't look at keeps what it
+	 * remembered */
+	set_property (mids[0], "artist", "Someone");
+	CU_ASSERT_EQUAL (xmms_coll_index_filter_lookup (rock, mids[0]), 1);
+	CU_ASSERT_EQUAL (xmms_coll_index_filter_lookup (rock, mids[1]), 0);
+	CU_ASSERT_TRUE (is_rock (mids[0]));
+
+	/* the one it does look at drops it */
+	set_property (mids[0], "genre", "Jazz");
+	CU_ASSERT_EQUAL (xmms_coll_index_filter_lookup (rock, mids[0]), -1);
+	CU_ASSERT_EQUAL (xmms_coll_index_filter_lookup (rock, mids[1]), -1);
+	CU_ASSERT_FALSE (is_rock (mids[0]));
+
+	/* for every media, not just the one that was written */
+	set_property (mids[0], "genre", "Rock");
+	CU_ASSERT_TRUE (is_rock (mids[0]));
+	set_property (mids[1], "genre", "Rock");
+	CU_ASSERT_TRUE (is_rock (mids[1]));
+	CU_ASSERT_EQUAL (xmms_coll_index_filter_lookup (rock, mids[0]), -1);
+}
+
+CASE (test_property_stamps)
+{
+	guint32 genre, artist, any;
+
+	genre = xmms_medialib_property_stamp ("genre");
+	artist = xmms_medialib_property_stamp ("artist");
+	any = xmms_medialib_property_stamp (NULL);
+
+	set_property (mids[2], "genre", "Pop");
+	CU_ASSERT_TRUE (xmms_medialib_property_stamp ("genre") > genre);
+	CU_ASSERT_EQUAL (xmms_medialib_property_stamp ("artist"), artist);
+	CU_ASSERT_TRUE (xmms_medialib_property_stamp (NULL) > any);
+
+	/* a change that may have hit anything moves them all */
+	genre = xmms_medialib_property_stamp ("genre");
+	xmms_medialib_property_changed (NULL);
+	CU_ASSERT_TRUE (xmms_medialib_property_stamp ("artist") > artist);
+	CU_ASSERT_TRUE (xmms_medialib_property_stamp ("genre") > genre);
+}
@@ -0,0 +1,597 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <glib.h>
+
+#include "core_fixture.h"
+
+#include "xmmsc/xmmsc_idnumbers.h"
+#include "xmmsc/xmmsv.h"
+#include "xmmspriv/xmms_collection.h"
+#include "xmmspriv/xmms_collserial.h"
+#include "xmmspriv/xmms_config.h"
+
+/* The collections are compared as text, one line per label with the
+ * collection it points to written out in full. The operands are
+ * sorted as the DB doesn't keep their order, and those of references
+ * are left out as they aren't saved. */
+
+static xmms_coll_dag_t *dag;
+static xmms_medialib_entry_t mids[8];
+
+static gint
+compare_strings (gconstpointer a, gconstpointer b)
+{
+	return strcmp (a, b);
+}
+
+/* Join a list of strings into str and free it */
+static void
+append_sorted (GString *str, GList *parts, const gchar *sep)
+{
+	GList *n;
+
+	parts = g_list_sort (parts, compare_strings);
+	for (n = parts; n; n = n->next) {
+		g_string_append (str, n->data);
+		if (n->next) {
+			g_string_append (str, sep);
+		}
+		g_free (n->data);
+	}
+	g_list_free (parts);
+}
+
+static void
+dump_dag_attribute (const char *key, xmmsv_t *value, void *udata)
+{
+	GList **parts = udata;
+	const gchar *s;
+
+	xmmsv_get_string (value, &s);
+	*parts = g_list_prepend (*parts, g_strdup_printf ("%s=%s", key, s));
+}
+
+static gchar *
+dump_dag_coll (xmmsv_coll_t *coll)
+{
+	GString *str;
+	GList *parts = NULL;
+	xmmsv_t *list, *tmp;
+	xmmsv_coll_t *op;
+	gint i;
+	int32_t mid;
+
+	str = g_string_new (NULL);
+	g_string_append_printf (str, "%d{", xmmsv_coll_get_type (coll));
+
+	xmmsv_dict_foreach (xmmsv_coll_attributes_get (coll),
+	                    dump_dag_attribute, &parts);
+	append_sorted (str, parts, ",");
+
+	g_string_append (str, "}[");
+	list = xmmsv_coll_idlist_get (coll);
+	for (i = 0; xmmsv_list_get_int (list, i, &mid); i++) {
+		g_string_append_printf (str, "%s%d:%d", i ? "," : "", i, mid);
+	}
+
+	g_string_append (str, "](");
+	parts = NULL;
+	list = xmmsv_coll_operands_get (coll);
+	if (xmmsv_coll_get_type (coll) != XMMS_COLLECTION_TYPE_REFERENCE) {
+		for (i = 0; xmmsv_list_get (list, i, &tmp); i++) {
+			xmmsv_get_coll (tmp, &op);
+			parts = g_list_prepend (parts, dump_dag_coll (op));
+		}
+	}
+	append_sorted (str, parts, ",");
+	g_string_append (str, ")");
+
+	return g_string_free (str, FALSE);
+}
+
+typedef struct {
+	guint nsid;
+	GList *parts;
+} dump_labels_t;
+
+static void
+dump_dag_label (gpointer key, gpointer value, gpointer udata)
+{
+	dump_labels_t *dump = udata;
+	gchar *coll;
+
+	coll = dump_dag_coll (value);
+	dump->parts = g_list_prepend (dump->parts,
+	                              g_strdup_printf ("%d/%s=%s", dump->nsid,
+	                                               (gchar *) key, coll));
+	g_free (coll);
+}
+
+/* The DAG as it is in memory */
+static gchar *
+dump_dag (void)
+{
+	dump_labels_t dump = { 0, NULL };
+	GString *str;
+
+	for (dump.nsid = 0; dump.nsid < XMMS_COLLECTION_NUM_NAMESPACES; dump.nsid++) {
+		xmms_collection_foreach_in_namespace (dag, dump.nsid,
+		                                      dump_dag_label, &dump);
+	}
+
+	str = g_string_new (NULL);
+	append_sorted (str, dump.parts, "\n");
+
+	return g_string_free (str, FALSE);
+}
+
+static GList *
+select_rows (xmms_medialib_session_t *session, const gchar *fmt, ...)
+{
+	GList *res;
+	gchar *query;
+	va_list ap;
+
+	va_start (ap, fmt);
+	query = g_strdup_vprintf (fmt, ap);
+	va_end (ap);
+
+	res = xmms_medialib_select (session, query, NULL);
+	g_free (query);
+
+	return res;
+}
+
+static gint
+row_int (GList *row, const gchar *key)
+{
+	int32_t i = -1;
+	xmmsv_dict_entry_get_int (row->data, key, &i);
+	return i;
+}
+
+static const gchar *
+row_string (GList *row, const gchar *key)
+{
+	const gchar *s = "";
+	xmmsv_dict_entry_get_string (row->data, key, &s);
+	return s;
+}
+
+static void
+rows_free (GList *res)
+{
+	g_list_foreach (res, (GFunc) xmmsv_unref, NULL);
+	g_list_free (res);
+}
+
+static gchar *
+dump_db_coll (xmms_medialib_session_t *session, gint id)
+{
+	GString *str;
+	GList *parts = NULL;
+	GList *res, *n;
+	gint i;
+
+	str = g_string_new (NULL);
+
+	res = select_rows (session, "SELECT type FROM CollectionOperators "
+	                            "WHERE id=%d", id);
+	g_string_append_printf (str, "%d{", res ? row_int (res, "type") : -1);
+	rows_free (res);
+
+	res = select_rows (session, "SELECT key, value FROM CollectionAttributes "
+	                            "WHERE collid=%d", id);
+	for (n = res; n; n = n->next) {
+		parts = g_list_prepend (parts,
+		                        g_strdup_printf ("%s=%s", row_string (n, "key"),
+		                                         row_string (n, "value")));
+	}
+	rows_free (res);
+	append_sorted (str, parts, ",");
+
+	g_string_append (str, "}[");
+	res = select_rows (session, "SELECT position, mid FROM CollectionIdlists "
+	                            "WHERE collid=%d ORDER BY position", id);
+	for (n = res, i = 0; n; n = n->next, i++) {
+		g_string_append_printf (str, "%s%d:%d", i ? "," : "",
+		                        row_int (n, "position"), row_int (n, "mid"));
+	}
+	rows_free (res);
+
+	g_string_append (str, "](");
+	parts = NULL;
+	res = select_rows (session, "SELECT from_id FROM CollectionConnections "
+	                            "WHERE to_id=%d", id);
+	for (n = res; n; n = n->next) {
+		parts = g_list_prepend (parts,
+		                        dump_db_coll (session, row_int (n, "from_id")));
+	}
+	rows_free (res);
+	append_sorted (str, parts, ",");
+	g_string_append (str, ")");
+
+	return g_string_free (str, FALSE);
+}
+
+/* The DAG as it was saved, followed by the number of rows in every
+ * table, which catches what was left behind by an earlier save */
+static gchar *
+dump_db (void)
+{
+	static const gchar *tables[] = {
+		"CollectionOperators", "CollectionLabels", "CollectionAttributes",
+		"CollectionConnections", "CollectionIdlists"
+	};
+	xmms_medialib_session_t *session;
+	GString *str;
+	GList *parts = NULL;
+	GList *res, *n;
+	gchar *coll;
+	gint i;
+
+	session = xmms_medialib_begin ();
+
+	res = select_rows (session, "SELECT collid, namespace, name "
+	                            "FROM CollectionLabels");
+	for (n = res; n; n = n->next) {
+		coll = dump_db_coll (session, row_int (n, "collid"));
+		parts = g_list_prepend (parts,
+		                        g_strdup_printf ("%d/%s=%s",
+		                                         row_int (n, "namespace"),
+		                                         row_string (n, "name"), coll));
+		g_free (coll);
+	}
+	rows_free (res);
+
+	str = g_string_new (NULL);
+	append_sorted (str, parts, "\n");
+
+	for (i = 0; i < G_N_ELEMENTS (tables); i++) {
+		res = select_rows (session, "SELECT COUNT(*) AS n FROM %s", tables[i]);
+		g_string_append_printf (str, "\n%s %d", tables[i], row_int (res, "n"));
+		rows_free (res);
+	}
+
+	xmms_medialib_end (session);
+
+	return g_string_free (str, FALSE);
+}
+
+/* The DB without the row counts, to hold against dump_dag */
+static gchar *
+dump_db_labels (void)
+{
+	gchar *dump, *counts;
+
+	dump = dump_db ();
+	counts = strstr (dump, "\nCollectionOperators ");
+	if (counts) {
+		*counts = '\0';
+	}
+
+	return dump;
+}
+
+static void
+check_saved (void)
+{
+	gchar *db, *mem;
+
+	xmms_collection_sync (dag);
+
+	db = dump_db_labels ();
+	mem = dump_dag ();
+	CU_ASSERT_STRING_EQUAL (db, mem);
+	g_free (mem);
+	g_free (db);
+}
+
+static void
+set_full_save (const gchar *value)
+{
+	xmms_config_property_t *prop;
+
+	prop = xmms_config_lookup ("collection.full_save");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (prop);
+	xmms_config_property_set_data (prop, value);
+}
+
+/* Save what changed, then everything, both must give the same DB */
+static void
+check_same_as_full_save (void)
+{
+	gchar *incremental, *full;
+
+	check_saved ();
+	incremental = dump_db ();
+
+	set_full_save ("1");
+	xmms_collection_sync (dag);
+	set_full_save ("0");
+
+	full = dump_db ();
+	CU_ASSERT_STRING_EQUAL (incremental, full);
+
+	g_free (full);
+	g_free (incremental);
+}
+
+static xmmsv_coll_t *
+find_operand (xmmsv_coll_t *coll, xmmsv_coll_type_t type)
+{
+	xmmsv_coll_t *op;
+	xmmsv_t *tmp;
+	gint i;
+
+	for (i = 0; xmmsv_list_get (xmmsv_coll_operands_get (coll), i, &tmp); i++) {
+		xmmsv_get_coll (tmp, &op);
+		if (xmmsv_coll_get_type (op) == type) {
+			return op;
+		}
+	}
+
+	return NULL;
+}
+
+static xmmsv_coll_t *
+new_filter (xmmsv_coll_type_t type, const gchar *field, const gchar *value)
+{
+	xmmsv_coll_t *coll, *all;
+
+	all = xmmsv_coll_universe ();
+	coll = xmmsv_coll_new (type);
+	xmmsv_coll_attribute_set (coll, "field", field);
+	xmmsv_coll_attribute_set (coll, "value", value);
+	xmmsv_coll_add_operand (coll, all);
+	xmmsv_coll_unref (all);
+
+	return coll;
+}
+
+static xmmsv_coll_t *
+new_reference (const gchar *name, const gchar *namespace)
+{
+	xmmsv_coll_t *coll;
+
+	coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_REFERENCE);
+	xmmsv_coll_attribute_set (coll, "reference", name);
+	xmmsv_coll_attribute_set (coll, "namespace", namespace);
+
+	return coll;
+}
+
+static xmmsv_coll_t *
+new_idlist (gint count)
+{
+	xmmsv_coll_t *coll;
+	gint i;
+
+	coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+	for (i = 0; i < count; i++) {
+		xmmsv_coll_idlist_append (coll, mids[i]);
+	}
+
+	return coll;
+}
+
+SETUP (coll_save) {
+	xmmsv_coll_t *coll, *op;
+
+	if (!core_fixture_init ()) {
+		core_fixture_fini ();
+		return 1;
+	}
+
+	dag = core_fixture_colldag ();
+	core_fixture_entries ("coll_save", mids, G_N_ELEMENTS (mids));
+
+	/* a couple of playlists, and collections referring to them and
+	 * to each other */
+	if (!core_fixture_coll_save ("Saved", XMMS_COLLECTION_NS_PLAYLISTS,
+	                             new_idlist (4)) ||
+	    !core_fixture_coll_save ("Other", XMMS_COLLECTION_NS_PLAYLISTS,
+	                             new_idlist (2)) ||
+	    !core_fixture_coll_save ("Rock", XMMS_COLLECTION_NS_COLLECTIONS,
+	                             new_filter (XMMS_COLLECTION_TYPE_EQUALS,
+	                                         "genre", "Rock"))) {
+		core_fixture_fini ();
+		return 1;
+	}
+
+	coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_UNION);
+	op = new_reference ("Rock", XMMS_COLLECTION_NS_COLLECTIONS);
+	xmmsv_coll_add_operand (coll, op);
+	xmmsv_coll_unref (op);
+	op = new_reference ("Saved", XMMS_COLLECTION_NS_PLAYLISTS);
+	xmmsv_coll_add_operand (coll, op);
+	xmmsv_coll_unref (op);
+	op = new_filter (XMMS_COLLECTION_TYPE_MATCH, "artist", "The *");
+	xmmsv_coll_add_operand (coll, op);
+	xmmsv_coll_unref (op);
+	if (!core_fixture_coll_save ("Mix", XMMS_COLLECTION_NS_COLLECTIONS,
+	                             coll)) {
+		core_fixture_fini ();
+		return 1;
+	}
+
+	/* start from what's in the DB, as the server does */
+	xmms_collection_sync (dag);
+	xmms_collection_dag_restore (dag);
+
+	return 0;
+}
+
+CLEANUP () {
+	core_fixture_fini ();
+	return 0;
+}
+
+CASE (test_restore_unchanged)
+{
+	gchar *before, *after;
+
+	check_saved ();
+
+	before = dump_dag ();
+	xmms_collection_dag_restore (dag);
+	after = dump_dag ();
+	CU_ASSERT_STRING_EQUAL (before, after);
+
+	/* nothing changed, nothing is written */
+	check_same_as_full_save ();
+
+	g_free (after);
+	g_free (before);
+}
+
+CASE (test_idlist_changes)
+{
+	xmms_playlist_t *playlist;
+	xmms_error_t err;
+	gint i;
+
+	playlist = core_fixture_playlist ();
+	xmms_error_reset (&err);
+
+	/* append */
+	for (i = 4; i < G_N_ELEMENTS (mids); i++) {
+		xmms_playlist_add_entry (playlist, "Saved", mids[i], &err);
+	}
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	check_saved ();
+
+	/* truncate */
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_REMOVE_ENTRY, "Saved",
+	                                            1, 7));
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_REMOVE_ENTRY, "Saved",
+	                                            1, 6));
+	check_saved ();
+
+	/* reorder */
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_MOVE_ENTRY, "Saved",
+	                                            2, 5, 0));
+	check_saved ();
+
+	/* insert in the middle, and remove from the front */
+	xmms_playlist_insert_entry (playlist, "Other", 1, mids[7], &err);
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_REMOVE_ENTRY, "Other",
+	                                            1, 0));
+	check_saved ();
+
+	/* empty it, and fill it again */
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_CLEAR, "Other",
+	                                            0));
+	check_saved ();
+	xmms_playlist_add_entry (playlist, "Other", mids[3], &err);
+	check_saved ();
+
+	check_same_as_full_save ();
+
+	/* again, on top of what was restored */
+	xmms_collection_dag_restore (dag);
+	xmms_playlist_add_entry (playlist, "Saved", mids[0], &err);
+	CU_ASSERT_TRUE (core_fixture_playlist_call (XMMS_IPC_CMD_MOVE_ENTRY, "Saved",
+	                                            2, 0, 3));
+	check_same_as_full_save ();
+}
+
+CASE (test_operand_changes)
+{
+	xmmsv_coll_t *mix, *op;
+
+	mix = xmms_collection_get_pointer (dag, "Mix",
+	                                   XMMS_COLLECTION_NSID_COLLECTIONS);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (mix);
+
+	/* add one */
+	op = new_filter (XMMS_COLLECTION_TYPE_HAS, "album", "");
+	xmmsv_coll_add_operand (mix, op);
+	xmmsv_coll_unref (op);
+	check_saved ();
+
+	/* change one in place */
+	op = find_operand (mix, XMMS_COLLECTION_TYPE_MATCH);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (op);
+	xmmsv_coll_attribute_set (op, "value", "A *");
+	check_saved ();
+
+	/* remove one */
+	xmmsv_coll_remove_operand (mix, op);
+	check_saved ();
+
+	/* an attribute of the operator itself */
+	xmmsv_coll_attribute_set (mix, "comment", "mixed");
+	check_saved ();
+
+	check_same_as_full_save ();
+
+	/* again, on top of what was restored */
+	xmms_collection_dag_restore (dag);
+	mix = xmms_collection_get_pointer (dag, "Mix",
+	                                   XMMS_COLLECTION_NSID_COLLECTIONS);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (mix);
+	op = new_filter (XMMS_COLLECTION_TYPE_SMALLER, "tracknr", "4");
+	xmmsv_coll_add_operand (mix, op);
+	xmmsv_coll_unref (op);
+	xmmsv_coll_attribute_remove (mix, "comment");
+	check_same_as_full_save ();
+}
+
+CASE (test_label_changes)
+{
+	xmmsv_coll_t *coll;
+	xmmsv_t *args;
+
+	/* replace a collection, the references follow it */
+	coll = new_filter (XMMS_COLLECTION_TYPE_EQUALS, "genre", "Metal");
+	CU_ASSERT_TRUE (core_fixture_coll_save ("Rock",
+	                                        XMMS_COLLECTION_NS_COLLECTIONS,
+	                                        coll));
+	check_saved ();
+
+	/* rename */
+	args = xmmsv_new_list ();
+	xmmsv_list_append_string (args, "Other");
+	xmmsv_list_append_string (args, "Renamed");
+	xmmsv_list_append_string (args, XMMS_COLLECTION_NS_PLAYLISTS);
+	CU_ASSERT_TRUE (core_fixture_call (dag, XMMS_IPC_CMD_COLLECTION_RENAME,
+	                                   args, NULL));
+	check_saved ();
+
+	/* remove */
+	args = xmmsv_new_list ();
+	xmmsv_list_append_string (args, "Renamed");
+	xmmsv_list_append_string (args, XMMS_COLLECTION_NS_PLAYLISTS);
+	CU_ASSERT_TRUE (core_fixture_call (dag, XMMS_IPC_CMD_COLLECTION_REMOVE,
+	                                   args, NULL));
+	check_saved ();
+
+	check_same_as_full_save ();
+
+	/* again, on top of what was restored */
+	xmms_collection_dag_restore (dag);
+	CU_ASSERT_TRUE (core_fixture_coll_save ("Other",
+	                                        XMMS_COLLECTION_NS_PLAYLISTS,
+	                                        new_idlist (3)));
+	check_same_as_full_save ();
+}
@@ -0,0 +1,280 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "core_fixture.h"
+
+#include "xmms/xmms_sample.h"
+#include "xmmspriv/xmms_plugin.h"
+#include "xmmspriv/xmms_xform.h"
+
+/* The test decoder plays ten seconds where every sample is its own
+ * position, one 32 bit word per S16 stereo sample. */
+#define RATE 44100
+#define SAMPLES (RATE * 10)
+
+static gint opens;
+static gint seeks;
+static GList *goal_formats;
+
+static gboolean
+test_init (xmms_xform_t *xform)
+{
+	xmms_xform_private_data_set (xform, g_new0 (gint64, 1));
+
+	xmms_xform_outdata_type_add (xform,
+	                             XMMS_STREAM_TYPE_MIMETYPE,
+	                             "audio/pcm",
+	                             XMMS_STREAM_TYPE_FMT_FORMAT,
+	                             XMMS_SAMPLE_FORMAT_S16,
+	                             XMMS_STREAM_TYPE_FMT_CHANNELS,
+	                             2,
+	                             XMMS_STREAM_TYPE_FMT_SAMPLERATE,
+	                             RATE,
+	                             XMMS_STREAM_TYPE_END);
+	opens++;
+
+	return TRUE;
+}
+
+static void
+test_destroy (xmms_xform_t *xform)
+{
+	g_free (xmms_xform_private_data_get (xform));
+}
+
+static gint
+test_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
+           xmms_error_t *err)
+{
+	gint64 *pos = xmms_xform_private_data_get (xform);
+	guint32 *out = (guint32 *) buf;
+	gint i, n;
+
+	n = MIN (len / sizeof (guint32), SAMPLES - *pos);
+	for (i = 0; i < n; i++) {
+		out[i] = (*pos)++;
+	}
+
+	return n * sizeof (guint32);
+}
+
+static gint64
+test_seek (xmms_xform_t *xform, gint64 samples,
+           xmms_xform_seek_mode_t whence, xmms_error_t *err)
+{
+	gint64 *pos = xmms_xform_private_data_get (xform);
+
+	g_return_val_if_fail (whence == XMMS_XFORM_SEEK_SET, -1);
+
+	seeks++;
+	*pos = samples;
+
+	return *pos;
+}
+
+static gboolean
+test_plugin_setup (xmms_xform_plugin_t *xform_plugin)
+{
+	xmms_xform_methods_t methods;
+
+	XMMS_XFORM_METHODS_INIT (methods);
+	methods.init = test_init;
+	methods.destroy = test_destroy;
+	methods.read = test_read;
+	methods.seek = test_seek;
+
+	xmms_xform_plugin_methods_set (xform_plugin, &methods);
+
+	xmms_xform_plugin_indata_add (xform_plugin,
+	                              XMMS_STREAM_TYPE_MIMETYPE,
+	                              "application/x-url",
+	                              XMMS_STREAM_TYPE_URL,
+	                              "test://*",
+	                              XMMS_STREAM_TYPE_END);
+
+	return TRUE;
+}
+
+XMMS_XFORM_BUILTIN (parktest,
+                    "Park test decoder",
+                    XMMS_VERSION,
+                    "Counts its opens and seeks",
+                    test_plugin_setup);
+
+static xmms_xform_t *
+chain_open (const gchar *url)
+{
+	return xmms_xform_chain_setup (core_fixture_entry (url),
+	                               goal_formats, FALSE);
+}
+
+/* Read the chain to its end, returns the number of samples and
+ * the first one */
+static gint64
+chain_drain (xmms_xform_t *xform, guint32 *first)
+{
+	xmms_error_t err;
+	guint32 buf[1024];
+	gint64 total = 0;
+	gint res;
+
+	xmms_error_reset (&err);
+
+	while ((res = xmms_xform_this_read (xform, buf, sizeof (buf), &err)) > 0) {
+		if (!total) {
+			*first = buf[0];
+		}
+		total += res / sizeof (guint32);
+	}
+
+	return total;
+}
+
+SETUP (xform_park) {
+	xmms_stream_type_t *goal;
+
+	if (!core_fixture_init ()) {
+		core_fixture_fini ();
+		return 1;
+	}
+
+	if (!xmms_plugin_find (XMMS_PLUGIN_TYPE_XFORM, "parktest") &&
+	    !xmms_plugin_load (&xmms_builtin_parktest, NULL)) {
+		core_fixture_fini ();
+		return 1;
+	}
+
+	goal = _xmms_stream_type_new (XMMS_STREAM_TYPE_BEGIN,
+	                              XMMS_STREAM_TYPE_MIMETYPE,
+	                              "audio/pcm",
+	                              XMMS_STREAM_TYPE_FMT_FORMAT,
+	                              XMMS_SAMPLE_FORMAT_S16,
+	                              XMMS_STREAM_TYPE_FMT_CHANNELS,
+	                              2,
+	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE,
+	                              RATE,
+	                              XMMS_STREAM_TYPE_END);
+	goal_formats = g_list_prepend (NULL, goal);
+
+	return 0;
+}
+
+CLEANUP () {
+	xmms_object_unref (goal_formats->data);
+	g_list_free (goal_formats);
+	goal_formats = NULL;
+	core_fixture_fini ();
+	return 0;
+}
+
+CASE (test_resume_next_track)
+{
+	xmms_medialib_entry_t entry;
+	xmms_xform_t *xform;
+	const gchar *startframe;
+	guint32 first = 0;
+	gint32 duration;
+	gint o, s;
+
+	xform = chain_open ("test://resume?startframe=75&stopframe=150");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+
+	CU_ASSERT_EQUAL (chain_drain (xform, &first), RATE);
+	CU_ASSERT_EQUAL (first, RATE);
+
+	/* played to its stop, the decoder is kept for the next track */
+	xmms_object_unref (xform);
+
+	o = opens;
+	s = seeks;
+
+	entry = core_fixture_entry ("test://resume?startframe=150&stopframe=300");
+	xform = xmms_xform_chain_setup (entry, goal_formats, FALSE);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+
+	CU_ASSERT_EQUAL (opens, o);
+	CU_ASSERT_EQUAL (seeks, s);
+
+	/* the arguments of the new track replace the old ones */
+	CU_ASSERT_TRUE (xmms_xform_metadata_get_str (xform, "startframe",
+	                                             &startframe));
+	CU_ASSERT_STRING_EQUAL (startframe, "150");
+	CU_ASSERT_EQUAL (xmms_xform_entry_get (xform), entry);
+	CU_ASSERT_TRUE (xmms_xform_metadata_get_int (xform, "duration",
+	                                             &duration));
+	CU_ASSERT_EQUAL (duration, 2000);
+
+	CU_ASSERT_EQUAL (chain_drain (xform, &first), 2 * RATE);
+	CU_ASSERT_EQUAL (first, 2 * RATE);
+
+	xmms_object_unref (xform);
+}
+
+CASE (test_reopen_other_start)
+{
+	xmms_xform_t *xform;
+	guint32 first = 0;
+	gint o;
+
+	xform = chain_open ("test://gap?startframe=0&stopframe=75");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+	CU_ASSERT_EQUAL (chain_drain (xform, &first), RATE);
+	xmms_object_unref (xform);
+
+	o = opens;
+
+	/* skips a track, the parked decoder is at the wrong place */
+	xform = chain_open ("test://gap?startframe=150&stopframe=225");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+	CU_ASSERT_EQUAL (opens, o + 1);
+
+	CU_ASSERT_EQUAL (chain_drain (xform, &first), RATE);
+	CU_ASSERT_EQUAL (first, 2 * RATE);
+
+	xmms_object_unref (xform);
+}
+
+CASE (test_abandoned_not_parked)
+{
+	xmms_error_t err;
+	xmms_xform_t *xform;
+	guint32 buf[1024];
+	guint32 first = 0;
+	gint o;
+
+	xmms_error_reset (&err);
+
+	xform = chain_open ("test://abandon?startframe=0&stopframe=75");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+	CU_ASSERT_TRUE (xmms_xform_this_read (xform, buf, sizeof (buf), &err) > 0);
+	xmms_object_unref (xform);
+
+	o = opens;
+
+	xform = chain_open ("test://abandon?startframe=75&stopframe=150");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+	CU_ASSERT_EQUAL (opens, o + 1);
+
+	CU_ASSERT_EQUAL (chain_drain (xform, &first), RATE);
+	CU_ASSERT_EQUAL (first, RATE);
+
+	xmms_object_unref (xform);
+}
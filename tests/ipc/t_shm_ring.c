@@ -0,0 +1,318 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/select.h>
+
+#include "xmmsc/xmmsv.h"
+#include "xmmsc/xmmsc_ipc_msg.h"
+#include "xmmsc/xmmsc_ipc_transport.h"
+
+/* XMMS_IPC_SHM_RING_SIZE in socket_shm.c */
+#define RING_SIZE (1024 * 1024)
+
+static xmms_ipc_transport_t *server;
+static char url[64];
+
+static void *
+connect_thread (void *data)
+{
+	return xmms_ipc_client_init (url);
+}
+
+/* The client waits for the server to hand it the rings, so connect
+ * from a thread while accepting here */
+static bool
+connect_pair (xmms_ipc_transport_t **client, xmms_ipc_transport_t **peer)
+{
+	pthread_t thread;
+	void *ret;
+	int i;
+
+	if (pthread_create (&thread, NULL, connect_thread, NULL)) {
+		return false;
+	}
+
+	*peer = NULL;
+	for (i = 0; i < 500 && !*peer; i++) {
+		*peer = xmms_ipc_server_accept (server);
+		if (!*peer) {
+			usleep (10000);
+		}
+	}
+
+	pthread_join (thread, &ret);
+	*client = ret;
+
+	if (!*client || !*peer) {
+		if (*client) {
+			xmms_ipc_transport_destroy (*client);
+		}
+		if (*peer) {
+			xmms_ipc_transport_destroy (*peer);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+/* Whether there is input on the transport's descriptor right now */
+static bool
+readable (xmms_ipc_transport_t *ipct)
+{
+	struct timeval tv = { 0, 0 };
+	fd_set fds;
+	int fd;
+
+	fd = xmms_ipc_transport_fd_get (ipct);
+
+	FD_ZERO (&fds);
+	FD_SET (fd, &fds);
+
+	return select (fd + 1, &fds, NULL, NULL, &tv) == 1;
+}
+
+static void
+fill (unsigned char *data, int len, int seed)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		data[i] = (seed * 31 + i * 7 + i / 251) & 0xff;
+	}
+}
+
+static xmms_ipc_msg_t *
+payload_msg (const unsigned char *data, int len)
+{
+	xmms_ipc_msg_t *msg;
+	xmmsv_t *bin;
+
+	msg = xmms_ipc_msg_new (0, 0);
+	bin = xmmsv_new_bin (data, len);
+	xmms_ipc_msg_put_value (msg, bin);
+	xmmsv_unref (bin);
+
+	return msg;
+}
+
+static bool
+payload_equal (xmms_ipc_msg_t *msg, const unsigned char *data, int len)
+{
+	const unsigned char *got;
+	unsigned int got_len;
+	xmmsv_t *v;
+	bool ret;
+
+	if (!xmms_ipc_msg_get_value (msg, &v)) {
+		return false;
+	}
+
+	ret = xmmsv_get_bin (v, &got, &got_len) && got_len == len &&
+	      !memcmp (got, data, len);
+	xmmsv_unref (v);
+
+	return ret;
+}
+
+SETUP (shm_ring) {
+	snprintf (url, sizeof (url), "shm:///tmp/xmms2-shm-ring-%d",
+	          (int) getpid ());
+
+	server = xmms_ipc_server_init (url);
+
+	return server == NULL;
+}
+
+CLEANUP () {
+	xmms_ipc_transport_destroy (server);
+	unlink (url + strlen ("shm://"));
+
+	return 0;
+}
+
+CASE (test_wraparound)
+{
+	xmms_ipc_transport_t *client, *peer;
+	xmms_ipc_msg_t *out[3], *in;
+	unsigned char *data[3];
+	bool disconnected = false;
+	int i, sent = 0, got = 0, rounds;
+
+	CU_ASSERT_TRUE_FATAL (connect_pair (&client, &peer));
+
+	/* each one bigger than half the ring, so the second one doesn't
+	 * fit while the first is unread and the rest has to go around
+	 * the end */
+	for (i = 0; i < 3; i++) {
+		data[i] = malloc (RING_SIZE * 3 / 5);
+		fill (data[i], RING_SIZE * 3 / 5, i);
+		out[i] = payload_msg (data[i], RING_SIZE * 3 / 5);
+	}
+
+	in = xmms_ipc_msg_alloc ();
+
+	for (rounds = 0; got < 3 && rounds < 100; rounds++) {
+		if (sent < 3 &&
+		    xmms_ipc_msg_write_transport (out[sent], client, &disconnected)) {
+			sent++;
+		}
+		if (sent == 1 && !got) {
+			/* the second one stops at the end of the free space,
+			 * and then waits for the reader */
+			CU_ASSERT_FALSE (xmms_ipc_msg_write_transport (out[1], client,
+			                                               &disconnected));
+			CU_ASSERT_FALSE (xmms_ipc_transport_write_blocked (client));
+			CU_ASSERT_FALSE (xmms_ipc_msg_write_transport (out[1], client,
+			                                               &disconnected));
+			CU_ASSERT_TRUE (xmms_ipc_transport_write_blocked (client));
+		}
+		while (got < 3 &&
+		       xmms_ipc_msg_read_transport (in, peer, &disconnected)) {
+			CU_ASSERT_TRUE (payload_equal (in, data[got], RING_SIZE * 3 / 5));
+			xmms_ipc_msg_destroy (in);
+			in = xmms_ipc_msg_alloc ();
+			got++;
+		}
+	}
+
+	CU_ASSERT_EQUAL (got, 3);
+	CU_ASSERT_FALSE (disconnected);
+
+	for (i = 0; i < 3; i++) {
+		xmms_ipc_msg_destroy (out[i]);
+		free (data[i]);
+	}
+	xmms_ipc_msg_destroy (in);
+
+	xmms_ipc_transport_destroy (client);
+	xmms_ipc_transport_destroy (peer);
+}
+
+CASE (test_full_ring)
+{
+	xmms_ipc_transport_t *client, *peer;
+	unsigned char *data, *buf;
+	int ret, pos;
+
+	CU_ASSERT_TRUE_FATAL (connect_pair (&client, &peer));
+
+	/* nobody has read yet, the first write has to wake the reader */
+	CU_ASSERT_FALSE (readable (peer));
+
+	data = malloc (RING_SIZE + 4096);
+	buf = malloc (RING_SIZE + 4096);
+	fill (data, RING_SIZE + 4096, 1);
+
+	/* fill it up, only what fits is taken */
+	ret = xmms_ipc_transport_write (client, (char *) data, RING_SIZE + 4096);
+	CU_ASSERT_EQUAL (ret, RING_SIZE);
+	CU_ASSERT_FALSE (xmms_ipc_transport_write_blocked (client));
+
+	/* the next write finds it full and waits for the reader */
+	errno = 0;
+	ret = xmms_ipc_transport_write (client, (char *) data + RING_SIZE, 4096);
+	CU_ASSERT_EQUAL (ret, -1);
+	CU_ASSERT_EQUAL (errno, EAGAIN);
+	CU_ASSERT_TRUE (xmms_ipc_transport_write_blocked (client));
+	CU_ASSERT_FALSE (readable (client));
+
+	/* the reader making room wakes it up */
+	CU_ASSERT_TRUE (readable (peer));
+	ret = xmms_ipc_transport_read (peer, (char *) buf, 1000);
+	CU_ASSERT_EQUAL (ret, 1000);
+	CU_ASSERT_TRUE (readable (client));
+	CU_ASSERT_FALSE (xmms_ipc_transport_write_blocked (client));
+
+	/* and it carries on from where it stopped, over the end */
+	ret = xmms_ipc_transport_write (client, (char *) data + RING_SIZE, 4096);
+	CU_ASSERT_EQUAL (ret, 1000);
+	ret = xmms_ipc_transport_write (client, (char *) data + RING_SIZE + 1000, 3096);
+	CU_ASSERT_EQUAL (ret, -1);
+	CU_ASSERT_TRUE (xmms_ipc_transport_write_blocked (client));
+
+	for (pos = 1000; pos < RING_SIZE + 1000; pos += ret) {
+		ret = xmms_ipc_transport_read (peer, (char *) buf + pos,
+		                               RING_SIZE + 4096 - pos);
+		if (ret <= 0) {
+			break;
+		}
+	}
+	CU_ASSERT_EQUAL (pos, RING_SIZE + 1000);
+	CU_ASSERT_EQUAL (memcmp (buf, data, RING_SIZE + 1000), 0);
+
+	ret = xmms_ipc_transport_write (client, (char *) data + RING_SIZE + 1000, 3096);
+	CU_ASSERT_EQUAL (ret, 3096);
+	ret = xmms_ipc_transport_read (peer, (char *) buf + pos, 4096);
+	CU_ASSERT_EQUAL (ret, 3096);
+	CU_ASSERT_EQUAL (memcmp (buf, data, RING_SIZE + 4096), 0);
+
+	/* empty now, the reader has to wait for the next write */
+	errno = 0;
+	CU_ASSERT_EQUAL (xmms_ipc_transport_read (peer, (char *) buf, 1), -1);
+	CU_ASSERT_EQUAL (errno, EAGAIN);
+	CU_ASSERT_FALSE (readable (peer));
+	CU_ASSERT_EQUAL (xmms_ipc_transport_write (client, (char *) data, 1), 1);
+	CU_ASSERT_TRUE (readable (peer));
+
+	free (data);
+	free (buf);
+
+	xmms_ipc_transport_destroy (client);
+	xmms_ipc_transport_destroy (peer);
+}
+
+CASE (test_hangup)
+{
+	xmms_ipc_transport_t *client, *peer;
+	xmms_ipc_msg_t *msg;
+	unsigned char data[1000];
+	bool disconnected = false;
+
+	CU_ASSERT_TRUE_FATAL (connect_pair (&client, &peer));
+
+	/* what was written right before hanging up still arrives */
+	fill (data, sizeof (data), 2);
+	msg = payload_msg (data, sizeof (data));
+	CU_ASSERT_TRUE (xmms_ipc_msg_write_transport (msg, client, &disconnected));
+	xmms_ipc_msg_destroy (msg);
+
+	xmms_ipc_transport_destroy (client);
+
+	CU_ASSERT_TRUE (readable (peer));
+
+	msg = xmms_ipc_msg_alloc ();
+	CU_ASSERT_TRUE (xmms_ipc_msg_read_transport (msg, peer, &disconnected));
+	CU_ASSERT_FALSE (disconnected);
+	CU_ASSERT_TRUE (payload_equal (msg, data, sizeof (data)));
+	xmms_ipc_msg_destroy (msg);
+
+	/* then the hangup */
+	msg = xmms_ipc_msg_alloc ();
+	CU_ASSERT_FALSE (xmms_ipc_msg_read_transport (msg, peer, &disconnected));
+	CU_ASSERT_TRUE (disconnected);
+	xmms_ipc_msg_destroy (msg);
+
+	xmms_ipc_transport_destroy (peer);
+}
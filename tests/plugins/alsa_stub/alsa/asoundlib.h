@@ -0,0 +1,150 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ * The part of the ALSA PCM API the alsa output uses, implemented by
+ * pcm.c next to this directory so the tests run without ALSA or a
+ * sound card. It knows two devices, "null" and
+ * "file:FILE=<path>,FORMAT=raw", which behave like the ALSA plugins
+ * of the same names. The hardware plays a period every time the
+ * stream is waited on, instead of in real time.
+ */
+
+#ifndef __ALSA_STUB_ASOUNDLIB_H__
+#define __ALSA_STUB_ASOUNDLIB_H__
+
+#include <sys/types.h>
+#include <alloca.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef ESTRPIPE
+#define ESTRPIPE 86
+#endif
+
+typedef struct _snd_pcm snd_pcm_t;
+typedef struct _snd_pcm_hw_params snd_pcm_hw_params_t;
+typedef struct _snd_pcm_sw_params snd_pcm_sw_params_t;
+
+typedef unsigned long snd_pcm_uframes_t;
+typedef long snd_pcm_sframes_t;
+
+typedef enum {
+	SND_PCM_STREAM_PLAYBACK = 0,
+	SND_PCM_STREAM_CAPTURE
+} snd_pcm_stream_t;
+
+typedef enum {
+	SND_PCM_ACCESS_MMAP_INTERLEAVED = 0,
+	SND_PCM_ACCESS_MMAP_NONINTERLEAVED,
+	SND_PCM_ACCESS_MMAP_COMPLEX,
+	SND_PCM_ACCESS_RW_INTERLEAVED,
+	SND_PCM_ACCESS_RW_NONINTERLEAVED
+} snd_pcm_access_t;
+
+typedef enum {
+	SND_PCM_FORMAT_UNKNOWN = -1,
+	SND_PCM_FORMAT_S8 = 0,
+	SND_PCM_FORMAT_U8,
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_U16_LE,
+	SND_PCM_FORMAT_U16_BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_BE,
+	SND_PCM_FORMAT_U24_LE,
+	SND_PCM_FORMAT_U24_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_U32_LE,
+	SND_PCM_FORMAT_U32_BE,
+	SND_PCM_FORMAT_FLOAT_LE,
+	SND_PCM_FORMAT_FLOAT_BE,
+	SND_PCM_FORMAT_FLOAT64_LE,
+	SND_PCM_FORMAT_FLOAT64_BE
+} snd_pcm_format_t;
+
+typedef enum {
+	SND_PCM_STATE_OPEN = 0,
+	SND_PCM_STATE_SETUP,
+	SND_PCM_STATE_PREPARED,
+	SND_PCM_STATE_RUNNING,
+	SND_PCM_STATE_XRUN,
+	SND_PCM_STATE_DRAINING,
+	SND_PCM_STATE_PAUSED,
+	SND_PCM_STATE_SUSPENDED,
+	SND_PCM_STATE_DISCONNECTED
+} snd_pcm_state_t;
+
+typedef struct {
+	void *addr;
+	/** offset to the first sample and between samples, in bits */
+	unsigned int first;
+	unsigned int step;
+} snd_pcm_channel_area_t;
+
+size_t snd_pcm_hw_params_sizeof (void);
+size_t snd_pcm_sw_params_sizeof (void);
+
+#define snd_pcm_hw_params_alloca(ptr) \
+	do { \
+		*(ptr) = (snd_pcm_hw_params_t *) alloca (snd_pcm_hw_params_sizeof ()); \
+		memset (*(ptr), 0, snd_pcm_hw_params_sizeof ()); \
+	} while (0)
+
+#define snd_pcm_sw_params_alloca(ptr) \
+	do { \
+		*(ptr) = (snd_pcm_sw_params_t *) alloca (snd_pcm_sw_params_sizeof ()); \
+		memset (*(ptr), 0, snd_pcm_sw_params_sizeof ()); \
+	} while (0)
+
+int snd_pcm_open (snd_pcm_t **pcm, const char *name, snd_pcm_stream_t stream, int mode);
+int snd_pcm_close (snd_pcm_t *pcm);
+
+int snd_pcm_hw_params_any (snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
+int snd_pcm_hw_params_test_access (snd_pcm_t *pcm, snd_pcm_hw_params_t *params, snd_pcm_access_t access);
+int snd_pcm_hw_params_set_access (snd_pcm_t *pcm, snd_pcm_hw_params_t *params, snd_pcm_access_t access);
+int snd_pcm_hw_params_set_format (snd_pcm_t *pcm, snd_pcm_hw_params_t *params, snd_pcm_format_t format);
+int snd_pcm_hw_params_set_channels (snd_pcm_t *pcm, snd_pcm_hw_params_t *params, unsigned int val);
+int snd_pcm_hw_params_set_rate (snd_pcm_t *pcm, snd_pcm_hw_params_t *params, unsigned int val, int dir);
+int snd_pcm_hw_params_set_buffer_time_near (snd_pcm_t *pcm, snd_pcm_hw_params_t *params, unsigned int *val, int *dir);
+int snd_pcm_hw_params_set_period_time_near (snd_pcm_t *pcm, snd_pcm_hw_params_t *params, unsigned int *val, int *dir);
+int snd_pcm_hw_params (snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
+int snd_pcm_hw_params_get_buffer_size (const snd_pcm_hw_params_t *params, snd_pcm_uframes_t *val);
+int snd_pcm_hw_params_get_period_size (const snd_pcm_hw_params_t *params, snd_pcm_uframes_t *val, int *dir);
+
+int snd_pcm_sw_params_current (snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
+int snd_pcm_sw_params_set_start_threshold (snd_pcm_t *pcm, snd_pcm_sw_params_t *params, snd_pcm_uframes_t val);
+int snd_pcm_sw_params_set_avail_min (snd_pcm_t *pcm, snd_pcm_sw_params_t *params, snd_pcm_uframes_t val);
+int snd_pcm_sw_params (snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
+
+ssize_t snd_pcm_frames_to_bytes (snd_pcm_t *pcm, snd_pcm_sframes_t frames);
+
+snd_pcm_state_t snd_pcm_state (snd_pcm_t *pcm);
+int snd_pcm_prepare (snd_pcm_t *pcm);
+int snd_pcm_start (snd_pcm_t *pcm);
+int snd_pcm_drop (snd_pcm_t *pcm);
+int snd_pcm_drain (snd_pcm_t *pcm);
+int snd_pcm_resume (snd_pcm_t *pcm);
+int snd_pcm_wait (snd_pcm_t *pcm, int timeout);
+int snd_pcm_delay (snd_pcm_t *pcm, snd_pcm_sframes_t *delayp);
+snd_pcm_sframes_t snd_pcm_avail_update (snd_pcm_t *pcm);
+
+snd_pcm_sframes_t snd_pcm_writei (snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size);
+int snd_pcm_mmap_begin (snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames);
+snd_pcm_sframes_t snd_pcm_mmap_commit (snd_pcm_t *pcm, snd_pcm_uframes_t offset, snd_pcm_uframes_t frames);
+
+#endif
@@ -0,0 +1,547 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ * A stand-in for ALSA's PCM devices, see alsa/asoundlib.h.
+ *
+ * The hardware buffer is a ring of buffer_size frames. appl counts
+ * the frames written to it and hw the frames played, so what is
+ * queued is appl - hw. Playing hands the frames to the file, if
+ * there is one.
+ */
+
+#include <stdio.h>
+#include <glib.h>
+
+#include "alsa/asoundlib.h"
+
+struct _snd_pcm_hw_params {
+	snd_pcm_access_t access;
+	snd_pcm_format_t format;
+	unsigned int channels;
+	unsigned int rate;
+	unsigned int buffer_time;
+	unsigned int period_time;
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_uframes_t period_size;
+};
+
+struct _snd_pcm_sw_params {
+	snd_pcm_uframes_t start_threshold;
+	snd_pcm_uframes_t avail_min;
+};
+
+struct _snd_pcm {
+	snd_pcm_state_t state;
+	FILE *file;
+
+	snd_pcm_hw_params_t hw;
+	snd_pcm_sw_params_t sw;
+	gint frame_bytes;
+
+	guint8 *ring;
+	snd_pcm_uframes_t appl;
+	snd_pcm_uframes_t played;
+	snd_pcm_channel_area_t area;
+};
+
+size_t
+snd_pcm_hw_params_sizeof (void)
+{
+	return sizeof (snd_pcm_hw_params_t);
+}
+
+size_t
+snd_pcm_sw_params_sizeof (void)
+{
+	return sizeof (snd_pcm_sw_params_t);
+}
+
+int
+snd_pcm_open (snd_pcm_t **pcm, const char *name, snd_pcm_stream_t stream,
+              int mode)
+{
+	gchar *path = NULL;
+	FILE *file = NULL;
+
+	if (stream != SND_PCM_STREAM_PLAYBACK) {
+		return -EINVAL;
+	}
+
+	if (g_str_has_prefix (name, "file:FILE=") &&
+	    g_str_has_suffix (name, ",FORMAT=raw")) {
+		path = g_strndup (name + strlen ("file:FILE="),
+		                  strlen (name) - strlen ("file:FILE=,FORMAT=raw"));
+		file = fopen (path, "wb");
+		g_free (path);
+		if (!file) {
+			return -errno;
+		}
+	} else if (strcmp (name, "null") != 0) {
+		return -ENOENT;
+	}
+
+	*pcm = g_new0 (snd_pcm_t, 1);
+	(*pcm)->state = SND_PCM_STATE_OPEN;
+	(*pcm)->file = file;
+
+	return 0;
+}
+
+int
+snd_pcm_close (snd_pcm_t *pcm)
+{
+	if (pcm->file) {
+		fclose (pcm->file);
+	}
+	g_free (pcm->ring);
+	g_free (pcm);
+
+	return 0;
+}
+
+static gint
+format_bytes (snd_pcm_format_t format)
+{
+	switch (format) {
+		case SND_PCM_FORMAT_S8:
+		case SND_PCM_FORMAT_U8:
+			return 1;
+		case SND_PCM_FORMAT_S16_LE:
+		case SND_PCM_FORMAT_S16_BE:
+		case SND_PCM_FORMAT_U16_LE:
+		case SND_PCM_FORMAT_U16_BE:
+			return 2;
+		case SND_PCM_FORMAT_FLOAT64_LE:
+		case SND_PCM_FORMAT_FLOAT64_BE:
+			return 8;
+		case SND_PCM_FORMAT_UNKNOWN:
+			return 0;
+		default:
+			/* 24 bit samples take 32 bits, like in ALSA */
+			return 4;
+	}
+}
+
+/* Let the hardware play up to frames of what is queued */
+static void
+play (snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	snd_pcm_uframes_t offset, n;
+
+	frames = MIN (frames, pcm->appl - pcm->played);
+
+	while (frames > 0) {
+		offset = pcm->played % pcm->hw.buffer_size;
+		n = MIN (frames, pcm->hw.buffer_size - offset);
+
+		if (pcm->file) {
+			fwrite (pcm->ring + offset * pcm->frame_bytes,
+			        pcm->frame_bytes, n, pcm->file);
+		}
+
+		pcm->played += n;
+		frames -= n;
+	}
+}
+
+static snd_pcm_uframes_t
+avail (snd_pcm_t *pcm)
+{
+	return pcm->hw.buffer_size - (pcm->appl - pcm->played);
+}
+
+int
+snd_pcm_hw_params_any (snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	memset (params, 0, sizeof (*params));
+	params->access = SND_PCM_ACCESS_RW_INTERLEAVED;
+	params->format = SND_PCM_FORMAT_UNKNOWN;
+
+	return 0;
+}
+
+int
+snd_pcm_hw_params_test_access (snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
+                               snd_pcm_access_t access)
+{
+	if (access != SND_PCM_ACCESS_RW_INTERLEAVED &&
+	    access != SND_PCM_ACCESS_MMAP_INTERLEAVED) {
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int
+snd_pcm_hw_params_set_access (snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
+                              snd_pcm_access_t access)
+{
+	if (snd_pcm_hw_params_test_access (pcm, params, access) < 0) {
+		return -EINVAL;
+	}
+
+	params->access = access;
+	return 0;
+}
+
+int
+snd_pcm_hw_params_set_format (snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
+                              snd_pcm_format_t format)
+{
+	if (!format_bytes (format)) {
+		return -EINVAL;
+	}
+
+	params->format = format;
+	return 0;
+}
+
+int
+snd_pcm_hw_params_set_channels (snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
+                                unsigned int val)
+{
+	if (val < 1 || val > 32) {
+		return -EINVAL;
+	}
+
+	params->channels = val;
+	return 0;
+}
+
+int
+snd_pcm_hw_params_set_rate (snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
+                            unsigned int val, int dir)
+{
+	if (val < 4000 || val > 192000) {
+		return -EINVAL;
+	}
+
+	params->rate = val;
+	return 0;
+}
+
+/* Times are turned into whole frames, and back into what that
+ * comes to */
+static snd_pcm_uframes_t
+time_to_frames (snd_pcm_hw_params_t *params, unsigned int *val)
+{
+	snd_pcm_uframes_t frames;
+
+	frames = MAX ((guint64) *val * params->rate / G_USEC_PER_SEC, 1);
+	*val = (guint64) frames * G_USEC_PER_SEC / params->rate;
+
+	return frames;
+}
+
+int
+snd_pcm_hw_params_set_buffer_time_near (snd_pcm_t *pcm,
+                                        snd_pcm_hw_params_t *params,
+                                        unsigned int *val, int *dir)
+{
+	if (!params->rate) {
+		return -EINVAL;
+	}
+
+	params->buffer_size = time_to_frames (params, val);
+	params->buffer_time = *val;
+
+	return 0;
+}
+
+int
+snd_pcm_hw_params_set_period_time_near (snd_pcm_t *pcm,
+                                        snd_pcm_hw_params_t *params,
+                                        unsigned int *val, int *dir)
+{
+	if (!params->rate) {
+		return -EINVAL;
+	}
+
+	params->period_size = time_to_frames (params, val);
+	params->period_time = *val;
+
+	return 0;
+}
+
+/* The buffer is made a whole number of periods, at least two */
+int
+snd_pcm_hw_params (snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	snd_pcm_uframes_t periods;
+
+	if (pcm->state > SND_PCM_STATE_PREPARED) {
+		return -EBADFD;
+	}
+
+	if (params->format == SND_PCM_FORMAT_UNKNOWN || !params->channels ||
+	    !params->rate || !params->buffer_size || !params->period_size) {
+		return -EINVAL;
+	}
+
+	periods = MAX (params->buffer_size / params->period_size, 2);
+	params->buffer_size = periods * params->period_size;
+
+	pcm->hw = *params;
+	pcm->frame_bytes = format_bytes (params->format) * params->channels;
+	pcm->ring = g_realloc (pcm->ring, params->buffer_size * pcm->frame_bytes);
+
+	pcm->area.addr = pcm->ring;
+	pcm->area.first = 0;
+	pcm->area.step = pcm->frame_bytes * 8;
+
+	pcm->sw.start_threshold = 1;
+	pcm->sw.avail_min = params->period_size;
+
+	pcm->appl = pcm->played = 0;
+	pcm->state = SND_PCM_STATE_PREPARED;
+
+	return 0;
+}
+
+int
+snd_pcm_hw_params_get_buffer_size (const snd_pcm_hw_params_t *params,
+                                   snd_pcm_uframes_t *val)
+{
+	*val = params->buffer_size;
+	return 0;
+}
+
+int
+snd_pcm_hw_params_get_period_size (const snd_pcm_hw_params_t *params,
+                                   snd_pcm_uframes_t *val, int *dir)
+{
+	*val = params->period_size;
+	return 0;
+}
+
+int
+snd_pcm_sw_params_current (snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
+{
+	if (pcm->state < SND_PCM_STATE_SETUP) {
+		return -EBADFD;
+	}
+
+	*params = pcm->sw;
+	return 0;
+}
+
+int
+snd_pcm_sw_params_set_start_threshold (snd_pcm_t *pcm,
+                                       snd_pcm_sw_params_t *params,
+                                       snd_pcm_uframes_t val)
+{
+	params->start_threshold = val;
+	return 0;
+}
+
+int
+snd_pcm_sw_params_set_avail_min (snd_pcm_t *pcm, snd_pcm_sw_params_t *params,
+                                 snd_pcm_uframes_t val)
+{
+	params->avail_min = val;
+	return 0;
+}
+
+int
+snd_pcm_sw_params (snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
+{
+	if (pcm->state < SND_PCM_STATE_SETUP) {
+		return -EBADFD;
+	}
+
+	pcm->sw = *params;
+	return 0;
+}
+
+ssize_t
+snd_pcm_frames_to_bytes (snd_pcm_t *pcm, snd_pcm_sframes_t frames)
+{
+	return frames * pcm->frame_bytes;
+}
+
+snd_pcm_state_t
+snd_pcm_state (snd_pcm_t *pcm)
+{
+	return pcm->state;
+}
+
+int
+snd_pcm_prepare (snd_pcm_t *pcm)
+{
+	if (pcm->state < SND_PCM_STATE_SETUP) {
+		return -EBADFD;
+	}
+
+	pcm->appl = pcm->played = 0;
+	pcm->state = SND_PCM_STATE_PREPARED;
+
+	return 0;
+}
+
+int
+snd_pcm_start (snd_pcm_t *pcm)
+{
+	if (pcm->state != SND_PCM_STATE_PREPARED) {
+		return -EBADFD;
+	}
+
+	pcm->state = SND_PCM_STATE_RUNNING;
+	return 0;
+}
+
+int
+snd_pcm_drop (snd_pcm_t *pcm)
+{
+	if (pcm->state < SND_PCM_STATE_SETUP) {
+		return -EBADFD;
+	}
+
+	pcm->played = pcm->appl;
+	pcm->state = SND_PCM_STATE_SETUP;
+
+	return 0;
+}
+
+int
+snd_pcm_drain (snd_pcm_t *pcm)
+{
+	if (pcm->state < SND_PCM_STATE_SETUP) {
+		return -EBADFD;
+	}
+
+	play (pcm, pcm->appl - pcm->played);
+	pcm->state = SND_PCM_STATE_SETUP;
+
+	return 0;
+}
+
+int
+snd_pcm_resume (snd_pcm_t *pcm)
+{
+	return -ENOSYS;
+}
+
+/* A period is played every time the stream is waited on */
+int
+snd_pcm_wait (snd_pcm_t *pcm, int timeout)
+{
+	if (pcm->state != SND_PCM_STATE_RUNNING) {
+		return avail (pcm) >= pcm->sw.avail_min;
+	}
+
+	play (pcm, pcm->hw.period_size);
+
+	return 1;
+}
+
+int
+snd_pcm_delay (snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
+{
+	if (pcm->state != SND_PCM_STATE_RUNNING &&
+	    pcm->state != SND_PCM_STATE_PREPARED) {
+		return -EBADFD;
+	}
+
+	*delayp = pcm->appl - pcm->played;
+	return 0;
+}
+
+snd_pcm_sframes_t
+snd_pcm_avail_update (snd_pcm_t *pcm)
+{
+	if (pcm->state != SND_PCM_STATE_RUNNING &&
+	    pcm->state != SND_PCM_STATE_PREPARED) {
+		return -EBADFD;
+	}
+
+	return avail (pcm);
+}
+
+/* Blocks like a device opened without SND_PCM_NONBLOCK, by letting
+ * the hardware play when the buffer is full */
+snd_pcm_sframes_t
+snd_pcm_writei (snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size)
+{
+	const guint8 *src = buffer;
+	snd_pcm_uframes_t done = 0, offset, n;
+
+	if (pcm->state != SND_PCM_STATE_RUNNING &&
+	    pcm->state != SND_PCM_STATE_PREPARED) {
+		return -EBADFD;
+	}
+
+	if (pcm->hw.access != SND_PCM_ACCESS_RW_INTERLEAVED) {
+		return -EINVAL;
+	}
+
+	while (done < size) {
+		if (!avail (pcm)) {
+			if (pcm->state == SND_PCM_STATE_PREPARED) {
+				pcm->state = SND_PCM_STATE_RUNNING;
+			}
+			play (pcm, pcm->hw.period_size);
+		}
+
+		offset = pcm->appl % pcm->hw.buffer_size;
+		n = MIN (size - done, MIN (avail (pcm), pcm->hw.buffer_size - offset));
+
+		memcpy (pcm->ring + offset * pcm->frame_bytes,
+		        src + done * pcm->frame_bytes, n * pcm->frame_bytes);
+		pcm->appl += n;
+		done += n;
+
+		if (pcm->state == SND_PCM_STATE_PREPARED &&
+		    pcm->appl - pcm->played >= pcm->sw.start_threshold) {
+			pcm->state = SND_PCM_STATE_RUNNING;
+		}
+	}
+
+	return done;
+}
+
+int
+snd_pcm_mmap_begin (snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas,
+                    snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames)
+{
+	if (pcm->state != SND_PCM_STATE_RUNNING &&
+	    pcm->state != SND_PCM_STATE_PREPARED) {
+		return -EBADFD;
+	}
+
+	if (pcm->hw.access != SND_PCM_ACCESS_MMAP_INTERLEAVED) {
+		return -ENXIO;
+	}
+
+	*areas = &pcm->area;
+	*offset = pcm->appl % pcm->hw.buffer_size;
+	*frames = MIN (*frames, MIN (avail (pcm), pcm->hw.buffer_size - *offset));
+
+	return 0;
+}
+
+/* Unlike writei, this doesn't start the stream */
+snd_pcm_sframes_t
+snd_pcm_mmap_commit (snd_pcm_t *pcm, snd_pcm_uframes_t offset,
+                     snd_pcm_uframes_t frames)
+{
+	if (offset != pcm->appl % pcm->hw.buffer_size || frames > avail (pcm)) {
+		return -EPIPE;
+	}
+
+	pcm->appl += frames;
+	return frames;
+}
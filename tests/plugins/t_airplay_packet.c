@@ -0,0 +1,176 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <openssl/evp.h>
+
+#include "raop_packet.h"
+
+#define BATCH 4
+
+/* not all multiples of four samples, to get the packer's tail going */
+static const guint32 lengths[] = { RAOP_PACKET_PCM_SIZE, 2, 4, 6, 8, 10,
+                                   1002, RAOP_PACKET_PCM_SIZE - 2 };
+
+static const guint8 key[16] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+                                0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 };
+static const guint8 iv[16] = { 0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+                               0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0 };
+
+/* the bit writer the packets used to be put together with */
+static void
+write_bits (guint8 *buf, guint8 val, gint nbits, guint32 *offset)
+{
+	int bit_offset = *offset % 8;
+	int byte_offset = *offset / 8;
+	int left = 8 - bit_offset;
+
+	*offset += nbits;
+	if (nbits >= left) {
+		buf[byte_offset] |= (val >> (nbits - left));
+		val = (val << left) >> left;
+		nbits -= left;
+		left = 8;
+		byte_offset++;
+	}
+	if (nbits && nbits < left) {
+		buf[byte_offset] |= (val << (left - nbits));
+	}
+}
+
+static guint32
+reference_pack (guint8 *sbuf, const guint16 *buf, guint32 len)
+{
+	guint8 hdr[] = {0x24, 0x00, 0x00, 0x00,
+	                0xF0, 0xFF, 0x00, 0x00,
+	                0x00, 0x00, 0x00, 0x00,
+	                0x00, 0x00, 0x00, 0x00};
+	guint16 cnt;
+	guint8 *pbuf;
+	guint32 offset = 0;
+	gint i;
+
+	cnt = GUINT16_TO_BE (len + 3 + 12);
+	memcpy (hdr + 2, &cnt, sizeof (cnt));
+
+	memset (sbuf, 0, RAOP_PACKET_MAX_SIZE);
+	memcpy (sbuf, hdr, sizeof (hdr));
+	pbuf = sbuf + sizeof (hdr);
+
+	write_bits (pbuf, 1, 3, &offset);
+	write_bits (pbuf, 0, 4, &offset);
+	write_bits (pbuf, 0, 4, &offset);
+	write_bits (pbuf, 0, 8, &offset);
+	write_bits (pbuf, 0, 1, &offset);
+	write_bits (pbuf, 0, 2, &offset);
+	write_bits (pbuf, 1, 1, &offset);
+
+	for (i = 0; i < len / 2; i++) {
+		write_bits (pbuf, buf[i] >> 8, 8, &offset);
+		write_bits (pbuf, buf[i] & 0xff, 8, &offset);
+	}
+
+	return len + 3 + sizeof (hdr);
+}
+
+static void
+fill_noise (guint16 *buf, gint count, guint32 seed)
+{
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = seed >> 16;
+	}
+}
+
+SETUP (airplay_packet) {
+	g_thread_init (0);
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+CASE (test_pack_matches_bit_writer)
+{
+	guint16 samples[RAOP_PACKET_PCM_SIZE / 2];
+	guint8 expected[RAOP_PACKET_MAX_SIZE];
+	raop_packet_t packet;
+	guint32 size;
+	gint i;
+
+	for (i = 0; i < G_N_ELEMENTS (lengths); i++) {
+		fill_noise (samples, lengths[i] / 2, i + 1);
+		size = reference_pack (expected, samples, lengths[i]);
+
+		/* nothing of what was in the packet before may show through */
+		memset (&packet, 0xff, sizeof (packet));
+		raop_packet_pack (&packet, samples, lengths[i]);
+
+		CU_ASSERT_EQUAL (packet.size, size);
+		CU_ASSERT_EQUAL (packet.offset, 0);
+		CU_ASSERT_EQUAL (memcmp (packet.data, expected, size), 0);
+	}
+}
+
+CASE (test_encrypt_batch)
+{
+	guint16 samples[RAOP_PACKET_PCM_SIZE / 2];
+	raop_packet_t packets[BATCH], plain[BATCH];
+	raop_packet_t *batch[BATCH];
+	raop_packet_cipher_t *cipher;
+	EVP_CIPHER_CTX *ctx;
+	guint8 expected[RAOP_PACKET_MAX_SIZE];
+	gint i, len, outlen;
+
+	for (i = 0; i < BATCH; i++) {
+		fill_noise (samples, G_N_ELEMENTS (samples), i + 1);
+		raop_packet_pack (&packets[i], samples, lengths[i]);
+		plain[i] = packets[i];
+		batch[i] = &packets[i];
+	}
+
+	cipher = raop_packet_cipher_new (key, iv);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (cipher);
+	CU_ASSERT_TRUE (raop_packet_encrypt (cipher, batch, 2));
+	CU_ASSERT_TRUE (raop_packet_encrypt (cipher, batch + 2, BATCH - 2));
+	raop_packet_cipher_free (cipher);
+
+	/* every packet is a CBC run of its own, starting from the IV, and
+	 * the bytes after the last whole block are left alone */
+	ctx = EVP_CIPHER_CTX_new ();
+	for (i = 0; i < BATCH; i++) {
+		memcpy (expected, plain[i].data, plain[i].size);
+		len = plain[i].size - RAOP_PACKET_HEADER_SIZE;
+		len -= len % 16;
+
+		EVP_EncryptInit_ex (ctx, EVP_aes_128_cbc (), NULL, key, iv);
+		EVP_CIPHER_CTX_set_padding (ctx, 0);
+		EVP_EncryptUpdate (ctx, expected + RAOP_PACKET_HEADER_SIZE, &outlen,
+		                   plain[i].data + RAOP_PACKET_HEADER_SIZE, len);
+		CU_ASSERT_EQUAL (outlen, len);
+
+		CU_ASSERT_EQUAL (packets[i].size, plain[i].size);
+		CU_ASSERT_EQUAL (memcmp (packets[i].data, expected, plain[i].size), 0);
+	}
+	EVP_CIPHER_CTX_free (ctx);
+}
@@ -0,0 +1,185 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "alsa_pcm.h"
+
+#define RATE 44100
+#define CHANNELS 2
+#define FRAME_BYTES (CHANNELS * 2)
+
+static gchar *filename;
+
+static snd_pcm_t *
+open_pcm (const gchar *device)
+{
+	snd_pcm_t *pcm = NULL;
+
+	CU_ASSERT_EQUAL (snd_pcm_open (&pcm, device, SND_PCM_STREAM_PLAYBACK, 0), 0);
+
+	return pcm;
+}
+
+/* Play a pattern through the file PCM in chunks the size the output
+ * writer uses, and check that it ends up in the file unchanged */
+static void
+check_file_output (gboolean mmap)
+{
+	xmms_alsa_pcm_options_t options = { 100000, 0, 0, mmap };
+	xmms_alsa_pcm_stats_t stats;
+	xmms_alsa_pcm_t *apcm;
+	snd_pcm_t *pcm;
+	gchar *device, *contents;
+	gint16 *samples;
+	gsize len;
+	gint frames, i, chunk;
+
+	device = g_strdup_printf ("file:FILE=%s,FORMAT=raw", filename);
+	pcm = open_pcm (device);
+	g_free (device);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (pcm);
+
+	apcm = xmms_alsa_pcm_new (pcm, &options);
+	CU_ASSERT_EQUAL_FATAL (xmms_alsa_pcm_configure (apcm, SND_PCM_FORMAT_S16_LE,
+	                                                CHANNELS, RATE), 0);
+
+	xmms_alsa_pcm_stats_get (apcm, &stats);
+	CU_ASSERT_EQUAL (stats.mmap, mmap);
+
+	/* not a multiple of the period, to get a partial one at the end */
+	frames = stats.period_size * 10 + 123;
+	samples = g_new (gint16, frames * CHANNELS);
+	for (i = 0; i < frames * CHANNELS; i++) {
+		samples[i] = i * 7;
+	}
+
+	for (i = 0; i < frames; i += chunk) {
+		chunk = MIN (4096 / FRAME_BYTES, frames - i);
+		CU_ASSERT_EQUAL (xmms_alsa_pcm_write (apcm, samples + i * CHANNELS,
+		                                      chunk), 0);
+	}
+
+	snd_pcm_drain (pcm);
+	xmms_alsa_pcm_free (apcm);
+	snd_pcm_close (pcm);
+
+	CU_ASSERT_FATAL (g_file_get_contents (filename, &contents, &len, NULL));
+	CU_ASSERT_EQUAL (len, frames * FRAME_BYTES);
+	CU_ASSERT (memcmp (contents, samples, MIN (len, frames * FRAME_BYTES)) == 0);
+
+	g_free (contents);
+	g_free (samples);
+}
+
+SETUP (alsa_pcm) {
+	gint fd;
+
+	fd = g_file_open_tmp ("xmms2-alsa-pcm-XXXXXX", &filename, NULL);
+	if (fd < 0) {
+		return 1;
+	}
+	close (fd);
+
+	return 0;
+}
+
+CLEANUP () {
+	unlink (filename);
+	g_free (filename);
+	return 0;
+}
+
+CASE (test_latency_targets)
+{
+	xmms_alsa_pcm_options_t options = { 100000, 0, 0, FALSE };
+	xmms_alsa_pcm_stats_t stats;
+	xmms_alsa_pcm_t *apcm;
+	snd_pcm_t *pcm;
+
+	pcm = open_pcm ("null");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (pcm);
+
+	apcm = xmms_alsa_pcm_new (pcm, &options);
+	CU_ASSERT_EQUAL_FATAL (xmms_alsa_pcm_configure (apcm, SND_PCM_FORMAT_S16_LE,
+	                                                CHANNELS, RATE), 0);
+
+	/* 100ms in periods of a quarter of that, give or take */
+	xmms_alsa_pcm_stats_get (apcm, &stats);
+	CU_ASSERT (stats.buffer_size >= RATE / 20 && stats.buffer_size <= RATE / 5);
+	CU_ASSERT (stats.period_size >= stats.buffer_size / 8 &&
+	           stats.period_size <= stats.buffer_size / 2);
+	CU_ASSERT_EQUAL (stats.underruns, 0);
+	CU_ASSERT_EQUAL (stats.min_delay, -1);
+
+	/* without a maximum, an underrun doesn't change anything */
+	CU_ASSERT_EQUAL (xmms_alsa_pcm_recover (apcm, -EPIPE), 0);
+	xmms_alsa_pcm_stats_get (apcm, &stats);
+	CU_ASSERT_EQUAL (stats.underruns, 1);
+	CU_ASSERT_EQUAL (stats.buffer_time, 100000);
+
+	xmms_alsa_pcm_free (apcm);
+	snd_pcm_close (pcm);
+}
+
+CASE (test_buffer_grows_on_underrun)
+{
+	xmms_alsa_pcm_options_t options = { 20000, 0, 60000, FALSE };
+	xmms_alsa_pcm_stats_t stats;
+	xmms_alsa_pcm_t *apcm;
+	snd_pcm_uframes_t size;
+	snd_pcm_t *pcm;
+
+	pcm = open_pcm ("null");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (pcm);
+
+	apcm = xmms_alsa_pcm_new (pcm, &options);
+	CU_ASSERT_EQUAL_FATAL (xmms_alsa_pcm_configure (apcm, SND_PCM_FORMAT_S16_LE,
+	                                                CHANNELS, RATE), 0);
+	xmms_alsa_pcm_stats_get (apcm, &stats);
+	size = stats.buffer_size;
+
+	CU_ASSERT_EQUAL (xmms_alsa_pcm_recover (apcm, -EPIPE), 0);
+	xmms_alsa_pcm_stats_get (apcm, &stats);
+	CU_ASSERT_EQUAL (stats.buffer_time, 40000);
+	CU_ASSERT (stats.buffer_size > size);
+	CU_ASSERT_EQUAL (snd_pcm_state (pcm), SND_PCM_STATE_PREPARED);
+
+	/* up to the maximum and no further */
+	CU_ASSERT_EQUAL (xmms_alsa_pcm_recover (apcm, -EPIPE), 0);
+	CU_ASSERT_EQUAL (xmms_alsa_pcm_recover (apcm, -EPIPE), 0);
+	xmms_alsa_pcm_stats_get (apcm, &stats);
+	CU_ASSERT_EQUAL (stats.buffer_time, 60000);
+	CU_ASSERT_EQUAL (stats.underruns, 3);
+
+	xmms_alsa_pcm_free (apcm);
+	snd_pcm_close (pcm);
+}
+
+CASE (test_writei)
+{
+	check_file_output (FALSE);
+}
+
+CASE (test_mmap)
+{
+	check_file_output (TRUE);
+}
@@ -0,0 +1,62 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <glib.h>
+
+#include "cue_index.h"
+
+SETUP (cue_index) {
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+CASE (test_index_parse)
+{
+	gint number, frames;
+
+	CU_ASSERT_TRUE (xmms_cue_index_parse ("01 00:00:00", &number, &frames));
+	CU_ASSERT_EQUAL (number, 1);
+	CU_ASSERT_EQUAL (frames, 0);
+
+	CU_ASSERT_TRUE (xmms_cue_index_parse ("00 03:25:74", &number, &frames));
+	CU_ASSERT_EQUAL (number, 0);
+	CU_ASSERT_EQUAL (frames, (3 * 60 + 25) * 75 + 74);
+
+	/* the minutes go past 59 on long rips */
+	CU_ASSERT_TRUE (xmms_cue_index_parse ("1 79:59:74\r", &number, &frames));
+	CU_ASSERT_EQUAL (number, 1);
+	CU_ASSERT_EQUAL (frames, (79 * 60 + 59) * 75 + 74);
+
+	CU_ASSERT_FALSE (xmms_cue_index_parse ("01", &number, &frames));
+	CU_ASSERT_FALSE (xmms_cue_index_parse ("01 00:00", &number, &frames));
+	CU_ASSERT_FALSE (xmms_cue_index_parse ("01 00:60:00", &number, &frames));
+	CU_ASSERT_FALSE (xmms_cue_index_parse ("01 00:00:75", &number, &frames));
+	CU_ASSERT_FALSE (xmms_cue_index_parse ("01 -1:00:00", &number, &frames));
+}
+
+CASE (test_frames_to_ms)
+{
+	/* the frames used to be truncated away entirely */
+	CU_ASSERT_EQUAL (xmms_cue_frames_to_ms (74), 986);
+	CU_ASSERT_EQUAL (xmms_cue_frames_to_ms (75), 1000);
+	CU_ASSERT_EQUAL (xmms_cue_frames_to_ms ((3 * 60 + 25) * 75 + 37), 205493);
+	CU_ASSERT_EQUAL (xmms_cue_frames_to_ms ((99 * 60 + 59) * 75 + 74), 5999986);
+}
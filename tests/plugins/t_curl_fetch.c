@@ -0,0 +1,389 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+
+#include "curl_fetch.h"
+
+#define BODY_SIZE (1024 * 1024)
+#define READAHEAD (64 * 1024)
+
+/* A tiny HTTP/1.1 server standing in for the real thing */
+typedef struct {
+	gint fd;
+	guint port;
+	GThread *thread;
+	gboolean ignore_range;
+	gint quit;
+	gint connections;
+	gint requests;
+	gint range_requests;
+} http_server_t;
+
+typedef struct {
+	http_server_t *server;
+	gint fd;
+} http_conn_t;
+
+static guint8
+body_byte (guint64 i)
+{
+	return (guint8) (i ^ (i >> 8) ^ (i >> 16));
+}
+
+static gboolean
+send_all (gint fd, const gchar *buf, gsize len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = send (fd, buf, len, MSG_NOSIGNAL);
+		if (n <= 0) {
+			return FALSE;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+static gpointer
+http_conn_thread (gpointer udata)
+{
+	http_conn_t *conn = udata;
+	http_server_t *server = conn->server;
+	gchar request[4096], header[256], body[8192];
+	guint64 offset, i, j;
+	gsize fill = 0;
+	gchar *end, *range;
+	ssize_t n;
+	gboolean partial;
+
+	for (;;) {
+		/* read one request */
+		end = NULL;
+		while (!end) {
+			n = recv (conn->fd, request + fill, sizeof (request) - fill - 1, 0);
+			if (n <= 0) {
+				goto out;
+			}
+			fill += n;
+			request[fill] = '\0';
+			end = strstr (request, "\r\n\r\n");
+		}
+
+		g_atomic_int_inc (&server->requests);
+
+		offset = 0;
+		range = strstr (request, "Range: bytes=");
+		if (range && range < end) {
+			g_atomic_int_inc (&server->range_requests);
+			offset = g_ascii_strtoull (range + 13, NULL, 10);
+		}
+		partial = offset > 0 && !server->ignore_range;
+		if (!partial) {
+			offset = 0;
+		}
+
+		if (partial) {
+			g_snprintf (header, sizeof (header),
+			            "HTTP/1.1 206 Partial Content\r\n"
+			            "Content-Length: %" G_GUINT64_FORMAT "\r\n"
+			            "Content-Range: bytes %" G_GUINT64_FORMAT "-%d/%d\r\n"
+			            "Accept-Ranges: bytes\r\n\r\n",
+			            BODY_SIZE - offset, offset, BODY_SIZE - 1, BODY_SIZE);
+		} else {
+			g_snprintf (header, sizeof (header),
+			            "HTTP/1.1 200 OK\r\n"
+			            "Content-Length: %d\r\n"
+			            "Accept-Ranges: bytes\r\n\r\n", BODY_SIZE);
+		}
+
+		if (!send_all (conn->fd, header, strlen (header))) {
+			goto out;
+		}
+
+		for (i = offset; i < BODY_SIZE; i += j) {
+			for (j = 0; j < sizeof (body) && i + j < BODY_SIZE; j++) {
+				body[j] = body_byte (i + j);
+			}
+			if (!send_all (conn->fd, body, j)) {
+				goto out;
+			}
+		}
+
+		/* keep whatever came after this request */
+		end += 4;
+		fill -= end - request;
+		memmove (request, end, fill);
+	}
+
+out:
+	close (conn->fd);
+	g_free (conn);
+
+	return NULL;
+}
+
+static gpointer
+http_server_thread (gpointer udata)
+{
+	http_server_t *server = udata;
+	struct pollfd pfd;
+	http_conn_t *conn;
+	gint fd;
+
+	pfd.fd = server->fd;
+	pfd.events = POLLIN;
+
+	while (!g_atomic_int_get (&server->quit)) {
+		if (poll (&pfd, 1, 50) <= 0) {
+			continue;
+		}
+
+		fd = accept (server->fd, NULL, NULL);
+		if (fd < 0) {
+			continue;
+		}
+
+		g_atomic_int_inc (&server->connections);
+
+		conn = g_new0 (http_conn_t, 1);
+		conn->server = server;
+		conn->fd = fd;
+		g_thread_create (http_conn_thread, conn, FALSE, NULL);
+	}
+
+	return NULL;
+}
+
+static http_server_t *
+http_server_start (gboolean ignore_range)
+{
+	http_server_t *server;
+	struct sockaddr_in addr;
+	socklen_t len = sizeof (addr);
+
+	server = g_new0 (http_server_t, 1);
+	server->ignore_range = ignore_range;
+	server->fd = socket (AF_INET, SOCK_STREAM, 0);
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+	bind (server->fd, (struct sockaddr *) &addr, sizeof (addr));
+	listen (server->fd, 8);
+	getsockname (server->fd, (struct sockaddr *) &addr, &len);
+	server->port = ntohs (addr.sin_port);
+
+	server->thread = g_thread_create (http_server_thread, server, TRUE, NULL);
+
+	return server;
+}
+
+static void
+http_server_stop (http_server_t *server)
+{
+	g_atomic_int_set (&server->quit, 1);
+	g_thread_join (server->thread);
+	close (server->fd);
+	g_free (server);
+}
+
+static xmms_curl_fetch_t *
+fetch_new (http_server_t *server)
+{
+	gchar url[64];
+
+	g_snprintf (url, sizeof (url), "http://127.0.0.1:%u/track", server->port);
+
+	return xmms_curl_fetch_new (url, READAHEAD, NULL, NULL, NULL);
+}
+
+/* Read len bytes from the current position and check them */
+static gboolean
+read_check (xmms_curl_fetch_t *fetch, guint64 len)
+{
+	gchar buf[4096];
+	guint64 pos, done = 0;
+	gint n, i;
+
+	pos = xmms_curl_fetch_tell (fetch);
+
+	while (done < len) {
+		n = xmms_curl_fetch_read (fetch, buf, MIN (sizeof (buf), len - done), NULL);
+		if (n <= 0) {
+			return FALSE;
+		}
+		for (i = 0; i < n; i++) {
+			if ((guint8) buf[i] != body_byte (pos + done + i)) {
+				return FALSE;
+			}
+		}
+		done += n;
+	}
+
+	return TRUE;
+}
+
+SETUP (curl_fetch) {
+	g_thread_init (0);
+	xmms_curl_fetch_pool_init ();
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+CASE (test_read_all)
+{
+	http_server_t *server;
+	xmms_curl_fetch_t *fetch;
+	xmms_curl_fetch_stats_t stats;
+	gchar c;
+
+	server = http_server_start (FALSE);
+	fetch = fetch_new (server);
+
+	CU_ASSERT_EQUAL (1, xmms_curl_fetch_wait (fetch, NULL));
+	CU_ASSERT_EQUAL (BODY_SIZE, xmms_curl_fetch_size (fetch));
+	CU_ASSERT_TRUE (xmms_curl_fetch_seekable (fetch));
+
+	CU_ASSERT_TRUE (read_check (fetch, BODY_SIZE));
+	CU_ASSERT_EQUAL (0, xmms_curl_fetch_read (fetch, &c, 1, NULL));
+
+	xmms_curl_fetch_stats_get (fetch, &stats);
+	CU_ASSERT_EQUAL (BODY_SIZE, stats.bytes);
+	CU_ASSERT_EQUAL (1, stats.requests);
+
+	xmms_curl_fetch_free (fetch);
+	http_server_stop (server);
+}
+
+CASE (test_buffered_seek)
+{
+	http_server_t *server;
+	xmms_curl_fetch_t *fetch;
+	xmms_curl_fetch_stats_t stats;
+
+	server = http_server_start (FALSE);
+	fetch = fetch_new (server);
+
+	CU_ASSERT_TRUE (read_check (fetch, 40000));
+
+	/* backwards, still in the ring */
+	CU_ASSERT_EQUAL (30000, xmms_curl_fetch_seek (fetch, 30000));
+	CU_ASSERT_TRUE (read_check (fetch, 1000));
+
+	/* forwards again, over data that has been fetched already */
+	CU_ASSERT_EQUAL (39000, xmms_curl_fetch_seek (fetch, 39000));
+	CU_ASSERT_TRUE (read_check (fetch, 20000));
+
+	xmms_curl_fetch_stats_get (fetch, &stats);
+	CU_ASSERT_EQUAL (2, stats.buffered_seeks);
+	CU_ASSERT_EQUAL (1, stats.requests);
+	CU_ASSERT_EQUAL (0, g_atomic_int_get (&server->range_requests));
+
+	xmms_curl_fetch_free (fetch);
+	http_server_stop (server);
+}
+
+CASE (test_range_seek)
+{
+	http_server_t *server;
+	xmms_curl_fetch_t *fetch;
+	xmms_curl_fetch_stats_t stats;
+
+	server = http_server_start (FALSE);
+	fetch = fetch_new (server);
+
+	CU_ASSERT_TRUE (read_check (fetch, 1000));
+
+	CU_ASSERT_EQUAL (900000, xmms_curl_fetch_seek (fetch, 900000));
+	CU_ASSERT_TRUE (read_check (fetch, BODY_SIZE - 900000));
+
+	/* and back to the start, which has been dropped from the ring */
+	CU_ASSERT_EQUAL (0, xmms_curl_fetch_seek (fetch, 0));
+	CU_ASSERT_TRUE (read_check (fetch, 5000));
+
+	CU_ASSERT_EQUAL (-1, xmms_curl_fetch_seek (fetch, BODY_SIZE + 1));
+
+	xmms_curl_fetch_stats_get (fetch, &stats);
+	CU_ASSERT_EQUAL (3, stats.requests);
+	CU_ASSERT_EQUAL (1, g_atomic_int_get (&server->range_requests));
+
+	xmms_curl_fetch_free (fetch);
+	http_server_stop (server);
+}
+
+CASE (test_ignored_range)
+{
+	http_server_t *server;
+	xmms_curl_fetch_t *fetch;
+
+	server = http_server_start (TRUE);
+	fetch = fetch_new (server);
+
+	CU_ASSERT_TRUE (read_check (fetch, 1000));
+
+	/* the server sends everything again, the start is skipped */
+	CU_ASSERT_EQUAL (700000, xmms_curl_fetch_seek (fetch, 700000));
+	CU_ASSERT_TRUE (read_check (fetch, BODY_SIZE - 700000));
+
+	xmms_curl_fetch_free (fetch);
+	http_server_stop (server);
+}
+
+CASE (test_connection_reuse)
+{
+	http_server_t *server;
+	xmms_curl_fetch_t *fetch;
+	xmms_curl_fetch_stats_t stats;
+
+	server = http_server_start (FALSE);
+
+	fetch = fetch_new (server);
+	CU_ASSERT_TRUE (read_check (fetch, BODY_SIZE));
+	xmms_curl_fetch_stats_get (fetch, &stats);
+	CU_ASSERT_FALSE (stats.reused);
+	xmms_curl_fetch_free (fetch);
+
+	/* the next track from the same host uses the same connection */
+	fetch = fetch_new (server);
+	CU_ASSERT_TRUE (read_check (fetch, BODY_SIZE));
+	xmms_curl_fetch_stats_get (fetch, &stats);
+	CU_ASSERT_TRUE (stats.reused);
+	xmms_curl_fetch_free (fetch);
+
+	CU_ASSERT_EQUAL (2, g_atomic_int_get (&server->requests));
+	CU_ASSERT_EQUAL (1, g_atomic_int_get (&server->connections));
+
+	http_server_stop (server);
+}
@@ -0,0 +1,646 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+
+#include "daap_cmd.h"
+#include "daap_conn.h"
+#include "daap_songs.h"
+
+#define SESSION_ID 42
+#define DB_ID 7
+#define MAX_SONGS 16
+#define SONG_SIZE (64 * 1024)
+
+typedef struct {
+	gint id;
+	gchar name[32];
+	guint changed;
+	guint deleted;
+} fake_song_t;
+
+/* A DAAP server with a library that can be changed under its feet */
+typedef struct {
+	gint fd;
+	guint port;
+	GThread *thread;
+	gint quit;
+
+	/* send Connection: close and hang up after every response */
+	gboolean close_each;
+	/* hang up after every response without telling */
+	gboolean drop_idle;
+	/* answer delta requests with the full list */
+	gboolean ignore_delta;
+
+	GMutex *lock;
+	guint revision;
+	fake_song_t songs[MAX_SONGS];
+	gint n_songs;
+
+	gint connections;
+	gint requests;
+	gint item_requests;
+	gint delta_requests;
+	gint items_sent;
+} daap_server_t;
+
+typedef struct {
+	daap_server_t *server;
+	gint fd;
+} daap_server_conn_t;
+
+static void
+dmap_add (GByteArray *b, const gchar *cc, gconstpointer data, guint32 len)
+{
+	guint32 be = GUINT32_TO_BE (len);
+
+	g_byte_array_append (b, (const guint8 *) cc, 4);
+	g_byte_array_append (b, (const guint8 *) &be, 4);
+	g_byte_array_append (b, data, len);
+}
+
+static void
+dmap_int (GByteArray *b, const gchar *cc, gint32 value)
+{
+	guint32 be = GUINT32_TO_BE (value);
+	dmap_add (b, cc, &be, 4);
+}
+
+static void
+dmap_short (GByteArray *b, const gchar *cc, gint16 value)
+{
+	guint16 be = GUINT16_TO_BE (value);
+	dmap_add (b, cc, &be, 2);
+}
+
+static void
+dmap_byte (GByteArray *b, const gchar *cc, gint8 value)
+{
+	dmap_add (b, cc, &value, 1);
+}
+
+static void
+dmap_string (GByteArray *b, const gchar *cc, const gchar *value)
+{
+	dmap_add (b, cc, value, strlen (value));
+}
+
+static guint
+dmap_begin (GByteArray *b, const gchar *cc)
+{
+	dmap_add (b, cc, NULL, 0);
+	return b->len;
+}
+
+static void
+dmap_end (GByteArray *b, guint start)
+{
+	guint32 be = GUINT32_TO_BE (b->len - start);
+	memcpy (b->data + start - 4, &be, 4);
+}
+
+static guint8
+song_byte (gint id, guint i)
+{
+	return (guint8) (id * 31 + i + (i >> 8));
+}
+
+static GByteArray *
+daap_server_items (daap_server_t *server, guint delta)
+{
+	GByteArray *b;
+	fake_song_t *song;
+	guint top, list;
+	gint i, alive = 0, returned = 0;
+
+	if (server->ignore_delta) {
+		delta = 0;
+	}
+
+	for (i = 0; i < server->n_songs; i++) {
+		song = &server->songs[i];
+		if (!song->deleted) {
+			alive++;
+			if (song->changed > delta) {
+				returned++;
+			}
+		}
+	}
+
+	b = g_byte_array_new ();
+	top = dmap_begin (b, "adbs");
+	dmap_int (b, "mstt", 200);
+	dmap_byte (b, "muty", delta ? 1 : 0);
+	dmap_int (b, "mtco", alive);
+	dmap_int (b, "mrco", returned);
+
+	list = dmap_begin (b, "mlcl");
+	for (i = 0; i < server->n_songs; i++) {
+		guint item;
+
+		song = &server->songs[i];
+		if (song->deleted || song->changed <= delta) {
+			continue;
+		}
+
+		item = dmap_begin (b, "mlit");
+		dmap_byte (b, "mikd", 2);
+		dmap_int (b, "miid", song->id);
+		dmap_string (b, "minm", song->name);
+		dmap_string (b, "asar", "Artist");
+		dmap_string (b, "asfm", "mp3");
+		dmap_short (b, "astn", song->id);
+		dmap_end (b, item);
+	}
+	dmap_end (b, list);
+
+	if (delta) {
+		list = dmap_begin (b, "mudl");
+		for (i = 0; i < server->n_songs; i++) {
+			song = &server->songs[i];
+			if (song->deleted > delta) {
+				dmap_int (b, "miid", song->id);
+			}
+		}
+		dmap_end (b, list);
+	}
+
+	dmap_end (b, top);
+
+	server->items_sent = returned;
+
+	return b;
+}
+
+static GByteArray *
+daap_server_respond (daap_server_t *server, const gchar *path, gint *status)
+{
+	GByteArray *b;
+	const gchar *p;
+	guint top, list, item, i;
+	gint id;
+
+	b = g_byte_array_new ();
+	*status = 200;
+
+	g_mutex_lock (server->lock);
+
+	if (g_str_has_prefix (path, "/login")) {
+		top = dmap_begin (b, "mlog");
+		dmap_int (b, "mstt", 200);
+		dmap_int (b, "mlid", SESSION_ID);
+		dmap_end (b, top);
+	} else if (g_str_has_prefix (path, "/update")) {
+		top = dmap_begin (b, "mupd");
+		dmap_int (b, "mstt", 200);
+		dmap_int (b, "musr", server->revision);
+		dmap_end (b, top);
+	} else if (g_str_has_prefix (path, "/logout")) {
+		*status = 204;
+	} else if (g_str_has_prefix (path, "/databases?")) {
+		top = dmap_begin (b, "avdb");
+		dmap_int (b, "mstt", 200);
+		dmap_byte (b, "muty", 0);
+		dmap_int (b, "mtco", 1);
+		dmap_int (b, "mrco", 1);
+		list = dmap_begin (b, "mlcl");
+		item = dmap_begin (b, "mlit");
+		dmap_int (b, "miid", DB_ID);
+		dmap_string (b, "minm", "Library");
+		dmap_end (b, item);
+		dmap_end (b, list);
+		dmap_end (b, top);
+	} else if (g_str_has_prefix (path, "/databases/7/items?")) {
+		server->item_requests++;
+		p = strstr (path, "&delta=");
+		if (p) {
+			server->delta_requests++;
+		}
+		g_byte_array_free (b, TRUE);
+		b = daap_server_items (server, p ? atoi (p + 7) : 0);
+	} else if (sscanf (path, "/databases/7/items/%d.mp3", &id) == 1) {
+		g_byte_array_set_size (b, SONG_SIZE);
+		for (i = 0; i < SONG_SIZE; i++) {
+			b->data[i] = song_byte (id, i);
+		}
+	} else {
+		*status = 404;
+	}
+
+	g_mutex_unlock (server->lock);
+
+	return b;
+}
+
+static gboolean
+send_all (gint fd, const void *buf, gsize len)
+{
+	const gchar *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = send (fd, p, len, MSG_NOSIGNAL);
+		if (n <= 0) {
+			return FALSE;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+static gpointer
+daap_server_conn_thread (gpointer udata)
+{
+	daap_server_conn_t *conn = udata;
+	daap_server_t *server = conn->server;
+	gchar request[4096], path[1024], header[256];
+	GByteArray *body;
+	gsize fill = 0;
+	gchar *end;
+	ssize_t n;
+	gint status;
+
+	for (;;) {
+		end = NULL;
+		while (!end) {
+			n = recv (conn->fd, request + fill, sizeof (request) - fill - 1, 0);
+			if (n <= 0) {
+				goto out;
+			}
+			fill += n;
+			request[fill] = '\0';
+			end = strstr (request, "\r\n\r\n");
+		}
+
+		g_atomic_int_inc (&server->requests);
+
+		if (sscanf (request, "GET %1023s HTTP/1.1", path) != 1) {
+			goto out;
+		}
+
+		body = daap_server_respond (server, path, &status);
+
+		g_snprintf (header, sizeof (header),
+		            "HTTP/1.1 %d %s\r\n"
+		            "Content-Type: application/x-dmap-tagged\r\n"
+		            "%s"
+		            "Content-Length: %u\r\n\r\n",
+		            status, status == 404 ? "Not Found" : "OK",
+		            server->close_each ? "Connection: close\r\n" : "",
+		            status == 204 ? 0 : body->len);
+
+		if (!send_all (conn->fd, header, strlen (header)) ||
+		    !send_all (conn->fd, body->data, status == 204 ? 0 : body->len)) {
+			g_byte_array_free (body, TRUE);
+			goto out;
+		}
+		g_byte_array_free (body, TRUE);
+
+		if (server->close_each || server->drop_idle) {
+			goto out;
+		}
+
+		end += 4;
+		fill -= end - request;
+		memmove (request, end, fill);
+	}
+
+out:
+	close (conn->fd);
+	g_free (conn);
+
+	return NULL;
+}
+
+static gpointer
+daap_server_thread (gpointer udata)
+{
+	daap_server_t *server = udata;
+	daap_server_conn_t *conn;
+	struct pollfd pfd;
+	gint fd;
+
+	pfd.fd = server->fd;
+	pfd.events = POLLIN;
+
+	while (!g_atomic_int_get (&server->quit)) {
+		if (poll (&pfd, 1, 50) <= 0) {
+			continue;
+		}
+
+		fd = accept (server->fd, NULL, NULL);
+		if (fd < 0) {
+			continue;
+		}
+
+		g_atomic_int_inc (&server->connections);
+
+		conn = g_new0 (daap_server_conn_t, 1);
+		conn->server = server;
+		conn->fd = fd;
+		g_thread_create (daap_server_conn_thread, conn, FALSE, NULL);
+	}
+
+	return NULL;
+}
+
+static void
+daap_server_add_song (daap_server_t *server, gint id, const gchar *name)
+{
+	fake_song_t *song = &server->songs[server->n_songs++];
+
+	song->id = id;
+	g_strlcpy (song->name, name, sizeof (song->name));
+	song->changed = server->revision;
+}
+
+static daap_server_t *
+daap_server_start (void)
+{
+	daap_server_t *server;
+	struct sockaddr_in addr;
+	socklen_t len = sizeof (addr);
+
+	server = g_new0 (daap_server_t, 1);
+	server->lock = g_mutex_new ();
+	server->revision = 1;
+	daap_server_add_song (server, 1, "one");
+	daap_server_add_song (server, 2, "two");
+	daap_server_add_song (server, 3, "three");
+
+	server->fd = socket (AF_INET, SOCK_STREAM, 0);
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+	bind (server->fd, (struct sockaddr *) &addr, sizeof (addr));
+	listen (server->fd, 8);
+	getsockname (server->fd, (struct sockaddr *) &addr, &len);
+	server->port = ntohs (addr.sin_port);
+
+	server->thread = g_thread_create (daap_server_thread, server, TRUE, NULL);
+
+	return server;
+}
+
+static void
+daap_server_stop (daap_server_t *server)
+{
+	g_atomic_int_set (&server->quit, 1);
+	g_thread_join (server->thread);
+	close (server->fd);
+	g_mutex_free (server->lock);
+	g_free (server);
+}
+
+/* revision 2: two is deleted, three renamed and four added */
+static void
+daap_server_change_library (daap_server_t *server)
+{
+	g_mutex_lock (server->lock);
+	server->revision = 2;
+	server->songs[1].deleted = 2;
+	g_strlcpy (server->songs[2].name, "THREE", sizeof (server->songs[2].name));
+	server->songs[2].changed = 2;
+	daap_server_add_song (server, 4, "four");
+	g_mutex_unlock (server->lock);
+}
+
+static void
+collect_song (cc_item_record_t *song, GString *str)
+{
+	g_string_append_printf (str, "%d:%s ", song->dbid, song->iname);
+}
+
+static gchar *
+songs_to_string (daap_songs_t *songs)
+{
+	GString *str = g_string_new ("");
+	daap_songs_foreach (songs, (GFunc) collect_song, str);
+	return g_string_free (str, FALSE);
+}
+
+static daap_songs_t *
+update_songs (daap_server_t *server, daap_songs_t *songs, guint revision)
+{
+	xmms_error_t err;
+
+	xmms_error_reset (&err);
+	CU_ASSERT_TRUE (daap_songs_update (songs, "127.0.0.1", server->port,
+	                                   SESSION_ID, revision, 1, DB_ID, &err));
+	CU_ASSERT_EQUAL (revision, daap_songs_revision (songs));
+
+	return songs;
+}
+
+SETUP (daap) {
+	g_thread_init (0);
+	signal (SIGPIPE, SIG_IGN);
+	daap_conn_pool_init ();
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+CASE (test_keep_alive)
+{
+	daap_server_t *server;
+	xmms_error_t err;
+	GSList *dbs, *songs;
+	gint total;
+
+	server = daap_server_start ();
+	xmms_error_reset (&err);
+
+	CU_ASSERT_EQUAL (SESSION_ID, daap_command_login ("127.0.0.1", server->port,
+	                                                 0, &err));
+	CU_ASSERT_EQUAL (1, daap_command_update ("127.0.0.1", server->port,
+	                                         SESSION_ID, 0));
+
+	dbs = daap_command_db_list ("127.0.0.1", server->port, SESSION_ID, 1, 0);
+	CU_ASSERT_EQUAL (1, g_slist_length (dbs));
+	CU_ASSERT_EQUAL (DB_ID, ((cc_item_record_t *) dbs->data)->dbid);
+	g_slist_foreach (dbs, (GFunc) cc_item_record_free, NULL);
+	g_slist_free (dbs);
+
+	songs = daap_command_song_list ("127.0.0.1", server->port, SESSION_ID, 1,
+	                                0, DB_ID, 0, &total, NULL, &err);
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	CU_ASSERT_EQUAL (3, total);
+	CU_ASSERT_EQUAL (3, g_slist_length (songs));
+	CU_ASSERT_STRING_EQUAL ("one", ((cc_item_record_t *) songs->data)->iname);
+	CU_ASSERT_STRING_EQUAL ("mp3", ((cc_item_record_t *) songs->data)->song_format);
+	g_slist_foreach (songs, (GFunc) cc_item_record_free, NULL);
+	g_slist_free (songs);
+
+	CU_ASSERT_TRUE (daap_command_logout ("127.0.0.1", server->port,
+	                                     SESSION_ID, 0));
+
+	CU_ASSERT_EQUAL (5, g_atomic_int_get (&server->requests));
+	CU_ASSERT_EQUAL (1, g_atomic_int_get (&server->connections));
+
+	daap_server_stop (server);
+}
+
+CASE (test_connection_close)
+{
+	daap_server_t *server;
+	gint i;
+
+	server = daap_server_start ();
+	server->close_each = TRUE;
+
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT_EQUAL (1, daap_command_update ("127.0.0.1", server->port,
+		                                         SESSION_ID, 0));
+	}
+
+	CU_ASSERT_EQUAL (3, g_atomic_int_get (&server->connections));
+
+	daap_server_stop (server);
+}
+
+CASE (test_stale_connection)
+{
+	daap_server_t *server;
+	gint i;
+
+	server = daap_server_start ();
+	server->drop_idle = TRUE;
+
+	/* every pooled connection is dead by the time it is used again */
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT_EQUAL (1, daap_command_update ("127.0.0.1", server->port,
+		                                         SESSION_ID, 0));
+	}
+
+	CU_ASSERT_EQUAL (3, g_atomic_int_get (&server->connections));
+
+	daap_server_stop (server);
+}
+
+CASE (test_stream)
+{
+	daap_server_t *server;
+	daap_conn_t *conn;
+	gchar buf[4096];
+	guint size = 0, done = 0;
+	gint n, i;
+	gboolean same = TRUE;
+
+	server = daap_server_start ();
+
+	conn = daap_command_init_stream ("127.0.0.1", server->port, SESSION_ID, 1,
+	                                 0, DB_ID, "/3.mp3", &size);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (conn);
+	CU_ASSERT_EQUAL (SONG_SIZE, size);
+
+	while ((n = daap_conn_read (conn, buf, sizeof (buf))) > 0) {
+		for (i = 0; i < n; i++) {
+			same = same && (guint8) buf[i] == song_byte (3, done + i);
+		}
+		done += n;
+	}
+	CU_ASSERT_EQUAL (0, n);
+	CU_ASSERT_EQUAL (SONG_SIZE, done);
+	CU_ASSERT_TRUE (same);
+
+	/* a stream read to the end leaves the connection usable */
+	daap_conn_release (conn);
+	CU_ASSERT_EQUAL (1, daap_command_update ("127.0.0.1", server->port,
+	                                         SESSION_ID, 0));
+	CU_ASSERT_EQUAL (1, g_atomic_int_get (&server->connections));
+
+	daap_server_stop (server);
+}
+
+CASE (test_song_list_delta)
+{
+	daap_server_t *server;
+	daap_songs_t *songs;
+	gchar *str;
+
+	server = daap_server_start ();
+	songs = daap_songs_new ();
+
+	update_songs (server, songs, 1);
+	str = songs_to_string (songs);
+	CU_ASSERT_STRING_EQUAL ("1:one 2:two 3:three ", str);
+	g_free (str);
+
+	/* nothing changed, nothing fetched */
+	update_songs (server, songs, 1);
+	CU_ASSERT_EQUAL (1, server->item_requests);
+
+	daap_server_change_library (server);
+	update_songs (server, songs, 2);
+
+	str = songs_to_string (songs);
+	CU_ASSERT_STRING_EQUAL ("1:one 3:THREE 4:four ", str);
+	g_free (str);
+
+	CU_ASSERT_EQUAL (2, server->item_requests);
+	CU_ASSERT_EQUAL (1, server->delta_requests);
+	CU_ASSERT_EQUAL (2, server->items_sent);
+
+	daap_songs_free (songs);
+	daap_server_stop (server);
+}
+
+CASE (test_song_list_delta_ignored)
+{
+	daap_server_t *server;
+	daap_songs_t *songs;
+	gchar *str;
+
+	server = daap_server_start ();
+	server->ignore_delta = TRUE;
+	songs = daap_songs_new ();
+
+	update_songs (server, songs, 1);
+
+	/* the full list comes back without the deletion, so start over */
+	daap_server_change_library (server);
+	update_songs (server, songs, 2);
+
+	str = songs_to_string (songs);
+	CU_ASSERT_STRING_EQUAL ("1:one 3:THREE 4:four ", str);
+	g_free (str);
+
+	CU_ASSERT_EQUAL (3, daap_songs_length (songs));
+	CU_ASSERT_EQUAL (3, server->item_requests);
+
+	daap_songs_free (songs);
+	daap_server_stop (server);
+}
@@ -0,0 +1,238 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "eq_iir.h"
+
+#define SRATE 44100
+#define FRAMES 8192
+#define MAX_CHANNELS 6
+
+static const gint bands[] = { 10, 15, 25, 31 };
+static const gint channels[] = { 1, 2, 6 };
+
+/* not multiples of the block size, so blocks get split up in all
+ * kinds of places */
+static const gint chunks[] = { 1, 100, 333, 1024, 7, 4096 };
+
+static gint16 *input;
+
+static void
+fill_noise (gint16 *buf, gint count)
+{
+	guint32 x = 1;
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = (gint16) ((x >> 16) & 0x3fff) - 0x2000;
+	}
+}
+
+static void
+fill_sine (gint16 *buf, gint frames, gdouble freq, gdouble amplitude)
+{
+	gint i;
+
+	for (i = 0; i < frames; i++) {
+		buf[i] = amplitude * sin (2 * M_PI * freq * i / SRATE);
+	}
+}
+
+static void
+gains_set (xmms_eq_iir_t *iir, gdouble scale)
+{
+	gint i;
+
+	for (i = 0; i < EQ_MAX_BANDS; i++) {
+		xmms_eq_iir_gain_set (iir, i, scale * sin (i + 1));
+	}
+}
+
+/* Equalize the input in uneven pieces, changing the gains and
+ * the bands halfway through */
+static void
+run (xmms_eq_iir_t *iir, gint16 *buf, gint nch, gint nbands,
+     gboolean extra_filtering)
+{
+	gint done, n, i;
+
+	xmms_eq_iir_bands_set (iir, nbands, FALSE);
+	xmms_eq_iir_preamp_set (iir, 1.2);
+	gains_set (iir, 0.3);
+
+	for (done = 0, i = 0; done < FRAMES; done += n, i++) {
+		n = MIN (chunks[i % G_N_ELEMENTS (chunks)], FRAMES - done);
+
+		if (done > FRAMES / 2 && i % 3 == 0) {
+			gains_set (iir, -0.2 * i);
+			xmms_eq_iir_bands_set (iir, bands[i % G_N_ELEMENTS (bands)],
+			                       FALSE);
+		}
+
+		xmms_eq_iir_process (iir, buf + done * nch, n, extra_filtering);
+	}
+}
+
+/* The largest difference between neighbouring samples */
+static gint
+max_step (const gint16 *buf, gint start, gint end)
+{
+	gint i, step = 0;
+
+	for (i = MAX (start, 1); i < end; i++) {
+		step = MAX (step, ABS (buf[i] - buf[i - 1]));
+	}
+
+	return step;
+}
+
+SETUP (eq_iir) {
+	g_thread_init (0);
+
+	input = g_new (gint16, FRAMES * MAX_CHANNELS);
+	fill_noise (input, FRAMES * MAX_CHANNELS);
+	return 0;
+}
+
+CLEANUP () {
+	g_free (input);
+	return 0;
+}
+
+CASE (test_impls_match)
+{
+	gint16 *expected, *actual;
+	xmms_eq_iir_t *iir;
+	gint b, c, extra, impl, i, count;
+
+	expected = g_new (gint16, FRAMES * MAX_CHANNELS);
+	actual = g_new (gint16, FRAMES * MAX_CHANNELS);
+
+	for (b = 0; b < G_N_ELEMENTS (bands); b++) {
+		for (c = 0; c < G_N_ELEMENTS (channels); c++) {
+			for (extra = 0; extra < 2; extra++) {
+				count = FRAMES * channels[c];
+
+				iir = xmms_eq_iir_new (SRATE, channels[c],
+				                       XMMS_EQ_IIR_IMPL_SCALAR);
+				CU_ASSERT_PTR_NOT_NULL_FATAL (iir);
+				memcpy (expected, input, count * sizeof (gint16));
+				run (iir, expected, channels[c], bands[b], extra);
+				xmms_eq_iir_free (iir);
+
+				for (impl = 1; impl < XMMS_EQ_IIR_IMPL_COUNT; impl++) {
+					iir = xmms_eq_iir_new (SRATE, channels[c], impl);
+					if (!iir) {
+						continue;
+					}
+
+					memcpy (actual, input, count * sizeof (gint16));
+					run (iir, actual, channels[c], bands[b], extra);
+					xmms_eq_iir_free (iir);
+
+					/* the bands are summed up in another order */
+					for (i = 0; i < count; i++) {
+						if (ABS (expected[i] - actual[i]) > 1) {
+							break;
+						}
+					}
+					CU_ASSERT_EQUAL (i, count);
+				}
+			}
+		}
+	}
+
+	g_free (expected);
+	g_free (actual);
+}
+
+CASE (test_gain_ramp)
+{
+	gint16 buf[FRAMES];
+	xmms_eq_iir_t *iir;
+	gint steady;
+
+	iir = xmms_eq_iir_new (SRATE, 1, xmms_eq_iir_impl_best ());
+	CU_ASSERT_PTR_NOT_NULL_FATAL (iir);
+
+	fill_sine (buf, FRAMES, 200.0, 8000.0);
+
+	gains_set (iir, 0.1);
+	xmms_eq_iir_process (iir, buf, FRAMES / 2, FALSE);
+
+	xmms_eq_iir_preamp_set (iir, 3.0);
+	gains_set (iir, 0.4);
+	xmms_eq_iir_process (iir, buf + FRAMES / 2, FRAMES / 2, FALSE);
+
+	/* louder afterwards, but no jump on the way there */
+	steady = max_step (buf, FRAMES / 4, FRAMES / 2);
+	CU_ASSERT (max_step (buf, FRAMES / 2 - 1, FRAMES / 2 + 1024) <=
+	           max_step (buf, FRAMES - 1024, FRAMES) + 1);
+	CU_ASSERT (max_step (buf, FRAMES - 1024, FRAMES) > 2 * steady);
+
+	xmms_eq_iir_free (iir);
+}
+
+CASE (test_bands_crossfade)
+{
+	gint16 buf[FRAMES];
+	xmms_eq_iir_t *iir;
+	gint steady;
+
+	iir = xmms_eq_iir_new (SRATE, 1, xmms_eq_iir_impl_best ());
+	CU_ASSERT_PTR_NOT_NULL_FATAL (iir);
+
+	fill_sine (buf, FRAMES, 200.0, 8000.0);
+
+	gains_set (iir, 0.4);
+	xmms_eq_iir_process (iir, buf, FRAMES / 2, FALSE);
+	steady = max_step (buf, FRAMES / 4, FRAMES / 2);
+
+	/* the new filters start out silent, which would be heard as a
+	 * click without the fade */
+	CU_ASSERT_EQUAL (xmms_eq_iir_bands_set (iir, 31, FALSE), 31);
+	xmms_eq_iir_process (iir, buf + FRAMES / 2, FRAMES / 2, FALSE);
+
+	CU_ASSERT (max_step (buf, FRAMES / 2 - 1, FRAMES) < 2 * steady);
+
+	xmms_eq_iir_free (iir);
+}
+
+CASE (test_bands_fallback)
+{
+	xmms_eq_iir_t *iir;
+
+	iir = xmms_eq_iir_new (22050, 2, XMMS_EQ_IIR_IMPL_SCALAR);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (iir);
+	CU_ASSERT_EQUAL (xmms_eq_iir_bands_set (iir, 31, FALSE), 10);
+	xmms_eq_iir_free (iir);
+
+	iir = xmms_eq_iir_new (SRATE, 2, XMMS_EQ_IIR_IMPL_SCALAR);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (iir);
+	CU_ASSERT_EQUAL (xmms_eq_iir_bands_set (iir, 25, FALSE), 25);
+	CU_ASSERT_EQUAL (xmms_eq_iir_bands_set (iir, 20, FALSE), 10);
+	xmms_eq_iir_free (iir);
+
+	CU_ASSERT_PTR_NULL (xmms_eq_iir_new (SRATE, 2, XMMS_EQ_IIR_IMPL_COUNT));
+	CU_ASSERT_PTR_NULL (xmms_eq_iir_func (XMMS_EQ_IIR_IMPL_COUNT));
+}
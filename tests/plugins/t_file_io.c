@@ -0,0 +1,211 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "file_io.h"
+
+#define FILE_SIZE (300 * 1024 + 123)
+
+static gchar *filename;
+static guchar *contents;
+
+/* Read len bytes at the current position of io and compare them */
+static void
+assert_read (xmms_file_io_t *io, gint64 offset, gint len)
+{
+	guchar buf[8192];
+	gint ret, n;
+
+	while (len > 0) {
+		n = MIN (len, sizeof (buf));
+		ret = xmms_file_io_read (io, buf, n);
+		CU_ASSERT_FATAL (ret > 0);
+		CU_ASSERT (memcmp (buf, contents + offset, ret) == 0);
+		offset += ret;
+		len -= ret;
+	}
+}
+
+/* Jump around the file like a tag reader followed by a decoder */
+static void
+check_access (const xmms_file_io_options_t *options)
+{
+	xmms_file_io_t *io;
+	guchar buf[4096];
+	gint64 offset;
+	gint i, ret;
+
+	io = xmms_file_io_open (filename, options);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (io);
+	CU_ASSERT_EQUAL (xmms_file_io_size (io), FILE_SIZE);
+
+	assert_read (io, 0, 10);
+	assert_read (io, 10, 5000);
+
+	CU_ASSERT_EQUAL (xmms_file_io_seek (io, -128, XMMS_FILE_IO_SEEK_END),
+	                 FILE_SIZE - 128);
+	assert_read (io, FILE_SIZE - 128, 128);
+	CU_ASSERT_EQUAL (xmms_file_io_read (io, buf, sizeof (buf)), 0);
+
+	CU_ASSERT_EQUAL (xmms_file_io_seek (io, 0, XMMS_FILE_IO_SEEK_SET), 0);
+	assert_read (io, 0, FILE_SIZE);
+	CU_ASSERT_EQUAL (xmms_file_io_read (io, buf, sizeof (buf)), 0);
+
+	/* across the end of the mapped header and back */
+	CU_ASSERT_EQUAL (xmms_file_io_seek (io, 4000, XMMS_FILE_IO_SEEK_SET), 4000);
+	assert_read (io, 4000, 200);
+	CU_ASSERT_EQUAL (xmms_file_io_seek (io, 100000, XMMS_FILE_IO_SEEK_CUR),
+	                 104200);
+	assert_read (io, 104200, 70000);
+	CU_ASSERT_EQUAL (xmms_file_io_seek (io, -150000, XMMS_FILE_IO_SEEK_CUR),
+	                 24200);
+	assert_read (io, 24200, 1000);
+
+	for (i = 0; i < 200; i++) {
+		offset = g_random_int_range (0, FILE_SIZE);
+		xmms_file_io_seek (io, offset, XMMS_FILE_IO_SEEK_SET);
+		ret = xmms_file_io_read (io, buf, g_random_int_range (1, sizeof (buf)));
+		CU_ASSERT_FATAL (ret > 0);
+		CU_ASSERT (memcmp (buf, contents + offset, ret) == 0);
+	}
+
+	CU_ASSERT_EQUAL (xmms_file_io_seek (io, -1, XMMS_FILE_IO_SEEK_SET), -1);
+
+	xmms_file_io_close (io);
+}
+
+SETUP (file_io) {
+	gint fd, i;
+
+	contents = g_malloc (FILE_SIZE);
+	for (i = 0; i < FILE_SIZE; i++) {
+		contents[i] = (i * 13 + i / 509) & 0xff;
+	}
+
+	fd = g_file_open_tmp ("xmms2-file-io-XXXXXX", &filename, NULL);
+	if (fd < 0) {
+		return 1;
+	}
+
+	if (write (fd, contents, FILE_SIZE) != FILE_SIZE) {
+		close (fd);
+		return 1;
+	}
+	close (fd);
+
+	return 0;
+}
+
+CLEANUP () {
+	unlink (filename);
+	g_free (filename);
+	g_free (contents);
+	return 0;
+}
+
+CASE (test_pread)
+{
+	xmms_file_io_options_t options = { FALSE, 0, 0, 0 };
+
+	check_access (&options);
+}
+
+CASE (test_mmap_whole)
+{
+	xmms_file_io_options_t options = { TRUE, FILE_SIZE, 0, 0 };
+	xmms_file_io_t *io;
+	guint syscalls;
+
+	check_access (&options);
+
+	/* nothing but memcpy after opening */
+	io = xmms_file_io_open (filename, &options);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (io);
+	syscalls = xmms_file_io_syscalls (io);
+	assert_read (io, 0, FILE_SIZE);
+	xmms_file_io_seek (io, 1000, XMMS_FILE_IO_SEEK_SET);
+	assert_read (io, 1000, 1000);
+	CU_ASSERT_EQUAL (xmms_file_io_syscalls (io), syscalls);
+	xmms_file_io_close (io);
+}
+
+CASE (test_mmap_header)
+{
+	xmms_file_io_options_t options = { TRUE, FILE_SIZE - 1, 4096, 0 };
+
+	check_access (&options);
+}
+
+CASE (test_truncated)
+{
+	xmms_file_io_options_t options = { TRUE, 0, 0, 0 };
+	xmms_file_io_t *io;
+	guchar buf[8192];
+	gchar *name;
+	gint fd;
+
+	fd = g_file_open_tmp ("xmms2-file-io-XXXXXX", &name, NULL);
+	CU_ASSERT_FATAL (fd >= 0);
+	CU_ASSERT_FATAL (write (fd, contents, FILE_SIZE) == FILE_SIZE);
+
+	io = xmms_file_io_open (name, &options);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (io);
+
+	/* another program cuts the file short while it is open, which
+	 * would raise SIGBUS on a mapping */
+	CU_ASSERT_FATAL (ftruncate (fd, 1000) == 0);
+	close (fd);
+
+	CU_ASSERT_EQUAL (xmms_file_io_read (io, buf, sizeof (buf)), 1000);
+	CU_ASSERT (memcmp (buf, contents, 1000) == 0);
+	CU_ASSERT_EQUAL (xmms_file_io_read (io, buf, sizeof (buf)), 0);
+
+	xmms_file_io_close (io);
+	unlink (name);
+	g_free (name);
+}
+
+CASE (test_uring)
+{
+#ifdef HAVE_LIBURING
+	xmms_file_io_options_t options = { TRUE, 0, 4096, 4 };
+	xmms_file_io_t *io;
+
+	io = xmms_file_io_open (filename, &options);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (io);
+	CU_ASSERT_TRUE (xmms_file_io_uses_uring (io));
+	xmms_file_io_close (io);
+
+	check_access (&options);
+#else
+	printf ("\n    test_uring skipped, built without io_uring\n");
+#endif
+}
+
+CASE (test_not_regular)
+{
+	xmms_file_io_options_t options = { TRUE, FILE_SIZE, 4096, 4 };
+
+	CU_ASSERT_PTR_NULL (xmms_file_io_open ("/", &options));
+	CU_ASSERT_PTR_NULL (xmms_file_io_open ("/nonexistent/file", &options));
+}
@@ -0,0 +1,219 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "rg_gain.h"
+
+/* not a multiple of any vector size, to get a tail */
+#define COUNT 1003
+
+static const xmms_sample_format_t formats[] = {
+	XMMS_SAMPLE_FORMAT_S8,
+	XMMS_SAMPLE_FORMAT_U8,
+	XMMS_SAMPLE_FORMAT_S16,
+	XMMS_SAMPLE_FORMAT_U16,
+	XMMS_SAMPLE_FORMAT_S32,
+	XMMS_SAMPLE_FORMAT_U32,
+	XMMS_SAMPLE_FORMAT_FLOAT,
+	XMMS_SAMPLE_FORMAT_DOUBLE,
+};
+
+/* below 1, above 1 and enough to clip about everything */
+static const gfloat gains[] = { 0.3, 1.7, 15.0 };
+
+static guint8 *input;
+static gfloat *noise;
+
+static void
+fill_input (xmms_sample_format_t format, guint8 *buf, gint count)
+{
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		guint32 r = g_random_int ();
+
+		switch (format) {
+			case XMMS_SAMPLE_FORMAT_FLOAT:
+				((gfloat *) buf)[i] = g_random_double_range (-1.0, 1.0);
+				break;
+			case XMMS_SAMPLE_FORMAT_DOUBLE:
+				((gdouble *) buf)[i] = g_random_double_range (-1.0, 1.0);
+				break;
+			default:
+				memcpy (buf + i * xmms_sample_size_get (format), &r,
+				        xmms_sample_size_get (format));
+				break;
+		}
+	}
+}
+
+/* Run every implementation against the scalar one, starting at
+ * offset samples into the buffer so they don't all get aligned data */
+static void
+check_format (xmms_sample_format_t format, gint offset, gboolean dither)
+{
+	xmms_rg_gain_func_t reference, func;
+	gint size, bytes, impl, i;
+	guint8 *expected, *actual;
+	const gfloat *n = NULL;
+
+	size = xmms_sample_size_get (format);
+	bytes = COUNT * size;
+
+	reference = xmms_rg_gain_func (format, XMMS_RG_GAIN_IMPL_SCALAR);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (reference);
+
+	fill_input (format, input, COUNT);
+
+	if (dither) {
+		n = noise + offset;
+	}
+
+	expected = g_malloc (bytes);
+	actual = g_malloc (bytes + size);
+
+	for (i = 0; i < G_N_ELEMENTS (gains); i++) {
+		memcpy (expected, input + offset * size, bytes - offset * size);
+		reference (expected, COUNT - offset, gains[i], n);
+
+		for (impl = 0; impl < XMMS_RG_GAIN_IMPL_COUNT; impl++) {
+			func = xmms_rg_gain_func (format, impl);
+			if (!func) {
+				continue;
+			}
+
+			/* one byte in, to check unaligned access too */
+			memcpy (actual + 1, input + offset * size, bytes - offset * size);
+			func (actual + 1, COUNT - offset, gains[i], n);
+
+			CU_ASSERT (memcmp (expected, actual + 1,
+			                   bytes - offset * size) == 0);
+		}
+	}
+
+	g_free (expected);
+	g_free (actual);
+}
+
+SETUP (rg_gain) {
+	guint32 state = 1;
+
+	input = g_malloc (COUNT * sizeof (gdouble));
+	noise = g_new (gfloat, COUNT);
+	xmms_rg_gain_dither (&state, noise, COUNT);
+
+	return 0;
+}
+
+CLEANUP () {
+	g_free (input);
+	g_free (noise);
+	return 0;
+}
+
+CASE (test_bit_exact)
+{
+	gint i, offset;
+
+	for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+		for (offset = 0; offset < 9; offset++) {
+			check_format (formats[i], offset, FALSE);
+			check_format (formats[i], offset, TRUE);
+		}
+	}
+}
+
+CASE (test_saturation)
+{
+	gint16 s16[] = { 32767, -32768, 1000, -1000, 3, 0, -3, 20000, -20000 };
+	guint8 u8[] = { 255, 0, 128, 200, 50, 1, 254, 129, 127 };
+	gint32 s32[] = { G_MAXINT32, G_MININT32, 1, -1, 0, 1 << 30, -(1 << 30),
+	                 100, -100 };
+	gint impl;
+
+	for (impl = 0; impl < XMMS_RG_GAIN_IMPL_COUNT; impl++) {
+		gint16 s[G_N_ELEMENTS (s16)];
+		guint8 u[G_N_ELEMENTS (u8)];
+		gint32 l[G_N_ELEMENTS (s32)];
+
+		if (!xmms_rg_gain_func (XMMS_SAMPLE_FORMAT_S16, impl)) {
+			continue;
+		}
+
+		memcpy (s, s16, sizeof (s));
+		xmms_rg_gain_func (XMMS_SAMPLE_FORMAT_S16, impl) (s, G_N_ELEMENTS (s),
+		                                                   15.0, NULL);
+		CU_ASSERT_EQUAL (s[0], G_MAXINT16);
+		CU_ASSERT_EQUAL (s[1], G_MININT16);
+		CU_ASSERT_EQUAL (s[2], 15000);
+		CU_ASSERT_EQUAL (s[3], -15000);
+		CU_ASSERT_EQUAL (s[7], G_MAXINT16);
+		CU_ASSERT_EQUAL (s[8], G_MININT16);
+
+		/* unsigned formats clip at 0, not at their middle */
+		memcpy (u, u8, sizeof (u));
+		xmms_rg_gain_func (XMMS_SAMPLE_FORMAT_U8, impl) (u, G_N_ELEMENTS (u),
+		                                                  2.0, NULL);
+		CU_ASSERT_EQUAL (u[0], 255);
+		CU_ASSERT_EQUAL (u[1], 0);
+		CU_ASSERT_EQUAL (u[3], 255);
+		CU_ASSERT_EQUAL (u[4], 100);
+
+		memcpy (l, s32, sizeof (l));
+		xmms_rg_gain_func (XMMS_SAMPLE_FORMAT_S32, impl) (l, G_N_ELEMENTS (l),
+		                                                  4.0, NULL);
+		CU_ASSERT_EQUAL (l[0], G_MAXINT32);
+		CU_ASSERT_EQUAL (l[1], G_MININT32);
+		CU_ASSERT_EQUAL (l[2], 4);
+		CU_ASSERT_EQUAL (l[5], G_MAXINT32);
+		CU_ASSERT_EQUAL (l[6], G_MININT32);
+		CU_ASSERT_EQUAL (l[7], 400);
+	}
+}
+
+CASE (test_dither)
+{
+	gfloat buf[4096];
+	gdouble sum = 0.0;
+	guint32 state = 12345;
+	gint i;
+
+	xmms_rg_gain_dither (&state, buf, G_N_ELEMENTS (buf));
+	CU_ASSERT_NOT_EQUAL (state, 0);
+
+	for (i = 0; i < G_N_ELEMENTS (buf); i++) {
+		CU_ASSERT (buf[i] > -1.0 && buf[i] < 1.0);
+		sum += buf[i];
+	}
+
+	/* triangular around 0, so the mean is close to it */
+	CU_ASSERT (ABS (sum / G_N_ELEMENTS (buf)) < 0.05);
+}
+
+CASE (test_unknown)
+{
+	CU_ASSERT_PTR_NULL (xmms_rg_gain_func (XMMS_SAMPLE_FORMAT_UNKNOWN,
+	                                       XMMS_RG_GAIN_IMPL_SCALAR));
+	CU_ASSERT_PTR_NULL (xmms_rg_gain_func (XMMS_SAMPLE_FORMAT_S16,
+	                                       XMMS_RG_GAIN_IMPL_COUNT));
+	CU_ASSERT_PTR_NOT_NULL (xmms_rg_gain_func (XMMS_SAMPLE_FORMAT_S16,
+	                                           xmms_rg_gain_impl_best ()));
+}
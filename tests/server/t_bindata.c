@@ -0,0 +1,318 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "core_fixture.h"
+
+#include "xmmsc/xmmsc_idnumbers.h"
+#include "xmmsc/xmmsv.h"
+#include "xmmspriv/xmms_bindata.h"
+#include "xmmspriv/xmms_config.h"
+
+#define BLOB_SIZE 1024
+
+static xmms_bindata_t *bindata;
+
+/* Add a blob, the hash it's stored under goes to hash */
+static gboolean
+add (const guchar *data, gsize len, gchar hash[33])
+{
+	xmmsv_t *args, *bin, *ret = NULL;
+	const gchar *s;
+	gboolean ok;
+
+	args = xmmsv_new_list ();
+	bin = xmmsv_new_bin (data, len);
+	xmmsv_list_append (args, bin);
+	xmmsv_unref (bin);
+
+	ok = core_fixture_call (bindata, XMMS_IPC_CMD_ADD_DATA, args, &ret) &&
+	     xmmsv_get_string (ret, &s) && strlen (s) == 32;
+	if (ok) {
+		g_strlcpy (hash, s, 33);
+	}
+	if (ret) {
+		xmmsv_unref (ret);
+	}
+
+	return ok;
+}
+
+/* Whether the blob is there and holds len bytes of data */
+static gboolean
+has (const gchar *hash, const guchar *data, gsize len)
+{
+	xmmsv_t *args, *ret = NULL;
+	const guchar *got;
+	guint got_len;
+	gboolean ok;
+
+	args = xmmsv_new_list ();
+	xmmsv_list_append_string (args, hash);
+
+	ok = core_fixture_call (bindata, XMMS_IPC_CMD_GET_DATA, args, &ret) &&
+	     xmmsv_get_bin (ret, &got, &got_len) && got_len == len &&
+	     (!len || !memcmp (got, data, len));
+	if (ret) {
+		xmmsv_unref (ret);
+	}
+
+	return ok;
+}
+
+static gboolean
+remove_data (const gchar *hash)
+{
+	xmmsv_t *args;
+
+	args = xmmsv_new_list ();
+	xmmsv_list_append_string (args, hash);
+
+	return core_fixture_call (bindata, XMMS_IPC_CMD_REMOVE_DATA, args, NULL);
+}
+
+/* One of the cache statistics, or -1 */
+static gint
+cache_stat (const gchar *key)
+{
+	xmmsv_t *ret = NULL;
+	gint32 value = -1;
+
+	if (core_fixture_call (bindata, XMMS_IPC_CMD_STATS_DATA,
+	                       xmmsv_new_list (), &ret)) {
+		xmmsv_dict_entry_get_int (ret, key, &value);
+	}
+	if (ret) {
+		xmmsv_unref (ret);
+	}
+
+	return value;
+}
+
+static void
+set_cachesize (gint size)
+{
+	xmms_config_property_t *prop;
+	gchar value[16];
+
+	prop = xmms_config_lookup ("bindata.cachesize");
+	g_snprintf (value, sizeof (value), "%d", size);
+	xmms_config_property_set_data (prop, value);
+}
+
+/* Where the blob is stored */
+static gchar *
+blob_path (const gchar *hash)
+{
+	xmms_config_property_t *prop;
+	gchar shard[3];
+
+	prop = xmms_config_lookup ("bindata.path");
+	g_strlcpy (shard, hash, sizeof (shard));
+
+	return g_build_filename (xmms_config_property_get_string (prop),
+	                         shard, hash, NULL);
+}
+
+static void
+fill_blob (guchar *data, gsize len, gint seed)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++) {
+		data[i] = (seed * 31 + i * 7) & 0xff;
+	}
+}
+
+SETUP (bindata) {
+	if (!core_fixture_init ()) {
+		core_fixture_fini ();
+		return 1;
+	}
+
+	bindata = xmms_bindata_init ();
+
+	return 0;
+}
+
+CLEANUP () {
+	xmms_object_unref (bindata);
+	bindata = NULL;
+	core_fixture_fini ();
+	return 0;
+}
+
+CASE (test_round_trip)
+{
+	const guchar data[] = "some cover art";
+	gchar hash[33], md5[33];
+	gchar *path;
+
+	CU_ASSERT_TRUE_FATAL (add (data, sizeof (data), hash));
+
+	xmms_bindata_calculate_md5 (data, sizeof (data), md5);
+	CU_ASSERT_STRING_EQUAL (hash, md5);
+
+	path = blob_path (hash);
+	CU_ASSERT_TRUE (g_file_test (path, G_FILE_TEST_IS_REGULAR));
+
+	/* the first one reads the file, the second one the cache */
+	CU_ASSERT_TRUE (has (hash, data, sizeof (data)));
+	CU_ASSERT_TRUE (has (hash, data, sizeof (data)));
+
+	/* adding it again is fine, and keeps it */
+	CU_ASSERT_TRUE (add (data, sizeof (data), hash));
+	CU_ASSERT_STRING_EQUAL (hash, md5);
+	CU_ASSERT_TRUE (has (hash, data, sizeof (data)));
+
+	/* it's gone after removing it, also from the cache */
+	CU_ASSERT_TRUE (remove_data (hash));
+	CU_ASSERT_FALSE (g_file_test (path, G_FILE_TEST_EXISTS));
+	CU_ASSERT_FALSE (has (hash, data, sizeof (data)));
+	CU_ASSERT_FALSE (remove_data (hash));
+
+	g_free (path);
+
+	CU_ASSERT_FALSE (has ("not a hash", NULL, 0));
+	CU_ASSERT_FALSE (remove_data ("../../xmms2.conf"));
+}
+
+CASE (test_empty_blob)
+{
+	gchar hash[33];
+
+	CU_ASSERT_TRUE_FATAL (add ((const guchar *) "", 0, hash));
+	CU_ASSERT_STRING_EQUAL (hash, "d41d8cd98f00b204e9800998ecf8427e");
+
+	CU_ASSERT_TRUE (has (hash, NULL, 0));
+	CU_ASSERT_TRUE (has (hash, NULL, 0));
+
+	CU_ASSERT_TRUE (remove_data (hash));
+	CU_ASSERT_FALSE (has (hash, NULL, 0));
+}
+
+CASE (test_lru_eviction)
+{
+	guchar data[4][BLOB_SIZE];
+	gchar hash[4][33];
+	gint i, hits, misses, evictions;
+
+	set_cachesize (3 * BLOB_SIZE);
+
+	for (i = 0; i < 4; i++) {
+		fill_blob (data[i], BLOB_SIZE, i + 1);
+		CU_ASSERT_TRUE_FATAL (add (data[i], BLOB_SIZE, hash[i]));
+	}
+
+	hits = cache_stat ("hits");
+	misses = cache_stat ("misses");
+	evictions = cache_stat ("evictions");
+
+	/* the fourth one pushes out the first */
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT_TRUE (has (hash[i], data[i], BLOB_SIZE));
+	}
+	CU_ASSERT_EQUAL (cache_stat ("misses"), misses + 4);
+	CU_ASSERT_EQUAL (cache_stat ("evictions"), evictions + 1);
+	CU_ASSERT_EQUAL (cache_stat ("entries"), 3);
+	CU_ASSERT_EQUAL (cache_stat ("size"), 3 * BLOB_SIZE);
+
+	/* [3, 2, 1] -> [3, 2, 1] */
+	CU_ASSERT_TRUE (has (hash[3], data[3], BLOB_SIZE));
+	CU_ASSERT_EQUAL (cache_stat ("hits"), hits + 1);
+
+	/* the least recently used one goes, [3, 2, 1] -> [0, 3, 2] */
+	CU_ASSERT_TRUE (has (hash[0], data[0], BLOB_SIZE));
+	CU_ASSERT_EQUAL (cache_stat ("misses"), misses + 5);
+	CU_ASSERT_EQUAL (cache_stat ("evictions"), evictions + 2);
+
+	CU_ASSERT_TRUE (has (hash[2], data[2], BLOB_SIZE));
+	CU_ASSERT_EQUAL (cache_stat ("hits"), hits + 2);
+	CU_ASSERT_TRUE (has (hash[1], data[1], BLOB_SIZE));
+	CU_ASSERT_EQUAL (cache_stat ("misses"), misses + 6);
+
+	/* shrinking the cache drops what no longer fits right away */
+	set_cachesize (BLOB_SIZE);
+	CU_ASSERT_EQUAL (cache_stat ("entries"), 1);
+	CU_ASSERT_EQUAL (cache_stat ("size"), BLOB_SIZE);
+	CU_ASSERT_EQUAL (cache_stat ("capacity"), BLOB_SIZE);
+
+	/* and what's too big for it is still handed out */
+	set_cachesize (BLOB_SIZE / 2);
+	CU_ASSERT_EQUAL (cache_stat ("entries"), 0);
+	CU_ASSERT_TRUE (has (hash[1], data[1], BLOB_SIZE));
+	CU_ASSERT_EQUAL (cache_stat ("entries"), 0);
+
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT_TRUE (remove_data (hash[i]));
+	}
+
+	set_cachesize (8 * 1024 * 1024);
+}
+
+CASE (test_same_shard)
+{
+	gchar hashes[256][33];
+	guchar data[2][BLOB_SIZE];
+	gchar hash[2][33];
+	gchar *path[2];
+	gint i, j, found = -1;
+
+	/* find two blobs that go in the same directory */
+	for (i = 0; found < 0 && i < G_N_ELEMENTS (hashes); i++) {
+		fill_blob (data[0], BLOB_SIZE, 100 + i);
+		xmms_bindata_calculate_md5 (data[0], BLOB_SIZE, hashes[i]);
+		for (j = 0; j < i; j++) {
+			if (!strncmp (hashes[i], hashes[j], 2)) {
+				found = j;
+				break;
+			}
+		}
+	}
+	CU_ASSERT_FATAL (found >= 0);
+
+	fill_blob (data[0], BLOB_SIZE, 100 + found);
+	fill_blob (data[1], BLOB_SIZE, 100 + i - 1);
+
+	for (i = 0; i < 2; i++) {
+		CU_ASSERT_TRUE_FATAL (add (data[i], BLOB_SIZE, hash[i]));
+		path[i] = blob_path (hash[i]);
+	}
+	CU_ASSERT_NOT_EQUAL (strcmp (hash[0], hash[1]), 0);
+	CU_ASSERT_EQUAL (strncmp (hash[0], hash[1], 2), 0);
+
+	for (i = 0; i < 2; i++) {
+		CU_ASSERT_TRUE (g_file_test (path[i], G_FILE_TEST_IS_REGULAR));
+		CU_ASSERT_TRUE (has (hash[i], data[i], BLOB_SIZE));
+	}
+
+	/* removing one leaves the other alone */
+	CU_ASSERT_TRUE (remove_data (hash[0]));
+	CU_ASSERT_FALSE (has (hash[0], data[0], BLOB_SIZE));
+	CU_ASSERT_TRUE (g_file_test (path[1], G_FILE_TEST_IS_REGULAR));
+	CU_ASSERT_TRUE (has (hash[1], data[1], BLOB_SIZE));
+
+	CU_ASSERT_TRUE (remove_data (hash[1]));
+	CU_ASSERT_FALSE (has (hash[1], data[1], BLOB_SIZE));
+
+	for (i = 0; i < 2; i++) {
+		g_free (path[i]);
+	}
+}
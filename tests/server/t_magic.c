@@ -0,0 +1,210 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "xmmspriv/xmms_magic.h"
+
+typedef struct {
+	const gchar *data;
+	guint len;
+} memory_t;
+
+static xmms_magic_set_t *set;
+
+static gint
+memory_read (gpointer udata, gchar *buf, guint len)
+{
+	memory_t *mem = udata;
+
+	len = MIN (len, mem->len);
+	memcpy (buf, mem->data, len);
+
+	return len;
+}
+
+static const gchar *
+match (const gchar *data, guint len, gboolean linear)
+{
+	xmms_magic_checker_t c;
+	memory_t mem = { data, len };
+	const gchar *ret;
+
+	xmms_magic_checker_init (&c, memory_read, &mem);
+	if (linear) {
+		ret = xmms_magic_set_match_linear (set, &c, NULL);
+	} else {
+		ret = xmms_magic_set_match (set, &c, NULL);
+	}
+	xmms_magic_checker_clear (&c);
+
+	return ret;
+}
+
+static void
+assert_same (const gchar *data, guint len)
+{
+	const gchar *a, *b;
+
+	a = match (data, len, FALSE);
+	b = match (data, len, TRUE);
+
+	CU_ASSERT_PTR_EQUAL (a, b);
+}
+
+SETUP (magic) {
+	g_thread_init (0);
+
+	/* a representative selection of the specs shipped with the plugins */
+	set = xmms_magic_set_new ();
+	xmms_magic_set_add (set, "asf header", "video/x-ms-asf",
+	                    "0 belong 0x3026b275", NULL);
+	xmms_magic_set_add (set, "mpeg aac header", "audio/aac",
+	                    "0 beshort&0xfff6 0xfff0", NULL);
+	xmms_magic_set_add (set, "flac header", "audio/x-flac",
+	                    "0 string fLaC", NULL);
+	xmms_magic_set_add (set, "html tag", "text/html",
+	                    "0 string/c <html ", NULL);
+	xmms_magic_set_add (set, "mpeg header", "audio/mpeg",
+	                    "0 beshort&0xfff6 0xfff6",
+	                    "0 beshort&0xfff6 0xfff4",
+	                    "0 beshort&0xffe6 0xffe2", NULL);
+	xmms_magic_set_add (set, "mpeg-4 header", "video/mp4",
+	                    "4 string ftyp", ">8 string isom",
+	                    ">8 string mp42", NULL);
+	xmms_magic_set_add (set, "iTunes header", "audio/mp4",
+	                    "4 string ftyp", ">8 string M4A ", NULL);
+	xmms_magic_set_add (set, "ScreamTracker III module", "audio/s3m",
+	                    "44 string SCRM", NULL);
+	xmms_magic_set_add (set, "4-channel Protracker module", "audio/mod",
+	                    "1080 string M.K.", NULL);
+	xmms_magic_set_add (set, "id3 header", "application/id3v2",
+	                    "0 string ID3", ">3 byte <0xff",
+	                    ">>4 byte <0xff", NULL);
+	xmms_magic_set_add (set, "NUL padded", "application/x-nul-padded",
+	                    "0 byte 0x0", NULL);
+	xmms_magic_set_add (set, "ogg/speex header", "audio/x-speex",
+	                    "0 string OggS", ">4 byte 0",
+	                    ">>28 string Speex   ", NULL);
+	xmms_magic_set_add (set, "wave header", "audio/x-wav",
+	                    "0 string RIFF", ">8 string WAVE",
+	                    ">>12 string fmt ", NULL);
+
+	return 0;
+}
+
+CLEANUP () {
+	xmms_magic_set_free (set);
+	return 0;
+}
+
+CASE (test_empty)
+{
+	xmms_magic_set_t *empty;
+	xmms_magic_checker_t c;
+	memory_t mem = { "fLaC", 4 };
+
+	empty = xmms_magic_set_new ();
+
+	xmms_magic_checker_init (&c, memory_read, &mem);
+	CU_ASSERT_PTR_NULL (xmms_magic_set_match (empty, &c, NULL));
+	xmms_magic_checker_clear (&c);
+
+	xmms_magic_set_free (empty);
+}
+
+CASE (test_invalid_spec)
+{
+	CU_ASSERT_FALSE (xmms_magic_set_add (set, "broken", "x-test/broken",
+	                                     "0 nosuchtype 1", NULL));
+	CU_ASSERT_PTR_NULL (match ("0 nosuchtype 1", 14, FALSE));
+}
+
+CASE (test_match_headers)
+{
+	static const gchar wave[] = "RIFF\0\0\0\0WAVEfmt ";
+	static const gchar mp4[] = "\0\0\0\x20" "ftypM4A \0\0\0\0";
+	static const gchar asf[] = "\x30\x26\xb2\x75\x8e\x66\xcf\x11";
+	static const gchar mpeg[] = "\xff\xfb\x90\x00";
+	gchar mod[1084];
+	const gchar *desc = NULL;
+	xmms_magic_checker_t c;
+	memory_t mem = { wave, sizeof (wave) - 1 };
+
+	xmms_magic_checker_init (&c, memory_read, &mem);
+	CU_ASSERT_STRING_EQUAL ("audio/x-wav", xmms_magic_set_match (set, &c, &desc));
+	CU_ASSERT_STRING_EQUAL ("wave header", desc);
+	xmms_magic_checker_clear (&c);
+
+	CU_ASSERT_STRING_EQUAL ("audio/x-flac", match ("fLaC\0\0\0\x22", 8, FALSE));
+	CU_ASSERT_STRING_EQUAL ("audio/mp4", match (mp4, sizeof (mp4) - 1, FALSE));
+	CU_ASSERT_STRING_EQUAL ("video/x-ms-asf", match (asf, sizeof (asf) - 1, FALSE));
+	CU_ASSERT_STRING_EQUAL ("audio/mpeg", match (mpeg, sizeof (mpeg) - 1, FALSE));
+	CU_ASSERT_STRING_EQUAL ("text/html", match ("<HtMl lang", 10, FALSE));
+	CU_ASSERT_STRING_EQUAL ("application/x-nul-padded", match ("\0abc", 4, FALSE));
+
+	/* tests beyond the indexed window still work */
+	memset (mod, 'x', sizeof (mod));
+	memcpy (mod + 1080, "M.K.", 4);
+	CU_ASSERT_STRING_EQUAL ("audio/mod", match (mod, sizeof (mod), FALSE));
+
+	CU_ASSERT_PTR_NULL (match ("nothing to see", 14, FALSE));
+	CU_ASSERT_PTR_NULL (match ("", 0, FALSE));
+}
+
+CASE (test_short_data)
+{
+	/* not enough data for the indexed offsets, must not match or crash */
+	CU_ASSERT_PTR_NULL (match ("fLa", 3, FALSE));
+	CU_ASSERT_PTR_NULL (match ("xxxxfty", 7, FALSE));
+	assert_same ("\xff", 1);
+	assert_same ("O", 1);
+}
+
+CASE (test_same_as_linear)
+{
+	static const gchar headers[][16] = {
+		"RIFF\0\0\0\0WAVEfmt ", "OggS\0\0\0\0", "ID3\x03\x00\x00",
+		"\0\0\0\x18" "ftypisom", "\xff\xf1\x50\x80", "\xff\xe3\x18\xc4",
+		"<html>", "<HTML ", "fLaC", "\x30\x26\xb2\x75",
+	};
+	gchar buf[64];
+	GRand *rand;
+	guint i, j, k;
+
+	rand = g_rand_new_with_seed (1234);
+
+	for (i = 0; i < G_N_ELEMENTS (headers); i++) {
+		for (j = 0; j < 200; j++) {
+			for (k = 0; k < sizeof (buf); k++) {
+				buf[k] = g_rand_int (rand);
+			}
+			memcpy (buf, headers[i], sizeof (headers[i]));
+
+			/* flip a byte in the header now and then */
+			if (j & 1) {
+				buf[g_rand_int_range (rand, 0, sizeof (headers[i]))] ^= 1 << g_rand_int_range (rand, 0, 8);
+			}
+
+			assert_same (buf, g_rand_int_range (rand, 0, sizeof (buf) + 1));
+		}
+	}
+
+	g_rand_free (rand);
+}
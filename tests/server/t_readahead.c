@@ -0,0 +1,298 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "xmms/xmms_readahead.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define BUFFER_SIZE (64 * 1024)
+
+/* A transport reading a temporary file, in place of a share */
+typedef struct {
+	gint fd;
+	/** fail reads at or after this offset, -1 never */
+	gint64 fail_at;
+} file_t;
+
+static gchar *filename;
+static guchar *contents;
+
+static gint
+file_read (gpointer udata, gpointer buf, gint len, xmms_error_t *err)
+{
+	file_t *file = udata;
+	gint ret;
+
+	if (file->fail_at >= 0 &&
+	    lseek (file->fd, 0, SEEK_CUR) + len > file->fail_at) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "share went away");
+		return -1;
+	}
+
+	ret = read (file->fd, buf, len);
+	if (ret < 0) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "read failed");
+	}
+
+	return ret;
+}
+
+static gint64
+file_seek (gpointer udata, gint64 offset, xmms_xform_seek_mode_t whence,
+           xmms_error_t *err)
+{
+	file_t *file = udata;
+	gint64 ret;
+	gint w;
+
+	switch (whence) {
+		case XMMS_XFORM_SEEK_CUR:
+			w = SEEK_CUR;
+			break;
+		case XMMS_XFORM_SEEK_END:
+			w = SEEK_END;
+			break;
+		default:
+			w = SEEK_SET;
+			break;
+	}
+
+	ret = lseek (file->fd, offset, w);
+	if (ret < 0) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "Couldn't seek");
+	}
+
+	return ret;
+}
+
+static xmms_readahead_t *
+file_readahead (file_t *file, gint64 length, gint64 fail_at)
+{
+	file->fd = open (filename, O_RDONLY);
+	file->fail_at = fail_at;
+	CU_ASSERT_FATAL (file->fd >= 0);
+
+	return xmms_readahead_new (file_read, file_seek, file, 0, length,
+	                           BUFFER_SIZE);
+}
+
+static void
+file_close (xmms_readahead_t *ra, file_t *file)
+{
+	xmms_readahead_free (ra);
+	close (file->fd);
+}
+
+/* Read exactly len bytes at the current offset and compare them */
+static void
+assert_read (xmms_readahead_t *ra, gint64 offset, gint len)
+{
+	xmms_error_t err;
+	guchar buf[4096];
+	gint ret, n;
+
+	xmms_error_reset (&err);
+
+	while (len > 0) {
+		n = MIN (len, sizeof (buf));
+		ret = xmms_readahead_read (ra, buf, n, &err);
+		CU_ASSERT_FATAL (ret > 0);
+		CU_ASSERT (memcmp (buf, contents + offset, ret) == 0);
+		offset += ret;
+		len -= ret;
+	}
+}
+
+static void
+assert_seek (xmms_readahead_t *ra, gint64 offset,
+             xmms_xform_seek_mode_t whence, gint64 expected)
+{
+	xmms_error_t err;
+
+	xmms_error_reset (&err);
+	CU_ASSERT_EQUAL (xmms_readahead_seek (ra, offset, whence, &err), expected);
+	CU_ASSERT (xmms_error_isok (&err));
+}
+
+SETUP (readahead) {
+	gint fd, i;
+
+	g_thread_init (0);
+
+	contents = g_malloc (FILE_SIZE);
+	for (i = 0; i < FILE_SIZE; i++) {
+		contents[i] = (i * 7 + i / 251) & 0xff;
+	}
+
+	fd = g_file_open_tmp ("xmms2-readahead-XXXXXX", &filename, NULL);
+	if (fd < 0) {
+		return 1;
+	}
+
+	if (write (fd, contents, FILE_SIZE) != FILE_SIZE) {
+		close (fd);
+		return 1;
+	}
+	close (fd);
+
+	return 0;
+}
+
+CLEANUP () {
+	unlink (filename);
+	g_free (filename);
+	g_free (contents);
+	return 0;
+}
+
+CASE (test_sequential)
+{
+	xmms_readahead_t *ra;
+	xmms_error_t err;
+	guint reads, seeks, buffered, stalls;
+	guchar buf[1000];
+	gint64 offset = 0;
+	gint ret;
+	file_t file;
+
+	ra = file_readahead (&file, FILE_SIZE, -1);
+	xmms_error_reset (&err);
+
+	/* small reads, like a decoder does */
+	while ((ret = xmms_readahead_read (ra, buf, sizeof (buf), &err)) > 0) {
+		CU_ASSERT (memcmp (buf, contents + offset, ret) == 0);
+		offset += ret;
+	}
+
+	CU_ASSERT_EQUAL (ret, 0);
+	CU_ASSERT_EQUAL (offset, FILE_SIZE);
+	CU_ASSERT (xmms_error_isok (&err));
+
+	/* stays at the end */
+	CU_ASSERT_EQUAL (xmms_readahead_read (ra, buf, sizeof (buf), &err), 0);
+
+	/* the file was read in a few large chunks */
+	xmms_readahead_stats_get (ra, &reads, &seeks, &buffered, &stalls);
+	CU_ASSERT (reads <= FILE_SIZE / (BUFFER_SIZE / 4) + 1);
+	CU_ASSERT_EQUAL (seeks, 0);
+
+	file_close (ra, &file);
+}
+
+CASE (test_seek_in_buffer)
+{
+	xmms_readahead_t *ra;
+	guint reads, seeks, buffered, stalls;
+	file_t file;
+
+	ra = file_readahead (&file, FILE_SIZE, -1);
+
+	assert_read (ra, 0, 10000);
+
+	/* back to what was already read */
+	assert_seek (ra, 100, XMMS_XFORM_SEEK_SET, 100);
+	assert_read (ra, 100, 5000);
+
+	/* forward over what was already read again */
+	assert_seek (ra, 2000, XMMS_XFORM_SEEK_CUR, 7100);
+	assert_read (ra, 7100, 100);
+
+	/* telling the position is a seek too */
+	assert_seek (ra, 0, XMMS_XFORM_SEEK_CUR, 7200);
+
+	xmms_readahead_stats_get (ra, &reads, &seeks, &buffered, &stalls);
+	CU_ASSERT_EQUAL (seeks, 0);
+	CU_ASSERT_EQUAL (buffered, 3);
+
+	file_close (ra, &file);
+}
+
+CASE (test_seek_far)
+{
+	xmms_readahead_t *ra;
+	guint reads, seeks, buffered, stalls;
+	file_t file;
+
+	ra = file_readahead (&file, FILE_SIZE, -1);
+
+	assert_read (ra, 0, 1000);
+
+	assert_seek (ra, 900000, XMMS_XFORM_SEEK_SET, 900000);
+	assert_read (ra, 900000, 20000);
+
+	/* the start has been thrown away by now */
+	assert_seek (ra, 0, XMMS_XFORM_SEEK_SET, 0);
+	assert_read (ra, 0, 1000);
+
+	xmms_readahead_stats_get (ra, &reads, &seeks, &buffered, &stalls);
+	CU_ASSERT_EQUAL (seeks, 2);
+
+	file_close (ra, &file);
+}
+
+CASE (test_seek_end)
+{
+	xmms_readahead_t *ra;
+	file_t file;
+
+	/* the length is known, so it's a seek from the start */
+	ra = file_readahead (&file, FILE_SIZE, -1);
+	assert_seek (ra, -1000, XMMS_XFORM_SEEK_END, FILE_SIZE - 1000);
+	assert_read (ra, FILE_SIZE - 1000, 1000);
+	file_close (ra, &file);
+
+	/* it isn't, so the transport has to do it */
+	ra = file_readahead (&file, -1, -1);
+	assert_seek (ra, -1000, XMMS_XFORM_SEEK_END, FILE_SIZE - 1000);
+	assert_read (ra, FILE_SIZE - 1000, 1000);
+	file_close (ra, &file);
+}
+
+CASE (test_error)
+{
+	xmms_readahead_t *ra;
+	xmms_error_t err;
+	guchar buf[4096];
+	gint64 offset = 0;
+	gint ret;
+	file_t file;
+
+	ra = file_readahead (&file, FILE_SIZE, 500000);
+
+	xmms_error_reset (&err);
+	while ((ret = xmms_readahead_read (ra, buf, sizeof (buf), &err)) > 0) {
+		CU_ASSERT (memcmp (buf, contents + offset, ret) == 0);
+		offset += ret;
+	}
+
+	CU_ASSERT_EQUAL (ret, -1);
+	CU_ASSERT (offset <= 500000);
+	CU_ASSERT (offset > 500000 - BUFFER_SIZE);
+	CU_ASSERT_STRING_EQUAL (err.message, "share went away");
+
+	/* a seek recovers */
+	file.fail_at = -1;
+	assert_seek (ra, 1000, XMMS_XFORM_SEEK_SET, 1000);
+	assert_read (ra, 1000, 1000);
+
+	file_close (ra, &file);
+}
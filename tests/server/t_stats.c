@@ -0,0 +1,204 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "xmmspriv/xmms_stats.h"
+
+#define THREADS 8
+#define ADDS_PER_THREAD 100000
+
+static xmms_stats_counter_t *shared;
+
+static gpointer
+add_thread (gpointer udata)
+{
+	gint i;
+
+	for (i = 0; i < ADDS_PER_THREAD; i++) {
+		xmms_stats_counter_inc (shared);
+	}
+
+	return NULL;
+}
+
+static void
+collect (const gchar *name, xmmsv_t *value, gpointer udata)
+{
+	xmmsv_t *dict = (xmmsv_t *) udata;
+
+	xmmsv_dict_set (dict, name, value);
+}
+
+SETUP (stats) {
+	if (!g_thread_supported ()) {
+		g_thread_init (NULL);
+	}
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+CASE (test_counter)
+{
+	xmms_stats_counter_t *counter;
+
+	xmms_stats_init ();
+
+	counter = xmms_stats_counter_register ("test.counter");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (counter);
+	CU_ASSERT_PTR_EQUAL (counter, xmms_stats_counter_register ("test.counter"));
+	CU_ASSERT_EQUAL (xmms_stats_counter_get (counter), 0);
+
+	/* so the per thread slots really sit on their own cache lines */
+	CU_ASSERT_EQUAL (GPOINTER_TO_SIZE (counter) % 64, 0);
+
+	xmms_stats_counter_inc (counter);
+	xmms_stats_counter_add (counter, 41);
+	CU_ASSERT_EQUAL (xmms_stats_counter_get (counter), 42);
+
+	xmms_stats_counter_add (counter, G_GINT64_CONSTANT (1) << 40);
+	CU_ASSERT_EQUAL (xmms_stats_counter_get (counter),
+	                 (G_GINT64_CONSTANT (1) << 40) + 42);
+
+	/* used as a gauge */
+	xmms_stats_counter_set (counter, 7);
+	CU_ASSERT_EQUAL (xmms_stats_counter_get (counter), 7);
+
+	xmms_stats_shutdown ();
+}
+
+CASE (test_counter_threads)
+{
+	GThread *threads[THREADS];
+	gint i;
+
+	xmms_stats_init ();
+
+	shared = xmms_stats_counter_register ("test.shared");
+
+	for (i = 0; i < THREADS; i++) {
+		threads[i] = g_thread_create (add_thread, NULL, TRUE, NULL);
+	}
+	for (i = 0; i < THREADS; i++) {
+		g_thread_join (threads[i]);
+	}
+
+	CU_ASSERT_EQUAL (xmms_stats_counter_get (shared),
+	                 THREADS * ADDS_PER_THREAD);
+
+	xmms_stats_shutdown ();
+}
+
+CASE (test_histogram)
+{
+	xmms_stats_histogram_t *hist;
+	gint i;
+
+	xmms_stats_init ();
+
+	hist = xmms_stats_histogram_register ("test.hist_us");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (hist);
+	CU_ASSERT_EQUAL (GPOINTER_TO_SIZE (hist) % 64, 0);
+	CU_ASSERT_EQUAL (xmms_stats_histogram_percentile (hist, 50), 0);
+
+	for (i = 0; i < 90; i++) {
+		xmms_stats_histogram_add (hist, 10);
+	}
+	for (i = 0; i < 10; i++) {
+		xmms_stats_histogram_add (hist, 5000);
+	}
+
+	CU_ASSERT_EQUAL (xmms_stats_histogram_count (hist), 100);
+	/* 10 is in [8, 16), 5000 in [4096, 8192) */
+	CU_ASSERT_EQUAL (xmms_stats_histogram_percentile (hist, 50), 15);
+	CU_ASSERT_EQUAL (xmms_stats_histogram_percentile (hist, 90), 15);
+	CU_ASSERT_EQUAL (xmms_stats_histogram_percentile (hist, 91), 8191);
+	CU_ASSERT_EQUAL (xmms_stats_histogram_percentile (hist, 99), 8191);
+
+	/* a clock going backwards counts as no time at all */
+	xmms_stats_histogram_add (hist, -5);
+	CU_ASSERT_EQUAL (xmms_stats_histogram_count (hist), 101);
+	CU_ASSERT_EQUAL (xmms_stats_histogram_percentile (hist, 0), 0);
+
+	xmms_stats_shutdown ();
+}
+
+CASE (test_foreach)
+{
+	xmms_stats_histogram_t *hist;
+	xmmsv_t *dict, *h, *buckets, *v;
+	gint32 value;
+
+	xmms_stats_init ();
+
+	xmms_stats_counter_add (xmms_stats_counter_register ("b.counter"), 3);
+	hist = xmms_stats_histogram_register ("a.hist_us");
+	xmms_stats_histogram_add (hist, 3000);
+	xmms_stats_histogram_add (hist, 1000);
+
+	dict = xmmsv_new_dict ();
+	xmms_stats_foreach (collect, dict);
+
+	CU_ASSERT_EQUAL (xmmsv_dict_get_size (dict), 2);
+
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int (dict, "b.counter", &value));
+	CU_ASSERT_EQUAL (value, 3);
+
+	CU_ASSERT_TRUE_FATAL (xmmsv_dict_get (dict, "a.hist_us", &h));
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int (h, "count", &value));
+	CU_ASSERT_EQUAL (value, 2);
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int (h, "total_ms", &value));
+	CU_ASSERT_EQUAL (value, 4);
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int (h, "p50_us", &value));
+	CU_ASSERT_EQUAL (value, 1023);
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int (h, "p99_us", &value));
+	CU_ASSERT_EQUAL (value, 4095);
+
+	/* up to and including the bucket 3000 is in */
+	CU_ASSERT_TRUE_FATAL (xmmsv_dict_get (h, "buckets", &buckets));
+	CU_ASSERT_EQUAL (xmmsv_list_get_size (buckets), 13);
+	CU_ASSERT_TRUE (xmmsv_list_get (buckets, 10, &v));
+	CU_ASSERT_TRUE (xmmsv_get_int (v, &value));
+	CU_ASSERT_EQUAL (value, 1);
+
+	xmmsv_unref (dict);
+
+	xmms_stats_shutdown ();
+}
+
+CASE (test_without_registry)
+{
+	xmms_stats_counter_t *counter;
+	xmms_stats_histogram_t *hist;
+
+	/* code running before the registry is set up gets nothing */
+	counter = xmms_stats_counter_register ("test.counter");
+	hist = xmms_stats_histogram_register ("test.hist_us");
+	CU_ASSERT_PTR_NULL (counter);
+	CU_ASSERT_PTR_NULL (hist);
+
+	/* and can use it anyway */
+	xmms_stats_counter_inc (counter);
+	xmms_stats_histogram_add_since (hist, xmms_stats_time ());
+	CU_ASSERT_EQUAL (xmms_stats_counter_get (counter), 0);
+	CU_ASSERT_EQUAL (xmms_stats_histogram_count (hist), 0);
+}
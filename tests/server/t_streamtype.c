@@ -316,3 +316,72 @@ CASE (test_coerce)
 	xmms_object_unref (to);
 }
 
+
+CASE (test_match_url_pattern)
+{
+	xmms_stream_type_t *st1, *st2;
+
+	st1 = _xmms_stream_type_new ("dummy",
+	                             XMMS_STREAM_TYPE_MIMETYPE, "application/x-url",
+	                             XMMS_STREAM_TYPE_URL, "file://*",
+	                             XMMS_STREAM_TYPE_END);
+	st2 = _xmms_stream_type_new ("dummy",
+	                             XMMS_STREAM_TYPE_MIMETYPE, "application/x-url",
+	                             XMMS_STREAM_TYPE_URL, "file:///music/a.flac",
+	                             XMMS_STREAM_TYPE_END);
+
+	CU_ASSERT_TRUE (xmms_stream_type_match (st1, st2));
+	CU_ASSERT_FALSE (xmms_stream_type_match (st2, st1));
+
+	xmms_object_unref (st1);
+	xmms_object_unref (st2);
+}
+
+CASE (test_equal)
+{
+	xmms_stream_type_t *st1, *st2, *st3;
+
+	st1 = _xmms_stream_type_new ("dummy",
+	                             XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                             XMMS_STREAM_TYPE_FMT_CHANNELS, 2,
+	                             XMMS_STREAM_TYPE_FMT_SAMPLERATE, 44100,
+	                             XMMS_STREAM_TYPE_END);
+	st2 = _xmms_stream_type_new ("other",
+	                             XMMS_STREAM_TYPE_FMT_SAMPLERATE, 44100,
+	                             XMMS_STREAM_TYPE_PRIORITY, 10,
+	                             XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                             XMMS_STREAM_TYPE_FMT_CHANNELS, 2,
+	                             XMMS_STREAM_TYPE_END);
+	st3 = _xmms_stream_type_new ("dummy",
+	                             XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                             XMMS_STREAM_TYPE_FMT_CHANNELS, 1,
+	                             XMMS_STREAM_TYPE_FMT_SAMPLERATE, 44100,
+	                             XMMS_STREAM_TYPE_END);
+
+	/* order, name and priority don't matter */
+	CU_ASSERT_TRUE (xmms_stream_type_equal (st1, st2));
+	CU_ASSERT_EQUAL (xmms_stream_type_hash (st1), xmms_stream_type_hash (st2));
+	CU_ASSERT_FALSE (xmms_stream_type_equal (st1, st3));
+
+	/* mimetypes are interned */
+	CU_ASSERT_PTR_EQUAL (xmms_stream_type_get_str (st1, XMMS_STREAM_TYPE_MIMETYPE),
+	                     xmms_stream_type_get_str (st2, XMMS_STREAM_TYPE_MIMETYPE));
+
+	xmms_object_unref (st1);
+	xmms_object_unref (st2);
+	xmms_object_unref (st3);
+}
+
+CASE (test_duplicate_key)
+{
+	xmms_stream_type_t *st;
+
+	st = _xmms_stream_type_new ("dummy",
+	                            XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                            XMMS_STREAM_TYPE_FMT_CHANNELS, 2,
+	                            XMMS_STREAM_TYPE_FMT_CHANNELS, 6,
+	                            XMMS_STREAM_TYPE_END);
+	CU_ASSERT_EQUAL (2, xmms_stream_type_get_int (st, XMMS_STREAM_TYPE_FMT_CHANNELS));
+
+	xmms_object_unref (st);
+}
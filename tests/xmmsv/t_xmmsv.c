@@ -848,6 +848,84 @@ CASE (test_xmmsv_type_bitbuffer2)
 	xmmsv_unref (value);
 }
 
+CASE (test_xmmsv_type_bitbuffer_aligned_data)
+{
+	xmmsv_t *value;
+	unsigned char data[1000], b[1000];
+	int i, r;
+
+	for (i = 0; i < sizeof (data); i++) {
+		data[i] = i * 7;
+	}
+
+	value = xmmsv_bitbuffer_new ();
+
+	/* byte aligned, one write growing the buffer well past its
+	 * first allocation */
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_bits (value, 8, 0x42));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_data (value, data, sizeof (data)));
+	CU_ASSERT_EQUAL (xmmsv_bitbuffer_pos (value), (1 + sizeof (data)) * 8);
+	CU_ASSERT_EQUAL (xmmsv_bitbuffer_len (value), (1 + sizeof (data)) * 8);
+
+	/* and another one growing it again */
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_data (value, data, sizeof (data)));
+	CU_ASSERT_EQUAL (xmmsv_bitbuffer_len (value), (1 + 2 * sizeof (data)) * 8);
+	CU_ASSERT_EQUAL (memcmp (xmmsv_bitbuffer_buffer (value) + 1 + sizeof (data),
+	                         data, sizeof (data)), 0);
+
+	/* nothing to write doesn't move anything */
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_data (value, data, 0));
+	CU_ASSERT_EQUAL (xmmsv_bitbuffer_len (value), (1 + 2 * sizeof (data)) * 8);
+
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_rewind (value));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_bits (value, 8, &r));
+	CU_ASSERT_EQUAL (r, 0x42);
+
+	memset (b, 0, sizeof (b));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_data (value, b, sizeof (b)));
+	CU_ASSERT_EQUAL (memcmp (b, data, sizeof (data)), 0);
+	CU_ASSERT_EQUAL (xmmsv_bitbuffer_pos (value), (1 + sizeof (data)) * 8);
+
+	/* reading past the end fails */
+	CU_ASSERT_FALSE (xmmsv_bitbuffer_get_data (value, b, sizeof (b) + 1));
+
+	/* overwriting in the middle leaves the length alone */
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_goto (value, 8));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_data (value, (unsigned char *) "test", 4));
+	CU_ASSERT_EQUAL (xmmsv_bitbuffer_len (value), (1 + 2 * sizeof (data)) * 8);
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_goto (value, 8));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_data (value, b, 4));
+	CU_ASSERT_EQUAL (memcmp (b, "test", 4), 0);
+
+	xmmsv_unref (value);
+}
+
+CASE (test_xmmsv_type_bitbuffer_unaligned_data)
+{
+	xmmsv_t *value;
+	unsigned char b[3];
+	int r;
+
+	value = xmmsv_bitbuffer_new ();
+
+	/* off by a bit, goes the slow way and has to agree */
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_bits (value, 1, 1));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_data (value, (unsigned char *) "\x81\x42\xff", 3));
+	CU_ASSERT_EQUAL (xmmsv_bitbuffer_len (value), 25);
+
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_rewind (value));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_bits (value, 9, &r));
+	CU_ASSERT_EQUAL (r, 0x181);
+
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_rewind (value));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_bits (value, 1, &r));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_data (value, b, 3));
+	CU_ASSERT_EQUAL (memcmp (b, "\x81\x42\xff", 3), 0);
+	CU_ASSERT_FALSE (xmmsv_bitbuffer_get_data (value, b, 1));
+
+	xmmsv_unref (value);
+}
+
 CASE (test_xmmsv_type_bitbuffer_ro)
 {
 	xmmsv_t *value;
@@ -0,0 +1,172 @@
+from waflib import Task, Logs, Errors, Options, Utils
+from waflib.Build import BuildContext
+from waflib.TaskGen import feature, after_method
+
+# Metrics are named after what they measure, which tells which way
+# is better when comparing against a baseline. The ones describing
+# the work that was done, like the number of files, aren't compared.
+# A metric matching none of these fails the run, so that it can't
+# silently drop out of the comparison. Values that aren't numbers,
+# like the name of the implementation picked, are only reported.
+LOWER_IS_BETTER = ('_ms', '_us', '_ns', '_calls')
+HIGHER_IS_BETTER = ('_per_sec', 'x_realtime')
+WORKLOAD = ('_count', '_bytes')
+
+# Benchmarks running side by side would only measure each other.
+benchlock = Utils.threading.Lock()
+
+class BenchContext(BuildContext):
+    '''builds the project and runs the benchmarks'''
+    cmd = 'bench'
+
+@feature('bench')
+@after_method('apply_link')
+def make_bench(self):
+    if self.bld.cmd != 'bench':
+        return
+
+    wanted = Options.options.benchmarks
+    if wanted and self.target not in wanted.split(','):
+        return
+
+    if getattr(self, 'link_task', None):
+        self.create_task('bench', self.link_task.outputs)
+
+class bench(Task.Task):
+    color = 'PINK'
+    after = ['vnum', 'inst']
+    vars = []
+
+    def runnable_status(self):
+        ret = Task.Task.runnable_status(self)
+        if ret == Task.SKIP_ME:
+            return Task.RUN_ME
+        return ret
+
+    def run(self):
+        cmd = [self.inputs[0].abspath()]
+        cmd += Utils.to_list(getattr(self.generator, 'bench_args', []))
+
+        # the synthetic medialib benchmarks take the number of songs
+        size = Options.options.bench_medialib_size
+        flag = getattr(self.generator, 'bench_medialib_arg', None)
+        if size and flag:
+            cmd += [flag, str(size)]
+
+        benchlock.acquire()
+        try:
+            Logs.info("- running %s" % self.generator.target)
+            proc = Utils.subprocess.Popen(cmd,
+                                          cwd=self.inputs[0].parent.abspath(),
+                                          stdout=Utils.subprocess.PIPE,
+                                          stderr=Utils.subprocess.PIPE)
+            (stdout, stderr) = proc.communicate()
+        finally:
+            benchlock.release()
+
+        bld = self.generator.bld
+        bld.bench_results.append((self.generator.target, proc.returncode,
+                                  stdout.decode("ascii", "ignore"),
+                                  stderr.decode("ascii", "ignore")))
+
+def direction(metric):
+    """1 if lower is better, -1 if higher is, 0 if not compared and
+    None if the name follows none of the conventions"""
+    if metric.endswith(LOWER_IS_BETTER):
+        return 1
+    if metric.endswith(HIGHER_IS_BETTER):
+        return -1
+    if metric.endswith(WORKLOAD):
+        return 0
+    return None
+
+def parse_results(lines):
+    results = {}
+    for line in lines:
+        if line.startswith('#'):
+            continue
+        fields = line.rstrip('\n').split('\t')
+        if len(fields) != 4:
+            continue
+        try:
+            results[tuple(fields[:3])] = float(fields[3])
+        except ValueError:
+            pass
+    return results
+
+def compare(results, baseline_file):
+    baseline = parse_results(open(baseline_file).readlines())
+    threshold = Options.options.bench_threshold / 100.0
+
+    regressions = []
+    for key, value in sorted(results.items()):
+        if key not in baseline or baseline[key] == 0:
+            continue
+
+        change = (value - baseline[key]) / baseline[key]
+        if direction(key[2]) * change > threshold:
+            regressions.append("%s %s %s: %g -> %g (%+.1f%%)" %
+                               (key + (baseline[key], value, change * 100)))
+
+    return regressions
+
+def summary(bld):
+    lst = getattr(bld, 'bench_results', [])
+    if not lst:
+        return
+
+    lines = ["# xmms2 %s\n" % bld.env.VERSION]
+    failed = []
+
+    for (target, code, out, err) in sorted(lst):
+        if code != 0:
+            failed.append("%s (exit status %d)\n%s" % (target, code, err))
+            continue
+        for line in out.splitlines():
+            if line.count('\t') == 2:
+                lines.append("%s\t%s\n" % (target, line))
+
+    node = bld.bldnode.make_node('bench-results.tsv')
+    node.write(''.join(lines))
+
+    Logs.pprint('CYAN', 'benchmark results')
+    Logs.pprint('NORMAL', ''.join(lines[1:]))
+    Logs.info("Results written to %s" % node.abspath())
+
+    results = parse_results(lines)
+    unknown = ["%s %s %s" % key for key in sorted(results)
+               if direction(key[2]) is None]
+    if unknown:
+        failed.append("metrics named after no known unit:\n%s" %
+                      "\n".join(unknown))
+
+    if failed:
+        raise Errors.WafError("Benchmark(s) failed:\n%s" % "\n".join(failed))
+
+    if Options.options.bench_baseline:
+        regressions = compare(results, Options.options.bench_baseline)
+        if regressions:
+            raise Errors.WafError("Regressions against %s:\n%s" %
+                                  (Options.options.bench_baseline,
+                                   "\n".join(regressions)))
+
+def configure(conf):
+    pass
+
+def setup(bld):
+    bld.bench_results = []
+    bld.add_post_fun(summary)
+
+def options(opts):
+    opts.add_option('--benchmarks', type='string', dest='benchmarks',
+                    default=None,
+                    help="Comma separated list of benchmarks to run with 'bench'")
+    opts.add_option('--bench-medialib-size', type='int',
+                    dest='bench_medialib_size', default=None,
+                    help="Number of songs in the synthetic medialibs, e.g. 1000000 [default: 100000]")
+    opts.add_option('--bench-baseline', type='string', dest='bench_baseline',
+                    default=None,
+                    help="Compare the benchmark results against an earlier bench-results.tsv")
+    opts.add_option('--bench-threshold', type='float', dest='bench_threshold',
+                    default=10.0,
+                    help="Percentage a metric may get worse by before it counts as a regression [default: 10]")
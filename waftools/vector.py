@@ -0,0 +1,39 @@
+# Checks for what plugins need to build vectorized code paths that
+# are picked at runtime.
+
+vector_fragment = """
+typedef float vf __attribute__ ((vector_size (16)));
+typedef int vi __attribute__ ((vector_size (16)));
+int main() {
+    vi i = { 1, 2, 3, 4 };
+    vf f = __builtin_convertvector (i, vf) * 0.5f;
+    return (int) f[3];
+}
+"""
+
+dispatch_fragment = """
+__attribute__ ((target ("avx2"))) static int twice (int x) { return x * 2; }
+int main() {
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("avx2") ? twice (0) : 0;
+}
+"""
+
+# Defines HAVE_VECTOR_EXTENSIONS if the compiler has GCC's generic
+# vector types, and HAVE_CPU_DISPATCH if it can also build functions
+# for AVX2 and check for it at runtime. Only done once, however many
+# plugins ask.
+def check_vector(conf):
+    if 'HAVE_VECTOR_EXTENSIONS' in conf.env.VECTOR_CHECKED:
+        return
+    conf.env.append_value('VECTOR_CHECKED', 'HAVE_VECTOR_EXTENSIONS')
+
+    conf.check_cc(fragment=vector_fragment,
+                  define_name="HAVE_VECTOR_EXTENSIONS",
+                  msg="Checking for vector extensions",
+                  mandatory=False)
+    if conf.is_defined("HAVE_VECTOR_EXTENSIONS"):
+        conf.check_cc(fragment=dispatch_fragment,
+                      define_name="HAVE_CPU_DISPATCH",
+                      msg="Checking for AVX2 runtime dispatch",
+                      mandatory=False)